@@ -0,0 +1,82 @@
+// bench.h - Timing helpers for the host benchmarks
+// Benchmarks print a single JSON document on stdout so results can be
+// collected and compared between runs; progress and errors go to stderr.
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// Keeps the compiler from discarding a result nobody reads
+#define BENCH_KEEP(value) __asm__ volatile("" : : "g"(value) : "memory")
+
+// Best of several timed rounds, to shed scheduler noise
+#define BENCH_ROUNDS 5
+
+// Stack high-water of fn(ctx), measured the way FreeRTOS does it: fn runs
+// on a thread whose stack is painted with a pattern, and the bytes no longer
+// holding the pattern are counted. What thread start-up itself uses is
+// subtracted. Returns 0 if the thread cannot be started.
+#define BENCH_STACK_SIZE (256 * 1024)
+#define BENCH_STACK_PAINT 0xA5
+
+typedef struct {
+    void (*fn)(void *ctx);
+    void *ctx;
+} bench_stack_call_t;
+
+static inline void *bench_stack_trampoline(void *arg)
+{
+    bench_stack_call_t *call = arg;
+    if (call->fn) {
+        call->fn(call->ctx);
+    }
+    return NULL;
+}
+
+static inline size_t bench_stack_raw(void (*fn)(void *ctx), void *ctx)
+{
+    uint8_t *stack = mmap(NULL, BENCH_STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (stack == MAP_FAILED) {
+        return 0;
+    }
+    memset(stack, BENCH_STACK_PAINT, BENCH_STACK_SIZE);
+
+    bench_stack_call_t call = { fn, ctx };
+    pthread_attr_t attr;
+    pthread_t thread;
+    size_t used = 0;
+    pthread_attr_init(&attr);
+    if (pthread_attr_setstack(&attr, stack, BENCH_STACK_SIZE) == 0 &&
+        pthread_create(&thread, &attr, bench_stack_trampoline, &call) == 0) {
+        pthread_join(thread, NULL);
+        size_t untouched = 0;
+        while (untouched < BENCH_STACK_SIZE && stack[untouched] == BENCH_STACK_PAINT) {
+            untouched++;
+        }
+        used = BENCH_STACK_SIZE - untouched;
+    }
+    pthread_attr_destroy(&attr);
+    munmap(stack, BENCH_STACK_SIZE);
+    return used;
+}
+
+static inline size_t bench_stack_used(void (*fn)(void *ctx), void *ctx)
+{
+    size_t baseline = bench_stack_raw(NULL, NULL);
+    size_t used = bench_stack_raw(fn, ctx);
+    return used > baseline ? used - baseline : 0;
+}
+
+#endif // BENCH_H
@@ -0,0 +1,112 @@
+// bench_fixed_format.c - fixed_format() against snprintf("%.*f"): time and stack
+// Time per value at each decimal count the templates use, on readings of
+// every magnitude a register decodes to. Then the stack high-water (painted
+// stack, see bench.h) of one value and of a whole QUALITY document, the
+// widest the telemetry task builds, through the old snprintf template and
+// through the writer. The C library here is glibc, not the ESP32's newlib, so
+// the stack figures show the difference in kind rather than the device's
+// bytes; on the device telemetry_task logs its own high-water mark.
+
+#include "bench.h"
+#include "fixed_format.h"
+#include "json_templates.h"
+#include "legacy_json_templates.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define VALUE_COUNT 4096
+#define BENCH_PASSES 25                    // Over all values, per timed round
+
+static const int decimal_counts[] = { 0, 2, 6, 9 };
+#define DECIMAL_COUNT (sizeof(decimal_counts) / sizeof(decimal_counts[0]))
+
+static double values[VALUE_COUNT];
+
+static uint64_t time_snprintf(int decimals)
+{
+    char out[FIXED_FORMAT_BUF_SIZE];
+    uint64_t start_ns = bench_now_ns();
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        for (int i = 0; i < VALUE_COUNT; i++) {
+            snprintf(out, sizeof(out), "%.*f", decimals, values[i]);
+            BENCH_KEEP(out[0]);
+        }
+    }
+    return bench_now_ns() - start_ns;
+}
+
+static uint64_t time_fixed_format(int decimals)
+{
+    char out[FIXED_FORMAT_BUF_SIZE];
+    uint64_t start_ns = bench_now_ns();
+    for (int pass = 0; pass < BENCH_PASSES; pass++) {
+        for (int i = 0; i < VALUE_COUNT; i++) {
+            fixed_format(out, sizeof(out), values[i], decimals);
+            BENCH_KEEP(out[0]);
+        }
+    }
+    return bench_now_ns() - start_ns;
+}
+
+static void stack_snprintf(void *ctx)
+{
+    char out[FIXED_FORMAT_BUF_SIZE];
+    snprintf(out, sizeof(out), "%.*f", 6, *(double *)ctx);
+    BENCH_KEEP(out[0]);
+}
+
+static void stack_fixed_format(void *ctx)
+{
+    char out[FIXED_FORMAT_BUF_SIZE];
+    fixed_format(out, sizeof(out), *(double *)ctx, 6);
+    BENCH_KEEP(out[0]);
+}
+
+static void stack_legacy_quality(void *ctx)
+{
+    char doc[MAX_JSON_PAYLOAD_SIZE];
+    legacy_create_json_payload(ctx, doc, sizeof(doc));
+    BENCH_KEEP(doc[0]);
+}
+
+static void stack_writer_quality(void *ctx)
+{
+    char doc[MAX_JSON_PAYLOAD_SIZE];
+    create_json_payload(ctx, doc, sizeof(doc));
+    BENCH_KEEP(doc[0]);
+}
+
+int main(void)
+{
+    host_log_level = ESP_LOG_NONE;
+    srand(19);
+    for (int i = 0; i < VALUE_COUNT; i++) {
+        values[i] = (double)(rand() % 2000000001 - 1000000000) / pow(10, rand() % 8);
+    }
+
+    printf("{\n  \"benchmark\": \"fixed_format\",\n  \"unit\": \"ns_per_value\",\n  \"results\": [\n");
+    for (size_t d = 0; d < DECIMAL_COUNT; d++) {
+        uint64_t best_snprintf = UINT64_MAX, best_fixed = UINT64_MAX;
+        for (int round = 0; round < BENCH_ROUNDS; round++) {
+            uint64_t ns = time_snprintf(decimal_counts[d]);
+            if (ns < best_snprintf) best_snprintf = ns;
+            ns = time_fixed_format(decimal_counts[d]);
+            if (ns < best_fixed) best_fixed = ns;
+        }
+        double snprintf_ns = (double)best_snprintf / (BENCH_PASSES * VALUE_COUNT);
+        double fixed_ns = (double)best_fixed / (BENCH_PASSES * VALUE_COUNT);
+        printf("    {\"decimals\": %d, \"snprintf\": %.1f, \"fixed_format\": %.1f, \"speedup\": %.2f}%s\n",
+               decimal_counts[d], snprintf_ns, fixed_ns, snprintf_ns / fixed_ns, d + 1 < DECIMAL_COUNT ? "," : "");
+    }
+
+    double value = 24.1968355;
+    json_params_t quality = { .type = JSON_TYPE_QUALITY, .unit_id = "TFG2235Q",
+                              .timestamp = "2025-11-24T12:05:05Z", .scaled_value = 7.12 };
+    printf("  ],\n  \"stack_bytes\": {\"value_snprintf\": %zu, \"value_fixed_format\": %zu, "
+           "\"quality_snprintf\": %zu, \"quality_writer\": %zu}\n}\n",
+           bench_stack_used(stack_snprintf, &value), bench_stack_used(stack_fixed_format, &value),
+           bench_stack_used(stack_legacy_quality, &quality), bench_stack_used(stack_writer_quality, &quality));
+    return 0;
+}
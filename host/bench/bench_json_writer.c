@@ -0,0 +1,213 @@
+// bench_json_writer.c - Sensor documents from the snprintf templates, the writer and compiled templates
+// For each sensor type: one document from the old snprintf template
+// (legacy_generate_sensor_json_with_hex), from the writer
+// (generate_sensor_json_with_hex) and from the sensor's compiled template
+// (json_template_render). Then a 20-sensor telemetry batch, built the old way
+// (a document per sensor into a scratch buffer, copied into the payload) and
+// streamed by the writer into one buffer, field by field or from templates.
+// Logging is off, so only formatting is timed.
+
+#include "bench.h"
+#include "json_templates.h"
+#include "legacy_json_templates.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_DOCUMENTS 20000              // Per timed round
+#define BENCH_BATCHES 1000
+#define BATCH_SENSORS 20
+
+static const struct {
+    const char *sensor_type;
+    double value;
+    const char *hex;
+} cases[] = {
+    { "Flow-Meter", 265.23, NULL },
+    { "Level", 49.4, NULL },
+    { "RAINGAUGE", 123.45, NULL },
+    { "BOREWELL", 24.1968355, NULL },
+    { "ENERGY", 17234.5, "0001 A2F3" },
+    { "QUALITY", 7.12, NULL },
+};
+#define CASE_COUNT (sizeof(cases) / sizeof(cases[0]))
+
+static void make_sensor(sensor_config_t *sensor, int index, const char *sensor_type)
+{
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->enabled = true;
+    snprintf(sensor->name, sizeof(sensor->name), "Sensor %d", index + 1);
+    snprintf(sensor->unit_id, sizeof(sensor->unit_id), "FG247%03d", index);
+    sensor->slave_id = 1 + index;
+    strcpy(sensor->sensor_type, sensor_type);
+}
+
+static double best_ns_per(uint64_t (*run)(void *), void *ctx, int iterations)
+{
+    uint64_t best = UINT64_MAX;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t ns = run(ctx);
+        if (ns < best) {
+            best = ns;
+        }
+    }
+    return (double)best / iterations;
+}
+
+typedef struct {
+    const sensor_config_t *sensor;
+    const json_sensor_template_t *tpl;
+    double value;
+    const char *hex;
+} doc_ctx_t;
+
+static uint64_t run_legacy_doc(void *arg)
+{
+    doc_ctx_t *ctx = arg;
+    char doc[MAX_JSON_PAYLOAD_SIZE];
+    uint64_t start_ns = bench_now_ns();
+    for (int i = 0; i < BENCH_DOCUMENTS; i++) {
+        legacy_generate_sensor_json_with_hex(ctx->sensor, ctx->value, (uint32_t)i, ctx->hex, NULL, doc, sizeof(doc));
+        BENCH_KEEP(doc[0]);
+    }
+    return bench_now_ns() - start_ns;
+}
+
+static uint64_t run_writer_doc(void *arg)
+{
+    doc_ctx_t *ctx = arg;
+    char doc[MAX_JSON_PAYLOAD_SIZE];
+    uint64_t start_ns = bench_now_ns();
+    for (int i = 0; i < BENCH_DOCUMENTS; i++) {
+        generate_sensor_json_with_hex(ctx->sensor, ctx->value, (uint32_t)i, ctx->hex, NULL, doc, sizeof(doc));
+        BENCH_KEEP(doc[0]);
+    }
+    return bench_now_ns() - start_ns;
+}
+
+static uint64_t run_template_doc(void *arg)
+{
+    doc_ctx_t *ctx = arg;
+    char doc[JSON_TEMPLATE_DOC_SIZE];
+    json_template_values_t values = { .value = ctx->value, .hex_string = ctx->hex };
+    uint64_t start_ns = bench_now_ns();
+    for (int i = 0; i < BENCH_DOCUMENTS; i++) {
+        values.raw_value = (uint32_t)i;
+        values.timestamp = time(NULL);
+        json_template_render(ctx->tpl, &values, doc, sizeof(doc));
+        BENCH_KEEP(doc[0]);
+    }
+    return bench_now_ns() - start_ns;
+}
+
+static sensor_config_t batch_sensors[BATCH_SENSORS];
+static json_sensor_template_t batch_templates[BATCH_SENSORS];
+static char batch_payload[8192];
+static size_t batch_bytes;
+
+// As create_telemetry_payload() did: render into temp_json, copy into the array
+static uint64_t run_legacy_batch(void *arg)
+{
+    (void)arg;
+    char temp_json[MAX_JSON_PAYLOAD_SIZE];
+    uint64_t start_ns = bench_now_ns();
+    for (int b = 0; b < BENCH_BATCHES; b++) {
+        size_t pos = 0;
+        batch_payload[pos++] = '[';
+        for (int i = 0; i < BATCH_SENSORS; i++) {
+            const sensor_config_t *sensor = &batch_sensors[i];
+            legacy_generate_sensor_json_with_hex(sensor, 100.0 + i * 12.34, (uint32_t)i, NULL, NULL,
+                                                 temp_json, sizeof(temp_json));
+            size_t len = strlen(temp_json);
+            if (i > 0) {
+                batch_payload[pos++] = ',';
+            }
+            memcpy(batch_payload + pos, temp_json, len);
+            pos += len;
+        }
+        batch_payload[pos++] = ']';
+        batch_payload[pos] = '\0';
+        batch_bytes = pos;
+        BENCH_KEEP(batch_payload[0]);
+    }
+    return bench_now_ns() - start_ns;
+}
+
+static uint64_t run_writer_batch(void *arg)
+{
+    (void)arg;
+    uint64_t start_ns = bench_now_ns();
+    for (int b = 0; b < BENCH_BATCHES; b++) {
+        json_writer_t w;
+        json_writer_init(&w, batch_payload, sizeof(batch_payload), NULL, NULL);
+        json_writer_begin_array(&w);
+        for (int i = 0; i < BATCH_SENSORS; i++) {
+            write_sensor_json(&w, &batch_sensors[i], 100.0 + i * 12.34, (uint32_t)i, NULL, NULL);
+        }
+        json_writer_end_array(&w);
+        json_writer_finish(&w);
+        BENCH_KEEP(batch_payload[0]);
+    }
+    return bench_now_ns() - start_ns;
+}
+
+static uint64_t run_template_batch(void *arg)
+{
+    (void)arg;
+    uint64_t start_ns = bench_now_ns();
+    for (int b = 0; b < BENCH_BATCHES; b++) {
+        json_writer_t w;
+        json_writer_init(&w, batch_payload, sizeof(batch_payload), NULL, NULL);
+        json_writer_begin_array(&w);
+        time_t now = time(NULL);
+        for (int i = 0; i < BATCH_SENSORS; i++) {
+            json_template_values_t values = { .value = 100.0 + i * 12.34, .raw_value = (uint32_t)i, .timestamp = now };
+            json_template_write(&w, &batch_templates[i], &values);
+        }
+        json_writer_end_array(&w);
+        json_writer_finish(&w);
+        BENCH_KEEP(batch_payload[0]);
+    }
+    return bench_now_ns() - start_ns;
+}
+
+int main(void)
+{
+    host_log_level = ESP_LOG_NONE;
+
+    printf("{\n  \"benchmark\": \"json_writer\",\n  \"unit\": \"ns_per_document\",\n  \"results\": [\n");
+    for (size_t c = 0; c < CASE_COUNT; c++) {
+        sensor_config_t sensor;
+        json_sensor_template_t tpl;
+        make_sensor(&sensor, (int)c, cases[c].sensor_type);
+        if (json_template_compile(&sensor, &tpl) != ESP_OK) {
+            fprintf(stderr, "%s: template did not compile\n", cases[c].sensor_type);
+            return 1;
+        }
+        doc_ctx_t ctx = { &sensor, &tpl, cases[c].value, cases[c].hex };
+        char doc[MAX_JSON_PAYLOAD_SIZE];
+        generate_sensor_json_with_hex(&sensor, ctx.value, 0, ctx.hex, NULL, doc, sizeof(doc));
+
+        double legacy_ns = best_ns_per(run_legacy_doc, &ctx, BENCH_DOCUMENTS);
+        double writer_ns = best_ns_per(run_writer_doc, &ctx, BENCH_DOCUMENTS);
+        double template_ns = best_ns_per(run_template_doc, &ctx, BENCH_DOCUMENTS);
+        printf("    {\"case\": \"%s\", \"bytes\": %zu, \"snprintf\": %.0f, \"writer\": %.0f, \"template\": %.0f, "
+               "\"writer_speedup\": %.2f, \"template_speedup\": %.2f},\n",
+               get_json_template_name(get_json_type_from_sensor_type(cases[c].sensor_type)), strlen(doc),
+               legacy_ns, writer_ns, template_ns, legacy_ns / writer_ns, legacy_ns / template_ns);
+    }
+
+    for (int i = 0; i < BATCH_SENSORS; i++) {
+        make_sensor(&batch_sensors[i], i, cases[i % CASE_COUNT].sensor_type);
+        json_template_compile(&batch_sensors[i], &batch_templates[i]);
+    }
+    double legacy_ns = best_ns_per(run_legacy_batch, NULL, BENCH_BATCHES);
+    double writer_ns = best_ns_per(run_writer_batch, NULL, BENCH_BATCHES);
+    double template_ns = best_ns_per(run_template_batch, NULL, BENCH_BATCHES);
+    printf("    {\"case\": \"batch_%d\", \"bytes\": %zu, \"snprintf\": %.0f, \"writer\": %.0f, \"template\": %.0f, "
+           "\"writer_speedup\": %.2f, \"template_speedup\": %.2f}\n",
+           BATCH_SENSORS, batch_bytes, legacy_ns, writer_ns, template_ns, legacy_ns / writer_ns,
+           legacy_ns / template_ns);
+    printf("  ]\n}\n");
+    return 0;
+}
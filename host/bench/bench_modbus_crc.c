@@ -0,0 +1,76 @@
+// bench_modbus_crc.c - Throughput of the CRC-16/MODBUS implementations
+// Times each MODBUS_CRC_IMPL over the frame sizes the gateway handles (an
+// 8-byte request, typical and maximum responses) and byte by byte, the way
+// the frame assembler folds bytes in as they arrive.
+
+#include "bench.h"
+#include "modbus_crc.h"
+#include "modbus_crc_variants.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_BYTES (4u * 1024 * 1024)     // Hashed per round and frame size
+
+static const size_t frame_sizes[] = { 8, 25, 64, 256 };
+#define FRAME_SIZE_COUNT (sizeof(frame_sizes) / sizeof(frame_sizes[0]))
+
+static double time_update(const modbus_crc_variant_t *v, const uint8_t *data, size_t size)
+{
+    size_t frames = BENCH_BYTES / size;
+    uint64_t best_ns = UINT64_MAX;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t start_ns = bench_now_ns();
+        for (size_t i = 0; i < frames; i++) {
+            uint16_t crc = v->update(MODBUS_CRC_INIT, data, size);
+            BENCH_KEEP(crc);
+        }
+        uint64_t elapsed_ns = bench_now_ns() - start_ns;
+        if (elapsed_ns < best_ns) {
+            best_ns = elapsed_ns;
+        }
+    }
+    return (double)best_ns / (double)(frames * size);
+}
+
+static double time_update_byte(const modbus_crc_variant_t *v, const uint8_t *data, size_t size)
+{
+    size_t frames = BENCH_BYTES / size;
+    uint64_t best_ns = UINT64_MAX;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t start_ns = bench_now_ns();
+        for (size_t i = 0; i < frames; i++) {
+            uint16_t crc = MODBUS_CRC_INIT;
+            for (size_t j = 0; j < size; j++) {
+                crc = v->update_byte(crc, data[j]);
+            }
+            BENCH_KEEP(crc);
+        }
+        uint64_t elapsed_ns = bench_now_ns() - start_ns;
+        if (elapsed_ns < best_ns) {
+            best_ns = elapsed_ns;
+        }
+    }
+    return (double)best_ns / (double)(frames * size);
+}
+
+int main(void)
+{
+    uint8_t data[256];
+    srand(1);
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)rand();
+    }
+
+    printf("{\n  \"benchmark\": \"modbus_crc\",\n  \"unit\": \"ns_per_byte\",\n  \"results\": [\n");
+    for (size_t k = 0; k < MODBUS_CRC_VARIANT_COUNT; k++) {
+        const modbus_crc_variant_t *v = &modbus_crc_variants[k];
+        printf("    {\"impl\": \"%s\"", v->name);
+        for (size_t s = 0; s < FRAME_SIZE_COUNT; s++) {
+            printf(", \"frame_%zu\": %.3f", frame_sizes[s], time_update(v, data, frame_sizes[s]));
+        }
+        printf(", \"byte_at_a_time\": %.3f}%s\n", time_update_byte(v, data, 256),
+               k + 1 < MODBUS_CRC_VARIANT_COUNT ? "," : "");
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
@@ -0,0 +1,373 @@
+// bench_poll_cycle.c - Whole poll cycles and telemetry builds against budgets
+// The sensor manager, poll planner, bus task and JSON templates run unchanged
+// on simulated slaves (modbus_port_sim), in FreeRTOS tasks with the firmware's
+// stack sizes. Each site profile polls its sensors for a number of cycles,
+// then builds the telemetry payload from the readings as telemetry_task does,
+// and reports what /api/poll_profile reports on the device: cycle time, bus
+// utilisation, per-stage times, minimum free heap and stack high-water marks.
+//
+// Times on the line are simulated (see modbus_port_sim.h), CPU stages are
+// timed for real on the host. Stack figures are glibc/x86_64 ones and only
+// comparable between runs of this bench. Exits 1 when a profile misses a budget.
+
+#include "bench.h"
+#include "modbus.h"
+#include "modbus_bus.h"
+#include "modbus_port_sim.h"
+#include "modbus_sim.h"
+#include "sensor_manager.h"
+#include "sensor_decoder.h"
+#include "json_templates.h"
+#include "poll_profile.h"
+#include "web_config.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WARMUP_CYCLES 4                    // Adaptive timeouts settle first
+#define MEASURED_CYCLES 50
+#define TELEMETRY_BUILDS 200
+#define TASK_STACK_SIZE 8192               // modbus_task / telemetry_task in main.c
+#define PAYLOAD_SIZE 4096                  // TELEMETRY_MAX_MESSAGE_SIZE
+#define STACK_MARGIN_BYTES 512             // Least free stack left to a task
+
+typedef struct {
+    const char *name;
+    int sensors;
+    int quality_sensors;                   // Of 8 sub-sensors each, in place of plain sensors
+    bool mixed_baud;
+    uint16_t timeout_permille;
+    uint32_t cycle_budget_ms;              // Average simulated cycle
+} site_profile_t;
+
+// Cycle budgets sit about a quarter above the averages measured when they
+// were set; the simulator seed is fixed, so only a slower poll path fails them
+static const site_profile_t profiles[] = {
+    { "sensors_1", 1, 0, false, 0, 40 },
+    { "sensors_5", 5, 0, false, 0, 150 },
+    { "sensors_20", 20, 0, false, 0, 630 },
+    { "quality_4x8", 0, 4, false, 0, 285 },
+    { "mixed_baud_20", 20, 0, true, 0, 850 },
+    { "timeouts_5pct_20", 20, 0, false, 50, 670 },
+};
+#define PROFILE_COUNT (sizeof(profiles) / sizeof(profiles[0]))
+
+typedef struct {
+    uint64_t wall_ns;
+    int64_t simulated_us;
+    int valid_readings;
+    int json_bytes;
+} profile_run_t;
+
+static const modbus_line_config_t lines[] = {
+    { 9600, 'N', 1 }, { 19200, 'E', 1 }, { 4800, 'N', 1 }, { 38400, 'O', 1 },
+};
+
+static const char *const sensor_types[] = { "Flow-Meter", "Level", "ENERGY", "RAINGAUGE", "BOREWELL" };
+static const char *const quality_keys[] = { "pH", "TDS", "Temp", "HUMIDITY", "TSS", "BOD", "COD", "Temp" };
+
+static system_config_t s_config;
+static modbus_sim_t s_sim;
+static profile_run_t s_run;
+static sensor_reading_t s_readings[20];
+static char s_payload[PAYLOAD_SIZE];
+static SemaphoreHandle_t s_poll_start;
+static SemaphoreHandle_t s_telemetry_start;
+static SemaphoreHandle_t s_done;
+
+// web_config.c is not part of the host build
+system_config_t *get_system_config(void)
+{
+    return &s_config;
+}
+
+static const char *parity_name(char parity)
+{
+    return parity == 'E' ? "even" : parity == 'O' ? "odd" : "none";
+}
+
+static modbus_sim_slave_t *profile_slave(int slave_id, const modbus_line_config_t *line)
+{
+    modbus_sim_slave_t *slave = modbus_sim_find(&s_sim, (uint8_t)slave_id);
+    if (!slave) {
+        slave = modbus_sim_add_slave(&s_sim, (uint8_t)slave_id);
+        slave->turnaround_us = 8000;
+        slave->jitter_us = 4000;
+        slave->line = *line;
+    }
+    return slave;
+}
+
+// Two sensors per slave, ten registers apart, so the planner coalesces pairs
+static void add_plain_sensor(const site_profile_t *profile, int index)
+{
+    sensor_config_t *sensor = &s_config.sensors[index];
+    const char *type = sensor_types[index % 5];
+    const modbus_line_config_t *line = &lines[profile->mixed_baud ? (index / 2) % 4 : 0];
+    uint16_t address = (uint16_t)((index % 2) * 10);
+
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->enabled = true;
+    snprintf(sensor->name, sizeof(sensor->name), "Sensor %d", index + 1);
+    snprintf(sensor->unit_id, sizeof(sensor->unit_id), "FG247%03d", index);
+    sensor->slave_id = 1 + index / 2;
+    sensor->baud_rate = line->baud_rate;
+    strcpy(sensor->parity, parity_name(line->parity));
+    sensor->register_address = address;
+    strcpy(sensor->register_type, "HOLDING");
+    strcpy(sensor->sensor_type, type);
+    strcpy(sensor->byte_order, "BIG_ENDIAN");
+    sensor->scale_factor = 1.0f;
+
+    modbus_sim_slave_t *slave = profile_slave(sensor->slave_id, line);
+    slave->timeout_permille = profile->timeout_permille;
+    if (strcmp(type, "Flow-Meter") == 0) {
+        sensor->quantity = 4;
+        strcpy(sensor->data_type, "UINT32_3412");
+        modbus_sim_put_flow_meter(slave, MODBUS_SIM_HOLDING, address, 123456.789 + index);
+    } else if (strcmp(type, "Level") == 0) {
+        sensor->quantity = 1;
+        strcpy(sensor->data_type, "UINT16");
+        sensor->scale_factor = 0.01f;
+        sensor->sensor_height = 500.0f;
+        sensor->max_water_level = 400.0f;
+        modbus_sim_put_u16(slave, MODBUS_SIM_HOLDING, address, (uint16_t)(21000 + index));
+    } else if (strcmp(type, "ENERGY") == 0) {
+        sensor->quantity = 2;
+        strcpy(sensor->data_type, "UINT32_1234");
+        modbus_sim_put_bytes(slave, MODBUS_SIM_HOLDING, address, 17234500u + (uint32_t)index, 4, "ABCD");
+    } else if (strcmp(type, "RAINGAUGE") == 0) {
+        sensor->quantity = 1;
+        strcpy(sensor->data_type, "UINT16");
+        sensor->scale_factor = 0.1f;
+        modbus_sim_put_u16(slave, MODBUS_SIM_HOLDING, address, (uint16_t)(1234 + index));
+    } else {
+        sensor->quantity = 2;
+        strcpy(sensor->data_type, "FLOAT32_1234");
+        modbus_sim_put_float32(slave, MODBUS_SIM_HOLDING, address, 24.1968355f + (float)index, "ABCD");
+    }
+}
+
+// A probe per slave, its eight parameters in consecutive FLOAT32 registers
+static void add_quality_sensor(const site_profile_t *profile, int index)
+{
+    sensor_config_t *sensor = &s_config.sensors[index];
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->enabled = true;
+    snprintf(sensor->name, sizeof(sensor->name), "Quality %d", index + 1);
+    snprintf(sensor->unit_id, sizeof(sensor->unit_id), "TFG2235Q%d", index);
+    sensor->slave_id = 40 + index;
+    sensor->baud_rate = 9600;
+    strcpy(sensor->parity, "none");
+    strcpy(sensor->sensor_type, "QUALITY");
+    sensor->scale_factor = 1.0f;
+
+    modbus_sim_slave_t *slave = profile_slave(sensor->slave_id, &lines[0]);
+    slave->timeout_permille = profile->timeout_permille;
+    sensor->sub_sensor_count = 8;
+    for (int k = 0; k < 8; k++) {
+        sub_sensor_t *sub = &sensor->sub_sensors[k];
+        sub->enabled = true;
+        snprintf(sub->parameter_name, sizeof(sub->parameter_name), "Parameter %d", k + 1);
+        strcpy(sub->json_key, quality_keys[k]);
+        sub->slave_id = sensor->slave_id;
+        sub->register_address = 100 + 2 * k;
+        sub->quantity = 2;
+        strcpy(sub->data_type, "FLOAT32_1234");
+        strcpy(sub->register_type, "HOLDING");
+        sub->scale_factor = 1.0f;
+        strcpy(sub->byte_order, "BIG_ENDIAN");
+        modbus_sim_put_float32(slave, MODBUS_SIM_HOLDING, (uint16_t)sub->register_address,
+                               7.0f + (float)k * 3.5f, "ABCD");
+    }
+}
+
+static void profile_setup(const site_profile_t *profile)
+{
+    memset(&s_config, 0, sizeof(s_config));
+    modbus_sim_init(&s_sim, 22);
+    modbus_port_sim_attach(&s_sim);
+    int count = profile->quality_sensors ? profile->quality_sensors : profile->sensors;
+    for (int i = 0; i < count; i++) {
+        if (profile->quality_sensors) {
+            add_quality_sensor(profile, i);
+        } else {
+            add_plain_sensor(profile, i);
+        }
+    }
+    s_config.sensor_count = count;
+    sensor_decoder_config_changed(&s_config);
+    json_templates_config_changed(&s_config);
+}
+
+// The tasks live for the whole run, as on the device, so their stack
+// high-water marks and the minimum free heap are since start like there
+static void poll_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        xSemaphoreTake(s_poll_start, portMAX_DELAY);
+        int count = 0;
+        for (int c = 0; c < WARMUP_CYCLES; c++) {
+            sensor_read_all_configured(s_readings, 20, &count);
+        }
+        poll_profile_reset();
+        modbus_port_sim_reset_stats();
+
+        int64_t start_us = modbus_port_now_us();
+        uint64_t start_ns = bench_now_ns();
+        for (int c = 0; c < MEASURED_CYCLES; c++) {
+            sensor_read_all_configured(s_readings, 20, &count);
+        }
+        s_run.wall_ns = bench_now_ns() - start_ns;
+        s_run.simulated_us = modbus_port_now_us() - start_us;
+        s_run.valid_readings = count;
+        xSemaphoreGive(s_done);
+    }
+}
+
+// As publish_telemetry_message() does: every valid reading into one JSON
+// array, from its compiled template or field by field
+static void telemetry_build(void)
+{
+    for (int b = 0; b < TELEMETRY_BUILDS; b++) {
+        int64_t json_start_us = esp_timer_get_time();
+        json_writer_t w;
+        json_writer_init(&w, s_payload, sizeof(s_payload), NULL, NULL);
+        json_writer_begin_array(&w);
+        int sensors = 0;
+        for (int i = 0; i < s_run.valid_readings; i++) {
+            const sensor_reading_t *reading = &s_readings[i];
+            int index = -1;
+            for (int j = 0; j < s_config.sensor_count; j++) {
+                if (strcmp(s_config.sensors[j].unit_id, reading->unit_id) == 0) {
+                    index = j;
+                    break;
+                }
+            }
+            if (!reading->valid || index < 0) {
+                continue;
+            }
+            const sensor_config_t *sensor = &s_config.sensors[index];
+            const char *hex = NULL;
+            uint32_t raw_value = reading->raw_value ? reading->raw_value : (uint32_t)(reading->value * 10000);
+            if (strcmp(sensor->sensor_type, "ENERGY") == 0 && reading->raw_hex[0]) {
+                hex = reading->raw_hex;
+            }
+            const json_sensor_template_t *tpl = json_template_lookup(&s_config, index);
+            json_template_values_t values = {
+                .value = reading->value, .raw_value = raw_value, .hex_string = hex, .timestamp = time(NULL),
+            };
+            esp_err_t ret = (tpl && tpl->status == ESP_OK) ? json_template_write(&w, tpl, &values) :
+                            write_sensor_json(&w, sensor, reading->value, raw_value, hex, NULL);
+            if (ret == ESP_OK) {
+                sensors++;
+            }
+        }
+        json_writer_end_array(&w);
+        json_writer_finish(&w);
+        s_run.json_bytes = (int)w.len;
+        poll_profile_record_json((uint32_t)(esp_timer_get_time() - json_start_us), sensors);
+    }
+}
+
+static void telemetry_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        xSemaphoreTake(s_telemetry_start, portMAX_DELAY);
+        telemetry_build();
+        xSemaphoreGive(s_done);
+    }
+}
+
+static bool run_task(SemaphoreHandle_t start)
+{
+    xSemaphoreGive(start);
+    return xSemaphoreTake(s_done, pdMS_TO_TICKS(600000)) == pdTRUE;
+}
+
+static void print_metric(const char *name, const poll_profile_metric_t *metric, const char *tail)
+{
+    printf("\"%s\": {\"avg_us\": %lu, \"max_us\": %lu}%s", name, (unsigned long)metric->avg_us,
+           (unsigned long)metric->max_us, tail);
+}
+
+int main(void)
+{
+    host_log_level = ESP_LOG_NONE;
+    // As app_main() does before any task starts
+    setenv("TZ", "IST-5:30", 1);
+    tzset();
+
+    s_poll_start = xSemaphoreCreateBinary();
+    s_telemetry_start = xSemaphoreCreateBinary();
+    s_done = xSemaphoreCreateBinary();
+    modbus_set_port(&modbus_port_sim);
+    if (modbus_init() != ESP_OK || modbus_bus_start() != ESP_OK || sensor_manager_init() != ESP_OK ||
+        xTaskCreate(poll_task, "modbus_task", TASK_STACK_SIZE, NULL, 5, NULL) != pdPASS ||
+        xTaskCreate(telemetry_task, "telemetry_task", TASK_STACK_SIZE, NULL, 5, NULL) != pdPASS) {
+        fprintf(stderr, "gateway did not start\n");
+        return 1;
+    }
+
+    bool all_ok = true;
+    printf("{\n  \"benchmark\": \"poll_cycle\",\n  \"cycles\": %d,\n  \"telemetry_builds\": %d,\n  \"results\": [\n",
+           MEASURED_CYCLES, TELEMETRY_BUILDS);
+    for (size_t p = 0; p < PROFILE_COUNT; p++) {
+        const site_profile_t *profile = &profiles[p];
+        memset(&s_run, 0, sizeof(s_run));
+        profile_setup(profile);
+        if (!run_task(s_poll_start) || !run_task(s_telemetry_start)) {
+            fprintf(stderr, "%s: task did not finish\n", profile->name);
+            return 1;
+        }
+
+        poll_profile_t prof;
+        poll_profile_get(&prof);
+        modbus_port_sim_stats_t line;
+        modbus_port_sim_get_stats(&line);
+        double cycle_ms = (double)s_run.simulated_us / MEASURED_CYCLES / 1000.0;
+        double bus_pct = s_run.simulated_us > 0 ? 100.0 * (double)line.busy_us / (double)s_run.simulated_us : 0.0;
+
+        bool cycle_ok = cycle_ms <= profile->cycle_budget_ms && prof.cycles_over_budget == 0;
+        bool decode_ok = prof.decode_over_budget == 0;
+        bool json_ok = prof.json_over_budget == 0;
+        bool stack_ok = prof.poll_stack_free >= STACK_MARGIN_BYTES && prof.telemetry_stack_free >= STACK_MARGIN_BYTES;
+        bool ok = cycle_ok && decode_ok && json_ok && stack_ok;
+        all_ok = all_ok && ok;
+
+        printf("    {\"profile\": \"%s\", \"sensors\": %d, \"valid_readings\": %d, \"transactions\": %d,\n",
+               profile->name, s_config.sensor_count, s_run.valid_readings, prof.transactions);
+        printf("     \"cycle_ms\": %.1f, \"cycle_budget_ms\": %lu, \"cycle_max_us\": %lu, "
+               "\"host_cpu_us_per_cycle\": %.1f,\n",
+               cycle_ms, (unsigned long)profile->cycle_budget_ms, (unsigned long)prof.cycle.max_us,
+               (double)s_run.wall_ns / MEASURED_CYCLES / 1000.0);
+        printf("     \"bus_utilisation_pct\": %.1f, \"bytes_sent\": %lu, \"bytes_received\": %lu, "
+               "\"json_bytes\": %d,\n",
+               bus_pct, (unsigned long)line.bytes_sent, (unsigned long)line.bytes_received, s_run.json_bytes);
+        printf("     \"stages\": {");
+        print_metric("encode", &prof.stages[POLL_STAGE_ENCODE], ", ");
+        print_metric("tx", &prof.stages[POLL_STAGE_TX], ", ");
+        print_metric("wait", &prof.stages[POLL_STAGE_WAIT], ",\n                ");
+        print_metric("decode", &prof.stages[POLL_STAGE_DECODE], ", ");
+        print_metric("json", &prof.stages[POLL_STAGE_JSON], "},\n");
+        printf("     \"min_free_heap\": %lu, \"poll_stack_free\": %lu, \"telemetry_stack_free\": %lu,\n",
+               (unsigned long)prof.min_free_heap, (unsigned long)prof.poll_stack_free,
+               (unsigned long)prof.telemetry_stack_free);
+        printf("     \"over_budget\": {\"cycles\": %lu, \"decode\": %lu, \"json\": %lu},\n",
+               (unsigned long)prof.cycles_over_budget, (unsigned long)prof.decode_over_budget,
+               (unsigned long)prof.json_over_budget);
+        printf("     \"ok\": {\"cycle\": %s, \"decode\": %s, \"json\": %s, \"stack\": %s}}%s\n",
+               cycle_ok ? "true" : "false", decode_ok ? "true" : "false", json_ok ? "true" : "false",
+               stack_ok ? "true" : "false", p + 1 < PROFILE_COUNT ? "," : "");
+    }
+    printf("  ],\n  \"ok\": %s\n}\n", all_ok ? "true" : "false");
+    return all_ok ? 0 : 1;
+}
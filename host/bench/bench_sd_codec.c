@@ -0,0 +1,123 @@
+// bench_sd_codec.c - Size and speed of the cached-message encoding
+// For each payload kind: the encoded body against the text record that
+// earlier firmware stored ("timestamp\0topic\0payload"), and the time to
+// encode and decode one message.
+
+#include "bench.h"
+#include "sd_codec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_MESSAGES 20000               // Per timed round
+#define BENCH_TOPIC "devices/gateway-0042/messages/events/"
+#define BENCH_TIMESTAMP "2025-11-24T12:05:05Z"
+
+static const char quality[] =
+    "{\"params_data\":{\"pH\":7.12,\"TDS\":182.40,\"Temp\":27.31,\"HUMIDITY\":61.00,\"TSS\":12.55,"
+    "\"BOD\":4.80,\"COD\":9.10},\"type\":\"QUALITY\",\"created_on\":\"2025-11-24T12:05:05Z\","
+    "\"unit_id\":\"WQ0101\"}";
+static const char flow[] =
+    "[{\"unit_id\":\"FG24708F\",\"type\":\"FLOW\",\"consumption\":\"265.23\","
+    "\"created_on\":\"2025-11-24T12:05:05Z\"},{\"unit_id\":\"FG24708G\",\"type\":\"FLOW\","
+    "\"consumption\":\"1287.00\",\"created_on\":\"2025-11-24T12:05:05Z\"}]";
+static const char energy[] =
+    "{\"ene_con_hex\":\"0001A2F3\",\"type\":\"ENERGY\",\"created_on_epoch\":1764000000,"
+    "\"slave_id\":3,\"meter\":\"energy\"}";
+
+typedef struct {
+    const char *name;
+    char payload[SD_CODEC_MAX_PAYLOAD + 1];
+} payload_case_t;
+
+static payload_case_t cases[6];
+#define CASE_COUNT (sizeof(cases) / sizeof(cases[0]))
+
+static void build_cases(void)
+{
+    cases[0].name = "quality";
+    strcpy(cases[0].payload, quality);
+    cases[1].name = "flow_2";
+    strcpy(cases[1].payload, flow);
+    cases[2].name = "energy";
+    strcpy(cases[2].payload, energy);
+
+    // A batch of flow objects up to the size limit
+    cases[3].name = "flow_max";
+    size_t length = 0;
+    for (int unit = 0; length + 100 < SD_CODEC_MAX_PAYLOAD; unit++) {
+        length += (size_t)snprintf(cases[3].payload + length, SD_CODEC_MAX_PAYLOAD + 1 - length,
+                                   "%s{\"unit_id\":\"FG247%03d\",\"type\":\"FLOW\",\"consumption\":\"%d.%02d\","
+                                   "\"created_on\":\"2025-11-24T12:05:05Z\"}",
+                                   unit ? "," : "[", unit, 100 + unit * 37, unit * 13 % 100);
+    }
+    strcat(cases[3].payload, "]");
+
+    cases[4].name = "incompressible";
+    srand(3);
+    for (size_t i = 0; i < SD_CODEC_MAX_PAYLOAD; i++) {
+        cases[4].payload[i] = (char)(1 + rand() % 255);
+    }
+    cases[4].payload[SD_CODEC_MAX_PAYLOAD] = '\0';
+
+    cases[5].name = "repeated_run";
+    memset(cases[5].payload, '0', SD_CODEC_MAX_PAYLOAD);
+    cases[5].payload[SD_CODEC_MAX_PAYLOAD] = '\0';
+}
+
+int main(void)
+{
+    build_cases();
+
+    printf("{\n  \"benchmark\": \"sd_codec\",\n  \"unit\": \"ns_per_message\",\n  \"results\": [\n");
+    for (size_t c = 0; c < CASE_COUNT; c++) {
+        const char *payload = cases[c].payload;
+        uint8_t body[SD_CODEC_MAX_PAYLOAD + 64];
+        size_t length = 0;
+        if (sd_codec_encode(0, BENCH_TIMESTAMP, payload, body, sizeof(body), &length) != ESP_OK) {
+            fprintf(stderr, "%s: encode failed\n", cases[c].name);
+            return 1;
+        }
+        size_t text_length = sizeof(BENCH_TIMESTAMP) + sizeof(BENCH_TOPIC) + strlen(payload);
+
+        uint64_t best_encode_ns = UINT64_MAX;
+        uint64_t best_decode_ns = UINT64_MAX;
+        for (int round = 0; round < BENCH_ROUNDS; round++) {
+            uint64_t start_ns = bench_now_ns();
+            for (int i = 0; i < BENCH_MESSAGES; i++) {
+                size_t n;
+                sd_codec_encode(0, BENCH_TIMESTAMP, payload, body, sizeof(body), &n);
+                BENCH_KEEP(n);
+            }
+            uint64_t elapsed_ns = bench_now_ns() - start_ns;
+            if (elapsed_ns < best_encode_ns) {
+                best_encode_ns = elapsed_ns;
+            }
+
+            uint8_t topic;
+            char timestamp[32];
+            char decoded[SD_CODEC_MAX_PAYLOAD + 1];
+            start_ns = bench_now_ns();
+            for (int i = 0; i < BENCH_MESSAGES; i++) {
+                sd_codec_decode(body, length, &topic, timestamp, sizeof(timestamp), decoded, sizeof(decoded));
+                BENCH_KEEP(decoded[0]);
+            }
+            elapsed_ns = bench_now_ns() - start_ns;
+            if (elapsed_ns < best_decode_ns) {
+                best_decode_ns = elapsed_ns;
+            }
+        }
+
+        double encode_ns = (double)best_encode_ns / BENCH_MESSAGES;
+        double decode_ns = (double)best_decode_ns / BENCH_MESSAGES;
+        printf("    {\"payload\": \"%s\", \"payload_bytes\": %zu, \"text_record_bytes\": %zu, "
+               "\"encoded_bytes\": %zu, \"ratio\": %.3f, \"stored\": %s, \"encode\": %.0f, \"decode\": %.0f, "
+               "\"encode_mb_s\": %.1f, \"decode_mb_s\": %.1f}%s\n",
+               cases[c].name, strlen(payload), text_length, length, (double)length / (double)text_length,
+               (body[1] & SD_CODEC_FLAG_STORED) ? "true" : "false", encode_ns, decode_ns,
+               strlen(payload) / encode_ns * 1e9 / (1024.0 * 1024.0),
+               strlen(payload) / decode_ns * 1e9 / (1024.0 * 1024.0), c + 1 < CASE_COUNT ? "," : "");
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
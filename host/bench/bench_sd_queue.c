@@ -0,0 +1,173 @@
+// bench_sd_queue.c - Append and drain throughput of the store-and-forward queue
+// Fills a queue under each sync policy with telemetry-sized and maximum-size
+// records, then drains it the way the uploader does: peek and ack one by one,
+// or read ahead with sd_queue_read_next() and ack behind. The queue lives in a
+// fresh directory under /tmp, or under the directory given as the first
+// argument (e.g. a mounted SD card in a card reader).
+
+#include "bench.h"
+#include "sd_queue.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#define BENCH_QUEUE_BYTES (1024u * 1024)   // Appended per run
+
+static const struct {
+    const char *name;
+    sd_queue_sync_t sync;
+} policies[] = {
+    { "record", SD_QUEUE_SYNC_RECORD },
+    { "periodic", SD_QUEUE_SYNC_PERIODIC },
+    { "batch", SD_QUEUE_SYNC_BATCH },
+};
+#define POLICY_COUNT (sizeof(policies) / sizeof(policies[0]))
+
+static const uint16_t record_sizes[] = { 300, SD_QUEUE_MAX_RECORD };
+#define RECORD_SIZE_COUNT (sizeof(record_sizes) / sizeof(record_sizes[0]))
+
+static void remove_dir(const char *dir)
+{
+    DIR *dp = opendir(dir);
+    if (!dp) {
+        return;
+    }
+    struct dirent *entry;
+    char path[512];
+    while ((entry = readdir(dp)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dp);
+    rmdir(dir);
+}
+
+typedef struct {
+    double append_mb_s;
+    double append_us;                      // Per record
+    double drain_peek_us;
+    double drain_read_ahead_us;
+} queue_result_t;
+
+static uint64_t fill(sd_queue_t *queue, const uint8_t *body, uint16_t size, uint32_t records)
+{
+    uint64_t start_ns = bench_now_ns();
+    for (uint32_t id = 1; id <= records; id++) {
+        if (sd_queue_append(queue, id, body, size) != ESP_OK) {
+            fprintf(stderr, "append %lu failed\n", (unsigned long)id);
+            exit(1);
+        }
+        sd_queue_flush_due(queue);
+    }
+    sd_queue_flush(queue);
+    return bench_now_ns() - start_ns;
+}
+
+static uint64_t drain_peek(sd_queue_t *queue, uint8_t *body, uint32_t records)
+{
+    uint64_t start_ns = bench_now_ns();
+    for (uint32_t n = 0; n < records; n++) {
+        uint32_t id;
+        uint16_t length;
+        if (sd_queue_peek(queue, &id, body, SD_QUEUE_MAX_RECORD, &length) != ESP_OK ||
+            sd_queue_ack(queue, id) != ESP_OK) {
+            fprintf(stderr, "drain failed after %lu records\n", (unsigned long)n);
+            exit(1);
+        }
+    }
+    return bench_now_ns() - start_ns;
+}
+
+// Batches of ten in flight, as the publisher keeps them
+static uint64_t drain_read_ahead(sd_queue_t *queue, uint8_t *body, uint32_t records)
+{
+    uint32_t ids[10];
+    uint64_t start_ns = bench_now_ns();
+    sd_queue_rewind(queue);
+    for (uint32_t done = 0; done < records;) {
+        int batch = 0;
+        uint16_t length;
+        while (batch < 10 && sd_queue_read_next(queue, &ids[batch], body, SD_QUEUE_MAX_RECORD, &length) == ESP_OK) {
+            batch++;
+        }
+        if (batch == 0) {
+            fprintf(stderr, "read-ahead drain stopped after %lu records\n", (unsigned long)done);
+            exit(1);
+        }
+        for (int i = 0; i < batch; i++) {
+            sd_queue_ack(queue, ids[i]);
+        }
+        done += (uint32_t)batch;
+    }
+    return bench_now_ns() - start_ns;
+}
+
+static queue_result_t run(const char *parent, sd_queue_sync_t sync, uint16_t size)
+{
+    uint8_t body[SD_QUEUE_MAX_RECORD];
+    for (size_t i = 0; i < sizeof(body); i++) {
+        body[i] = (uint8_t)(i * 31 + 7);
+    }
+    uint32_t records = BENCH_QUEUE_BYTES / (SD_QUEUE_HEADER_SIZE + size);
+
+    char dir[SD_QUEUE_PATH_MAX - 16];
+    snprintf(dir, sizeof(dir), "%s/sdqb_XXXXXX", parent);
+    if (!mkdtemp(dir)) {
+        perror(dir);
+        exit(1);
+    }
+
+    queue_result_t result = {0};
+    uint64_t best_append_ns = UINT64_MAX, best_peek_ns = UINT64_MAX, best_ahead_ns = UINT64_MAX;
+    sd_queue_t queue;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        if (sd_queue_open(&queue, dir) != ESP_OK) {
+            fprintf(stderr, "cannot open a queue in %s\n", dir);
+            exit(1);
+        }
+        sd_queue_set_sync(&queue, sync, 1000);
+
+        uint64_t ns = fill(&queue, body, size, records);
+        if (ns < best_append_ns) best_append_ns = ns;
+        ns = drain_peek(&queue, body, records);
+        if (ns < best_peek_ns) best_peek_ns = ns;
+
+        fill(&queue, body, size, records);
+        ns = drain_read_ahead(&queue, body, records);
+        if (ns < best_ahead_ns) best_ahead_ns = ns;
+        sd_queue_clear(&queue);
+        sd_queue_close(&queue);
+    }
+    remove_dir(dir);
+
+    result.append_us = (double)best_append_ns / 1000.0 / records;
+    result.append_mb_s = (double)records * size / ((double)best_append_ns / 1e9) / (1024.0 * 1024.0);
+    result.drain_peek_us = (double)best_peek_ns / 1000.0 / records;
+    result.drain_read_ahead_us = (double)best_ahead_ns / 1000.0 / records;
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    const char *parent = argc > 1 ? argv[1] : "/tmp";
+    host_log_level = ESP_LOG_ERROR;        // Every fresh queue logs an index rebuild
+
+    printf("{\n  \"benchmark\": \"sd_queue\",\n  \"unit\": \"us_per_record\",\n  \"bytes_per_run\": %u,\n"
+           "  \"results\": [\n", BENCH_QUEUE_BYTES);
+    for (size_t p = 0; p < POLICY_COUNT; p++) {
+        for (size_t s = 0; s < RECORD_SIZE_COUNT; s++) {
+            queue_result_t r = run(parent, policies[p].sync, record_sizes[s]);
+            printf("    {\"sync\": \"%s\", \"record_bytes\": %u, \"append\": %.2f, \"append_mb_s\": %.1f, "
+                   "\"drain_peek\": %.2f, \"drain_read_ahead\": %.2f}%s\n",
+                   policies[p].name, record_sizes[s], r.append_us, r.append_mb_s, r.drain_peek_us,
+                   r.drain_read_ahead_us, p + 1 < POLICY_COUNT || s + 1 < RECORD_SIZE_COUNT ? "," : "");
+        }
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
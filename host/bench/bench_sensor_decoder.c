@@ -0,0 +1,94 @@
+// bench_sensor_decoder.c - Interpreted vs compiled register decoding
+// Per-reading cost of the legacy strstr/strcmp decoder and of a precompiled
+// sensor_decoder_t for the formats in the field, plus the one-off compile
+// cost. Logging is off for both paths, so the legacy numbers exclude the
+// ESP_LOGI formatting it did on every reading on the device.
+
+#include "bench.h"
+#include "sensor_decoder.h"
+#include "legacy_sensor_decoder.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_DECODES 200000
+
+typedef struct {
+    const char *name;
+    const char *sensor_type;
+    const char *data_type;
+    const char *byte_order;
+    uint16_t registers[4];
+} bench_format_t;
+
+static const bench_format_t formats[] = {
+    { "uint16", "Level", "UINT16", "BIG_ENDIAN", { 0x1234 } },
+    { "int32_3412", "ENERGY", "INT32_3412", "BIG_ENDIAN", { 0x5678, 0x1234 } },
+    { "float32_1234", "ENERGY", "FLOAT32_1234", "BIG_ENDIAN", { 0x4148, 0x0000 } },
+    { "uint32_mixed_badc", "ENERGY", "UINT32", "MIXED_BADC", { 0x3412, 0x7856 } },
+    { "float64_78563412", "ENERGY", "FLOAT64_78563412", "BIG_ENDIAN", { 0x0000, 0x0000, 0x004A, 0x9340 } },
+    { "flow_meter", "Flow-Meter", "UINT32", "BIG_ENDIAN", { 0x8131, 0x0000, 0x70A4, 0x3F5D } },
+    { "panda_usm", "Panda_USM", "FLOAT64_12345678", "BIG_ENDIAN", { 0x4093, 0x4A00, 0x0000, 0x0000 } },
+};
+#define FORMAT_COUNT (sizeof(formats) / sizeof(formats[0]))
+
+static void bench_sensor(const bench_format_t *f, sensor_config_t *sensor)
+{
+    memset(sensor, 0, sizeof(*sensor));
+    strcpy(sensor->sensor_type, f->sensor_type);
+    strcpy(sensor->data_type, f->data_type);
+    strcpy(sensor->byte_order, f->byte_order);
+    sensor->scale_factor = 0.01f;
+    sensor->quantity = 4;
+}
+
+static double best_ns_per_decode(int which, const sensor_config_t *sensor, const uint16_t *registers)
+{
+    sensor_decoder_t decoder;
+    sensor_decoder_compile(sensor, &decoder);
+    uint64_t best_ns = UINT64_MAX;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t start_ns = bench_now_ns();
+        for (int i = 0; i < BENCH_DECODES; i++) {
+            double value = 0;
+            uint32_t raw = 0;
+            if (which == 0) {
+                sensor_test_result_t result;
+                legacy_sensor_decode_registers(sensor, registers, 4, &result);
+                value = result.scaled_value;
+            } else if (which == 1) {
+                sensor_decoder_decode(&decoder, sensor, registers, 4, &value, &raw);
+            } else {
+                sensor_decoder_compile(sensor, &decoder);
+                BENCH_KEEP(decoder.permutation);
+            }
+            BENCH_KEEP(value);
+            BENCH_KEEP(raw);
+        }
+        uint64_t elapsed_ns = bench_now_ns() - start_ns;
+        if (elapsed_ns < best_ns) {
+            best_ns = elapsed_ns;
+        }
+    }
+    return (double)best_ns / BENCH_DECODES;
+}
+
+int main(void)
+{
+    host_log_level = ESP_LOG_NONE;
+
+    printf("{\n  \"benchmark\": \"sensor_decoder\",\n  \"unit\": \"ns_per_reading\",\n  \"results\": [\n");
+    for (size_t i = 0; i < FORMAT_COUNT; i++) {
+        sensor_config_t sensor;
+        bench_sensor(&formats[i], &sensor);
+        double legacy_ns = best_ns_per_decode(0, &sensor, formats[i].registers);
+        double compiled_ns = best_ns_per_decode(1, &sensor, formats[i].registers);
+        double compile_ns = best_ns_per_decode(2, &sensor, formats[i].registers);
+        printf("    {\"format\": \"%s\", \"legacy\": %.1f, \"compiled\": %.1f, \"speedup\": %.1f, \"compile_once\": %.1f}%s\n",
+               formats[i].name, legacy_ns, compiled_ns, legacy_ns / compiled_ns, compile_ns,
+               i + 1 < FORMAT_COUNT ? "," : "");
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
@@ -0,0 +1,121 @@
+// host_serial.c - termios helpers shared by the pty port and the pty simulator
+
+#include "host_serial.h"
+#include <termios.h>
+
+static const struct {
+    int baud_rate;
+    speed_t speed;
+} s_speeds[] = {
+    { 1200, B1200 }, { 2400, B2400 }, { 4800, B4800 }, { 9600, B9600 }, { 19200, B19200 },
+    { 38400, B38400 }, { 57600, B57600 }, { 115200, B115200 },
+};
+
+#define SERIAL_SPEED_COUNT (sizeof(s_speeds) / sizeof(s_speeds[0]))
+
+static esp_err_t host_serial_update(int fd, void (*change)(struct termios *tio, int arg), int arg)
+{
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        return ESP_FAIL;
+    }
+    change(&tio, arg);
+    return tcsetattr(fd, TCSANOW, &tio) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+static void apply_speed(struct termios *tio, int index)
+{
+    cfsetispeed(tio, s_speeds[index].speed);
+    cfsetospeed(tio, s_speeds[index].speed);
+}
+
+static void apply_parity(struct termios *tio, int parity)
+{
+    tio->c_cflag &= ~(tcflag_t)(PARENB | PARODD);
+    if (parity == 'E') {
+        tio->c_cflag |= PARENB;
+    } else if (parity == 'O') {
+        tio->c_cflag |= PARENB | PARODD;
+    }
+}
+
+static void apply_stop_bits(struct termios *tio, int stop_bits)
+{
+    if (stop_bits == 2) {
+        tio->c_cflag |= CSTOPB;
+    } else {
+        tio->c_cflag &= ~(tcflag_t)CSTOPB;
+    }
+}
+
+static void apply_raw(struct termios *tio, int unused)
+{
+    (void)unused;
+    cfmakeraw(tio);
+    tio->c_cflag |= CLOCAL | CREAD;
+    tio->c_cc[VMIN] = 0;
+    tio->c_cc[VTIME] = 0;
+}
+
+esp_err_t host_serial_set_baud_rate(int fd, int baud_rate)
+{
+    for (size_t i = 0; i < SERIAL_SPEED_COUNT; i++) {
+        if (s_speeds[i].baud_rate == baud_rate) {
+            return host_serial_update(fd, apply_speed, (int)i);
+        }
+    }
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t host_serial_set_parity(int fd, char parity)
+{
+    if (parity != 'N' && parity != 'E' && parity != 'O') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return host_serial_update(fd, apply_parity, parity);
+}
+
+esp_err_t host_serial_set_stop_bits(int fd, uint8_t stop_bits)
+{
+    if (stop_bits != 1 && stop_bits != 2) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return host_serial_update(fd, apply_stop_bits, stop_bits);
+}
+
+esp_err_t host_serial_configure(int fd, int baud_rate, char parity, uint8_t stop_bits)
+{
+    esp_err_t ret = host_serial_update(fd, apply_raw, 0);
+    if (ret == ESP_OK) {
+        ret = host_serial_set_baud_rate(fd, baud_rate);
+    }
+    if (ret == ESP_OK) {
+        ret = host_serial_set_parity(fd, parity);
+    }
+    if (ret == ESP_OK) {
+        ret = host_serial_set_stop_bits(fd, stop_bits);
+    }
+    return ret;
+}
+
+void host_serial_get_line(int fd, modbus_line_config_t *line)
+{
+    struct termios tio;
+    line->baud_rate = 0;
+    line->parity = 'N';
+    line->stop_bits = 1;
+    if (tcgetattr(fd, &tio) != 0) {
+        return;
+    }
+
+    speed_t speed = cfgetospeed(&tio);
+    for (size_t i = 0; i < SERIAL_SPEED_COUNT; i++) {
+        if (s_speeds[i].speed == speed) {
+            line->baud_rate = s_speeds[i].baud_rate;
+        }
+    }
+    if (tio.c_cflag & PARENB) {
+        line->parity = (tio.c_cflag & PARODD) ? 'O' : 'E';
+    }
+    line->stop_bits = (tio.c_cflag & CSTOPB) ? 2 : 1;
+}
@@ -0,0 +1,16 @@
+// host_serial.h - termios helpers shared by the pty port and the pty simulator
+
+#ifndef HOST_SERIAL_H
+#define HOST_SERIAL_H
+
+#include "esp_err.h"
+#include "modbus.h"
+
+// Raw 8-bit line at the given settings (parity 'N', 'E' or 'O'; 1 or 2 stop bits)
+esp_err_t host_serial_configure(int fd, int baud_rate, char parity, uint8_t stop_bits);
+esp_err_t host_serial_set_baud_rate(int fd, int baud_rate);
+esp_err_t host_serial_set_parity(int fd, char parity);
+esp_err_t host_serial_set_stop_bits(int fd, uint8_t stop_bits);
+void host_serial_get_line(int fd, modbus_line_config_t *line);
+
+#endif // HOST_SERIAL_H
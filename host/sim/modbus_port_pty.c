@@ -0,0 +1,200 @@
+// modbus_port_pty.c - Modbus port on a POSIX serial device for host builds
+
+#define _GNU_SOURCE
+#include "modbus_port_pty.h"
+#include "host_serial.h"
+#include "modbus.h"
+#include "modbus_frame.h"
+#include "esp_log.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char *TAG = "MODBUS_PTY";
+
+// A pty delivers a write as one burst, so silence after it only has to cover
+// scheduling delays; real tty adapters also get at least the RTU gap
+#define PTY_MIN_GAP_US 2000
+
+static char device_path[64];
+static int fd = -1;
+static int baud_rate = RS485_BAUD_RATE;
+static bool gap_pending = false;           // Bytes returned, line not yet seen idle
+static bool is_pty = false;                // Linux ptys have no parity bit in termios
+
+esp_err_t modbus_port_pty_set_device(const char *path)
+{
+    if (!path || strlen(path) >= sizeof(device_path) || fd >= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    strcpy(device_path, path);
+    return ESP_OK;
+}
+
+static esp_err_t modbus_pty_open(void)
+{
+    if (device_path[0] == '\0') {
+        ESP_LOGE(TAG, "[ERROR] No serial device set");
+        return ESP_ERR_INVALID_STATE;
+    }
+    fd = open(device_path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "[ERROR] Failed to open %s: %s", device_path, strerror(errno));
+        return ESP_FAIL;
+    }
+    baud_rate = RS485_BAUD_RATE;
+    gap_pending = false;
+    is_pty = strncmp(device_path, "/dev/pts/", 9) == 0;
+    return host_serial_configure(fd, RS485_BAUD_RATE, 'N', 1);
+}
+
+static void modbus_pty_close(void)
+{
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    gap_pending = false;
+}
+
+static esp_err_t modbus_pty_set_baud_rate(int new_baud_rate)
+{
+    esp_err_t ret = host_serial_set_baud_rate(fd, new_baud_rate);
+    if (ret == ESP_OK) {
+        baud_rate = new_baud_rate;
+    }
+    return ret;
+}
+
+// A pty rejects PARENB, so there the setting is accepted but not carried to
+// the simulator, which then sees 8N1/8N2
+static esp_err_t modbus_pty_set_parity(char parity)
+{
+    if (is_pty) {
+        return parity == 'N' || parity == 'E' || parity == 'O' ? ESP_OK : ESP_ERR_INVALID_ARG;
+    }
+    return host_serial_set_parity(fd, parity);
+}
+
+static esp_err_t modbus_pty_set_stop_bits(uint8_t stop_bits)
+{
+    return host_serial_set_stop_bits(fd, stop_bits);
+}
+
+static int modbus_pty_write(const uint8_t *data, size_t length)
+{
+    size_t written = 0;
+    while (written < length) {
+        ssize_t n = write(fd, data + written, length - written);
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+            struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+            poll(&pfd, 1, 10);
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        written += (size_t)n;
+    }
+    return (int)written;
+}
+
+static void modbus_pty_wait_tx_done(uint32_t timeout_ms)
+{
+    (void)timeout_ms;
+    tcdrain(fd);
+}
+
+static void modbus_pty_flush_input(void)
+{
+    tcflush(fd, TCIFLUSH);
+    gap_pending = false;
+}
+
+static int64_t modbus_pty_now_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static bool modbus_pty_wait_readable(int64_t timeout_us)
+{
+    int64_t deadline_us = modbus_pty_now_us() + timeout_us;
+    while (1) {
+        int64_t remaining_us = deadline_us - modbus_pty_now_us();
+        if (remaining_us <= 0) {
+            return false;
+        }
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, (int)((remaining_us + 999) / 1000));
+        if (ready > 0) {
+            return true;
+        }
+        if (ready < 0 && errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+// Bytes are returned as soon as they arrive; once the line then stays quiet
+// for the inter-frame gap, the next call reports it
+static int modbus_pty_read(uint8_t *buf, size_t size, int64_t timeout_us, bool *gap)
+{
+    *gap = false;
+    if (fd < 0) {
+        return 0;
+    }
+
+    int64_t wait_us = timeout_us;
+    if (gap_pending) {
+        int64_t gap_us = modbus_frame_gap_us(baud_rate);
+        if (gap_us < PTY_MIN_GAP_US) {
+            gap_us = PTY_MIN_GAP_US;
+        }
+        if (gap_us < wait_us) {
+            wait_us = gap_us;
+        }
+    }
+
+    if (!modbus_pty_wait_readable(wait_us)) {
+        if (gap_pending && wait_us < timeout_us) {
+            gap_pending = false;
+            *gap = true;
+        }
+        return 0;
+    }
+
+    ssize_t n = read(fd, buf, size);
+    if (n <= 0) {
+        return 0;
+    }
+    gap_pending = true;
+    return (int)n;
+}
+
+static void modbus_pty_delay_ms(uint32_t ms)
+{
+    struct timespec delay = { .tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000 };
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR) {
+    }
+}
+
+const modbus_port_t modbus_port_pty = {
+    .name = "pty",
+    .open = modbus_pty_open,
+    .close = modbus_pty_close,
+    .set_baud_rate = modbus_pty_set_baud_rate,
+    .set_parity = modbus_pty_set_parity,
+    .set_stop_bits = modbus_pty_set_stop_bits,
+    .write = modbus_pty_write,
+    .wait_tx_done = modbus_pty_wait_tx_done,
+    .flush_input = modbus_pty_flush_input,
+    .read = modbus_pty_read,
+    .now_us = modbus_pty_now_us,
+    .delay_ms = modbus_pty_delay_ms,
+};
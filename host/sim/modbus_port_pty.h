@@ -0,0 +1,16 @@
+// modbus_port_pty.h - Modbus port on a POSIX serial device for host builds
+// Opens a tty (normally the slave side of modbus_sim_pty) at RS485_BAUD_RATE
+// 8N1 and applies line changes through termios. The clock is CLOCK_MONOTONIC.
+
+#ifndef MODBUS_PORT_PTY_H
+#define MODBUS_PORT_PTY_H
+
+#include "esp_err.h"
+#include "modbus_port.h"
+
+extern const modbus_port_t modbus_port_pty;
+
+// Device opened by the next modbus_init(); only while the port is closed
+esp_err_t modbus_port_pty_set_device(const char *path);
+
+#endif // MODBUS_PORT_PTY_H
@@ -0,0 +1,184 @@
+// modbus_port_sim.c - In-process Modbus port on a simulated line
+
+#include "modbus_port_sim.h"
+#include "modbus_frame.h"
+#include <string.h>
+#include <time.h>
+
+static modbus_sim_t *attached_sim;
+static modbus_line_config_t line = { RS485_BAUD_RATE, 'N', 1 };
+static int64_t clock_skew_us;              // Read by other threads through modbus_port_now_us()
+static modbus_port_sim_stats_t port_stats;
+
+// Response of the current transaction
+static uint8_t response[MODBUS_FRAME_MAX_SIZE];
+static size_t response_length;
+static int64_t tx_done_us;                 // Last request byte left the line
+static int64_t response_done_us;           // Last response byte arrived
+static bool response_delivered;
+static bool gap_reported;
+
+static int64_t monotonic_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static int64_t sim_port_now_us(void)
+{
+    return monotonic_us() + __atomic_load_n(&clock_skew_us, __ATOMIC_RELAXED);
+}
+
+static void sim_port_advance_to(int64_t when_us)
+{
+    int64_t ahead_us = when_us - sim_port_now_us();
+    if (ahead_us > 0) {
+        __atomic_add_fetch(&clock_skew_us, ahead_us, __ATOMIC_RELAXED);
+        port_stats.skipped_us += (uint64_t)ahead_us;
+    }
+}
+
+uint32_t modbus_port_sim_char_us(void)
+{
+    uint32_t bits = 1 + 8 + (line.parity == 'N' ? 0 : 1) + line.stop_bits;
+    return (uint32_t)((bits * 1000000u + (uint32_t)line.baud_rate - 1) / (uint32_t)line.baud_rate);
+}
+
+void modbus_port_sim_attach(modbus_sim_t *sim)
+{
+    attached_sim = sim;
+}
+
+void modbus_port_sim_get_stats(modbus_port_sim_stats_t *stats)
+{
+    *stats = port_stats;
+}
+
+void modbus_port_sim_reset_stats(void)
+{
+    memset(&port_stats, 0, sizeof(port_stats));
+}
+
+static void sim_port_drop_response(void)
+{
+    response_length = 0;
+    response_delivered = false;
+    gap_reported = false;
+}
+
+static esp_err_t sim_port_open(void)
+{
+    line.baud_rate = RS485_BAUD_RATE;
+    line.parity = 'N';
+    line.stop_bits = 1;
+    sim_port_drop_response();
+    return ESP_OK;
+}
+
+static void sim_port_close(void)
+{
+    sim_port_drop_response();
+}
+
+static esp_err_t sim_port_set_baud_rate(int baud_rate)
+{
+    if (baud_rate <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    line.baud_rate = baud_rate;
+    return ESP_OK;
+}
+
+static esp_err_t sim_port_set_parity(char parity)
+{
+    line.parity = parity;
+    return ESP_OK;
+}
+
+static esp_err_t sim_port_set_stop_bits(uint8_t stop_bits)
+{
+    line.stop_bits = stop_bits;
+    return ESP_OK;
+}
+
+// The slave answers once the request is on the line; the response is held
+// back until the clock reaches its arrival time
+static int sim_port_write(const uint8_t *data, size_t length)
+{
+    uint32_t char_us = modbus_port_sim_char_us();
+    tx_done_us = sim_port_now_us() + (int64_t)length * char_us;
+    port_stats.bytes_sent += (uint32_t)length;
+    port_stats.busy_us += (uint64_t)length * char_us;
+
+    sim_port_drop_response();
+    if (attached_sim) {
+        uint32_t turnaround_us = 0;
+        response_length = modbus_sim_process(attached_sim, &line, data, length, response, sizeof(response),
+                                             &turnaround_us);
+        response_done_us = tx_done_us + turnaround_us + (int64_t)response_length * char_us;
+    }
+    return (int)length;
+}
+
+static void sim_port_wait_tx_done(uint32_t timeout_ms)
+{
+    (void)timeout_ms;
+    sim_port_advance_to(tx_done_us);
+}
+
+static void sim_port_flush_input(void)
+{
+    sim_port_drop_response();
+}
+
+// The whole response is returned at the arrival of its last byte, the gap one
+// RTU gap later; waits that end in nothing move the clock to their deadline
+static int sim_port_read(uint8_t *buf, size_t size, int64_t timeout_us, bool *gap)
+{
+    int64_t deadline_us = sim_port_now_us() + timeout_us;
+    *gap = false;
+
+    if (response_length > 0 && !response_delivered) {
+        if (response_done_us <= deadline_us) {
+            sim_port_advance_to(response_done_us);
+            size_t n = response_length < size ? response_length : size;
+            memcpy(buf, response, n);
+            response_delivered = true;
+            port_stats.bytes_received += (uint32_t)n;
+            port_stats.busy_us += (uint64_t)response_length * modbus_port_sim_char_us();
+            return (int)n;
+        }
+    } else if (response_delivered && !gap_reported) {
+        int64_t gap_us = response_done_us + modbus_frame_gap_us(line.baud_rate);
+        if (gap_us <= deadline_us) {
+            sim_port_advance_to(gap_us);
+            gap_reported = true;
+            *gap = true;
+            return 0;
+        }
+    }
+
+    sim_port_advance_to(deadline_us);
+    return 0;
+}
+
+static void sim_port_delay_ms(uint32_t ms)
+{
+    sim_port_advance_to(sim_port_now_us() + (int64_t)ms * 1000);
+}
+
+const modbus_port_t modbus_port_sim = {
+    .name = "sim",
+    .open = sim_port_open,
+    .close = sim_port_close,
+    .set_baud_rate = sim_port_set_baud_rate,
+    .set_parity = sim_port_set_parity,
+    .set_stop_bits = sim_port_set_stop_bits,
+    .write = sim_port_write,
+    .wait_tx_done = sim_port_wait_tx_done,
+    .flush_input = sim_port_flush_input,
+    .read = sim_port_read,
+    .now_us = sim_port_now_us,
+    .delay_ms = sim_port_delay_ms,
+};
@@ -0,0 +1,35 @@
+// modbus_port_sim.h - In-process Modbus port on a simulated line
+// Requests go straight to a modbus_sim_t. Line time is simulated instead of
+// slept: the port clock is CLOCK_MONOTONIC plus a skew that jumps over every
+// character time, slave turnaround and timeout, so CPU work (encoding,
+// decoding, JSON) is measured for real while a poll cycle at 9600 baud takes
+// milliseconds of wall time and repeats exactly for a given simulator seed.
+
+#ifndef MODBUS_PORT_SIM_H
+#define MODBUS_PORT_SIM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "modbus_port.h"
+#include "modbus_sim.h"
+
+// Line activity since the last modbus_port_sim_reset_stats()
+typedef struct {
+    uint64_t busy_us;                      // Character times of requests and responses
+    uint64_t skipped_us;                   // Simulated time the clock jumped over
+    uint32_t bytes_sent;
+    uint32_t bytes_received;
+} modbus_port_sim_stats_t;
+
+extern const modbus_port_t modbus_port_sim;
+
+// sim must outlive its use by the port; NULL detaches (every request times out)
+void modbus_port_sim_attach(modbus_sim_t *sim);
+void modbus_port_sim_get_stats(modbus_port_sim_stats_t *stats);
+void modbus_port_sim_reset_stats(void);
+
+// Time on the line for one character at the current settings (start, 8 data,
+// parity, stop bits)
+uint32_t modbus_port_sim_char_us(void);
+
+#endif // MODBUS_PORT_SIM_H
@@ -0,0 +1,269 @@
+// modbus_sim.c - Simulated Modbus RTU slaves for host builds
+
+#include "modbus_sim.h"
+#include "modbus_crc.h"
+#include <string.h>
+#include <math.h>
+
+void modbus_sim_init(modbus_sim_t *sim, uint32_t seed)
+{
+    memset(sim, 0, sizeof(*sim));
+    sim->random_state = seed ? seed : 0x2545F491u;
+}
+
+// xorshift32, so injected faults repeat from run to run
+static uint32_t modbus_sim_random(modbus_sim_t *sim)
+{
+    uint32_t x = sim->random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim->random_state = x;
+    return x;
+}
+
+static bool modbus_sim_chance(modbus_sim_t *sim, uint16_t permille)
+{
+    return permille > 0 && modbus_sim_random(sim) % 1000 < permille;
+}
+
+modbus_sim_slave_t *modbus_sim_find(modbus_sim_t *sim, uint8_t slave_id)
+{
+    for (int i = 0; i < sim->slave_count; i++) {
+        if (sim->slaves[i].slave_id == slave_id) {
+            return &sim->slaves[i];
+        }
+    }
+    return NULL;
+}
+
+modbus_sim_slave_t *modbus_sim_add_slave(modbus_sim_t *sim, uint8_t slave_id)
+{
+    modbus_sim_slave_t *slave = modbus_sim_find(sim, slave_id);
+    if (slave) {
+        return slave;
+    }
+    if (slave_id == 0 || sim->slave_count >= MODBUS_SIM_MAX_SLAVES) {
+        return NULL;
+    }
+    slave = &sim->slaves[sim->slave_count++];
+    memset(slave, 0, sizeof(*slave));
+    slave->slave_id = slave_id;
+    return slave;
+}
+
+static bool modbus_sim_line_matches(const modbus_sim_slave_t *slave, const modbus_line_config_t *line)
+{
+    if (!line) {
+        return true;
+    }
+    return (slave->line.baud_rate == 0 || slave->line.baud_rate == line->baud_rate) &&
+           (slave->line.parity == 0 || slave->line.parity == line->parity) &&
+           (slave->line.stop_bits == 0 || slave->line.stop_bits == line->stop_bits);
+}
+
+static size_t modbus_sim_exception(const uint8_t *request, uint8_t code, uint8_t *response)
+{
+    response[0] = request[0];
+    response[1] = request[1] | 0x80;
+    response[2] = code;
+    return 3;
+}
+
+// Response PDU without CRC; 0 when the request is malformed
+static size_t modbus_sim_answer(modbus_sim_slave_t *slave, const uint8_t *request, size_t length,
+                                uint8_t *response, size_t response_size)
+{
+    uint8_t function_code = request[1];
+    uint16_t address = (uint16_t)((request[2] << 8) | request[3]);
+    uint16_t value = (uint16_t)((request[4] << 8) | request[5]);
+
+    switch (function_code) {
+        case MODBUS_READ_HOLDING_REGISTERS:
+        case MODBUS_READ_INPUT_REGISTERS: {
+            if (length != 8) {
+                return 0;
+            }
+            if (value == 0 || value > MODBUS_MAX_REGISTERS || (size_t)(3 + value * 2) > response_size) {
+                return modbus_sim_exception(request, MODBUS_ILLEGAL_DATA_VALUE, response);
+            }
+            if ((uint32_t)address + value > MODBUS_SIM_REGISTERS) {
+                return modbus_sim_exception(request, MODBUS_ILLEGAL_DATA_ADDRESS, response);
+            }
+            const uint16_t *table = function_code == MODBUS_READ_HOLDING_REGISTERS ? slave->holding : slave->input;
+            response[0] = request[0];
+            response[1] = function_code;
+            response[2] = (uint8_t)(value * 2);
+            for (uint16_t i = 0; i < value; i++) {
+                response[3 + i * 2] = (uint8_t)(table[address + i] >> 8);
+                response[4 + i * 2] = (uint8_t)table[address + i];
+            }
+            return (size_t)(3 + value * 2);
+        }
+        case MODBUS_WRITE_SINGLE_REGISTER:
+            if (length != 8) {
+                return 0;
+            }
+            if (address >= MODBUS_SIM_REGISTERS) {
+                return modbus_sim_exception(request, MODBUS_ILLEGAL_DATA_ADDRESS, response);
+            }
+            slave->holding[address] = value;
+            slave->writes++;
+            memcpy(response, request, 6);
+            return 6;
+        case MODBUS_WRITE_MULTIPLE_REGISTERS: {
+            if (length < 9 || request[6] != value * 2 || length != (size_t)(9 + request[6])) {
+                return 0;
+            }
+            if (value == 0 || value > 123) {
+                return modbus_sim_exception(request, MODBUS_ILLEGAL_DATA_VALUE, response);
+            }
+            if ((uint32_t)address + value > MODBUS_SIM_REGISTERS) {
+                return modbus_sim_exception(request, MODBUS_ILLEGAL_DATA_ADDRESS, response);
+            }
+            for (uint16_t i = 0; i < value; i++) {
+                slave->holding[address + i] = (uint16_t)((request[7 + i * 2] << 8) | request[8 + i * 2]);
+            }
+            slave->writes++;
+            memcpy(response, request, 6);
+            return 6;
+        }
+        default:
+            return modbus_sim_exception(request, MODBUS_ILLEGAL_FUNCTION, response);
+    }
+}
+
+size_t modbus_sim_process(modbus_sim_t *sim, const modbus_line_config_t *line, const uint8_t *request,
+                          size_t request_length, uint8_t *response, size_t response_size,
+                          uint32_t *turnaround_us)
+{
+    *turnaround_us = 0;
+    if (!request || request_length < 4 || response_size < 8 ||
+        modbus_crc_update(MODBUS_CRC_INIT, request, request_length) != 0) {
+        sim->unanswered++;
+        return 0;
+    }
+
+    modbus_sim_slave_t *slave = modbus_sim_find(sim, request[0]);
+    if (!slave) {
+        sim->unanswered++;
+        return 0;
+    }
+    slave->requests++;
+
+    // At other line settings the slave sees noise and stays silent
+    if (!modbus_sim_line_matches(slave, line)) {
+        slave->line_mismatches++;
+        return 0;
+    }
+    if (modbus_sim_chance(sim, slave->timeout_permille)) {
+        slave->timeouts_injected++;
+        return 0;
+    }
+
+    size_t length = modbus_sim_answer(slave, request, request_length, response, response_size - 2);
+    if (length == 0) {
+        return 0;
+    }
+
+    uint16_t crc = modbus_crc_update(MODBUS_CRC_INIT, response, length);
+    if (modbus_sim_chance(sim, slave->crc_error_permille)) {
+        crc ^= 0x5A5A;
+        slave->crc_errors_injected++;
+    }
+    response[length++] = (uint8_t)(crc & 0xFF);
+    response[length++] = (uint8_t)(crc >> 8);
+
+    slave->responses++;
+    *turnaround_us = slave->turnaround_us + (slave->jitter_us ? modbus_sim_random(sim) % slave->jitter_us : 0);
+    return length;
+}
+
+uint16_t *modbus_sim_registers(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address, int count)
+{
+    if (!slave || count <= 0 || (uint32_t)address + (uint32_t)count > MODBUS_SIM_REGISTERS) {
+        return NULL;
+    }
+    return (table == MODBUS_SIM_HOLDING ? slave->holding : slave->input) + address;
+}
+
+esp_err_t modbus_sim_put_u16(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address, uint16_t value)
+{
+    uint16_t *registers = modbus_sim_registers(slave, table, address, 1);
+    if (!registers) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    registers[0] = value;
+    return ESP_OK;
+}
+
+// Wire byte i carries value byte order[i] - 'A', with 'A' the most significant
+esp_err_t modbus_sim_put_bytes(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address,
+                               uint64_t value, int width, const char *order)
+{
+    if ((width != 2 && width != 4 && width != 8) || !order || (int)strlen(order) != width) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint16_t *registers = modbus_sim_registers(slave, table, address, width / 2);
+    if (!registers) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t wire[8];
+    for (int i = 0; i < width; i++) {
+        int index = order[i] - 'A';
+        if (index < 0 || index >= width) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        wire[i] = (uint8_t)(value >> (8 * (width - 1 - index)));
+    }
+    for (int r = 0; r < width / 2; r++) {
+        registers[r] = (uint16_t)((wire[2 * r] << 8) | wire[2 * r + 1]);
+    }
+    return ESP_OK;
+}
+
+esp_err_t modbus_sim_put_float32(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address,
+                                 float value, const char *order)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return modbus_sim_put_bytes(slave, table, address, bits, 4, order);
+}
+
+esp_err_t modbus_sim_put_float64(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address,
+                                 double value, const char *order)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return modbus_sim_put_bytes(slave, table, address, bits, 8, order);
+}
+
+esp_err_t modbus_sim_put_flow_meter(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address,
+                                    double total)
+{
+    double integer_part = floor(total);
+    esp_err_t ret = modbus_sim_put_bytes(slave, table, address, (uint32_t)integer_part, 4, "CDAB");
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return modbus_sim_put_float32(slave, table, address + 2, (float)(total - integer_part), "CDAB");
+}
+
+esp_err_t modbus_sim_put_zest(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address, double total)
+{
+    double integer_part = floor(total);
+    uint16_t *registers = modbus_sim_registers(slave, table, address, 4);
+    if (!registers) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    registers[0] = (uint16_t)integer_part;
+    registers[1] = 0;
+    return modbus_sim_put_float32(slave, table, address + 2, (float)(total - integer_part), "ABCD");
+}
+
+esp_err_t modbus_sim_put_panda_usm(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address,
+                                   double total)
+{
+    return modbus_sim_put_float64(slave, table, address, total, "ABCDEFGH");
+}
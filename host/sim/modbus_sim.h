@@ -0,0 +1,88 @@
+// modbus_sim.h - Simulated Modbus RTU slaves for host builds
+// A modbus_sim_t holds the register maps of a set of slaves and answers
+// request ADUs the way the field devices do: FC 03/04 reads, FC 06/16 writes,
+// exception responses for unmapped addresses, and silence for other slave IDs.
+// Each slave has its own turnaround time and can be told to answer with a bad
+// CRC, stay silent, or listen only at given line settings.
+//
+// The simulator is transport-free: modbus_port_sim drives it in process on a
+// virtual clock, modbus_sim_pty serves it on a pseudo-terminal.
+
+#ifndef MODBUS_SIM_H
+#define MODBUS_SIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "modbus.h"
+
+#define MODBUS_SIM_MAX_SLAVES 32
+#define MODBUS_SIM_REGISTERS 1024          // Per table; higher addresses answer exception 02
+
+typedef enum {
+    MODBUS_SIM_HOLDING,
+    MODBUS_SIM_INPUT
+} modbus_sim_table_t;
+
+typedef struct {
+    uint8_t slave_id;
+    uint16_t holding[MODBUS_SIM_REGISTERS];
+    uint16_t input[MODBUS_SIM_REGISTERS];
+
+    // Behaviour
+    uint32_t turnaround_us;                // End of request to first response byte
+    uint32_t jitter_us;                    // Added uniformly on top of turnaround_us
+    uint16_t crc_error_permille;           // Responses sent with a corrupted CRC
+    uint16_t timeout_permille;             // Requests left unanswered
+    modbus_line_config_t line;             // Zero fields accept any setting
+
+    // Counters
+    uint32_t requests;
+    uint32_t responses;
+    uint32_t writes;
+    uint32_t crc_errors_injected;
+    uint32_t timeouts_injected;
+    uint32_t line_mismatches;
+} modbus_sim_slave_t;
+
+typedef struct {
+    modbus_sim_slave_t slaves[MODBUS_SIM_MAX_SLAVES];
+    int slave_count;
+    uint32_t random_state;
+    uint32_t unanswered;                   // Requests to unknown slaves or with a bad CRC
+} modbus_sim_t;
+
+void modbus_sim_init(modbus_sim_t *sim, uint32_t seed);
+modbus_sim_slave_t *modbus_sim_add_slave(modbus_sim_t *sim, uint8_t slave_id);
+modbus_sim_slave_t *modbus_sim_find(modbus_sim_t *sim, uint8_t slave_id);
+
+// Answer one request ADU received at the given line settings. Returns the
+// response length (0: the slaves stay silent) and the turnaround to apply.
+size_t modbus_sim_process(modbus_sim_t *sim, const modbus_line_config_t *line, const uint8_t *request,
+                          size_t request_length, uint8_t *response, size_t response_size,
+                          uint32_t *turnaround_us);
+
+// Register map helpers. Byte orders use the letter notation of Modbus tools:
+// "ABCD" is big-endian, "CDAB" word-swapped, "BADC" byte-swapped within each
+// register and "DCBA" fully reversed (eight letters for 64-bit values).
+uint16_t *modbus_sim_registers(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address, int count);
+esp_err_t modbus_sim_put_u16(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address, uint16_t value);
+esp_err_t modbus_sim_put_bytes(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address,
+                               uint64_t value, int width, const char *order);
+esp_err_t modbus_sim_put_float32(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address,
+                                 float value, const char *order);
+esp_err_t modbus_sim_put_float64(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address,
+                                 double value, const char *order);
+
+// Vendor formats of the supported meters, four registers each
+// Flow-Meter / Clampon: UINT32 integer part + FLOAT32 fraction, both word-swapped
+esp_err_t modbus_sim_put_flow_meter(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address,
+                                    double total);
+// ZEST: UINT16 integer part, unused register, FLOAT32 big-endian fraction
+esp_err_t modbus_sim_put_zest(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address, double total);
+// Panda USM: FLOAT64 big-endian
+esp_err_t modbus_sim_put_panda_usm(modbus_sim_slave_t *slave, modbus_sim_table_t table, uint16_t address,
+                                   double total);
+
+#endif // MODBUS_SIM_H
@@ -0,0 +1,149 @@
+// modbus_sim_pty.c - Serve simulated slaves on a pseudo-terminal
+
+#define _GNU_SOURCE
+#include "modbus_sim_pty.h"
+#include "host_serial.h"
+#include "modbus_frame.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+
+// Silence that ends a request. Bytes written in one call arrive together on a
+// pty, so this only has to cover scheduling delays, not character times.
+#define SIM_PTY_REQUEST_GAP_MS 2
+#define SIM_PTY_POLL_MS 20                 // Stop flag check interval
+
+struct modbus_sim_pty {
+    modbus_sim_t *sim;
+    int master_fd;
+    int slave_fd;                          // Held open so the line survives gateway reopens
+    char device[64];
+    pthread_t thread;
+    volatile bool stop;
+};
+
+static void sim_pty_sleep_us(uint32_t us)
+{
+    struct timespec delay = { .tv_sec = us / 1000000, .tv_nsec = (long)(us % 1000000) * 1000 };
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR) {
+    }
+}
+
+static void sim_pty_serve(modbus_sim_pty_t *server, const uint8_t *request, size_t length)
+{
+    modbus_line_config_t line;
+    host_serial_get_line(server->slave_fd, &line);
+
+    uint8_t response[MODBUS_FRAME_MAX_SIZE];
+    uint32_t turnaround_us = 0;
+    size_t response_length = modbus_sim_process(server->sim, &line, request, length, response,
+                                                sizeof(response), &turnaround_us);
+    if (response_length == 0) {
+        return;
+    }
+
+    sim_pty_sleep_us(turnaround_us);
+    size_t written = 0;
+    while (written < response_length) {
+        ssize_t n = write(server->master_fd, response + written, response_length - written);
+        if (n <= 0) {
+            return;
+        }
+        written += (size_t)n;
+    }
+}
+
+static void *sim_pty_thread(void *arg)
+{
+    modbus_sim_pty_t *server = (modbus_sim_pty_t *)arg;
+    uint8_t request[MODBUS_FRAME_MAX_SIZE];
+    size_t length = 0;
+
+    while (!server->stop) {
+        struct pollfd pfd = { .fd = server->master_fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, length > 0 ? SIM_PTY_REQUEST_GAP_MS : SIM_PTY_POLL_MS);
+        if (ready < 0) {
+            continue;
+        }
+        if (ready == 0) {
+            if (length > 0) {
+                sim_pty_serve(server, request, length);
+                length = 0;
+            }
+            continue;
+        }
+
+        ssize_t n = read(server->master_fd, request + length, sizeof(request) - length);
+        if (n > 0) {
+            length += (size_t)n;
+            if (length == sizeof(request)) {
+                length = 0;                // Not a request any slave would answer
+            }
+        }
+    }
+    return NULL;
+}
+
+esp_err_t modbus_sim_pty_start(modbus_sim_t *sim, modbus_sim_pty_t **server_out)
+{
+    if (!sim || !server_out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    modbus_sim_pty_t *server = calloc(1, sizeof(*server));
+    if (!server) {
+        return ESP_ERR_NO_MEM;
+    }
+    server->sim = sim;
+    server->slave_fd = -1;
+    server->master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (server->master_fd < 0 || grantpt(server->master_fd) != 0 || unlockpt(server->master_fd) != 0 ||
+        ptsname_r(server->master_fd, server->device, sizeof(server->device)) != 0) {
+        goto fail;
+    }
+
+    server->slave_fd = open(server->device, O_RDWR | O_NOCTTY);
+    if (server->slave_fd < 0 || host_serial_configure(server->slave_fd, RS485_BAUD_RATE, 'N', 1) != ESP_OK) {
+        goto fail;
+    }
+
+    if (pthread_create(&server->thread, NULL, sim_pty_thread, server) != 0) {
+        goto fail;
+    }
+    *server_out = server;
+    return ESP_OK;
+
+fail:
+    if (server->slave_fd >= 0) {
+        close(server->slave_fd);
+    }
+    if (server->master_fd >= 0) {
+        close(server->master_fd);
+    }
+    free(server);
+    return ESP_FAIL;
+}
+
+const char *modbus_sim_pty_device(const modbus_sim_pty_t *server)
+{
+    return server ? server->device : NULL;
+}
+
+void modbus_sim_pty_stop(modbus_sim_pty_t *server)
+{
+    if (!server) {
+        return;
+    }
+    server->stop = true;
+    pthread_join(server->thread, NULL);
+    close(server->slave_fd);
+    close(server->master_fd);
+    free(server);
+}
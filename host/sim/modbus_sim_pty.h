@@ -0,0 +1,23 @@
+// modbus_sim_pty.h - Serve simulated slaves on a pseudo-terminal
+// The simulator owns the pty master; the gateway side opens the slave device
+// (modbus_sim_pty_device()) like any serial line, e.g. through modbus_port_pty.
+// Requests are delimited by line silence, answered after the slave's
+// turnaround time, at the line settings the gateway applied to the pty.
+// Linux ptys carry baud rate and stop bits but no parity: slaves served here
+// should leave line.parity at 0.
+
+#ifndef MODBUS_SIM_PTY_H
+#define MODBUS_SIM_PTY_H
+
+#include "esp_err.h"
+#include "modbus_sim.h"
+
+typedef struct modbus_sim_pty modbus_sim_pty_t;
+
+// sim must outlive the server. Register maps may only change while no
+// request is in flight.
+esp_err_t modbus_sim_pty_start(modbus_sim_t *sim, modbus_sim_pty_t **server);
+const char *modbus_sim_pty_device(const modbus_sim_pty_t *server);
+void modbus_sim_pty_stop(modbus_sim_pty_t *server);
+
+#endif // MODBUS_SIM_PTY_H
@@ -0,0 +1,13 @@
+// driver/uart.h - Host stand-in: UART port numbers referenced by configuration headers
+// The host build reaches serial lines through a modbus_port_t, never this driver.
+
+#ifndef HOST_DRIVER_UART_H
+#define HOST_DRIVER_UART_H
+
+typedef int uart_port_t;
+
+#define UART_NUM_0 0
+#define UART_NUM_1 1
+#define UART_NUM_2 2
+
+#endif // HOST_DRIVER_UART_H
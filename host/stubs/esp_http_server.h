@@ -0,0 +1,17 @@
+// esp_http_server.h - Host stand-in: the request and handle types web_config.h names
+
+#ifndef HOST_ESP_HTTP_SERVER_H
+#define HOST_ESP_HTTP_SERVER_H
+
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef void *httpd_handle_t;
+typedef struct httpd_req {
+    const char *uri;
+    int method;
+    size_t content_len;
+    void *user_ctx;
+} httpd_req_t;
+
+#endif // HOST_ESP_HTTP_SERVER_H
@@ -0,0 +1,33 @@
+// esp_log.h - Host stand-in for ESP-IDF logging
+// Messages at or below host_log_level go to stderr. The level starts at WARN
+// and can be raised with HOST_LOG_LEVEL=0..5 in the environment.
+
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+extern esp_log_level_t host_log_level;
+
+void host_log(esp_log_level_t level, const char *tag, const char *format, ...);
+
+#define ESP_LOG_LEVEL_LOCAL(level, tag, format, ...) do {              \
+        if ((level) <= host_log_level) {                                \
+            host_log((level), (tag), format, ##__VA_ARGS__);            \
+        }                                                               \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#endif // HOST_ESP_LOG_H
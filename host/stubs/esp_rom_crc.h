@@ -0,0 +1,10 @@
+// esp_rom_crc.h - Host stand-in for the ROM CRC-32 (IEEE 802.3, reflected)
+
+#ifndef HOST_ESP_ROM_CRC_H
+#define HOST_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif // HOST_ESP_ROM_CRC_H
@@ -0,0 +1,17 @@
+// esp_system.h - Host stand-in for the heap and restart calls
+// The heap figures model a HOST_HEAP_SIZE byte heap with the process's malloc
+// usage taken out of it, so allocations made by the code under test show up.
+
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define HOST_HEAP_SIZE (320 * 1024)
+
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+void esp_restart(void);
+
+#endif // HOST_ESP_SYSTEM_H
@@ -0,0 +1,36 @@
+// FreeRTOS.h - Host stand-in for the FreeRTOS kernel API, backed by pthreads
+// Only the calls the core modules make are provided (see host_freertos.c).
+
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFu)
+#define configTICK_RATE_HZ 100             // CONFIG_FREERTOS_HZ of sdkconfig
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define pdTICKS_TO_MS(ticks) ((uint32_t)(ticks) * portTICK_PERIOD_MS)
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) host_critical_enter()
+#define portEXIT_CRITICAL(mux) host_critical_exit()
+#define IRAM_ATTR
+
+void host_critical_enter(void);
+void host_critical_exit(void);
+
+#endif // HOST_FREERTOS_H
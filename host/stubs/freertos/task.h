@@ -0,0 +1,25 @@
+// task.h - Host stand-in: FreeRTOS tasks as pthreads
+
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+// stack_depth is in bytes, as on ESP-IDF. Task stacks are painted so
+// uxTaskGetStackHighWaterMark() reports the real unused depth.
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *param,
+                       UBaseType_t priority, TaskHandle_t *handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                                   void *param, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+// Bytes never touched on the task's stack; 0 for threads not created by xTaskCreate
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+BaseType_t xPortGetCoreID(void);
+
+#endif // HOST_FREERTOS_TASK_H
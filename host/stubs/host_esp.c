@@ -0,0 +1,113 @@
+// host_esp.c - ESP-IDF logging, timer, heap, CRC and error-name calls for host builds
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+#include <malloc.h>
+
+esp_log_level_t host_log_level = ESP_LOG_WARN;
+
+__attribute__((constructor))
+static void host_log_level_from_env(void)
+{
+    const char *level = getenv("HOST_LOG_LEVEL");
+    if (level && level[0] >= '0' && level[0] <= '5') {
+        host_log_level = (esp_log_level_t)(level[0] - '0');
+    }
+}
+
+void host_log(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    static const char letters[] = "NEWIDV";
+    va_list args;
+
+    fprintf(stderr, "%c (%lld) %s: ", letters[level], (long long)(esp_timer_get_time() / 1000), tag);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE: return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_INVALID_CRC: return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_INVALID_VERSION: return "ESP_ERR_INVALID_VERSION";
+        case ESP_ERR_INVALID_MAC: return "ESP_ERR_INVALID_MAC";
+        case ESP_ERR_NOT_FINISHED: return "ESP_ERR_NOT_FINISHED";
+        default: return "UNKNOWN ERROR";
+    }
+}
+
+static int64_t host_monotonic_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static int64_t boot_us;
+
+__attribute__((constructor))
+static void host_timer_start(void)
+{
+    boot_us = host_monotonic_us() - 1;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return host_monotonic_us() - boot_us;
+}
+
+static uint32_t min_free_heap = HOST_HEAP_SIZE;
+
+uint32_t esp_get_free_heap_size(void)
+{
+    struct mallinfo2 info = mallinfo2();
+    uint32_t free_bytes = info.uordblks >= HOST_HEAP_SIZE ? 0 : (uint32_t)(HOST_HEAP_SIZE - info.uordblks);
+    if (free_bytes < min_free_heap) {
+        min_free_heap = free_bytes;
+    }
+    return free_bytes;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    esp_get_free_heap_size();
+    return min_free_heap;
+}
+
+void esp_restart(void)
+{
+    fprintf(stderr, "esp_restart() called\n");
+    abort();
+}
+
+// Same convention as the ROM: crc is the previous result, 0 to start
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1u));
+        }
+    }
+    return ~crc;
+}
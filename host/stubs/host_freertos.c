@@ -0,0 +1,407 @@
+// host_freertos.c - FreeRTOS tasks, queues and semaphores on pthreads
+
+#define _GNU_SOURCE
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <assert.h>
+
+// Room for host libc frames on top of the depth the firmware asked for; the
+// high-water mark is reported against the requested depth only
+#define HOST_STACK_HEADROOM (64 * 1024)
+#define HOST_STACK_PAINT 0xA5
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t function;
+    void *param;
+    char name[16];
+    uint8_t *stack;
+    size_t stack_size;                     // Allocated, including the headroom
+    uint32_t depth;                        // Requested by the caller
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    uint8_t *items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+struct host_semaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    UBaseType_t count;
+    UBaseType_t max_count;
+    bool is_static;
+};
+
+static_assert(sizeof(struct host_semaphore) <= sizeof(StaticSemaphore_t), "StaticSemaphore_t too small");
+
+static __thread struct host_task *current_task = NULL;
+static pthread_mutex_t critical_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+void host_critical_enter(void)
+{
+    pthread_mutex_lock(&critical_lock);
+}
+
+void host_critical_exit(void)
+{
+    pthread_mutex_unlock(&critical_lock);
+}
+
+static void host_cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static struct timespec host_deadline(TickType_t ticks)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    uint64_t ns = (uint64_t)pdTICKS_TO_MS(ticks) * 1000000ull + (uint64_t)deadline.tv_nsec;
+    deadline.tv_sec += (time_t)(ns / 1000000000ull);
+    deadline.tv_nsec = (long)(ns % 1000000000ull);
+    return deadline;
+}
+
+// Wait on cond until ready() holds; false once the tick timeout expires
+static bool host_wait(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks,
+                      bool (*ready)(void *), void *object)
+{
+    if (ticks == portMAX_DELAY) {
+        while (!ready(object)) {
+            pthread_cond_wait(cond, lock);
+        }
+        return true;
+    }
+
+    struct timespec deadline = host_deadline(ticks);
+    while (!ready(object)) {
+        if (ticks == 0 || pthread_cond_timedwait(cond, lock, &deadline) == ETIMEDOUT) {
+            return ready(object);
+        }
+    }
+    return true;
+}
+
+// Tasks
+
+static void *host_task_entry(void *arg)
+{
+    struct host_task *task = (struct host_task *)arg;
+    current_task = task;
+    task->function(task->param);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                                   void *param, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    (void)priority;
+    (void)core;
+
+    struct host_task *task = calloc(1, sizeof(*task));
+    if (!task) {
+        return pdFAIL;
+    }
+    task->function = function;
+    task->param = param;
+    task->depth = stack_depth;
+    task->stack_size = stack_depth + HOST_STACK_HEADROOM;
+    strncpy(task->name, name ? name : "task", sizeof(task->name) - 1);
+    if (posix_memalign((void **)&task->stack, 64, task->stack_size) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    memset(task->stack, HOST_STACK_PAINT, task->stack_size);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, task->stack, task->stack_size);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int err = pthread_create(&task->thread, &attr, host_task_entry, task);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        free(task->stack);
+        free(task);
+        return pdFAIL;
+    }
+
+    if (handle) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *param,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    return xTaskCreatePinnedToCore(function, name, stack_depth, param, priority, handle, tskNO_AFFINITY);
+}
+
+// The task's stack stays allocated: a thread cannot release the stack it runs on
+void vTaskDelete(TaskHandle_t task)
+{
+    if (!task || task == current_task) {
+        pthread_exit(NULL);
+    }
+    pthread_cancel(task->thread);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec delay = {
+        .tv_sec = (time_t)(pdTICKS_TO_MS(ticks) / 1000),
+        .tv_nsec = (long)(pdTICKS_TO_MS(ticks) % 1000) * 1000000L,
+    };
+    if (ticks == 0) {
+        sched_yield();
+        return;
+    }
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR) {
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t ms = (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+    return (TickType_t)(ms / portTICK_PERIOD_MS);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current_task;
+}
+
+// Stacks grow down, so the untouched paint sits at the low end
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    if (!task) {
+        task = current_task;
+    }
+    if (!task) {
+        return 0;
+    }
+
+    size_t untouched = 0;
+    while (untouched < task->stack_size && task->stack[untouched] == HOST_STACK_PAINT) {
+        untouched++;
+    }
+    size_t used = task->stack_size - untouched;
+    return used >= task->depth ? 0 : (UBaseType_t)(task->depth - used);
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+// Queues
+
+static bool queue_has_item(void *object)
+{
+    return ((struct host_queue *)object)->count > 0;
+}
+
+static bool queue_has_space(void *object)
+{
+    struct host_queue *queue = (struct host_queue *)object;
+    return queue->count < queue->length;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+    if (!queue || length == 0) {
+        free(queue);
+        return NULL;
+    }
+    queue->items = calloc(length, item_size ? item_size : 1);
+    if (!queue->items) {
+        free(queue);
+        return NULL;
+    }
+    queue->length = length;
+    queue->item_size = item_size;
+    pthread_mutex_init(&queue->lock, NULL);
+    host_cond_init(&queue->changed);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    if (queue) {
+        pthread_cond_destroy(&queue->changed);
+        pthread_mutex_destroy(&queue->lock);
+        free(queue->items);
+        free(queue);
+    }
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    if (!queue) {
+        return pdFAIL;
+    }
+    pthread_mutex_lock(&queue->lock);
+    bool ok = host_wait(&queue->changed, &queue->lock, ticks, queue_has_space, queue);
+    if (ok) {
+        UBaseType_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(queue->items + (size_t)tail * queue->item_size, item, queue->item_size);
+        queue->count++;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdPASS : pdFAIL;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    if (!queue) {
+        return pdFAIL;
+    }
+    pthread_mutex_lock(&queue->lock);
+    bool ok = host_wait(&queue->changed, &queue->lock, ticks, queue_has_item, queue);
+    if (ok) {
+        memcpy(item, queue->items + (size_t)queue->head * queue->item_size, queue->item_size);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdPASS : pdFAIL;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    if (queue) {
+        pthread_mutex_lock(&queue->lock);
+        queue->head = 0;
+        queue->count = 0;
+        pthread_cond_broadcast(&queue->changed);
+        pthread_mutex_unlock(&queue->lock);
+    }
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    if (!queue) {
+        return 0;
+    }
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+// Semaphores
+
+static bool semaphore_available(void *object)
+{
+    return ((struct host_semaphore *)object)->count > 0;
+}
+
+static SemaphoreHandle_t semaphore_init(struct host_semaphore *semaphore, UBaseType_t max_count,
+                                        UBaseType_t initial_count, bool is_static)
+{
+    memset(semaphore, 0, sizeof(*semaphore));
+    pthread_mutex_init(&semaphore->lock, NULL);
+    host_cond_init(&semaphore->changed);
+    semaphore->max_count = max_count;
+    semaphore->count = initial_count;
+    semaphore->is_static = is_static;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    struct host_semaphore *semaphore = malloc(sizeof(*semaphore));
+    return semaphore ? semaphore_init(semaphore, max_count, initial_count, false) : NULL;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer)
+{
+    return buffer ? semaphore_init((struct host_semaphore *)buffer, 1, 0, true) : NULL;
+}
+
+// No priority inheritance or owner tracking; enough for the firmware's use
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    if (semaphore) {
+        pthread_cond_destroy(&semaphore->changed);
+        pthread_mutex_destroy(&semaphore->lock);
+        if (!semaphore->is_static) {
+            free(semaphore);
+        }
+    }
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    if (!semaphore) {
+        return pdFAIL;
+    }
+    pthread_mutex_lock(&semaphore->lock);
+    bool ok = host_wait(&semaphore->changed, &semaphore->lock, ticks, semaphore_available, semaphore);
+    if (ok) {
+        semaphore->count--;
+    }
+    pthread_mutex_unlock(&semaphore->lock);
+    return ok ? pdPASS : pdFAIL;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    if (!semaphore) {
+        return pdFAIL;
+    }
+    pthread_mutex_lock(&semaphore->lock);
+    bool ok = semaphore->count < semaphore->max_count;
+    if (ok) {
+        semaphore->count++;
+        pthread_cond_broadcast(&semaphore->changed);
+    }
+    pthread_mutex_unlock(&semaphore->lock);
+    return ok ? pdPASS : pdFAIL;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t semaphore)
+{
+    if (!semaphore) {
+        return 0;
+    }
+    pthread_mutex_lock(&semaphore->lock);
+    UBaseType_t count = semaphore->count;
+    pthread_mutex_unlock(&semaphore->lock);
+    return count;
+}
@@ -0,0 +1,45 @@
+// host_test.h - Minimal assertions for the host tests
+// A failed CHECK prints the location and counts the failure; the test keeps
+// running so one run reports every broken case. main() ends with
+// TEST_RESULT(), which is the process exit status.
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+static int test_failures;
+static int test_checks;
+
+#define CHECK(cond) do { \
+        test_checks++; \
+        if (!(cond)) { \
+            test_failures++; \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+#define CHECK_EQ_INT(actual, expected) do { \
+        long long check_a = (long long)(actual), check_e = (long long)(expected); \
+        test_checks++; \
+        if (check_a != check_e) { \
+            test_failures++; \
+            fprintf(stderr, "%s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual, check_a, check_e); \
+        } \
+    } while (0)
+
+#define CHECK_EQ_STR(actual, expected) do { \
+        const char *check_a = (actual), *check_e = (expected); \
+        test_checks++; \
+        if (strcmp(check_a, check_e) != 0) { \
+            test_failures++; \
+            fprintf(stderr, "%s:%d: %s == \"%s\", expected \"%s\"\n", __FILE__, __LINE__, #actual, check_a, check_e); \
+        } \
+    } while (0)
+
+#define TEST_RESULT() \
+    (fprintf(stderr, "%s: %d checks, %d failed\n", __FILE__, test_checks, test_failures), test_failures ? 1 : 0)
+
+#endif // HOST_TEST_H
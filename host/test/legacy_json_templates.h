@@ -0,0 +1,20 @@
+// legacy_json_templates.h - snprintf templates the JSON writer replaced
+// Reference for the host JSON tests and benchmark, see legacy_json_templates.c
+
+#ifndef LEGACY_JSON_TEMPLATES_H
+#define LEGACY_JSON_TEMPLATES_H
+
+#include "json_templates.h"
+
+esp_err_t legacy_create_json_payload(const json_params_t* params, char* json_buffer, size_t buffer_size);
+esp_err_t legacy_generate_sensor_json(const sensor_config_t* sensor, double scaled_value,
+                                      uint32_t raw_value, const network_stats_t* net_stats,
+                                      char* json_buffer, size_t buffer_size);
+esp_err_t legacy_generate_sensor_json_with_hex(const sensor_config_t* sensor, double scaled_value,
+                                               uint32_t raw_value, const char* hex_string,
+                                               const network_stats_t* net_stats,
+                                               char* json_buffer, size_t buffer_size);
+esp_err_t legacy_generate_quality_sensor_json(const sensor_reading_t* reading, char* json_buffer,
+                                              size_t buffer_size);
+
+#endif // LEGACY_JSON_TEMPLATES_H
@@ -0,0 +1,415 @@
+// legacy_sensor_decoder.c - Interpreted decoder the compiled one replaced
+// convert_modbus_data() and sensor_decode_registers() exactly as they were in
+// main/sensor_manager.c before the sensor_decoder descriptors (git 1040105^),
+// renamed legacy_*. The decoder tests and benchmark use them as the reference
+// the compiled path has to match bit for bit. Do not "fix" this copy.
+
+#include "legacy_sensor_decoder.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+static const char *TAG = "SENSOR_MGR";
+
+esp_err_t legacy_convert_modbus_data(const uint16_t *registers, int reg_count, 
+                             const char* data_type, const char* byte_order,
+                             double scale_factor, double *result, uint32_t *raw_value)
+{
+    if (!registers || !data_type || !byte_order || !result || !raw_value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ESP_LOGI(TAG, "Converting data: Type=%s, Order=%s, Scale=%.6f", data_type, byte_order, scale_factor);
+
+    // Handle specific format names from web interface
+    const char* actual_data_type = data_type;
+    const char* actual_byte_order = byte_order;
+    
+    // 32-bit Integer formats
+    if (strstr(data_type, "INT32_1234") || strstr(data_type, "UINT32_1234")) {
+        actual_data_type = strstr(data_type, "UINT32") ? "UINT32" : "INT32";
+        actual_byte_order = "BIG_ENDIAN";     // 1234 = ABCD = BIG_ENDIAN
+    } else if (strstr(data_type, "INT32_4321") || strstr(data_type, "UINT32_4321")) {
+        actual_data_type = strstr(data_type, "UINT32") ? "UINT32" : "INT32";
+        actual_byte_order = "LITTLE_ENDIAN";  // 4321 = DCBA = LITTLE_ENDIAN
+    } else if (strstr(data_type, "INT32_3412") || strstr(data_type, "UINT32_3412")) {
+        actual_data_type = strstr(data_type, "UINT32") ? "UINT32" : "INT32";
+        actual_byte_order = "LITTLE_ENDIAN";  // 3412 = DCBA (word swap) = reg[1]<<16 | reg[0]
+    } else if (strstr(data_type, "INT32_2143") || strstr(data_type, "UINT32_2143")) {
+        actual_data_type = strstr(data_type, "UINT32") ? "UINT32" : "INT32";
+        actual_byte_order = "MIXED_BADC";     // 2143 = BADC = MIXED_BADC
+    }
+    
+    // 32-bit Float formats
+    else if (strstr(data_type, "FLOAT32_1234")) {
+        actual_data_type = "FLOAT32";
+        actual_byte_order = "BIG_ENDIAN";     // 1234 = ABCD
+    } else if (strstr(data_type, "FLOAT32_4321")) {
+        actual_data_type = "FLOAT32";
+        actual_byte_order = "LITTLE_ENDIAN";  // 4321 = DCBA
+    } else if (strstr(data_type, "FLOAT32_3412")) {
+        actual_data_type = "FLOAT32";
+        actual_byte_order = "LITTLE_ENDIAN";  // 3412 = DCBA (word swap)
+    } else if (strstr(data_type, "FLOAT32_2143")) {
+        actual_data_type = "FLOAT32";
+        actual_byte_order = "MIXED_BADC";     // 2143 = BADC
+    }
+    
+    // 64-bit formats - Handle both full and truncated format names
+    else if (strstr(data_type, "INT64_12345678") || strstr(data_type, "UINT64_12345678") || strstr(data_type, "FLOAT64_12345678") ||
+             strstr(data_type, "INT64_1234567") || strstr(data_type, "UINT64_1234567") || strstr(data_type, "FLOAT64_1234567")) {
+        actual_data_type = strstr(data_type, "UINT64") ? "UINT64" : strstr(data_type, "FLOAT64") ? "FLOAT64" : "INT64";
+        actual_byte_order = "BIG_ENDIAN";     // 12345678/1234567 = standard order
+    } else if (strstr(data_type, "INT64_87654321") || strstr(data_type, "UINT64_87654321") || strstr(data_type, "FLOAT64_87654321") ||
+               strstr(data_type, "INT64_8765432") || strstr(data_type, "UINT64_8765432") || strstr(data_type, "FLOAT64_8765432")) {
+        actual_data_type = strstr(data_type, "UINT64") ? "UINT64" : strstr(data_type, "FLOAT64") ? "FLOAT64" : "INT64";
+        actual_byte_order = "LITTLE_ENDIAN";  // 87654321/8765432 = reversed
+    } else if (strstr(data_type, "INT64_78563412") || strstr(data_type, "UINT64_78563412") || strstr(data_type, "FLOAT64_78563412") ||
+               strstr(data_type, "INT64_7856341") || strstr(data_type, "UINT64_7856341") || strstr(data_type, "FLOAT64_7856341")) {
+        actual_data_type = strstr(data_type, "UINT64") ? "UINT64" : strstr(data_type, "FLOAT64") ? "FLOAT64" : "INT64";
+        actual_byte_order = "MIXED_BADC";     // 78563412/7856341 = mixed order
+    }
+    
+    ESP_LOGI(TAG, "Mapped to: Type=%s, Order=%s", actual_data_type, actual_byte_order);
+
+    if (strcmp(actual_data_type, "UINT16") == 0 && reg_count >= 1) {
+        *raw_value = registers[0];
+        *result = (double)(*raw_value) * scale_factor;
+        ESP_LOGI(TAG, "UINT16: Raw=0x%04" PRIX32 " (%" PRIu32 ") -> %.6f", *raw_value, *raw_value, *result);
+        
+    } else if (strcmp(actual_data_type, "INT16") == 0 && reg_count >= 1) {
+        int16_t signed_val = (int16_t)registers[0];
+        *raw_value = registers[0];
+        *result = (double)signed_val * scale_factor;
+        ESP_LOGI(TAG, "INT16: Raw=0x%04" PRIX32 " (%d) -> %.6f", *raw_value, signed_val, *result);
+        
+    } else if ((strcmp(actual_data_type, "UINT32") == 0 || strcmp(actual_data_type, "INT32") == 0) && reg_count >= 2) {
+        uint32_t combined_value;
+        
+        if (strcmp(actual_byte_order, "BIG_ENDIAN") == 0) {
+            // ABCD - reg[0] is high word, reg[1] is low word
+            combined_value = ((uint32_t)registers[0] << 16) | registers[1];
+        } else if (strcmp(actual_byte_order, "LITTLE_ENDIAN") == 0) {
+            // CDAB - reg[1] is high word, reg[0] is low word
+            combined_value = ((uint32_t)registers[1] << 16) | registers[0];
+        } else if (strcmp(actual_byte_order, "MIXED_BADC") == 0) {
+            // BADC - byte swap within each register
+            uint16_t reg0_swapped = ((registers[0] & 0xFF) << 8) | ((registers[0] >> 8) & 0xFF);
+            uint16_t reg1_swapped = ((registers[1] & 0xFF) << 8) | ((registers[1] >> 8) & 0xFF);
+            combined_value = ((uint32_t)reg0_swapped << 16) | reg1_swapped;
+        } else if (strcmp(actual_byte_order, "MIXED_DCBA") == 0) {
+            // DCBA - completely reversed
+            uint16_t reg0_swapped = ((registers[0] & 0xFF) << 8) | ((registers[0] >> 8) & 0xFF);
+            uint16_t reg1_swapped = ((registers[1] & 0xFF) << 8) | ((registers[1] >> 8) & 0xFF);
+            combined_value = ((uint32_t)reg1_swapped << 16) | reg0_swapped;
+        } else {
+            ESP_LOGE(TAG, "Unknown byte order: %s", actual_byte_order);
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        *raw_value = combined_value;
+        
+        if (strcmp(actual_data_type, "INT32") == 0) {
+            int32_t signed_val = (int32_t)combined_value;
+            *result = (double)signed_val * scale_factor;
+            ESP_LOGI(TAG, "INT32: Raw=0x%08" PRIX32 " (%" PRId32 ") -> %.6f", combined_value, signed_val, *result);
+        } else {
+            *result = (double)combined_value * scale_factor;
+            ESP_LOGI(TAG, "UINT32: Raw=0x%08" PRIX32 " (%" PRIu32 ") -> %.6f", combined_value, combined_value, *result);
+        }
+        
+    } else if (strcmp(actual_data_type, "HEX") == 0) {
+        // HEX type - concatenate all registers as hex value
+        *raw_value = 0;
+        for (int i = 0; i < reg_count && i < 2; i++) {
+            *raw_value = (*raw_value << 16) | registers[i];
+        }
+        *result = (double)(*raw_value) * scale_factor;
+        ESP_LOGI(TAG, "HEX: Raw=0x%08" PRIX32 " -> %.6f", *raw_value, *result);
+        
+    } else if (strcmp(actual_data_type, "FLOAT32") == 0 && reg_count >= 2) {
+        uint32_t combined_value;
+        
+        if (strcmp(actual_byte_order, "BIG_ENDIAN") == 0) {
+            combined_value = ((uint32_t)registers[0] << 16) | registers[1];
+        } else if (strcmp(actual_byte_order, "LITTLE_ENDIAN") == 0) {
+            combined_value = ((uint32_t)registers[1] << 16) | registers[0];
+        } else {
+            ESP_LOGE(TAG, "FLOAT32 only supports BIG_ENDIAN and LITTLE_ENDIAN");
+            return ESP_ERR_INVALID_ARG;
+        }
+        
+        // Convert to IEEE 754 float
+        union {
+            uint32_t i;
+            float f;
+        } converter;
+        converter.i = combined_value;
+        
+        *raw_value = combined_value;
+        *result = (double)converter.f * scale_factor;
+        ESP_LOGI(TAG, "FLOAT32: Raw=0x%08" PRIX32 " (%.6f) -> %.6f", combined_value, converter.f, *result);
+        
+    } else if (strcmp(actual_data_type, "FLOAT64") == 0 && reg_count >= 4) {
+        // FLOAT64 handling - 4 registers (64-bit double precision)
+        uint64_t combined_value64 = 0;
+        
+        if (strcmp(actual_byte_order, "BIG_ENDIAN") == 0) {
+            // FLOAT64_12345678 (ABCDEFGH) - Standard big endian
+            combined_value64 = ((uint64_t)registers[0] << 48) | ((uint64_t)registers[1] << 32) | 
+                              ((uint64_t)registers[2] << 16) | registers[3];
+        } else if (strcmp(actual_byte_order, "LITTLE_ENDIAN") == 0) {
+            // FLOAT64_87654321 (HGFEDCBA) - Full little endian
+            combined_value64 = ((uint64_t)registers[3] << 48) | ((uint64_t)registers[2] << 32) | 
+                              ((uint64_t)registers[1] << 16) | registers[0];
+        } else if (strcmp(actual_byte_order, "MIXED_BADC") == 0) {
+            // FLOAT64_78563412 (GHEFCDAB) - Mixed byte order
+            uint64_t val64_78563412 = ((uint64_t)(((registers[3] & 0xFF) << 8) | ((registers[3] >> 8) & 0xFF)) << 48) |
+                                     ((uint64_t)(((registers[2] & 0xFF) << 8) | ((registers[2] >> 8) & 0xFF)) << 32) |
+                                     ((uint64_t)(((registers[1] & 0xFF) << 8) | ((registers[1] >> 8) & 0xFF)) << 16) |
+                                     (((registers[0] & 0xFF) << 8) | ((registers[0] >> 8) & 0xFF));
+            combined_value64 = val64_78563412;
+        } else {
+            ESP_LOGE(TAG, "FLOAT64 unsupported byte order: %s", actual_byte_order);
+            return ESP_ERR_INVALID_ARG;
+        }
+        
+        // Convert to IEEE 754 double precision
+        union {
+            uint64_t i;
+            double d;
+        } converter64;
+        converter64.i = combined_value64;
+        
+        *raw_value = (uint32_t)(combined_value64 & 0xFFFFFFFF);  // Store lower 32 bits for compatibility
+        *result = converter64.d * scale_factor;
+        ESP_LOGI(TAG, "FLOAT64: Raw=0x%016" PRIX64 " (%.6f) -> %.6f", combined_value64, converter64.d, *result);
+        
+    } else {
+        // Calculate expected register count for better error message
+        int expected_regs = 1;  // Default for INT16/UINT16
+        if (strcmp(actual_data_type, "UINT32") == 0 || strcmp(actual_data_type, "INT32") == 0 || strcmp(actual_data_type, "FLOAT32") == 0) {
+            expected_regs = 2;
+        } else if (strcmp(actual_data_type, "FLOAT64") == 0 || strcmp(actual_data_type, "INT64") == 0 || strcmp(actual_data_type, "UINT64") == 0) {
+            expected_regs = 4;
+        }
+        
+        ESP_LOGE(TAG, "Unsupported data type or insufficient registers: %s -> %s (need %d, have %d)", 
+                 data_type, actual_data_type, expected_regs, reg_count);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return ESP_OK;
+}
+
+// Decode a block of raw registers according to the sensor configuration.
+// Shared by the live test path and the coalesced poll, which hands in a slice
+// of a larger window read.
+esp_err_t legacy_sensor_decode_registers(const sensor_config_t *sensor, const uint16_t *registers,
+                                  int reg_count, sensor_test_result_t *result)
+{
+    if (!sensor || !registers || !result) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (reg_count < sensor->quantity) {
+        result->success = false;
+        snprintf(result->error_message, sizeof(result->error_message), 
+                "Insufficient registers received: got %d, expected %d", reg_count, sensor->quantity);
+        return ESP_FAIL;
+    }
+
+    // Create hex representation
+    char hex_buf[64] = {0};
+    for (int i = 0; i < reg_count && i < 12; i++) {
+        char temp[8];
+        snprintf(temp, sizeof(temp), "%04X ", registers[i]);
+        strncat(hex_buf, temp, sizeof(hex_buf) - strlen(hex_buf) - 1);
+    }
+    strncpy(result->raw_hex, hex_buf, sizeof(result->raw_hex) - 1);
+
+    // Special handling for Flow-Meter sensors (4 registers: UINT32_BADC + FLOAT32_BADC)
+    if (strcmp(sensor->sensor_type, "Flow-Meter") == 0 && reg_count >= 4) {
+        // Flow-Meter reads 4 registers:
+        // Registers [0-1]: Cumulative Flow Integer part (32-bit UINT, BADC word-swapped)
+        // Registers [2-3]: Cumulative Flow Decimal part (32-bit FLOAT, BADC word-swapped)
+        // Example: 33073.865 m³ = 33073 (registers[0-1]) + 0.865 (float in registers[2-3])
+
+        // Integer part: BADC format (word-swapped) = (reg[1] << 16) | reg[0]
+        uint32_t integer_part_raw = ((uint32_t)registers[1] << 16) | registers[0];
+        double integer_part = (double)integer_part_raw;
+
+        // Decimal part: BADC format (word-swapped) = (reg[3] << 16) | reg[2]
+        uint32_t float_bits = ((uint32_t)registers[3] << 16) | registers[2];
+        float decimal_part_float;
+        memcpy(&decimal_part_float, &float_bits, sizeof(float));
+        double decimal_part = (double)decimal_part_float;
+
+        // Sum integer and decimal parts, then apply scale factor
+        result->scaled_value = (integer_part + decimal_part) * sensor->scale_factor;
+        result->raw_value = integer_part_raw; // Store integer part as raw value
+
+        ESP_LOGI(TAG, "Flow-Meter Calculation: Integer=0x%08lX(%lu) + Decimal(FLOAT)=0x%08lX(%.6f) = %.6f",
+                 (unsigned long)integer_part_raw, (unsigned long)integer_part_raw,
+                 (unsigned long)float_bits, decimal_part, result->scaled_value);
+    }
+    // Special handling for ZEST sensors (AquaGen Flow Meter format)
+    else if (strcmp(sensor->sensor_type, "ZEST") == 0 && reg_count >= 4) {
+        // ZEST reads 4 registers (per AquaGen Modbus documentation):
+        // Register [0] @ 0x1019: Cumulative Flow Integer part (16-bit UINT)
+        // Register [1]: Unused (0x0000)
+        // Registers [2,3] @ 0x101B-101C: Cumulative Flow Decimal part (FLOAT32, IEEE 754 Big Endian)
+        // Example: 43.675 m³ = 43 (register[0]) + 0.675 (float in registers[2-3])
+
+        // First register contains the integer part (16-bit value)
+        uint32_t integer_part_raw = (uint32_t)registers[0];
+        double integer_part = (double)integer_part_raw;
+
+        // Registers 2-3 contain decimal part as 32-bit FLOAT Big Endian (ABCD)
+        // Convert to IEEE 754 float: registers[2] is HIGH word, registers[3] is LOW word
+        uint32_t float_bits = ((uint32_t)registers[2] << 16) | registers[3];
+        float decimal_part_float;
+        memcpy(&decimal_part_float, &float_bits, sizeof(float));
+        double decimal_part = (double)decimal_part_float;
+
+        // Sum integer and decimal parts, then apply scale factor
+        result->scaled_value = (integer_part + decimal_part) * sensor->scale_factor;
+        result->raw_value = integer_part_raw; // Store integer part as raw value
+
+        ESP_LOGI(TAG, "ZEST Calculation: Integer=0x%04X(%lu) + Decimal(FLOAT)=0x%08lX(%.6f) = %.6f",
+                 (unsigned int)integer_part_raw, (unsigned long)integer_part_raw,
+                 (unsigned long)float_bits, decimal_part, result->scaled_value);
+    }
+    // Special handling for Panda USM sensors (64-bit double format)
+    else if (strcmp(sensor->sensor_type, "Panda_USM") == 0 && reg_count >= 4) {
+        // Panda USM stores net volume as 64-bit double at register 4
+        // Big-endian format: registers[0] = MSW, registers[3] = LSW
+        uint64_t combined_value64 = ((uint64_t)registers[0] << 48) |
+                                   ((uint64_t)registers[1] << 32) |
+                                   ((uint64_t)registers[2] << 16) |
+                                   registers[3];
+
+        // Convert to double
+        double net_volume;
+        memcpy(&net_volume, &combined_value64, sizeof(double));
+
+        // Apply scale factor
+        result->scaled_value = net_volume * sensor->scale_factor;
+        result->raw_value = (uint32_t)(combined_value64 >> 32); // Store upper 32 bits as raw value
+
+        ESP_LOGI(TAG, "Panda USM Calculation: DOUBLE64=0x%016llX = %.6f m³",
+                 (unsigned long long)combined_value64, result->scaled_value);
+    }
+    // Special handling for Clampon flow meters (4 registers: UINT32_BADC + FLOAT32_BADC)
+    else if (strcmp(sensor->sensor_type, "Clampon") == 0 && reg_count >= 4) {
+        // Clampon reads 4 registers:
+        // Registers [0-1]: Cumulative Flow Integer part (32-bit UINT, BADC word-swapped)
+        // Registers [2-3]: Cumulative Flow Decimal part (32-bit FLOAT, BADC word-swapped)
+        // Example: 33073.865 m³ = 33073 (registers[0-1]) + 0.865 (float in registers[2-3])
+
+        // Integer part: BADC format (word-swapped) = (reg[1] << 16) | reg[0]
+        uint32_t integer_part_raw = ((uint32_t)registers[1] << 16) | registers[0];
+        double integer_part = (double)integer_part_raw;
+
+        // Decimal part: BADC format (word-swapped) = (reg[3] << 16) | reg[2]
+        uint32_t float_bits = ((uint32_t)registers[3] << 16) | registers[2];
+        float decimal_part_float;
+        memcpy(&decimal_part_float, &float_bits, sizeof(float));
+        double decimal_part = (double)decimal_part_float;
+
+        // Sum integer and decimal parts, then apply scale factor
+        result->scaled_value = (integer_part + decimal_part) * sensor->scale_factor;
+        result->raw_value = integer_part_raw; // Store integer part as raw value
+
+        ESP_LOGI(TAG, "Clampon Calculation: Integer=0x%08lX(%lu) + Decimal(FLOAT)=0x%08lX(%.6f) = %.6f",
+                 (unsigned long)integer_part_raw, (unsigned long)integer_part_raw,
+                 (unsigned long)float_bits, decimal_part, result->scaled_value);
+    }
+    // Special handling for Dailian EMF flow meters (2 registers: UINT32 word-swapped totaliser)
+    else if (strcmp(sensor->sensor_type, "Dailian_EMF") == 0 && reg_count >= 2) {
+        // Dailian EMF reads 2 registers at address 0x07D6 (2006):
+        // Registers [0-1]: Totaliser value (32-bit UINT, word-swapped)
+        // Format: (reg[1] << 16) | reg[0]
+
+        // Totaliser: word-swapped = (reg[1] << 16) | reg[0]
+        uint32_t totaliser_raw = ((uint32_t)registers[1] << 16) | registers[0];
+
+        // Apply scale factor
+        result->scaled_value = (double)totaliser_raw * sensor->scale_factor;
+        result->raw_value = totaliser_raw;
+
+        ESP_LOGI(TAG, "Dailian_EMF Calculation: Totaliser=0x%08lX(%lu) * %.6f = %.6f",
+                 (unsigned long)totaliser_raw, (unsigned long)totaliser_raw,
+                 sensor->scale_factor, result->scaled_value);
+    }
+    // Special handling for Panda EMF flow meters (4 registers: INT32_BE + FLOAT32_BE)
+    else if (strcmp(sensor->sensor_type, "Panda_EMF") == 0 && reg_count >= 4) {
+        // Panda EMF reads 4 registers at address 0x1012 (4114):
+        // Registers [0-1]: Totalizer integer part (32-bit INT, big-endian)
+        // Registers [2-3]: Totalizer decimal part (32-bit FLOAT, big-endian)
+        // Total = integer_part + float_decimal
+
+        // Integer part: Big-endian = (reg[0] << 16) | reg[1]
+        int32_t integer_part = (int32_t)(((uint32_t)registers[0] << 16) | registers[1]);
+        double integer_value = (double)integer_part;
+
+        // Decimal part: Big-endian = (reg[2] << 16) | reg[3]
+        uint32_t float_bits = ((uint32_t)registers[2] << 16) | registers[3];
+        float decimal_part_float;
+        memcpy(&decimal_part_float, &float_bits, sizeof(float));
+        double decimal_value = (double)decimal_part_float;
+
+        // Sum integer and decimal parts, then apply scale factor
+        result->scaled_value = (integer_value + decimal_value) * sensor->scale_factor;
+        result->raw_value = (uint32_t)integer_part; // Store integer part as raw value
+
+        ESP_LOGI(TAG, "Panda_EMF Calculation: Integer=0x%08lX(%ld) + Decimal(FLOAT)=0x%08lX(%.6f) = %.6f",
+                 (unsigned long)((uint32_t)integer_part), (long)integer_part,
+                 (unsigned long)float_bits, decimal_value, result->scaled_value);
+    }
+    // Special handling for Panda Level sensors (1 register: UINT16 level value)
+    else if (strcmp(sensor->sensor_type, "Panda_Level") == 0 && reg_count >= 1) {
+        // Panda Level reads 1 register at address 0x0001 (1):
+        // Register [0]: Level value (distance from sensor to water surface)
+        // Calculation: Level % = ((Sensor Height - Raw Value) / Tank Height) * 100
+
+        // Raw level value (distance reading)
+        uint16_t raw_level = registers[0];
+        double level_value = (double)raw_level;
+
+        // Apply the level calculation if sensor_height and max_water_level are set
+        if (sensor->max_water_level > 0) {
+            // Level % = ((Sensor Height - Raw Value) / Tank Height) * 100
+            result->scaled_value = ((sensor->sensor_height - level_value) / sensor->max_water_level) * 100.0;
+            // Clamp to 0-100% range
+            if (result->scaled_value < 0) result->scaled_value = 0.0;
+            if (result->scaled_value > 100) result->scaled_value = 100.0;
+        } else {
+            // If no tank height set, just return raw value scaled
+            result->scaled_value = level_value * sensor->scale_factor;
+        }
+        result->raw_value = raw_level;
+
+        ESP_LOGI(TAG, "Panda_Level Calculation: Raw=%u, SensorHeight=%.2f, TankHeight=%.2f, Level%%=%.2f",
+                 raw_level, sensor->sensor_height, sensor->max_water_level, result->scaled_value);
+    } else {
+        // Convert the data using standard conversion
+        esp_err_t conv_result = legacy_convert_modbus_data(registers, reg_count,
+                                                   sensor->data_type, sensor->byte_order,
+                                                   sensor->scale_factor,
+                                                   &result->scaled_value, &result->raw_value);
+
+        if (conv_result != ESP_OK) {
+            result->success = false;
+            snprintf(result->error_message, sizeof(result->error_message), 
+                    "Data conversion failed");
+            return conv_result;
+        }
+    }
+
+
+    result->success = true;
+    return ESP_OK;
+}
+
@@ -0,0 +1,17 @@
+// legacy_sensor_decoder.h - Interpreted decoder the compiled one replaced
+// Reference for the host decoder tests and benchmark, see legacy_sensor_decoder.c
+
+#ifndef LEGACY_SENSOR_DECODER_H
+#define LEGACY_SENSOR_DECODER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "sensor_manager.h"
+
+esp_err_t legacy_convert_modbus_data(const uint16_t *registers, int reg_count,
+                                     const char *data_type, const char *byte_order,
+                                     double scale_factor, double *result, uint32_t *raw_value);
+esp_err_t legacy_sensor_decode_registers(const sensor_config_t *sensor, const uint16_t *registers,
+                                         int reg_count, sensor_test_result_t *result);
+
+#endif // LEGACY_SENSOR_DECODER_H
@@ -0,0 +1,32 @@
+// modbus_crc_variants.h - Every MODBUS_CRC_IMPL built side by side
+// host/CMakeLists.txt compiles main/modbus_crc.c once per implementation with
+// its functions renamed; the firmware build links exactly one of them.
+
+#ifndef MODBUS_CRC_VARIANTS_H
+#define MODBUS_CRC_VARIANTS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+uint16_t modbus_crc_update_bitwise(uint16_t crc, const uint8_t *data, size_t length);
+uint16_t modbus_crc_update_byte_bitwise(uint16_t crc, uint8_t byte);
+uint16_t modbus_crc_update_table(uint16_t crc, const uint8_t *data, size_t length);
+uint16_t modbus_crc_update_byte_table(uint16_t crc, uint8_t byte);
+uint16_t modbus_crc_update_slice4(uint16_t crc, const uint8_t *data, size_t length);
+uint16_t modbus_crc_update_byte_slice4(uint16_t crc, uint8_t byte);
+
+typedef struct {
+    const char *name;
+    uint16_t (*update)(uint16_t crc, const uint8_t *data, size_t length);
+    uint16_t (*update_byte)(uint16_t crc, uint8_t byte);
+} modbus_crc_variant_t;
+
+static const modbus_crc_variant_t modbus_crc_variants[] = {
+    { "bitwise", modbus_crc_update_bitwise, modbus_crc_update_byte_bitwise },
+    { "table", modbus_crc_update_table, modbus_crc_update_byte_table },
+    { "slice4", modbus_crc_update_slice4, modbus_crc_update_byte_slice4 },
+};
+
+#define MODBUS_CRC_VARIANT_COUNT (sizeof(modbus_crc_variants) / sizeof(modbus_crc_variants[0]))
+
+#endif // MODBUS_CRC_VARIANTS_H
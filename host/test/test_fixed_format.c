@@ -0,0 +1,161 @@
+// test_fixed_format.c - fixed_format() against snprintf("%.*f")
+// Golden strings for the rounding cases the integer path has to get right,
+// then every decimal count on tie, boundary and random values, each compared
+// byte for byte with the C library. Values outside the integer path (NaN,
+// infinities, |v| >= 2^53, more than FIXED_FORMAT_MAX_DECIMALS) must still
+// match, through the snprintf fallback. The size contract (return value,
+// truncation, NUL) is checked like snprintf's.
+
+#include "host_test.h"
+#include "fixed_format.h"
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+#define RANDOM_VALUES 200000
+
+static int mismatches;
+
+static void check_value(double value, int decimals)
+{
+    char expected[512], actual[512];
+    int expected_len = snprintf(expected, sizeof(expected), "%.*f", decimals, value);
+    int actual_len = fixed_format(actual, sizeof(actual), value, decimals);
+    test_checks++;
+    if (actual_len != expected_len || strcmp(actual, expected) != 0) {
+        test_failures++;
+        if (mismatches++ < 20) {
+            fprintf(stderr, "fixed_format(%a, %d) == \"%s\" (%d), expected \"%s\" (%d)\n",
+                    value, decimals, actual, actual_len, expected, expected_len);
+        }
+    }
+}
+
+static void check_all_decimals(double value)
+{
+    for (int decimals = 0; decimals <= FIXED_FORMAT_MAX_DECIMALS + 2; decimals++) {
+        check_value(value, decimals);
+        check_value(-value, decimals);
+    }
+}
+
+static void test_golden(void)
+{
+    static const struct {
+        double value;
+        int decimals;
+        const char *text;
+    } golden[] = {
+        // Exact ties round half to even, like printf
+        { 0.5, 0, "0" }, { 1.5, 0, "2" }, { 2.5, 0, "2" }, { -2.5, 0, "-2" },
+        { 0.125, 2, "0.12" }, { 0.375, 2, "0.38" }, { -0.625, 2, "-0.62" },
+        // Not ties: 2.675, 1.005 and 9.995 are stored just below, 0.005 and 99.995 just above
+        { 0.005, 2, "0.01" }, { 2.675, 2, "2.67" }, { 1.005, 2, "1.00" },
+        { 9.995, 2, "9.99" }, { 99.995, 2, "100.00" }, { 0.9999999, 6, "1.000000" },
+        // Negatives, including those that round to zero
+        { -0.0, 2, "-0.00" }, { -0.004, 2, "-0.00" }, { -0.006, 2, "-0.01" }, { -49.5, 0, "-50" },
+        // Values from the payload examples
+        { 265.23, 2, "265.23" }, { 49.4, 0, "49" }, { 24.1968355, 6, "24.196835" },
+        // Largest value on the integer path, and the first one past it
+        { 9007199254740991.0, 2, "9007199254740991.00" },
+        { -9007199254740991.0, 0, "-9007199254740991" },
+        { 9007199254740992.0, 1, "9007199254740992.0" },
+        { 4503599627370495.5, 0, "4503599627370496" },
+        // Tiny values
+        { 5e-324, 9, "0.000000000" }, { 4.9e-10, 9, "0.000000000" }, { 5e-10, 9, "0.000000001" },
+    };
+    for (size_t i = 0; i < sizeof(golden) / sizeof(golden[0]); i++) {
+        char out[FIXED_FORMAT_BUF_SIZE];
+        fixed_format(out, sizeof(out), golden[i].value, golden[i].decimals);
+        CHECK_EQ_STR(out, golden[i].text);
+        check_value(golden[i].value, golden[i].decimals);
+    }
+}
+
+static void test_edges(void)
+{
+    static const double edges[] = {
+        0.0, 1.0, 0.1, 0.01, 0.05, 0.15, 0.25, 0.35, 0.45, 0.55, 0.65, 0.75, 0.85, 0.95,
+        0.5, 1.5, 2.5, 3.5, 1e-9, 5e-10, 1e-10, 0.0000000005, 0.9999999995, 0.99999999949,
+        4294967295.0, 4294967295.5, 4294967296.0, 18446744073709551615.0,
+        9007199254740991.0, 9007199254740991.5, 9007199254740992.0, 9007199254740993.0,
+        4503599627370495.5, 4503599627370496.5, 1e15 + 0.5, 1e16, 1e22, 1e300, DBL_MAX,
+        DBL_MIN, DBL_MIN / 2, DBL_TRUE_MIN, DBL_EPSILON,
+        NAN, INFINITY,
+    };
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        check_all_decimals(edges[i]);
+        check_all_decimals(nextafter(edges[i], 0));
+        check_all_decimals(nextafter(edges[i], INFINITY));
+    }
+
+    // Every exact tie at each decimal count: odd multiples of 5 * 10^-(d+1)
+    for (int decimals = 0; decimals <= FIXED_FORMAT_MAX_DECIMALS; decimals++) {
+        for (int k = 1; k < 2000; k += 2) {
+            check_value(k * 0.5 * pow(10, -decimals), decimals);
+            check_value(-(k * 0.5 * pow(10, -decimals)), decimals);
+        }
+    }
+    // Halves up to 2^53, where the integer part decides the tie
+    for (int shift = 0; shift < 53; shift++) {
+        double v = ldexp(1.0, shift) - 0.5;
+        check_all_decimals(v);
+    }
+}
+
+// Register-decoded readings: decimal fractions of every scale, and raw bits
+static void test_random(void)
+{
+    for (int i = 0; i < RANDOM_VALUES; i++) {
+        int scale = rand() % 10;
+        double value = (double)(rand() % 2000000001 - 1000000000) / pow(10, scale);
+        check_all_decimals(value);
+
+        uint64_t bits = ((uint64_t)rand() << 62) ^ ((uint64_t)rand() << 31) ^ (uint64_t)rand();
+        // Mostly the integer path's exponents (|v| < 2^53), some beyond it
+        if (rand() % 8) {
+            int exponent = 1023 - 40 + rand() % 93;
+            bits = (bits & ~(0x7FFULL << 52)) | ((uint64_t)exponent << 52);
+        }
+        memcpy(&value, &bits, sizeof(value));
+        check_value(value, rand() % (FIXED_FORMAT_MAX_DECIMALS + 3));
+    }
+}
+
+// Same contract as snprintf: full length returned, at most size - 1 written
+static void test_size_contract(void)
+{
+    static const double values[] = { 265.23, -0.5, 9007199254740991.0, 1e300, NAN };
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        for (int decimals = 0; decimals <= FIXED_FORMAT_MAX_DECIMALS; decimals += 3) {
+            for (size_t size = 0; size <= 24; size++) {
+                char expected[32], actual[32];
+                memset(expected, '#', sizeof(expected));
+                memset(actual, '#', sizeof(actual));
+                int expected_len = snprintf(size ? expected : NULL, size, "%.*f", decimals, values[i]);
+                int actual_len = fixed_format(size ? actual : NULL, size, values[i], decimals);
+                CHECK_EQ_INT(actual_len, expected_len);
+                CHECK(memcmp(actual, expected, sizeof(actual)) == 0);
+            }
+        }
+    }
+
+    // Negative precision is ignored by printf, i.e. 6 decimals
+    char out[FIXED_FORMAT_BUF_SIZE];
+    CHECK_EQ_INT(fixed_format(out, sizeof(out), 3.25, -1), 8);
+    CHECK_EQ_STR(out, "3.250000");
+
+    // The widest output of the integer path fits FIXED_FORMAT_BUF_SIZE
+    CHECK_EQ_INT(fixed_format(out, sizeof(out), -9007199254740991.0, FIXED_FORMAT_MAX_DECIMALS), 27);
+    CHECK_EQ_STR(out, "-9007199254740991.000000000");
+}
+
+int main(void)
+{
+    srand(19);
+    test_golden();
+    test_edges();
+    test_random();
+    test_size_contract();
+    return TEST_RESULT();
+}
@@ -0,0 +1,365 @@
+// test_json_templates.c - Writer-built payloads against the snprintf templates they replaced
+// create_json_payload(), the generate_*_json() wrappers and the compiled
+// templates are run on random and edge-case readings for every sensor type
+// next to the verbatim old code, and must produce the same bytes. The
+// intended differences (escaping, non-finite and very wide values, overflow)
+// are checked separately. The streaming path is checked against the buffered one with a
+// scratch buffer smaller than a single document.
+
+#include "host_test.h"
+#include "json_templates.h"
+#include "legacy_json_templates.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#define FUZZ_CASES 20000
+
+static const char *const sensor_types[] = {
+    "Flow-Meter", "Panda_USM", "ZEST", "Level", "Piezometer", "RAINGAUGE", "BOREWELL",
+    "ENERGY", "power", "QUALITY", "",
+};
+#define SENSOR_TYPE_COUNT (sizeof(sensor_types) / sizeof(sensor_types[0]))
+
+static const json_template_type_t json_types[] = {
+    JSON_TYPE_FLOW, JSON_TYPE_LEVEL, JSON_TYPE_RAINGAUGE, JSON_TYPE_BOREWELL, JSON_TYPE_ENERGY, JSON_TYPE_QUALITY,
+};
+#define JSON_TYPE_COUNT (sizeof(json_types) / sizeof(json_types[0]))
+
+// Values where "%.*f" rounding is easiest to get wrong, plus the range
+// readings actually take
+static double random_value(void)
+{
+    static const double edges[] = {
+        0.0, -0.0, 0.005, 0.015, 0.125, 0.5, 1.5, 2.5, -2.5, 0.994999, 0.995, 9.995, 99.995,
+        -0.004, -0.006, 265.23, 1287.0, 24.1968355, 4294967295.0, -2147483648.0,
+        123456789.987654321, 9007199254740991.0, 9007199254740993.0, 1e17, -3.5e18, 1e-7, 5e-324,
+    };
+    switch (rand() % 4) {
+        case 0:
+            return edges[rand() % (sizeof(edges) / sizeof(edges[0]))];
+        case 1:
+            return (double)(rand() % 2000000 - 1000000) / 100.0;
+        case 2:
+            return ((double)rand() / RAND_MAX - 0.5) * pow(10, rand() % 13);
+        default: {
+            // Any finite double below 1e20; wider ones are an intended difference
+            uint64_t bits = ((uint64_t)rand() << 62) ^ ((uint64_t)rand() << 31) ^ (uint64_t)rand();
+            double v;
+            memcpy(&v, &bits, sizeof(v));
+            return isfinite(v) ? fmod(v, 1e20) : 1.0;
+        }
+    }
+}
+
+static void random_text(char *out, size_t size, const char *alphabet)
+{
+    size_t len = (size_t)rand() % size;
+    size_t n = strlen(alphabet);
+    for (size_t i = 0; i < len; i++) {
+        out[i] = alphabet[rand() % n];
+    }
+    out[len] = '\0';
+}
+
+#define ID_CHARS "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_-. "
+#define HEX_CHARS "0123456789ABCDEF "
+
+static void random_params(json_params_t *params)
+{
+    memset(params, 0, sizeof(*params));
+    params->type = json_types[rand() % JSON_TYPE_COUNT];
+    random_text(params->unit_id, sizeof(params->unit_id), ID_CHARS);
+    params->scaled_value = random_value();
+    params->raw_value = (uint32_t)rand() ^ ((uint32_t)rand() << 16);
+    params->slave_id = rand() % 300 - 20;
+    format_timestamp_iso8601(params->timestamp, sizeof(params->timestamp));
+    if (rand() % 2) {
+        random_text(params->extra_params.meter_id, sizeof(params->extra_params.meter_id), ID_CHARS);
+    }
+    if (rand() % 2) {
+        random_text(params->extra_params.hex_string, sizeof(params->extra_params.hex_string), HEX_CHARS);
+    }
+    if (rand() % 2) {
+        params->extra_params.ph_value = random_value();
+        params->extra_params.tds_value = random_value();
+        params->extra_params.temp_value = random_value();
+        params->extra_params.humidity_value = random_value();
+        params->extra_params.tss_value = random_value();
+        params->extra_params.bod_value = random_value();
+        params->extra_params.cod_value = random_value();
+    }
+}
+
+static void random_sensor(sensor_config_t *sensor)
+{
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->enabled = true;
+    random_text(sensor->name, sizeof(sensor->name), ID_CHARS);
+    random_text(sensor->unit_id, sizeof(sensor->unit_id), ID_CHARS);
+    if (sensor->unit_id[0] == '\0') {
+        strcpy(sensor->unit_id, "FG24708F");
+    }
+    sensor->slave_id = 1 + rand() % 247;
+    strcpy(sensor->sensor_type, sensor_types[rand() % SENSOR_TYPE_COUNT]);
+    if (rand() % 2) {
+        random_text(sensor->meter_type, sizeof(sensor->meter_type), ID_CHARS);
+    }
+}
+
+// Both documents carry time(NULL); a pair built across a second boundary is redone
+#define SAME_SECOND(start) (time(NULL) == (start))
+
+static int payload_mismatches;
+
+static void check_payload(const json_params_t *params)
+{
+    char expected[MAX_JSON_PAYLOAD_SIZE];
+    char actual[MAX_JSON_PAYLOAD_SIZE];
+    esp_err_t expected_ret, actual_ret;
+    time_t start;
+    do {
+        start = time(NULL);
+        expected_ret = legacy_create_json_payload(params, expected, sizeof(expected));
+        actual_ret = create_json_payload(params, actual, sizeof(actual));
+    } while (!SAME_SECOND(start));
+
+    CHECK_EQ_INT(actual_ret, expected_ret);
+    if (expected_ret == ESP_OK && actual_ret == ESP_OK && strcmp(actual, expected) != 0) {
+        if (payload_mismatches++ < 10) {
+            CHECK_EQ_STR(actual, expected);
+        } else {
+            test_failures++;
+        }
+    }
+}
+
+static void test_golden_payloads(void)
+{
+    // The examples in the template comments
+    json_params_t params = {0};
+    params.type = JSON_TYPE_FLOW;
+    strcpy(params.unit_id, "FG24708F");
+    strcpy(params.timestamp, "2025-11-24T12:05:05Z");
+    params.scaled_value = 265.23;
+    char out[MAX_JSON_PAYLOAD_SIZE];
+    CHECK_EQ_INT(create_json_payload(&params, out, sizeof(out)), ESP_OK);
+    CHECK_EQ_STR(out, "{\"unit_id\":\"FG24708F\",\"type\":\"FLOW\",\"consumption\":\"265.23\","
+                      "\"created_on\":\"2025-11-24T12:05:05Z\"}");
+    check_payload(&params);
+
+    params.type = JSON_TYPE_LEVEL;
+    strcpy(params.unit_id, "FG24769L");
+    strcpy(params.timestamp, "2025-11-24T12:04:16Z");
+    params.scaled_value = 49.4;
+    CHECK_EQ_INT(create_json_payload(&params, out, sizeof(out)), ESP_OK);
+    CHECK_EQ_STR(out, "{\"unit_id\":\"FG24769L\",\"created_on\":\"2025-11-24T12:04:16Z\",\"type\":\"LEVEL\","
+                      "\"level_filled\":49}");
+    check_payload(&params);
+
+    params.type = JSON_TYPE_QUALITY;
+    strcpy(params.unit_id, "TFG2235Q");
+    params.scaled_value = 7;
+    params.extra_params.tds_value = 100;
+    params.extra_params.temp_value = 32;
+    params.extra_params.humidity_value = 65;
+    params.extra_params.tss_value = 15;
+    params.extra_params.bod_value = 8;
+    params.extra_params.cod_value = 12;
+    check_payload(&params);
+
+    for (size_t t = 0; t < JSON_TYPE_COUNT; t++) {
+        json_params_t empty = { .type = json_types[t] };
+        check_payload(&empty);                  // Empty unit_id: rejected by both
+    }
+}
+
+static void test_random_payloads(void)
+{
+    for (int i = 0; i < FUZZ_CASES; i++) {
+        json_params_t params;
+        random_params(&params);
+        check_payload(&params);
+    }
+}
+
+static void test_sensor_documents(void)
+{
+    network_stats_t net_stats = { .signal_strength = -67, .network_type = "WiFi" };
+    int mismatches = 0;
+
+    for (int i = 0; i < FUZZ_CASES; i++) {
+        sensor_config_t sensor;
+        random_sensor(&sensor);
+        double value = random_value();
+        uint32_t raw = (uint32_t)rand() ^ ((uint32_t)rand() << 16);
+        char hex[32];
+        random_text(hex, sizeof(hex), HEX_CHARS);
+
+        json_sensor_template_t tpl;
+        CHECK_EQ_INT(json_template_compile(&sensor, &tpl), ESP_OK);
+
+        char expected[MAX_JSON_PAYLOAD_SIZE], expected_hex[MAX_JSON_PAYLOAD_SIZE];
+        char actual[MAX_JSON_PAYLOAD_SIZE], actual_hex[MAX_JSON_PAYLOAD_SIZE];
+        char rendered[JSON_TEMPLATE_DOC_SIZE], rendered_hex[JSON_TEMPLATE_DOC_SIZE];
+        time_t start;
+        do {
+            start = time(NULL);
+            json_template_values_t values = { .value = value, .raw_value = raw, .timestamp = start };
+            CHECK_EQ_INT(legacy_generate_sensor_json(&sensor, value, raw, &net_stats, expected, sizeof(expected)),
+                         ESP_OK);
+            CHECK_EQ_INT(generate_sensor_json(&sensor, value, raw, &net_stats, actual, sizeof(actual)), ESP_OK);
+            CHECK(json_template_render(&tpl, &values, rendered, sizeof(rendered)) > 0);
+
+            values.hex_string = hex;
+            CHECK_EQ_INT(legacy_generate_sensor_json_with_hex(&sensor, value, raw, hex, NULL,
+                                                              expected_hex, sizeof(expected_hex)), ESP_OK);
+            CHECK_EQ_INT(generate_sensor_json_with_hex(&sensor, value, raw, hex, NULL,
+                                                       actual_hex, sizeof(actual_hex)), ESP_OK);
+            CHECK(json_template_render(&tpl, &values, rendered_hex, sizeof(rendered_hex)) > 0);
+        } while (!SAME_SECOND(start));
+
+        if ((strcmp(actual, expected) != 0 || strcmp(rendered, expected) != 0 ||
+             strcmp(actual_hex, expected_hex) != 0 || strcmp(rendered_hex, expected_hex) != 0) &&
+            mismatches++ < 10) {
+            fprintf(stderr, "sensor type \"%s\", value %.17g, hex \"%s\"\n", sensor.sensor_type, value, hex);
+            CHECK_EQ_STR(actual, expected);
+            CHECK_EQ_STR(rendered, expected);
+            CHECK_EQ_STR(actual_hex, expected_hex);
+            CHECK_EQ_STR(rendered_hex, expected_hex);
+        }
+    }
+    CHECK_EQ_INT(mismatches, 0);
+}
+
+static void test_quality_documents(void)
+{
+    int mismatches = 0;
+    for (int i = 0; i < FUZZ_CASES; i++) {
+        sensor_reading_t reading = {0};
+        random_text(reading.unit_id, sizeof(reading.unit_id), ID_CHARS);
+        format_timestamp_iso8601(reading.timestamp, sizeof(reading.timestamp));
+        reading.quality_params.ph_value = random_value();
+        reading.quality_params.tds_value = random_value();
+        reading.quality_params.temp_value = random_value();
+        reading.quality_params.humidity_value = random_value();
+        reading.quality_params.tss_value = random_value();
+        reading.quality_params.bod_value = random_value();
+        reading.quality_params.cod_value = random_value();
+
+        char expected[MAX_JSON_PAYLOAD_SIZE], actual[MAX_JSON_PAYLOAD_SIZE];
+        CHECK_EQ_INT(legacy_generate_quality_sensor_json(&reading, expected, sizeof(expected)), ESP_OK);
+        CHECK_EQ_INT(generate_quality_sensor_json(&reading, actual, sizeof(actual)), ESP_OK);
+        if (strcmp(actual, expected) != 0 && mismatches++ < 10) {
+            CHECK_EQ_STR(actual, expected);
+        }
+    }
+    CHECK_EQ_INT(mismatches, 0);
+}
+
+// Where the writer deliberately departs from the old templates
+static void test_intended_differences(void)
+{
+    json_params_t params = {0};
+    params.type = JSON_TYPE_FLOW;
+    strcpy(params.unit_id, "A\"B\\C\n");
+    strcpy(params.timestamp, "2025-11-24T12:05:05Z");
+    params.scaled_value = NAN;
+    char out[MAX_JSON_PAYLOAD_SIZE];
+    CHECK_EQ_INT(create_json_payload(&params, out, sizeof(out)), ESP_OK);
+    // The old template wrote the raw characters and "nan", neither of them JSON
+    CHECK_EQ_STR(out, "{\"unit_id\":\"A\\\"B\\\\C\\n\",\"type\":\"FLOW\",\"consumption\":null,"
+                      "\"created_on\":\"2025-11-24T12:05:05Z\"}");
+
+    params.type = JSON_TYPE_LEVEL;
+    strcpy(params.unit_id, "L1");
+    params.scaled_value = -INFINITY;
+    CHECK_EQ_INT(create_json_payload(&params, out, sizeof(out)), ESP_OK);
+    CHECK_EQ_STR(out, "{\"unit_id\":\"L1\",\"created_on\":\"2025-11-24T12:05:05Z\",\"type\":\"LEVEL\","
+                      "\"level_filled\":null}");
+
+    // Too wide for "%.*f" in the writer's number buffer: "%.17g" instead
+    params.scaled_value = 1e40;
+    CHECK_EQ_INT(create_json_payload(&params, out, sizeof(out)), ESP_OK);
+    CHECK_EQ_STR(out, "{\"unit_id\":\"L1\",\"created_on\":\"2025-11-24T12:05:05Z\",\"type\":\"LEVEL\","
+                      "\"level_filled\":1e+40}");
+
+    // The old template truncated silently; the writer reports it and leaves no partial document
+    params.scaled_value = 1;
+    CHECK_EQ_INT(create_json_payload(&params, out, 40), ESP_ERR_NO_MEM);
+    CHECK_EQ_STR(out, "");
+}
+
+typedef struct {
+    char doc[8192];
+    size_t len;
+    int calls;
+} sink_buffer_t;
+
+static bool collect(void *ctx, const char *data, size_t len)
+{
+    sink_buffer_t *sink = ctx;
+    if (sink->len + len >= sizeof(sink->doc)) {
+        return false;
+    }
+    memcpy(sink->doc + sink->len, data, len);
+    sink->len += len;
+    sink->calls++;
+    return true;
+}
+
+// A telemetry batch streamed through a 48-byte scratch buffer
+static void test_streaming(void)
+{
+    sensor_config_t sensors[20];
+    for (int i = 0; i < 20; i++) {
+        random_sensor(&sensors[i]);
+    }
+
+    for (int attempt = 0; attempt < 3; attempt++) {
+        time_t start = time(NULL);
+        char whole[8192];
+        json_writer_t w;
+        json_writer_init(&w, whole, sizeof(whole), NULL, NULL);
+        json_writer_begin_array(&w);
+        for (int i = 0; i < 20; i++) {
+            write_sensor_json(&w, &sensors[i], i * 12.5, (uint32_t)i, "0001 A2F3", NULL);
+        }
+        json_writer_end_array(&w);
+        CHECK_EQ_INT(json_writer_finish(&w), ESP_OK);
+
+        char scratch[48];
+        sink_buffer_t sink = {0};
+        json_writer_init(&w, scratch, sizeof(scratch), collect, &sink);
+        json_writer_begin_array(&w);
+        for (int i = 0; i < 20; i++) {
+            write_sensor_json(&w, &sensors[i], i * 12.5, (uint32_t)i, "0001 A2F3", NULL);
+        }
+        json_writer_end_array(&w);
+        CHECK_EQ_INT(json_writer_finish(&w), ESP_OK);
+        sink.doc[sink.len] = '\0';
+
+        if (SAME_SECOND(start)) {
+            CHECK_EQ_STR(sink.doc, whole);
+            CHECK(sink.calls > 20);
+            return;
+        }
+    }
+    CHECK(false);
+}
+
+int main(void)
+{
+    host_log_level = ESP_LOG_NONE;      // Every document is logged, empty unit IDs at ERROR
+    srand(18);
+
+    test_golden_payloads();
+    test_random_payloads();
+    CHECK_EQ_INT(payload_mismatches, 0);
+    test_sensor_documents();
+    test_quality_documents();
+    test_intended_differences();
+    test_streaming();
+    return TEST_RESULT();
+}
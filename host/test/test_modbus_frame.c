@@ -0,0 +1,338 @@
+// test_modbus_frame.c - RTU frame assembly, alone and behind the Modbus master
+// The assembler is fed frames whole, byte by byte and in random splits, with
+// and without the inter-frame gap; a scripted port then replays the same
+// deliveries through modbus.c to check results and statistics.
+
+#include "host_test.h"
+#include "modbus.h"
+#include "modbus_crc.h"
+#include "modbus_frame.h"
+#include "modbus_port.h"
+#include <stdlib.h>
+
+static size_t build_frame(uint8_t *frame, const uint8_t *pdu, size_t length)
+{
+    memcpy(frame, pdu, length);
+    uint16_t crc = modbus_crc_update(MODBUS_CRC_INIT, pdu, length);
+    frame[length] = (uint8_t)(crc & 0xFF);
+    frame[length + 1] = (uint8_t)(crc >> 8);
+    return length + 2;
+}
+
+static size_t build_read_response(uint8_t *frame, uint8_t slave_id, uint8_t function_code, int registers)
+{
+    uint8_t pdu[3 + 2 * MODBUS_MAX_REGISTERS];
+    pdu[0] = slave_id;
+    pdu[1] = function_code;
+    pdu[2] = (uint8_t)(registers * 2);
+    for (int i = 0; i < registers; i++) {
+        pdu[3 + 2 * i] = (uint8_t)(0x10 + i);
+        pdu[4 + 2 * i] = (uint8_t)i;
+    }
+    return build_frame(frame, pdu, (size_t)(3 + registers * 2));
+}
+
+static void test_whole_and_byte_by_byte(void)
+{
+    uint8_t adu[MODBUS_FRAME_MAX_SIZE];
+    size_t length = build_read_response(adu, 1, MODBUS_READ_HOLDING_REGISTERS, 10);
+    modbus_frame_t frame;
+
+    modbus_frame_init(&frame, 1, MODBUS_READ_HOLDING_REGISTERS, 10);
+    CHECK_EQ_INT(modbus_frame_feed(&frame, adu, length), MODBUS_FRAME_COMPLETE);
+    CHECK(modbus_frame_crc_ok(&frame));
+    CHECK_EQ_INT(frame.length, length);
+
+    modbus_frame_init(&frame, 1, MODBUS_READ_HOLDING_REGISTERS, 10);
+    for (size_t i = 0; i < length; i++) {
+        CHECK_EQ_INT(modbus_frame_feed(&frame, &adu[i], 1),
+                     i + 1 < length ? MODBUS_FRAME_INCOMPLETE : MODBUS_FRAME_COMPLETE);
+    }
+    CHECK(modbus_frame_crc_ok(&frame));
+}
+
+// Random splits through the in-place receive path, for every read size
+static void test_random_splits(void)
+{
+    srand(21);
+    for (int registers = 1; registers <= MODBUS_MAX_REGISTERS; registers++) {
+        uint8_t adu[MODBUS_FRAME_MAX_SIZE];
+        size_t length = build_read_response(adu, 5, MODBUS_READ_INPUT_REGISTERS, registers);
+        modbus_frame_t frame;
+        modbus_frame_init(&frame, 5, MODBUS_READ_INPUT_REGISTERS, (uint16_t)registers);
+
+        size_t offset = 0;
+        modbus_frame_status_t status = MODBUS_FRAME_INCOMPLETE;
+        while (offset < length) {
+            size_t chunk = 1 + (size_t)rand() % 16;
+            if (chunk > length - offset) {
+                chunk = length - offset;
+            }
+            size_t space = 0;
+            uint8_t *tail = modbus_frame_tail(&frame, &space);
+            CHECK(tail != NULL && space >= chunk);
+            memcpy(tail, adu + offset, chunk);
+            status = modbus_frame_commit(&frame, chunk);
+            offset += chunk;
+            if (offset < length) {
+                CHECK_EQ_INT(status, MODBUS_FRAME_INCOMPLETE);
+            }
+        }
+        CHECK_EQ_INT(status, MODBUS_FRAME_COMPLETE);
+        CHECK(modbus_frame_crc_ok(&frame));
+        CHECK(memcmp(frame.data, adu, length) == 0);
+    }
+}
+
+static void test_gaps(void)
+{
+    uint8_t adu[MODBUS_FRAME_MAX_SIZE];
+    size_t length = build_read_response(adu, 1, MODBUS_READ_HOLDING_REGISTERS, 4);
+    modbus_frame_t frame;
+
+    // A gap inside a frame of known length does not end it
+    modbus_frame_init(&frame, 1, MODBUS_READ_HOLDING_REGISTERS, 4);
+    CHECK_EQ_INT(modbus_frame_feed(&frame, adu, 6), MODBUS_FRAME_INCOMPLETE);
+    CHECK_EQ_INT(modbus_frame_end_of_gap(&frame), MODBUS_FRAME_INCOMPLETE);
+    CHECK_EQ_INT(modbus_frame_feed(&frame, adu + 6, length - 6), MODBUS_FRAME_COMPLETE);
+    CHECK(modbus_frame_crc_ok(&frame));
+
+    // Unknown function codes are delimited by the gap alone
+    const uint8_t pdu[] = { 1, 0x2B, 0x0E, 0x01, 0x00, 0x55 };
+    length = build_frame(adu, pdu, sizeof(pdu));
+    modbus_frame_init(&frame, 1, 0x2B, 0);
+    CHECK_EQ_INT(modbus_frame_feed(&frame, adu, length), MODBUS_FRAME_INCOMPLETE);
+    CHECK_EQ_INT(modbus_frame_end_of_gap(&frame), MODBUS_FRAME_COMPLETE);
+    CHECK_EQ_INT(frame.length, length);
+    CHECK(modbus_frame_crc_ok(&frame));
+
+    // ...but a burst shorter than an exception frame is not a frame
+    modbus_frame_init(&frame, 1, 0x2B, 0);
+    CHECK_EQ_INT(modbus_frame_feed(&frame, adu, 3), MODBUS_FRAME_INCOMPLETE);
+    CHECK_EQ_INT(modbus_frame_end_of_gap(&frame), MODBUS_FRAME_INCOMPLETE);
+
+    CHECK_EQ_INT(modbus_frame_gap_us(9600), 4010);
+    CHECK_EQ_INT(modbus_frame_gap_us(19200), 2005);
+    CHECK_EQ_INT(modbus_frame_gap_us(115200), 1750);
+    CHECK_EQ_INT(modbus_frame_gap_us(0), 0);
+}
+
+static void test_exceptions_and_trailing_bytes(void)
+{
+    uint8_t adu[MODBUS_FRAME_MAX_SIZE + 8];
+    const uint8_t exception[] = { 1, MODBUS_READ_HOLDING_REGISTERS | 0x80, MODBUS_ILLEGAL_DATA_ADDRESS };
+    size_t length = build_frame(adu, exception, sizeof(exception));
+    modbus_frame_t frame;
+
+    // An exception is five bytes whatever the request asked for
+    modbus_frame_init(&frame, 1, MODBUS_READ_HOLDING_REGISTERS, 60);
+    CHECK_EQ_INT(modbus_frame_feed(&frame, adu, length), MODBUS_FRAME_COMPLETE);
+    CHECK(modbus_frame_is_exception(&frame));
+    CHECK(modbus_frame_crc_ok(&frame));
+
+    // Line noise after the frame is dropped and counted
+    length = build_read_response(adu, 1, MODBUS_READ_HOLDING_REGISTERS, 2);
+    adu[length] = 0xFF;
+    adu[length + 1] = 0x00;
+    modbus_frame_init(&frame, 1, MODBUS_READ_HOLDING_REGISTERS, 2);
+    CHECK_EQ_INT(modbus_frame_feed(&frame, adu, length + 2), MODBUS_FRAME_COMPLETE);
+    CHECK_EQ_INT(frame.length, length);
+    CHECK_EQ_INT(frame.discarded, 2);
+    CHECK(modbus_frame_crc_ok(&frame));
+
+    // Write echoes
+    const uint8_t echo[] = { 1, MODBUS_WRITE_MULTIPLE_REGISTERS, 0x00, 0x10, 0x00, 0x02 };
+    length = build_frame(adu, echo, sizeof(echo));
+    modbus_frame_init(&frame, 1, MODBUS_WRITE_MULTIPLE_REGISTERS, 2);
+    CHECK_EQ_INT(modbus_frame_feed(&frame, adu, length - 1), MODBUS_FRAME_INCOMPLETE);
+    CHECK_EQ_INT(modbus_frame_feed(&frame, adu + length - 1, 1), MODBUS_FRAME_COMPLETE);
+
+    // A frame whose length cannot be known fills the buffer and overflows
+    memset(adu, 0x5A, sizeof(adu));
+    modbus_frame_init(&frame, 1, 0x2B, 0);
+    CHECK_EQ_INT(modbus_frame_feed(&frame, adu, MODBUS_FRAME_MAX_SIZE + 1), MODBUS_FRAME_OVERFLOW);
+    size_t space = 1;
+    CHECK(modbus_frame_tail(&frame, &space) == NULL);
+    CHECK_EQ_INT(space, 0);
+}
+
+// Scripted port: each write queues a response, delivered in the given chunks
+// with a gap after the last one (or after every chunk when gap_each is set)
+#define SCRIPT_MAX_CHUNKS 8
+
+static struct {
+    uint8_t response[MODBUS_FRAME_MAX_SIZE];
+    size_t chunk_length[SCRIPT_MAX_CHUNKS];
+    int chunk_count;
+    int next_chunk;
+    size_t offset;
+    bool gap_each;
+    bool gap_due;
+    int64_t now_us;
+} script;
+
+static void script_response(const uint8_t *adu, const size_t *chunks, int chunk_count, bool gap_each)
+{
+    memset(&script, 0, sizeof(script));
+    size_t total = 0;
+    for (int i = 0; i < chunk_count; i++) {
+        script.chunk_length[i] = chunks[i];
+        total += chunks[i];
+    }
+    memcpy(script.response, adu, total);
+    script.chunk_count = chunk_count;
+    script.gap_each = gap_each;
+}
+
+static esp_err_t script_open(void) { return ESP_OK; }
+static void script_close(void) {}
+static esp_err_t script_set_baud_rate(int baud_rate) { (void)baud_rate; return ESP_OK; }
+static esp_err_t script_set_parity(char parity) { (void)parity; return ESP_OK; }
+static esp_err_t script_set_stop_bits(uint8_t stop_bits) { (void)stop_bits; return ESP_OK; }
+static int script_write(const uint8_t *data, size_t length) { (void)data; return (int)length; }
+static void script_wait_tx_done(uint32_t timeout_ms) { (void)timeout_ms; }
+static void script_flush_input(void) {}
+static int64_t script_now_us(void) { return script.now_us; }
+static void script_delay_ms(uint32_t ms) { script.now_us += (int64_t)ms * 1000; }
+
+static int script_read(uint8_t *buf, size_t size, int64_t timeout_us, bool *gap)
+{
+    *gap = false;
+    if (script.gap_due) {
+        script.gap_due = false;
+        *gap = true;
+        return 0;
+    }
+    if (script.next_chunk >= script.chunk_count) {
+        script.now_us += timeout_us;
+        return 0;
+    }
+    size_t length = script.chunk_length[script.next_chunk++];
+    CHECK(length <= size);
+    memcpy(buf, script.response + script.offset, length);
+    script.offset += length;
+    script.gap_due = script.gap_each || script.next_chunk == script.chunk_count;
+    script.now_us += 1000;
+    return (int)length;
+}
+
+static const modbus_port_t script_port = {
+    .name = "script",
+    .open = script_open,
+    .close = script_close,
+    .set_baud_rate = script_set_baud_rate,
+    .set_parity = script_set_parity,
+    .set_stop_bits = script_set_stop_bits,
+    .write = script_write,
+    .wait_tx_done = script_wait_tx_done,
+    .flush_input = script_flush_input,
+    .read = script_read,
+    .now_us = script_now_us,
+    .delay_ms = script_delay_ms,
+};
+
+static void test_master_split_frames(void)
+{
+    uint8_t adu[MODBUS_FRAME_MAX_SIZE];
+    size_t length = build_read_response(adu, 2, MODBUS_READ_HOLDING_REGISTERS, 3);
+    uint16_t registers[3];
+    modbus_stats_t stats;
+
+    // Split with gaps inside the frame (a slow slave pausing mid-response)
+    const size_t split[] = { 2, 3, length - 5 };
+    script_response(adu, split, 3, true);
+    modbus_reset_statistics();
+    CHECK_EQ_INT(modbus_read_registers(2, MODBUS_READ_HOLDING_REGISTERS, 0, 3, registers, NULL), MODBUS_SUCCESS);
+    CHECK_EQ_INT(registers[0], 0x1000);
+    CHECK_EQ_INT(registers[2], 0x1202);
+
+    // Cut short: the gap after the last chunk does not complete the frame
+    const size_t truncated[] = { length - 1 };
+    script_response(adu, truncated, 1, false);
+    modbus_set_timeout_override(50);
+    CHECK_EQ_INT(modbus_read_registers(2, MODBUS_READ_HOLDING_REGISTERS, 0, 3, registers, NULL), MODBUS_TIMEOUT);
+    modbus_set_timeout_override(0);
+
+    modbus_get_statistics(&stats);
+    CHECK_EQ_INT(stats.total_requests, 2);
+    CHECK_EQ_INT(stats.successful_requests, 1);
+    CHECK_EQ_INT(stats.failed_requests, 1);
+    CHECK_EQ_INT(stats.timeout_errors, 1);
+}
+
+static void test_master_write_accounting(void)
+{
+    const uint16_t values[2] = { 7, 8 };
+    uint8_t adu[16];
+    modbus_stats_t stats;
+
+    // Each successful write counts once
+    const uint8_t echo[] = { 4, MODBUS_WRITE_MULTIPLE_REGISTERS, 0x00, 0x20, 0x00, 0x02 };
+    size_t length = build_frame(adu, echo, sizeof(echo));
+    modbus_reset_statistics();
+    script_response(adu, &length, 1, false);
+    CHECK_EQ_INT(modbus_write_multiple_registers(4, 0x20, 2, values), MODBUS_SUCCESS);
+    modbus_get_statistics(&stats);
+    CHECK_EQ_INT(stats.total_requests, 1);
+    CHECK_EQ_INT(stats.successful_requests, 1);
+    CHECK_EQ_INT(stats.failed_requests, 0);
+
+    // An echo of another address or quantity is a failure, not a success
+    const uint8_t wrong_echo[] = { 4, MODBUS_WRITE_MULTIPLE_REGISTERS, 0x00, 0x21, 0x00, 0x02 };
+    length = build_frame(adu, wrong_echo, sizeof(wrong_echo));
+    script_response(adu, &length, 1, false);
+    CHECK_EQ_INT(modbus_write_multiple_registers(4, 0x20, 2, values), MODBUS_INVALID_RESPONSE);
+    modbus_get_statistics(&stats);
+    CHECK_EQ_INT(stats.total_requests, 2);
+    CHECK_EQ_INT(stats.successful_requests, 1);
+    CHECK_EQ_INT(stats.failed_requests, 1);
+    CHECK_EQ_INT(stats.last_error_code, MODBUS_INVALID_RESPONSE);
+    CHECK_EQ_INT(stats.total_requests, stats.successful_requests + stats.failed_requests);
+}
+
+static void test_master_write_single_echo(void)
+{
+    uint8_t adu[16];
+    modbus_stats_t stats;
+
+    const uint8_t echo[] = { 4, MODBUS_WRITE_SINGLE_REGISTER, 0x00, 0x30, 0x12, 0x34 };
+    size_t length = build_frame(adu, echo, sizeof(echo));
+    modbus_reset_statistics();
+    script_response(adu, &length, 1, false);
+    CHECK_EQ_INT(modbus_write_single_register(4, 0x30, 0x1234), MODBUS_SUCCESS);
+
+    // The echo must repeat both the address and the value written
+    const uint8_t wrong_addr[] = { 4, MODBUS_WRITE_SINGLE_REGISTER, 0x00, 0x31, 0x12, 0x34 };
+    length = build_frame(adu, wrong_addr, sizeof(wrong_addr));
+    script_response(adu, &length, 1, false);
+    CHECK_EQ_INT(modbus_write_single_register(4, 0x30, 0x1234), MODBUS_INVALID_RESPONSE);
+
+    const uint8_t wrong_value[] = { 4, MODBUS_WRITE_SINGLE_REGISTER, 0x00, 0x30, 0x12, 0x35 };
+    length = build_frame(adu, wrong_value, sizeof(wrong_value));
+    script_response(adu, &length, 1, false);
+    CHECK_EQ_INT(modbus_write_single_register(4, 0x30, 0x1234), MODBUS_INVALID_RESPONSE);
+
+    modbus_get_statistics(&stats);
+    CHECK_EQ_INT(stats.total_requests, 3);
+    CHECK_EQ_INT(stats.successful_requests, 1);
+    CHECK_EQ_INT(stats.failed_requests, 2);
+    CHECK_EQ_INT(stats.last_error_code, MODBUS_INVALID_RESPONSE);
+}
+
+int main(void)
+{
+    test_whole_and_byte_by_byte();
+    test_random_splits();
+    test_gaps();
+    test_exceptions_and_trailing_bytes();
+
+    CHECK_EQ_INT(modbus_set_port(&script_port), ESP_OK);
+    CHECK_EQ_INT(modbus_init(), ESP_OK);
+    test_master_split_frames();
+    test_master_write_accounting();
+    test_master_write_single_echo();
+    modbus_deinit();
+    modbus_set_port(NULL);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,154 @@
+// test_modbus_port_sim.c - Modbus master on the in-process simulated line
+// The port clock must account for every character, turnaround and timeout,
+// and the slave must only answer at its own line settings. Timeouts are all
+// traced but logged at most once per MODBUS_TIMEOUT_LOG_INTERVAL_MS, and
+// only slaves that answer get a modbus_rtt_ms series.
+
+#include "host_test.h"
+#include "modbus.h"
+#include "modbus_port.h"
+#include "modbus_port_sim.h"
+#include "modbus_sim.h"
+#include "trace.h"
+#include "metrics.h"
+#include <unistd.h>
+
+#define SLAVE_ID 3
+#define EVEN_PARITY_SLAVE_ID 4
+
+static modbus_sim_t sim;
+
+static void test_transfer_time(void)
+{
+    modbus_sim_slave_t *slave = modbus_sim_add_slave(&sim, SLAVE_ID);
+    slave->turnaround_us = 5000;
+    modbus_sim_put_u16(slave, MODBUS_SIM_HOLDING, 0, 0xCAFE);
+
+    // 8-byte request + 5 ms turnaround + 25-byte response + gap at 9600 8N1 (1042 us per char)
+    uint16_t registers[10];
+    modbus_port_sim_reset_stats();
+    int64_t start_us = modbus_port_now_us();
+    CHECK_EQ_INT(modbus_read_registers(SLAVE_ID, MODBUS_READ_HOLDING_REGISTERS, 0, 10, registers, NULL),
+                 MODBUS_SUCCESS);
+    int64_t elapsed_us = modbus_port_now_us() - start_us;
+    CHECK_EQ_INT(registers[0], 0xCAFE);
+    CHECK_EQ_INT(modbus_port_sim_char_us(), 1042);
+    CHECK(elapsed_us >= 8 * 1042 + 5000 + 25 * 1042);
+    CHECK(elapsed_us < 8 * 1042 + 5000 + 25 * 1042 + 20000);
+
+    modbus_port_sim_stats_t line;
+    modbus_port_sim_get_stats(&line);
+    CHECK_EQ_INT(line.bytes_sent, 8);
+    CHECK_EQ_INT(line.bytes_received, 25);
+    CHECK_EQ_INT(line.busy_us, 33 * 1042);
+}
+
+static void test_timeout_skips_time(void)
+{
+    uint16_t value;
+    modbus_set_timeout_override(500);
+    int64_t start_us = modbus_port_now_us();
+    CHECK_EQ_INT(modbus_read_registers(99, MODBUS_READ_HOLDING_REGISTERS, 0, 1, &value, NULL), MODBUS_TIMEOUT);
+    CHECK(modbus_port_now_us() - start_us >= 500000);
+    modbus_set_timeout_override(0);
+}
+
+static void test_line_settings(void)
+{
+    modbus_sim_slave_t *slave = modbus_sim_add_slave(&sim, EVEN_PARITY_SLAVE_ID);
+    slave->line = (modbus_line_config_t){ 19200, 'E', 1 };
+    modbus_sim_put_u16(slave, MODBUS_SIM_INPUT, 7, 77);
+
+    uint16_t value = 0;
+    modbus_set_timeout_override(100);
+    CHECK_EQ_INT(modbus_read_registers(EVEN_PARITY_SLAVE_ID, MODBUS_READ_INPUT_REGISTERS, 7, 1, &value, NULL),
+                 MODBUS_TIMEOUT);
+    modbus_set_timeout_override(0);
+    CHECK_EQ_INT(slave->line_mismatches, 1);
+
+    modbus_line_config_t line = { 19200, 'E', 1 };
+    CHECK_EQ_INT(modbus_set_line_config(&line), ESP_OK);
+    CHECK_EQ_INT(modbus_port_sim_char_us(), 573);   // 11 bits at 19200
+    CHECK_EQ_INT(modbus_read_registers(EVEN_PARITY_SLAVE_ID, MODBUS_READ_INPUT_REGISTERS, 7, 1, &value, NULL),
+                 MODBUS_SUCCESS);
+    CHECK_EQ_INT(value, 77);
+}
+
+static int count_occurrences(const char *text, const char *needle)
+{
+    int count = 0;
+    for (const char *p = strstr(text, needle); p; p = strstr(p + 1, needle)) {
+        count++;
+    }
+    return count;
+}
+
+static void test_timeout_log_rate(void)
+{
+    static char log[8192];
+    static char trace[32768];
+    uint16_t value;
+
+    // Capture what the driver logs
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    FILE *capture = tmpfile();
+    dup2(fileno(capture), STDERR_FILENO);
+
+    uint32_t since = trace_head();
+    // Past the interval of any earlier report: logged
+    modbus_set_timeout_override(MODBUS_TIMEOUT_LOG_INTERVAL_MS + 1000);
+    CHECK_EQ_INT(modbus_read_registers(99, MODBUS_READ_HOLDING_REGISTERS, 0, 1, &value, NULL), MODBUS_TIMEOUT);
+    // Within the interval: traced only
+    modbus_set_timeout_override(100);
+    for (int i = 0; i < 20; i++) {
+        CHECK_EQ_INT(modbus_read_registers(99, MODBUS_READ_HOLDING_REGISTERS, 0, 1, &value, NULL), MODBUS_TIMEOUT);
+    }
+    modbus_set_timeout_override(0);
+
+    fflush(stderr);
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+    rewind(capture);
+    size_t length = fread(log, 1, sizeof(log) - 1, capture);
+    log[length] = '\0';
+    fclose(capture);
+    CHECK_EQ_INT(count_occurrences(log, "No response from slave 99"), 1);
+    CHECK_EQ_INT(count_occurrences(log, "\n"), 1);
+
+    json_writer_t w;
+    json_writer_init(&w, trace, sizeof(trace), NULL, NULL);
+    CHECK_EQ_INT(trace_write_json(&w, since), ESP_OK);
+    json_writer_finish(&w);
+    CHECK_EQ_INT(count_occurrences(trace, "\"modbus_timeout\""), 21);
+}
+
+// Slaves that never answer must not use up the metrics registry
+static void test_silent_slaves_register_no_series(void)
+{
+    // With the default timeout: probes under an override get no slave entry
+    uint16_t value;
+    for (int slave_id = 100; slave_id < 100 + METRICS_MAX; slave_id++) {
+        CHECK_EQ_INT(modbus_read_registers((uint8_t)slave_id, MODBUS_READ_HOLDING_REGISTERS, 0, 1, &value, NULL),
+                     MODBUS_TIMEOUT);
+    }
+    CHECK(metrics_gauge("test_after_silent_slaves", "Registered after the silent slaves", NULL, NULL) != NULL);
+}
+
+int main(void)
+{
+    modbus_sim_init(&sim, 1);
+    modbus_port_sim_attach(&sim);
+    CHECK_EQ_INT(modbus_set_port(&modbus_port_sim), ESP_OK);
+    CHECK_EQ_INT(modbus_init(), ESP_OK);
+
+    test_transfer_time();
+    test_timeout_skips_time();
+    test_line_settings();
+    test_timeout_log_rate();
+    test_silent_slaves_register_no_series();
+
+    modbus_deinit();
+    modbus_set_port(NULL);
+    return TEST_RESULT();
+}
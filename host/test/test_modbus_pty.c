@@ -0,0 +1,149 @@
+// test_modbus_pty.c - Modbus master against a simulated slave on a pseudo-terminal
+// Drives modbus.c through modbus_port_pty, so requests and responses cross a
+// real tty: framing, CRC, gap detection, line changes and write echoes.
+
+#include "host_test.h"
+#include "modbus.h"
+#include "modbus_port.h"
+#include "modbus_port_pty.h"
+#include "modbus_sim.h"
+#include "modbus_sim_pty.h"
+
+#define SLAVE_ID 7
+#define FAST_SLAVE_ID 9                    // Listens at 19200 8N2 only
+#define SILENT_SLAVE_ID 42
+
+static modbus_sim_t sim;
+
+static void test_read_registers(modbus_sim_slave_t *slave)
+{
+    for (int i = 0; i < 10; i++) {
+        modbus_sim_put_u16(slave, MODBUS_SIM_HOLDING, 100 + i, (uint16_t)(0x1000 + i));
+    }
+    modbus_sim_put_float32(slave, MODBUS_SIM_INPUT, 20, 12.5f, "ABCD");
+
+    uint16_t registers[10] = {0};
+    modbus_txn_info_t info;
+    CHECK_EQ_INT(modbus_read_registers(SLAVE_ID, MODBUS_READ_HOLDING_REGISTERS, 100, 10, registers, &info),
+                 MODBUS_SUCCESS);
+    CHECK_EQ_INT(info.register_count, 10);
+    CHECK_EQ_INT(info.frame_length, 5 + 20);
+    for (int i = 0; i < 10; i++) {
+        CHECK_EQ_INT(registers[i], 0x1000 + i);
+    }
+
+    CHECK_EQ_INT(modbus_read_registers(SLAVE_ID, MODBUS_READ_INPUT_REGISTERS, 20, 2, registers, &info),
+                 MODBUS_SUCCESS);
+    CHECK_EQ_INT(registers[0], 0x4148);    // 12.5f
+    CHECK_EQ_INT(registers[1], 0x0000);
+
+    // Largest read the protocol allows
+    uint16_t many[MODBUS_MAX_REGISTERS];
+    CHECK_EQ_INT(modbus_read_registers(SLAVE_ID, MODBUS_READ_HOLDING_REGISTERS, 0, MODBUS_MAX_REGISTERS, many, &info),
+                 MODBUS_SUCCESS);
+    CHECK_EQ_INT(many[105], 0x1005);
+}
+
+static void test_write_registers(modbus_sim_slave_t *slave)
+{
+    uint32_t writes = slave->writes;
+    CHECK_EQ_INT(modbus_write_single_register(SLAVE_ID, 300, 0xBEEF), MODBUS_SUCCESS);
+    CHECK_EQ_INT(slave->holding[300], 0xBEEF);
+
+    const uint16_t values[4] = { 1, 2, 0xFFFF, 0x8000 };
+    CHECK_EQ_INT(modbus_write_multiple_registers(SLAVE_ID, 310, 4, values), MODBUS_SUCCESS);
+    for (int i = 0; i < 4; i++) {
+        CHECK_EQ_INT(slave->holding[310 + i], values[i]);
+    }
+    CHECK_EQ_INT(slave->writes, writes + 2);
+
+    // What was written reads back
+    uint16_t readback[4] = {0};
+    CHECK_EQ_INT(modbus_read_registers(SLAVE_ID, MODBUS_READ_HOLDING_REGISTERS, 310, 4, readback, NULL),
+                 MODBUS_SUCCESS);
+    CHECK(memcmp(readback, values, sizeof(values)) == 0);
+}
+
+static void test_errors(modbus_sim_slave_t *slave)
+{
+    uint16_t registers[4];
+    modbus_stats_t before, after;
+
+    // Exception response for an unmapped address
+    CHECK_EQ_INT(modbus_read_registers(SLAVE_ID, MODBUS_READ_HOLDING_REGISTERS, MODBUS_SIM_REGISTERS, 4, registers, NULL),
+                 MODBUS_ILLEGAL_DATA_ADDRESS);
+
+    // Corrupted CRC
+    modbus_get_statistics(&before);
+    slave->crc_error_permille = 1000;
+    CHECK_EQ_INT(modbus_read_registers(SLAVE_ID, MODBUS_READ_HOLDING_REGISTERS, 0, 4, registers, NULL),
+                 MODBUS_INVALID_CRC);
+    slave->crc_error_permille = 0;
+    modbus_get_statistics(&after);
+    CHECK_EQ_INT(after.crc_errors, before.crc_errors + 1);
+
+    // Nobody answers
+    modbus_set_timeout_override(100);
+    modbus_get_statistics(&before);
+    CHECK_EQ_INT(modbus_read_registers(SILENT_SLAVE_ID, MODBUS_READ_HOLDING_REGISTERS, 0, 4, registers, NULL),
+                 MODBUS_TIMEOUT);
+    modbus_get_statistics(&after);
+    CHECK_EQ_INT(after.timeout_errors, before.timeout_errors + 1);
+    modbus_set_timeout_override(0);
+
+    // The master recovers on the next request
+    CHECK_EQ_INT(modbus_read_registers(SLAVE_ID, MODBUS_READ_HOLDING_REGISTERS, 100, 1, registers, NULL),
+                 MODBUS_SUCCESS);
+    CHECK_EQ_INT(registers[0], 0x1000);
+}
+
+static void test_line_settings(void)
+{
+    modbus_sim_slave_t *slave = modbus_sim_add_slave(&sim, FAST_SLAVE_ID);
+    slave->line = (modbus_line_config_t){ 19200, 0, 2 };
+    modbus_sim_put_u16(slave, MODBUS_SIM_HOLDING, 0, 0x1234);
+
+    uint16_t value = 0;
+    modbus_set_timeout_override(100);
+    CHECK_EQ_INT(modbus_read_registers(FAST_SLAVE_ID, MODBUS_READ_HOLDING_REGISTERS, 0, 1, &value, NULL),
+                 MODBUS_TIMEOUT);
+    CHECK_EQ_INT(slave->line_mismatches, 1);
+    modbus_set_timeout_override(0);
+
+    modbus_line_config_t line = { 19200, 'N', 2 };
+    CHECK_EQ_INT(modbus_set_line_config(&line), ESP_OK);
+    CHECK_EQ_INT(modbus_read_registers(FAST_SLAVE_ID, MODBUS_READ_HOLDING_REGISTERS, 0, 1, &value, NULL),
+                 MODBUS_SUCCESS);
+    CHECK_EQ_INT(value, 0x1234);
+
+    line = (modbus_line_config_t){ RS485_BAUD_RATE, 'N', 1 };
+    CHECK_EQ_INT(modbus_set_line_config(&line), ESP_OK);
+}
+
+int main(void)
+{
+    modbus_sim_init(&sim, 1);
+    modbus_sim_slave_t *slave = modbus_sim_add_slave(&sim, SLAVE_ID);
+    slave->turnaround_us = 3000;
+
+    modbus_sim_pty_t *server = NULL;
+    if (modbus_sim_pty_start(&sim, &server) != ESP_OK) {
+        fprintf(stderr, "No pseudo-terminal available\n");
+        return 1;
+    }
+
+    CHECK_EQ_INT(modbus_port_pty_set_device(modbus_sim_pty_device(server)), ESP_OK);
+    CHECK_EQ_INT(modbus_set_port(&modbus_port_pty), ESP_OK);
+    CHECK_EQ_INT(modbus_init(), ESP_OK);
+    CHECK_EQ_INT(modbus_set_port(NULL), ESP_ERR_INVALID_STATE);
+
+    test_read_registers(slave);
+    test_write_registers(slave);
+    test_errors(slave);
+    test_line_settings();
+
+    modbus_deinit();
+    modbus_sim_pty_stop(server);
+    modbus_set_port(NULL);
+    return TEST_RESULT();
+}
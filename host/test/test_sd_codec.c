@@ -0,0 +1,301 @@
+// test_sd_codec.c - Round trips of the cached-message encoding
+// Empty, incompressible, maximum-size and long-run payloads, every timestamp
+// form, telemetry built from the JSON templates and random mixes of all of it
+// must decode to exactly what was encoded. Truncated and damaged bodies must
+// be rejected without touching memory outside the output buffers.
+
+#include "host_test.h"
+#include "sd_codec.h"
+#include <stdlib.h>
+
+#define FUZZ_MESSAGES 20000
+#define OUT_SIZE (SD_CODEC_MAX_PAYLOAD + 64)
+
+static const char *const telemetry[] = {
+    "{\"params_data\":{\"pH\":7.12,\"TDS\":182.40,\"Temp\":27.31,\"HUMIDITY\":61.00,\"TSS\":12.55,"
+    "\"BOD\":4.80,\"COD\":9.10},\"type\":\"QUALITY\",\"created_on\":\"2025-11-24T12:05:05Z\","
+    "\"unit_id\":\"WQ0101\"}",
+    "[{\"unit_id\":\"FG24708F\",\"type\":\"FLOW\",\"consumption\":\"265.23\","
+    "\"created_on\":\"2025-11-24T12:05:05Z\"},{\"unit_id\":\"FG24708G\",\"type\":\"FLOW\","
+    "\"consumption\":\"1287.00\",\"created_on\":\"2025-11-24T12:05:05Z\"}]",
+    "{\"ene_con_hex\":\"0001A2F3\",\"type\":\"ENERGY\",\"created_on_epoch\":1764000000,"
+    "\"slave_id\":3,\"meter\":\"energy\"}",
+    "{\"borewell\":12.345678,\"type\":\"BOREWELL\",\"created_on_epoch\":1764000000,"
+    "\"slave_id\":1,\"meter\":\"piezo\"}",
+    "{\"unit_id\":\"RG0001\",\"type\":\"RAINGAUGE\",\"raingauge\":\"3.20\","
+    "\"created_on\":\"2025-11-24T12:05:05Z\"}",
+};
+#define TELEMETRY_COUNT (sizeof(telemetry) / sizeof(telemetry[0]))
+
+static void expect_round_trip(uint8_t topic, const char *timestamp, const char *payload)
+{
+    uint8_t body[OUT_SIZE];
+    size_t length = 0;
+    CHECK_EQ_INT(sd_codec_encode(topic, timestamp, payload, body, sizeof(body), &length), ESP_OK);
+    CHECK(length <= 3 + 1 + strlen(timestamp) + 2 + strlen(payload));
+
+    uint8_t topic_out = 0xFF;
+    char timestamp_out[32];
+    char payload_out[SD_CODEC_MAX_PAYLOAD + 1];
+    memset(payload_out, 0xAA, sizeof(payload_out));
+    CHECK_EQ_INT(sd_codec_decode(body, length, &topic_out, timestamp_out, sizeof(timestamp_out), payload_out,
+                                 sizeof(payload_out)), ESP_OK);
+    CHECK_EQ_INT(topic_out, topic);
+    CHECK_EQ_STR(timestamp_out, timestamp);
+    CHECK_EQ_STR(payload_out, payload);
+}
+
+static size_t encoded_size(const char *timestamp, const char *payload, uint8_t *flags)
+{
+    uint8_t body[OUT_SIZE];
+    size_t length = 0;
+    if (sd_codec_encode(0, timestamp, payload, body, sizeof(body), &length) != ESP_OK) {
+        return 0;
+    }
+    *flags = body[1];
+    return length;
+}
+
+static void test_empty(void)
+{
+    uint8_t flags;
+    expect_round_trip(0, "2025-11-24T12:05:05Z", "");
+    expect_round_trip(7, "", "");
+    expect_round_trip(1, "", "{}");
+    CHECK(encoded_size("2025-11-24T12:05:05Z", "", &flags) > 0);
+    CHECK(flags & SD_CODEC_FLAG_STORED);
+}
+
+static void test_timestamps(void)
+{
+    static const char *const canonical[] = {
+        "2020-01-01T00:00:00Z", "2025-11-24T12:05:05Z", "2024-02-29T23:59:59Z", "2099-12-31T23:59:59Z",
+    };
+    static const char *const raw[] = {
+        "2019-12-31T23:59:59Z",            // Before SD_CODEC_EPOCH
+        "2025-11-24 12:05:05",             // Not the canonical form
+        "2025-11-24T12:05:05+05:30",
+        "2025-02-30T00:00:00Z",            // Not a real date
+        "2025-11-24T12:05:05.123Z",
+        "not a time",
+        "1764000000",
+    };
+    uint8_t flags;
+    for (size_t i = 0; i < sizeof(canonical) / sizeof(canonical[0]); i++) {
+        expect_round_trip(2, canonical[i], telemetry[0]);
+        CHECK(encoded_size(canonical[i], "x", &flags) > 0);
+        CHECK(!(flags & SD_CODEC_FLAG_RAW_TIME));
+    }
+    for (size_t i = 0; i < sizeof(raw) / sizeof(raw[0]); i++) {
+        expect_round_trip(2, raw[i], telemetry[0]);
+        CHECK(encoded_size(raw[i], "x", &flags) > 0);
+        CHECK(flags & SD_CODEC_FLAG_RAW_TIME);
+    }
+
+    // Longest timestamp kept as text, one more is refused
+    char longest[33];
+    memset(longest, '9', 31);
+    longest[31] = '\0';
+    expect_round_trip(0, longest, "{}");
+    longest[31] = '9';
+    longest[32] = '\0';
+    CHECK(encoded_size(longest, "{}", &flags) == 0);
+}
+
+static void test_telemetry(void)
+{
+    for (size_t i = 0; i < TELEMETRY_COUNT; i++) {
+        expect_round_trip((uint8_t)i, "2025-11-24T12:05:05Z", telemetry[i]);
+
+        // The preset dictionary and the timestamp make telemetry compress well
+        uint8_t flags;
+        size_t length = encoded_size("2025-11-24T12:05:05Z", telemetry[i], &flags);
+        CHECK(!(flags & SD_CODEC_FLAG_STORED));
+        CHECK(length * 2 < strlen(telemetry[i]));
+    }
+}
+
+static void random_text(char *text, size_t length, int alphabet)
+{
+    for (size_t i = 0; i < length; i++) {
+        text[i] = (char)(1 + rand() % alphabet);
+    }
+    text[length] = '\0';
+}
+
+static void test_incompressible(void)
+{
+    char payload[SD_CODEC_MAX_PAYLOAD + 1];
+    srand(7);
+    for (size_t length = 1; length <= SD_CODEC_MAX_PAYLOAD; length += 61) {
+        random_text(payload, length, 255);
+        expect_round_trip(3, "2025-11-24T12:05:05Z", payload);
+
+        // Stored bodies cost only the header
+        uint8_t flags;
+        size_t size = encoded_size("2025-11-24T12:05:05Z", payload, &flags);
+        CHECK(size <= length + 3 + 5 + 2);
+    }
+    random_text(payload, SD_CODEC_MAX_PAYLOAD, 255);
+    expect_round_trip(3, "2025-11-24T12:05:05Z", payload);
+}
+
+static void test_max_size(void)
+{
+    char payload[SD_CODEC_MAX_PAYLOAD + 2];
+
+    // Telemetry repeated up to the limit
+    size_t length = 0;
+    for (size_t i = 0; length < SD_CODEC_MAX_PAYLOAD; i++) {
+        const char *part = telemetry[i % TELEMETRY_COUNT];
+        size_t n = strlen(part);
+        if (n > SD_CODEC_MAX_PAYLOAD - length) {
+            n = SD_CODEC_MAX_PAYLOAD - length;
+        }
+        memcpy(payload + length, part, n);
+        length += n;
+    }
+    payload[length] = '\0';
+    expect_round_trip(4, "2025-11-24T12:05:05Z", payload);
+
+    // One byte over is refused, as is a body that does not fit the output
+    uint8_t body[OUT_SIZE];
+    size_t body_length;
+    payload[SD_CODEC_MAX_PAYLOAD] = 'x';
+    payload[SD_CODEC_MAX_PAYLOAD + 1] = '\0';
+    CHECK_EQ_INT(sd_codec_encode(0, "2025-11-24T12:05:05Z", payload, body, sizeof(body), &body_length),
+                 ESP_ERR_INVALID_SIZE);
+    random_text(payload, SD_CODEC_MAX_PAYLOAD, 255);
+    CHECK_EQ_INT(sd_codec_encode(0, "2025-11-24T12:05:05Z", payload, body, SD_CODEC_MAX_PAYLOAD, &body_length),
+                 ESP_ERR_INVALID_SIZE);
+
+    // Decoding into buffers that are too small
+    random_text(payload, 100, 255);
+    CHECK_EQ_INT(sd_codec_encode(0, "2025-11-24T12:05:05Z", payload, body, sizeof(body), &body_length), ESP_OK);
+    uint8_t topic;
+    char timestamp[32];
+    char small[100];
+    CHECK_EQ_INT(sd_codec_decode(body, body_length, &topic, timestamp, sizeof(timestamp), small, sizeof(small)),
+                 ESP_ERR_INVALID_SIZE);
+    CHECK_EQ_INT(sd_codec_decode(body, body_length, &topic, timestamp, 20, payload, sizeof(payload)),
+                 ESP_ERR_INVALID_SIZE);
+}
+
+// Runs longer than one match token, overlapping copies at distance 1 and 2
+static void test_repeated_runs(void)
+{
+    char payload[SD_CODEC_MAX_PAYLOAD + 1];
+    size_t lengths[] = { 3, 4, 33, 34, 35, 289, 290, 291, 600, SD_CODEC_MAX_PAYLOAD };
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        memset(payload, 'a', lengths[i]);
+        payload[lengths[i]] = '\0';
+        expect_round_trip(5, "2025-11-24T12:05:05Z", payload);
+
+        for (size_t k = 0; k < lengths[i]; k++) {
+            payload[k] = k % 2 ? '0' : '.';
+        }
+        expect_round_trip(5, "2025-11-24T12:05:05Z", payload);
+    }
+
+    uint8_t flags;
+    memset(payload, 'a', SD_CODEC_MAX_PAYLOAD);
+    payload[SD_CODEC_MAX_PAYLOAD] = '\0';
+    CHECK(encoded_size("2025-11-24T12:05:05Z", payload, &flags) < 32);
+    CHECK(!(flags & SD_CODEC_FLAG_STORED));
+}
+
+// Telemetry fragments, runs and noise in random order and lengths
+static void test_fuzz(void)
+{
+    static const char *const timestamps[] = { "2025-11-24T12:05:05Z", "2031-06-01T00:00:01Z", "2025-11-24 12:05" };
+    char payload[SD_CODEC_MAX_PAYLOAD + 1];
+    srand(99);
+    for (int n = 0; n < FUZZ_MESSAGES; n++) {
+        size_t target = (size_t)rand() % (SD_CODEC_MAX_PAYLOAD + 1);
+        size_t length = 0;
+        while (length < target) {
+            size_t n_bytes = 1 + (size_t)rand() % 80;
+            if (n_bytes > target - length) {
+                n_bytes = target - length;
+            }
+            switch (rand() % 3) {
+                case 0: {
+                    const char *part = telemetry[rand() % TELEMETRY_COUNT];
+                    size_t start = (size_t)rand() % strlen(part);
+                    size_t available = strlen(part) - start;
+                    memcpy(payload + length, part + start, n_bytes < available ? n_bytes : available);
+                    length += n_bytes < available ? n_bytes : available;
+                    break;
+                }
+                case 1:
+                    memset(payload + length, "ab0.9\""[rand() % 6], n_bytes);
+                    length += n_bytes;
+                    break;
+                default:
+                    random_text(payload + length, n_bytes, rand() % 2 ? 255 : 4);
+                    length += n_bytes;
+                    break;
+            }
+        }
+        payload[length] = '\0';
+        expect_round_trip((uint8_t)(rand() % SD_CODEC_MAX_TOPICS), timestamps[rand() % 3], payload);
+    }
+}
+
+// Every prefix of a body is rejected; damaged bodies never overrun the outputs
+static void test_malformed(void)
+{
+    uint8_t body[OUT_SIZE];
+    size_t length;
+    uint8_t topic;
+    char timestamp[32 + 8];
+    char payload[SD_CODEC_MAX_PAYLOAD + 1 + 8];
+
+    for (size_t t = 0; t < TELEMETRY_COUNT; t++) {
+        CHECK_EQ_INT(sd_codec_encode(1, "2025-11-24T12:05:05Z", telemetry[t], body, sizeof(body), &length), ESP_OK);
+        for (size_t prefix = 0; prefix < length; prefix++) {
+            CHECK(sd_codec_decode(body, prefix, &topic, timestamp, 32, payload, SD_CODEC_MAX_PAYLOAD + 1) != ESP_OK);
+        }
+    }
+
+    srand(5);
+    int accepted = 0;
+    for (int n = 0; n < 20000; n++) {
+        const char *source = telemetry[n % TELEMETRY_COUNT];
+        CHECK_EQ_INT(sd_codec_encode(1, n % 2 ? "2025-11-24T12:05:05Z" : "raw time", source, body, sizeof(body),
+                                     &length), ESP_OK);
+        int flips = 1 + rand() % 4;
+        for (int f = 0; f < flips; f++) {
+            body[rand() % length] ^= (uint8_t)(1 << (rand() % 8));
+        }
+
+        // Guard bytes after the sizes the decoder is given
+        memset(timestamp, 0x5C, sizeof(timestamp));
+        memset(payload, 0x5C, sizeof(payload));
+        if (sd_codec_decode(body, length, &topic, timestamp, 32, payload, SD_CODEC_MAX_PAYLOAD + 1) == ESP_OK) {
+            accepted++;
+            CHECK(strlen(payload) <= SD_CODEC_MAX_PAYLOAD);
+            CHECK(strlen(timestamp) < 32);
+        }
+        for (size_t g = 0; g < 8; g++) {
+            CHECK_EQ_INT((uint8_t)timestamp[32 + g], 0x5C);
+            CHECK_EQ_INT((uint8_t)payload[SD_CODEC_MAX_PAYLOAD + 1 + g], 0x5C);
+        }
+    }
+    // Literal bytes carry no check, so some damage decodes; the record CRC in
+    // sd_queue catches that on the card
+    CHECK(accepted < 20000);
+}
+
+int main(void)
+{
+    test_empty();
+    test_timestamps();
+    test_telemetry();
+    test_incompressible();
+    test_max_size();
+    test_repeated_runs();
+    test_fuzz();
+    test_malformed();
+    return TEST_RESULT();
+}
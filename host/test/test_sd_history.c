@@ -0,0 +1,328 @@
+// test_sd_history.c - Sensor historian on a scratch directory
+// Three days of one-minute rows are recorded through sd_history_record() and
+// read back raw and in 5-minute and daily buckets, each compared with the same
+// figures computed from the generator. Daily buckets of whole days come from
+// the file header, partial days from the rows, so both paths are covered.
+// Also checked: a row older than the last one of its day is dropped, a header
+// that fell behind its rows is rebuilt, and days past the retention window
+// are deleted once a newer day is recorded.
+//
+// SD_HISTORY_DIR points at /tmp for this test (see CMakeLists.txt).
+
+#include "host_test.h"
+#include "sd_history.h"
+#include "sd_card_logger.h"
+#include "esp_rom_crc.h"
+#include <stdlib.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#define UNIT "FG24708F"
+#define DAY 86400
+#define DAYS 3
+#define ROWS_PER_DAY 1440
+#define MAX_POINTS (DAYS * ROWS_PER_DAY + 16)
+
+static bool card_available = true;
+
+bool sd_card_is_available(void)
+{
+    return card_available;
+}
+
+// ---------------------------------------------------------------------------
+// Generator: row k at day0 + k minutes, every seventh row stale
+
+static time_t day0;
+
+static time_t row_time(int k)
+{
+    return day0 + (time_t)k * 60;
+}
+
+static float row_value(int k)
+{
+    return (float)(k % ROWS_PER_DAY) / 4;
+}
+
+static uint8_t row_quality(int k)
+{
+    return k % 7 == 3 ? SD_HISTORY_STALE : SD_HISTORY_GOOD;
+}
+
+// Bucket of rows [first, last] as the historian should report it
+static sd_history_point_t expected_bucket(time_t start, int first, int last)
+{
+    sd_history_point_t point = { .time = start };
+    double sum = 0;
+    for (int k = first; k <= last; k++) {
+        point.count++;
+        if (row_quality(k) != SD_HISTORY_GOOD) {
+            continue;
+        }
+        float v = row_value(k);
+        if (point.good == 0 || v < point.min) point.min = v;
+        if (point.good == 0 || v > point.max) point.max = v;
+        point.good++;
+        sum += v;
+    }
+    point.avg = point.good ? (float)(sum / point.good) : 0.0f;
+    return point;
+}
+
+// ---------------------------------------------------------------------------
+// Query collector
+
+static sd_history_point_t points[MAX_POINTS];
+static int point_count;
+static int point_limit;
+
+static bool collect(const sd_history_point_t *point, void *ctx)
+{
+    (void)ctx;
+    if (point_count < MAX_POINTS) {
+        points[point_count] = *point;
+    }
+    point_count++;
+    return point_count < point_limit;
+}
+
+static esp_err_t query(time_t from, time_t to, uint32_t bucket_sec)
+{
+    point_count = 0;
+    point_limit = MAX_POINTS;
+    return sd_history_query(UNIT, from, to, bucket_sec, collect, NULL);
+}
+
+static void check_point(const sd_history_point_t *actual, const sd_history_point_t *expected)
+{
+    CHECK_EQ_INT(actual->time, expected->time);
+    CHECK_EQ_INT(actual->count, expected->count);
+    CHECK_EQ_INT(actual->good, expected->good);
+    CHECK(actual->min == expected->min);
+    CHECK(actual->max == expected->max);
+    CHECK(fabsf(actual->avg - expected->avg) < 1e-3f);
+}
+
+// ---------------------------------------------------------------------------
+
+static void test_record_three_days(void)
+{
+    for (int k = 0; k < DAYS * ROWS_PER_DAY; k++) {
+        if (sd_history_record(UNIT, row_time(k), row_value(k), row_quality(k)) != ESP_OK) {
+            CHECK_EQ_INT(k, -1);
+            return;
+        }
+    }
+
+    // One file per day, each a 64-byte header and 8-byte rows
+    const char *days[DAYS] = { "20261015", "20261016", "20261017" };
+    for (int d = 0; d < DAYS; d++) {
+        char path[96];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", SD_HISTORY_DIR, days[d]);
+        CHECK(stat(path, &st) == 0 && S_ISDIR(st.st_mode));
+    }
+}
+
+static void test_raw_query(void)
+{
+    // Across midnight: the last two rows of day 0 and the first three of day 1
+    CHECK_EQ_INT(query(day0 + DAY - 150, day0 + DAY + 150, 0), ESP_OK);
+    CHECK_EQ_INT(point_count, 5);
+    for (int i = 0; i < point_count && i < 5; i++) {
+        int k = ROWS_PER_DAY - 2 + i;
+        CHECK_EQ_INT(points[i].time, row_time(k));
+        CHECK_EQ_INT(points[i].count, 1);
+        CHECK(points[i].avg == row_value(k));
+        CHECK_EQ_INT(points[i].quality, row_quality(k));
+        CHECK_EQ_INT(points[i].good, row_quality(k) == SD_HISTORY_GOOD);
+    }
+
+    // The whole range, in time order
+    CHECK_EQ_INT(query(day0, day0 + DAYS * DAY - 1, 0), ESP_OK);
+    CHECK_EQ_INT(point_count, DAYS * ROWS_PER_DAY);
+    bool ordered = true;
+    for (int i = 0; i < point_count && i < MAX_POINTS; i++) {
+        ordered = ordered && points[i].time == row_time(i);
+    }
+    CHECK(ordered);
+
+    // A range between two rows is empty
+    CHECK_EQ_INT(query(row_time(10) + 1, row_time(11) - 1, 0), ESP_OK);
+    CHECK_EQ_INT(point_count, 0);
+
+    // The emitter can stop the query
+    point_count = 0;
+    point_limit = 10;
+    CHECK_EQ_INT(sd_history_query(UNIT, day0, day0 + DAY - 1, 0, collect, NULL), ESP_OK);
+    CHECK_EQ_INT(point_count, 10);
+}
+
+static void test_five_minute_buckets(void)
+{
+    uint32_t bucket_sec = 0;
+    CHECK(sd_history_parse_interval("5m", &bucket_sec));
+    CHECK_EQ_INT(bucket_sec, 300);
+
+    CHECK_EQ_INT(query(day0 + DAY, day0 + 2 * DAY - 1, bucket_sec), ESP_OK);
+    CHECK_EQ_INT(point_count, ROWS_PER_DAY / 5);
+    for (int b = 0; b < point_count && b < ROWS_PER_DAY / 5; b++) {
+        int first = ROWS_PER_DAY + b * 5;
+        sd_history_point_t expected = expected_bucket(row_time(first), first, first + 4);
+        check_point(&points[b], &expected);
+    }
+
+    // A range starting mid-bucket only counts the rows inside it
+    CHECK_EQ_INT(query(row_time(7), row_time(12), bucket_sec), ESP_OK);
+    CHECK_EQ_INT(point_count, 2);
+    if (point_count == 2) {
+        sd_history_point_t first = expected_bucket(row_time(5), 7, 9);
+        sd_history_point_t second = expected_bucket(row_time(10), 10, 12);
+        check_point(&points[0], &first);
+        check_point(&points[1], &second);
+    }
+}
+
+static void test_daily_buckets(void)
+{
+    uint32_t bucket_sec = 0;
+    CHECK(sd_history_parse_interval("1d", &bucket_sec));
+    CHECK_EQ_INT(bucket_sec, DAY);
+
+    // Whole days: straight from the headers
+    CHECK_EQ_INT(query(day0, day0 + DAYS * DAY - 1, bucket_sec), ESP_OK);
+    CHECK_EQ_INT(point_count, DAYS);
+    for (int d = 0; d < point_count && d < DAYS; d++) {
+        int first = d * ROWS_PER_DAY;
+        sd_history_point_t expected = expected_bucket(day0 + d * DAY, first, first + ROWS_PER_DAY - 1);
+        check_point(&points[d], &expected);
+    }
+
+    // Noon to noon: the first and last day are summed from their rows
+    CHECK_EQ_INT(query(day0 + DAY / 2, day0 + 2 * DAY + DAY / 2, bucket_sec), ESP_OK);
+    CHECK_EQ_INT(point_count, DAYS);
+    if (point_count == DAYS) {
+        int half = ROWS_PER_DAY / 2;
+        sd_history_point_t expected[DAYS] = {
+            expected_bucket(day0, half, ROWS_PER_DAY - 1),
+            expected_bucket(day0 + DAY, ROWS_PER_DAY, 2 * ROWS_PER_DAY - 1),
+            expected_bucket(day0 + 2 * DAY, 2 * ROWS_PER_DAY, 2 * ROWS_PER_DAY + half),
+        };
+        for (int d = 0; d < DAYS; d++) {
+            check_point(&points[d], &expected[d]);
+        }
+    }
+}
+
+static void test_out_of_order(void)
+{
+    int last = DAYS * ROWS_PER_DAY - 1;
+
+    // A clock step back within the day drops the row
+    CHECK_EQ_INT(sd_history_record(UNIT, row_time(last) - 90, 999.0f, SD_HISTORY_GOOD), ESP_ERR_INVALID_STATE);
+    CHECK_EQ_INT(query(row_time(last) - 120, row_time(last), 0), ESP_OK);
+    CHECK_EQ_INT(point_count, 3);
+    for (int i = 0; i < point_count && i < 3; i++) {
+        CHECK(points[i].avg != 999.0f);
+    }
+
+    // A row for an earlier day still lands in that day's file, if it is the latest there
+    time_t late = row_time(ROWS_PER_DAY - 1) + 30;
+    CHECK_EQ_INT(sd_history_record(UNIT, late, 1234.0f, SD_HISTORY_GOOD), ESP_OK);
+    CHECK_EQ_INT(query(late, late, 0), ESP_OK);
+    CHECK_EQ_INT(point_count, 1);
+    CHECK(point_count == 1 && points[0].avg == 1234.0f);
+    CHECK_EQ_INT(sd_history_record(UNIT, late - 60, 1.0f, SD_HISTORY_GOOD), ESP_ERR_INVALID_STATE);
+
+    // A header that missed its last row (power lost between the two writes) is rebuilt
+    char path[96];
+    uint32_t hash = esp_rom_crc32_le(0, (const uint8_t *)UNIT, strlen(UNIT));
+    snprintf(path, sizeof(path), "%s/20261017/%08lX.dat", SD_HISTORY_DIR, (unsigned long)hash);
+    FILE *fp = fopen(path, "ab");
+    CHECK(fp != NULL);
+    if (fp) {
+        struct { uint32_t time_quality; float value; } row = { (uint32_t)(DAY - 1) << 8 | SD_HISTORY_GOOD, 77.0f };
+        CHECK_EQ_INT(fwrite(&row, sizeof(row), 1, fp), 1);
+        fclose(fp);
+    }
+    CHECK_EQ_INT(query(day0 + 2 * DAY, day0 + 3 * DAY - 1, DAY), ESP_OK);
+    CHECK_EQ_INT(point_count, 1);
+    CHECK(point_count == 1 && points[0].count == ROWS_PER_DAY + 1);
+    CHECK_EQ_INT(query(day0 + 3 * DAY - 1, day0 + 3 * DAY - 1, 0), ESP_OK);
+    CHECK(point_count == 1 && points[0].avg == 77.0f);
+
+    // Bad arguments
+    CHECK_EQ_INT(query(day0 + DAY, day0, 0), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(query(day0, day0 + (SD_HISTORY_MAX_SPAN_DAYS + 1) * (time_t)DAY, 0), ESP_ERR_INVALID_SIZE);
+    CHECK_EQ_INT(sd_history_record(UNIT, 1000, 1.0f, SD_HISTORY_GOOD), ESP_ERR_INVALID_ARG);
+    card_available = false;
+    CHECK_EQ_INT(query(day0, day0 + DAY, 0), ESP_ERR_INVALID_STATE);
+    CHECK_EQ_INT(sd_history_record(UNIT, row_time(last) + 60, 1.0f, SD_HISTORY_GOOD), ESP_ERR_INVALID_STATE);
+    card_available = true;
+}
+
+static void test_retention(void)
+{
+    // Recording a day SD_HISTORY_RETENTION_DAYS after day 1 drops day 0 only
+    time_t later = day0 + (time_t)(SD_HISTORY_RETENTION_DAYS + 1) * DAY;
+    CHECK_EQ_INT(sd_history_record(UNIT, later, 1.0f, SD_HISTORY_GOOD), ESP_OK);
+
+    char path[96];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/20261015", SD_HISTORY_DIR);
+    CHECK(stat(path, &st) != 0);
+    snprintf(path, sizeof(path), "%s/20261016", SD_HISTORY_DIR);
+    CHECK(stat(path, &st) == 0);
+
+    CHECK_EQ_INT(query(day0, day0 + DAY - 1, 0), ESP_OK);
+    CHECK_EQ_INT(point_count, 0);
+    CHECK_EQ_INT(query(day0 + DAY, day0 + 2 * DAY - 1, 0), ESP_OK);
+    CHECK_EQ_INT(point_count, ROWS_PER_DAY);
+    CHECK_EQ_INT(query(later, later, 0), ESP_OK);
+    CHECK_EQ_INT(point_count, 1);
+}
+
+static void test_parse(void)
+{
+    time_t t = 0;
+    CHECK(sd_history_parse_time("2026-10-17", &t) && t == 1792195200);
+    CHECK(sd_history_parse_time("2026-10-17T08:30", &t) && t == 1792195200 + 8 * 3600 + 30 * 60);
+    CHECK(sd_history_parse_time("2026-10-17T08:30:15Z", &t) && t == 1792195200 + 8 * 3600 + 30 * 60 + 15);
+    CHECK(sd_history_parse_time("1700000000", &t) && t == 1700000000);
+    CHECK(!sd_history_parse_time("2026-13-01", &t));
+    CHECK(!sd_history_parse_time("2026-10-17T25:00", &t));
+    CHECK(!sd_history_parse_time("yesterday", &t));
+
+    uint32_t seconds = 1;
+    CHECK(sd_history_parse_interval("raw", &seconds) && seconds == 0);
+    CHECK(sd_history_parse_interval("300", &seconds) && seconds == 300);
+    CHECK(sd_history_parse_interval("30s", &seconds) && seconds == 30);
+    CHECK(sd_history_parse_interval("1h", &seconds) && seconds == 3600);
+    CHECK(!sd_history_parse_interval("5x", &seconds));
+    CHECK(!sd_history_parse_interval("5mm", &seconds));
+    CHECK(!sd_history_parse_interval("100d", &seconds));
+}
+
+int main(void)
+{
+    if (system("rm -rf " SD_HISTORY_DIR) != 0) {
+        perror("rm " SD_HISTORY_DIR);
+        return 1;
+    }
+    if (!sd_history_parse_time("2026-10-15", &day0)) {
+        fprintf(stderr, "cannot parse the start day\n");
+        return 1;
+    }
+
+    test_parse();
+    test_record_three_days();
+    test_raw_query();
+    test_five_minute_buckets();
+    test_daily_buckets();
+    test_out_of_order();
+    test_retention();
+
+    system("rm -rf " SD_HISTORY_DIR);
+    return TEST_RESULT();
+}
@@ -0,0 +1,547 @@
+// test_sd_queue.c - Store-and-forward queue over a plain directory
+// Round trips across segments and reopens, recovery from torn and corrupt
+// records, and read failures injected into fread: a failed read must come back
+// as ESP_FAIL and leave every record and segment file in place. A seeded fuzz
+// run mixes all of it and checks the queue against a model after every step.
+//
+// Linked with -Wl,--wrap=fread so reads made by sd_queue.c can be failed.
+
+#include "host_test.h"
+#include "sd_queue.h"
+#include <stdlib.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define FUZZ_STEPS 20000
+#define MAX_RECORDS 40000
+
+// Fault injection: fail the fread fread_fail_in calls from now (0 = the next one)
+static int fread_fail_in = -1;
+static int fread_failures;
+
+size_t __real_fread(void *ptr, size_t size, size_t n, FILE *fp);
+
+size_t __wrap_fread(void *ptr, size_t size, size_t n, FILE *fp)
+{
+    if (fread_fail_in >= 0 && fread_fail_in-- == 0) {
+        fread_failures++;
+        fp->_flags |= _IO_ERR_SEEN;    // What a failed read on the card leaves behind
+        errno = EIO;
+        return 0;
+    }
+    return __real_fread(ptr, size, n, fp);
+}
+
+static void fail_fread(int calls_from_now)
+{
+    fread_fail_in = calls_from_now;
+}
+
+// ---------------------------------------------------------------------------
+// Model: records are numbered from 1, bodies derived from the ID
+
+static uint16_t model_length[MAX_RECORDS + 1];
+static uint32_t model_head;                // Oldest pending ID
+static uint32_t model_next;                // ID of the next append
+static uint32_t model_scan;                // Next ID read_next returns, if not behind the head
+
+static void fill_body(uint32_t id, uint16_t length, uint8_t *body)
+{
+    for (uint16_t i = 0; i < length; i++) {
+        body[i] = (uint8_t)(id * 131 + i * 7 + (i >> 8));
+    }
+}
+
+static bool body_matches(uint32_t id, const uint8_t *body, uint16_t length)
+{
+    uint8_t expected[SD_QUEUE_MAX_RECORD];
+    fill_body(id, length, expected);
+    return memcmp(body, expected, length) == 0;
+}
+
+static void model_reset(void)
+{
+    model_head = 1;
+    model_next = 1;
+    model_scan = 1;
+}
+
+static esp_err_t append_record(sd_queue_t *queue, uint16_t length)
+{
+    uint8_t body[SD_QUEUE_MAX_RECORD];
+    fill_body(model_next, length, body);
+    esp_err_t ret = sd_queue_append(queue, model_next, body, length);
+    if (ret == ESP_OK) {
+        model_length[model_next++] = length;
+    }
+    return ret;
+}
+
+static uint16_t random_length(void)
+{
+    // Mostly telemetry-sized, sometimes the largest record
+    return rand() % 8 == 0 ? SD_QUEUE_MAX_RECORD : (uint16_t)(1 + rand() % 400);
+}
+
+// The head as the model has it, or ESP_ERR_NOT_FOUND when empty
+static void check_head(sd_queue_t *queue)
+{
+    uint8_t body[SD_QUEUE_MAX_RECORD];
+    uint32_t id = 0;
+    uint16_t length = 0;
+    esp_err_t ret = sd_queue_peek(queue, &id, body, sizeof(body), &length);
+    if (model_head == model_next) {
+        CHECK_EQ_INT(ret, ESP_ERR_NOT_FOUND);
+        return;
+    }
+    CHECK_EQ_INT(ret, ESP_OK);
+    CHECK_EQ_INT(id, model_head);
+    CHECK_EQ_INT(length, model_length[model_head]);
+    CHECK(ret != ESP_OK || body_matches(id, body, length));
+}
+
+static void check_count(sd_queue_t *queue)
+{
+    uint32_t count = 0;
+    CHECK_EQ_INT(sd_queue_count(queue, &count), ESP_OK);
+    CHECK_EQ_INT(count, model_next - model_head);
+}
+
+static void ack_head(sd_queue_t *queue)
+{
+    CHECK_EQ_INT(sd_queue_ack(queue, model_head), ESP_OK);
+    model_head++;
+}
+
+static void check_read_next(sd_queue_t *queue)
+{
+    uint8_t body[SD_QUEUE_MAX_RECORD];
+    uint32_t id = 0;
+    uint16_t length = 0;
+    uint32_t expected = model_scan > model_head ? model_scan : model_head;
+    esp_err_t ret = sd_queue_read_next(queue, &id, body, sizeof(body), &length);
+    if (expected == model_next) {
+        CHECK_EQ_INT(ret, ESP_ERR_NOT_FOUND);
+        return;
+    }
+    CHECK_EQ_INT(ret, ESP_OK);
+    CHECK_EQ_INT(id, expected);
+    CHECK_EQ_INT(length, model_length[expected]);
+    CHECK(ret != ESP_OK || body_matches(id, body, length));
+    model_scan = expected + 1;
+}
+
+static void drain(sd_queue_t *queue)
+{
+    while (model_head != model_next) {
+        check_head(queue);
+        ack_head(queue);
+    }
+    check_head(queue);
+    check_count(queue);
+}
+
+// ---------------------------------------------------------------------------
+// Directory helpers
+
+static void make_dir(char *dir, size_t size)
+{
+    snprintf(dir, size, "/tmp/sdq_XXXXXX");
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        exit(2);
+    }
+}
+
+static void remove_dir(const char *dir)
+{
+    DIR *dp = opendir(dir);
+    if (!dp) {
+        return;
+    }
+    struct dirent *entry;
+    char path[512];
+    while ((entry = readdir(dp)) != NULL) {
+        if (entry->d_name[0] != '.') {
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dp);
+    rmdir(dir);
+}
+
+static void segment_path(const char *dir, uint32_t segment, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%08lu.seg", dir, (unsigned long)segment);
+}
+
+static bool segment_exists(const char *dir, uint32_t segment)
+{
+    char path[256];
+    struct stat st;
+    segment_path(dir, segment, path, sizeof(path));
+    return stat(path, &st) == 0;
+}
+
+static long segment_size(const char *dir, uint32_t segment)
+{
+    char path[256];
+    struct stat st;
+    segment_path(dir, segment, path, sizeof(path));
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+// Flip one byte of a segment file, as a bad sector would
+static void corrupt_byte(const char *dir, uint32_t segment, long offset)
+{
+    char path[256];
+    segment_path(dir, segment, path, sizeof(path));
+    FILE *fp = fopen(path, "r+b");
+    if (!fp) {
+        return;
+    }
+    fseek(fp, offset, SEEK_SET);
+    int c = fgetc(fp);
+    fseek(fp, offset, SEEK_SET);
+    fputc(c ^ 0x5A, fp);
+    fclose(fp);
+}
+
+static void open_queue(sd_queue_t *queue, const char *dir, sd_queue_sync_t sync)
+{
+    CHECK_EQ_INT(sd_queue_open(queue, dir), ESP_OK);
+    sd_queue_set_sync(queue, sync, 0);
+    model_scan = model_head;
+}
+
+// ---------------------------------------------------------------------------
+
+static void test_round_trip(void)
+{
+    char dir[32];
+    sd_queue_t queue;
+    make_dir(dir, sizeof(dir));
+    model_reset();
+    srand(11);
+
+    open_queue(&queue, dir, SD_QUEUE_SYNC_BATCH);
+    check_head(&queue);
+    for (int i = 0; i < 700; i++) {
+        CHECK_EQ_INT(append_record(&queue, random_length()), ESP_OK);
+    }
+    CHECK(queue.tail_segment > queue.head_segment + 2);
+    check_count(&queue);
+
+    // Read ahead over segment boundaries, then consume half and reopen
+    for (int i = 0; i < 450; i++) {
+        check_read_next(&queue);
+    }
+    for (int i = 0; i < 350; i++) {
+        ack_head(&queue);
+    }
+    check_read_next(&queue);
+    sd_queue_close(&queue);
+
+    open_queue(&queue, dir, SD_QUEUE_SYNC_RECORD);
+    check_count(&queue);
+    check_read_next(&queue);
+    CHECK_EQ_INT(queue.first_id, model_head);
+    CHECK_EQ_INT(queue.last_id, model_next - 1);
+    uint32_t first_live = queue.head_segment;
+    drain(&queue);
+
+    // Consumed segments are deleted, IDs keep counting after a reopen
+    CHECK(!segment_exists(dir, first_live));
+    sd_queue_close(&queue);
+    open_queue(&queue, dir, SD_QUEUE_SYNC_RECORD);
+    CHECK_EQ_INT(queue.last_id, model_next - 1);
+    check_head(&queue);
+    sd_queue_close(&queue);
+    remove_dir(dir);
+}
+
+// A read failure at each point of the read path must not skip or delete anything
+static void test_injected_read_failures(void)
+{
+    char dir[32];
+    sd_queue_t queue;
+    make_dir(dir, sizeof(dir));
+    model_reset();
+
+    open_queue(&queue, dir, SD_QUEUE_SYNC_BATCH);
+    for (int i = 0; i < 200; i++) {
+        CHECK_EQ_INT(append_record(&queue, 700), ESP_OK);
+    }
+    CHECK_EQ_INT(sd_queue_flush(&queue), ESP_OK);
+    uint32_t head_segment = queue.head_segment;
+    CHECK(queue.tail_segment > head_segment + 1);
+
+    // Header read, body read
+    for (int call = 0; call < 2; call++) {
+        int failures = fread_failures;
+        fail_fread(call);
+        CHECK_EQ_INT(sd_queue_peek(&queue, NULL, NULL, 0, NULL), ESP_FAIL);
+        CHECK_EQ_INT(fread_failures, failures + 1);
+        CHECK_EQ_INT(queue.head_segment, head_segment);
+        CHECK_EQ_INT(queue.head_offset, 0);
+        CHECK(segment_exists(dir, head_segment));
+        check_count(&queue);
+        check_head(&queue);
+    }
+
+    // Ack peeks first when the head is not cached
+    sd_queue_close(&queue);
+    open_queue(&queue, dir, SD_QUEUE_SYNC_BATCH);
+    fail_fread(0);
+    CHECK_EQ_INT(sd_queue_ack(&queue, model_head), ESP_FAIL);
+    check_count(&queue);
+    ack_head(&queue);
+    check_head(&queue);
+
+    // First read in a fresh segment, right after the previous one was deleted
+    while (queue.head_segment == head_segment) {
+        ack_head(&queue);
+    }
+    CHECK(!segment_exists(dir, head_segment));
+    fail_fread(0);
+    CHECK_EQ_INT(sd_queue_peek(&queue, NULL, NULL, 0, NULL), ESP_FAIL);
+    CHECK(segment_exists(dir, head_segment + 1));
+    CHECK_EQ_INT(queue.head_segment, head_segment + 1);
+    check_head(&queue);
+
+    // Read-ahead into the next segment keeps its cursor
+    while (model_scan < model_next && queue.scan_segment <= queue.head_segment) {
+        check_read_next(&queue);
+    }
+    fail_fread(1);
+    CHECK_EQ_INT(sd_queue_read_next(&queue, NULL, NULL, 0, NULL), ESP_FAIL);
+    check_read_next(&queue);
+    check_count(&queue);
+
+    // Failure while resynchronising after a corrupt record
+    sd_queue_rewind(&queue);
+    model_scan = model_head;
+    corrupt_byte(dir, queue.head_segment, (long)queue.head_offset + SD_QUEUE_HEADER_SIZE + 5);
+    sd_queue_close(&queue);
+    open_queue(&queue, dir, SD_QUEUE_SYNC_BATCH);
+    fail_fread(2);                         // Header, body, then the first resync read
+    CHECK_EQ_INT(sd_queue_peek(&queue, NULL, NULL, 0, NULL), ESP_FAIL);
+    CHECK_EQ_INT(queue.head_offset, 0);
+    CHECK(segment_exists(dir, queue.head_segment));
+    // The corrupt record itself is skipped once the card reads again
+    model_head++;
+    check_head(&queue);
+    check_count(&queue);
+
+    drain(&queue);
+    sd_queue_close(&queue);
+    remove_dir(dir);
+}
+
+// Acks rewrite the index per the sync policy; a crash replays the unsaved ones
+static void test_ack_persistence(void)
+{
+    char dir[32];
+    sd_queue_t queue;
+    sd_queue_t after_crash;
+    uint32_t count = 0;
+    make_dir(dir, sizeof(dir));
+    model_reset();
+
+    open_queue(&queue, dir, SD_QUEUE_SYNC_BATCH);
+    for (int i = 0; i < 3 * SD_QUEUE_ACK_SAVE_EVERY; i++) {
+        CHECK_EQ_INT(append_record(&queue, 100), ESP_OK);
+    }
+    CHECK_EQ_INT(sd_queue_flush(&queue), ESP_OK);
+    uint32_t seq = queue.index_seq;
+
+    for (int i = 0; i < SD_QUEUE_ACK_SAVE_EVERY - 1; i++) {
+        ack_head(&queue);
+    }
+    CHECK_EQ_INT(queue.index_seq, seq);
+
+    // What a reboot now would find: the acks so far come back
+    CHECK_EQ_INT(sd_queue_open(&after_crash, dir), ESP_OK);
+    CHECK_EQ_INT(sd_queue_count(&after_crash, &count), ESP_OK);
+    CHECK_EQ_INT(count, 3 * SD_QUEUE_ACK_SAVE_EVERY);
+    sd_queue_close(&after_crash);
+
+    ack_head(&queue);
+    CHECK_EQ_INT(queue.index_seq, seq + 1);
+
+    // A flush saves acks even with nothing staged
+    ack_head(&queue);
+    CHECK_EQ_INT(sd_queue_flush(&queue), ESP_OK);
+    CHECK_EQ_INT(queue.index_seq, seq + 2);
+    CHECK_EQ_INT(sd_queue_flush(&queue), ESP_OK);
+    CHECK_EQ_INT(queue.index_seq, seq + 2);
+
+    // Periodic: saved once the interval has passed since the first unsaved ack
+    sd_queue_set_sync(&queue, SD_QUEUE_SYNC_PERIODIC, 0);
+    ack_head(&queue);
+    CHECK_EQ_INT(queue.index_seq, seq + 2);
+    CHECK_EQ_INT(sd_queue_flush_due(&queue), ESP_OK);
+    CHECK_EQ_INT(queue.index_seq, seq + 3);
+
+    // Record: every ack
+    sd_queue_set_sync(&queue, SD_QUEUE_SYNC_RECORD, 0);
+    ack_head(&queue);
+    ack_head(&queue);
+    CHECK_EQ_INT(queue.index_seq, seq + 5);
+
+    // Batch again: the last ack of a drain is saved at once
+    sd_queue_set_sync(&queue, SD_QUEUE_SYNC_BATCH, 0);
+    while (model_head != model_next) {
+        ack_head(&queue);
+    }
+    CHECK_EQ_INT(queue.unsaved_acks, 0);
+    CHECK_EQ_INT(sd_queue_open(&after_crash, dir), ESP_OK);
+    CHECK_EQ_INT(sd_queue_count(&after_crash, &count), ESP_OK);
+    CHECK_EQ_INT(count, 0);
+    sd_queue_close(&after_crash);
+
+    // Close saves the rest
+    CHECK_EQ_INT(append_record(&queue, 100), ESP_OK);
+    CHECK_EQ_INT(append_record(&queue, 100), ESP_OK);
+    CHECK_EQ_INT(sd_queue_flush(&queue), ESP_OK);
+    ack_head(&queue);
+    sd_queue_close(&queue);
+    open_queue(&queue, dir, SD_QUEUE_SYNC_BATCH);
+    check_count(&queue);
+    check_head(&queue);
+    sd_queue_close(&queue);
+    remove_dir(dir);
+}
+
+// Power loss mid-append and a bad sector in an older segment
+static void test_recovery(void)
+{
+    char dir[32];
+    sd_queue_t queue;
+    make_dir(dir, sizeof(dir));
+    model_reset();
+
+    open_queue(&queue, dir, SD_QUEUE_SYNC_RECORD);
+    for (int i = 0; i < 150; i++) {
+        CHECK_EQ_INT(append_record(&queue, 900), ESP_OK);
+    }
+    uint32_t tail_segment = queue.tail_segment;
+    sd_queue_close(&queue);
+
+    // Tear the last record
+    char path[256];
+    segment_path(dir, tail_segment, path, sizeof(path));
+    CHECK_EQ_INT(truncate(path, segment_size(dir, tail_segment) - 100), 0);
+    model_next--;
+
+    // Corrupt a record body in the first segment
+    uint32_t lost = 5;
+    corrupt_byte(dir, 1, (long)(lost - 1) * (SD_QUEUE_HEADER_SIZE + 900) + SD_QUEUE_HEADER_SIZE + 300);
+
+    open_queue(&queue, dir, SD_QUEUE_SYNC_RECORD);
+    CHECK(queue.tail_segment == tail_segment + 1);
+    CHECK_EQ_INT(queue.last_id, model_next - 1);
+
+    // New records go to a fresh segment and arrive after the recovered ones
+    for (int i = 0; i < 10; i++) {
+        CHECK_EQ_INT(append_record(&queue, 50), ESP_OK);
+    }
+
+    uint8_t body[SD_QUEUE_MAX_RECORD];
+    uint32_t id;
+    uint16_t length;
+    for (uint32_t expected = 1; expected < model_next; expected++) {
+        if (expected == lost) {
+            continue;
+        }
+        CHECK_EQ_INT(sd_queue_peek(&queue, &id, body, sizeof(body), &length), ESP_OK);
+        CHECK_EQ_INT(id, expected);
+        CHECK(body_matches(id, body, length));
+        CHECK_EQ_INT(sd_queue_ack(&queue, id), ESP_OK);
+    }
+    CHECK_EQ_INT(sd_queue_peek(&queue, &id, body, sizeof(body), &length), ESP_ERR_NOT_FOUND);
+    CHECK_EQ_INT(queue.corrupt_skips, 1);  // Reported so the caller can step the card clock down
+    sd_queue_close(&queue);
+    remove_dir(dir);
+}
+
+// Random appends, acks, read-ahead, flushes, reopens and read failures; the
+// queue must agree with the model after every step
+static void test_fuzz(void)
+{
+    char dir[32];
+    sd_queue_t queue;
+    make_dir(dir, sizeof(dir));
+    model_reset();
+    srand(1234);
+
+    sd_queue_sync_t sync = SD_QUEUE_SYNC_BATCH;
+    open_queue(&queue, dir, sync);
+    int injected = 0;
+
+    for (int step = 0; step < FUZZ_STEPS && model_next < MAX_RECORDS; step++) {
+        int op = rand() % 100;
+        if (op < 40) {
+            CHECK_EQ_INT(append_record(&queue, random_length()), ESP_OK);
+        } else if (op < 65) {
+            if (model_head != model_next) {
+                ack_head(&queue);
+            }
+        } else if (op < 80) {
+            check_read_next(&queue);
+        } else if (op < 85) {
+            CHECK_EQ_INT(sd_queue_flush(&queue), ESP_OK);
+        } else if (op < 88) {
+            sd_queue_close(&queue);
+            sync = (sd_queue_sync_t)(rand() % 3);
+            open_queue(&queue, dir, sync);
+        } else if (op < 90) {
+            sd_queue_rewind(&queue);
+            model_scan = model_head;
+        } else {
+            // Fail one of the next few reads; whatever call hits it reports
+            // ESP_FAIL and changes nothing
+            int failures = fread_failures;
+            uint32_t head_segment = queue.head_segment;
+            uint32_t expected = model_scan > model_head ? model_scan : model_head;
+            uint32_t id = 0;
+            bool read_ahead = rand() % 2;
+            fail_fread(rand() % 3);
+            esp_err_t ret = read_ahead ? sd_queue_read_next(&queue, &id, NULL, 0, NULL)
+                                       : sd_queue_peek(&queue, &id, NULL, 0, NULL);
+            if (fread_failures != failures) {
+                injected++;
+                CHECK_EQ_INT(ret, ESP_FAIL);
+                CHECK_EQ_INT(queue.head_segment, head_segment);
+                CHECK(segment_exists(dir, head_segment));
+            } else if (read_ahead && ret == ESP_OK) {
+                CHECK_EQ_INT(id, expected);
+                model_scan = expected + 1;
+            }
+            fail_fread(-1);
+        }
+        check_count(&queue);
+        check_head(&queue);
+    }
+    CHECK(injected > 100);
+
+    sd_queue_close(&queue);
+    open_queue(&queue, dir, sync);
+    check_count(&queue);
+    drain(&queue);
+    sd_queue_close(&queue);
+    remove_dir(dir);
+}
+
+int main(void)
+{
+    test_round_trip();
+    test_injected_read_failures();
+    test_ack_persistence();
+    test_recovery();
+    test_fuzz();
+    return TEST_RESULT();
+}
@@ -0,0 +1,397 @@
+// test_sd_replay.c - Pipelined backlog replay against a fake card and broker
+// sd_replay.c runs unchanged in its own task. The card side is a list of
+// pending messages that only lets the oldest one be removed; the broker side
+// acknowledges each publish after a set latency from a task of its own, and
+// can lose acks or the whole connection. Checked: every message is removed
+// once and in order, the window opens up to SD_REPLAY_MAX_INFLIGHT while acks
+// are fast and closes when they slow down, a lost ack is resent after
+// SD_REPLAY_ACK_TIMEOUT_MS with a window of one, and a reconnect resends what
+// was in flight starting from SD_REPLAY_INITIAL_WINDOW.
+//
+// Built with shortened timeouts (see CMakeLists.txt) so the test runs in seconds.
+
+#include "host_test.h"
+#include "sd_replay.h"
+#include "sd_card_logger.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+#define MAX_MESSAGES 512
+#define DRAIN_TIMEOUT_MS 20000
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+// ---------------------------------------------------------------------------
+// Fake card: message IDs first_id.., removable oldest first only
+
+static uint32_t card_ids[MAX_MESSAGES];
+static bool card_bad[MAX_MESSAGES];              // Read back as ESP_ERR_INVALID_RESPONSE
+static int card_count;
+static int card_head;                            // Oldest not yet removed
+static int card_cursor;                          // Next to read
+static int card_removals;
+static int card_bad_removals;
+static int card_out_of_order;
+
+bool sd_card_is_available(void)
+{
+    return true;
+}
+
+esp_err_t sd_card_read_next_message(pending_message_t *msg)
+{
+    pthread_mutex_lock(&lock);
+    if (card_cursor >= card_count) {
+        pthread_mutex_unlock(&lock);
+        return ESP_ERR_NOT_FOUND;
+    }
+    int n = card_cursor++;
+    memset(msg, 0, sizeof(*msg));
+    msg->message_id = card_ids[n];
+    snprintf(msg->timestamp, sizeof(msg->timestamp), "2025-11-24T12:%02d:00Z", n % 60);
+    snprintf(msg->topic, sizeof(msg->topic), "devices/test/messages/events/");
+    snprintf(msg->payload, sizeof(msg->payload), "%lu", (unsigned long)card_ids[n]);
+    bool bad = card_bad[n];
+    pthread_mutex_unlock(&lock);
+    return bad ? ESP_ERR_INVALID_RESPONSE : ESP_OK;
+}
+
+void sd_card_rewind_messages(void)
+{
+    pthread_mutex_lock(&lock);
+    card_cursor = card_head;
+    pthread_mutex_unlock(&lock);
+}
+
+esp_err_t sd_card_remove_message(uint32_t message_id)
+{
+    pthread_mutex_lock(&lock);
+    esp_err_t ret = ESP_OK;
+    if (card_head >= card_count || card_ids[card_head] != message_id) {
+        card_out_of_order++;
+        ret = ESP_ERR_INVALID_STATE;
+    } else {
+        card_bad_removals += card_bad[card_head];
+        card_head++;
+        card_removals++;
+    }
+    pthread_mutex_unlock(&lock);
+    return ret;
+}
+
+esp_err_t sd_card_get_pending_count(uint32_t *count)
+{
+    pthread_mutex_lock(&lock);
+    *count = (uint32_t)(card_count - card_head);
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+static void card_load(int count, uint32_t first_id)
+{
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < count; i++) {
+        card_ids[i] = first_id + (uint32_t)i;
+        card_bad[i] = false;
+    }
+    card_count = count;
+    card_head = 0;
+    card_cursor = 0;
+    card_removals = 0;
+    card_bad_removals = 0;
+    card_out_of_order = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+// ---------------------------------------------------------------------------
+// Fake broker: acks each publish latency_ms later, unless it is lost
+
+typedef struct {
+    int msg_id;
+    int64_t due_us;
+} broker_ack_t;
+
+static broker_ack_t broker_pending[MAX_MESSAGES];
+static int broker_pending_count;
+static int broker_next_msg_id = 1;
+static int broker_latency_ms = 2;
+static uint32_t broker_drop_id;                  // First publish of this message loses its ack (0 = none)
+static bool broker_connected;
+
+// Per message ID, relative to the loaded backlog
+static uint32_t broker_first_id;
+static int publish_count[MAX_MESSAGES];
+
+// Every publish in order: message and acks outstanding just before it
+typedef struct {
+    uint32_t message_id;
+    int outstanding;
+    int epoch;                                   // Connection it was sent on
+} publish_log_t;
+
+static publish_log_t publish_log[4 * MAX_MESSAGES];
+static int publish_log_count;
+static int broker_epoch;
+
+static int broker_publish(const char *topic, const char *payload)
+{
+    (void)topic;
+    uint32_t message_id = (uint32_t)strtoul(payload, NULL, 10);
+    pthread_mutex_lock(&lock);
+    if (!broker_connected || broker_pending_count >= MAX_MESSAGES) {
+        pthread_mutex_unlock(&lock);
+        return -1;
+    }
+    int msg_id = broker_next_msg_id;
+    broker_next_msg_id = broker_next_msg_id % 65535 + 1;
+
+    int index = (int)(message_id - broker_first_id);
+    bool lost = message_id == broker_drop_id && publish_count[index] == 0;
+    publish_count[index]++;
+    if (publish_log_count < (int)(sizeof(publish_log) / sizeof(publish_log[0]))) {
+        publish_log[publish_log_count++] = (publish_log_t){ message_id, broker_pending_count, broker_epoch };
+    }
+    if (!lost) {
+        broker_pending[broker_pending_count++] = (broker_ack_t){
+            msg_id, esp_timer_get_time() + (int64_t)broker_latency_ms * 1000
+        };
+    }
+    pthread_mutex_unlock(&lock);
+    return msg_id;
+}
+
+static void broker_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        int due[MAX_MESSAGES];
+        int due_count = 0;
+        int64_t now_us = esp_timer_get_time();
+
+        pthread_mutex_lock(&lock);
+        int kept = 0;
+        for (int i = 0; i < broker_pending_count; i++) {
+            if (broker_pending[i].due_us <= now_us) {
+                due[due_count++] = broker_pending[i].msg_id;
+            } else {
+                broker_pending[kept++] = broker_pending[i];
+            }
+        }
+        broker_pending_count = kept;
+        pthread_mutex_unlock(&lock);
+
+        for (int i = 0; i < due_count; i++) {
+            sd_replay_on_published(due[i]);
+        }
+        vTaskDelay(1);
+    }
+}
+
+static void broker_connect(bool connected)
+{
+    pthread_mutex_lock(&lock);
+    broker_connected = connected;
+    broker_pending_count = 0;                    // A lost connection loses its acks
+    broker_epoch++;
+    pthread_mutex_unlock(&lock);
+    sd_replay_set_connected(connected);
+}
+
+static void broker_reset(uint32_t first_id, int latency_ms)
+{
+    pthread_mutex_lock(&lock);
+    broker_first_id = first_id;
+    broker_latency_ms = latency_ms;
+    broker_drop_id = 0;
+    memset(publish_count, 0, sizeof(publish_count));
+    publish_log_count = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+static void set_latency(int latency_ms)
+{
+    pthread_mutex_lock(&lock);
+    broker_latency_ms = latency_ms;
+    pthread_mutex_unlock(&lock);
+}
+
+static int removals(void)
+{
+    pthread_mutex_lock(&lock);
+    int n = card_removals;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+static bool wait_for_removals(int count)
+{
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)DRAIN_TIMEOUT_MS * 1000;
+    while (removals() < count) {
+        if (esp_timer_get_time() > deadline_us) {
+            return false;
+        }
+        vTaskDelay(1);
+    }
+    return true;
+}
+
+static int max_outstanding(int from, int to)
+{
+    int max = 0;
+    for (int i = from; i < to && i < publish_log_count; i++) {
+        if (publish_log[i].outstanding > max) {
+            max = publish_log[i].outstanding;
+        }
+    }
+    return max;
+}
+
+static void check_drained(int count)
+{
+    CHECK(wait_for_removals(count));
+    vTaskDelay(pdMS_TO_TICKS(20));
+    pthread_mutex_lock(&lock);
+    CHECK_EQ_INT(card_removals, count);
+    CHECK_EQ_INT(card_head, card_count);
+    CHECK_EQ_INT(card_out_of_order, 0);
+    pthread_mutex_unlock(&lock);
+}
+
+// ---------------------------------------------------------------------------
+
+// Fast acks: everything goes out, the window opens fully, and records the
+// card cannot parse are removed in their place without being published
+static void test_fast_acks(void)
+{
+    const int count = 300;
+    card_load(count, 1000);
+    card_bad[10] = card_bad[11] = card_bad[200] = true;
+    broker_reset(1000, 2);
+    broker_connect(true);
+
+    check_drained(count);
+    CHECK_EQ_INT(card_bad_removals, 3);
+    CHECK_EQ_INT(publish_count[10], 0);
+    CHECK_EQ_INT(publish_count[200], 0);
+    int published_once = 0;
+    for (int i = 0; i < count; i++) {
+        published_once += publish_count[i] == 1;
+    }
+    CHECK_EQ_INT(published_once, count - 3);
+    CHECK_EQ_INT(max_outstanding(0, 1), 0);
+    // The first round trip is limited to the initial window
+    CHECK(max_outstanding(0, SD_REPLAY_INITIAL_WINDOW) < SD_REPLAY_INITIAL_WINDOW);
+    CHECK_EQ_INT(max_outstanding(0, publish_log_count), SD_REPLAY_MAX_INFLIGHT - 1);
+    broker_connect(false);
+}
+
+// Acks slowing down well past twice the fastest: the window is halved down
+// to a message or two in flight
+static void test_slow_acks_close_window(void)
+{
+    const int count = 250;
+    card_load(count, 5000);
+    broker_reset(5000, 2);
+    broker_connect(true);
+
+    CHECK(wait_for_removals(100));
+    CHECK_EQ_INT(max_outstanding(0, publish_log_count), SD_REPLAY_MAX_INFLIGHT - 1);
+    set_latency(4 * SD_REPLAY_LATENCY_SLACK_MS);
+    CHECK(wait_for_removals(200));
+    pthread_mutex_lock(&lock);
+    int end = publish_log_count;
+    pthread_mutex_unlock(&lock);
+    CHECK(max_outstanding(end - 5, end) <= 1);
+
+    set_latency(2);
+    check_drained(count);
+    broker_connect(false);
+}
+
+// A lost ack holds back retirement until it times out; the replay then
+// resends from that message with one message in flight
+static void test_lost_ack_resent(void)
+{
+    const int count = 100;
+    card_load(count, 9000);
+    broker_reset(9000, 2);
+    pthread_mutex_lock(&lock);
+    broker_drop_id = 9040;
+    pthread_mutex_unlock(&lock);
+    int64_t start_us = esp_timer_get_time();
+    broker_connect(true);
+
+    check_drained(count);
+    CHECK(esp_timer_get_time() - start_us >= (int64_t)SD_REPLAY_ACK_TIMEOUT_MS * 1000);
+    CHECK_EQ_INT(publish_count[40], 2);
+    for (int i = 0; i < 40; i++) {
+        CHECK_EQ_INT(publish_count[i], 1);
+    }
+
+    // The resend goes out alone, the next publish waits for its ack
+    int resend = -1;
+    for (int i = 0; i < publish_log_count; i++) {
+        if (publish_log[i].message_id == 9040) {
+            resend = i;                          // Last one
+        }
+    }
+    CHECK(resend > 0);
+    CHECK_EQ_INT(max_outstanding(resend, resend + 2), 0);
+    broker_connect(false);
+}
+
+// Dropping the connection mid-drain loses the acks in flight: after the
+// reconnect those messages are sent again, starting from the initial window
+static void test_reconnect_resends(void)
+{
+    const int count = 300;
+    card_load(count, 20000);
+    broker_reset(20000, 30);
+    broker_connect(true);
+
+    // Acks that reached the replay before the drop still count
+    CHECK(wait_for_removals(100));
+    broker_connect(false);
+    vTaskDelay(pdMS_TO_TICKS(20));
+    int removed_at_drop = removals();
+    vTaskDelay(pdMS_TO_TICKS(50));
+    CHECK_EQ_INT(removals(), removed_at_drop);
+    broker_connect(true);
+
+    check_drained(count);
+    int resent = 0;
+    for (int i = 0; i < count; i++) {
+        resent += publish_count[i] > 1;
+    }
+    CHECK(resent > 0);
+    CHECK(resent <= SD_REPLAY_MAX_INFLIGHT);
+
+    int first = -1;
+    for (int i = 0; i < publish_log_count; i++) {
+        if (publish_log[i].epoch == broker_epoch) {
+            first = i;
+            break;
+        }
+    }
+    CHECK(first >= 0);
+    CHECK_EQ_INT(publish_log[first].message_id, 20000 + (uint32_t)removed_at_drop);
+    CHECK(max_outstanding(first, first + SD_REPLAY_INITIAL_WINDOW + 1) <= SD_REPLAY_INITIAL_WINDOW);
+    broker_connect(false);
+}
+
+int main(void)
+{
+    host_log_level = ESP_LOG_ERROR;
+    CHECK_EQ_INT(sd_replay_start(broker_publish), ESP_OK);
+    xTaskCreate(broker_task, "broker", 4096, NULL, 5, NULL);
+
+    test_fast_acks();
+    test_slow_acks_close_window();
+    test_lost_ack_resent();
+    test_reconnect_resends();
+    return TEST_RESULT();
+}
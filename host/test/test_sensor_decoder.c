@@ -0,0 +1,282 @@
+// test_sensor_decoder.c - Compiled decoders against the interpreted decoder they replaced
+// Every data type the web interface offers, under every byte_order, is decoded
+// from golden and random registers by both paths. Wherever the interpreted
+// decoder produced a value the compiled one must produce the same bits; the
+// formats only the compiled decoder supports are listed and checked against
+// golden values.
+
+#include "host_test.h"
+#include "sensor_decoder.h"
+#include "legacy_sensor_decoder.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <math.h>
+
+static const char *const data_types[] = {
+    "UINT16", "INT16", "UINT16_HI", "UINT16_LO", "INT16_HI", "INT16_LO",
+    "UINT32", "INT32", "FLOAT32",
+    "UINT32_1234", "UINT32_4321", "UINT32_3412", "UINT32_2143",
+    "INT32_1234", "INT32_4321", "INT32_3412", "INT32_2143",
+    "FLOAT32_1234", "FLOAT32_4321", "FLOAT32_3412", "FLOAT32_2143",
+    "UINT32_ABCD", "UINT32_CDAB", "UINT32_BADC", "UINT32_DCBA",
+    "INT32_ABCD", "INT32_CDAB", "INT32_BADC", "INT32_DCBA",
+    "FLOAT32_ABCD", "FLOAT32_CDAB", "FLOAT32_BADC", "FLOAT32_DCBA",
+    "UINT64", "INT64", "FLOAT64",
+    "UINT64_12345678", "UINT64_87654321", "UINT64_78563412", "UINT64_21436587",
+    "INT64_12345678", "INT64_87654321", "INT64_78563412", "INT64_21436587",
+    "FLOAT64_12345678", "FLOAT64_87654321", "FLOAT64_78563412", "FLOAT64_21436587",
+    "FLOAT64_1234567", "FLOAT64_8765432", "FLOAT64_7856341",
+    "HEX", "UINT8", "INT8", "BOOL", "ASCII", "PDU", "",
+};
+#define DATA_TYPE_COUNT (sizeof(data_types) / sizeof(data_types[0]))
+
+static const char *const byte_orders[] = {
+    "BIG_ENDIAN", "LITTLE_ENDIAN", "MIXED_BADC", "MIXED_DCBA", "", "BOGUS",
+};
+#define BYTE_ORDER_COUNT (sizeof(byte_orders) / sizeof(byte_orders[0]))
+
+// Formats the interpreted decoder rejected and the compiled one decodes
+static bool is_extension(const char *data_type, const char *byte_order)
+{
+    static const char *const extended_types[] = {
+        "UINT16_HI", "UINT16_LO", "INT16_HI", "INT16_LO", "FLOAT32_2143", "FLOAT64_21436587",
+    };
+    for (size_t i = 0; i < sizeof(extended_types) / sizeof(extended_types[0]); i++) {
+        if (strcmp(data_type, extended_types[i]) == 0) {
+            return true;
+        }
+    }
+    // 64-bit integers were never decoded before
+    if (strncmp(data_type, "UINT64", 6) == 0 || strncmp(data_type, "INT64", 5) == 0) {
+        return true;
+    }
+    // FLOAT32 accepted only word orders
+    return strcmp(data_type, "FLOAT32") == 0 &&
+           (strcmp(byte_order, "MIXED_BADC") == 0 || strcmp(byte_order, "MIXED_DCBA") == 0);
+}
+
+static bool same_bits(double a, double b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static int compared;
+static int extensions_seen;
+
+static void compare_format(const char *data_type, const char *byte_order, double scale_factor,
+                           const uint16_t *registers, int reg_count)
+{
+    double legacy_value = 0, compiled_value = 0;
+    uint32_t legacy_raw = 0, compiled_raw = 0;
+    esp_err_t legacy = legacy_convert_modbus_data(registers, reg_count, data_type, byte_order, scale_factor,
+                                                  &legacy_value, &legacy_raw);
+
+    sensor_decoder_t decoder;
+    esp_err_t compiled = sensor_decoder_compile_format(data_type, byte_order, scale_factor, &decoder);
+    if (compiled == ESP_OK) {
+        compiled = sensor_decoder_decode(&decoder, NULL, registers, reg_count, &compiled_value, &compiled_raw);
+    }
+
+    if (legacy == ESP_OK) {
+        compared++;
+        if (compiled != ESP_OK || !same_bits(legacy_value, compiled_value) || legacy_raw != compiled_raw) {
+            test_failures++;
+            fprintf(stderr, "%s / %s, %d regs %04X %04X %04X %04X: legacy %.17g (0x%08X), compiled %s %.17g (0x%08X)\n",
+                    data_type, byte_order, reg_count, registers[0], registers[1], registers[2], registers[3],
+                    legacy_value, legacy_raw, esp_err_to_name(compiled), compiled_value, compiled_raw);
+        }
+    } else if (compiled == ESP_OK) {
+        if (is_extension(data_type, byte_order)) {
+            extensions_seen++;
+        } else {
+            test_failures++;
+            fprintf(stderr, "%s / %s: rejected before, decoded now\n", data_type, byte_order);
+        }
+    }
+    test_checks++;
+}
+
+// Registers that exercise sign bits, NaN/infinity exponents and zero words
+static uint16_t random_register(void)
+{
+    static const uint16_t specials[] = { 0x0000, 0xFFFF, 0x8000, 0x7FFF, 0x7F80, 0x7FC0, 0xFF80, 0x0001 };
+    int r = rand();
+    return (r & 3) == 0 ? specials[(r >> 2) & 7] : (uint16_t)(r >> 4);
+}
+
+static void test_all_formats_match_legacy(void)
+{
+    static const double scales[] = { 1.0, 0.1f, 0.001f, -2.5f, 1000.0f };
+    srand(10);
+    for (int round = 0; round < 400; round++) {
+        uint16_t registers[4];
+        for (int i = 0; i < 4; i++) {
+            registers[i] = random_register();
+        }
+        double scale_factor = scales[round % 5];
+        for (size_t t = 0; t < DATA_TYPE_COUNT; t++) {
+            for (size_t o = 0; o < BYTE_ORDER_COUNT; o++) {
+                for (int reg_count = 1; reg_count <= 4; reg_count++) {
+                    compare_format(data_types[t], byte_orders[o], scale_factor, registers, reg_count);
+                }
+            }
+        }
+    }
+    CHECK(compared > 100000);
+    CHECK(extensions_seen > 0);
+}
+
+typedef struct {
+    const char *data_type;
+    const char *byte_order;
+    uint16_t registers[4];
+    int reg_count;
+    double value;
+    uint32_t raw;
+} golden_t;
+
+// 1234.5 = 0x40934A0000000000, 12.5f = 0x41480000
+static const golden_t golden[] = {
+    { "UINT16", "", { 0xFFFF }, 1, 65535, 0xFFFF },
+    { "INT16", "LITTLE_ENDIAN", { 0xFFFF }, 1, -1, 0xFFFF },
+    { "UINT16_LO", "", { 0x3412 }, 1, 0x1234, 0x1234 },
+    { "INT16_HI", "", { 0x8000 }, 1, -32768, 0x8000 },
+    { "UINT32_1234", "", { 0x1234, 0x5678 }, 2, 0x12345678, 0x12345678 },
+    { "UINT32_4321", "", { 0x5678, 0x1234 }, 2, 0x12345678, 0x12345678 },
+    { "UINT32_3412", "", { 0x5678, 0x1234 }, 2, 0x12345678, 0x12345678 },
+    { "UINT32_2143", "", { 0x3412, 0x7856 }, 2, 0x12345678, 0x12345678 },
+    { "INT32_1234", "", { 0xFFFF, 0xFFFE }, 2, -2, 0xFFFFFFFE },
+    { "INT32_3412", "", { 0xFFFE, 0xFFFF }, 2, -2, 0xFFFFFFFE },
+    { "UINT32", "BIG_ENDIAN", { 0x1234, 0x5678 }, 2, 0x12345678, 0x12345678 },
+    { "UINT32", "LITTLE_ENDIAN", { 0x5678, 0x1234 }, 2, 0x12345678, 0x12345678 },
+    { "UINT32", "MIXED_BADC", { 0x3412, 0x7856 }, 2, 0x12345678, 0x12345678 },
+    { "UINT32", "MIXED_DCBA", { 0x7856, 0x3412 }, 2, 0x12345678, 0x12345678 },
+    { "FLOAT32_1234", "", { 0x4148, 0x0000 }, 2, 12.5, 0x41480000 },
+    { "FLOAT32_3412", "", { 0x0000, 0x4148 }, 2, 12.5, 0x41480000 },
+    { "FLOAT32_4321", "", { 0x0000, 0x4148 }, 2, 12.5, 0x41480000 },
+    { "FLOAT32", "BIG_ENDIAN", { 0xC148, 0x0000 }, 2, -12.5, 0xC1480000 },
+    { "FLOAT32_2143", "", { 0x4841, 0x0000 }, 2, 12.5, 0x41480000 },
+    { "FLOAT64_12345678", "", { 0x4093, 0x4A00, 0x0000, 0x0000 }, 4, 1234.5, 0 },
+    { "FLOAT64_1234567", "", { 0x4093, 0x4A00, 0x0000, 0x0000 }, 4, 1234.5, 0 },
+    { "FLOAT64_87654321", "", { 0x0000, 0x0000, 0x4A00, 0x4093 }, 4, 1234.5, 0 },
+    { "FLOAT64_78563412", "", { 0x0000, 0x0000, 0x004A, 0x9340 }, 4, 1234.5, 0 },
+    { "FLOAT64_21436587", "", { 0x9340, 0x004A, 0x0000, 0x0000 }, 4, 1234.5, 0 },
+    { "FLOAT64", "BIG_ENDIAN", { 0x4093, 0x4A00, 0x0000, 0x0001 }, 4, 1234.5000000000002, 1 },
+    { "UINT64_12345678", "", { 0x0000, 0x0000, 0x0001, 0x0000 }, 4, 65536, 0x00010000 },
+    { "UINT64_87654321", "", { 0x0000, 0x0000, 0x0001, 0x0000 }, 4, 4294967296.0, 0 },
+    { "INT64_87654321", "", { 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF }, 4, -1, 0xFFFFFFFF },
+    { "HEX", "", { 0x1234, 0x5678 }, 2, 0x12345678, 0x12345678 },
+    { "HEX", "", { 0xABCD }, 1, 0xABCD, 0xABCD },
+};
+
+static void test_golden_values(void)
+{
+    for (size_t i = 0; i < sizeof(golden) / sizeof(golden[0]); i++) {
+        const golden_t *g = &golden[i];
+        sensor_decoder_t decoder;
+        double value = 0;
+        uint32_t raw = 0;
+        CHECK_EQ_INT(sensor_decoder_compile_format(g->data_type, g->byte_order, 1.0, &decoder), ESP_OK);
+        CHECK_EQ_INT(sensor_decoder_decode(&decoder, NULL, g->registers, g->reg_count, &value, &raw), ESP_OK);
+        if (value != g->value || raw != g->raw) {
+            test_failures++;
+            fprintf(stderr, "golden %s / %s: %.17g (0x%08X), expected %.17g (0x%08X)\n",
+                    g->data_type, g->byte_order, value, raw, g->value, g->raw);
+        }
+
+        // Scaling is one multiplication after decoding
+        CHECK_EQ_INT(sensor_decoder_compile_format(g->data_type, g->byte_order, 0.01f, &decoder), ESP_OK);
+        sensor_decoder_decode(&decoder, NULL, g->registers, g->reg_count, &value, &raw);
+        CHECK(same_bits(value, g->value * (double)0.01f));
+    }
+
+    // Too few registers and unknown formats are errors, not zeros
+    sensor_decoder_t decoder;
+    double value;
+    uint32_t raw;
+    const uint16_t registers[4] = {0};
+    CHECK_EQ_INT(sensor_decoder_compile_format("FLOAT32_1234", "", 1.0, &decoder), ESP_OK);
+    CHECK_EQ_INT(sensor_decoder_decode(&decoder, NULL, registers, 1, &value, &raw), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(sensor_decoder_compile_format("UINT32_ABCD", "", 1.0, &decoder), ESP_ERR_NOT_SUPPORTED);
+    CHECK_EQ_INT(sensor_decoder_compile_format("FLOAT64", "MIXED_DCBA", 1.0, &decoder), ESP_ERR_NOT_SUPPORTED);
+}
+
+static void compare_sensor(const sensor_config_t *sensor, const uint16_t *registers, int reg_count)
+{
+    sensor_test_result_t legacy = {0};
+    esp_err_t legacy_status = legacy_sensor_decode_registers(sensor, registers, reg_count, &legacy);
+
+    sensor_decoder_t decoder;
+    double value = 0;
+    uint32_t raw = 0;
+    esp_err_t compiled_status = sensor_decoder_compile(sensor, &decoder);
+    if (compiled_status == ESP_OK) {
+        compiled_status = sensor_decoder_decode(&decoder, sensor, registers, reg_count, &value, &raw);
+    }
+
+    test_checks++;
+    if (legacy_status == ESP_OK &&
+        (compiled_status != ESP_OK || !same_bits(legacy.scaled_value, value) || legacy.raw_value != raw)) {
+        test_failures++;
+        fprintf(stderr, "%s (%s), %d regs %04X %04X %04X %04X: legacy %.17g (0x%08X), compiled %s %.17g (0x%08X)\n",
+                sensor->sensor_type, sensor->data_type, reg_count, registers[0], registers[1], registers[2],
+                registers[3], legacy.scaled_value, legacy.raw_value, esp_err_to_name(compiled_status), value, raw);
+    }
+}
+
+// Vendor formats, including register counts too short for them (the data type applies)
+static void test_vendor_formats_match_legacy(void)
+{
+    static const char *const sensor_types[] = {
+        "Flow-Meter", "ZEST", "Panda_USM", "Clampon", "Dailian_EMF", "Panda_EMF", "Panda_Level", "Level",
+    };
+    static const char *const fallback_types[] = { "UINT16", "UINT32_3412", "FLOAT32_1234", "FLOAT64_12345678" };
+
+    srand(11);
+    for (int round = 0; round < 2000; round++) {
+        sensor_config_t sensor;
+        memset(&sensor, 0, sizeof(sensor));
+        strcpy(sensor.sensor_type, sensor_types[round % 8]);
+        strcpy(sensor.data_type, fallback_types[(round / 8) % 4]);
+        strcpy(sensor.byte_order, "BIG_ENDIAN");
+        sensor.scale_factor = (round & 1) ? 1.0f : 0.001f;
+        sensor.sensor_height = (float)(rand() % 500);
+        sensor.max_water_level = (round % 3) ? (float)(rand() % 400) : 0.0f;
+
+        uint16_t registers[4];
+        for (int i = 0; i < 4; i++) {
+            registers[i] = random_register();
+        }
+        for (int reg_count = 1; reg_count <= 4; reg_count++) {
+            sensor.quantity = reg_count;
+            compare_sensor(&sensor, registers, reg_count);
+        }
+    }
+
+    // Flow-Meter 33073 + 0.865: word-swapped UINT32 and FLOAT32
+    sensor_config_t flow = { .quantity = 4, .scale_factor = 1.0f };
+    strcpy(flow.sensor_type, "Flow-Meter");
+    strcpy(flow.data_type, "UINT32");
+    float fraction = 0.865f;
+    uint32_t bits;
+    memcpy(&bits, &fraction, sizeof(bits));
+    const uint16_t registers[4] = { 33073, 0, (uint16_t)bits, (uint16_t)(bits >> 16) };
+    sensor_decoder_t decoder;
+    double value;
+    uint32_t raw;
+    CHECK_EQ_INT(sensor_decoder_compile(&flow, &decoder), ESP_OK);
+    CHECK_EQ_INT(sensor_decoder_decode(&decoder, &flow, registers, 4, &value, &raw), ESP_OK);
+    CHECK(fabs(value - 33073.865) < 1e-6);
+    CHECK_EQ_INT(raw, 33073);
+}
+
+int main(void)
+{
+    host_log_level = ESP_LOG_NONE;         // The legacy decoder logs every conversion
+    test_golden_values();
+    test_all_formats_match_legacy();
+    test_vendor_formats_match_legacy();
+    fprintf(stderr, "%d decodes compared with the legacy decoder, %d extension formats decoded\n",
+            compared, extensions_seen);
+    return TEST_RESULT();
+}
@@ -13,6 +13,7 @@
 #include "lwip/sockets.h"
 #include "netif/ppp/pppapi.h"
 #include "a7670c_ppp.h"
+#include "metrics.h"
 
 static const char *TAG = "A7670C_PPP";
 
@@ -28,6 +29,8 @@ static const int PPP_CONNECTED_BIT = BIT0;
 // UART RX task control
 static TaskHandle_t uart_rx_task_handle = NULL;
 static volatile bool uart_rx_task_running = false;
+static metric_t *ppp_tx_bytes = NULL;
+static metric_t *ppp_rx_bytes = NULL;
 
 // Signal strength storage (checked before entering PPP mode)
 static signal_strength_t current_signal = {0};
@@ -171,6 +174,7 @@ static esp_err_t power_on_modem(void) {
 // PPP transmit callback - sends data from PPP stack to modem via UART
 static esp_err_t ppp_output_callback(void *ctx, void *data, size_t len) {
     uart_write_bytes(modem_config.uart_num, (const char*)data, len);
+    metrics_inc(ppp_tx_bytes, (uint32_t)len);
     return ESP_OK;
 }
 
@@ -191,6 +195,7 @@ static void uart_rx_task(void *pvParameters) {
         int len = uart_read_bytes(modem_config.uart_num, data, 2048, pdMS_TO_TICKS(100));
         if (len > 0 && ppp_netif) {
             // Feed received data to PPP stack
+            metrics_inc(ppp_rx_bytes, (uint32_t)len);
             esp_netif_receive(ppp_netif, data, len, NULL);
         }
     }
@@ -672,6 +677,8 @@ esp_err_t a7670c_ppp_connect(void) {
     esp_netif_action_start(ppp_netif, 0, 0, NULL);
 
     // Start UART receive task to feed data to PPP
+    ppp_tx_bytes = metrics_counter("ppp_tx_bytes_total", "Bytes sent to the modem over PPP", NULL, NULL);
+    ppp_rx_bytes = metrics_counter("ppp_rx_bytes_total", "Bytes received from the modem over PPP", NULL, NULL);
     xTaskCreate(uart_rx_task, "uart_rx", 4096, NULL, 12, &uart_rx_task_handle);
 
     // Wait for IP
@@ -0,0 +1,123 @@
+// fixed_format.c - Integer-arithmetic replacement for snprintf("%.*f")
+
+#include "fixed_format.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+static const uint32_t pow10_u32[FIXED_FORMAT_MAX_DECIMALS + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+// Digits of v, written backwards from end; returns the first digit.
+// 32-bit divisions where possible: 64-bit ones are library calls on the ESP32.
+static char *fixed_format_utoa(uint64_t v, char *end)
+{
+    while (v > UINT32_MAX) {
+        *--end = (char)('0' + v % 10);
+        v /= 10;
+    }
+    uint32_t v32 = (uint32_t)v;
+    do {
+        *--end = (char)('0' + v32 % 10);
+        v32 /= 10;
+    } while (v32);
+    return end;
+}
+
+// Bit k of the 128-bit value hi:lo
+static inline bool fixed_format_bit(uint64_t hi, uint64_t lo, int k)
+{
+    return k < 64 ? (lo >> k) & 1 : (hi >> (k - 64)) & 1;
+}
+
+// Any of the bits below k set
+static inline bool fixed_format_sticky(uint64_t hi, uint64_t lo, int k)
+{
+    if (k <= 0) {
+        return false;
+    }
+    if (k < 64) {
+        return (lo & ((1ULL << k) - 1)) != 0;
+    }
+    if (k == 64) {
+        return lo != 0;
+    }
+    return lo != 0 || (hi & ((1ULL << (k - 64)) - 1)) != 0;
+}
+
+int fixed_format(char *out, size_t size, double value, int decimals)
+{
+    if (decimals < 0) {
+        decimals = 6;  // printf default precision
+    }
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bool negative = bits >> 63;
+    int biased_exp = (int)((bits >> 52) & 0x7FF);
+    uint64_t mantissa = bits & ((1ULL << 52) - 1);
+
+    // value = mantissa / 2^shift; shift < 0 means |value| >= 2^53
+    int shift;
+    if (biased_exp == 0) {
+        shift = 1074;                       // Zero and subnormals
+    } else {
+        mantissa |= 1ULL << 52;
+        shift = 1075 - biased_exp;
+    }
+    if (biased_exp == 0x7FF || shift < 0 || decimals > FIXED_FORMAT_MAX_DECIMALS) {
+        return snprintf(out, size, "%.*f", decimals, value);
+    }
+
+    uint64_t int_part = shift >= 64 ? 0 : mantissa >> shift;
+    uint64_t frac_bits = shift >= 64 ? mantissa : mantissa & ((1ULL << shift) - 1);
+    uint32_t scale = pow10_u32[decimals];
+
+    // Scaled fraction = frac_bits * scale / 2^shift, rounded half to even.
+    // frac_bits < 2^53 and scale < 2^30, so the product fits in 83 bits (hi:lo).
+    uint32_t frac = 0;
+    if (frac_bits != 0 && shift < 84) {
+        uint64_t low = (frac_bits & 0xFFFFFFFFULL) * scale;
+        uint64_t mid = (frac_bits >> 32) * scale;
+        uint64_t lo = low + (mid << 32);
+        uint64_t hi = (mid >> 32) + (lo < low);
+
+        uint64_t q = shift >= 64 ? hi >> (shift - 64) : (lo >> shift) | (hi << (64 - shift));
+        frac = (uint32_t)q;
+        // On an exact tie the last printed digit decides: the integer part with no decimals
+        bool odd = decimals == 0 ? (int_part & 1) : (frac & 1);
+        if (fixed_format_bit(hi, lo, shift - 1) &&
+            (fixed_format_sticky(hi, lo, shift - 1) || odd)) {
+            if (++frac == scale) {
+                frac = 0;
+                int_part++;
+            }
+        }
+    }
+    // shift >= 84: the scaled fraction is below 1/2 and rounds to 0
+
+    char text[FIXED_FORMAT_BUF_SIZE];
+    char *end = text + sizeof(text);
+    char *p = end;
+    if (decimals > 0) {
+        for (int i = 0; i < decimals; i++) {
+            *--p = (char)('0' + frac % 10);
+            frac /= 10;
+        }
+        *--p = '.';
+    }
+    p = fixed_format_utoa(int_part, p);
+    if (negative) {
+        *--p = '-';
+    }
+
+    int len = (int)(end - p);
+    if (size > 0) {
+        size_t n = (size_t)len < size - 1 ? (size_t)len : size - 1;
+        memcpy(out, p, n);
+        out[n] = '\0';
+    }
+    return len;
+}
@@ -0,0 +1,24 @@
+// fixed_format.h - Integer-arithmetic replacement for snprintf("%.*f")
+// The ESP32 has no double-precision FPU and newlib's printf float path is
+// slow and stack hungry. fixed_format() splits the double into its integer and
+// binary-fraction bits and rounds the scaled fraction with integer arithmetic
+// (round half to even on exact ties, like printf), so its output is
+// byte-identical to "%.*f" for every value it handles. Values it does not
+// handle (NaN, infinities, |value| >= 2^53, more than FIXED_FORMAT_MAX_DECIMALS)
+// fall back to snprintf.
+
+#ifndef FIXED_FORMAT_H
+#define FIXED_FORMAT_H
+
+#include <stddef.h>
+
+#define FIXED_FORMAT_MAX_DECIMALS 9
+
+// Longest output for |value| < 2^53: sign, 16 digits, point, 9 decimals, NUL
+#define FIXED_FORMAT_BUF_SIZE 32
+
+// Same contract as snprintf(out, size, "%.*f", decimals, value): returns the
+// full length, writes at most size - 1 characters plus a NUL
+int fixed_format(char *out, size_t size, double value, int decimals);
+
+#endif // FIXED_FORMAT_H
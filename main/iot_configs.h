@@ -38,4 +38,25 @@
 #define OTA_MAX_RETRY 3                   // Max download retries
 #define OTA_CONFIRM_TIMEOUT_SEC 300       // 5 minutes to confirm new firmware before rollback
 
+// Modbus Poll Planning
+#define MODBUS_COALESCE_ENABLED true      // Merge nearby register ranges into one read per slave
+#define MODBUS_COALESCE_GAP_REGISTERS 8   // Unrequested registers tolerated between merged ranges
+#define MODBUS_POLL_INTERVAL_SEC 120      // 2 minutes - sensor poll cycle of the Modbus task
+
+// Telemetry Batching
+#define TELEMETRY_BATCH_SINGLE 0          // One sensor per message, published back-to-back
+#define TELEMETRY_BATCH_ARRAY 1           // Several sensors per message as a JSON array
+#define TELEMETRY_BATCH_MODE TELEMETRY_BATCH_ARRAY
+#define TELEMETRY_MAX_MESSAGE_SIZE 4096   // Split the batch into several publishes above this size
+
+// Sensor Cache Configuration
+#define SENSOR_CACHE_MAX_AGE_SEC 150      // Consumers force a poll when the cache is older than this
+
+// SD Telemetry Cache
+#define SD_CACHE_SYNC_RECORD 0            // Write and fsync every cached message immediately
+#define SD_CACHE_SYNC_PERIODIC 1          // Stage in RAM; fsync after SD_CACHE_FLUSH_INTERVAL_SEC
+#define SD_CACHE_SYNC_BATCH 2             // Stage in RAM; write only full 4 KB stages, fsync at shutdown/replay
+#define SD_CACHE_SYNC_POLICY SD_CACHE_SYNC_PERIODIC
+#define SD_CACHE_FLUSH_INTERVAL_SEC 60    // Longest a cached message waits in RAM (periodic policy)
+
 #endif // IOT_CONFIGS_H
\ No newline at end of file
@@ -1,11 +1,13 @@
 // json_templates.c - JSON template implementation for different sensor types
 
 #include "json_templates.h"
+#include "fixed_format.h"
 #include "esp_log.h"
 #include <string.h>
 #include <stdio.h>
 #include <time.h>
 #include <inttypes.h>
+#include <math.h>
 
 static const char *TAG = "JSON_TEMPLATES";
 
@@ -97,6 +99,16 @@ const char* get_json_template_name(json_template_type_t type)
     }
 }
 
+// Decimals of the primary value in each template (and wherever it is displayed)
+int get_json_value_decimals(json_template_type_t type)
+{
+    switch (type) {
+        case JSON_TYPE_LEVEL:     return 0;
+        case JSON_TYPE_BOREWELL:  return 6;
+        default:                  return 2;
+    }
+}
+
 // Format timestamp in ISO8601 format
 void format_timestamp_iso8601(char* timestamp, size_t size)
 {
@@ -136,67 +148,49 @@ esp_err_t validate_json_params(const json_params_t* params)
     return ESP_OK;
 }
 
-// Create JSON payload based on template type and parameters
-esp_err_t create_json_payload(const json_params_t* params, char* json_buffer, size_t buffer_size)
+// Write the JSON document for params into w
+esp_err_t json_write_payload(json_writer_t* w, const json_params_t* params)
 {
-    if (!params || !json_buffer || buffer_size == 0) {
+    if (!params || !w) {
         return ESP_ERR_INVALID_ARG;
     }
-    
+
     esp_err_t ret = validate_json_params(params);
     if (ret != ESP_OK) {
         return ret;
     }
-    
-    // Clear buffer
-    memset(json_buffer, 0, buffer_size);
-    
-    ESP_LOGI(TAG, "Creating JSON for type: %s, Unit: %s, Value: %.6f", 
-             get_json_template_name(params->type), params->unit_id, params->scaled_value);
-    
+
+    int decimals = get_json_value_decimals(params->type);
+    ESP_LOGD(TAG, "Creating JSON for type: %s, Unit: %s", get_json_template_name(params->type), params->unit_id);
+
+    json_writer_begin_object(w);
     switch (params->type) {
         case JSON_TYPE_FLOW: {
             // {"unit_id":"FG24708F","type":"FLOW","consumption":"265.23","created_on":"2025-11-24T12:05:05Z"}
-            snprintf(json_buffer, buffer_size,
-                "{"
-                "\"unit_id\":\"%s\","
-                "\"type\":\"FLOW\","
-                "\"consumption\":\"%.2f\","
-                "\"created_on\":\"%s\""
-                "}",
-                params->unit_id,
-                params->scaled_value,
-                params->timestamp);
+            json_writer_key_string(w, "unit_id", params->unit_id);
+            json_writer_key_string(w, "type", "FLOW");
+            json_writer_key(w, "consumption");
+            json_writer_double_string(w, params->scaled_value, decimals);
+            json_writer_key_string(w, "created_on", params->timestamp);
             break;
         }
         
         case JSON_TYPE_LEVEL: {
             // {"unit_id":"FG24769L","created_on":"2025-11-24T12:04:16Z","type":"LEVEL","level_filled":49}
-            snprintf(json_buffer, buffer_size,
-                "{"
-                "\"unit_id\":\"%s\","
-                "\"created_on\":\"%s\","
-                "\"type\":\"LEVEL\","
-                "\"level_filled\":%.0f"
-                "}",
-                params->unit_id,
-                params->timestamp,
-                params->scaled_value);
+            json_writer_key_string(w, "unit_id", params->unit_id);
+            json_writer_key_string(w, "created_on", params->timestamp);
+            json_writer_key_string(w, "type", "LEVEL");
+            json_writer_key_double(w, "level_filled", params->scaled_value, decimals);
             break;
         }
         
         case JSON_TYPE_RAINGAUGE: {
             // {"unit_id":"FG24769R","created_on":"2025-11-24T12:04:16Z","type":"RAINGAUGE","raingauge":"123.45"}
-            snprintf(json_buffer, buffer_size,
-                "{"
-                "\"unit_id\":\"%s\","
-                "\"created_on\":\"%s\","
-                "\"type\":\"RAINGAUGE\","
-                "\"raingauge\":\"%.2f\""
-                "}",
-                params->unit_id,
-                params->timestamp,
-                params->scaled_value);
+            json_writer_key_string(w, "unit_id", params->unit_id);
+            json_writer_key_string(w, "created_on", params->timestamp);
+            json_writer_key_string(w, "type", "RAINGAUGE");
+            json_writer_key(w, "raingauge");
+            json_writer_double_string(w, params->scaled_value, decimals);
             break;
         }
         
@@ -205,17 +199,11 @@ esp_err_t create_json_payload(const json_params_t* params, char* json_buffer, si
             uint32_t epoch_time;
             format_timestamp_epoch(&epoch_time);
 
-            snprintf(json_buffer, buffer_size,
-                "{"
-                "\"borewell\":%.6f,"
-                "\"type\":\"BOREWELL\","
-                "\"created_on_epoch\":%" PRIu32 ","
-                "\"slave_id\":%d,"
-                "\"meter\":\"%s\""
-                "}",
-                params->scaled_value,
-                epoch_time,
-                params->slave_id,
+            json_writer_key_double(w, "borewell", params->scaled_value, decimals);
+            json_writer_key_string(w, "type", "BOREWELL");
+            json_writer_key_uint(w, "created_on_epoch", epoch_time);
+            json_writer_key_int(w, "slave_id", params->slave_id);
+            json_writer_key_string(w, "meter",
                 strlen(params->extra_params.meter_id) > 0 ? params->extra_params.meter_id : "piezo");
             break;
         }
@@ -243,17 +231,11 @@ esp_err_t create_json_payload(const json_params_t* params, char* json_buffer, si
                 snprintf(hex_value, sizeof(hex_value), "%08" PRIX32, params->raw_value);
             }
 
-            snprintf(json_buffer, buffer_size,
-                "{"
-                "\"ene_con_hex\":\"%s\","
-                "\"type\":\"ENERGY\","
-                "\"created_on_epoch\":%" PRIu32 ","
-                "\"slave_id\":%d,"
-                "\"meter\":\"%s\""
-                "}",
-                hex_value,
-                epoch_time,
-                params->slave_id,
+            json_writer_key_string(w, "ene_con_hex", hex_value);
+            json_writer_key_string(w, "type", "ENERGY");
+            json_writer_key_uint(w, "created_on_epoch", epoch_time);
+            json_writer_key_int(w, "slave_id", params->slave_id);
+            json_writer_key_string(w, "meter",
                 strlen(params->extra_params.meter_id) > 0 ? params->extra_params.meter_id : params->unit_id);
             break;
         }
@@ -268,30 +250,19 @@ esp_err_t create_json_payload(const json_params_t* params, char* json_buffer, si
             double bod_value = (params->extra_params.bod_value > 0) ? params->extra_params.bod_value : 5.0; // Default BOD
             double cod_value = (params->extra_params.cod_value > 0) ? params->extra_params.cod_value : 8.0; // Default COD
 
-            snprintf(json_buffer, buffer_size,
-                "{"
-                "\"params_data\":{"
-                "\"pH\":%.2f,"
-                "\"TDS\":%.2f,"
-                "\"Temp\":%.2f,"
-                "\"HUMIDITY\":%.2f,"
-                "\"TSS\":%.2f,"
-                "\"BOD\":%.2f,"
-                "\"COD\":%.2f"
-                "},"
-                "\"type\":\"QUALITY\","
-                "\"created_on\":\"%s\","
-                "\"unit_id\":\"%s\""
-                "}",
-                ph_value,
-                tds_value,
-                temp_value,
-                humidity_value,
-                tss_value,
-                bod_value,
-                cod_value,
-                params->timestamp,
-                params->unit_id);
+            json_writer_key(w, "params_data");
+            json_writer_begin_object(w);
+            json_writer_key_double(w, "pH", ph_value, 2);
+            json_writer_key_double(w, "TDS", tds_value, 2);
+            json_writer_key_double(w, "Temp", temp_value, 2);
+            json_writer_key_double(w, "HUMIDITY", humidity_value, 2);
+            json_writer_key_double(w, "TSS", tss_value, 2);
+            json_writer_key_double(w, "BOD", bod_value, 2);
+            json_writer_key_double(w, "COD", cod_value, 2);
+            json_writer_end_object(w);
+            json_writer_key_string(w, "type", "QUALITY");
+            json_writer_key_string(w, "created_on", params->timestamp);
+            json_writer_key_string(w, "unit_id", params->unit_id);
             break;
         }
         
@@ -300,22 +271,42 @@ esp_err_t create_json_payload(const json_params_t* params, char* json_buffer, si
             return ESP_ERR_NOT_SUPPORTED;
         }
     }
-    
-    ESP_LOGI(TAG, "JSON created successfully (%d bytes): %s", strlen(json_buffer), json_buffer);
+    json_writer_end_object(w);
+
+    return w->error;
+}
+
+// Create JSON payload based on template type and parameters
+esp_err_t create_json_payload(const json_params_t* params, char* json_buffer, size_t buffer_size)
+{
+    if (!params || !json_buffer || buffer_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    json_writer_t w;
+    json_writer_init(&w, json_buffer, buffer_size, NULL, NULL);
+    esp_err_t ret = json_write_payload(&w, params);
+    if (ret != ESP_OK) {
+        json_buffer[0] = '\0';
+        return ret;
+    }
+
+    ESP_LOGD(TAG, "JSON created successfully (%d bytes): %s", (int)w.len, json_buffer);
     return ESP_OK;
 }
 
-// Generate JSON for a sensor configuration with real data
-esp_err_t generate_sensor_json(const sensor_config_t* sensor, double scaled_value,
-                              uint32_t raw_value, const network_stats_t* net_stats,
-                              char* json_buffer, size_t buffer_size)
+// Write the JSON document for a sensor configuration with real data into w.
+// hex_string (from Test RS485) is used by ENERGY sensors when not empty.
+esp_err_t write_sensor_json(json_writer_t* w, const sensor_config_t* sensor, double scaled_value,
+                            uint32_t raw_value, const char* hex_string,
+                            const network_stats_t* net_stats)
 {
-    if (!sensor || !json_buffer || buffer_size == 0) {
+    if (!sensor || !w) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    ESP_LOGI(TAG, "Generating JSON for sensor: %s (Type: %s, Unit: %s)",
-             sensor->name, sensor->sensor_type, sensor->unit_id);
+    ESP_LOGD(TAG, "Generating JSON for sensor: %s (Type: %s, Unit: %s, Hex: %s)",
+             sensor->name, sensor->sensor_type, sensor->unit_id, hex_string ? hex_string : "NULL");
 
     // Prepare JSON parameters
     json_params_t params = {0};
@@ -357,7 +348,11 @@ esp_err_t generate_sensor_json(const sensor_config_t* sensor, double scaled_valu
 
     // Set additional parameters for specific types
     if (params.type == JSON_TYPE_ENERGY) {
-        // For ENERGY type, use meter_type if available, otherwise fallback to sensor name
+        // Copy hex string from Test RS485
+        if (hex_string && strlen(hex_string) > 0) {
+            strncpy(params.extra_params.hex_string, hex_string, sizeof(params.extra_params.hex_string) - 1);
+        }
+        // Use meter_type if available, otherwise fallback to sensor name
         if (strlen(sensor->meter_type) > 0) {
             strncpy(params.extra_params.meter_id, sensor->meter_type, sizeof(params.extra_params.meter_id) - 1);
         } else if (strlen(sensor->name) > 0) {
@@ -375,140 +370,409 @@ esp_err_t generate_sensor_json(const sensor_config_t* sensor, double scaled_valu
     }
 
     // Generate the JSON
-    esp_err_t ret = create_json_payload(&params, json_buffer, buffer_size);
+    esp_err_t ret = json_write_payload(w, &params);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to create JSON payload for sensor %s", sensor->name);
+    }
+    return ret;
+}
+
+static esp_err_t generate_sensor_json_buffer(const sensor_config_t* sensor, double scaled_value,
+                                             uint32_t raw_value, const char* hex_string,
+                                             const network_stats_t* net_stats,
+                                             char* json_buffer, size_t buffer_size)
+{
+    if (!sensor || !json_buffer || buffer_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    json_writer_t w;
+    json_writer_init(&w, json_buffer, buffer_size, NULL, NULL);
+    esp_err_t ret = write_sensor_json(&w, sensor, scaled_value, raw_value, hex_string, net_stats);
+    if (ret != ESP_OK) {
+        json_buffer[0] = '\0';
         return ret;
     }
 
-    ESP_LOGI(TAG, "JSON generated for sensor %s: %s", sensor->name, json_buffer);
+    ESP_LOGD(TAG, "JSON generated for sensor %s: %s", sensor->name, json_buffer);
     return ESP_OK;
 }
 
-// Generate JSON for a sensor configuration with real data and hex string
+// Generate JSON for a sensor configuration with real data
+esp_err_t generate_sensor_json(const sensor_config_t* sensor, double scaled_value,
+                              uint32_t raw_value, const network_stats_t* net_stats,
+                              char* json_buffer, size_t buffer_size)
+{
+    return generate_sensor_json_buffer(sensor, scaled_value, raw_value, NULL, net_stats,
+                                       json_buffer, buffer_size);
+}
+
 // Generate JSON for a sensor configuration with real data and hex string
 esp_err_t generate_sensor_json_with_hex(const sensor_config_t* sensor, double scaled_value,
                               uint32_t raw_value, const char* hex_string,
                               const network_stats_t* net_stats,
                               char* json_buffer, size_t buffer_size)
 {
-    if (!sensor || !json_buffer || buffer_size == 0) {
+    return generate_sensor_json_buffer(sensor, scaled_value, raw_value, hex_string, net_stats,
+                                       json_buffer, buffer_size);
+}
+
+// Generate JSON for a sensor reading with quality parameters (for QUALITY sensors)
+esp_err_t generate_quality_sensor_json(const sensor_reading_t* reading, char* json_buffer, size_t buffer_size)
+{
+    if (!reading || !json_buffer || buffer_size == 0) {
         return ESP_ERR_INVALID_ARG;
     }
+    
+    ESP_LOGD(TAG, "Generating JSON for quality sensor reading: %s", reading->unit_id);
+    
+    // Create JSON for water quality sensor with actual parameter values
+    json_writer_t w;
+    json_writer_init(&w, json_buffer, buffer_size, NULL, NULL);
+    json_writer_begin_object(&w);
+    json_writer_key(&w, "params_data");
+    json_writer_begin_object(&w);
+    json_writer_key_double(&w, "pH", reading->quality_params.ph_value, 2);
+    json_writer_key_double(&w, "TDS", reading->quality_params.tds_value, 2);
+    json_writer_key_double(&w, "Temp", reading->quality_params.temp_value, 2);
+    json_writer_key_double(&w, "HUMIDITY", reading->quality_params.humidity_value, 2);
+    json_writer_key_double(&w, "TSS", reading->quality_params.tss_value, 2);
+    json_writer_key_double(&w, "BOD", reading->quality_params.bod_value, 2);
+    json_writer_key_double(&w, "COD", reading->quality_params.cod_value, 2);
+    json_writer_end_object(&w);
+    json_writer_key_string(&w, "type", "QUALITY");
+    json_writer_key_string(&w, "created_on", reading->timestamp);
+    json_writer_key_string(&w, "unit_id", reading->unit_id);
+    json_writer_end_object(&w);
+    if (w.error != ESP_OK) {
+        json_buffer[0] = '\0';
+        return w.error;
+    }
+    
+    ESP_LOGD(TAG, "Quality JSON generated (%d bytes): %s", (int)w.len, json_buffer);
+    return ESP_OK;
+}
 
-    ESP_LOGI(TAG, "Generating JSON for sensor: %s (Type: %s, Unit: %s, Hex: %s)",
-             sensor->name, sensor->sensor_type, sensor->unit_id, hex_string ? hex_string : "NULL");
+// ===== Pre-rendered sensor templates =====
 
-    // Prepare JSON parameters
-    json_params_t params = {0};
+// Marks a slot at the writer's cursor: the slot's value follows the last key
+static void json_template_slot(json_writer_t* w, json_sensor_template_t* tpl, json_slot_kind_t kind, int decimals)
+{
+    json_writer_raw(w, "", 0);  // Consume the key like a value would
+    if (tpl->slot_count >= JSON_TEMPLATE_MAX_SLOTS) {
+        w->error = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    json_template_slot_t* slot = &tpl->slots[tpl->slot_count++];
+    slot->at = (uint16_t)w->len;
+    slot->kind = (uint8_t)kind;
+    slot->decimals = (uint8_t)decimals;
+}
 
-    // Determine JSON template type from sensor type
-    // Note: get_json_type_from_sensor_type() defaults to JSON_TYPE_FLOW for unknown types
-    params.type = get_json_type_from_sensor_type(sensor->sensor_type);
+// Same documents as write_sensor_json(), with the per-reading fields left as slots
+esp_err_t json_template_compile(const sensor_config_t* sensor, json_sensor_template_t* tpl)
+{
+    if (!sensor || !tpl) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(tpl, 0, sizeof(*tpl));
+    tpl->type = (uint8_t)get_json_type_from_sensor_type(sensor->sensor_type);
 
-    // Copy basic parameters
-    strncpy(params.unit_id, sensor->unit_id, sizeof(params.unit_id) - 1);
-    params.scaled_value = scaled_value;
-    params.raw_value = raw_value;
-    params.slave_id = sensor->slave_id;
+    if (strlen(sensor->unit_id) == 0) {
+        tpl->status = ESP_ERR_INVALID_ARG;
+        return tpl->status;
+    }
 
-    // Format timestamp
-    format_timestamp_iso8601(params.timestamp, sizeof(params.timestamp));
+    int decimals = get_json_value_decimals(tpl->type);
+    json_writer_t w;
+    json_writer_init(&w, tpl->text, sizeof(tpl->text), NULL, NULL);
+    json_writer_begin_object(&w);
+    switch (tpl->type) {
+        case JSON_TYPE_FLOW:
+            json_writer_key_string(&w, "unit_id", sensor->unit_id);
+            json_writer_key_string(&w, "type", "FLOW");
+            json_writer_key(&w, "consumption");
+            json_template_slot(&w, tpl, JSON_SLOT_VALUE_QUOTED, decimals);
+            json_writer_key(&w, "created_on");
+            json_template_slot(&w, tpl, JSON_SLOT_TIMESTAMP, 0);
+            break;
 
-    // Add network telemetry data
-    if (net_stats) {
-        params.signal_strength = net_stats->signal_strength;
-        strncpy(params.network_type, net_stats->network_type, sizeof(params.network_type) - 1);
+        case JSON_TYPE_LEVEL:
+            json_writer_key_string(&w, "unit_id", sensor->unit_id);
+            json_writer_key(&w, "created_on");
+            json_template_slot(&w, tpl, JSON_SLOT_TIMESTAMP, 0);
+            json_writer_key_string(&w, "type", "LEVEL");
+            json_writer_key(&w, "level_filled");
+            json_template_slot(&w, tpl, JSON_SLOT_VALUE, decimals);
+            break;
 
-        // Determine quality based on signal strength
-        if (net_stats->signal_strength >= -60) {
-            strncpy(params.network_quality, "Excellent", sizeof(params.network_quality) - 1);
-        } else if (net_stats->signal_strength >= -70) {
-            strncpy(params.network_quality, "Good", sizeof(params.network_quality) - 1);
-        } else if (net_stats->signal_strength >= -80) {
-            strncpy(params.network_quality, "Fair", sizeof(params.network_quality) - 1);
-        } else {
-            strncpy(params.network_quality, "Poor", sizeof(params.network_quality) - 1);
+        case JSON_TYPE_RAINGAUGE:
+            json_writer_key_string(&w, "unit_id", sensor->unit_id);
+            json_writer_key(&w, "created_on");
+            json_template_slot(&w, tpl, JSON_SLOT_TIMESTAMP, 0);
+            json_writer_key_string(&w, "type", "RAINGAUGE");
+            json_writer_key(&w, "raingauge");
+            json_template_slot(&w, tpl, JSON_SLOT_VALUE_QUOTED, decimals);
+            break;
+
+        case JSON_TYPE_BOREWELL:
+            json_writer_key(&w, "borewell");
+            json_template_slot(&w, tpl, JSON_SLOT_VALUE, decimals);
+            json_writer_key_string(&w, "type", "BOREWELL");
+            json_writer_key(&w, "created_on_epoch");
+            json_template_slot(&w, tpl, JSON_SLOT_EPOCH, 0);
+            json_writer_key_int(&w, "slave_id", sensor->slave_id);
+            json_writer_key_string(&w, "meter", "piezo");
+            break;
+
+        case JSON_TYPE_ENERGY: {
+            const char* meter = strlen(sensor->meter_type) > 0 ? sensor->meter_type :
+                                strlen(sensor->name) > 0 ? sensor->name : sensor->unit_id;
+            json_writer_key(&w, "ene_con_hex");
+            json_template_slot(&w, tpl, JSON_SLOT_HEX, 0);
+            json_writer_key_string(&w, "type", "ENERGY");
+            json_writer_key(&w, "created_on_epoch");
+            json_template_slot(&w, tpl, JSON_SLOT_EPOCH, 0);
+            json_writer_key_int(&w, "slave_id", sensor->slave_id);
+            json_writer_key_string(&w, "meter", meter);
+            break;
         }
-    } else {
-        // Default values when network stats unavailable
-        params.signal_strength = 0;
-        strncpy(params.network_type, "Unknown", sizeof(params.network_type) - 1);
-        strncpy(params.network_quality, "Unknown", sizeof(params.network_quality) - 1);
+
+        case JSON_TYPE_QUALITY:
+            // pH and TDS follow the reading; the other parameters are fixed defaults
+            json_writer_key(&w, "params_data");
+            json_writer_begin_object(&w);
+            json_writer_key(&w, "pH");
+            json_template_slot(&w, tpl, JSON_SLOT_VALUE, 2);
+            json_writer_key(&w, "TDS");
+            json_template_slot(&w, tpl, JSON_SLOT_VALUE_X10, 2);
+            json_writer_key_double(&w, "Temp", 25.0, 2);
+            json_writer_key_double(&w, "HUMIDITY", 60.0, 2);
+            json_writer_key_double(&w, "TSS", 10.0, 2);
+            json_writer_key_double(&w, "BOD", 5.0, 2);
+            json_writer_key_double(&w, "COD", 8.0, 2);
+            json_writer_end_object(&w);
+            json_writer_key_string(&w, "type", "QUALITY");
+            json_writer_key(&w, "created_on");
+            json_template_slot(&w, tpl, JSON_SLOT_TIMESTAMP, 0);
+            json_writer_key_string(&w, "unit_id", sensor->unit_id);
+            break;
+
+        default:
+            tpl->status = ESP_ERR_NOT_SUPPORTED;
+            return tpl->status;
     }
+    json_writer_end_object(&w);
 
-    // Set additional parameters for specific types
-    if (params.type == JSON_TYPE_ENERGY) {
-        // Copy hex string from Test RS485
-        if (hex_string && strlen(hex_string) > 0) {
-            strncpy(params.extra_params.hex_string, hex_string, sizeof(params.extra_params.hex_string) - 1);
+    tpl->status = w.error;
+    tpl->text_len = (uint16_t)w.len;
+    return tpl->status;
+}
+
+static bool json_template_put(char* out, size_t size, size_t* len, const char* data, size_t n)
+{
+    if (*len + n >= size) {
+        return false;
+    }
+    memcpy(out + *len, data, n);
+    *len += n;
+    return true;
+}
+
+// A number exactly as json_writer_double()/json_writer_double_string() writes it
+static bool json_template_number(char* out, size_t size, size_t* len, double v, int decimals, bool quoted)
+{
+    if (!isfinite(v)) {
+        return json_template_put(out, size, len, "null", 4);
+    }
+    char text[FIXED_FORMAT_BUF_SIZE + 2];
+    char* p = text + 1;
+    int n = fixed_format(p, FIXED_FORMAT_BUF_SIZE, v, decimals);
+    if (n < 0 || n >= FIXED_FORMAT_BUF_SIZE) {
+        n = snprintf(p, FIXED_FORMAT_BUF_SIZE, "%.17g", v);
+    }
+    if (quoted) {
+        text[0] = '"';
+        p[n] = '"';
+        return json_template_put(out, size, len, text, n + 2);
+    }
+    return json_template_put(out, size, len, p, n);
+}
+
+static bool json_template_hex(char* out, size_t size, size_t* len, const json_template_values_t* values)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    char hex[32];
+    size_t n = 0;
+    if (values->hex_string && values->hex_string[0]) {
+        // Spaces removed, from as much of the string as json_params_t carries
+        size_t limit = sizeof(((json_params_t*)0)->extra_params.hex_string) - 1;
+        for (size_t i = 0; i < limit && values->hex_string[i]; i++) {
+            if (values->hex_string[i] != ' ') {
+                hex[n++] = values->hex_string[i];
+            }
         }
-        // Use meter_type if available, otherwise fallback to sensor name
-        if (strlen(sensor->meter_type) > 0) {
-            strncpy(params.extra_params.meter_id, sensor->meter_type, sizeof(params.extra_params.meter_id) - 1);
-        } else if (strlen(sensor->name) > 0) {
-            strncpy(params.extra_params.meter_id, sensor->name, sizeof(params.extra_params.meter_id) - 1);
+    } else {
+        for (int shift = 28; shift >= 0; shift -= 4) {
+            hex[n++] = digits[(values->raw_value >> shift) & 0xF];
         }
-    } else if (params.type == JSON_TYPE_QUALITY) {
-        // For QUALITY type, use scaled_value as primary parameter and set reasonable defaults
-        params.extra_params.ph_value = scaled_value;
-        params.extra_params.tds_value = scaled_value * 10; // Example conversion
-        params.extra_params.temp_value = 25.0; // Default temperature
-        params.extra_params.humidity_value = 60.0; // Default humidity
-        params.extra_params.tss_value = 10.0; // Default TSS
-        params.extra_params.bod_value = 5.0; // Default BOD
-        params.extra_params.cod_value = 8.0; // Default COD
     }
+    if (!json_template_put(out, size, len, "\"", 1)) {
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)hex[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            if (!json_template_put(out, size, len, &hex[i], 1)) {
+                return false;
+            }
+        } else {
+            // Escaped the way json_writer_string() would
+            char esc[6] = { '\\', 'u', '0', '0', "0123456789abcdef"[c >> 4], "0123456789abcdef"[c & 0xF] };
+            size_t esc_len = 6;
+            switch (c) {
+                case '"':  esc[1] = '"';  esc_len = 2; break;
+                case '\\': esc[1] = '\\'; esc_len = 2; break;
+                case '\n': esc[1] = 'n';  esc_len = 2; break;
+                case '\r': esc[1] = 'r';  esc_len = 2; break;
+                case '\t': esc[1] = 't';  esc_len = 2; break;
+                case '\b': esc[1] = 'b';  esc_len = 2; break;
+                case '\f': esc[1] = 'f';  esc_len = 2; break;
+                default: break;
+            }
+            if (!json_template_put(out, size, len, esc, esc_len)) {
+                return false;
+            }
+        }
+    }
+    return json_template_put(out, size, len, "\"", 1);
+}
 
-    // Generate the JSON
-    esp_err_t ret = create_json_payload(&params, json_buffer, buffer_size);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to create JSON payload for sensor %s", sensor->name);
-        return ret;
+int json_template_render(const json_sensor_template_t* tpl, const json_template_values_t* values,
+                         char* out, size_t size)
+{
+    if (!tpl || !values || !out || size == 0 || tpl->status != ESP_OK) {
+        return -1;
     }
 
-    ESP_LOGI(TAG, "JSON generated for sensor %s: %s", sensor->name, json_buffer);
-    return ESP_OK;
+    size_t len = 0;
+    size_t from = 0;
+    bool ok = true;
+    for (int i = 0; i < tpl->slot_count && ok; i++) {
+        const json_template_slot_t* slot = &tpl->slots[i];
+        ok = json_template_put(out, size, &len, tpl->text + from, slot->at - from);
+        from = slot->at;
+        if (!ok) {
+            break;
+        }
+        switch (slot->kind) {
+            case JSON_SLOT_VALUE:
+                ok = json_template_number(out, size, &len, values->value, slot->decimals, false);
+                break;
+            case JSON_SLOT_VALUE_QUOTED:
+                ok = json_template_number(out, size, &len, values->value, slot->decimals, true);
+                break;
+            case JSON_SLOT_VALUE_X10:
+                ok = json_template_number(out, size, &len, values->value * 10, slot->decimals, false);
+                break;
+            case JSON_SLOT_TIMESTAMP: {
+                struct tm timeinfo;
+                char timestamp[34];
+                gmtime_r(&values->timestamp, &timeinfo);
+                size_t n = strftime(timestamp + 1, sizeof(timestamp) - 2, "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
+                timestamp[0] = '"';
+                timestamp[n + 1] = '"';
+                ok = json_template_put(out, size, &len, timestamp, n + 2);
+                break;
+            }
+            case JSON_SLOT_EPOCH: {
+                char digits[12];
+                char* end = digits + sizeof(digits);
+                char* p = end;
+                uint32_t epoch = (uint32_t)values->timestamp;
+                do {
+                    *--p = (char)('0' + epoch % 10);
+                    epoch /= 10;
+                } while (epoch);
+                ok = json_template_put(out, size, &len, p, end - p);
+                break;
+            }
+            case JSON_SLOT_HEX:
+                ok = json_template_hex(out, size, &len, values);
+                break;
+            default:
+                ok = false;
+                break;
+        }
+    }
+    if (!ok || !json_template_put(out, size, &len, tpl->text + from, tpl->text_len - from)) {
+        return -1;
+    }
+    out[len] = '\0';
+    return (int)len;
 }
 
-// Generate JSON for a sensor reading with quality parameters (for QUALITY sensors)
-esp_err_t generate_quality_sensor_json(const sensor_reading_t* reading, char* json_buffer, size_t buffer_size)
+esp_err_t json_template_write(json_writer_t* w, const json_sensor_template_t* tpl,
+                              const json_template_values_t* values)
 {
-    if (!reading || !json_buffer || buffer_size == 0) {
+    if (!w || !tpl || !values) {
         return ESP_ERR_INVALID_ARG;
     }
-    
-    ESP_LOGI(TAG, "Generating JSON for quality sensor reading: %s", reading->unit_id);
-    
-    // Clear buffer
-    memset(json_buffer, 0, buffer_size);
-    
-    // Create JSON for water quality sensor with actual parameter values
-    snprintf(json_buffer, buffer_size,
-        "{"
-        "\"params_data\":{"
-        "\"pH\":%.2f,"
-        "\"TDS\":%.2f,"
-        "\"Temp\":%.2f,"
-        "\"HUMIDITY\":%.2f,"
-        "\"TSS\":%.2f,"
-        "\"BOD\":%.2f,"
-        "\"COD\":%.2f"
-        "},"
-        "\"type\":\"QUALITY\","
-        "\"created_on\":\"%s\","
-        "\"unit_id\":\"%s\""
-        "}",
-        reading->quality_params.ph_value,
-        reading->quality_params.tds_value,
-        reading->quality_params.temp_value,
-        reading->quality_params.humidity_value,
-        reading->quality_params.tss_value,
-        reading->quality_params.bod_value,
-        reading->quality_params.cod_value,
-        reading->timestamp,
-        reading->unit_id);
-    
-    ESP_LOGI(TAG, "Quality JSON generated (%d bytes): %s", strlen(json_buffer), json_buffer);
-    return ESP_OK;
+    if (tpl->status != ESP_OK) {
+        return tpl->status;
+    }
+    char doc[JSON_TEMPLATE_DOC_SIZE];
+    int len = json_template_render(tpl, values, doc, sizeof(doc));
+    if (len < 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    json_writer_raw(w, doc, (size_t)len);
+    return w->error;
+}
+
+static json_sensor_template_t s_templates[JSON_TEMPLATE_MAX_SENSORS];
+static uint32_t s_template_generation[JSON_TEMPLATE_MAX_SENSORS];
+static uint32_t s_generation = 1;
+
+void json_templates_config_changed(const system_config_t* config)
+{
+    __atomic_add_fetch(&s_generation, 1, __ATOMIC_RELEASE);
+    if (!config) {
+        return;
+    }
+
+    // Compiled here only to report problems; the table itself is rebuilt by its reader
+    json_sensor_template_t tpl;
+    int compiled = 0;
+    for (int i = 0; i < config->sensor_count && i < JSON_TEMPLATE_MAX_SENSORS; i++) {
+        const sensor_config_t* sensor = &config->sensors[i];
+        if (!sensor->enabled) {
+            continue;
+        }
+        esp_err_t ret = json_template_compile(sensor, &tpl);
+        if (ret == ESP_OK) {
+            compiled++;
+        } else {
+            ESP_LOGW(TAG, "[WARN] Sensor %d (%s): no JSON template (%s), built field by field",
+                     i + 1, sensor->name, esp_err_to_name(ret));
+        }
+    }
+    ESP_LOGI(TAG, "[OK] JSON templates ready for %d sensors", compiled);
+}
+
+// Compiled template of a configured sensor, rebuilt if the configuration
+// changed since it was compiled
+const json_sensor_template_t* json_template_lookup(const system_config_t* config, int sensor_index)
+{
+    if (!config || sensor_index < 0 || sensor_index >= JSON_TEMPLATE_MAX_SENSORS) {
+        return NULL;
+    }
+
+    json_sensor_template_t* tpl = &s_templates[sensor_index];
+    uint32_t generation = __atomic_load_n(&s_generation, __ATOMIC_ACQUIRE);
+    if (s_template_generation[sensor_index] != generation) {
+        json_template_compile(&config->sensors[sensor_index], tpl);
+        s_template_generation[sensor_index] = generation;
+    }
+    return tpl;
 }
@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <time.h>
 #include "sensor_manager.h"
+#include "json_writer.h"
 
 // Maximum JSON payload size
 #define MAX_JSON_PAYLOAD_SIZE 1024  // Increased to support larger individual sensor JSON
@@ -62,7 +63,68 @@ esp_err_t generate_sensor_json_with_hex(const sensor_config_t* sensor, double sc
                               char* json_buffer, size_t buffer_size);
 esp_err_t generate_quality_sensor_json(const sensor_reading_t* reading, char* json_buffer, size_t buffer_size);
 esp_err_t create_json_payload(const json_params_t* params, char* json_buffer, size_t buffer_size);
+// Streaming variants: append the sensor's document to w (e.g. straight into a telemetry message)
+esp_err_t json_write_payload(json_writer_t* w, const json_params_t* params);
+esp_err_t write_sensor_json(json_writer_t* w, const sensor_config_t* sensor, double scaled_value,
+                            uint32_t raw_value, const char* hex_string,
+                            const network_stats_t* net_stats);
 const char* get_json_template_name(json_template_type_t type);
+int get_json_value_decimals(json_template_type_t type);
+
+// Pre-rendered sensor documents
+// A sensor's document is compiled once per configuration change: everything
+// that comes from the configuration (unit_id, type, slave_id, meter, the
+// fixed quality defaults) is rendered into static text, and the per-reading
+// fields are slots spliced in at render time.
+#define JSON_TEMPLATE_MAX_SENSORS 20
+#define JSON_TEMPLATE_TEXT_SIZE 192
+#define JSON_TEMPLATE_MAX_SLOTS 4
+// Largest rendered document: the static text plus the widest slots
+#define JSON_TEMPLATE_DOC_SIZE 512
+
+typedef enum {
+    JSON_SLOT_VALUE,             // 49
+    JSON_SLOT_VALUE_QUOTED,      // "265.23"
+    JSON_SLOT_VALUE_X10,         // Quality TDS: value * 10
+    JSON_SLOT_TIMESTAMP,         // "2025-11-24T12:05:05Z"
+    JSON_SLOT_EPOCH,             // 1763986189
+    JSON_SLOT_HEX                // "00004351" (hex string or raw value)
+} json_slot_kind_t;
+
+typedef struct {
+    uint16_t at;                 // Offset in text where the slot is spliced in
+    uint8_t kind;                // json_slot_kind_t
+    uint8_t decimals;
+} json_template_slot_t;
+
+typedef struct {
+    esp_err_t status;            // ESP_OK, or why the sensor cannot be rendered from the template
+    uint8_t type;                // json_template_type_t
+    uint8_t slot_count;
+    uint16_t text_len;
+    json_template_slot_t slots[JSON_TEMPLATE_MAX_SLOTS];
+    char text[JSON_TEMPLATE_TEXT_SIZE];
+} json_sensor_template_t;
+
+typedef struct {
+    double value;
+    uint32_t raw_value;
+    const char* hex_string;      // ENERGY: hex string from Test RS485, NULL to use raw_value
+    time_t timestamp;
+} json_template_values_t;
+
+esp_err_t json_template_compile(const sensor_config_t* sensor, json_sensor_template_t* tpl);
+// Returns the document length, or -1 if it does not fit in size
+int json_template_render(const json_sensor_template_t* tpl, const json_template_values_t* values,
+                         char* out, size_t size);
+esp_err_t json_template_write(json_writer_t* w, const json_sensor_template_t* tpl,
+                              const json_template_values_t* values);
+
+// Template table for the configured sensors. json_templates_config_changed()
+// reports sensors that cannot use a template and invalidates the table;
+// entries are recompiled on their next lookup, made from the telemetry task only.
+void json_templates_config_changed(const system_config_t* config);
+const json_sensor_template_t* json_template_lookup(const system_config_t* config, int sensor_index);
 
 // Utility functions
 void format_timestamp_iso8601(char* timestamp, size_t size);
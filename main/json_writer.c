@@ -0,0 +1,291 @@
+// json_writer.c - Streaming JSON emitter with a bounded buffer
+
+#include "json_writer.h"
+#include "fixed_format.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static bool json_writer_drain(json_writer_t *w)
+{
+    if (w->error != ESP_OK) {
+        return false;
+    }
+    if (!w->sink) {
+        w->error = ESP_ERR_NO_MEM;
+        return false;
+    }
+    if (w->len > 0 && !w->sink(w->sink_ctx, w->buf, w->len)) {
+        w->error = ESP_FAIL;
+        return false;
+    }
+    w->len = 0;
+    return true;
+}
+
+static void json_writer_put(json_writer_t *w, const char *data, size_t len)
+{
+    if (w->error != ESP_OK) {
+        return;
+    }
+    while (len > 0) {
+        size_t room = w->size - 1 - w->len;
+        if (room == 0) {
+            if (!json_writer_drain(w)) {
+                return;
+            }
+            continue;
+        }
+        size_t n = len < room ? len : room;
+        memcpy(w->buf + w->len, data, n);
+        w->len += n;
+        data += n;
+        len -= n;
+    }
+    w->buf[w->len] = '\0';
+}
+
+static void json_writer_putc(json_writer_t *w, char c)
+{
+    if (w->error == ESP_OK && w->len + 1 < w->size) {
+        w->buf[w->len++] = c;
+        w->buf[w->len] = '\0';
+    } else {
+        json_writer_put(w, &c, 1);
+    }
+}
+
+// Comma before every value but the first at this level; none right after a key
+static void json_writer_value(json_writer_t *w)
+{
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    uint32_t bit = 1u << w->depth;
+    if (w->has_items & bit) {
+        json_writer_putc(w, ',');
+    }
+    w->has_items |= bit;
+}
+
+static void json_writer_begin(json_writer_t *w, char open)
+{
+    json_writer_value(w);
+    if (w->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+        w->error = w->error != ESP_OK ? w->error : ESP_ERR_INVALID_STATE;
+        return;
+    }
+    json_writer_putc(w, open);
+    w->depth++;
+    w->has_items &= ~(1u << w->depth);
+}
+
+static void json_writer_end(json_writer_t *w, char close)
+{
+    if (w->depth == 0) {
+        w->error = w->error != ESP_OK ? w->error : ESP_ERR_INVALID_STATE;
+        return;
+    }
+    w->depth--;
+    json_writer_putc(w, close);
+}
+
+static void json_writer_escaped(json_writer_t *w, const char *s)
+{
+    json_writer_putc(w, '"');
+    const char *run = s;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        json_writer_put(w, run, s - run);
+        run = s + 1;
+        char esc[6] = { '\\', 0 };
+        size_t n = 2;
+        switch (c) {
+            case '"':  esc[1] = '"'; break;
+            case '\\': esc[1] = '\\'; break;
+            case '\n': esc[1] = 'n'; break;
+            case '\r': esc[1] = 'r'; break;
+            case '\t': esc[1] = 't'; break;
+            case '\b': esc[1] = 'b'; break;
+            case '\f': esc[1] = 'f'; break;
+            default:
+                esc[1] = 'u'; esc[2] = '0'; esc[3] = '0';
+                esc[4] = hex_digits[c >> 4]; esc[5] = hex_digits[c & 0xF];
+                n = 6;
+                break;
+        }
+        json_writer_put(w, esc, n);
+    }
+    json_writer_put(w, run, s - run);
+    json_writer_putc(w, '"');
+}
+
+// Digits of v, written backwards from end; returns the first digit
+static char *json_writer_utoa(uint64_t v, char *end)
+{
+    do {
+        *--end = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    return end;
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size, json_writer_sink_fn sink, void *sink_ctx)
+{
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->size = size;
+    w->sink = sink;
+    w->sink_ctx = sink_ctx;
+    w->error = (buf && size >= 2) ? ESP_OK : ESP_ERR_INVALID_ARG;
+    if (buf && size > 0) {
+        buf[0] = '\0';
+    }
+}
+
+void json_writer_begin_object(json_writer_t *w) { json_writer_begin(w, '{'); }
+void json_writer_end_object(json_writer_t *w)   { json_writer_end(w, '}'); }
+void json_writer_begin_array(json_writer_t *w)  { json_writer_begin(w, '['); }
+void json_writer_end_array(json_writer_t *w)    { json_writer_end(w, ']'); }
+
+void json_writer_key(json_writer_t *w, const char *key)
+{
+    json_writer_value(w);
+    json_writer_escaped(w, key);
+    json_writer_putc(w, ':');
+    w->after_key = true;
+}
+
+void json_writer_string(json_writer_t *w, const char *s)
+{
+    json_writer_value(w);
+    json_writer_escaped(w, s ? s : "");
+}
+
+void json_writer_int(json_writer_t *w, int64_t v)
+{
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    char *p = json_writer_utoa(v < 0 ? 0 - (uint64_t)v : (uint64_t)v, end);
+    if (v < 0) {
+        *--p = '-';
+    }
+    json_writer_value(w);
+    json_writer_put(w, p, end - p);
+}
+
+void json_writer_uint(json_writer_t *w, uint64_t v)
+{
+    char digits[24];
+    char *end = digits + sizeof(digits);
+    char *p = json_writer_utoa(v, end);
+    json_writer_value(w);
+    json_writer_put(w, p, end - p);
+}
+
+static void json_writer_number(json_writer_t *w, double v, int decimals, bool quoted)
+{
+    json_writer_value(w);
+    if (!isfinite(v)) {
+        json_writer_put(w, "null", 4);
+        return;
+    }
+    char text[FIXED_FORMAT_BUF_SIZE];
+    int n = fixed_format(text, sizeof(text), v, decimals);
+    if (n < 0 || n >= (int)sizeof(text)) {
+        // Beyond what any sensor reports; keep the document valid
+        n = snprintf(text, sizeof(text), "%.17g", v);
+    }
+    if (quoted) {
+        json_writer_putc(w, '"');
+    }
+    json_writer_put(w, text, n);
+    if (quoted) {
+        json_writer_putc(w, '"');
+    }
+}
+
+void json_writer_double(json_writer_t *w, double v, int decimals)
+{
+    json_writer_number(w, v, decimals, false);
+}
+
+void json_writer_double_string(json_writer_t *w, double v, int decimals)
+{
+    json_writer_number(w, v, decimals, true);
+}
+
+void json_writer_bool(json_writer_t *w, bool v)
+{
+    json_writer_value(w);
+    json_writer_put(w, v ? "true" : "false", v ? 4 : 5);
+}
+
+void json_writer_null(json_writer_t *w)
+{
+    json_writer_value(w);
+    json_writer_put(w, "null", 4);
+}
+
+void json_writer_raw(json_writer_t *w, const char *json, size_t len)
+{
+    json_writer_value(w);
+    json_writer_put(w, json, len);
+}
+
+void json_writer_text(json_writer_t *w, const char *text, size_t len)
+{
+    json_writer_put(w, text, len);
+}
+
+void json_writer_key_string(json_writer_t *w, const char *key, const char *s)
+{
+    json_writer_key(w, key);
+    json_writer_string(w, s);
+}
+
+void json_writer_key_int(json_writer_t *w, const char *key, int64_t v)
+{
+    json_writer_key(w, key);
+    json_writer_int(w, v);
+}
+
+void json_writer_key_uint(json_writer_t *w, const char *key, uint64_t v)
+{
+    json_writer_key(w, key);
+    json_writer_uint(w, v);
+}
+
+void json_writer_key_double(json_writer_t *w, const char *key, double v, int decimals)
+{
+    json_writer_key(w, key);
+    json_writer_double(w, v, decimals);
+}
+
+void json_writer_key_bool(json_writer_t *w, const char *key, bool v)
+{
+    json_writer_key(w, key);
+    json_writer_bool(w, v);
+}
+
+void json_writer_rewind(json_writer_t *w, const json_writer_t *checkpoint)
+{
+    *w = *checkpoint;
+    if (w->buf && w->len < w->size) {
+        w->buf[w->len] = '\0';
+    }
+}
+
+esp_err_t json_writer_finish(json_writer_t *w)
+{
+    if (w->error == ESP_OK && w->sink) {
+        json_writer_drain(w);
+    }
+    return w->error;
+}
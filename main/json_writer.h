@@ -0,0 +1,74 @@
+// json_writer.h - Streaming JSON emitter with a bounded buffer
+// Values are appended at a cursor; commas and string escaping are handled by
+// the writer. Without a sink the buffer holds the whole document and stays
+// NUL-terminated. With a sink the buffer is only scratch space: it is handed to
+// the sink whenever it fills (an MQTT publish, httpd_resp_send_chunk, ...), so
+// a document of any size needs only the scratch buffer.
+//
+// Errors are sticky: once the buffer overflows (no sink) or the sink fails,
+// further writes are ignored and json_writer_finish() reports the error.
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define JSON_WRITER_MAX_DEPTH 16
+
+// Receives the next span of the document; return false to abort
+typedef bool (*json_writer_sink_fn)(void *ctx, const char *data, size_t len);
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;                  // Bytes in buf not yet handed to the sink
+    json_writer_sink_fn sink;
+    void *sink_ctx;
+    uint32_t has_items;          // Bit per nesting level: the next value needs a comma
+    uint8_t depth;
+    bool after_key;
+    esp_err_t error;             // ESP_ERR_NO_MEM (buffer full), ESP_FAIL (sink), ESP_ERR_INVALID_STATE (nesting)
+} json_writer_t;
+
+// buf needs room for the terminating NUL; sink may be NULL
+void json_writer_init(json_writer_t *w, char *buf, size_t size, json_writer_sink_fn sink, void *sink_ctx);
+
+void json_writer_begin_object(json_writer_t *w);
+void json_writer_end_object(json_writer_t *w);
+void json_writer_begin_array(json_writer_t *w);
+void json_writer_end_array(json_writer_t *w);
+void json_writer_key(json_writer_t *w, const char *key);
+
+void json_writer_string(json_writer_t *w, const char *s);
+void json_writer_int(json_writer_t *w, int64_t v);
+void json_writer_uint(json_writer_t *w, uint64_t v);
+// Fixed decimals, as "%.*f" (see fixed_format.h); NaN and infinities are written as null
+void json_writer_double(json_writer_t *w, double v, int decimals);
+// Same, quoted ("consumption":"12.34")
+void json_writer_double_string(json_writer_t *w, double v, int decimals);
+void json_writer_bool(json_writer_t *w, bool v);
+void json_writer_null(json_writer_t *w);
+// Already-serialized JSON value, copied verbatim
+void json_writer_raw(json_writer_t *w, const char *json, size_t len);
+// Plain text outside any JSON structure (no separators), for text formats
+// that want the writer's buffering and sink
+void json_writer_text(json_writer_t *w, const char *text, size_t len);
+
+// Key/value shorthands
+void json_writer_key_string(json_writer_t *w, const char *key, const char *s);
+void json_writer_key_int(json_writer_t *w, const char *key, int64_t v);
+void json_writer_key_uint(json_writer_t *w, const char *key, uint64_t v);
+void json_writer_key_double(json_writer_t *w, const char *key, double v, int decimals);
+void json_writer_key_bool(json_writer_t *w, const char *key, bool v);
+
+// Without a sink a copy of the writer is a checkpoint: rewinding drops
+// everything written since the copy was taken (e.g. an item that did not fit).
+void json_writer_rewind(json_writer_t *w, const json_writer_t *checkpoint);
+
+// Hands the rest of the buffer to the sink. Returns the sticky error, if any.
+esp_err_t json_writer_finish(json_writer_t *w);
+
+#endif // JSON_WRITER_H
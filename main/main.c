@@ -27,11 +27,19 @@
 
 #include "iot_configs.h"
 #include "modbus.h"
+#include "modbus_bus.h"
+#include "poll_planner.h"
 #include "web_config.h"
 #include "sensor_manager.h"
+#include "sensor_cache.h"
 #include "network_stats.h"
 #include "json_templates.h"
+#include "poll_profile.h"
+#include "trace.h"
+#include "metrics.h"
 #include "sd_card_logger.h"
+#include "sd_replay.h"
+#include "sd_history.h"
 #include "ds3231_rtc.h"
 #include "a7670c_ppp.h"
 #include "telegram_bot.h"
@@ -102,13 +110,15 @@ static uint32_t system_restart_count = 0;           // Loaded from NVS on boot
 static char mqtt_broker_uri[256];
 static char mqtt_username[256];
 static char telemetry_topic[256];
-static char telemetry_payload[8192];  // Increased to support up to 20 sensors
 static char c2d_topic[256];
 
 // Static buffers for telemetry to prevent heap fragmentation
 // These replace malloc/free calls that were causing memory exhaustion
 static sensor_reading_t telemetry_readings[20];  // Pre-allocated sensor readings
-static char telemetry_temp_json[MAX_JSON_PAYLOAD_SIZE];  // Pre-allocated JSON buffer
+
+// Batched telemetry: sensor JSON is written straight into the open message,
+// which is published (or cached) as soon as it is full
+static char telemetry_message[TELEMETRY_MAX_MESSAGE_SIZE + 1];
 
 // GPIO interrupt flag for web server toggle
 static volatile bool web_server_toggle_requested = false;
@@ -135,6 +145,7 @@ static SemaphoreHandle_t startup_log_mutex = NULL;
 typedef struct {
     char timestamp[32];
     char payload[400];  // Truncated version for display
+    bool truncated;     // payload is cut short, so no longer valid JSON
     bool success;
 } telemetry_record_t;
 
@@ -168,6 +179,8 @@ static void add_telemetry_to_history(const char *payload, bool success) {
         strncpy(telemetry_history[telemetry_history_index].payload, payload,
                 sizeof(telemetry_history[telemetry_history_index].payload) - 1);
         telemetry_history[telemetry_history_index].payload[sizeof(telemetry_history[telemetry_history_index].payload) - 1] = '\0';
+        telemetry_history[telemetry_history_index].truncated =
+            strlen(payload) >= sizeof(telemetry_history[telemetry_history_index].payload);
 
         // Set success flag
         telemetry_history[telemetry_history_index].success = success;
@@ -182,44 +195,42 @@ static void add_telemetry_to_history(const char *payload, bool success) {
     }
 }
 
-// Function to get telemetry history as JSON (called from web_config.c)
-int get_telemetry_history_json(char *buffer, size_t buffer_size) {
-    if (buffer == NULL || buffer_size < 10) {
-        return 0;
-    }
+// Write telemetry history as a JSON array, newest first (called from web_config.c).
+// Records are copied out one at a time so the mutex is never held while w's
+// sink is sending.
+esp_err_t write_telemetry_history_json(json_writer_t *w) {
+    json_writer_begin_array(w);
 
     // Always return valid JSON array, even if mutex not ready
-    if (telemetry_history_mutex == NULL) {
-        return snprintf(buffer, buffer_size, "[]");
-    }
-
-    int written = 0;
-    written += snprintf(buffer + written, buffer_size - written, "[");
-
-    if (xSemaphoreTake(telemetry_history_mutex, pdMS_TO_TICKS(200)) == pdTRUE) {
-        int count = 0;
-        // Read in reverse order (newest first)
-        for (int i = telemetry_history_count - 1; i >= 0; i--) {
-            int actual_index = (telemetry_history_index - 1 - (telemetry_history_count - 1 - i) + TELEMETRY_HISTORY_SIZE) % TELEMETRY_HISTORY_SIZE;
-
-            if (count > 0) {
-                written += snprintf(buffer + written, buffer_size - written, ",");
-            }
-
-            written += snprintf(buffer + written, buffer_size - written,
-                "{\"timestamp\":\"%s\",\"payload\":%s,\"success\":%s}",
-                telemetry_history[actual_index].timestamp,
-                telemetry_history[actual_index].payload,
-                telemetry_history[actual_index].success ? "true" : "false");
-
-            count++;
-            if (written >= buffer_size - 100) break; // Leave room for closing bracket
+    for (int n = 0; telemetry_history_mutex != NULL && w->error == ESP_OK; n++) {
+        telemetry_record_t record;
+        if (xSemaphoreTake(telemetry_history_mutex, pdMS_TO_TICKS(200)) != pdTRUE) {
+            break;
+        }
+        bool found = n < telemetry_history_count;
+        if (found) {
+            int actual_index = (telemetry_history_index - 1 - n + TELEMETRY_HISTORY_SIZE) % TELEMETRY_HISTORY_SIZE;
+            record = telemetry_history[actual_index];
         }
         xSemaphoreGive(telemetry_history_mutex);
+        if (!found) {
+            break;
+        }
+
+        json_writer_begin_object(w);
+        json_writer_key_string(w, "timestamp", record.timestamp);
+        json_writer_key(w, "payload");
+        if (record.truncated) {
+            json_writer_string(w, record.payload);
+        } else {
+            json_writer_raw(w, record.payload, strlen(record.payload));
+        }
+        json_writer_key_bool(w, "success", record.success);
+        json_writer_end_object(w);
     }
 
-    written += snprintf(buffer + written, buffer_size - written, "]");
-    return written;
+    json_writer_end_array(w);
+    return w->error;
 }
 static esp_err_t reinit_modem_reset_gpio(int new_gpio_pin);
 static void start_web_server(void);
@@ -510,39 +521,71 @@ static int generate_sas_token(char* token, size_t token_size, uint32_t expiry_se
     return 0;
 }
 
-// Callback function for replaying cached SD card messages to MQTT
-static void replay_message_callback(const pending_message_t* msg) {
-    if (!msg || !mqtt_client) {
-        ESP_LOGE(TAG, "[SD] Invalid message or MQTT client not initialized");
-        return;
-    }
+// Publish-to-PUBACK latency of QoS 1 messages (telemetry is QoS 0 and never acked)
+#define MQTT_ACK_PENDING_MAX 8
+typedef struct {
+    int msg_id;
+    int64_t start_us;
+} mqtt_ack_pending_t;
 
-    if (!mqtt_connected) {
-        ESP_LOGW(TAG, "[SD] Cannot replay message %lu - MQTT not connected", msg->message_id);
+static mqtt_ack_pending_t mqtt_ack_pending[MQTT_ACK_PENDING_MAX];
+static metric_t *mqtt_ack_metric = NULL;
+
+static void mqtt_ack_track(int msg_id) {
+    if (msg_id <= 0) {
         return;
     }
+    // Oldest entry is overwritten if PUBACKs stop arriving
+    int slot = 0;
+    for (int i = 0; i < MQTT_ACK_PENDING_MAX; i++) {
+        if (mqtt_ack_pending[i].msg_id == 0) {
+            slot = i;
+            break;
+        }
+        if (mqtt_ack_pending[i].start_us < mqtt_ack_pending[slot].start_us) {
+            slot = i;
+        }
+    }
+    mqtt_ack_pending[slot].msg_id = msg_id;
+    mqtt_ack_pending[slot].start_us = esp_timer_get_time();
+}
 
-    ESP_LOGI(TAG, "[SD] 📤 Replaying cached message ID %lu", msg->message_id);
-    ESP_LOGI(TAG, "[SD]    Topic: %s", msg->topic);
-    ESP_LOGI(TAG, "[SD]    Timestamp: %s", msg->timestamp);
-    ESP_LOGI(TAG, "[SD]    Payload: %.100s%s", msg->payload, strlen(msg->payload) > 100 ? "..." : "");
-
-    int msg_id = esp_mqtt_client_publish(mqtt_client, msg->topic, msg->payload, 0, 1, 0);
-    if (msg_id == -1) {
-        ESP_LOGE(TAG, "[SD] ❌ Failed to publish replayed message %lu", msg->message_id);
-    } else {
-        ESP_LOGI(TAG, "[SD] ✅ Successfully published replayed message %lu (MQTT msg_id: %d)",
-                 msg->message_id, msg_id);
-
-        // Remove the message from SD card after successful publish
-        esp_err_t ret = sd_card_remove_message(msg->message_id);
-        if (ret != ESP_OK) {
-            ESP_LOGW(TAG, "[SD] Failed to remove replayed message %lu from SD card", msg->message_id);
+static void mqtt_ack_complete(int msg_id) {
+    for (int i = 0; i < MQTT_ACK_PENDING_MAX; i++) {
+        if (mqtt_ack_pending[i].msg_id == msg_id) {
+            metrics_observe(mqtt_ack_metric, (uint32_t)((esp_timer_get_time() - mqtt_ack_pending[i].start_us) / 1000));
+            mqtt_ack_pending[i].msg_id = 0;
+            return;
         }
     }
+}
 
-    // Small delay between replayed messages to avoid overwhelming MQTT broker
-    vTaskDelay(pdMS_TO_TICKS(100));
+// Values kept in main.c globals, published at scrape time
+static void main_metrics_collect(metrics_out_t *out) {
+    metrics_emit_gauge(out, "uptime_seconds", "Seconds since boot", NULL, NULL,
+                       esp_timer_get_time() / 1000000 - system_uptime_start);
+    metrics_emit_gauge(out, "heap_free_bytes", "Free heap", NULL, NULL, esp_get_free_heap_size());
+    metrics_emit_gauge(out, "heap_min_free_bytes", "Lowest free heap since boot", NULL, NULL,
+                       esp_get_minimum_free_heap_size());
+    metrics_emit_counter(out, "telemetry_sent_total", "Telemetry messages published", NULL, NULL,
+                         total_telemetry_sent);
+    // Both reset on recovery, so they are gauges
+    metrics_emit_gauge(out, "telemetry_failures", "Consecutive telemetry failures", NULL, NULL,
+                       telemetry_failure_count);
+    metrics_emit_gauge(out, "mqtt_reconnects", "MQTT reconnect attempts since the last connection", NULL, NULL,
+                       mqtt_reconnect_count);
+    metrics_emit_counter(out, "system_restarts_total", "Restarts recorded in NVS", NULL, NULL,
+                         system_restart_count);
+}
+
+// Publish one cached message for the backlog replay task (QoS 1, PUBACK tracked by msg_id)
+static int replay_publish(const char* topic, const char* payload) {
+    if (!mqtt_client || !mqtt_connected) {
+        return -1;
+    }
+    int msg_id = esp_mqtt_client_publish(mqtt_client, topic, payload, 0, 1, 0);
+    mqtt_ack_track(msg_id);
+    return msg_id;
 }
 
 // Log heartbeat to SD card for post-mortem debugging
@@ -603,52 +646,80 @@ static void report_device_twin(void) {
     // Get OTA status for Device Twin
     ota_info_t* ota_info = ota_get_info();
 
+    // Sensor cache state (read lock-free, never touches the bus)
+    int cache_ok_count = 0;
+    sensor_cache_entry_t cache_entry;
+    for (int i = 0; i < config->sensor_count && i < SENSOR_CACHE_SLOTS; i++) {
+        if (config->sensors[i].enabled && sensor_cache_get(i, &cache_entry) &&
+            cache_entry.last_error == ESP_OK) {
+            cache_ok_count++;
+        }
+    }
+    int64_t cache_age_ms = sensor_cache_cycle_age_ms();
+
+    // Per-slave response times and adaptive timeouts (static: only the main loop reports)
+    static modbus_slave_stats_t slave_stats[MODBUS_STATS_MAX_SLAVES];
+    int slave_count = modbus_get_slave_statistics(slave_stats, MODBUS_STATS_MAX_SLAVES);
+
     // Create Device Twin reported properties JSON with OTA status
-    char twin_json[1536];
-    snprintf(twin_json, sizeof(twin_json),
-        "{\"deviceId\":\"%s\","
-        "\"firmwareVersion\":\"%s\","
-        "\"uptimeSeconds\":%lld,"
-        "\"freeHeapBytes\":%lu,"
-        "\"minFreeHeapBytes\":%lu,"
-        "\"mqttReconnectCount\":%lu,"
-        "\"telemetrySentCount\":%lu,"
-        "\"telemetryFailureCount\":%lu,"
-        "\"systemRestartCount\":%lu,"
-        "\"networkMode\":\"%s\","
-        "\"sdCardEnabled\":%s,"
-        "\"sensorCount\":%d,"
-        "\"ota\":{"
-        "\"status\":\"%s\","
-        "\"currentVersion\":\"%s\","
-        "\"newVersion\":\"%s\","
-        "\"progress\":%d,"
-        "\"bytesDownloaded\":%lu,"
-        "\"totalBytes\":%lu,"
-        "\"isRollback\":%s,"
-        "\"bootCount\":%d,"
-        "\"errorMsg\":\"%s\"}}",
-        config->azure_device_id,
-        FW_VERSION_STRING,
-        (long long)uptime,
-        esp_get_free_heap_size(),
-        esp_get_minimum_free_heap_size(),
-        mqtt_reconnect_count,
-        total_telemetry_sent,
-        telemetry_failure_count,
-        system_restart_count,
-        config->network_mode == NETWORK_MODE_WIFI ? "WiFi" : "SIM",
-        config->sd_config.enabled ? "true" : "false",
-        config->sensor_count,
-        ota_status_to_string(ota_info->status),
-        ota_info->current_version,
-        ota_info->new_version,
-        ota_info->progress,
-        ota_info->bytes_downloaded,
-        ota_info->total_bytes,
-        ota_info->is_rollback ? "true" : "false",
-        ota_info->boot_count,
-        ota_info->error_msg);
+    static char twin_json[4096];
+    json_writer_t w;
+    json_writer_init(&w, twin_json, sizeof(twin_json), NULL, NULL);
+    json_writer_begin_object(&w);
+    json_writer_key_string(&w, "deviceId", config->azure_device_id);
+    json_writer_key_string(&w, "firmwareVersion", FW_VERSION_STRING);
+    json_writer_key_int(&w, "uptimeSeconds", uptime);
+    json_writer_key_uint(&w, "freeHeapBytes", esp_get_free_heap_size());
+    json_writer_key_uint(&w, "minFreeHeapBytes", esp_get_minimum_free_heap_size());
+    json_writer_key_uint(&w, "mqttReconnectCount", mqtt_reconnect_count);
+    json_writer_key_uint(&w, "telemetrySentCount", total_telemetry_sent);
+    json_writer_key_uint(&w, "telemetryFailureCount", telemetry_failure_count);
+    json_writer_key_uint(&w, "systemRestartCount", system_restart_count);
+    json_writer_key_string(&w, "networkMode", config->network_mode == NETWORK_MODE_WIFI ? "WiFi" : "SIM");
+    json_writer_key_bool(&w, "sdCardEnabled", config->sd_config.enabled);
+    json_writer_key_int(&w, "sensorCount", config->sensor_count);
+
+    json_writer_key(&w, "sensorCache");
+    json_writer_begin_object(&w);
+    json_writer_key_uint(&w, "version", sensor_cache_version());
+    json_writer_key_int(&w, "ageSeconds", cache_age_ms >= 0 ? cache_age_ms / 1000 : -1);
+    json_writer_key_int(&w, "okCount", cache_ok_count);
+    json_writer_end_object(&w);
+
+    json_writer_key(&w, "modbusSlaves");
+    json_writer_begin_array(&w);
+    for (int i = 0; i < slave_count; i++) {
+        json_writer_begin_object(&w);
+        json_writer_key_int(&w, "id", slave_stats[i].slave_id);
+        json_writer_key_double(&w, "rttMs", slave_stats[i].rtt_ewma_us / 1000.0f, 1);
+        json_writer_key_uint(&w, "p99Ms", modbus_slave_rtt_p99_ms(&slave_stats[i]));
+        json_writer_key_uint(&w, "timeoutMs", slave_stats[i].timeout_ms);
+        json_writer_key_uint(&w, "timeouts", slave_stats[i].timeouts);
+        json_writer_end_object(&w);
+    }
+    json_writer_end_array(&w);
+
+    json_writer_key(&w, "metrics");
+    metrics_write_json(&w);
+
+    json_writer_key(&w, "ota");
+    json_writer_begin_object(&w);
+    json_writer_key_string(&w, "status", ota_status_to_string(ota_info->status));
+    json_writer_key_string(&w, "currentVersion", ota_info->current_version);
+    json_writer_key_string(&w, "newVersion", ota_info->new_version);
+    json_writer_key_int(&w, "progress", ota_info->progress);
+    json_writer_key_uint(&w, "bytesDownloaded", ota_info->bytes_downloaded);
+    json_writer_key_uint(&w, "totalBytes", ota_info->total_bytes);
+    json_writer_key_bool(&w, "isRollback", ota_info->is_rollback);
+    json_writer_key_int(&w, "bootCount", ota_info->boot_count);
+    json_writer_key_string(&w, "errorMsg", ota_info->error_msg);
+    json_writer_end_object(&w);
+    json_writer_end_object(&w);
+
+    if (json_writer_finish(&w) != ESP_OK) {
+        ESP_LOGW(TAG, "[TWIN] Reported properties exceed %d bytes, not sent", (int)sizeof(twin_json));
+        return;
+    }
 
     // Publish to Device Twin reported properties topic
     // Azure IoT Hub Device Twin topic format: $iothub/twin/PATCH/properties/reported/?$rid=<request_id>
@@ -656,7 +727,8 @@ static void report_device_twin(void) {
     static uint32_t twin_request_id = 0;
     snprintf(twin_topic, sizeof(twin_topic), "$iothub/twin/PATCH/properties/reported/?$rid=%lu", ++twin_request_id);
 
-    int msg_id = esp_mqtt_client_publish(mqtt_client, twin_topic, twin_json, 0, 1, 0);
+    int msg_id = esp_mqtt_client_publish(mqtt_client, twin_topic, twin_json, (int)w.len, 1, 0);
+    mqtt_ack_track(msg_id);
     if (msg_id >= 0) {
         ESP_LOGI(TAG, "[TWIN] Reported device status to Azure IoT Hub");
     } else {
@@ -722,6 +794,7 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
             mqtt_connected = true;
             mqtt_connect_time = esp_timer_get_time() / 1000000;  // Record connection time in seconds
             mqtt_reconnect_count = 0; // Reset reconnect counter on successful connection
+            sd_replay_set_connected(true);
 
             // Subscribe to cloud-to-device messages after connection
             system_config_t* config = get_system_config();
@@ -735,6 +808,7 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGW(TAG, "[WARN] MQTT_EVENT_DISCONNECTED");
             mqtt_connected = false;
+            sd_replay_set_connected(false);
             mqtt_reconnect_count++;
 
             // Check if network recovery is needed
@@ -793,7 +867,10 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
             break;
             
         case MQTT_EVENT_PUBLISHED:
-            ESP_LOGI(TAG, "[OK] TELEMETRY PUBLISHED SUCCESSFULLY! msg_id=%d", event->msg_id);
+            mqtt_ack_complete(event->msg_id);
+            if (!sd_replay_on_published(event->msg_id)) {
+                ESP_LOGI(TAG, "[OK] TELEMETRY PUBLISHED SUCCESSFULLY! msg_id=%d", event->msg_id);
+            }
             total_telemetry_sent++;
             last_telemetry_time = esp_timer_get_time() / 1000000;  // Record last telemetry time in seconds
             break;
@@ -851,6 +928,37 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
                                     }
                                 }
                             }
+                            else if (strcmp(cmd, "write_register") == 0) {
+                                cJSON *slave = cJSON_GetObjectItem(root, "slave_id");
+                                cJSON *address = cJSON_GetObjectItem(root, "address");
+                                cJSON *value = cJSON_GetObjectItem(root, "value");
+                                cJSON *baud = cJSON_GetObjectItem(root, "baud_rate");
+                                cJSON *parity = cJSON_GetObjectItem(root, "parity");
+
+                                if (slave && cJSON_IsNumber(slave) && slave->valueint >= 1 && slave->valueint <= 247 &&
+                                    address && cJSON_IsNumber(address) && address->valueint >= 0 && address->valueint <= 65535 &&
+                                    value && cJSON_IsNumber(value) && value->valueint >= 0 && value->valueint <= 65535) {
+                                    // Line settings default to whatever the bus currently runs
+                                    modbus_line_config_t line = {0};
+                                    if (baud && cJSON_IsNumber(baud) && baud->valueint > 0) {
+                                        line.baud_rate = baud->valueint;
+                                    }
+                                    if (parity && cJSON_IsString(parity)) {
+                                        line.parity = poll_parity_code(parity->valuestring);
+                                    }
+                                    modbus_result_t result = modbus_bus_write_single(MODBUS_PRIO_WRITE, &line,
+                                                                                     slave->valueint, address->valueint,
+                                                                                     value->valueint);
+                                    if (result == MODBUS_SUCCESS) {
+                                        ESP_LOGI(TAG, "[C2D] Register %d on slave %d set to %d",
+                                                 address->valueint, slave->valueint, value->valueint);
+                                    } else {
+                                        ESP_LOGE(TAG, "[C2D] Register write failed: %d", result);
+                                    }
+                                } else {
+                                    ESP_LOGW(TAG, "[C2D] write_register requires slave_id (1-247), address and value (0-65535)");
+                                }
+                            }
                             else if (strcmp(cmd, "get_status") == 0) {
                                 ESP_LOGI(TAG, "[C2D] Status request - sending telemetry now");
                                 send_telemetry();
@@ -1320,8 +1428,104 @@ static int initialize_mqtt_client(void) {
     return 0;
 }
 
-static void create_telemetry_payload(char* payload, size_t payload_size) {
+// Receives each finished telemetry message; return false to stop building
+typedef bool (*telemetry_emit_fn)(const char *message, size_t len, void *ctx);
+
+// A message carrying several sensors is a JSON array, a message carrying one
+// sensor is the bare object as before. The open message is always written as an
+// array; with one item the leading '[' is skipped when it is emitted.
+typedef struct {
+    json_writer_t writer;       // Open message in telemetry_message
+    int items;                  // Sensors in the open message
+    int msg_count;              // Messages emitted
+    int bytes;                  // Bytes emitted
+    size_t max_message_size;
+    telemetry_emit_fn emit;
+    void *emit_ctx;
+    bool stopped;               // emit returned false
+} telemetry_batch_t;
+
+static void telemetry_batch_open(telemetry_batch_t *batch) {
+    json_writer_init(&batch->writer, telemetry_message, batch->max_message_size + 1, NULL, NULL);
+    json_writer_begin_array(&batch->writer);
+    batch->items = 0;
+}
+
+static void telemetry_batch_close(telemetry_batch_t *batch) {
+    if (batch->items == 0 || batch->stopped) {
+        return;
+    }
+    const char *message = telemetry_message;
+    if (batch->items == 1) {
+        message++;
+    } else {
+        json_writer_end_array(&batch->writer);
+    }
+    size_t len = telemetry_message + batch->writer.len - message;
+    if (batch->emit(message, len, batch->emit_ctx)) {
+        batch->msg_count++;
+        batch->bytes += len;
+    } else {
+        batch->stopped = true;
+    }
+    telemetry_batch_open(batch);
+}
+
+// Write one sensor's document into the open message. If it does not fit, the
+// open message is emitted and the sensor starts the next one.
+static esp_err_t telemetry_batch_add(telemetry_batch_t *batch, int sensor_index, const sensor_config_t *sensor,
+                                     const sensor_reading_t *reading, const network_stats_t *net_stats) {
+    // ENERGY sensors send the hex string from Test RS485 when there is one
+    const char *hex = NULL;
+    uint32_t raw_value = reading->raw_value ? reading->raw_value : (uint32_t)(reading->value * 10000);
+    if (strcasecmp(sensor->sensor_type, "ENERGY") == 0 && strlen(reading->raw_hex) > 0) {
+        hex = reading->raw_hex;
+        raw_value = reading->raw_value;
+    }
+
+    // Rendered from the sensor's compiled template; built field by field only
+    // when the sensor has none (see json_templates_config_changed)
+    const json_sensor_template_t *tpl = json_template_lookup(get_system_config(), sensor_index);
+    json_template_values_t values = {
+        .value = reading->value,
+        .raw_value = raw_value,
+        .hex_string = hex,
+        .timestamp = time(NULL),
+    };
+
+    for (int attempt = 0; attempt < 2 && !batch->stopped; attempt++) {
+        json_writer_t checkpoint = batch->writer;
+        esp_err_t ret = (tpl && tpl->status == ESP_OK) ?
+            json_template_write(&batch->writer, tpl, &values) :
+            write_sensor_json(&batch->writer, sensor, reading->value, raw_value, hex, net_stats);
+        // Keep room for the closing ']'
+        if (ret == ESP_OK && batch->writer.len + 1 <= batch->max_message_size) {
+            batch->items++;
+            if (TELEMETRY_BATCH_MODE != TELEMETRY_BATCH_ARRAY) {
+                telemetry_batch_close(batch);
+            }
+            return ESP_OK;
+        }
+        json_writer_rewind(&batch->writer, &checkpoint);
+        if (ret != ESP_OK && ret != ESP_ERR_NO_MEM) {
+            return ret;
+        }
+        if (batch->items == 0) {
+            ESP_LOGW(TAG, "[WARN] Sensor %s JSON exceeds max message size %d, skipped",
+                     sensor->unit_id, (int)batch->max_message_size);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        telemetry_batch_close(batch);
+    }
+    return ESP_FAIL;
+}
+
+// Build telemetry for all valid sensors, packed into messages of at most
+// max_message_size bytes, each handed to emit as soon as it is complete.
+// Returns the number of messages emitted (0 = no data).
+static int create_telemetry_payload(size_t max_message_size, telemetry_emit_fn emit, void *emit_ctx) {
     system_config_t *config = get_system_config();
+    int message_count = 0;
 
     // Get network statistics for telemetry
     network_stats_t net_stats = {0};
@@ -1378,35 +1582,32 @@ static void create_telemetry_payload(char* payload, size_t payload_size) {
     // Use pre-allocated static buffers to prevent heap fragmentation
     // (malloc/free pattern was causing memory exhaustion when web server is active)
     sensor_reading_t* readings = telemetry_readings;
-    char* temp_json = telemetry_temp_json;
     memset(readings, 0, sizeof(telemetry_readings));
-    memset(temp_json, 0, sizeof(telemetry_temp_json));
 
+    // Served from the poll cache; only polls the bus if the cache has gone stale
     int actual_count = 0;
-    esp_err_t ret = sensor_read_all_configured(readings, 20, &actual_count);
+    esp_err_t ret = sensor_get_cached_readings(readings, 20, &actual_count);
     
     if (ret == ESP_OK && actual_count > 0) {
-        ESP_LOGI(TAG, "[FLOW] Creating merged JSON for %d sensors", actual_count);
-        
-        // Log sensor data for debugging
-        for (int i = 0; i < actual_count; i++) {
-            ESP_LOGI(TAG, "[DATA] Reading[%d]: Unit=%s, Valid=%d, Value=%.2f, Hex=%s", 
-                     i, readings[i].unit_id, readings[i].valid, readings[i].value, readings[i].raw_hex);
-        }
-        
-        int payload_pos = 0;
-
-        // Don't use array wrapper - send single JSON object directly
-        // (JSON templates already have "body" wrapper)
+        int64_t json_start_us = esp_timer_get_time();
+        telemetry_batch_t batch = {
+            .max_message_size = max_message_size < TELEMETRY_MAX_MESSAGE_SIZE ?
+                                max_message_size : TELEMETRY_MAX_MESSAGE_SIZE,
+            .emit = emit,
+            .emit_ctx = emit_ctx,
+        };
+        telemetry_batch_open(&batch);
 
         int valid_sensors = 0;
         for (int i = 0; i < actual_count; i++) {
             if (readings[i].valid) {
                 // Find the matching sensor config by unit_id
                 sensor_config_t* matching_sensor = NULL;
+                int sensor_index = -1;
                 for (int j = 0; j < config->sensor_count; j++) {
                     if (strcmp(config->sensors[j].unit_id, readings[i].unit_id) == 0) {
                         matching_sensor = &config->sensors[j];
+                        sensor_index = j;
                         break;
                     }
                 }
@@ -1416,68 +1617,70 @@ static void create_telemetry_payload(char* payload, size_t payload_size) {
                     continue;
                 }
                 
-                ESP_LOGI(TAG, "[TARGET] Sensor: Name='%s', Unit='%s', Type='%s', Value=%.2f", 
-                         matching_sensor->name, matching_sensor->unit_id, 
-                         matching_sensor->sensor_type, readings[i].value);
-                
-                // Generate JSON for this specific sensor using template system
-                esp_err_t json_result;
-
-                // Check if sensor is ENERGY type and has hex string available
-                if (strcasecmp(matching_sensor->sensor_type, "ENERGY") == 0 &&
-                    strlen(readings[i].raw_hex) > 0) {
-                    // Use the hex string from Test RS485 for ENERGY sensors
-                    json_result = generate_sensor_json_with_hex(
-                        matching_sensor,
-                        readings[i].value,
-                        readings[i].raw_value,
-                        readings[i].raw_hex,
-                        &net_stats,  // Pass network stats
-                        temp_json,
-                        MAX_JSON_PAYLOAD_SIZE
-                    );
-                } else {
-                    // Use standard JSON generation for other sensor types
-                    json_result = generate_sensor_json(
-                        matching_sensor,
-                        readings[i].value,
-                        readings[i].raw_value ? readings[i].raw_value : (uint32_t)(readings[i].value * 10000),
-                        &net_stats,  // Pass network stats
-                        temp_json,
-                        MAX_JSON_PAYLOAD_SIZE
-                    );
-                }
+                TRACE_DEBUG(TRACE_EV_TELEMETRY_VALUE, sensor_index, trace_float((float)readings[i].value));
                 
+                // Generate JSON for this specific sensor straight into the open message
+                esp_err_t json_result = telemetry_batch_add(&batch, sensor_index, matching_sensor, &readings[i], &net_stats);
                 if (json_result == ESP_OK) {
-                    // For first sensor, use its JSON directly (no array wrapper)
-                    // For multiple sensors, would need different strategy
-                    if (valid_sensors == 0) {
-                        int remaining_space = payload_size - payload_pos;
-                        if (remaining_space > strlen(temp_json) + 10) {
-                            payload_pos += snprintf(payload + payload_pos, remaining_space, "%s", temp_json);
-                            valid_sensors++;
-                        } else {
-                            ESP_LOGW(TAG, "[WARN] Payload buffer too small for sensor %d", i);
-                            break;
-                        }
-                    } else {
-                        ESP_LOGW(TAG, "[WARN] Multiple sensors not supported in this JSON format - only first sensor sent");
-                        break;
-                    }
+                    valid_sensors++;
+                } else if (batch.stopped) {
+                    ESP_LOGW(TAG, "[WARN] Message not delivered, stopping with %d sensor(s) unsent",
+                             actual_count - i);
+                    break;
                 } else {
                     ESP_LOGW(TAG, "[WARN] Failed to generate JSON for sensor %d", i);
                 }
             }
         }
 
-        // No closing bracket needed - single JSON object
+        telemetry_batch_close(&batch);
+        message_count = batch.msg_count;
+        uint32_t json_us = (uint32_t)(esp_timer_get_time() - json_start_us);
+        poll_profile_record_json(json_us, valid_sensors);
+        TRACE_INFO(TRACE_EV_TELEMETRY_BUILD, valid_sensors, json_us);
         
-        ESP_LOGI(TAG, "[OK] Merged JSON created with %d sensors (%d bytes)", valid_sensors, payload_pos);
+        ESP_LOGI(TAG, "[OK] Telemetry batch: %d sensors in %d message(s) (%d bytes)",
+                 valid_sensors, message_count, batch.bytes);
     } else {
         ESP_LOGW(TAG, "[WARN] No valid sensor data available, skipping telemetry");
-        payload[0] = '\0'; // Empty payload to indicate no data
     }
     // No free() needed - using static buffers
+    return message_count;
+}
+
+typedef struct {
+    const char *timestamp;
+    esp_err_t ret;
+} telemetry_cache_ctx_t;
+
+static bool cache_telemetry_message(const char *message, size_t len, void *ctx) {
+    telemetry_cache_ctx_t *cache = (telemetry_cache_ctx_t *)ctx;
+    (void)len;
+    esp_err_t ret = sd_card_save_message(telemetry_topic, message, cache->timestamp);
+    if (ret != ESP_OK) {
+        cache->ret = ret;
+    }
+    return true;
+}
+
+// Cache every telemetry message to the SD card for later replay
+static esp_err_t cache_telemetry_to_sd(void) {
+    size_t max_size = TELEMETRY_MAX_MESSAGE_SIZE < SD_CARD_MAX_PAYLOAD_SIZE - 1 ?
+                      TELEMETRY_MAX_MESSAGE_SIZE : SD_CARD_MAX_PAYLOAD_SIZE - 1;
+
+    // Generate timestamp for SD card message
+    time_t now = time(NULL);
+    struct tm timeinfo;
+    gmtime_r(&now, &timeinfo);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
+
+    telemetry_cache_ctx_t cache = { .timestamp = timestamp, .ret = ESP_OK };
+    int message_count = create_telemetry_payload(max_size, cache_telemetry_message, &cache);
+    if (message_count == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return cache.ret;
 }
 
 static esp_err_t read_configured_sensors_data(void) {
@@ -1534,11 +1737,8 @@ static esp_err_t read_configured_sensors_data(void) {
             ESP_LOGE(TAG, "[ERROR] Exceeded maximum Modbus read failures (%d)", MAX_MODBUS_READ_FAILURES);
             ESP_LOGE(TAG, "[CONFIG] Attempting to reinitialize Modbus communication...");
             
-            // Try to reinitialize Modbus
-            modbus_deinit();
-            vTaskDelay(pdMS_TO_TICKS(1000)); // Wait 1 second
-            
-            esp_err_t init_ret = modbus_init();
+            // Try to reinitialize Modbus (runs on the bus task between transactions)
+            esp_err_t init_ret = modbus_bus_reinit();
             if (init_ret == ESP_OK) {
                 ESP_LOGI(TAG, "[OK] Modbus reinitialized successfully");
                 modbus_failure_count = 0;
@@ -1987,6 +2187,8 @@ static void update_led_status(void)
 // Modbus reading task (Core 0)
 static void modbus_task(void *pvParameters)
 {
+    metric_t *stack_metric = metrics_task_stack_gauge("modbus_task");
+
     // Wait a bit to let the system stabilize before starting
     vTaskDelay(pdMS_TO_TICKS(100));
 
@@ -2033,6 +2235,11 @@ static void modbus_task(void *pvParameters)
             // Mark sensors as not responding if read failed
             sensors_responding = false;
         }
+
+        // Append this cycle's readings (or stale markers) to the local historian
+        if (sd_card_is_available()) {
+            sd_history_record_cycle();
+        }
         
         // Check for web server toggle request (handled by main monitoring loop)
         if (web_server_toggle_requested) {
@@ -2049,7 +2256,8 @@ static void modbus_task(void *pvParameters)
             return;
         }
         
-        vTaskDelay(pdMS_TO_TICKS(120000)); // Read every 2 minutes (120 seconds)
+        metrics_report_task_stack(stack_metric);
+        vTaskDelay(pdMS_TO_TICKS(MODBUS_POLL_INTERVAL_SEC * 1000));
     }
     
     // Task exiting normally (due to config mode request)
@@ -2098,6 +2306,9 @@ static void mqtt_task(void *pvParameters)
         vTaskDelete(NULL);
         return;
     }
+
+    // Registered only by a task that runs, not one skipped in setup mode
+    metric_t *stack_metric = metrics_task_stack_gauge("mqtt_task");
     
     while (1) {
         // Check for shutdown request only (web server toggle doesn't affect MQTT)
@@ -2111,6 +2322,7 @@ static void mqtt_task(void *pvParameters)
             ESP_LOGW(TAG, "[WARN] MQTT disconnected, checking connection...");
         }
 
+        metrics_report_task_stack(stack_metric);
         // Check every 10 seconds to reduce power consumption
         vTaskDelay(pdMS_TO_TICKS(10000));
     }
@@ -2153,9 +2365,11 @@ static void telemetry_task(void *pvParameters)
         xSemaphoreGive(startup_log_mutex);
     }
     
+    metric_t *stack_metric = metrics_task_stack_gauge("telemetry_task");
     system_config_t* config = get_system_config();
     TickType_t last_send_time = 0;
     bool first_telemetry_sent = false;
+    UBaseType_t telemetry_stack_low = UINT32_MAX;
     
     while (1) {
         // Check for shutdown request only (web server toggle doesn't affect telemetry)
@@ -2210,6 +2424,12 @@ static void telemetry_task(void *pvParameters)
         if (should_send_telemetry) {
             // Always call send_telemetry() - it will handle SD caching if MQTT is disconnected
             bool telemetry_success = send_telemetry();
+            // Payload building is the deepest path on this task; report each new low
+            UBaseType_t stack_free = uxTaskGetStackHighWaterMark(NULL);
+            if (stack_free < telemetry_stack_low) {
+                telemetry_stack_low = stack_free;
+                ESP_LOGI(TAG, "[DATA] Stack high-water: %u bytes free", (unsigned)stack_free);
+            }
             // Update last_send_time AFTER successful telemetry call
             if (telemetry_success && first_telemetry_sent) {
                 // For subsequent telemetries, only update timestamp after successful send
@@ -2229,6 +2449,7 @@ static void telemetry_task(void *pvParameters)
             }
         }
         
+        metrics_report_task_stack(stack_metric);
         vTaskDelay(pdMS_TO_TICKS(5000)); // Increased to 5 seconds to prevent timing edge cases
     }
     
@@ -2238,6 +2459,44 @@ static void telemetry_task(void *pvParameters)
     vTaskDelete(NULL);
 }
 
+// Publish one telemetry message (telemetry_emit_fn); ctx is the caller's failure flag
+static bool publish_telemetry_message(const char *message, size_t len, void *ctx) {
+    bool *failed = (bool *)ctx;
+    int message_len = (int)len;
+
+    ESP_LOGD(TAG, "[PKG] Payload (%d bytes): %s", message_len, message);
+
+    // Try QoS 0 for compatibility with Arduino 1.0.6
+    int msg_id = esp_mqtt_client_publish(
+        mqtt_client,
+        telemetry_topic,
+        message,
+        message_len,
+        0,  // QoS 0 for Arduino 1.0.6 compatibility
+        0   // DO_NOT_RETAIN_MSG
+    );
+
+    if (msg_id == -1) {
+        ESP_LOGE(TAG, "[ERROR] FAILED to publish telemetry - MQTT client error");
+        ESP_LOGE(TAG, "   Check: MQTT connection, topic format, payload size");
+        ESP_LOGE(TAG, "   Topic: %s", telemetry_topic);
+        ESP_LOGE(TAG, "   Payload size: %d bytes", message_len);
+        ESP_LOGE(TAG, "   MQTT connected: %s", mqtt_connected ? "YES" : "NO");
+        *failed = true;
+        return false;
+    }
+
+    total_telemetry_sent++; // Increment counter for web interface (Azure IoT doesn't send PUBACK)
+
+    // One trace entry per message; the payload itself stays out of the INFO log
+    TRACE_INFO(TRACE_EV_TELEMETRY_PUBLISH, msg_id, message_len);
+    ESP_LOGD(TAG, "[SEND] Published to %s, msg_id=%d", telemetry_topic, msg_id);
+
+    // Store in telemetry history for web interface
+    add_telemetry_to_history(message, true);
+    return true;
+}
+
 static bool send_telemetry(void) {
     static uint32_t call_counter = 0;
     static bool send_in_progress = false;
@@ -2266,20 +2525,12 @@ static bool send_telemetry(void) {
         if (config->sd_config.enabled && config->sd_config.cache_on_failure) {
             ESP_LOGI(TAG, "[SD] 💾 Caching telemetry to SD card (network unavailable)...");
 
-            // Generate the telemetry payload first
+            // Generate the telemetry messages first
             snprintf(telemetry_topic, sizeof(telemetry_topic),
                      "devices/%s/messages/events/", config->azure_device_id);
-            create_telemetry_payload(telemetry_payload, sizeof(telemetry_payload));
-
-            if (strlen(telemetry_payload) > 0) {
-                // Generate timestamp for SD card message
-                time_t now = time(NULL);
-                struct tm timeinfo;
-                gmtime_r(&now, &timeinfo);
-                char timestamp[32];
-                strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
+            esp_err_t ret = cache_telemetry_to_sd();
 
-                esp_err_t ret = sd_card_save_message(telemetry_topic, telemetry_payload, timestamp);
+            if (ret != ESP_ERR_NOT_FOUND) {
                 if (ret == ESP_OK) {
                     ESP_LOGI(TAG, "[SD] ✅ Telemetry cached to SD card - will replay when network reconnects");
                     send_in_progress = false;
@@ -2314,20 +2565,12 @@ static bool send_telemetry(void) {
         if (config->sd_config.enabled && config->sd_config.cache_on_failure) {
             ESP_LOGI(TAG, "[SD] 💾 Caching telemetry to SD card (MQTT disconnected)...");
 
-            // Generate the telemetry payload first
+            // Generate the telemetry messages first
             snprintf(telemetry_topic, sizeof(telemetry_topic),
                      "devices/%s/messages/events/", config->azure_device_id);
-            create_telemetry_payload(telemetry_payload, sizeof(telemetry_payload));
+            esp_err_t ret = cache_telemetry_to_sd();
 
-            if (strlen(telemetry_payload) > 0) {
-                // Generate timestamp for SD card message
-                time_t now = time(NULL);
-                struct tm timeinfo;
-                gmtime_r(&now, &timeinfo);
-                char timestamp[32];
-                strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
-
-                esp_err_t ret = sd_card_save_message(telemetry_topic, telemetry_payload, timestamp);
+            if (ret != ESP_ERR_NOT_FOUND) {
                 if (ret == ESP_OK) {
                     ESP_LOGI(TAG, "[SD] ✅ Telemetry cached to SD card - will replay when MQTT reconnects");
                     send_in_progress = false;
@@ -2351,24 +2594,8 @@ static bool send_telemetry(void) {
     
     ESP_LOGI(TAG, "[SEND] Sending telemetry message #%lu...", telemetry_send_count);
 
-    // IMPORTANT: Replay cached offline messages FIRST before sending live data
-    // This ensures chronological order - older cached data must be sent before newer live data
-    // Otherwise cloud analytics will use live data as reference and cached data becomes useless
-    if (config->sd_config.enabled) {
-        uint32_t pending_count = 0;
-        sd_card_get_pending_count(&pending_count);
-        if (pending_count > 0) {
-            ESP_LOGI(TAG, "[SD] 📤 Found %lu cached messages - sending FIRST (before live data)", pending_count);
-            esp_err_t replay_ret = sd_card_replay_messages(replay_message_callback);
-            if (replay_ret == ESP_OK) {
-                ESP_LOGI(TAG, "[SD] ✅ Cached messages sent successfully - now sending live data");
-            } else {
-                ESP_LOGW(TAG, "[SD] ⚠️ Some cached messages failed: %s", esp_err_to_name(replay_ret));
-            }
-            // Small delay to ensure cached messages are processed before live data
-            vTaskDelay(pdMS_TO_TICKS(500));
-        }
-    }
+    // Cached offline messages are replayed concurrently by the sd_replay task;
+    // every message carries its own created_on timestamp
 
     // Data is now provided by the modbus task via queue
 
@@ -2383,47 +2610,27 @@ static bool send_telemetry(void) {
         return false;
     }
 
-    create_telemetry_payload(telemetry_payload, sizeof(telemetry_payload));
-
-    // Check if payload is empty (no valid sensor data)
-    if (strlen(telemetry_payload) == 0) {
-        ESP_LOGW(TAG, "[WARN] No sensor data available, skipping telemetry transmission");
-        send_in_progress = false;
-        return false;
-    }
-
     ESP_LOGI(TAG, "[LOC] Topic: %s", telemetry_topic);
-    ESP_LOGI(TAG, "[PKG] Payload: %s", telemetry_payload);
-    ESP_LOGI(TAG, "[PKG] Payload Length: %d bytes", strlen(telemetry_payload));
     ESP_LOGI(TAG, "[KEY] Using SAS Token: %.50s...", sas_token);
     ESP_LOGI(TAG, "[NET] Device ID: %s", config->azure_device_id);
     ESP_LOGI(TAG, "[HUB] IoT Hub: %s", IOT_CONFIG_IOTHUB_FQDN);
     ESP_LOGI(TAG, "[LINK] MQTT Connected: %s", mqtt_connected ? "YES" : "NO");
-    
-    // Check payload size limit (Azure IoT Hub has 256KB limit)
-    if (strlen(telemetry_payload) > 262144) {
-        ESP_LOGE(TAG, "[ERROR] Payload too large: %d bytes (max 256KB)", strlen(telemetry_payload));
+
+    // Each message is published as soon as it is built; the MQTT client
+    // pipelines them on one connection
+    bool publish_failed = false;
+    int published = create_telemetry_payload(TELEMETRY_MAX_MESSAGE_SIZE, publish_telemetry_message,
+                                             &publish_failed);
+
+    // Check if payload is empty (no valid sensor data)
+    if (published == 0 && !publish_failed) {
+        ESP_LOGW(TAG, "[WARN] No sensor data available, skipping telemetry transmission");
         send_in_progress = false;
         return false;
     }
-    
-    // Try QoS 0 for compatibility with Arduino 1.0.6
-    int msg_id = esp_mqtt_client_publish(
-        mqtt_client,
-        telemetry_topic,
-        telemetry_payload,
-        strlen(telemetry_payload),
-        0,  // QoS 0 for Arduino 1.0.6 compatibility
-        0   // DO_NOT_RETAIN_MSG
-    );
+    ESP_LOGI(TAG, "[PKG] Messages: %d", published);
 
-    if (msg_id == -1) {
-        ESP_LOGE(TAG, "[ERROR] FAILED to publish telemetry - MQTT client error");
-        ESP_LOGE(TAG, "   Check: MQTT connection, topic format, payload size");
-        ESP_LOGE(TAG, "   Topic: %s", telemetry_topic);
-        ESP_LOGE(TAG, "   Payload size: %d bytes", strlen(telemetry_payload));
-        ESP_LOGE(TAG, "   MQTT connected: %s", mqtt_connected ? "YES" : "NO");
-        
+    if (publish_failed) {
         // Try to reconnect MQTT if disconnected
         if (!mqtt_connected && mqtt_client != NULL) {
             ESP_LOGW(TAG, "[WARN] Attempting MQTT reconnection...");
@@ -2432,27 +2639,15 @@ static bool send_telemetry(void) {
         send_in_progress = false; // Reset flag on failure
         telemetry_failure_count++;  // Track failures for recovery monitoring
         return false;
-    } else {
-        ESP_LOGI(TAG, "[OK] Telemetry queued for publish, msg_id=%d", msg_id);
-        ESP_LOGI(TAG, "   Waiting for MQTT_EVENT_PUBLISHED confirmation...");
-        telemetry_send_count++;
-        total_telemetry_sent++; // Increment counter for web interface (Azure IoT doesn't send PUBACK)
-        last_telemetry_time = esp_timer_get_time() / 1000000; // Update last telemetry timestamp
-        last_successful_telemetry_time = esp_timer_get_time() / 1000000;  // For recovery timeout
-        telemetry_failure_count = 0;  // Reset failure count on success
-
-        // Log detailed publish info
-        ESP_LOGI(TAG, "[SEND] Published to Azure IoT Hub:");
-        ESP_LOGI(TAG, "   Topic: %s", telemetry_topic);
-        ESP_LOGI(TAG, "   Message ID: %d", msg_id);
-        ESP_LOGI(TAG, "   Payload: %.200s%s", telemetry_payload, strlen(telemetry_payload) > 200 ? "..." : "");
-
-        // Store in telemetry history for web interface
-        add_telemetry_to_history(telemetry_payload, true);
-
-        send_in_progress = false; // Reset flag on success
-        return true;
     }
+
+    telemetry_send_count++;
+    last_telemetry_time = esp_timer_get_time() / 1000000; // Update last telemetry timestamp
+    last_successful_telemetry_time = esp_timer_get_time() / 1000000;  // For recovery timeout
+    telemetry_failure_count = 0;  // Reset failure count on success
+
+    send_in_progress = false; // Reset flag on success
+    return true;
 }
 
 void app_main(void) {
@@ -2465,6 +2660,9 @@ void app_main(void) {
 
     // Initialize system uptime tracking
     system_uptime_start = esp_timer_get_time() / 1000000;
+    mqtt_ack_metric = metrics_histogram("mqtt_ack_ms", "QoS 1 publish to PUBACK", NULL, NULL,
+                                        METRICS_LATENCY_MS_BOUNDS);
+    metrics_register_collector(main_metrics_collect);
 
     // Initialize Hardware Watchdog Timer (prevents system hang)
     ESP_LOGI(TAG, "[WDT] Initializing hardware watchdog timer (%d seconds)...", WATCHDOG_TIMEOUT_SEC);
@@ -2647,12 +2845,22 @@ void app_main(void) {
     ESP_LOGI(TAG, "║         🔌 MODBUS RS485 INITIALIZATION 🔌                ║");
     ESP_LOGI(TAG, "╚══════════════════════════════════════════════════════════╝");
     ESP_LOGI(TAG, "[CONFIG] Initializing Modbus RS485 communication...");
+    ret = sensor_manager_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "[WARN] Sensor manager init failed, sensors will be polled individually");
+    }
     ret = modbus_init();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "[ERROR] Failed to initialize Modbus: %s", esp_err_to_name(ret));
         ESP_LOGE(TAG, "[WARN] System will continue with simulated data only");
     } else {
         ESP_LOGI(TAG, "[OK] Modbus RS485 initialized successfully");
+
+        // All RS485 traffic goes through the bus owner task from here on
+        ret = modbus_bus_start();
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "[ERROR] Failed to start RS485 bus task: %s", esp_err_to_name(ret));
+        }
         
         // Test all configured sensors
         ESP_LOGI(TAG, "[TEST] Testing %d configured sensors...", config->sensor_count);
@@ -2890,6 +3098,11 @@ void app_main(void) {
         return;
     }
     
+    // Backlog replay task (drains the SD cache while MQTT is connected)
+    if (config->sd_config.enabled) {
+        sd_replay_start(replay_publish);
+    }
+
     ESP_LOGI(TAG, "[OK] All tasks created successfully");
     ESP_LOGI(TAG, "[CORE] Modbus reading: Core 0 (priority 5)");
     ESP_LOGI(TAG, "[NET] MQTT handling: Core 1 (priority 4)");
@@ -2989,6 +3202,11 @@ void app_main(void) {
             check_telemetry_timeout_recovery();
         }
 
+        // Write cached telemetry staged in RAM out to the SD card once it is due
+        if (sd_card_is_available()) {
+            sd_card_flush_if_due();
+        }
+
         // Heartbeat logging to SD card (every 5 minutes)
         int64_t current_time_sec = esp_timer_get_time() / 1000000;
         if (current_time_sec - last_heartbeat_time >= HEARTBEAT_LOG_INTERVAL_SEC) {
@@ -0,0 +1,384 @@
+// metrics.c - Registry of counters, gauges and fixed-bucket histograms
+
+#include "metrics.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <string.h>
+
+const uint32_t metrics_latency_ms_bounds[10] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000};
+
+static metric_t s_metrics[METRICS_MAX];
+static uint32_t s_metric_count = 0;
+static metrics_collector_fn s_collectors[METRICS_MAX_COLLECTORS];
+static uint32_t s_collector_count = 0;
+static bool s_register_lock = false;
+
+struct metrics_out {
+    json_writer_t *w;
+    bool json;
+    const char *family;                    // Family of the previous series
+    bool family_open;                      // JSON: object of a labeled family is open
+};
+
+static const char *const type_names[] = {"counter", "gauge", "histogram"};
+
+// Registration is rare (module init); only updates need to be lock-free
+static void metrics_lock(void)
+{
+    while (__atomic_test_and_set(&s_register_lock, __ATOMIC_ACQUIRE)) {
+        vTaskDelay(1);
+    }
+}
+
+static void metrics_unlock(void)
+{
+    __atomic_clear(&s_register_lock, __ATOMIC_RELEASE);
+}
+
+static metric_t *metrics_register(metric_type_t type, const char *name, const char *help, const char *label_key,
+                                  const char *label_value, const uint32_t *bounds, int bound_count)
+{
+    if (!name || (type == METRIC_HISTOGRAM && (!bounds || bound_count < 1 || bound_count > METRICS_MAX_BUCKETS))) {
+        return NULL;
+    }
+    if (!label_key) {
+        label_value = "";
+    } else if (!label_value) {
+        return NULL;
+    }
+
+    metrics_lock();
+    uint32_t count = __atomic_load_n(&s_metric_count, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < count; i++) {
+        if (strcmp(s_metrics[i].name, name) == 0 && strcmp(s_metrics[i].label_value, label_value) == 0) {
+            metrics_unlock();
+            return s_metrics[i].type == type ? &s_metrics[i] : NULL;
+        }
+    }
+    if (count >= METRICS_MAX) {
+        metrics_unlock();
+        return NULL;
+    }
+
+    metric_t *metric = &s_metrics[count];
+    memset(metric, 0, sizeof(*metric));
+    metric->name = name;
+    metric->help = help ? help : "";
+    metric->label_key = label_key;
+    strncpy(metric->label_value, label_value, sizeof(metric->label_value) - 1);
+    metric->type = type;
+    metric->bounds = bounds;
+    metric->bound_count = (uint8_t)bound_count;
+    __atomic_store_n(&s_metric_count, count + 1, __ATOMIC_RELEASE);
+    metrics_unlock();
+    return metric;
+}
+
+metric_t *metrics_counter(const char *name, const char *help, const char *label_key, const char *label_value)
+{
+    return metrics_register(METRIC_COUNTER, name, help, label_key, label_value, NULL, 0);
+}
+
+metric_t *metrics_gauge(const char *name, const char *help, const char *label_key, const char *label_value)
+{
+    return metrics_register(METRIC_GAUGE, name, help, label_key, label_value, NULL, 0);
+}
+
+metric_t *metrics_histogram(const char *name, const char *help, const char *label_key, const char *label_value,
+                            const uint32_t *bounds, int bound_count)
+{
+    return metrics_register(METRIC_HISTOGRAM, name, help, label_key, label_value, bounds, bound_count);
+}
+
+void metrics_inc(metric_t *metric, uint32_t n)
+{
+    if (metric) {
+        __atomic_fetch_add(&metric->value, n, __ATOMIC_RELAXED);
+    }
+}
+
+void metrics_set(metric_t *metric, int32_t value)
+{
+    if (metric) {
+        __atomic_store_n(&metric->value, (uint32_t)value, __ATOMIC_RELAXED);
+    }
+}
+
+void metrics_observe(metric_t *metric, uint32_t value)
+{
+    if (!metric || metric->type != METRIC_HISTOGRAM) {
+        return;
+    }
+    int bucket = 0;
+    while (bucket < metric->bound_count && value > metric->bounds[bucket]) {
+        bucket++;
+    }
+    __atomic_fetch_add(&metric->buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&metric->sum, (uint64_t)value, __ATOMIC_RELAXED);
+}
+
+metric_t *metrics_task_stack_gauge(const char *task_name)
+{
+    return metrics_gauge("task_stack_free_bytes", "Lowest free stack of the task since boot", "task", task_name);
+}
+
+void metrics_report_task_stack(metric_t *gauge)
+{
+    metrics_set(gauge, (int32_t)uxTaskGetStackHighWaterMark(NULL));
+}
+
+esp_err_t metrics_register_collector(metrics_collector_fn collector)
+{
+    if (!collector) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    metrics_lock();
+    uint32_t count = s_collector_count;
+    for (uint32_t i = 0; i < count; i++) {
+        if (s_collectors[i] == collector) {
+            metrics_unlock();
+            return ESP_OK;
+        }
+    }
+    if (count >= METRICS_MAX_COLLECTORS) {
+        metrics_unlock();
+        return ESP_ERR_NO_MEM;
+    }
+    s_collectors[count] = collector;
+    __atomic_store_n(&s_collector_count, count + 1, __ATOMIC_RELEASE);
+    metrics_unlock();
+    return ESP_OK;
+}
+
+// --- Output -----------------------------------------------------------------
+
+static void metrics_text(metrics_out_t *out, const char *text)
+{
+    json_writer_text(out->w, text, strlen(text));
+}
+
+// Series name with its label set; extra is an additional label (le="...")
+static void metrics_text_series(metrics_out_t *out, const char *name, const char *suffix,
+                                const char *label_key, const char *label_value, const char *extra)
+{
+    char line[96];
+    bool labels = label_key || extra;
+    snprintf(line, sizeof(line), "%s%s%s%s%s%s%s%s%s", name, suffix, labels ? "{" : "",
+             label_key ? label_key : "", label_key ? "=\"" : "", label_key ? label_value : "",
+             label_key ? "\"" : "", label_key && extra ? "," : "", extra ? extra : "");
+    metrics_text(out, line);
+    metrics_text(out, labels ? "} " : " ");
+}
+
+static void metrics_text_u64(metrics_out_t *out, uint64_t value)
+{
+    char text[24];
+    snprintf(text, sizeof(text), "%llu\n", (unsigned long long)value);
+    metrics_text(out, text);
+}
+
+static void metrics_text_i64(metrics_out_t *out, int64_t value)
+{
+    char text[24];
+    snprintf(text, sizeof(text), "%lld\n", (long long)value);
+    metrics_text(out, text);
+}
+
+// Starts a series: family header (text) or the key of the value (JSON)
+static void metrics_begin_series(metrics_out_t *out, metric_type_t type, const char *name, const char *help,
+                                 const char *label_key, const char *label_value)
+{
+    bool same_family = out->family && strcmp(out->family, name) == 0;
+
+    if (!out->json) {
+        if (!same_family) {
+            char line[160];
+            snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", name, help ? help : "",
+                     name, type_names[type]);
+            metrics_text(out, line);
+        }
+        out->family = name;
+        return;
+    }
+
+    if (out->family_open && (!same_family || !label_key)) {
+        json_writer_end_object(out->w);
+        out->family_open = false;
+    }
+    if (label_key) {
+        if (!out->family_open) {
+            json_writer_key(out->w, name);
+            json_writer_begin_object(out->w);
+            out->family_open = true;
+        }
+        json_writer_key(out->w, label_value);
+    } else {
+        json_writer_key(out->w, name);
+    }
+    out->family = name;
+}
+
+void metrics_emit_counter(metrics_out_t *out, const char *name, const char *help,
+                          const char *label_key, const char *label_value, uint64_t value)
+{
+    metrics_begin_series(out, METRIC_COUNTER, name, help, label_key, label_value);
+    if (out->json) {
+        json_writer_uint(out->w, value);
+    } else {
+        metrics_text_series(out, name, "", label_key, label_value, NULL);
+        metrics_text_u64(out, value);
+    }
+}
+
+void metrics_emit_gauge(metrics_out_t *out, const char *name, const char *help,
+                        const char *label_key, const char *label_value, int64_t value)
+{
+    metrics_begin_series(out, METRIC_GAUGE, name, help, label_key, label_value);
+    if (out->json) {
+        json_writer_int(out->w, value);
+    } else {
+        metrics_text_series(out, name, "", label_key, label_value, NULL);
+        metrics_text_i64(out, value);
+    }
+}
+
+// Upper bound of the bucket holding the given quantile; false in the overflow bucket
+static bool metrics_quantile(const uint32_t *bounds, int bound_count, const uint32_t *buckets, uint64_t count,
+                             int percent, uint32_t *bound)
+{
+    uint64_t rank = (count * (uint64_t)percent + 99) / 100;
+    uint64_t cumulative = 0;
+    for (int i = 0; i < bound_count; i++) {
+        cumulative += buckets[i];
+        if (cumulative >= rank) {
+            *bound = bounds[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+void metrics_emit_histogram(metrics_out_t *out, const char *name, const char *help,
+                            const char *label_key, const char *label_value,
+                            const uint32_t *bounds, int bound_count, const uint32_t *buckets, uint64_t sum)
+{
+    uint64_t count = 0;
+    for (int i = 0; i <= bound_count; i++) {
+        count += buckets[i];
+    }
+
+    metrics_begin_series(out, METRIC_HISTOGRAM, name, help, label_key, label_value);
+    if (out->json) {
+        uint32_t bound;
+        json_writer_begin_object(out->w);
+        json_writer_key_uint(out->w, "count", count);
+        json_writer_key_uint(out->w, "sum", sum);
+        if (count == 0) {
+            json_writer_end_object(out->w);
+            return;
+        }
+        json_writer_key(out->w, "p50");
+        if (metrics_quantile(bounds, bound_count, buckets, count, 50, &bound)) {
+            json_writer_uint(out->w, bound);
+        } else {
+            json_writer_null(out->w);
+        }
+        json_writer_key(out->w, "p99");
+        if (metrics_quantile(bounds, bound_count, buckets, count, 99, &bound)) {
+            json_writer_uint(out->w, bound);
+        } else {
+            json_writer_null(out->w);
+        }
+        json_writer_end_object(out->w);
+        return;
+    }
+
+    char le[24];
+    uint64_t cumulative = 0;
+    for (int i = 0; i < bound_count; i++) {
+        cumulative += buckets[i];
+        snprintf(le, sizeof(le), "le=\"%lu\"", (unsigned long)bounds[i]);
+        metrics_text_series(out, name, "_bucket", label_key, label_value, le);
+        metrics_text_u64(out, cumulative);
+    }
+    metrics_text_series(out, name, "_bucket", label_key, label_value, "le=\"+Inf\"");
+    metrics_text_u64(out, count);
+    metrics_text_series(out, name, "_sum", label_key, label_value, NULL);
+    metrics_text_u64(out, sum);
+    metrics_text_series(out, name, "_count", label_key, label_value, NULL);
+    metrics_text_u64(out, count);
+}
+
+static void metrics_emit_metric(metrics_out_t *out, const metric_t *metric)
+{
+    const char *label_value = metric->label_key ? metric->label_value : NULL;
+    switch (metric->type) {
+        case METRIC_COUNTER:
+            metrics_emit_counter(out, metric->name, metric->help, metric->label_key, label_value,
+                                 __atomic_load_n(&metric->value, __ATOMIC_RELAXED));
+            break;
+        case METRIC_GAUGE:
+            metrics_emit_gauge(out, metric->name, metric->help, metric->label_key, label_value,
+                               (int32_t)__atomic_load_n(&metric->value, __ATOMIC_RELAXED));
+            break;
+        case METRIC_HISTOGRAM: {
+            uint32_t buckets[METRICS_MAX_BUCKETS + 1];
+            for (int i = 0; i <= metric->bound_count; i++) {
+                buckets[i] = __atomic_load_n(&metric->buckets[i], __ATOMIC_RELAXED);
+            }
+            metrics_emit_histogram(out, metric->name, metric->help, metric->label_key, label_value,
+                                   metric->bounds, metric->bound_count, buckets,
+                                   __atomic_load_n(&metric->sum, __ATOMIC_RELAXED));
+            break;
+        }
+    }
+}
+
+static esp_err_t metrics_write(json_writer_t *w, bool json)
+{
+    metrics_out_t out = {.w = w, .json = json};
+    uint32_t count = __atomic_load_n(&s_metric_count, __ATOMIC_ACQUIRE);
+    bool emitted[METRICS_MAX] = {0};
+
+    if (json) {
+        json_writer_begin_object(w);
+    }
+
+    // Registered series, each family kept together
+    for (uint32_t i = 0; i < count; i++) {
+        if (emitted[i]) {
+            continue;
+        }
+        for (uint32_t j = i; j < count; j++) {
+            if (!emitted[j] && strcmp(s_metrics[j].name, s_metrics[i].name) == 0) {
+                metrics_emit_metric(&out, &s_metrics[j]);
+                emitted[j] = true;
+            }
+        }
+    }
+
+    uint32_t collectors = __atomic_load_n(&s_collector_count, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < collectors; i++) {
+        s_collectors[i](&out);
+    }
+
+    if (json) {
+        if (out.family_open) {
+            json_writer_end_object(w);
+        }
+        json_writer_end_object(w);
+    }
+    return w->error;
+}
+
+esp_err_t metrics_write_text(json_writer_t *w)
+{
+    return metrics_write(w, false);
+}
+
+esp_err_t metrics_write_json(json_writer_t *w)
+{
+    return metrics_write(w, true);
+}
@@ -0,0 +1,85 @@
+// metrics.h - Registry of counters, gauges and fixed-bucket histograms
+// Modules register their metrics once (get-or-create by name and label) and
+// update them from their own tasks without locks. Values a module already
+// keeps elsewhere (Modbus statistics, heap) are published by a collector that
+// runs at scrape time instead of being copied into the registry.
+//
+// Exported as Prometheus text exposition format by /metrics and as a compact
+// JSON object (histograms reduced to count, sum, p50 and p99) in the device
+// twin's reported properties.
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "json_writer.h"
+
+#define METRICS_MAX 48                     // Registered series (name + label value)
+#define METRICS_MAX_BUCKETS 12             // Histogram bounds; one more bucket counts the rest
+#define METRICS_MAX_COLLECTORS 4
+#define METRICS_LABEL_SIZE 16
+
+typedef enum {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM
+} metric_type_t;
+
+typedef struct {
+    const char *name;                      // Family name, [a-z_], unit as suffix (_ms, _bytes, _total)
+    const char *help;
+    const char *label_key;                 // NULL when the family has no label
+    char label_value[METRICS_LABEL_SIZE];
+    metric_type_t type;
+    const uint32_t *bounds;                // Histogram: ascending upper bounds (inclusive)
+    uint8_t bound_count;
+
+    uint32_t value;                        // Counter, or gauge (as int32)
+    uint32_t buckets[METRICS_MAX_BUCKETS + 1];
+    uint64_t sum;
+} metric_t;
+
+// Shared histogram bounds, milliseconds
+extern const uint32_t metrics_latency_ms_bounds[10];
+#define METRICS_LATENCY_MS_BOUNDS metrics_latency_ms_bounds, 10
+
+// Registration: returns the existing series for the same name and label value.
+// NULL when the registry is full; updating a NULL metric does nothing.
+// name, help, label_key and bounds must stay valid (string literals, const tables).
+metric_t *metrics_counter(const char *name, const char *help, const char *label_key, const char *label_value);
+metric_t *metrics_gauge(const char *name, const char *help, const char *label_key, const char *label_value);
+metric_t *metrics_histogram(const char *name, const char *help, const char *label_key, const char *label_value,
+                            const uint32_t *bounds, int bound_count);
+
+// Updates, lock-free
+void metrics_inc(metric_t *metric, uint32_t n);
+void metrics_set(metric_t *metric, int32_t value);
+void metrics_observe(metric_t *metric, uint32_t value);
+
+// Free stack of the calling task, as task_stack_free_bytes{task="name"}.
+// Register the gauge once when the task starts; report from its loop.
+metric_t *metrics_task_stack_gauge(const char *task_name);
+void metrics_report_task_stack(metric_t *gauge);
+
+// Scrape-time output. Collectors emit whole families through these calls.
+typedef struct metrics_out metrics_out_t;
+typedef void (*metrics_collector_fn)(metrics_out_t *out);
+
+esp_err_t metrics_register_collector(metrics_collector_fn collector);
+
+void metrics_emit_counter(metrics_out_t *out, const char *name, const char *help,
+                          const char *label_key, const char *label_value, uint64_t value);
+void metrics_emit_gauge(metrics_out_t *out, const char *name, const char *help,
+                        const char *label_key, const char *label_value, int64_t value);
+// buckets: bound_count + 1 non-cumulative counts, the last one above every bound
+void metrics_emit_histogram(metrics_out_t *out, const char *name, const char *help,
+                            const char *label_key, const char *label_value,
+                            const uint32_t *bounds, int bound_count, const uint32_t *buckets, uint64_t sum);
+
+// Exports
+esp_err_t metrics_write_text(json_writer_t *w);
+esp_err_t metrics_write_json(json_writer_t *w);
+
+#endif // METRICS_H
@@ -1,13 +1,13 @@
 // modbus.c - Production-ready Modbus communication implementation
 
 #include "modbus.h"
-#include "driver/uart.h"
-#include "driver/gpio.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
-#include "freertos/queue.h"
+#include "modbus_frame.h"
+#include "modbus_crc.h"
+#include "modbus_port.h"
+#include "trace.h"
+#include "metrics.h"
 #include "esp_log.h"
-#include "esp_timer.h"
+#include <stdio.h>
 #include <string.h>
 #include <time.h>
 #include <math.h>
@@ -15,46 +15,157 @@
 static const char *TAG = "MODBUS";
 
 // Global Variables
-static uint16_t response_buffer[MODBUS_MAX_REGISTERS];
+static uint16_t response_buffer[MODBUS_MAX_REGISTERS];   // Legacy readers only, see modbus_get_response_buffer()
 static uint8_t response_length = 0;
-static QueueHandle_t uart_queue = NULL;
+static modbus_frame_t rx_frame;            // Response of the current transaction; one transaction at a time (bus task)
+#ifdef ESP_PLATFORM
+#define MODBUS_DEFAULT_PORT (&modbus_port_uart)
+#else
+#define MODBUS_DEFAULT_PORT NULL            // Host builds install their port with modbus_set_port()
+#endif
+static const modbus_port_t *port = MODBUS_DEFAULT_PORT;
 static modbus_stats_t stats = {0};
-
-// Global variable to track current baud rate
+static modbus_slave_stats_t slave_stats[MODBUS_STATS_MAX_SLAVES];
+static uint32_t slave_stats_sequence = 0;
+static metric_t *slave_rtt_metric[MODBUS_STATS_MAX_SLAVES];   // modbus_rtt_ms series of each entry
+static uint32_t timeout_override_ms = 0;
+static int64_t timeout_log_us = 0;           // Port time of the last timeout logged
+static uint32_t timeout_log_count = 0;        // stats.timeout_errors when it was logged
+static bool timeout_logged = false;
+
+// Current line settings
 static int current_baud_rate = 9600;
+static char current_parity = 'N';
+static uint8_t current_stop_bits = 1;
 
 // Flag to track if Modbus is already initialized
 static bool modbus_initialized = false;
 
-// Function to set baud rate dynamically
-esp_err_t modbus_set_baud_rate(int baud_rate)
+esp_err_t modbus_set_port(const modbus_port_t *new_port)
+{
+    if (modbus_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    port = new_port ? new_port : MODBUS_DEFAULT_PORT;
+    return ESP_OK;
+}
+
+const modbus_port_t *modbus_get_port(void)
+{
+    return port;
+}
+
+int64_t modbus_port_now_us(void)
 {
-    if (baud_rate == current_baud_rate) {
-        // Baud rate already set, no need to change
+    return port ? port->now_us() : 0;
+}
+
+// Apply baud rate, parity and stop bits. Fields left at zero keep their current
+// value, and nothing is touched when the line already matches.
+esp_err_t modbus_set_line_config(const modbus_line_config_t* line)
+{
+    if (!line) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int baud_rate = line->baud_rate > 0 ? line->baud_rate : current_baud_rate;
+    char parity = line->parity ? line->parity : current_parity;
+    uint8_t stop_bits = line->stop_bits ? line->stop_bits : current_stop_bits;
+
+    if (parity != 'N' && parity != 'E' && parity != 'O') {
+        ESP_LOGW(TAG, "[WARN] Unknown parity '%c', using none", parity);
+        parity = 'N';
+    }
+    if (stop_bits != 1 && stop_bits != 2) {
+        ESP_LOGW(TAG, "[WARN] Unsupported stop bits %d, using 1", stop_bits);
+        stop_bits = 1;
+    }
+
+    if (baud_rate == current_baud_rate && parity == current_parity && stop_bits == current_stop_bits) {
         return ESP_OK;
     }
-    
-    ESP_LOGI(TAG, "[BAUD] Changing baud rate from %d to %d bps", current_baud_rate, baud_rate);
-    
-    // Set the new baud rate
-    esp_err_t ret = uart_set_baudrate(RS485_UART_PORT, baud_rate);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "[ERROR] Failed to set baud rate: %s", esp_err_to_name(ret));
-        return ret;
+
+    ESP_LOGD(TAG, "[LINE] Changing line settings from %d %c%d to %d %c%d",
+             current_baud_rate, current_parity, current_stop_bits, baud_rate, parity, stop_bits);
+    if (!port) {
+        return ESP_ERR_INVALID_STATE;
     }
-    
-    current_baud_rate = baud_rate;
-    
+    int64_t start_us = port->now_us();
+
+    esp_err_t ret = ESP_OK;
+    if (baud_rate != current_baud_rate) {
+        ret = port->set_baud_rate(baud_rate);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "[ERROR] Failed to set baud rate: %s", esp_err_to_name(ret));
+            return ret;
+        }
+        current_baud_rate = baud_rate;
+    }
+    if (parity != current_parity) {
+        ret = port->set_parity(parity);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "[ERROR] Failed to set parity: %s", esp_err_to_name(ret));
+            return ret;
+        }
+        current_parity = parity;
+    }
+    if (stop_bits != current_stop_bits) {
+        ret = port->set_stop_bits(stop_bits);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "[ERROR] Failed to set stop bits: %s", esp_err_to_name(ret));
+            return ret;
+        }
+        current_stop_bits = stop_bits;
+    }
+
     // Small delay to allow UART to stabilize
-    vTaskDelay(pdMS_TO_TICKS(50));
-    
-    // Flush UART buffers after baud rate change
-    uart_flush(RS485_UART_PORT);
-    
-    ESP_LOGI(TAG, "[BAUD] Successfully changed baud rate to %d bps", baud_rate);
+    port->delay_ms(MODBUS_LINE_SETTLE_MS);
+
+    // Flush UART buffers after the change
+    port->flush_input();
+
+    stats.line_reconfigs++;
+    stats.line_reconfig_us += (uint64_t)(port->now_us() - start_us);
     return ESP_OK;
 }
 
+void modbus_get_line_config(modbus_line_config_t* line)
+{
+    if (line) {
+        line->baud_rate = current_baud_rate;
+        line->parity = current_parity;
+        line->stop_bits = current_stop_bits;
+    }
+}
+
+// Function to set baud rate dynamically (parity and stop bits unchanged)
+esp_err_t modbus_set_baud_rate(int baud_rate)
+{
+    modbus_line_config_t line = { .baud_rate = baud_rate };
+    return modbus_set_line_config(&line);
+}
+
+// Scrape-time export of the bus statistics
+static void modbus_metrics_collect(metrics_out_t *out)
+{
+    metrics_emit_counter(out, "modbus_requests_total", "Modbus requests sent", NULL, NULL, stats.total_requests);
+    metrics_emit_counter(out, "modbus_failures_total", "Modbus requests that failed", NULL, NULL,
+                         stats.failed_requests);
+    metrics_emit_counter(out, "modbus_timeouts_total", "Modbus requests without a complete response", NULL, NULL,
+                         stats.timeout_errors);
+    metrics_emit_counter(out, "modbus_crc_errors_total", "Modbus responses with a bad CRC", NULL, NULL,
+                         stats.crc_errors);
+
+    char label[4];
+    for (int i = 0; i < MODBUS_STATS_MAX_SLAVES; i++) {
+        if (slave_stats[i].slave_id != 0) {
+            snprintf(label, sizeof(label), "%u", slave_stats[i].slave_id);
+            metrics_emit_gauge(out, "modbus_timeout_ms", "Adaptive response timeout of the slave", "slave", label,
+                               slave_stats[i].timeout_ms);
+        }
+    }
+}
+
 // Initialize Modbus communication
 esp_err_t modbus_init(void)
 {
@@ -64,68 +175,25 @@ esp_err_t modbus_init(void)
         return ESP_OK;
     }
 
-    ESP_LOGI(TAG, "[CONFIG] Initializing Modbus RS485 Communication");
-    ESP_LOGI(TAG, "[LOC] Hardware Configuration:");
-    ESP_LOGI(TAG, "   * UART Port: UART%d", RS485_UART_PORT);
-    ESP_LOGI(TAG, "   * Default Baud Rate: %d bps", RS485_BAUD_RATE);
-    ESP_LOGI(TAG, "   * TX Pin: GPIO %d", TXD2);
-    ESP_LOGI(TAG, "   * RX Pin: GPIO %d", RXD2);
-    ESP_LOGI(TAG, "   * RTS Pin: GPIO %d", RS485_RTS_PIN);
-    ESP_LOGI(TAG, "   * Buffer Size: %d bytes", RS485_BUF_SIZE);
-
-    current_baud_rate = RS485_BAUD_RATE;
-    
-    uart_config_t uart_config = {
-        .baud_rate = RS485_BAUD_RATE,
-        .data_bits = UART_DATA_8_BITS,
-        .parity = UART_PARITY_DISABLE,
-        .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
-        .rx_flow_ctrl_thresh = 122,
-        .source_clk = UART_SCLK_DEFAULT,
-    };
-
-    ESP_LOGI(TAG, "[CONF]  Installing UART driver...");
-    esp_err_t ret = uart_driver_install(RS485_UART_PORT, RS485_BUF_SIZE * 2, RS485_BUF_SIZE * 2, 20, &uart_queue, 0);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "[ERROR] Failed to install UART driver: %s", esp_err_to_name(ret));
-        return ret;
+    if (!port) {
+        ESP_LOGE(TAG, "[ERROR] No Modbus port installed");
+        return ESP_ERR_INVALID_STATE;
     }
-    ESP_LOGI(TAG, "[OK] UART driver installed successfully");
+    ESP_LOGI(TAG, "[CONFIG] Initializing Modbus RS485 Communication (%s port)", port->name);
 
-    ESP_LOGI(TAG, "[CONF]  Configuring UART parameters...");
-    ret = uart_param_config(RS485_UART_PORT, &uart_config);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "[ERROR] Failed to configure UART parameters: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    ESP_LOGI(TAG, "[OK] UART parameters configured");
-
-    ESP_LOGI(TAG, "[CONF]  Setting UART pins...");
-    ret = uart_set_pin(RS485_UART_PORT, TXD2, RXD2, RS485_RTS_PIN, UART_PIN_NO_CHANGE);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "[ERROR] Failed to set UART pins: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    ESP_LOGI(TAG, "[OK] UART pins configured");
+    current_baud_rate = RS485_BAUD_RATE;
+    current_parity = 'N';
+    current_stop_bits = 1;
 
-    ESP_LOGI(TAG, "[CONF]  Setting RS485 half-duplex mode...");
-    ret = uart_set_mode(RS485_UART_PORT, UART_MODE_RS485_HALF_DUPLEX);
+    esp_err_t ret = port->open();
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "[ERROR] Failed to set RS485 mode: %s", esp_err_to_name(ret));
+        port->close();  // Release whatever was set up, so a later init can retry
         return ret;
     }
-    ESP_LOGI(TAG, "[OK] RS485 half-duplex mode enabled");
-    
     ESP_LOGI(TAG, "[DONE] Modbus RS485 initialization complete!");
-    ESP_LOGI(TAG, "[INFO] Connection Guide:");
-    ESP_LOGI(TAG, "   * Connect RS485 A+ to GPIO %d", TXD2);
-    ESP_LOGI(TAG, "   * Connect RS485 B- to GPIO %d", RXD2);
-    ESP_LOGI(TAG, "   * Connect RTS to GPIO %d", RS485_RTS_PIN);
-    ESP_LOGI(TAG, "   * Ensure common ground connection");
-    ESP_LOGI(TAG, "   * Check device baud rate matches %d bps", RS485_BAUD_RATE);
 
     modbus_reset_statistics();
+    metrics_register_collector(modbus_metrics_collect);
 
     // Mark as initialized
     modbus_initialized = true;
@@ -136,9 +204,8 @@ esp_err_t modbus_init(void)
 // Deinitialize Modbus communication
 void modbus_deinit(void)
 {
-    if (uart_queue != NULL) {
-        uart_driver_delete(RS485_UART_PORT);
-        uart_queue = NULL;
+    if (modbus_initialized) {
+        port->close();
     }
 
     // Mark as deinitialized
@@ -150,18 +217,7 @@ void modbus_deinit(void)
 // Calculate Modbus CRC16
 uint16_t modbus_calculate_crc(const uint8_t* data, size_t length)
 {
-    uint16_t crc = 0xFFFF;
-    for (size_t i = 0; i < length; i++) {
-        crc ^= data[i];
-        for (int j = 0; j < 8; j++) {
-            if (crc & 0x0001) {
-                crc = (crc >> 1) ^ 0xA001;
-            } else {
-                crc >>= 1;
-            }
-        }
-    }
-    return crc;
+    return modbus_crc_update(MODBUS_CRC_INIT, data, length);
 }
 
 // Verify CRC in received data
@@ -180,210 +236,497 @@ bool modbus_verify_crc(const uint8_t* data, size_t length)
     return calculated_crc == received_crc;
 }
 
-// Generic Modbus request function
-static modbus_result_t modbus_send_request(uint8_t slave_id, uint8_t function_code, 
-                                         uint16_t start_addr, uint16_t data, 
-                                         uint8_t* response_data, size_t max_response_length)
+// Wait for a response frame, returning as soon as the assembler has a complete ADU.
+// The port reports the RTU inter-frame gap once the line goes idle, which ends
+// frames whose length the assembler could not know in advance.
+static modbus_frame_status_t modbus_receive_frame(modbus_frame_t *frame, uint32_t timeout_ms)
 {
-    uint8_t request[8];
-    uint8_t response[MODBUS_MAX_BUFFER_SIZE];
-    
+    int64_t deadline_us = port->now_us() + (int64_t)timeout_ms * 1000;
+
+    if (!modbus_initialized) {
+        return MODBUS_FRAME_INCOMPLETE;
+    }
+
+    while (1) {
+        int64_t remaining_us = deadline_us - port->now_us();
+        if (remaining_us <= 0) {
+            return MODBUS_FRAME_INCOMPLETE;
+        }
+
+        // Bytes go straight from the UART ring into the frame
+        size_t space = 0;
+        uint8_t *tail = modbus_frame_tail(frame, &space);
+        if (!tail) {
+            return MODBUS_FRAME_OVERFLOW;
+        }
+
+        bool gap = false;
+        int n = port->read(tail, space, remaining_us, &gap);
+        if (n == MODBUS_PORT_OVERFLOW) {
+            ESP_LOGW(TAG, "[WARN] UART RX overflow while waiting for response");
+            return MODBUS_FRAME_OVERFLOW;
+        }
+        if (n > 0) {
+            modbus_frame_status_t status = modbus_frame_commit(frame, (size_t)n);
+            if (status != MODBUS_FRAME_INCOMPLETE) {
+                return status;
+            }
+        }
+        if (gap && frame->length > 0) {
+            modbus_frame_status_t status = modbus_frame_end_of_gap(frame);
+            if (status != MODBUS_FRAME_INCOMPLETE) {
+                return status;
+            }
+        }
+    }
+}
+
+// Upper bound of a turnaround histogram bucket in ms (0 for the open-ended last bucket)
+uint32_t modbus_rtt_bucket_limit_ms(int bucket)
+{
+    if (bucket < 0 || bucket >= MODBUS_RTT_BUCKETS - 1) {
+        return 0;
+    }
+    return 1u << bucket;
+}
+
+static int modbus_rtt_bucket(uint32_t rtt_ms)
+{
+    int bucket = 0;
+    while (bucket < MODBUS_RTT_BUCKETS - 1 && rtt_ms >= (1u << bucket)) {
+        bucket++;
+    }
+    return bucket;
+}
+
+// 99th percentile turnaround, rounded up to the bucket limit
+uint32_t modbus_slave_rtt_p99_ms(const modbus_slave_stats_t* slave)
+{
+    if (!slave || slave->rtt_samples == 0) {
+        return 0;
+    }
+
+    uint32_t target = slave->rtt_samples - slave->rtt_samples / 100;
+    uint32_t seen = 0;
+    for (int b = 0; b < MODBUS_RTT_BUCKETS - 1; b++) {
+        seen += slave->rtt_histogram[b];
+        if (seen >= target) {
+            return modbus_rtt_bucket_limit_ms(b);
+        }
+    }
+    return slave->rtt_max_ms;
+}
+
+// Find the entry for a slave, taking over the least recently used one if needed.
+// Slaves that never answered (scan probes, dead devices) are evicted first.
+static modbus_slave_stats_t *modbus_slave_entry(uint8_t slave_id)
+{
+    static modbus_slave_stats_t broadcast_entry;
+    modbus_slave_stats_t *victim = NULL;
+
+    if (slave_id == 0 || timeout_override_ms > 0) {
+        // Broadcasts get no reply, and probes with a forced timeout (bus scans,
+        // possibly at the wrong line settings) would skew the slave's history
+        memset(&broadcast_entry, 0, sizeof(broadcast_entry));
+        return &broadcast_entry;
+    }
+
+    for (int i = 0; i < MODBUS_STATS_MAX_SLAVES; i++) {
+        modbus_slave_stats_t *entry = &slave_stats[i];
+        if (entry->slave_id == slave_id) {
+            entry->last_used = ++slave_stats_sequence;
+            return entry;
+        }
+        if (entry->slave_id == 0) {
+            if (!victim || victim->slave_id != 0) {
+                victim = entry;
+            }
+            continue;
+        }
+        if (victim && victim->slave_id == 0) {
+            continue;
+        }
+
+        bool entry_silent = (entry->responses == 0);
+        bool victim_silent = victim && (victim->responses == 0);
+        if (!victim || (entry_silent && !victim_silent) ||
+            (entry_silent == victim_silent && entry->last_used < victim->last_used)) {
+            victim = entry;
+        }
+    }
+
+    if (victim->slave_id == 0) {
+        stats.tracked_slaves++;
+    }
+    memset(victim, 0, sizeof(modbus_slave_stats_t));
+    victim->slave_id = slave_id;
+    victim->last_used = ++slave_stats_sequence;
+    slave_rtt_metric[victim - slave_stats] = NULL;     // Registered on the first response
+    return victim;
+}
+
+// Transfer time of a frame on the wire, 11 bits per character covers parity and 2 stop bits
+static uint32_t modbus_frame_time_ms(uint16_t bytes)
+{
+    int baud = current_baud_rate > 0 ? current_baud_rate : RS485_BAUD_RATE;
+    return (uint32_t)(((uint64_t)bytes * 11 * 1000 + baud - 1) / baud);
+}
+
+// Response timeout for the next request to this slave
+static uint32_t modbus_slave_timeout_ms(modbus_slave_stats_t *slave, uint16_t expected_length)
+{
+    uint32_t timeout_ms = MODBUS_RESPONSE_TIMEOUT_MS;
+
+    if (timeout_override_ms > 0) {
+        slave->timeout_ms = timeout_override_ms;
+        return timeout_override_ms;
+    }
+
+    bool probe = slave->consecutive_timeouts > 0 &&
+                 (slave->consecutive_timeouts % MODBUS_TIMEOUT_PROBE_EVERY) == 0;
+    if (slave->rtt_samples >= MODBUS_TIMEOUT_MIN_SAMPLES && !probe) {
+        uint32_t p99_ms = modbus_slave_rtt_p99_ms(slave);
+        timeout_ms = p99_ms * MODBUS_TIMEOUT_P99_FACTOR + modbus_frame_time_ms(expected_length);
+        if (timeout_ms < MODBUS_TIMEOUT_MIN_MS) {
+            timeout_ms = MODBUS_TIMEOUT_MIN_MS;
+        } else if (timeout_ms > MODBUS_RESPONSE_TIMEOUT_MS) {
+            timeout_ms = MODBUS_RESPONSE_TIMEOUT_MS;
+        }
+    }
+
+    slave->timeout_ms = timeout_ms;
+    return timeout_ms;
+}
+
+// Record a complete response frame; the turnaround is the wait minus the frame's own transfer time
+static void modbus_slave_record_response(modbus_slave_stats_t *slave, int64_t wait_us, uint16_t frame_length)
+{
+    int64_t rtt_us = wait_us - (int64_t)modbus_frame_time_ms(frame_length) * 1000;
+    if (rtt_us < 0) {
+        rtt_us = 0;
+    }
+    uint32_t rtt_ms = (uint32_t)(rtt_us / 1000);
+
+    slave->responses++;
+    slave->consecutive_timeouts = 0;
+    if (slave >= slave_stats && slave < slave_stats + MODBUS_STATS_MAX_SLAVES) {
+        // Only slaves that answer get a series: series are never unregistered, and
+        // IDs probed from the explorer or dead devices would fill the registry.
+        // An evicted slave's series stays registered and simply stops moving.
+        metric_t **metric = &slave_rtt_metric[slave - slave_stats];
+        if (!*metric) {
+            char label[4];
+            snprintf(label, sizeof(label), "%u", slave->slave_id);
+            *metric = metrics_histogram("modbus_rtt_ms", "Modbus slave turnaround time", "slave", label,
+                                        METRICS_LATENCY_MS_BOUNDS);
+        }
+        metrics_observe(*metric, rtt_ms);
+    }
+
+    if (slave->rtt_samples == 0) {
+        slave->rtt_ewma_us = (uint32_t)rtt_us;
+    } else {
+        int32_t delta = (int32_t)rtt_us - (int32_t)slave->rtt_ewma_us;
+        slave->rtt_ewma_us = (uint32_t)((int32_t)slave->rtt_ewma_us + delta / (1 << MODBUS_RTT_EWMA_SHIFT));
+    }
+    if (rtt_ms > slave->rtt_max_ms) {
+        slave->rtt_max_ms = rtt_ms;
+    }
+
+    if (slave->rtt_samples >= MODBUS_RTT_HISTORY_MAX) {
+        slave->rtt_samples = 0;
+        for (int b = 0; b < MODBUS_RTT_BUCKETS; b++) {
+            slave->rtt_histogram[b] /= 2;
+            slave->rtt_samples += slave->rtt_histogram[b];
+        }
+    }
+    slave->rtt_histogram[modbus_rtt_bucket(rtt_ms)]++;
+    slave->rtt_samples++;
+}
+
+// A dead slave times out on every poll; log it at most once per interval and
+// leave the individual timeouts to the trace (see modbus_transact())
+static void modbus_log_timeout(uint8_t slave_id, int received, int expected, uint32_t timeout_ms)
+{
+    int64_t now_us = port->now_us();
+    if (timeout_logged && now_us - timeout_log_us < (int64_t)MODBUS_TIMEOUT_LOG_INTERVAL_MS * 1000) {
+        return;
+    }
+    unsigned long count = (unsigned long)(stats.timeout_errors - timeout_log_count);
+    if (received == 0) {
+        ESP_LOGE(TAG, "[ERROR] No response from slave %d (timeout after %lu ms, %lu timeout(s) since last report)"
+                 " - check RS485 wiring (A+, B-, GND), slave ID, baud rate (%d bps) and power",
+                 slave_id, (unsigned long)timeout_ms, count, current_baud_rate);
+    } else {
+        ESP_LOGE(TAG, "[ERROR] Incomplete response from slave %d: %d of %d bytes (%lu timeout(s) since last report)",
+                 slave_id, received, expected, count);
+    }
+    timeout_logged = true;
+    timeout_log_us = now_us;
+    timeout_log_count = stats.timeout_errors;
+}
+
+// Send a request frame and validate the response (CRC, exception, header).
+// On success the response ADU is in rx_frame until the next transaction.
+static modbus_result_t modbus_exchange(const uint8_t *request, size_t request_length,
+                                       uint16_t quantity, modbus_txn_info_t *info)
+{
+    uint8_t slave_id = request[0];
+    uint8_t function_code = request[1];
+    modbus_frame_t *frame = &rx_frame;
+
     stats.total_requests++;
-    
-    // Build request frame
-    request[0] = slave_id;
-    request[1] = function_code;
-    request[2] = (start_addr >> 8) & 0xFF;
-    request[3] = start_addr & 0xFF;
-    request[4] = (data >> 8) & 0xFF;
-    request[5] = data & 0xFF;
-    
-    uint16_t crc = modbus_calculate_crc(request, 6);
-    request[6] = crc & 0xFF;
-    request[7] = (crc >> 8) & 0xFF;
-    
-    // Clear receive buffer and log request details
-    uart_flush_input(RS485_UART_PORT);
-    
-    ESP_LOGI(TAG, "[SEND] Sending Modbus request to Slave %d: [%02X %02X %02X %02X %02X %02X %02X %02X]",
-             slave_id, request[0], request[1], request[2], request[3], 
-             request[4], request[5], request[6], request[7]);
-    
+    if (!port) {
+        stats.failed_requests++;
+        stats.last_error_code = MODBUS_INVALID_RESPONSE;
+        return MODBUS_INVALID_RESPONSE;
+    }
+
+    // Clear receive buffer and any stale driver events from a previous transaction
+    port->flush_input();
+
     // Send request
-    int bytes_written = uart_write_bytes(RS485_UART_PORT, request, 8);
-    if (bytes_written != 8) {
-        ESP_LOGE(TAG, "[ERROR] Failed to send Modbus request - only %d bytes written", bytes_written);
+    int64_t tx_start_us = port->now_us();
+    int bytes_written = port->write(request, request_length);
+    if (bytes_written != (int)request_length) {
+        ESP_LOGE(TAG, "[ERROR] Failed to send Modbus request - only %d/%d bytes written",
+                 bytes_written, (int)request_length);
         stats.failed_requests++;
         stats.last_error_code = MODBUS_INVALID_RESPONSE;
         return MODBUS_INVALID_RESPONSE;
     }
-    
-    ESP_LOGI(TAG, "[OK] Modbus request sent successfully (%d bytes)", bytes_written);
-    
+
     // Wait for transmission complete
-    uart_wait_tx_done(RS485_UART_PORT, pdMS_TO_TICKS(100));
-    
-    ESP_LOGI(TAG, "[WAIT] Waiting for response (timeout: %d ms)...", MODBUS_RESPONSE_TIMEOUT_MS);
-    
-    // Clear response buffer for safety
-    memset(response, 0, sizeof(response));
-    
-    // Read response with bounds checking
-    int response_length = uart_read_bytes(RS485_UART_PORT, response, sizeof(response), 
-                                        pdMS_TO_TICKS(MODBUS_RESPONSE_TIMEOUT_MS));
-    
-    ESP_LOGI(TAG, "[RECV] Received %d bytes from RS485", response_length);
-    
-    if (response_length > 0) {
-        // Log received bytes for debugging
-        ESP_LOGI(TAG, "[INFO] Raw response data:");
-        for (int i = 0; i < response_length && i < 16; i++) {
-            printf("%02X ", response[i]);
-        }
-        printf("\n");
+    port->wait_tx_done(100);
+    stats.tx_us += (uint64_t)(port->now_us() - tx_start_us);
+
+    modbus_slave_stats_t *slave = modbus_slave_entry(slave_id);
+    slave->requests++;
+    uint32_t timeout_ms = modbus_slave_timeout_ms(slave, modbus_frame_expected_length(function_code, quantity));
+
+    int64_t wait_start_us = port->now_us();
+    modbus_frame_init(frame, slave_id, function_code, quantity);
+    modbus_frame_status_t frame_status = modbus_receive_frame(frame, timeout_ms);
+    int64_t wait_us = port->now_us() - wait_start_us;
+    stats.wait_us += (uint64_t)wait_us;
+    int response_length = frame->length;
+
+    info->frame_length = frame->length;
+    info->wait_us = (uint32_t)wait_us;
+    info->timeout_ms = timeout_ms;
+
+    if (frame_status == MODBUS_FRAME_COMPLETE) {
+        modbus_slave_record_response(slave, wait_us, frame->length);
     }
-    
-    if (response_length < 5) {
-        if (response_length == 0) {
-            ESP_LOGE(TAG, "[ERROR] No response from Modbus device (timeout)");
-            ESP_LOGE(TAG, "[CONFIG] Troubleshooting:");
-            ESP_LOGE(TAG, "   * Check RS485 wiring (A+, B-, GND)");
-            ESP_LOGE(TAG, "   * Verify slave ID (%d) is correct", slave_id);
-            ESP_LOGE(TAG, "   * Check baud rate (%d bps)", RS485_BAUD_RATE);
-            ESP_LOGE(TAG, "   * Ensure device is powered and connected");
-        } else {
-            ESP_LOGE(TAG, "[ERROR] Invalid response length: %d bytes (minimum 5 required)", response_length);
-        }
+
+    trace_bytes(frame->data, (size_t)response_length);
+
+    if (frame_status == MODBUS_FRAME_OVERFLOW) {
+        ESP_LOGE(TAG, "[ERROR] Response frame overflow (%d bytes)", response_length);
+        stats.failed_requests++;
+        stats.last_error_code = MODBUS_INVALID_RESPONSE;
+        return MODBUS_INVALID_RESPONSE;
+    }
+
+    if (frame_status != MODBUS_FRAME_COMPLETE) {
+        slave->timeouts++;
+        slave->consecutive_timeouts++;
         stats.failed_requests++;
         stats.timeout_errors++;
         stats.last_error_code = MODBUS_TIMEOUT;
+        modbus_log_timeout(slave_id, response_length, frame->expected_length, timeout_ms);
         return MODBUS_TIMEOUT;
     }
-    
-    // Verify CRC
-    if (!modbus_verify_crc(response, response_length)) {
+
+    if (frame->discarded > 0) {
+        ESP_LOGW(TAG, "[WARN] Ignored %d trailing bytes after response frame", frame->discarded);
+    }
+
+    // Verify CRC (folded in by the assembler as bytes arrived; rescan only to log the mismatch)
+    if (!modbus_frame_crc_ok(frame) && !modbus_verify_crc(frame->data, response_length)) {
         ESP_LOGE(TAG, "[ERROR] CRC verification failed");
         stats.failed_requests++;
         stats.crc_errors++;
         stats.last_error_code = MODBUS_INVALID_CRC;
         return MODBUS_INVALID_CRC;
     }
-    
+
     // Check for exception response
-    if (response[1] & 0x80) {
-        uint8_t exception_code = response[2];
+    if (modbus_frame_is_exception(frame)) {
+        uint8_t exception_code = frame->data[2];
         ESP_LOGE(TAG, "[ERROR] Modbus exception: 0x%02X", exception_code);
         stats.failed_requests++;
         stats.last_error_code = exception_code;
         return (modbus_result_t)exception_code;
     }
-    
+
     // Verify response header
-    if (response[0] != slave_id || response[1] != function_code) {
-        ESP_LOGE(TAG, "[ERROR] Invalid response header (slave: %d vs %d, func: %d vs %d)", 
-                 response[0], slave_id, response[1], function_code);
+    if (frame->data[0] != slave_id || frame->data[1] != function_code) {
+        ESP_LOGE(TAG, "[ERROR] Invalid response header (slave: %d vs %d, func: %d vs %d)",
+                 frame->data[0], slave_id, frame->data[1], function_code);
         stats.failed_requests++;
         stats.last_error_code = MODBUS_INVALID_RESPONSE;
         return MODBUS_INVALID_RESPONSE;
     }
-    
-    // Copy response data
-    if (response_data && max_response_length > 0) {
-        size_t copy_length = (response_length < max_response_length) ? response_length : max_response_length;
-        memcpy(response_data, response, copy_length);
-    }
-    
+
     stats.successful_requests++;
-    ESP_LOGI(TAG, "[OK] Modbus request successful");
     return MODBUS_SUCCESS;
 }
 
-// Read Holding Registers
-modbus_result_t modbus_read_holding_registers(uint8_t slave_id, uint16_t start_addr, uint16_t num_regs)
+// The exchange counted a success, but the caller found the payload unusable
+static modbus_result_t modbus_reject_response(void)
 {
-    uint8_t response[MODBUS_MAX_BUFFER_SIZE];
-    
-    ESP_LOGI(TAG, "[READ] Reading %d holding registers from slave %d, starting at 0x%04X", 
-             num_regs, slave_id, start_addr);
-    
-    modbus_result_t result = modbus_send_request(slave_id, MODBUS_READ_HOLDING_REGISTERS,
-                                               start_addr, num_regs, response, sizeof(response));
-
-    if (result == MODBUS_SUCCESS) {
-        uint8_t byte_count = response[2];
-
-        // Bounds check: Validate byte_count to prevent buffer overflow from malformed response
-        if (byte_count > MODBUS_MAX_REGISTERS * 2) {
-            ESP_LOGE(TAG, "[ERROR] Response byte_count too large: %d bytes (max %d)", byte_count, MODBUS_MAX_REGISTERS * 2);
-            return MODBUS_ERROR_INVALID_RESPONSE;
-        }
-
-        int num_registers = byte_count / 2;
+    stats.successful_requests--;
+    stats.failed_requests++;
+    stats.last_error_code = MODBUS_INVALID_RESPONSE;
+    return MODBUS_INVALID_RESPONSE;
+}
 
-        // Extract register values into response buffer
-        for (int i = 0; i < num_registers && i < MODBUS_MAX_REGISTERS; i++) {
-            response_buffer[i] = (response[3 + i*2] << 8) | response[4 + i*2];
-        }
+// One transaction, traced
+static modbus_result_t modbus_transact(const uint8_t *request, size_t request_length,
+                                       uint16_t quantity, modbus_txn_info_t *info)
+{
+    modbus_txn_info_t local_info;
+    if (!info) {
+        info = &local_info;
+    }
+    memset(info, 0, sizeof(*info));
 
-        response_length = num_registers;
+    uint16_t slave_fc = TRACE_SLAVE_FC(request[0], request[1]);
+    TRACE_INFO(TRACE_EV_MODBUS_REQUEST, slave_fc,
+               ((uint32_t)request[2] << 24) | ((uint32_t)request[3] << 16) | ((uint32_t)request[4] << 8) | request[5]);
 
-        ESP_LOGI(TAG, "[OK] Successfully read %d registers", num_registers);
-        
-        // Log register values for debugging
-        for (int i = 0; i < num_registers; i++) {
-            ESP_LOGI(TAG, "[DATA] Register[%d]: 0x%04X (%d)", i, response_buffer[i], response_buffer[i]);
-        }
+    modbus_result_t result = modbus_exchange(request, request_length, quantity, info);
+    if (result == MODBUS_SUCCESS) {
+        TRACE_INFO(TRACE_EV_MODBUS_RESPONSE, slave_fc, info->wait_us);
+    } else if (result == MODBUS_TIMEOUT) {
+        TRACE_INFO(TRACE_EV_MODBUS_TIMEOUT, slave_fc, info->timeout_ms);
+    } else {
+        TRACE_INFO(TRACE_EV_MODBUS_ERROR, slave_fc, result);
     }
-    
     return result;
 }
 
-// Read Input Registers
-modbus_result_t modbus_read_input_registers(uint8_t slave_id, uint16_t start_addr, uint16_t num_regs)
+// Generic Modbus request function (fixed 8-byte request frames)
+static modbus_result_t modbus_send_request(uint8_t slave_id, uint8_t function_code, 
+                                         uint16_t start_addr, uint16_t data, modbus_txn_info_t *info)
 {
-    uint8_t response[MODBUS_MAX_BUFFER_SIZE];
+    uint8_t request[8];
+    int64_t encode_start_us = port ? port->now_us() : 0;
+    
+    // Build request frame
+    request[0] = slave_id;
+    request[1] = function_code;
+    request[2] = (start_addr >> 8) & 0xFF;
+    request[3] = start_addr & 0xFF;
+    request[4] = (data >> 8) & 0xFF;
+    request[5] = data & 0xFF;
     
-    ESP_LOGI(TAG, "[READ] Reading %d input registers from slave %d, starting at 0x%04X", 
-             num_regs, slave_id, start_addr);
+    uint16_t crc = modbus_calculate_crc(request, 6);
+    request[6] = crc & 0xFF;
+    request[7] = (crc >> 8) & 0xFF;
+    if (port) {
+        stats.encode_us += (uint64_t)(port->now_us() - encode_start_us);
+    }
     
-    modbus_result_t result = modbus_send_request(slave_id, MODBUS_READ_INPUT_REGISTERS,
-                                               start_addr, num_regs, response, sizeof(response));
+    return modbus_transact(request, sizeof(request), data, info);
+}
 
-    if (result == MODBUS_SUCCESS) {
-        uint8_t byte_count = response[2];
+// Read holding (0x03) or input (0x04) registers, decoding the response frame
+// straight into out. out needs room for quantity registers; a slave answering
+// with more is truncated to quantity. info may be NULL.
+modbus_result_t modbus_read_registers(uint8_t slave_id, uint8_t function_code, uint16_t start_addr,
+                                      uint16_t quantity, uint16_t *out, modbus_txn_info_t *info)
+{
+    if (info) {
+        memset(info, 0, sizeof(*info));
+    }
+    if ((function_code != MODBUS_READ_HOLDING_REGISTERS && function_code != MODBUS_READ_INPUT_REGISTERS) ||
+        quantity == 0 || quantity > MODBUS_MAX_REGISTERS) {
+        ESP_LOGE(TAG, "[ERROR] Invalid read request: func 0x%02X, %d registers", function_code, quantity);
+        return MODBUS_ILLEGAL_DATA_VALUE;
+    }
 
-        // Bounds check: Validate byte_count to prevent buffer overflow from malformed response
-        if (byte_count > MODBUS_MAX_REGISTERS * 2) {
-            ESP_LOGE(TAG, "[ERROR] Response byte_count too large: %d bytes (max %d)", byte_count, MODBUS_MAX_REGISTERS * 2);
-            return MODBUS_ERROR_INVALID_RESPONSE;
-        }
+    modbus_result_t result = modbus_send_request(slave_id, function_code, start_addr, quantity, info);
+    if (result != MODBUS_SUCCESS) {
+        return result;
+    }
 
-        int num_registers = byte_count / 2;
+    uint8_t byte_count = rx_frame.data[2];
 
-        // Extract register values into response buffer
-        for (int i = 0; i < num_registers && i < MODBUS_MAX_REGISTERS; i++) {
-            response_buffer[i] = (response[3 + i*2] << 8) | response[4 + i*2];
-        }
+    // Bounds check: Validate byte_count to prevent buffer overflow from malformed response
+    if (byte_count > MODBUS_MAX_REGISTERS * 2) {
+        ESP_LOGE(TAG, "[ERROR] Response byte_count too large: %d bytes (max %d)", byte_count, MODBUS_MAX_REGISTERS * 2);
+        return modbus_reject_response();
+    }
 
-        response_length = num_registers;
-        ESP_LOGI(TAG, "[OK] Successfully read %d input registers", num_registers);
-        
-        // Log register values for debugging
-        for (int i = 0; i < num_registers; i++) {
-            ESP_LOGI(TAG, "[DATA] Register[%d]: 0x%04X (%d)", i, response_buffer[i], response_buffer[i]);
+    uint16_t count = byte_count / 2;
+    if (count > quantity) {
+        count = quantity;
+    }
+    if (out) {
+        const uint8_t *data = &rx_frame.data[3];
+        for (uint16_t i = 0; i < count; i++) {
+            out[i] = (uint16_t)((data[i * 2] << 8) | data[i * 2 + 1]);
         }
     }
-    
+    if (info) {
+        info->register_count = count;
+    }
+
+    for (uint16_t i = 0; out && i < count; i++) {
+        TRACE_DEBUG(TRACE_EV_MODBUS_REGISTER, i, out[i]);
+    }
+    return MODBUS_SUCCESS;
+}
+
+// Legacy readers: the registers land in the global response buffer
+static modbus_result_t modbus_read_to_response_buffer(uint8_t slave_id, uint8_t function_code,
+                                                      uint16_t start_addr, uint16_t num_regs)
+{
+    modbus_txn_info_t info;
+    modbus_result_t result = modbus_read_registers(slave_id, function_code, start_addr, num_regs,
+                                                   response_buffer, &info);
+    if (result == MODBUS_SUCCESS) {
+        response_length = (uint8_t)info.register_count;
+    }
     return result;
 }
 
+// Read Holding Registers
+modbus_result_t modbus_read_holding_registers(uint8_t slave_id, uint16_t start_addr, uint16_t num_regs)
+{
+    return modbus_read_to_response_buffer(slave_id, MODBUS_READ_HOLDING_REGISTERS, start_addr, num_regs);
+}
+
+// Read Input Registers
+modbus_result_t modbus_read_input_registers(uint8_t slave_id, uint16_t start_addr, uint16_t num_regs)
+{
+    return modbus_read_to_response_buffer(slave_id, MODBUS_READ_INPUT_REGISTERS, start_addr, num_regs);
+}
+
 // Write Single Register
 modbus_result_t modbus_write_single_register(uint8_t slave_id, uint16_t addr, uint16_t value)
 {
-    ESP_LOGI(TAG, "Writing value 0x%04X to register 0x%04X on slave %d", value, addr, slave_id);
+    ESP_LOGD(TAG, "Writing value 0x%04X to register 0x%04X on slave %d", value, addr, slave_id);
+    
+    modbus_result_t result = modbus_send_request(slave_id, MODBUS_WRITE_SINGLE_REGISTER, addr, value, NULL);
+    if (result != MODBUS_SUCCESS) {
+        return result;
+    }
     
-    uint8_t response[MODBUS_MAX_BUFFER_SIZE];
-    return modbus_send_request(slave_id, MODBUS_WRITE_SINGLE_REGISTER, addr, value, response, sizeof(response));
+    // The slave echoes the request; anything else means the write did not land as sent
+    const uint8_t *response = rx_frame.data;
+    uint16_t resp_addr = (response[2] << 8) | response[3];
+    uint16_t resp_value = (response[4] << 8) | response[5];
+    
+    if (resp_addr != addr || resp_value != value) {
+        ESP_LOGE(TAG, "[ERROR] Response data mismatch - Addr: %d (expected %d), Value: 0x%04X (expected 0x%04X)",
+                 resp_addr, addr, resp_value, value);
+        return modbus_reject_response();
+    }
+    
+    return MODBUS_SUCCESS;
 }
 
 // Write Multiple Registers
@@ -395,13 +738,12 @@ modbus_result_t modbus_write_multiple_registers(uint8_t slave_id, uint16_t start
         return MODBUS_ILLEGAL_DATA_VALUE;
     }
     
-    ESP_LOGI(TAG, "Writing %d registers starting at 0x%04X on slave %d", num_regs, start_addr, slave_id);
+    ESP_LOGD(TAG, "Writing %d registers starting at 0x%04X on slave %d", num_regs, start_addr, slave_id);
     
     // Calculate request length: 1(slave) + 1(func) + 2(addr) + 2(qty) + 1(bytes) + (qty*2)(data) + 2(crc)
     uint8_t byte_count = num_regs * 2;
     uint16_t request_length = 7 + byte_count + 2;
     uint8_t request[MODBUS_MAX_BUFFER_SIZE];
-    uint8_t response[MODBUS_MAX_BUFFER_SIZE];
     
     if (request_length > MODBUS_MAX_BUFFER_SIZE) {
         ESP_LOGE(TAG, "[ERROR] Request too large: %d bytes", request_length);
@@ -409,8 +751,6 @@ modbus_result_t modbus_write_multiple_registers(uint8_t slave_id, uint16_t start
         return MODBUS_ILLEGAL_DATA_VALUE;
     }
     
-    stats.total_requests++;
-    
     // Build request frame
     request[0] = slave_id;
     request[1] = MODBUS_WRITE_MULTIPLE_REGISTERS;
@@ -424,7 +764,7 @@ modbus_result_t modbus_write_multiple_registers(uint8_t slave_id, uint16_t start
     for (int i = 0; i < num_regs; i++) {
         request[7 + (i * 2)] = (values[i] >> 8) & 0xFF;
         request[8 + (i * 2)] = values[i] & 0xFF;
-        ESP_LOGI(TAG, "Register[%d]: 0x%04X (%d)", i, values[i], values[i]);
+        TRACE_DEBUG(TRACE_EV_MODBUS_REGISTER, i, values[i]);
     }
     
     // Calculate and add CRC
@@ -432,99 +772,23 @@ modbus_result_t modbus_write_multiple_registers(uint8_t slave_id, uint16_t start
     request[request_length - 2] = crc & 0xFF;
     request[request_length - 1] = (crc >> 8) & 0xFF;
     
-    // Clear receive buffer and log request
-    uart_flush_input(RS485_UART_PORT);
-    
-    ESP_LOGI(TAG, "[SEND] Sending %d-byte write multiple request to Slave %d", request_length, slave_id);
-    
-    // Send request
-    int bytes_written = uart_write_bytes(RS485_UART_PORT, request, request_length);
-    if (bytes_written != request_length) {
-        ESP_LOGE(TAG, "[ERROR] Failed to send request - only %d/%d bytes written", bytes_written, request_length);
-        stats.failed_requests++;
-        stats.last_error_code = MODBUS_INVALID_RESPONSE;
-        return MODBUS_INVALID_RESPONSE;
-    }
-    
-    ESP_LOGI(TAG, "[OK] Write multiple request sent successfully (%d bytes)", bytes_written);
-    
-    // Wait for transmission complete
-    uart_wait_tx_done(RS485_UART_PORT, pdMS_TO_TICKS(100));
-    
-    ESP_LOGI(TAG, "[WAIT] Waiting for response (timeout: %d ms)...", MODBUS_RESPONSE_TIMEOUT_MS);
-    
-    // Clear response buffer for safety
-    memset(response, 0, sizeof(response));
-    
-    // Read response with bounds checking
-    int response_length = uart_read_bytes(RS485_UART_PORT, response, sizeof(response), 
-                                        pdMS_TO_TICKS(MODBUS_RESPONSE_TIMEOUT_MS));
-    
-    ESP_LOGI(TAG, "[RECV] Received %d bytes from RS485", response_length);
-    
-    if (response_length <= 0) {
-        ESP_LOGE(TAG, "[ERROR] No response received (timeout)");
-        stats.timeout_errors++;
-        stats.failed_requests++;
-        stats.last_error_code = MODBUS_TIMEOUT;
-        return MODBUS_TIMEOUT;
-    }
-    
-    // Log received bytes
-    ESP_LOGI(TAG, "[RECV] Response data:");
-    for (int i = 0; i < response_length; i++) {
-        ESP_LOGI(TAG, "   [%d]: 0x%02X", i, response[i]);
-    }
-    
-    // Check minimum response length (8 bytes for normal response)
-    if (response_length < 8) {
-        ESP_LOGE(TAG, "[ERROR] Response too short: %d bytes", response_length);
-        stats.failed_requests++;
-        stats.last_error_code = MODBUS_INVALID_RESPONSE;
-        return MODBUS_INVALID_RESPONSE;
-    }
-    
-    // Verify CRC
-    if (!modbus_verify_crc(response, response_length)) {
-        ESP_LOGE(TAG, "[ERROR] Invalid CRC in response");
-        stats.crc_errors++;
-        stats.failed_requests++;
-        stats.last_error_code = MODBUS_INVALID_CRC;
-        return MODBUS_INVALID_CRC;
-    }
-    
-    // Check for error response
-    if (response[1] & 0x80) {
-        uint8_t error_code = response[2];
-        ESP_LOGE(TAG, "[ERROR] Modbus error response: 0x%02X", error_code);
-        stats.failed_requests++;
-        stats.last_error_code = error_code;
-        return (modbus_result_t)error_code;
-    }
-    
-    // Verify response matches request
-    if (response[0] != slave_id || response[1] != MODBUS_WRITE_MULTIPLE_REGISTERS) {
-        ESP_LOGE(TAG, "[ERROR] Response mismatch - Slave: %d (expected %d), Function: %d (expected %d)",
-                 response[0], slave_id, response[1], MODBUS_WRITE_MULTIPLE_REGISTERS);
-        stats.failed_requests++;
-        stats.last_error_code = MODBUS_INVALID_RESPONSE;
-        return MODBUS_INVALID_RESPONSE;
+    modbus_result_t result = modbus_transact(request, request_length, num_regs, NULL);
+    if (result != MODBUS_SUCCESS) {
+        return result;
     }
     
     // Extract response data
+    const uint8_t *response = rx_frame.data;
     uint16_t resp_start_addr = (response[2] << 8) | response[3];
     uint16_t resp_num_regs = (response[4] << 8) | response[5];
     
     if (resp_start_addr != start_addr || resp_num_regs != num_regs) {
         ESP_LOGE(TAG, "[ERROR] Response data mismatch - Addr: %d (expected %d), Qty: %d (expected %d)",
                  resp_start_addr, start_addr, resp_num_regs, num_regs);
-        stats.failed_requests++;
-        stats.last_error_code = MODBUS_INVALID_RESPONSE;
-        return MODBUS_INVALID_RESPONSE;
+        return modbus_reject_response();
     }
     
-    stats.successful_requests++;
-    ESP_LOGI(TAG, "[OK] Successfully wrote %d registers starting at 0x%04X", num_regs, start_addr);
+    ESP_LOGD(TAG, "[OK] Successfully wrote %d registers starting at 0x%04X", num_regs, start_addr);
     
     return MODBUS_SUCCESS;
 }
@@ -560,10 +824,38 @@ void modbus_get_statistics(modbus_stats_t* stats_out)
     }
 }
 
+// Copy the tracked per-slave statistics, ordered by slave ID. Returns the number copied.
+int modbus_get_slave_statistics(modbus_slave_stats_t* slaves, int max_slaves)
+{
+    if (!slaves || max_slaves <= 0) {
+        return 0;
+    }
+
+    int count = 0;
+    for (int id = 1; id <= 247 && count < max_slaves; id++) {
+        for (int i = 0; i < MODBUS_STATS_MAX_SLAVES; i++) {
+            if (slave_stats[i].slave_id == id) {
+                slaves[count++] = slave_stats[i];
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+// Force the response timeout of the following transactions (0 = adaptive per slave).
+// Transactions under an override are not recorded in the per-slave statistics.
+void modbus_set_timeout_override(uint32_t timeout_ms)
+{
+    timeout_override_ms = timeout_ms;
+}
+
 // Reset Statistics
 void modbus_reset_statistics(void)
 {
     memset(&stats, 0, sizeof(modbus_stats_t));
+    memset(slave_stats, 0, sizeof(slave_stats));
+    timeout_log_count = 0;
     ESP_LOGI(TAG, "[STATS] Modbus statistics reset");
 }
 
@@ -658,7 +950,7 @@ esp_err_t flow_meter_read_data(const meter_config_t* config, flow_meter_data_t*
         return ESP_ERR_NOT_SUPPORTED;
     }
     
-    data->last_read_time = esp_timer_get_time() / 1000; // Convert to milliseconds
+    data->last_read_time = modbus_port_now_us() / 1000; // Convert to milliseconds
     data->data_valid = true;
     
     ESP_LOGI(TAG, "[OK] Flow meter reading successful: %.3f %s", 
@@ -22,7 +22,8 @@
 #define RS485_UART_PORT UART_NUM_2
 #define RS485_BAUD_RATE 9600
 #define RS485_BUF_SIZE 2048
-#define MODBUS_RESPONSE_TIMEOUT_MS 1000
+#define MODBUS_RESPONSE_TIMEOUT_MS 1000   // Upper bound, and the timeout for slaves without history
+#define MODBUS_LINE_SETTLE_MS 50          // Line idle time after a UART reconfiguration
 #define RXD2 GPIO_NUM_16
 #define TXD2 GPIO_NUM_17
 #define RS485_RTS_PIN GPIO_NUM_18  // Changed from GPIO_NUM_32 to avoid conflict with SIM RX pin
@@ -65,6 +66,42 @@ typedef struct {
     uint32_t last_read_time;
 } flow_meter_data_t;
 
+// Serial line settings of a device. Zero fields keep the current setting.
+typedef struct {
+    int baud_rate;
+    char parity;                           // 'N', 'E' or 'O'
+    uint8_t stop_bits;                     // 1 or 2
+} modbus_line_config_t;
+
+// Adaptive Response Timeout
+// Each slave's turnaround time (end of request to start of response) is tracked
+// in a log2 histogram. Once enough samples exist, the timeout becomes
+// p99 x MODBUS_TIMEOUT_P99_FACTOR plus the transfer time of the expected frame.
+#define MODBUS_STATS_MAX_SLAVES 16         // Slaves tracked at once (least recently used is evicted)
+#define MODBUS_RTT_BUCKETS 12              // <1, <2, <4 ... <1024 ms, >=1024 ms
+#define MODBUS_RTT_EWMA_SHIFT 3            // EWMA weight of a new sample: 1/8
+#define MODBUS_RTT_HISTORY_MAX 1024        // Histogram is halved at this many samples so it tracks drift
+#define MODBUS_TIMEOUT_MIN_MS 30
+#define MODBUS_TIMEOUT_P99_FACTOR 2
+#define MODBUS_TIMEOUT_MIN_SAMPLES 8       // Samples required before the timeout adapts
+#define MODBUS_TIMEOUT_PROBE_EVERY 8       // Every Nth consecutive timeout waits the full timeout again
+#define MODBUS_TIMEOUT_LOG_INTERVAL_MS 60000 // Timeouts are logged at most this often; each one is traced
+
+// Per-slave response statistics
+typedef struct {
+    uint8_t slave_id;                      // 0 = unused entry
+    uint32_t requests;
+    uint32_t responses;                    // Complete frames, including exceptions and CRC errors
+    uint32_t timeouts;
+    uint32_t consecutive_timeouts;
+    uint32_t rtt_ewma_us;                  // Smoothed turnaround time
+    uint32_t rtt_max_ms;
+    uint32_t rtt_samples;                  // Samples currently held in the histogram
+    uint32_t rtt_histogram[MODBUS_RTT_BUCKETS];
+    uint32_t timeout_ms;                   // Timeout used for the latest request
+    uint32_t last_used;                    // Request sequence number, for eviction
+} modbus_slave_stats_t;
+
 // Statistics Structure
 typedef struct {
     uint32_t total_requests;
@@ -73,14 +110,34 @@ typedef struct {
     uint32_t timeout_errors;
     uint32_t crc_errors;
     uint32_t last_error_code;
+    uint32_t tracked_slaves;               // Entries in use, see modbus_get_slave_statistics()
+    uint32_t line_reconfigs;               // UART baud/parity/stop bit changes
+    uint64_t line_reconfig_us;             // Time spent in those changes, including settle time
+    uint64_t encode_us;                    // Building read requests (frame and CRC)
+    uint64_t tx_us;                        // Writing requests until the last byte left
+    uint64_t wait_us;                      // Waiting for responses, timeouts included
 } modbus_stats_t;
 
+// Details of one transaction, filled by modbus_read_registers()
+typedef struct {
+    uint16_t register_count;               // Registers decoded into the caller's span
+    uint16_t frame_length;                 // Response ADU bytes received
+    uint32_t wait_us;                      // End of request to complete response (or timeout)
+    uint32_t timeout_ms;                   // Response timeout applied
+} modbus_txn_info_t;
+
 // Function Prototypes
 esp_err_t modbus_init(void);
 esp_err_t modbus_set_baud_rate(int baud_rate);
+esp_err_t modbus_set_line_config(const modbus_line_config_t* line);
+void modbus_get_line_config(modbus_line_config_t* line);
 void modbus_deinit(void);
 
 // Read Functions
+// Decodes the response straight into out (room for quantity registers); info may be NULL
+modbus_result_t modbus_read_registers(uint8_t slave_id, uint8_t function_code, uint16_t start_addr,
+                                      uint16_t quantity, uint16_t *out, modbus_txn_info_t *info);
+// Compatibility: read into the global response buffer below
 modbus_result_t modbus_read_holding_registers(uint8_t slave_id, uint16_t start_addr, uint16_t num_regs);
 modbus_result_t modbus_read_input_registers(uint8_t slave_id, uint16_t start_addr, uint16_t num_regs);
 
@@ -88,7 +145,7 @@ modbus_result_t modbus_read_input_registers(uint8_t slave_id, uint16_t start_add
 modbus_result_t modbus_write_single_register(uint8_t slave_id, uint16_t addr, uint16_t value);
 modbus_result_t modbus_write_multiple_registers(uint8_t slave_id, uint16_t start_addr, uint16_t num_regs, const uint16_t* values);
 
-// Response Buffer Functions
+// Response Buffer Functions (results of the compatibility readers only)
 uint16_t modbus_get_response_buffer(uint8_t index);
 uint8_t modbus_get_response_length(void);
 void modbus_clear_response_buffer(void);
@@ -100,6 +157,10 @@ bool modbus_verify_crc(const uint8_t* data, size_t length);
 // Statistics Functions
 void modbus_get_statistics(modbus_stats_t* stats);
 void modbus_reset_statistics(void);
+int modbus_get_slave_statistics(modbus_slave_stats_t* slaves, int max_slaves);
+void modbus_set_timeout_override(uint32_t timeout_ms);
+uint32_t modbus_slave_rtt_p99_ms(const modbus_slave_stats_t* slave);
+uint32_t modbus_rtt_bucket_limit_ms(int bucket);
 
 // Flow Meter Functions
 esp_err_t flow_meter_read_data(const meter_config_t* config, flow_meter_data_t* data);
@@ -0,0 +1,282 @@
+// modbus_bus.c - RS485 bus arbitration
+
+#include "modbus_bus.h"
+#include "metrics.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <string.h>
+
+static const char *TAG = "MODBUS_BUS";
+
+// Internal operation: tear down and reinstall the UART driver
+#define MODBUS_BUS_OP_REINIT 0x00
+
+enum {
+    BUS_STOPPED = 0,
+    BUS_STARTING,
+    BUS_RUNNING
+};
+
+static volatile int s_bus_state = BUS_STOPPED;
+static QueueHandle_t s_queues[MODBUS_PRIO_COUNT];
+static SemaphoreHandle_t s_pending = NULL;   // Counts requests across all queues
+static TaskHandle_t s_bus_task = NULL;
+
+static void modbus_bus_run(modbus_bus_request_t *request)
+{
+    request->register_count = 0;
+
+    if (request->function_code == MODBUS_BUS_OP_REINIT) {
+        modbus_deinit();
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        esp_err_t ret = modbus_init();
+        request->result = (ret == ESP_OK) ? MODBUS_SUCCESS : MODBUS_INVALID_RESPONSE;
+        return;
+    }
+
+    // No-op when the previous request used the same settings
+    esp_err_t line_err = modbus_set_line_config(&request->line);
+    if (line_err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to apply line settings %d %c%d: %s", request->line.baud_rate,
+                 request->line.parity ? request->line.parity : '-', request->line.stop_bits,
+                 esp_err_to_name(line_err));
+        // Continue anyway with current line settings
+    }
+
+    modbus_set_timeout_override(request->timeout_ms);
+
+    switch (request->function_code) {
+        case MODBUS_READ_HOLDING_REGISTERS:
+        case MODBUS_READ_INPUT_REGISTERS: {
+            // Decoded straight into the requester's buffer
+            modbus_txn_info_t info;
+            request->result = modbus_read_registers(request->slave_id, request->function_code, request->address,
+                                                    request->quantity, request->registers, &info);
+            if (request->result == MODBUS_SUCCESS && request->registers) {
+                request->register_count = info.register_count;
+            }
+            break;
+        }
+        case MODBUS_WRITE_SINGLE_REGISTER:
+            request->result = request->write_values ?
+                modbus_write_single_register(request->slave_id, request->address, request->write_values[0]) :
+                MODBUS_ILLEGAL_DATA_VALUE;
+            break;
+        case MODBUS_WRITE_MULTIPLE_REGISTERS:
+            request->result = request->write_values ?
+                modbus_write_multiple_registers(request->slave_id, request->address, request->quantity,
+                                                request->write_values) :
+                MODBUS_ILLEGAL_DATA_VALUE;
+            break;
+        default:
+            request->result = MODBUS_ILLEGAL_FUNCTION;
+            break;
+    }
+
+    modbus_set_timeout_override(0);
+}
+
+// Bus owner task: always serves the highest priority class with pending work
+static void modbus_bus_task(void *pvParameters)
+{
+    ESP_LOGI(TAG, "[OK] RS485 bus owner task started on core %d", xPortGetCoreID());
+    metric_t *queue_metric = metrics_histogram("modbus_bus_queue_ms", "Time requests wait for the RS485 bus",
+                                               NULL, NULL, METRICS_LATENCY_MS_BOUNDS);
+    metric_t *stack_metric = metrics_task_stack_gauge("modbus_bus");
+
+    while (1) {
+        if (xSemaphoreTake(s_pending, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        modbus_bus_request_t *request = NULL;
+        for (int p = 0; p < MODBUS_PRIO_COUNT && !request; p++) {
+            if (xQueueReceive(s_queues[p], &request, 0) != pdTRUE) {
+                request = NULL;
+            }
+        }
+        if (!request) {
+            continue;
+        }
+
+        int64_t start_us = esp_timer_get_time();
+        request->queue_ms = (uint32_t)((start_us - request->submit_us) / 1000);
+        modbus_bus_run(request);
+        request->latency_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+        metrics_observe(queue_metric, request->queue_ms);
+
+        // The request may be released by its owner as soon as completion is signalled
+        SemaphoreHandle_t done = request->done;
+        if (request->callback) {
+            request->callback(request, request->user_ctx);
+        }
+        if (done) {
+            xSemaphoreGive(done);
+        }
+        metrics_report_task_stack(stack_metric);
+    }
+}
+
+esp_err_t modbus_bus_start(void)
+{
+    int expected = BUS_STOPPED;
+    if (!__atomic_compare_exchange_n(&s_bus_state, &expected, BUS_STARTING, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        // Already running, or another task is starting it
+        while (__atomic_load_n(&s_bus_state, __ATOMIC_ACQUIRE) == BUS_STARTING) {
+            vTaskDelay(1);
+        }
+        return modbus_bus_is_running() ? ESP_OK : ESP_FAIL;
+    }
+
+    for (int p = 0; p < MODBUS_PRIO_COUNT; p++) {
+        if (!s_queues[p]) {
+            s_queues[p] = xQueueCreate(MODBUS_BUS_QUEUE_DEPTH, sizeof(modbus_bus_request_t *));
+        }
+    }
+    if (!s_pending) {
+        s_pending = xSemaphoreCreateCounting(MODBUS_PRIO_COUNT * MODBUS_BUS_QUEUE_DEPTH, 0);
+    }
+
+    bool ok = s_pending != NULL;
+    for (int p = 0; p < MODBUS_PRIO_COUNT; p++) {
+        ok = ok && s_queues[p] != NULL;
+    }
+    if (ok && xTaskCreatePinnedToCore(modbus_bus_task, "modbus_bus", MODBUS_BUS_TASK_STACK, NULL,
+                                      MODBUS_BUS_TASK_PRIORITY, &s_bus_task, MODBUS_BUS_TASK_CORE) != pdPASS) {
+        ok = false;
+    }
+
+    if (!ok) {
+        ESP_LOGE(TAG, "[ERROR] Failed to start RS485 bus owner task");
+        __atomic_store_n(&s_bus_state, BUS_STOPPED, __ATOMIC_RELEASE);
+        return ESP_ERR_NO_MEM;
+    }
+
+    __atomic_store_n(&s_bus_state, BUS_RUNNING, __ATOMIC_RELEASE);
+    return ESP_OK;
+}
+
+bool modbus_bus_is_running(void)
+{
+    return __atomic_load_n(&s_bus_state, __ATOMIC_ACQUIRE) == BUS_RUNNING;
+}
+
+// Queue a request. Blocks while its priority class is full. Must not be called
+// from a completion callback (the bus task would wait on itself).
+esp_err_t modbus_bus_submit(modbus_bus_request_t *request, modbus_bus_priority_t priority)
+{
+    if (!request || priority < 0 || priority >= MODBUS_PRIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!modbus_bus_is_running() && modbus_bus_start() != ESP_OK) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    request->result = MODBUS_TIMEOUT;
+    request->register_count = 0;
+    request->queue_ms = 0;
+    request->latency_ms = 0;
+    request->submit_us = esp_timer_get_time();
+
+    if (xQueueSend(s_queues[priority], &request, portMAX_DELAY) != pdTRUE) {
+        return ESP_FAIL;
+    }
+    xSemaphoreGive(s_pending);
+    return ESP_OK;
+}
+
+modbus_result_t modbus_bus_execute(modbus_bus_request_t *request, modbus_bus_priority_t priority)
+{
+    if (!request) {
+        return MODBUS_INVALID_RESPONSE;
+    }
+
+    request->done = xSemaphoreCreateBinaryStatic(&request->done_buffer);
+    esp_err_t ret = modbus_bus_submit(request, priority);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "[ERROR] Failed to submit bus request: %s", esp_err_to_name(ret));
+        vSemaphoreDelete(request->done);
+        request->done = NULL;
+        return MODBUS_INVALID_RESPONSE;
+    }
+
+    xSemaphoreTake(request->done, portMAX_DELAY);
+    vSemaphoreDelete(request->done);
+    request->done = NULL;
+    return request->result;
+}
+
+modbus_result_t modbus_bus_read(modbus_bus_priority_t priority, const modbus_line_config_t *line, uint8_t slave_id,
+                                uint8_t function_code, uint16_t address, uint16_t quantity,
+                                uint16_t *registers, uint16_t *register_count)
+{
+    modbus_bus_request_t request;
+    memset(&request, 0, sizeof(request));
+    request.function_code = function_code;
+    request.slave_id = slave_id;
+    request.address = address;
+    request.quantity = quantity;
+    if (line) {
+        request.line = *line;
+    }
+    request.registers = registers;
+
+    modbus_result_t result = modbus_bus_execute(&request, priority);
+    if (register_count) {
+        *register_count = request.register_count;
+    }
+    return result;
+}
+
+modbus_result_t modbus_bus_write_single(modbus_bus_priority_t priority, const modbus_line_config_t *line,
+                                        uint8_t slave_id, uint16_t address, uint16_t value)
+{
+    modbus_bus_request_t request;
+    memset(&request, 0, sizeof(request));
+    request.function_code = MODBUS_WRITE_SINGLE_REGISTER;
+    request.slave_id = slave_id;
+    request.address = address;
+    request.quantity = 1;
+    if (line) {
+        request.line = *line;
+    }
+    request.write_values = &value;
+
+    return modbus_bus_execute(&request, priority);
+}
+
+modbus_result_t modbus_bus_write_multiple(modbus_bus_priority_t priority, const modbus_line_config_t *line,
+                                          uint8_t slave_id, uint16_t address, uint16_t quantity,
+                                          const uint16_t *values)
+{
+    modbus_bus_request_t request;
+    memset(&request, 0, sizeof(request));
+    request.function_code = MODBUS_WRITE_MULTIPLE_REGISTERS;
+    request.slave_id = slave_id;
+    request.address = address;
+    request.quantity = quantity;
+    if (line) {
+        request.line = *line;
+    }
+    request.write_values = values;
+
+    return modbus_bus_execute(&request, priority);
+}
+
+// Reinstall the UART driver from the bus task, between transactions
+esp_err_t modbus_bus_reinit(void)
+{
+    modbus_bus_request_t request;
+    memset(&request, 0, sizeof(request));
+    request.function_code = MODBUS_BUS_OP_REINIT;
+
+    return modbus_bus_execute(&request, MODBUS_PRIO_POLL) == MODBUS_SUCCESS ? ESP_OK : ESP_FAIL;
+}
+
+uint32_t modbus_bus_pending(void)
+{
+    return s_pending ? (uint32_t)uxSemaphoreGetCount(s_pending) : 0;
+}
@@ -0,0 +1,85 @@
+// modbus_bus.h - RS485 bus arbitration
+// A single owner task performs every Modbus transaction on UART2. Other tasks
+// submit requests into per-priority queues and get the result in their own
+// buffers, so frames and line settings can no longer interleave.
+
+#ifndef MODBUS_BUS_H
+#define MODBUS_BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "modbus.h"
+
+// Bus owner task configuration
+#define MODBUS_BUS_TASK_STACK 4096
+#define MODBUS_BUS_TASK_PRIORITY 6       // Above modbus_task so queued work starts immediately
+#define MODBUS_BUS_TASK_CORE 0
+#define MODBUS_BUS_QUEUE_DEPTH 8         // Pending requests per priority class
+
+// Priority classes, highest first
+typedef enum {
+    MODBUS_PRIO_POLL = 0,                // Scheduled sensor poll
+    MODBUS_PRIO_WRITE,                   // Cloud-to-device register writes
+    MODBUS_PRIO_INTERACTIVE,             // Web UI reads, sensor tests
+    MODBUS_PRIO_SCAN,                    // Bus scans and other background sweeps
+    MODBUS_PRIO_COUNT
+} modbus_bus_priority_t;
+
+struct modbus_bus_request;
+typedef void (*modbus_bus_callback_t)(struct modbus_bus_request *request, void *user_ctx);
+
+// One bus transaction. Owned by the caller until completion is signalled.
+typedef struct modbus_bus_request {
+    // Request
+    uint8_t function_code;               // MODBUS_READ_* / MODBUS_WRITE_*
+    uint8_t slave_id;
+    uint16_t address;
+    uint16_t quantity;
+    modbus_line_config_t line;           // Line settings for this request, zero fields keep current
+    const uint16_t *write_values;        // FC06: values[0], FC10: values[0..quantity-1]
+    uint16_t *registers;                 // Read destination, room for quantity registers
+    uint32_t timeout_ms;                 // Response timeout, 0 = adaptive per-slave timeout
+
+    // Completion
+    modbus_bus_callback_t callback;      // Runs in the bus task, keep it short (optional)
+    void *user_ctx;
+
+    // Result (valid once completed)
+    modbus_result_t result;
+    uint16_t register_count;             // Registers stored in registers[]
+    uint32_t queue_ms;                   // Time spent waiting for the bus
+    uint32_t latency_ms;                 // Time spent on the bus
+
+    // Internal
+    int64_t submit_us;
+    SemaphoreHandle_t done;
+    StaticSemaphore_t done_buffer;
+} modbus_bus_request_t;
+
+// Bus lifecycle
+esp_err_t modbus_bus_start(void);
+bool modbus_bus_is_running(void);
+
+// Asynchronous submission: completion via request->callback
+esp_err_t modbus_bus_submit(modbus_bus_request_t *request, modbus_bus_priority_t priority);
+
+// Synchronous helpers: block until the transaction has completed
+modbus_result_t modbus_bus_execute(modbus_bus_request_t *request, modbus_bus_priority_t priority);
+// line may be NULL to keep the current line settings
+modbus_result_t modbus_bus_read(modbus_bus_priority_t priority, const modbus_line_config_t *line, uint8_t slave_id,
+                                uint8_t function_code, uint16_t address, uint16_t quantity,
+                                uint16_t *registers, uint16_t *register_count);
+modbus_result_t modbus_bus_write_single(modbus_bus_priority_t priority, const modbus_line_config_t *line,
+                                        uint8_t slave_id, uint16_t address, uint16_t value);
+modbus_result_t modbus_bus_write_multiple(modbus_bus_priority_t priority, const modbus_line_config_t *line,
+                                          uint8_t slave_id, uint16_t address, uint16_t quantity,
+                                          const uint16_t *values);
+esp_err_t modbus_bus_reinit(void);
+
+// Diagnostics
+uint32_t modbus_bus_pending(void);
+
+#endif // MODBUS_BUS_H
@@ -0,0 +1,27 @@
+// modbus_crc.h - CRC-16/MODBUS calculation
+// Implementation is selected at compile time with MODBUS_CRC_IMPL
+
+#ifndef MODBUS_CRC_H
+#define MODBUS_CRC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Available implementations
+#define MODBUS_CRC_IMPL_BITWISE 0   // Bit-at-a-time loop, no tables
+#define MODBUS_CRC_IMPL_TABLE   1   // 256-entry lookup table (512 bytes flash)
+#define MODBUS_CRC_IMPL_SLICE4  2   // Slice-by-4 lookup tables (2 KB flash)
+
+#ifndef MODBUS_CRC_IMPL
+#define MODBUS_CRC_IMPL MODBUS_CRC_IMPL_TABLE
+#endif
+
+// CRC register value before any byte has been folded in
+#define MODBUS_CRC_INIT 0xFFFF
+
+// Incremental API: fold bytes into a running CRC as they arrive.
+// Running a whole frame including its trailing CRC yields 0x0000 when valid.
+uint16_t modbus_crc_update(uint16_t crc, const uint8_t *data, size_t length);
+uint16_t modbus_crc_update_byte(uint16_t crc, uint8_t byte);
+
+#endif // MODBUS_CRC_H
@@ -0,0 +1,161 @@
+// modbus_frame.c - Modbus RTU response frame assembler
+
+#include "modbus_frame.h"
+#include "modbus_crc.h"
+#include <string.h>
+
+// Function codes the assembler knows the response layout of
+#define FC_READ_HOLDING_REGISTERS 0x03
+#define FC_READ_INPUT_REGISTERS 0x04
+#define FC_WRITE_SINGLE_REGISTER 0x06
+#define FC_WRITE_MULTIPLE_REGISTERS 0x10
+
+// Expected response length derived from the request alone (0 = unknown)
+uint16_t modbus_frame_expected_length(uint8_t function_code, uint16_t quantity)
+{
+    switch (function_code) {
+        case FC_READ_HOLDING_REGISTERS:
+        case FC_READ_INPUT_REGISTERS:
+            // slave + func + byte_count + data + crc(2)
+            return (uint16_t)(5 + quantity * 2);
+        case FC_WRITE_SINGLE_REGISTER:
+        case FC_WRITE_MULTIPLE_REGISTERS:
+            return MODBUS_FRAME_WRITE_ECHO_SIZE;
+        default:
+            return 0;
+    }
+}
+
+// Refine the expected length from the header bytes received so far
+static void update_expected_length(modbus_frame_t *frame)
+{
+    if (frame->length < 2) {
+        return;
+    }
+
+    // Exception responses are always 5 bytes regardless of the request
+    if (frame->data[1] & 0x80) {
+        frame->expected_length = MODBUS_FRAME_EXCEPTION_SIZE;
+        return;
+    }
+
+    uint8_t function_code = frame->data[1];
+    if (function_code == FC_READ_HOLDING_REGISTERS || function_code == FC_READ_INPUT_REGISTERS) {
+        // Trust the byte count in the frame over the requested quantity
+        if (frame->length >= 3) {
+            frame->expected_length = (uint16_t)(5 + frame->data[2]);
+        }
+    } else {
+        frame->expected_length = modbus_frame_expected_length(function_code, frame->quantity);
+    }
+}
+
+void modbus_frame_init(modbus_frame_t *frame, uint8_t slave_id, uint8_t function_code, uint16_t quantity)
+{
+    if (!frame) return;
+
+    memset(frame, 0, sizeof(modbus_frame_t));
+    frame->slave_id = slave_id;
+    frame->function_code = function_code;
+    frame->quantity = quantity;
+    frame->crc = MODBUS_CRC_INIT;
+}
+
+modbus_frame_status_t modbus_frame_status(const modbus_frame_t *frame)
+{
+    if (!frame) return MODBUS_FRAME_INCOMPLETE;
+
+    if (frame->expected_length > MODBUS_FRAME_MAX_SIZE) {
+        return MODBUS_FRAME_OVERFLOW;
+    }
+    if (frame->expected_length > 0 && frame->length >= frame->expected_length) {
+        return MODBUS_FRAME_COMPLETE;
+    }
+    return MODBUS_FRAME_INCOMPLETE;
+}
+
+static void accept_byte(modbus_frame_t *frame, uint8_t byte)
+{
+    frame->data[frame->length++] = byte;
+    frame->crc = modbus_crc_update_byte(frame->crc, byte);
+    if (frame->length <= 3) {
+        update_expected_length(frame);
+    }
+}
+
+// Append received bytes; anything after a completed frame is counted and dropped
+modbus_frame_status_t modbus_frame_feed(modbus_frame_t *frame, const uint8_t *bytes, size_t len)
+{
+    if (!frame || (!bytes && len > 0)) return MODBUS_FRAME_INCOMPLETE;
+
+    for (size_t i = 0; i < len; i++) {
+        modbus_frame_status_t status = modbus_frame_status(frame);
+        if (status == MODBUS_FRAME_COMPLETE) {
+            frame->discarded += (uint16_t)(len - i);
+            return status;
+        }
+        if (frame->length >= MODBUS_FRAME_MAX_SIZE) {
+            return MODBUS_FRAME_OVERFLOW;
+        }
+        accept_byte(frame, bytes[i]);
+    }
+
+    return modbus_frame_status(frame);
+}
+
+uint8_t *modbus_frame_tail(modbus_frame_t *frame, size_t *space)
+{
+    if (!frame || !space || frame->length >= MODBUS_FRAME_MAX_SIZE) {
+        if (space) *space = 0;
+        return NULL;
+    }
+    *space = MODBUS_FRAME_MAX_SIZE - frame->length;
+    return &frame->data[frame->length];
+}
+
+// Same rules as modbus_frame_feed(), for bytes the port already stored at the tail
+modbus_frame_status_t modbus_frame_commit(modbus_frame_t *frame, size_t len)
+{
+    if (!frame || len > (size_t)(MODBUS_FRAME_MAX_SIZE - frame->length)) return MODBUS_FRAME_INCOMPLETE;
+
+    for (size_t i = 0; i < len; i++) {
+        if (modbus_frame_status(frame) == MODBUS_FRAME_COMPLETE) {
+            frame->discarded += (uint16_t)(len - i);
+            break;
+        }
+        accept_byte(frame, frame->data[frame->length]);
+    }
+
+    return modbus_frame_status(frame);
+}
+
+// Called when the line has been silent for the inter-frame gap. A frame whose
+// length cannot be derived from its header is delimited by the gap alone.
+modbus_frame_status_t modbus_frame_end_of_gap(modbus_frame_t *frame)
+{
+    if (!frame) return MODBUS_FRAME_INCOMPLETE;
+
+    if (frame->expected_length == 0 && frame->length >= MODBUS_FRAME_EXCEPTION_SIZE) {
+        frame->expected_length = frame->length;
+    }
+    return modbus_frame_status(frame);
+}
+
+bool modbus_frame_is_exception(const modbus_frame_t *frame)
+{
+    return frame && frame->length >= 2 && (frame->data[1] & 0x80);
+}
+
+// A frame followed by its own CRC (low byte first) leaves a zero residue
+bool modbus_frame_crc_ok(const modbus_frame_t *frame)
+{
+    return frame && frame->length >= 4 && frame->crc == 0;
+}
+
+// 3.5 character times for an 11-bit RTU character; fixed at 1750 us above 19200 bps
+uint32_t modbus_frame_gap_us(int baud_rate)
+{
+    if (baud_rate <= 0) return 0;
+    if (baud_rate > 19200) return 1750;
+    return (uint32_t)((35u * 11u * 1000000u) / (10u * (uint32_t)baud_rate));
+}
@@ -0,0 +1,56 @@
+// modbus_frame.h - Modbus RTU response frame assembler
+// Plain C with no ESP-IDF dependencies so the framing rules can be driven off-target
+
+#ifndef MODBUS_FRAME_H
+#define MODBUS_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// RTU ADU limits
+#define MODBUS_FRAME_MAX_SIZE 256
+#define MODBUS_FRAME_EXCEPTION_SIZE 5      // slave + func|0x80 + code + crc(2)
+#define MODBUS_FRAME_WRITE_ECHO_SIZE 8     // slave + func + addr(2) + value/qty(2) + crc(2)
+
+// Inter-frame silence (3.5 character times) as seen by the UART RX timeout,
+// which counts in whole character times
+#define MODBUS_FRAME_GAP_CHARS 4
+
+// Frame assembly status
+typedef enum {
+    MODBUS_FRAME_INCOMPLETE = 0,   // More bytes required
+    MODBUS_FRAME_COMPLETE,         // Expected length reached (or gap-delimited)
+    MODBUS_FRAME_OVERFLOW          // Frame exceeded MODBUS_FRAME_MAX_SIZE
+} modbus_frame_status_t;
+
+// Response frame being assembled
+typedef struct {
+    uint8_t slave_id;              // Slave the request was addressed to
+    uint8_t function_code;         // Function code of the request
+    uint16_t quantity;             // Register quantity of the request (read FCs)
+    uint16_t expected_length;      // Full ADU length once known, 0 while unknown
+    uint16_t length;               // Bytes accepted so far
+    uint16_t discarded;            // Trailing bytes dropped after the frame completed
+    uint16_t crc;                  // Running CRC over accepted bytes (0 for a valid frame)
+    uint8_t data[MODBUS_FRAME_MAX_SIZE];
+} modbus_frame_t;
+
+// Frame assembly
+void modbus_frame_init(modbus_frame_t *frame, uint8_t slave_id, uint8_t function_code, uint16_t quantity);
+modbus_frame_status_t modbus_frame_feed(modbus_frame_t *frame, const uint8_t *bytes, size_t len);
+// Receiving in place: the port reads into the free space after the accepted
+// bytes and modbus_frame_commit() accepts what it stored there, so response
+// bytes are copied once, from the UART ring into the frame
+uint8_t *modbus_frame_tail(modbus_frame_t *frame, size_t *space);
+modbus_frame_status_t modbus_frame_commit(modbus_frame_t *frame, size_t len);
+modbus_frame_status_t modbus_frame_status(const modbus_frame_t *frame);
+modbus_frame_status_t modbus_frame_end_of_gap(modbus_frame_t *frame);
+
+// Frame inspection
+bool modbus_frame_is_exception(const modbus_frame_t *frame);
+bool modbus_frame_crc_ok(const modbus_frame_t *frame);
+uint16_t modbus_frame_expected_length(uint8_t function_code, uint16_t quantity);
+uint32_t modbus_frame_gap_us(int baud_rate);
+
+#endif // MODBUS_FRAME_H
@@ -0,0 +1,54 @@
+// modbus_port.h - Serial line and clock port used by the Modbus master
+// modbus.c reaches the RS485 UART and the clock only through a port, so the
+// master, the sensor manager and the JSON templates can be driven by another
+// implementation (a pseudo-terminal with a simulated slave, a replayed capture)
+// without ESP32 hardware. modbus_port_uart is the ESP-IDF implementation and
+// the default.
+
+#ifndef MODBUS_PORT_H
+#define MODBUS_PORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Result of modbus_port_t.read() when received data was lost
+#define MODBUS_PORT_OVERFLOW -1
+
+typedef struct {
+    const char *name;
+
+    // Line, opened at the default settings (RS485_BAUD_RATE 8N1)
+    esp_err_t (*open)(void);
+    void (*close)(void);
+    esp_err_t (*set_baud_rate)(int baud_rate);
+    esp_err_t (*set_parity)(char parity);              // 'N', 'E' or 'O'
+    esp_err_t (*set_stop_bits)(uint8_t stop_bits);     // 1 or 2
+
+    // Transfer
+    int (*write)(const uint8_t *data, size_t length);  // Bytes queued for sending
+    void (*wait_tx_done)(uint32_t timeout_ms);
+    void (*flush_input)(void);                         // Drop received bytes and pending events
+    // Waits up to timeout_us for received bytes. Returns the bytes copied to
+    // buf, 0 when none arrived in time, or MODBUS_PORT_OVERFLOW. *gap is set
+    // once everything received so far has been returned and the line has
+    // been idle for the RTU inter-frame gap.
+    int (*read)(uint8_t *buf, size_t size, int64_t timeout_us, bool *gap);
+
+    // Clock
+    int64_t (*now_us)(void);                           // Monotonic microseconds
+    void (*delay_ms)(uint32_t ms);
+} modbus_port_t;
+
+extern const modbus_port_t modbus_port_uart;
+
+// Replaces the port; only while Modbus is not initialized. NULL restores the
+// default: the UART on ESP-IDF builds, none on host builds.
+esp_err_t modbus_set_port(const modbus_port_t *port);
+const modbus_port_t *modbus_get_port(void);
+
+// Clock of the active port, for timings that must agree with the master's
+int64_t modbus_port_now_us(void);
+
+#endif // MODBUS_PORT_H
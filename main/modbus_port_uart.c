@@ -0,0 +1,221 @@
+// modbus_port_uart.c - RS485 UART port of the Modbus master (ESP-IDF)
+
+#include "modbus_port.h"
+#include "modbus.h"
+#include "modbus_frame.h"
+#include "driver/uart.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "MODBUS_UART";
+
+static QueueHandle_t uart_queue = NULL;
+static bool gap_pending = false;          // RX timeout event seen, reported once the ring is drained
+
+static uart_parity_t modbus_uart_parity(char parity)
+{
+    switch (parity) {
+        case 'E': return UART_PARITY_EVEN;
+        case 'O': return UART_PARITY_ODD;
+        default:  return UART_PARITY_DISABLE;
+    }
+}
+
+static esp_err_t modbus_uart_open(void)
+{
+    ESP_LOGI(TAG, "[LOC] Hardware Configuration:");
+    ESP_LOGI(TAG, "   * UART Port: UART%d", RS485_UART_PORT);
+    ESP_LOGI(TAG, "   * Default Baud Rate: %d bps", RS485_BAUD_RATE);
+    ESP_LOGI(TAG, "   * TX Pin: GPIO %d", TXD2);
+    ESP_LOGI(TAG, "   * RX Pin: GPIO %d", RXD2);
+    ESP_LOGI(TAG, "   * RTS Pin: GPIO %d", RS485_RTS_PIN);
+    ESP_LOGI(TAG, "   * Buffer Size: %d bytes", RS485_BUF_SIZE);
+
+    uart_config_t uart_config = {
+        .baud_rate = RS485_BAUD_RATE,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .rx_flow_ctrl_thresh = 122,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+
+    ESP_LOGI(TAG, "[CONF]  Installing UART driver...");
+    esp_err_t ret = uart_driver_install(RS485_UART_PORT, RS485_BUF_SIZE * 2, RS485_BUF_SIZE * 2, 20, &uart_queue, 0);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "[ERROR] Failed to install UART driver: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGI(TAG, "[OK] UART driver installed successfully");
+
+    ESP_LOGI(TAG, "[CONF]  Configuring UART parameters...");
+    ret = uart_param_config(RS485_UART_PORT, &uart_config);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "[ERROR] Failed to configure UART parameters: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGI(TAG, "[OK] UART parameters configured");
+
+    ESP_LOGI(TAG, "[CONF]  Setting UART pins...");
+    ret = uart_set_pin(RS485_UART_PORT, TXD2, RXD2, RS485_RTS_PIN, UART_PIN_NO_CHANGE);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "[ERROR] Failed to set UART pins: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGI(TAG, "[OK] UART pins configured");
+
+    ESP_LOGI(TAG, "[CONF]  Setting RS485 half-duplex mode...");
+    ret = uart_set_mode(RS485_UART_PORT, UART_MODE_RS485_HALF_DUPLEX);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "[ERROR] Failed to set RS485 mode: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGI(TAG, "[OK] RS485 half-duplex mode enabled");
+
+    // Raise an RX timeout event after the RTU inter-frame gap so a response
+    // is picked up as soon as the slave stops transmitting
+    ret = uart_set_rx_timeout(RS485_UART_PORT, MODBUS_FRAME_GAP_CHARS);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "[ERROR] Failed to set RX timeout: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "[INFO] Connection Guide:");
+    ESP_LOGI(TAG, "   * Connect RS485 A+ to GPIO %d", TXD2);
+    ESP_LOGI(TAG, "   * Connect RS485 B- to GPIO %d", RXD2);
+    ESP_LOGI(TAG, "   * Connect RTS to GPIO %d", RS485_RTS_PIN);
+    ESP_LOGI(TAG, "   * Ensure common ground connection");
+    ESP_LOGI(TAG, "   * Check device baud rate matches %d bps", RS485_BAUD_RATE);
+    return ESP_OK;
+}
+
+static void modbus_uart_close(void)
+{
+    if (uart_queue != NULL) {
+        uart_driver_delete(RS485_UART_PORT);
+        uart_queue = NULL;
+    }
+    gap_pending = false;
+}
+
+static esp_err_t modbus_uart_set_baud_rate(int baud_rate)
+{
+    return uart_set_baudrate(RS485_UART_PORT, baud_rate);
+}
+
+static esp_err_t modbus_uart_set_parity(char parity)
+{
+    return uart_set_parity(RS485_UART_PORT, modbus_uart_parity(parity));
+}
+
+static esp_err_t modbus_uart_set_stop_bits(uint8_t stop_bits)
+{
+    return uart_set_stop_bits(RS485_UART_PORT, stop_bits == 2 ? UART_STOP_BITS_2 : UART_STOP_BITS_1);
+}
+
+static int modbus_uart_write(const uint8_t *data, size_t length)
+{
+    return uart_write_bytes(RS485_UART_PORT, data, length);
+}
+
+static void modbus_uart_wait_tx_done(uint32_t timeout_ms)
+{
+    uart_wait_tx_done(RS485_UART_PORT, pdMS_TO_TICKS(timeout_ms));
+}
+
+static void modbus_uart_flush_input(void)
+{
+    uart_flush_input(RS485_UART_PORT);
+    if (uart_queue != NULL) {
+        xQueueReset(uart_queue);
+    }
+    gap_pending = false;
+}
+
+// Bytes are pulled from the UART ring on each driver event; the driver raises
+// UART_DATA with timeout_flag set once the line has been idle for the RTU gap.
+static int modbus_uart_read(uint8_t *buf, size_t size, int64_t timeout_us, bool *gap)
+{
+    int64_t deadline_us = esp_timer_get_time() + timeout_us;
+    *gap = false;
+
+    if (uart_queue == NULL) {
+        return 0;
+    }
+
+    while (1) {
+        // Drain whatever is already buffered before blocking on the event queue
+        size_t buffered = 0;
+        uart_get_buffered_data_len(RS485_UART_PORT, &buffered);
+        if (buffered > 0) {
+            size_t to_read = buffered < size ? buffered : size;
+            int n = uart_read_bytes(RS485_UART_PORT, buf, to_read, 0);
+            if (n > 0) {
+                return n;
+            }
+        }
+
+        if (gap_pending) {
+            gap_pending = false;
+            *gap = true;
+            return 0;
+        }
+
+        int64_t remaining_us = deadline_us - esp_timer_get_time();
+        if (remaining_us <= 0) {
+            return 0;
+        }
+
+        TickType_t wait_ticks = pdMS_TO_TICKS(remaining_us / 1000);
+        if (wait_ticks == 0) {
+            wait_ticks = 1;
+        }
+
+        uart_event_t event;
+        if (xQueueReceive(uart_queue, &event, wait_ticks) != pdTRUE) {
+            continue;
+        }
+
+        switch (event.type) {
+            case UART_DATA:
+                gap_pending = event.timeout_flag;
+                break;
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                modbus_uart_flush_input();
+                return MODBUS_PORT_OVERFLOW;
+            default:
+                break;
+        }
+    }
+}
+
+static int64_t modbus_uart_now_us(void)
+{
+    return esp_timer_get_time();
+}
+
+static void modbus_uart_delay_ms(uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+const modbus_port_t modbus_port_uart = {
+    .name = "uart",
+    .open = modbus_uart_open,
+    .close = modbus_uart_close,
+    .set_baud_rate = modbus_uart_set_baud_rate,
+    .set_parity = modbus_uart_set_parity,
+    .set_stop_bits = modbus_uart_set_stop_bits,
+    .write = modbus_uart_write,
+    .wait_tx_done = modbus_uart_wait_tx_done,
+    .flush_input = modbus_uart_flush_input,
+    .read = modbus_uart_read,
+    .now_us = modbus_uart_now_us,
+    .delay_ms = modbus_uart_delay_ms,
+};
@@ -0,0 +1,230 @@
+// modbus_scan.c - Background Modbus slave discovery
+
+#include "modbus_scan.h"
+#include "modbus.h"
+#include "modbus_bus.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+static const char *TAG = "MODBUS_SCAN";
+
+static SemaphoreHandle_t s_scan_mutex = NULL;
+static modbus_scan_params_t s_params;
+static modbus_scan_status_t s_status;
+static modbus_scan_result_t s_results[MODBUS_SCAN_MAX_RESULTS];
+static int64_t s_start_us = 0;
+static volatile bool s_stop_requested = false;
+
+void modbus_scan_default_params(modbus_scan_params_t *params)
+{
+    memset(params, 0, sizeof(modbus_scan_params_t));
+    params->start_id = 1;
+    params->end_id = 247;
+    params->holding = true;
+    params->baud_rates[0] = 9600;
+    params->baud_count = 1;
+    params->parity = 'N';
+    params->probe_timeout_ms = MODBUS_SCAN_PROBE_TIMEOUT_MS;
+}
+
+const char *modbus_scan_state_name(modbus_scan_state_t state)
+{
+    switch (state) {
+        case MODBUS_SCAN_RUNNING:   return "running";
+        case MODBUS_SCAN_DONE:      return "done";
+        case MODBUS_SCAN_CANCELLED: return "cancelled";
+        default:                    return "idle";
+    }
+}
+
+static void modbus_scan_record(const modbus_scan_result_t *result)
+{
+    xSemaphoreTake(s_scan_mutex, portMAX_DELAY);
+    if (s_status.found < MODBUS_SCAN_MAX_RESULTS) {
+        s_results[s_status.found++] = *result;
+    } else {
+        s_status.dropped++;
+    }
+    xSemaphoreGive(s_scan_mutex);
+}
+
+// Probe one slave; true if anything answered (a normal reply or a Modbus exception)
+static bool modbus_scan_probe(uint8_t slave_id, uint8_t function_code, const modbus_line_config_t *line,
+                              modbus_scan_result_t *result)
+{
+    uint16_t value = 0;
+    modbus_bus_request_t request;
+    memset(&request, 0, sizeof(request));
+    request.function_code = function_code;
+    request.slave_id = slave_id;
+    request.address = s_params.test_register;
+    request.quantity = 1;
+    request.line = *line;
+    request.registers = &value;
+    request.timeout_ms = s_params.probe_timeout_ms;
+
+    modbus_result_t status = modbus_bus_execute(&request, MODBUS_PRIO_SCAN);
+    bool exception = (status >= MODBUS_ILLEGAL_FUNCTION && status <= MODBUS_SLAVE_DEVICE_BUSY);
+    if (status != MODBUS_SUCCESS && !exception) {
+        return false;
+    }
+
+    memset(result, 0, sizeof(modbus_scan_result_t));
+    result->slave_id = slave_id;
+    result->function_code = function_code;
+    result->baud_rate = line->baud_rate;
+    result->parity = line->parity;
+    result->exception_code = exception ? (uint8_t)status : 0;
+    result->value = exception ? 0 : value;
+    result->latency_ms = request.latency_ms;
+    return true;
+}
+
+static void modbus_scan_task(void *pvParameters)
+{
+    uint8_t function_codes[2];
+    int fc_count = 0;
+    if (s_params.holding) function_codes[fc_count++] = MODBUS_READ_HOLDING_REGISTERS;
+    if (s_params.input) function_codes[fc_count++] = MODBUS_READ_INPUT_REGISTERS;
+
+    ESP_LOGI(TAG, "[SCAN] Job %lu: slaves %d-%d, %d baud rate(s), %lu probes, %lu ms probe timeout",
+             (unsigned long)s_status.job_id, s_params.start_id, s_params.end_id, s_params.baud_count,
+             (unsigned long)s_status.probes_total, (unsigned long)s_params.probe_timeout_ms);
+
+    // Baud rate outermost so the UART is reconfigured once per rate
+    for (int b = 0; b < s_params.baud_count && !s_stop_requested; b++) {
+        modbus_line_config_t line = {
+            .baud_rate = s_params.baud_rates[b],
+            .parity = s_params.parity,
+            .stop_bits = 1,
+        };
+        for (int f = 0; f < fc_count && !s_stop_requested; f++) {
+            for (int id = s_params.start_id; id <= s_params.end_id && !s_stop_requested; id++) {
+                s_status.current_slave = (uint8_t)id;
+                s_status.current_baud = line.baud_rate;
+
+                modbus_scan_result_t result;
+                if (modbus_scan_probe((uint8_t)id, function_codes[f], &line, &result)) {
+                    ESP_LOGI(TAG, "[SCAN] Slave %d answered FC%02X at %d bps in %lu ms%s",
+                             id, function_codes[f], line.baud_rate, (unsigned long)result.latency_ms,
+                             result.exception_code ? " (exception)" : "");
+                    modbus_scan_record(&result);
+                }
+                s_status.probes_done++;
+                s_status.elapsed_ms = (uint32_t)((esp_timer_get_time() - s_start_us) / 1000);
+            }
+        }
+    }
+
+    xSemaphoreTake(s_scan_mutex, portMAX_DELAY);
+    s_status.state = s_stop_requested ? MODBUS_SCAN_CANCELLED : MODBUS_SCAN_DONE;
+    s_status.elapsed_ms = (uint32_t)((esp_timer_get_time() - s_start_us) / 1000);
+    xSemaphoreGive(s_scan_mutex);
+
+    ESP_LOGI(TAG, "[SCAN] Job %lu %s: %d device(s) in %lu ms", (unsigned long)s_status.job_id,
+             modbus_scan_state_name(s_status.state), s_status.found, (unsigned long)s_status.elapsed_ms);
+    vTaskDelete(NULL);
+}
+
+esp_err_t modbus_scan_start(const modbus_scan_params_t *params, uint32_t *job_id)
+{
+    if (!params || params->start_id < 1 || params->end_id > 247 || params->start_id > params->end_id ||
+        params->baud_count < 1 || params->baud_count > MODBUS_SCAN_MAX_BAUDS ||
+        (!params->holding && !params->input)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int b = 0; b < params->baud_count; b++) {
+        if (params->baud_rates[b] <= 0) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    if (!s_scan_mutex) {
+        s_scan_mutex = xSemaphoreCreateMutex();
+        if (!s_scan_mutex) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    xSemaphoreTake(s_scan_mutex, portMAX_DELAY);
+    if (s_status.state == MODBUS_SCAN_RUNNING) {
+        xSemaphoreGive(s_scan_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_params = *params;
+    if (s_params.probe_timeout_ms == 0) {
+        s_params.probe_timeout_ms = MODBUS_SCAN_PROBE_TIMEOUT_MS;
+    }
+    if (s_params.parity != 'E' && s_params.parity != 'O') {
+        s_params.parity = 'N';
+    }
+
+    uint32_t next_job_id = s_status.job_id + 1;
+    memset(&s_status, 0, sizeof(s_status));
+    s_status.job_id = next_job_id;
+    s_status.state = MODBUS_SCAN_RUNNING;
+    s_status.probes_total = (uint32_t)(s_params.end_id - s_params.start_id + 1) * s_params.baud_count *
+                            ((s_params.holding ? 1 : 0) + (s_params.input ? 1 : 0));
+    s_start_us = esp_timer_get_time();
+    s_stop_requested = false;
+    xSemaphoreGive(s_scan_mutex);
+
+    if (xTaskCreate(modbus_scan_task, "modbus_scan", MODBUS_SCAN_TASK_STACK, NULL,
+                    MODBUS_SCAN_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "[ERROR] Failed to create scan task");
+        s_status.state = MODBUS_SCAN_IDLE;
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (job_id) {
+        *job_id = next_job_id;
+    }
+    return ESP_OK;
+}
+
+// Ask a running job to finish after its current probe
+void modbus_scan_stop(void)
+{
+    s_stop_requested = true;
+}
+
+void modbus_scan_get_status(modbus_scan_status_t *status)
+{
+    if (!status) {
+        return;
+    }
+    if (!s_scan_mutex) {
+        memset(status, 0, sizeof(modbus_scan_status_t));
+        return;
+    }
+    xSemaphoreTake(s_scan_mutex, portMAX_DELAY);
+    *status = s_status;
+    if (status->state == MODBUS_SCAN_RUNNING) {
+        status->elapsed_ms = (uint32_t)((esp_timer_get_time() - s_start_us) / 1000);
+    }
+    xSemaphoreGive(s_scan_mutex);
+}
+
+// Copy results found after the first `since` ones; returns the number copied
+int modbus_scan_get_results(int since, modbus_scan_result_t *results, int max_results)
+{
+    if (!results || max_results <= 0 || !s_scan_mutex) {
+        return 0;
+    }
+    if (since < 0) {
+        since = 0;
+    }
+
+    xSemaphoreTake(s_scan_mutex, portMAX_DELAY);
+    int count = 0;
+    for (int i = since; i < s_status.found && count < max_results; i++) {
+        results[count++] = s_results[i];
+    }
+    xSemaphoreGive(s_scan_mutex);
+    return count;
+}
@@ -0,0 +1,73 @@
+// modbus_scan.h - Background Modbus slave discovery
+// A scan job runs in its own task and probes slave IDs through the bus owner
+// task at scan priority, so scheduled polls and web requests keep running.
+// Results are appended as they are found and can be fetched incrementally.
+
+#ifndef MODBUS_SCAN_H
+#define MODBUS_SCAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Scan job configuration
+#define MODBUS_SCAN_MAX_RESULTS 32
+#define MODBUS_SCAN_MAX_BAUDS 6
+#define MODBUS_SCAN_PROBE_TIMEOUT_MS 100     // Default per-probe response timeout
+#define MODBUS_SCAN_TASK_STACK 3072
+#define MODBUS_SCAN_TASK_PRIORITY 3
+
+// Scan parameters
+typedef struct {
+    uint8_t start_id;
+    uint8_t end_id;
+    uint16_t test_register;
+    bool holding;                           // Probe with FC03
+    bool input;                             // Probe with FC04
+    int baud_rates[MODBUS_SCAN_MAX_BAUDS];
+    int baud_count;
+    char parity;                            // 'N', 'E' or 'O'
+    uint32_t probe_timeout_ms;
+} modbus_scan_params_t;
+
+typedef enum {
+    MODBUS_SCAN_IDLE = 0,
+    MODBUS_SCAN_RUNNING,
+    MODBUS_SCAN_DONE,
+    MODBUS_SCAN_CANCELLED
+} modbus_scan_state_t;
+
+// One responding slave. An exception reply still proves the device is there.
+typedef struct {
+    uint8_t slave_id;
+    uint8_t function_code;
+    int baud_rate;
+    char parity;
+    uint8_t exception_code;                 // 0 for a normal response
+    uint16_t value;                         // Test register value (normal response only)
+    uint32_t latency_ms;                    // Request sent to response received
+} modbus_scan_result_t;
+
+typedef struct {
+    modbus_scan_state_t state;
+    uint32_t job_id;
+    uint32_t probes_done;
+    uint32_t probes_total;
+    int found;
+    int dropped;                            // Responses not stored (result list full)
+    uint8_t current_slave;
+    int current_baud;
+    uint32_t elapsed_ms;
+} modbus_scan_status_t;
+
+// Job control
+void modbus_scan_default_params(modbus_scan_params_t *params);
+esp_err_t modbus_scan_start(const modbus_scan_params_t *params, uint32_t *job_id);
+void modbus_scan_stop(void);
+
+// Progress and results
+void modbus_scan_get_status(modbus_scan_status_t *status);
+int modbus_scan_get_results(int since, modbus_scan_result_t *results, int max_results);
+const char *modbus_scan_state_name(modbus_scan_state_t state);
+
+#endif // MODBUS_SCAN_H
@@ -0,0 +1,192 @@
+// poll_planner.c - Modbus poll planning (register-range coalescing)
+
+#include "poll_planner.h"
+#include "modbus.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "POLL_PLAN";
+
+// Vendor composite formats always span 4 registers regardless of the configured quantity
+int poll_item_quantity(const sensor_config_t *sensor)
+{
+    if (strcmp(sensor->sensor_type, "Flow-Meter") == 0 ||
+        strcmp(sensor->sensor_type, "ZEST") == 0 ||
+        strcmp(sensor->sensor_type, "Panda_USM") == 0) {
+        return 4;
+    }
+    return sensor->quantity;
+}
+
+// Default to HOLDING if register_type is empty or invalid
+uint8_t poll_function_code(const char *register_type)
+{
+    if (register_type && strcmp(register_type, "INPUT") == 0) {
+        return MODBUS_READ_INPUT_REGISTERS;
+    }
+    return MODBUS_READ_HOLDING_REGISTERS;
+}
+
+char poll_parity_code(const char *parity)
+{
+    if (parity && strcasecmp(parity, "even") == 0) return 'E';
+    if (parity && strcasecmp(parity, "odd") == 0) return 'O';
+    return 'N';
+}
+
+// Line settings a sensor (and its sub-sensors) is polled with
+void poll_sensor_line(const sensor_config_t *sensor, modbus_line_config_t *line)
+{
+    line->baud_rate = sensor->baud_rate > 0 ? sensor->baud_rate : 9600;
+    line->parity = poll_parity_code(sensor->parity);
+    line->stop_bits = POLL_DEFAULT_STOP_BITS;
+}
+
+void poll_window_line(const poll_window_t *window, modbus_line_config_t *line)
+{
+    line->baud_rate = window->baud_rate;
+    line->parity = window->parity;
+    line->stop_bits = window->stop_bits;
+}
+
+static int compare_items(const void *a, const void *b)
+{
+    const poll_item_t *ia = (const poll_item_t *)a;
+    const poll_item_t *ib = (const poll_item_t *)b;
+
+    if (ia->baud_rate != ib->baud_rate) return ia->baud_rate < ib->baud_rate ? -1 : 1;
+    if (ia->parity != ib->parity) return ia->parity < ib->parity ? -1 : 1;
+    if (ia->stop_bits != ib->stop_bits) return ia->stop_bits < ib->stop_bits ? -1 : 1;
+    if (ia->slave_id != ib->slave_id) return ia->slave_id < ib->slave_id ? -1 : 1;
+    if (ia->function_code != ib->function_code) return ia->function_code < ib->function_code ? -1 : 1;
+    if (ia->start_addr != ib->start_addr) return ia->start_addr < ib->start_addr ? -1 : 1;
+    if (ia->quantity != ib->quantity) return ia->quantity < ib->quantity ? -1 : 1;
+    // Keep configuration order for identical ranges so the sort is deterministic
+    if (ia->sensor_index != ib->sensor_index) return ia->sensor_index < ib->sensor_index ? -1 : 1;
+    return ia->sub_index < ib->sub_index ? -1 : (ia->sub_index > ib->sub_index);
+}
+
+static void add_item(poll_plan_t *plan, int sensor_index, int sub_index, const modbus_line_config_t *line,
+                     int slave_id, const char *register_type, int register_address, int quantity)
+{
+    if (plan->item_count >= POLL_PLAN_MAX_ITEMS) {
+        ESP_LOGW(TAG, "Plan full, sensor %d sub %d not scheduled", sensor_index, sub_index);
+        return;
+    }
+    if (slave_id < 1 || slave_id > 247 || register_address < 0 || register_address > 0xFFFF ||
+        quantity < 1 || quantity > MODBUS_MAX_REGISTERS ||
+        register_address + quantity > 0x10000) {
+        // Leave it out of the plan; the reader reports it as a failed sensor
+        ESP_LOGW(TAG, "Sensor %d sub %d has an invalid range (slave %d, addr %d, qty %d)",
+                 sensor_index, sub_index, slave_id, register_address, quantity);
+        return;
+    }
+
+    poll_item_t *item = &plan->items[plan->item_count++];
+    item->sensor_index = (int8_t)sensor_index;
+    item->sub_index = (int8_t)sub_index;
+    item->slave_id = (uint8_t)slave_id;
+    item->function_code = poll_function_code(register_type);
+    item->parity = line->parity;
+    item->stop_bits = line->stop_bits;
+    item->baud_rate = line->baud_rate;
+    item->start_addr = (uint16_t)register_address;
+    item->quantity = (uint16_t)quantity;
+}
+
+// True if the item can join the window without exceeding the gap or PDU limits
+static bool window_accepts(const poll_window_t *window, const poll_item_t *item, uint16_t gap_tolerance)
+{
+    if (window->baud_rate != item->baud_rate || window->parity != item->parity ||
+        window->stop_bits != item->stop_bits || window->slave_id != item->slave_id || window->function_code != item->function_code) {
+        return false;
+    }
+
+    uint32_t window_end = (uint32_t)window->start_addr + window->quantity;
+    uint32_t item_end = (uint32_t)item->start_addr + item->quantity;
+
+    // Items are sorted by address, so the item never starts before the window
+    if (item->start_addr > window_end && item->start_addr - window_end > gap_tolerance) {
+        return false;
+    }
+
+    uint32_t new_end = item_end > window_end ? item_end : window_end;
+    return new_end - window->start_addr <= MODBUS_MAX_REGISTERS;
+}
+
+esp_err_t poll_plan_build(const system_config_t *config, uint16_t gap_tolerance, poll_plan_t *plan)
+{
+    if (!config || !plan) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    plan->item_count = 0;
+    plan->window_count = 0;
+    plan->line_groups = 0;
+    plan->gap_tolerance = gap_tolerance;
+
+    for (int i = 0; i < config->sensor_count && i < POLL_PLAN_MAX_SENSORS; i++) {
+        const sensor_config_t *sensor = &config->sensors[i];
+        if (!sensor->enabled) {
+            continue;
+        }
+
+        modbus_line_config_t line;
+        poll_sensor_line(sensor, &line);
+
+        if (strcmp(sensor->sensor_type, "QUALITY") == 0) {
+            // Sub-sensors share the parent's line settings but address their own slaves
+            for (int s = 0; s < sensor->sub_sensor_count && s < 8; s++) {
+                const sub_sensor_t *sub = &sensor->sub_sensors[s];
+                if (!sub->enabled) {
+                    continue;
+                }
+                add_item(plan, i, s, &line, sub->slave_id, sub->register_type,
+                         sub->register_address, sub->quantity);
+            }
+        } else {
+            add_item(plan, i, POLL_ITEM_MAIN_SENSOR, &line, sensor->slave_id,
+                     sensor->register_type, sensor->register_address, poll_item_quantity(sensor));
+        }
+    }
+
+    qsort(plan->items, plan->item_count, sizeof(poll_item_t), compare_items);
+
+    // Greedy merge: sorted items either extend the current window or open a new one
+    for (int i = 0; i < plan->item_count; i++) {
+        const poll_item_t *item = &plan->items[i];
+        poll_window_t *window = plan->window_count > 0 ? &plan->windows[plan->window_count - 1] : NULL;
+
+        if (window && window_accepts(window, item, gap_tolerance)) {
+            uint32_t window_end = (uint32_t)window->start_addr + window->quantity;
+            uint32_t item_end = (uint32_t)item->start_addr + item->quantity;
+            if (item_end > window_end) {
+                window->quantity = (uint16_t)(item_end - window->start_addr);
+            }
+            window->item_count++;
+            continue;
+        }
+
+        if (!window || window->baud_rate != item->baud_rate || window->parity != item->parity ||
+            window->stop_bits != item->stop_bits) {
+            plan->line_groups++;
+        }
+
+        window = &plan->windows[plan->window_count++];
+        window->baud_rate = item->baud_rate;
+        window->parity = item->parity;
+        window->stop_bits = item->stop_bits;
+        window->slave_id = item->slave_id;
+        window->function_code = item->function_code;
+        window->start_addr = item->start_addr;
+        window->quantity = item->quantity;
+        window->first_item = (uint16_t)i;
+        window->item_count = 1;
+    }
+
+    ESP_LOGD(TAG, "Planned %d reads for %d register ranges in %d line groups (gap tolerance %u)",
+             plan->window_count, plan->item_count, plan->line_groups, gap_tolerance);
+    return ESP_OK;
+}
@@ -0,0 +1,69 @@
+// poll_planner.h - Modbus poll planning (register-range coalescing)
+// Groups configured sensors by line settings, slave and register type and merges
+// nearby register ranges so each slave is read with as few transactions as possible
+
+#ifndef POLL_PLANNER_H
+#define POLL_PLANNER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "modbus.h"
+#include "web_config.h"
+
+// Plan capacity: every sensor plus up to 8 sub-sensors each
+#define POLL_PLAN_MAX_SENSORS 20
+#define POLL_PLAN_MAX_ITEMS (POLL_PLAN_MAX_SENSORS * 9)
+
+// Marks an item that reads the sensor itself rather than one of its sub-sensors
+#define POLL_ITEM_MAIN_SENSOR -1
+
+// sensor_config_t has no stop-bit setting; every configured device runs 1 stop bit
+#define POLL_DEFAULT_STOP_BITS 1
+
+// One register range needed by a sensor or sub-sensor
+typedef struct {
+    int8_t sensor_index;       // Index into system_config_t.sensors
+    int8_t sub_index;          // Sub-sensor index, or POLL_ITEM_MAIN_SENSOR
+    uint8_t slave_id;
+    uint8_t function_code;     // MODBUS_READ_HOLDING_REGISTERS / MODBUS_READ_INPUT_REGISTERS
+    char parity;               // 'N', 'E' or 'O'
+    uint8_t stop_bits;
+    int baud_rate;
+    uint16_t start_addr;
+    uint16_t quantity;
+} poll_item_t;
+
+// One Modbus transaction covering a contiguous run of items
+typedef struct {
+    int baud_rate;
+    char parity;
+    uint8_t stop_bits;
+    uint8_t slave_id;
+    uint8_t function_code;
+    uint16_t start_addr;
+    uint16_t quantity;
+    uint16_t first_item;       // Items of a window are contiguous in poll_plan_t.items
+    uint16_t item_count;
+} poll_window_t;
+
+// Complete plan for one poll cycle (windows are ordered by line settings)
+typedef struct {
+    poll_item_t items[POLL_PLAN_MAX_ITEMS];
+    int item_count;
+    poll_window_t windows[POLL_PLAN_MAX_ITEMS];
+    int window_count;
+    int line_groups;           // Runs of windows sharing baud, parity and stop bits
+    uint16_t gap_tolerance;    // Unrequested registers allowed between merged items
+} poll_plan_t;
+
+// Plan building
+esp_err_t poll_plan_build(const system_config_t *config, uint16_t gap_tolerance, poll_plan_t *plan);
+
+// Helpers shared with the sensor reader
+int poll_item_quantity(const sensor_config_t *sensor);
+uint8_t poll_function_code(const char *register_type);
+char poll_parity_code(const char *parity);
+void poll_sensor_line(const sensor_config_t *sensor, modbus_line_config_t *line);
+void poll_window_line(const poll_window_t *window, modbus_line_config_t *line);
+
+#endif // POLL_PLANNER_H
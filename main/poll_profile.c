@@ -0,0 +1,147 @@
+// poll_profile.c - Stage timings and latency budgets of the poll/telemetry path
+
+#include "poll_profile.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "POLL_PROFILE";
+
+static poll_profile_t s_profile;
+
+static const char *const stage_names[POLL_STAGE_COUNT] = {
+    "encode", "tx", "wait", "decode", "json"
+};
+
+static void poll_profile_sample(poll_profile_metric_t *metric, uint32_t us, bool first)
+{
+    metric->last_us = us;
+    if (us > metric->max_us) {
+        metric->max_us = us;
+    }
+    if (first) {
+        metric->avg_us = us;
+    } else {
+        int32_t delta = (int32_t)us - (int32_t)metric->avg_us;
+        metric->avg_us = (uint32_t)((int32_t)metric->avg_us + delta / (1 << POLL_PROFILE_EWMA_SHIFT));
+    }
+}
+
+static void poll_profile_memory(uint32_t *stack_free)
+{
+    s_profile.min_free_heap = esp_get_minimum_free_heap_size();
+    *stack_free = (uint32_t)uxTaskGetStackHighWaterMark(NULL);
+}
+
+void poll_profile_record_cycle(uint32_t cycle_us, int transactions, const uint32_t stage_us[POLL_STAGE_COUNT])
+{
+    bool first = s_profile.cycles == 0;
+    s_profile.cycles++;
+    s_profile.transactions = transactions;
+    poll_profile_sample(&s_profile.cycle, cycle_us, first);
+    for (int s = 0; s < POLL_STAGE_COUNT; s++) {
+        if (s != POLL_STAGE_JSON) {
+            poll_profile_sample(&s_profile.stages[s], stage_us[s], first);
+        }
+    }
+
+    uint64_t bus_us = (uint64_t)stage_us[POLL_STAGE_TX] + stage_us[POLL_STAGE_WAIT];
+    s_profile.bus_utilisation_pct = cycle_us > 0 ? (uint8_t)(bus_us >= cycle_us ? 100 : bus_us * 100 / cycle_us) : 0;
+    poll_profile_memory(&s_profile.poll_stack_free);
+
+    int budget_txns = transactions > 0 ? transactions : 1;
+    s_profile.cycle_budget_us = (uint32_t)budget_txns * POLL_PROFILE_BUDGET_TXN_MS * 1000;
+    if (cycle_us > s_profile.cycle_budget_us) {
+        s_profile.cycles_over_budget++;
+        ESP_LOGW(TAG, "[WARN] Poll cycle %lu ms over budget %lu ms (%d transactions, wait %lu ms, bus %u%%)",
+                 (unsigned long)(cycle_us / 1000), (unsigned long)(s_profile.cycle_budget_us / 1000),
+                 transactions, (unsigned long)(stage_us[POLL_STAGE_WAIT] / 1000),
+                 s_profile.bus_utilisation_pct);
+    }
+    if (stage_us[POLL_STAGE_DECODE] > (uint32_t)budget_txns * POLL_PROFILE_BUDGET_DECODE_US) {
+        s_profile.decode_over_budget++;
+        ESP_LOGW(TAG, "[WARN] Decoding took %lu us for %d transactions (budget %d us each)",
+                 (unsigned long)stage_us[POLL_STAGE_DECODE], transactions, POLL_PROFILE_BUDGET_DECODE_US);
+    }
+}
+
+void poll_profile_record_json(uint32_t json_us, int sensors)
+{
+    poll_profile_sample(&s_profile.stages[POLL_STAGE_JSON], json_us, s_profile.json_builds == 0);
+    s_profile.json_builds++;
+    s_profile.json_sensors = sensors;
+    poll_profile_memory(&s_profile.telemetry_stack_free);
+
+    uint32_t budget_us = (uint32_t)(sensors > 0 ? sensors : 1) * POLL_PROFILE_BUDGET_JSON_US;
+    if (json_us > budget_us) {
+        s_profile.json_over_budget++;
+        ESP_LOGW(TAG, "[WARN] Telemetry JSON took %lu us for %d sensors (budget %lu us)",
+                 (unsigned long)json_us, sensors, (unsigned long)budget_us);
+    }
+}
+
+void poll_profile_get(poll_profile_t *profile)
+{
+    if (profile) {
+        *profile = s_profile;
+    }
+}
+
+void poll_profile_reset(void)
+{
+    memset(&s_profile, 0, sizeof(s_profile));
+}
+
+static void poll_profile_write_metric(json_writer_t *w, const char *key, const poll_profile_metric_t *metric)
+{
+    json_writer_key(w, key);
+    json_writer_begin_object(w);
+    json_writer_key_uint(w, "last_us", metric->last_us);
+    json_writer_key_uint(w, "max_us", metric->max_us);
+    json_writer_key_uint(w, "avg_us", metric->avg_us);
+    json_writer_end_object(w);
+}
+
+esp_err_t poll_profile_write_json(json_writer_t *w)
+{
+    poll_profile_t p;
+    poll_profile_get(&p);
+
+    json_writer_begin_object(w);
+    json_writer_key_uint(w, "cycles", p.cycles);
+    json_writer_key_int(w, "transactions", p.transactions);
+    poll_profile_write_metric(w, "cycle", &p.cycle);
+    json_writer_key(w, "stages");
+    json_writer_begin_object(w);
+    for (int s = 0; s < POLL_STAGE_COUNT; s++) {
+        poll_profile_write_metric(w, stage_names[s], &p.stages[s]);
+    }
+    json_writer_end_object(w);
+    json_writer_key_uint(w, "bus_utilisation_pct", p.bus_utilisation_pct);
+
+    json_writer_key(w, "budget");
+    json_writer_begin_object(w);
+    json_writer_key_uint(w, "cycle_us", p.cycle_budget_us);
+    json_writer_key_uint(w, "txn_ms", POLL_PROFILE_BUDGET_TXN_MS);
+    json_writer_key_uint(w, "decode_us_per_txn", POLL_PROFILE_BUDGET_DECODE_US);
+    json_writer_key_uint(w, "json_us_per_sensor", POLL_PROFILE_BUDGET_JSON_US);
+    json_writer_key_uint(w, "cycles_over", p.cycles_over_budget);
+    json_writer_key_uint(w, "decode_over", p.decode_over_budget);
+    json_writer_key_uint(w, "json_over", p.json_over_budget);
+    json_writer_key_bool(w, "ok", p.cycles_over_budget == 0 && p.decode_over_budget == 0 &&
+                                  p.json_over_budget == 0);
+    json_writer_end_object(w);
+
+    json_writer_key_uint(w, "json_builds", p.json_builds);
+    json_writer_key_int(w, "json_sensors", p.json_sensors);
+    json_writer_key(w, "memory");
+    json_writer_begin_object(w);
+    json_writer_key_uint(w, "min_free_heap", p.min_free_heap);
+    json_writer_key_uint(w, "poll_stack_free", p.poll_stack_free);
+    json_writer_key_uint(w, "telemetry_stack_free", p.telemetry_stack_free);
+    json_writer_end_object(w);
+    json_writer_end_object(w);
+    return w->error;
+}
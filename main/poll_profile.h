@@ -0,0 +1,67 @@
+// poll_profile.h - Stage timings and latency budgets of the poll/telemetry path
+// Every poll cycle is broken down into request encoding, transmission, waiting
+// for the response and decoding; every telemetry build adds the JSON stage.
+// The last value, worst value and a smoothed average of each are kept together
+// with bus utilisation and heap/stack low-water marks, and are served as JSON
+// by /api/poll_profile. A cycle over its budget is logged and counted, so a
+// change that slows the poll path shows up on the device instead of being argued.
+//
+// Diagnostics only: writers (poll task, telemetry task) and readers are not
+// locked against each other, like modbus_get_statistics().
+
+#ifndef POLL_PROFILE_H
+#define POLL_PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "json_writer.h"
+
+// Latency budgets. The cycle budget scales with the transactions it ran.
+#define POLL_PROFILE_BUDGET_TXN_MS 250           // Per transaction, whole cycle
+#define POLL_PROFILE_BUDGET_DECODE_US 2000       // Per transaction
+#define POLL_PROFILE_BUDGET_JSON_US 5000         // Per sensor in the telemetry build
+#define POLL_PROFILE_EWMA_SHIFT 3                // Weight of a new sample: 1/8
+
+typedef enum {
+    POLL_STAGE_ENCODE,      // Request frame and CRC
+    POLL_STAGE_TX,          // UART write until the last byte left
+    POLL_STAGE_WAIT,        // Waiting for and assembling the response
+    POLL_STAGE_DECODE,      // Registers to values, into the cycle's readings
+    POLL_STAGE_JSON,        // Telemetry payload for all sensors
+    POLL_STAGE_COUNT
+} poll_stage_t;
+
+typedef struct {
+    uint32_t last_us;
+    uint32_t max_us;
+    uint32_t avg_us;        // EWMA
+} poll_profile_metric_t;
+
+typedef struct {
+    uint32_t cycles;
+    int transactions;                            // Last cycle
+    poll_profile_metric_t cycle;
+    poll_profile_metric_t stages[POLL_STAGE_COUNT];
+    uint8_t bus_utilisation_pct;                 // (TX + wait) / cycle time, last cycle
+    uint32_t cycle_budget_us;                    // Budget of the last cycle
+    uint32_t cycles_over_budget;
+    uint32_t decode_over_budget;
+    uint32_t json_builds;
+    int json_sensors;                            // Sensors in the last telemetry build
+    uint32_t json_over_budget;
+    uint32_t min_free_heap;                      // Since boot
+    uint32_t poll_stack_free;                    // High-water mark of the polling task, bytes
+    uint32_t telemetry_stack_free;               // High-water mark of the telemetry task, bytes
+} poll_profile_t;
+
+// Poll task: stage times of one cycle (encode/tx/wait from the Modbus statistics)
+void poll_profile_record_cycle(uint32_t cycle_us, int transactions, const uint32_t stage_us[POLL_STAGE_COUNT]);
+// Telemetry task: one payload build
+void poll_profile_record_json(uint32_t json_us, int sensors);
+
+void poll_profile_get(poll_profile_t *profile);
+void poll_profile_reset(void);
+esp_err_t poll_profile_write_json(json_writer_t *w);
+
+#endif // POLL_PROFILE_H
@@ -1,15 +1,25 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/unistd.h>
 #include <dirent.h>
 #include <errno.h>
 #include "esp_log.h"
+#include "esp_system.h"
 #include "esp_vfs_fat.h"
 #include "sdmmc_cmd.h"
 #include "driver/sdspi_host.h"
 #include "driver/spi_common.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
 #include "sd_card_logger.h"
+#include "sd_queue.h"
+#include "sd_codec.h"
+#include "metrics.h"
+#include "iot_configs.h"
 
 static const char *TAG = "SD_CARD";
 
@@ -20,6 +30,15 @@ static const char *TAG = "SD_CARD";
 #define SD_CARD_CS GPIO_NUM_15
 #define SD_CARD_SPI_HOST SPI3_HOST
 
+// SPI clock ladder tried at mount, fastest first. Each step must pass a
+// read-back test; I/O errors at runtime remount one step lower, and so do
+// repeated corrupt records (a single one is more likely a torn write).
+static const int sd_clock_ladder_khz[] = { 20000, 10000, 4000, 1000 };
+#define SD_CARD_CLOCK_STEPS ((int)(sizeof(sd_clock_ladder_khz) / sizeof(sd_clock_ladder_khz[0])))
+#define SD_CARD_CLOCK_TEST_BLOCKS 16   // 8 KB test pattern
+#define SD_CARD_CORRUPT_STEP_COUNT 3   // Corrupt records within the window that lower the clock
+#define SD_CARD_CORRUPT_WINDOW_MS 60000
+
 // SD Card state
 static bool sd_initialized = false;
 static bool sd_available = false;
@@ -27,14 +46,59 @@ static sdmmc_card_t *card = NULL;
 static uint32_t message_id_counter = 0;
 static const char* mount_point = "/sdcard";
 // Use 8.3 short filenames for maximum FAT compatibility
-static const char* pending_messages_file = "/sdcard/msgs.txt";  // Even shorter
-static const char* temp_messages_file = "/sdcard/tmp.txt";  // Even shorter
+static const char* pending_messages_file = "/sdcard/msgs.txt";  // Line-based cache of older firmware
+static const char* pending_messages_tmp_file = "/sdcard/msgs.tmp";
+static const char* queue_dir = "/sdcard/msgq";
+static const char* topics_file = "/sdcard/msgq/topics.txt";
+static const char* clock_test_file = "/sdcard/clk.tst";
+
+// Negotiated clock: ladder step of the current mount, never raised again after a fallback
+static int clock_step = 0;
+static uint32_t clock_fallbacks = 0;
+static uint32_t corrupt_in_window = 0;        // Corrupt records skipped in the current window
+static int64_t corrupt_window_start_us = 0;
+static uint32_t probe_write_kbps = 0;
+static uint32_t probe_read_kbps = 0;
+
+// Card operation latencies, updated under queue_mutex
+static sd_card_latency_t latency_append;
+static sd_card_latency_t latency_flush;
+static sd_card_latency_t latency_read;
+static sd_card_latency_t latency_remove;
+static metric_t *metric_append;
+static metric_t *metric_flush;
+static metric_t *metric_read;
+static metric_t *metric_remove;
+
+// Cached messages: segmented record log, guarded by queue_mutex
+static sd_queue_t message_queue;
+static SemaphoreHandle_t queue_mutex = NULL;
+
+// Topic dictionary of encoded messages: the line number in topics_file is the
+// index stored in each record. Only ever appended to.
+static char topic_table[SD_CODEC_MAX_TOPICS][128];
+static int topic_count = 0;
 
 // Minimum free space required (in bytes) - 1MB
 #define MIN_FREE_SPACE_BYTES (1024 * 1024)
 
-// Maximum message file size (10MB)
-#define MAX_MESSAGE_FILE_SIZE (10 * 1024 * 1024)
+static void sd_card_load_topics(void);
+static size_t sd_card_pack_message(const char* topic, const char* payload, const char* timestamp,
+                                   char* record, size_t record_size);
+static void sd_card_import_legacy_messages(void);
+static void sd_card_shutdown_handler(void);
+static esp_err_t sd_card_verify_clock(void);
+
+static void sd_card_record_latency(sd_card_latency_t *latency, metric_t *metric, int64_t start_us) {
+    uint32_t us = (uint32_t)(esp_timer_get_time() - start_us);
+    metrics_observe(metric, us / 1000);
+    latency->count++;
+    latency->last_us = us;
+    latency->avg_us = latency->count == 1 ? us : latency->avg_us - latency->avg_us / 8 + us / 8;
+    if (us > latency->max_us) {
+        latency->max_us = us;
+    }
+}
 
 // Initialize SD card with SPI interface
 esp_err_t sd_card_init(void) {
@@ -43,6 +107,15 @@ esp_err_t sd_card_init(void) {
         return ESP_OK;
     }
 
+    metric_append = metrics_histogram("sd_latency_ms", "SD card operation time", "op", "append",
+                                      METRICS_LATENCY_MS_BOUNDS);
+    metric_flush = metrics_histogram("sd_latency_ms", "SD card operation time", "op", "flush",
+                                     METRICS_LATENCY_MS_BOUNDS);
+    metric_read = metrics_histogram("sd_latency_ms", "SD card operation time", "op", "read",
+                                    METRICS_LATENCY_MS_BOUNDS);
+    metric_remove = metrics_histogram("sd_latency_ms", "SD card operation time", "op", "remove",
+                                      METRICS_LATENCY_MS_BOUNDS);
+
     ESP_LOGI(TAG, "🔧 Initializing SD Card on SPI...");
     ESP_LOGI(TAG, "📍 Pin Configuration:");
     ESP_LOGI(TAG, "   CS:   GPIO %d", SD_CARD_CS);
@@ -77,10 +150,6 @@ esp_err_t sd_card_init(void) {
         return ret;
     }
 
-    // CRITICAL: Add delay after SPI initialization (matching Arduino code line 158)
-    ESP_LOGI(TAG, "⏳ Waiting for SPI bus to stabilize...");
-    vTaskDelay(pdMS_TO_TICKS(1000));  // 1 second delay like Arduino
-
     // Configure SD host and slot
     ESP_LOGI(TAG, "⚙️ Configuring SD host...");
     sdmmc_host_t host = SDSPI_HOST_DEFAULT();
@@ -90,21 +159,34 @@ esp_err_t sd_card_init(void) {
     slot_config.gpio_cs = SD_CARD_CS;
     slot_config.host_id = SD_CARD_SPI_HOST;
 
-    // Use 1MHz like the working Arduino example (not too slow, not too fast)
-    host.max_freq_khz = 1000;  // 1MHz - same as working Arduino code
-    ESP_LOGI(TAG, "📶 SPI Frequency: %d kHz (matching working Arduino implementation)", host.max_freq_khz);
-
-    // Mount FAT filesystem
-    ESP_LOGI(TAG, "💾 Mounting FAT filesystem...");
     esp_vfs_fat_sdmmc_mount_config_t mount_config = {
-        .format_if_mount_failed = true,  // Auto-format if needed (like Arduino SD library)
-        .max_files = 5,
+        .format_if_mount_failed = false,
+        .max_files = 8,   // Message queue keeps up to 3 files open
         .allocation_unit_size = 0  // Use default allocation unit (let FAT decide)
     };
 
     ESP_LOGI(TAG, "🔍 Attempting to detect and initialize SD card...");
     ESP_LOGI(TAG, "   (This may take a few seconds)");
-    ret = esp_vfs_fat_sdspi_mount(mount_point, &host, &slot_config, &mount_config, &card);
+    ret = ESP_FAIL;
+    for (int step = clock_step; step < SD_CARD_CLOCK_STEPS; step++) {
+        host.max_freq_khz = sd_clock_ladder_khz[step];
+        // Auto-format like the Arduino SD library, but only at the slowest clock:
+        // at a marginal clock a misread boot sector would wipe a good card
+        mount_config.format_if_mount_failed = step == SD_CARD_CLOCK_STEPS - 1;
+
+        ESP_LOGI(TAG, "💾 Mounting FAT filesystem at %d kHz...", host.max_freq_khz);
+        ret = esp_vfs_fat_sdspi_mount(mount_point, &host, &slot_config, &mount_config, &card);
+        if (ret == ESP_OK) {
+            ret = sd_card_verify_clock();
+            if (ret == ESP_OK) {
+                clock_step = step;
+                break;
+            }
+            esp_vfs_fat_sdcard_unmount(mount_point, card);
+            card = NULL;
+        }
+        ESP_LOGW(TAG, "⚠️ SD card failed at %d kHz: %s", host.max_freq_khz, esp_err_to_name(ret));
+    }
 
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "❌ Failed to initialize SD card: %s (0x%x)", esp_err_to_name(ret), ret);
@@ -162,7 +244,6 @@ esp_err_t sd_card_init(void) {
     }
 
     sd_initialized = true;
-    sd_available = true;
 
     // Print card info
     ESP_LOGI(TAG, "✅ SD Card initialized successfully");
@@ -182,38 +263,30 @@ esp_err_t sd_card_init(void) {
     ESP_LOGI(TAG, "   Type: %s", card_type);
     ESP_LOGI(TAG, "   Speed: %s", (card->csd.tr_speed > 25000000) ? "High Speed" : "Default Speed");
     ESP_LOGI(TAG, "   Size: %lluMB", ((uint64_t) card->csd.capacity) * card->csd.sector_size / (1024 * 1024));
-
-    // Restore message ID counter
-    sd_card_restore_message_counter();
-
-    // Simple write test (matching Arduino approach)
-    ESP_LOGI(TAG, "🧪 Testing SD card write capability...");
-    const char* test_file = "/sdcard/test.txt";
-
-    FILE* test_fp = fopen(test_file, "w");
-    if (test_fp == NULL) {
-        ESP_LOGE(TAG, "❌ Failed to open test file for writing");
-        ESP_LOGE(TAG, "   errno: %d (%s)", errno, strerror(errno));
-        ESP_LOGE(TAG, "");
-        ESP_LOGE(TAG, "💡 TIP: Reformat SD card as FAT32 and try again");
-        ESP_LOGE(TAG, "");
-        sd_available = false;
+    ESP_LOGI(TAG, "   Clock: %d kHz (write %lu KB/s, read %lu KB/s)", sd_clock_ladder_khz[clock_step],
+             probe_write_kbps, probe_read_kbps);
+
+    // Open the message queue and take over messages cached by older firmware.
+    // Other tasks check sd_available before taking queue_mutex, so the card is
+    // only announced once the queue is open and the ID counter restored.
+    if (!queue_mutex) {
+        queue_mutex = xSemaphoreCreateMutex();
+        // Staged messages are written out before esp_restart()
+        esp_register_shutdown_handler(sd_card_shutdown_handler);
+    }
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    if (sd_queue_open(&message_queue, queue_dir) != ESP_OK) {
+        xSemaphoreGive(queue_mutex);
+        ESP_LOGE(TAG, "❌ Failed to open message queue %s", queue_dir);
         return ESP_FAIL;
     }
+    sd_queue_set_sync(&message_queue, (sd_queue_sync_t)SD_CACHE_SYNC_POLICY, SD_CACHE_FLUSH_INTERVAL_SEC * 1000);
+    sd_card_load_topics();
+    sd_card_import_legacy_messages();
 
-    fprintf(test_fp, "SD card test\n");
-    fclose(test_fp);
-
-    // Verify and clean up
-    struct stat test_st;
-    if (stat(test_file, &test_st) == 0) {
-        ESP_LOGI(TAG, "✅ SD card write test successful! (test file: %ld bytes)", test_st.st_size);
-        unlink(test_file);
-    } else {
-        ESP_LOGE(TAG, "❌ Test file was not created!");
-        sd_available = false;
-        return ESP_FAIL;
-    }
+    sd_available = true;
+    sd_card_restore_message_counter();
+    xSemaphoreGive(queue_mutex);
 
     return ESP_OK;
 }
@@ -224,6 +297,11 @@ esp_err_t sd_card_deinit(void) {
         return ESP_OK;
     }
 
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    sd_available = false;
+    sd_queue_close(&message_queue);
+    xSemaphoreGive(queue_mutex);
+
     esp_err_t ret = esp_vfs_fat_sdcard_unmount(mount_point, card);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to unmount SD card: %s", esp_err_to_name(ret));
@@ -233,7 +311,6 @@ esp_err_t sd_card_deinit(void) {
     spi_bus_free(SD_CARD_SPI_HOST);
 
     sd_initialized = false;
-    sd_available = false;
     card = NULL;
 
     ESP_LOGI(TAG, "SD Card deinitialized");
@@ -253,6 +330,20 @@ esp_err_t sd_card_get_status(sd_card_status_t* status) {
 
     status->initialized = sd_initialized;
     status->card_available = sd_available;
+    status->clock_khz = sd_initialized ? (uint32_t)sd_clock_ladder_khz[clock_step] : 0;
+    status->probe_write_kbps = probe_write_kbps;
+    status->probe_read_kbps = probe_read_kbps;
+    status->clock_fallbacks = clock_fallbacks;
+    if (queue_mutex != NULL) {
+        xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    }
+    status->append = latency_append;
+    status->flush = latency_flush;
+    status->read = latency_read;
+    status->remove = latency_remove;
+    if (queue_mutex != NULL) {
+        xSemaphoreGive(queue_mutex);
+    }
 
     if (sd_available && card != NULL) {
         status->card_size_mb = ((uint64_t) card->csd.capacity) * card->csd.sector_size / (1024 * 1024);
@@ -299,311 +390,568 @@ esp_err_t sd_card_check_space(uint64_t required_bytes) {
     return ESP_OK;
 }
 
-// Save message to SD card (matching Arduino approach with added reliability)
-esp_err_t sd_card_save_message(const char* topic, const char* payload, const char* timestamp) {
-    if (!sd_available) {
-        ESP_LOGW(TAG, "SD card not available for logging");
-        return ESP_ERR_INVALID_STATE;
+// Write a test pattern, read it back from the card and compare CRCs. The SPI
+// driver checks CRCs on every block too, so a marginal clock shows up either
+// as an I/O error or as a mismatch here. Also measures throughput.
+static esp_err_t sd_card_verify_clock(void) {
+    static uint8_t block[512];
+    uint32_t pattern = (uint32_t)esp_timer_get_time() | 1;  // Fresh pattern, stale data cannot pass
+    uint32_t written_crc = 0;
+    uint32_t read_crc = 0;
+    size_t total = SD_CARD_CLOCK_TEST_BLOCKS * sizeof(block);
+    bool ok = true;
+
+    FILE *fp = fopen(clock_test_file, "wb");
+    if (fp == NULL) {
+        return ESP_FAIL;
+    }
+    setvbuf(fp, NULL, _IONBF, 0);
+    int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < SD_CARD_CLOCK_TEST_BLOCKS && ok; i++) {
+        for (size_t j = 0; j < sizeof(block); j += sizeof(pattern)) {
+            pattern ^= pattern << 13;
+            pattern ^= pattern >> 17;
+            pattern ^= pattern << 5;
+            memcpy(block + j, &pattern, sizeof(pattern));
+        }
+        written_crc = esp_rom_crc32_le(written_crc, block, sizeof(block));
+        ok = fwrite(block, 1, sizeof(block), fp) == sizeof(block);
     }
+    ok = ok && fsync(fileno(fp)) == 0;
+    ok = fclose(fp) == 0 && ok;
+    int64_t write_us = esp_timer_get_time() - start_us;
 
-    if (topic == NULL || payload == NULL || timestamp == NULL) {
-        ESP_LOGE(TAG, "Invalid message parameters");
-        return ESP_ERR_INVALID_ARG;
+    // A fresh handle reads the sectors back from the card
+    fp = ok ? fopen(clock_test_file, "rb") : NULL;
+    start_us = esp_timer_get_time();
+    for (int i = 0; i < SD_CARD_CLOCK_TEST_BLOCKS && fp != NULL && ok; i++) {
+        ok = fread(block, 1, sizeof(block), fp) == sizeof(block);
+        read_crc = esp_rom_crc32_le(read_crc, block, sizeof(block));
     }
+    int64_t read_us = esp_timer_get_time() - start_us;
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    unlink(clock_test_file);
 
-    // Validate message sizes (matching Arduino limits: topic=100, payload=200)
-    if (strlen(topic) > 128 || strlen(payload) > 512) {
-        ESP_LOGE(TAG, "Message too large to save");
-        return ESP_ERR_INVALID_SIZE;
+    if (!ok || fp == NULL) {
+        return ESP_FAIL;
+    }
+    if (read_crc != written_crc) {
+        return ESP_ERR_INVALID_CRC;
     }
+    probe_write_kbps = (uint32_t)(total * 1000000ULL / 1024 / (write_us > 0 ? write_us : 1));
+    probe_read_kbps = (uint32_t)(total * 1000000ULL / 1024 / (read_us > 0 ? read_us : 1));
+    return ESP_OK;
+}
 
-    // Quick filesystem health check (verify mount point exists)
-    struct stat mount_st;
-    if (stat(mount_point, &mount_st) != 0) {
-        ESP_LOGE(TAG, "❌ Mount point %s no longer exists! SD card may have been unmounted", mount_point);
-        sd_available = false;
-        return ESP_ERR_INVALID_STATE;
+// Unmount and remount the card after a failed write or read, one clock step
+// lower. The read-ahead position survives, so messages already handed out are
+// not read again.
+static esp_err_t sd_card_recover(void) {
+    ESP_LOGW(TAG, "⚠️ Attempting to recover SD card filesystem...");
+    if (clock_step < SD_CARD_CLOCK_STEPS - 1) {
+        clock_step++;
+        clock_fallbacks++;
+        ESP_LOGW(TAG, "⚠️ Lowering SD clock to %d kHz", sd_clock_ladder_khz[clock_step]);
     }
 
-    // Try a simple test file first to verify filesystem is still writable
-    // Use same naming pattern as actual file (no dot prefix)
-    const char* test_file = "/sdcard/test.txt";
-    FILE *test_fp = fopen(test_file, "w");
-    if (test_fp == NULL) {
-        ESP_LOGE(TAG, "❌ Filesystem health check failed! errno: %d (%s)", errno, strerror(errno));
-        ESP_LOGW(TAG, "⚠️ Attempting to recover SD card filesystem...");
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    sd_available = false;
+    bool scan_valid = message_queue.scan_valid;
+    uint32_t scan_segment = message_queue.scan_segment;
+    uint32_t scan_offset = message_queue.scan_offset;
+    sd_queue_close(&message_queue);
+    xSemaphoreGive(queue_mutex);
+    if (card != NULL) {
+        ESP_LOGI(TAG, "Unmounting SD card...");
+        esp_vfs_fat_sdcard_unmount(mount_point, card);
+        card = NULL;
+    }
 
-        // Try to unmount and remount
-        if (card != NULL) {
-            ESP_LOGI(TAG, "Unmounting SD card...");
-            esp_vfs_fat_sdcard_unmount(mount_point, card);
-            card = NULL;
-        }
+    sd_initialized = false;
+    vTaskDelay(pdMS_TO_TICKS(500));  // Wait for cleanup
 
-        sd_available = false;
-        sd_initialized = false;
-        vTaskDelay(pdMS_TO_TICKS(500));  // Wait for cleanup
-
-        // Attempt reinit
-        ESP_LOGI(TAG, "Attempting to reinitialize SD card...");
-        if (sd_card_init() == ESP_OK) {
-            ESP_LOGI(TAG, "✅ SD card reinitialized successfully");
-            // Retry test file after reinit
-            test_fp = fopen(test_file, "w");
-        }
+    ESP_LOGI(TAG, "Attempting to reinitialize SD card...");
+    if (sd_card_init() != ESP_OK) {
+        ESP_LOGE(TAG, "❌ SD card recovery failed");
+        return ESP_FAIL;
+    }
 
-        if (test_fp == NULL) {
-            ESP_LOGE(TAG, "❌ SD card recovery failed, cannot save message");
-            return ESP_FAIL;
-        }
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    message_queue.scan_valid = scan_valid;
+    message_queue.scan_segment = scan_segment;
+    message_queue.scan_offset = scan_offset;
+    xSemaphoreGive(queue_mutex);
+    ESP_LOGI(TAG, "✅ SD card reinitialized successfully");
+    return ESP_OK;
+}
+
+// Write staged messages out and fsync them
+esp_err_t sd_card_flush(void) {
+    if (!sd_available) {
+        return ESP_ERR_INVALID_STATE;
     }
 
-    // Clean up test file
-    fprintf(test_fp, "ok\n");
-    fclose(test_fp);
-    unlink(test_file);
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    bool unsynced = message_queue.unsynced;
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = sd_queue_flush(&message_queue);
+    if (unsynced) {
+        sd_card_record_latency(&latency_flush, metric_flush, start_us);
+    }
+    xSemaphoreGive(queue_mutex);
 
-    // Now try to open the actual message file
-    ESP_LOGI(TAG, "Opening message file: %s", pending_messages_file);
-    FILE *file = fopen(pending_messages_file, "a");
-    ESP_LOGI(TAG, "fopen() result: %s (errno: %d)", file ? "SUCCESS" : "FAILED", errno);
+    return ret;
+}
 
-    // If append fails with EINVAL, try creating file explicitly first
-    if (file == NULL && errno == EINVAL) {
-        ESP_LOGW(TAG, "Append mode failed, trying to create file first...");
+// Periodic sync policy: flush once SD_CACHE_FLUSH_INTERVAL_SEC has passed since
+// the oldest unsynced message. Called from the main loop.
+esp_err_t sd_card_flush_if_due(void) {
+    if (!sd_available) {
+        return ESP_ERR_INVALID_STATE;
+    }
 
-        // Create file if it doesn't exist
-        FILE *create_file = fopen(pending_messages_file, "w");
-        if (create_file) {
-            fclose(create_file);
-            ESP_LOGI(TAG, "File created, retrying append...");
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    bool unsynced = message_queue.unsynced;
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = sd_queue_flush_due(&message_queue);
+    if (unsynced && !message_queue.unsynced) {
+        sd_card_record_latency(&latency_flush, metric_flush, start_us);
+    }
+    xSemaphoreGive(queue_mutex);
 
-            // Retry append
-            file = fopen(pending_messages_file, "a");
-        } else {
-            ESP_LOGE(TAG, "Failed to create file, errno: %d (%s)", errno, strerror(errno));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "❌ Failed to flush cached messages to SD card");
+        if (ret == ESP_FAIL) {
+            sd_card_recover();
         }
     }
+    return ret;
+}
 
-    if (file == NULL) {
-        ESP_LOGE(TAG, "Failed to open pending messages file for writing");
-        ESP_LOGE(TAG, "errno: %d (%s)", errno, strerror(errno));
-        ESP_LOGE(TAG, "File path: %s", pending_messages_file);
-        return ESP_FAIL;
+static void sd_card_shutdown_handler(void) {
+    if (!sd_available || !queue_mutex) {
+        return;
+    }
+    if (xSemaphoreTake(queue_mutex, pdMS_TO_TICKS(1000)) == pdTRUE) {
+        sd_queue_flush(&message_queue);
+        xSemaphoreGive(queue_mutex);
+    }
+}
+
+// Save message to SD card (matching Arduino approach with added reliability)
+esp_err_t sd_card_save_message(const char* topic, const char* payload, const char* timestamp) {
+    if (!sd_available) {
+        ESP_LOGW(TAG, "SD card not available for logging");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (topic == NULL || payload == NULL || timestamp == NULL) {
+        ESP_LOGE(TAG, "Invalid message parameters");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Validate message sizes (matching Arduino limits: topic=100, payload=200)
+    if (strlen(topic) > 128 || strlen(payload) >= SD_CARD_MAX_PAYLOAD_SIZE) {
+        ESP_LOGE(TAG, "Message too large to save");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    static char record[SD_QUEUE_MAX_RECORD];
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    size_t length = sd_card_pack_message(topic, payload, timestamp, record, sizeof(record));
+    if (length == 0) {
+        xSemaphoreGive(queue_mutex);
+        ESP_LOGE(TAG, "Message too large to save");
+        return ESP_ERR_INVALID_SIZE;
     }
 
-    // Increment message ID and write (matching Arduino format)
     message_id_counter++;
-    int written = fprintf(file, "%lu|%s|%s|%s\n", message_id_counter, timestamp, topic, payload);
-    fflush(file);  // Force write to disk
-    fclose(file);
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = sd_queue_append(&message_queue, message_id_counter, record, (uint16_t)length);
+    sd_card_record_latency(&latency_append, metric_append, start_us);
+    xSemaphoreGive(queue_mutex);
+
+    // A failed write is the health check: remount the card and try once more
+    if (ret == ESP_FAIL) {
+        ESP_LOGE(TAG, "❌ SD card write failed! errno: %d (%s)", errno, strerror(errno));
+        if (sd_card_recover() == ESP_OK) {
+            xSemaphoreTake(queue_mutex, portMAX_DELAY);
+            message_id_counter++;
+            start_us = esp_timer_get_time();
+            ret = sd_queue_append(&message_queue, message_id_counter, record, (uint16_t)length);
+            sd_card_record_latency(&latency_append, metric_append, start_us);
+            xSemaphoreGive(queue_mutex);
+        }
+    }
 
-    if (written > 0) {
-        ESP_LOGI(TAG, "💾 Message saved to SD card with ID: %lu (%d bytes)", message_id_counter, written);
+    if (ret == ESP_OK) {
+        ESP_LOGD(TAG, "💾 Message saved to SD card with ID: %lu (%d bytes, %d as JSON)", message_id_counter,
+                 (int)(SD_QUEUE_HEADER_SIZE + length), (int)strlen(payload));
         return ESP_OK;
     } else {
-        ESP_LOGE(TAG, "Failed to write message to file");
+        ESP_LOGE(TAG, "Failed to write message to SD card queue");
         return ESP_FAIL;
     }
 }
 
-// Get count of pending messages
-esp_err_t sd_card_get_pending_count(uint32_t* count) {
-    if (count == NULL) {
-        return ESP_ERR_INVALID_ARG;
+// Read the topic dictionary written by earlier saves
+static void sd_card_load_topics(void) {
+    topic_count = 0;
+    FILE *file = fopen(topics_file, "r");
+    if (file == NULL) {
+        return;
     }
+    while (topic_count < SD_CODEC_MAX_TOPICS && fgets(topic_table[topic_count], sizeof(topic_table[0]), file)) {
+        topic_table[topic_count][strcspn(topic_table[topic_count], "\r\n")] = 0;
+        topic_count++;
+    }
+    fclose(file);
+}
 
-    if (!sd_available) {
-        *count = 0;
-        return ESP_ERR_INVALID_STATE;
+// Dictionary index of a topic, adding it if needed; -1 if it cannot be stored
+static int sd_card_topic_index(const char* topic) {
+    for (int i = 0; i < topic_count; i++) {
+        if (strcmp(topic_table[i], topic) == 0) {
+            return i;
+        }
+    }
+    if (topic_count >= SD_CODEC_MAX_TOPICS || strlen(topic) >= sizeof(topic_table[0]) ||
+        strpbrk(topic, "\r\n") != NULL) {
+        return -1;
     }
 
-    FILE *file = fopen(pending_messages_file, "r");
+    // The entry must be on the card before any record refers to it
+    FILE *file = fopen(topics_file, "a");
     if (file == NULL) {
-        *count = 0;
-        return ESP_OK; // No file means no messages
+        return -1;
+    }
+    bool ok = fprintf(file, "%s\n", topic) > 0 && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    fclose(file);
+    if (!ok) {
+        return -1;
     }
 
-    uint32_t msg_count = 0;
-    char line[700];
+    strncpy(topic_table[topic_count], topic, sizeof(topic_table[0]) - 1);
+    return topic_count++;
+}
 
-    while (fgets(line, sizeof(line), file) != NULL) {
-        if (strlen(line) > 1) { // Skip empty lines
-            msg_count++;
+// Queue record for a message: the compact encoding of sd_codec.h, or the
+// "timestamp\0topic\0payload" text if the topic has no dictionary entry.
+// Returns the record length, 0 if the message does not fit.
+static size_t sd_card_pack_message(const char* topic, const char* payload, const char* timestamp,
+                                   char* record, size_t record_size) {
+    int topic_index = sd_card_topic_index(topic);
+    size_t length = 0;
+    if (topic_index >= 0 &&
+        sd_codec_encode((uint8_t)topic_index, timestamp, payload, (uint8_t*)record, record_size, &length) == ESP_OK) {
+        return length;
+    }
+
+    size_t ts_len = strlen(timestamp) + 1;
+    size_t topic_len = strlen(topic) + 1;
+    size_t payload_len = strlen(payload);
+    if (ts_len + topic_len + payload_len > record_size) {
+        return 0;
+    }
+    memcpy(record, timestamp, ts_len);
+    memcpy(record + ts_len, topic, topic_len);
+    memcpy(record + ts_len + topic_len, payload, payload_len);
+    return ts_len + topic_len + payload_len;
+}
+
+// Turn a queue record back into a message
+static esp_err_t sd_card_unpack_message(uint32_t id, const char *record, uint16_t length, pending_message_t *msg)
+{
+    if (length > 0 && (uint8_t)record[0] == SD_CODEC_VERSION) {
+        memset(msg, 0, sizeof(pending_message_t));
+        msg->message_id = id;
+        uint8_t topic_index = 0;
+        if (sd_codec_decode((const uint8_t*)record, length, &topic_index, msg->timestamp, sizeof(msg->timestamp),
+                            msg->payload, sizeof(msg->payload)) != ESP_OK || topic_index >= topic_count) {
+            return ESP_ERR_INVALID_RESPONSE;
         }
+        strncpy(msg->topic, topic_table[topic_index], sizeof(msg->topic) - 1);
+        return ESP_OK;
     }
 
-    fclose(file);
-    *count = msg_count;
+    // Text record of earlier firmware
+    const char *timestamp = record;
+    const char *ts_end = memchr(timestamp, '\0', length);
+    if (!ts_end) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    const char *topic = ts_end + 1;
+    const char *topic_end = memchr(topic, '\0', length - (topic - record));
+    if (!topic_end) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    const char *payload = topic_end + 1;
+    size_t payload_len = length - (payload - record);
+    if (payload_len == 0 || payload_len >= sizeof(msg->payload)) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
 
+    memset(msg, 0, sizeof(pending_message_t));
+    msg->message_id = id;
+    strncpy(msg->timestamp, timestamp, sizeof(msg->timestamp) - 1);
+    strncpy(msg->topic, topic, sizeof(msg->topic) - 1);
+    memcpy(msg->payload, payload, payload_len);
     return ESP_OK;
 }
 
-// Replay pending messages with callback
-esp_err_t sd_card_replay_messages(void (*publish_callback)(const pending_message_t* msg)) {
-    if (!sd_available) {
-        ESP_LOGW(TAG, "SD card not available");
-        return ESP_ERR_INVALID_STATE;
+// Copy the lines of msgs.txt from offset on, the ones not yet imported, to msgs.tmp
+static esp_err_t sd_card_copy_legacy_tail(FILE *file, long offset) {
+    FILE *tail = fopen(pending_messages_tmp_file, "w");
+    if (tail == NULL || fseek(file, offset, SEEK_SET) != 0) {
+        if (tail) {
+            fclose(tail);
+        }
+        return ESP_FAIL;
     }
 
-    if (publish_callback == NULL) {
-        ESP_LOGE(TAG, "Invalid callback function");
-        return ESP_ERR_INVALID_ARG;
+    static char chunk[512];
+    bool ok = true;
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        if (fwrite(chunk, 1, n, tail) != n) {
+            ok = false;
+            break;
+        }
+    }
+    if (fclose(tail) != 0 || !ok) {
+        remove(pending_messages_tmp_file);
+        return ESP_FAIL;
     }
+    return ESP_OK;
+}
 
+// Move messages from the line-based msgs.txt of older firmware into the queue.
+// Stops at the first message the queue does not take (card or queue full) and
+// keeps the rest in msgs.txt for the next mount.
+static void sd_card_import_legacy_messages(void) {
     FILE *file = fopen(pending_messages_file, "r");
-    if (file == NULL) {
-        ESP_LOGI(TAG, "No pending messages file found");
-        return ESP_OK;
+    if (file == NULL && rename(pending_messages_tmp_file, pending_messages_file) == 0) {
+        // A trim was interrupted between the remove and the rename
+        file = fopen(pending_messages_file, "r");
     }
-
-    uint32_t total_messages = 0;
-    sd_card_get_pending_count(&total_messages);
-
-    if (total_messages == 0) {
-        ESP_LOGI(TAG, "No messages to replay");
-        fclose(file);
-        return ESP_OK;
+    if (file == NULL) {
+        return;
     }
 
-    ESP_LOGI(TAG, "📤 Found %lu pending messages to replay", total_messages);
-
-    char line[700];
-    uint32_t replayed_count = 0;
-    const uint32_t MAX_REPLAY_BATCH = 20; // Limit messages per batch
+    static char line[700];
+    static char record[SD_QUEUE_MAX_RECORD];
+    uint32_t imported = 0;
+    long resume_offset = -1;
 
-    while (fgets(line, sizeof(line), file) != NULL && replayed_count < MAX_REPLAY_BATCH) {
-        // Remove newline
+    long line_offset = ftell(file);
+    while (fgets(line, sizeof(line), file) != NULL) {
         line[strcspn(line, "\r\n")] = 0;
 
-        if (strlen(line) < 10) {
-            continue; // Skip invalid lines
-        }
-
         // Parse line: ID|TIMESTAMP|TOPIC|PAYLOAD
         char *id_str = strtok(line, "|");
         char *timestamp = strtok(NULL, "|");
         char *topic = strtok(NULL, "|");
-        // Get everything after the 3rd pipe as payload (handles any content in payload)
         char *payload = topic ? (topic + strlen(topic) + 1) : NULL;
-
-        // Validate payload isn't empty
-        if (payload && *payload == '\0') {
-            payload = NULL;
-        }
-
-        if (id_str == NULL || timestamp == NULL || topic == NULL || payload == NULL) {
-            ESP_LOGW(TAG, "Malformed message line, skipping (ID=%s, TS=%s, Topic=%s, Payload=%s)",
-                     id_str ? id_str : "NULL",
-                     timestamp ? timestamp : "NULL",
-                     topic ? topic : "NULL",
-                     payload ? "NULL" : "empty");
+        if (id_str == NULL || timestamp == NULL || topic == NULL || payload == NULL || *payload == '\0') {
             continue;
         }
 
-        // Additional validation: check timestamp isn't empty
-        if (*timestamp == '\0') {
-            ESP_LOGW(TAG, "Malformed message line, skipping (empty timestamp)");
-            continue;
+        size_t length = sd_card_pack_message(topic, payload, timestamp, record, sizeof(record));
+        if (length > 0) {
+            if (sd_queue_append(&message_queue, (uint32_t)atoi(id_str), record, (uint16_t)length) != ESP_OK) {
+                resume_offset = line_offset;
+                break;
+            }
+            imported++;
         }
+        line_offset = ftell(file);
+    }
 
-        // Validate timestamp - skip messages from 1970 (invalid RTC time)
-        if (strncmp(timestamp, "1970-", 5) == 0) {
-            ESP_LOGW(TAG, "⏭️ Skipping message ID %s - invalid timestamp from 1970 (RTC was not set)", id_str);
-            continue;
+    if (sd_queue_flush(&message_queue) != ESP_OK) {
+        fclose(file);
+        ESP_LOGW(TAG, "⚠️ Keeping %s, imported messages were not written", pending_messages_file);
+        return;
+    }
+    if (resume_offset >= 0) {
+        // Keeping the whole file would import the first messages twice
+        esp_err_t ret = sd_card_copy_legacy_tail(file, resume_offset);
+        fclose(file);
+        // FAT rename does not replace an existing file
+        if (ret != ESP_OK || remove(pending_messages_file) != 0 ||
+            rename(pending_messages_tmp_file, pending_messages_file) != 0) {
+            ESP_LOGE(TAG, "❌ Failed to trim %s after a partial import", pending_messages_file);
         }
+        ESP_LOGW(TAG, "⚠️ Imported %lu messages from %s, keeping the rest for the next mount",
+                 imported, pending_messages_file);
+        return;
+    }
+    fclose(file);
+    remove(pending_messages_file);
+    ESP_LOGI(TAG, "📋 Imported %lu messages from %s", imported, pending_messages_file);
+}
 
-        // Validate topic - skip messages with placeholder device IDs
-        if (strstr(topic, "your-device-id") != NULL) {
-            ESP_LOGW(TAG, "⏭️ Skipping message ID %s - invalid topic with placeholder device ID", id_str);
-            continue;
-        }
+// Get count of pending messages
+esp_err_t sd_card_get_pending_count(uint32_t* count) {
+    if (count == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-        pending_message_t msg;
-        msg.message_id = atoi(id_str);
-        strncpy(msg.timestamp, timestamp, sizeof(msg.timestamp) - 1);
-        strncpy(msg.topic, topic, sizeof(msg.topic) - 1);
-        strncpy(msg.payload, payload, sizeof(msg.payload) - 1);
+    if (!sd_available) {
+        *count = 0;
+        return ESP_ERR_INVALID_STATE;
+    }
 
-        ESP_LOGI(TAG, "📤 Replaying message ID: %lu from %s", msg.message_id, msg.timestamp);
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    esp_err_t ret = sd_queue_count(&message_queue, count);
+    xSemaphoreGive(queue_mutex);
 
-        // Call publish callback
-        publish_callback(&msg);
-        replayed_count++;
+    return ret;
+}
 
-        // Small delay to avoid overwhelming the network
-        vTaskDelay(pdMS_TO_TICKS(100));
+// Get the IDs of the oldest and newest pending messages (both 0 when none)
+esp_err_t sd_card_get_pending_range(uint32_t* oldest_id, uint32_t* newest_id) {
+    if (oldest_id == NULL || newest_id == NULL) {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    fclose(file);
+    *oldest_id = 0;
+    *newest_id = 0;
+    if (!sd_available) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    if (message_queue.count > 0) {
+        *oldest_id = message_queue.first_id;
+        *newest_id = message_queue.last_id;
+    }
+    xSemaphoreGive(queue_mutex);
 
-    ESP_LOGI(TAG, "✅ Replayed %lu messages", replayed_count);
     return ESP_OK;
 }
 
-// Remove a specific message by ID
-esp_err_t sd_card_remove_message(uint32_t message_id) {
-    if (!sd_available || message_id == 0) {
-        return ESP_ERR_INVALID_STATE;
+// Count a skipped corrupt record; true once SD_CARD_CORRUPT_STEP_COUNT fall
+// within SD_CARD_CORRUPT_WINDOW_MS of the first
+static bool sd_card_corrupt_streak(void) {
+    int64_t now_us = esp_timer_get_time();
+    if (corrupt_in_window == 0 || now_us - corrupt_window_start_us > (int64_t)SD_CARD_CORRUPT_WINDOW_MS * 1000) {
+        corrupt_in_window = 0;
+        corrupt_window_start_us = now_us;
+    }
+    if (++corrupt_in_window < SD_CARD_CORRUPT_STEP_COUNT) {
+        return false;
     }
+    corrupt_in_window = 0;
+    return true;
+}
 
-    FILE *source_file = fopen(pending_messages_file, "r");
-    if (source_file == NULL) {
-        ESP_LOGW(TAG, "No pending messages file to clean");
-        return ESP_OK;
+// Read the next pending message after those already handed out, oldest first.
+// Messages stay on the card until sd_card_remove_message(), which must follow
+// the order they were read in. ESP_ERR_INVALID_RESPONSE marks a message that is
+// not to be published (malformed, or invalid timestamp/topic); it is removed
+// the same way, by msg->message_id.
+esp_err_t sd_card_read_next_message(pending_message_t* msg) {
+    if (!sd_available) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (msg == NULL) {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    FILE *temp_file = fopen(temp_messages_file, "w");
-    if (temp_file == NULL) {
-        ESP_LOGE(TAG, "Failed to create temp file");
-        fclose(source_file);
-        return ESP_FAIL;
+    static char record[SD_QUEUE_MAX_RECORD];
+    uint32_t id = 0;
+    uint16_t length = 0;
+
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    uint32_t corrupt_skips = message_queue.corrupt_skips;
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = sd_queue_read_next(&message_queue, &id, record, sizeof(record), &length);
+    if (ret == ESP_OK) {
+        sd_card_record_latency(&latency_read, metric_read, start_us);
+    }
+    if (ret == ESP_OK && sd_card_unpack_message(id, record, length, msg) != ESP_OK) {
+        ret = ESP_ERR_INVALID_RESPONSE;
     }
+    bool corrupt = message_queue.corrupt_skips != corrupt_skips;
+    xSemaphoreGive(queue_mutex);
 
-    bool message_found = false;
-    char line[700];
+    // An I/O error means the card is unreliable at this clock; the failed read
+    // is retried by the next call. Records skipped as corrupt are gone either
+    // way, and only count against the clock when they keep coming.
+    if (ret == ESP_FAIL) {
+        ESP_LOGE(TAG, "❌ SD card read failed (I/O error)");
+        sd_card_recover();
+    } else if (corrupt && sd_card_corrupt_streak()) {
+        ESP_LOGE(TAG, "❌ SD card read failed (%d corrupt records within %d s)",
+                 SD_CARD_CORRUPT_STEP_COUNT, SD_CARD_CORRUPT_WINDOW_MS / 1000);
+        sd_card_recover();
+    }
 
-    while (fgets(line, sizeof(line), source_file) != NULL) {
-        if (strlen(line) < 10) {
-            continue;
+    if (ret == ESP_ERR_INVALID_RESPONSE) {
+        ESP_LOGW(TAG, "Malformed message ID %lu, dropping", id);
+        memset(msg, 0, sizeof(pending_message_t));
+        msg->message_id = id;
+        return ret;
+    }
+    if (ret != ESP_OK) {
+        if (ret != ESP_ERR_NOT_FOUND) {
+            ESP_LOGE(TAG, "Failed to read pending message: %s", esp_err_to_name(ret));
         }
+        return ret;
+    }
 
-        // Extract message ID from line
-        uint32_t line_msg_id = atoi(line);
+    // Validate timestamp - drop messages from 1970 (invalid RTC time)
+    // Validate topic - drop messages with placeholder device IDs
+    if (strncmp(msg->timestamp, "1970-", 5) == 0 || strstr(msg->topic, "your-device-id") != NULL) {
+        ESP_LOGW(TAG, "⏭️ Dropping message ID %lu - invalid %s", msg->message_id,
+                 strncmp(msg->timestamp, "1970-", 5) == 0 ? "timestamp from 1970 (RTC was not set)" :
+                                                           "topic with placeholder device ID");
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
+}
 
-        if (line_msg_id != message_id) {
-            fputs(line, temp_file);
-        } else {
-            message_found = true;
-            ESP_LOGI(TAG, "🗑️ Removing published message ID: %lu", message_id);
-        }
+// Start reading again from the oldest pending message (e.g. after a reconnect)
+void sd_card_rewind_messages(void) {
+    if (!sd_available) {
+        return;
     }
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    sd_queue_rewind(&message_queue);
+    xSemaphoreGive(queue_mutex);
+}
 
-    fflush(temp_file);  // Ensure all data is written to disk
-    fclose(source_file);
-    fclose(temp_file);
+// Remove a published message. Messages are consumed in order, so this is the
+// message at the head of the queue.
+esp_err_t sd_card_remove_message(uint32_t message_id) {
+    if (!sd_available || message_id == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
 
-    if (message_found) {
-        // Remove old file
-        if (remove(pending_messages_file) != 0) {
-            ESP_LOGE(TAG, "❌ Failed to remove old messages file: %s", strerror(errno));
-            remove(temp_messages_file);  // Clean up temp file
-            return ESP_FAIL;
-        }
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = sd_queue_ack(&message_queue, message_id);
+    if (ret == ESP_OK) {
+        sd_card_record_latency(&latency_remove, metric_remove, start_us);
+    }
+    xSemaphoreGive(queue_mutex);
 
-        // Rename temp file to original
-        if (rename(temp_messages_file, pending_messages_file) != 0) {
-            ESP_LOGE(TAG, "❌ Failed to rename temp file: %s", strerror(errno));
-            return ESP_FAIL;
-        }
+    // The head is read back before it is consumed; a read error there is handled like one in read-ahead
+    if (ret == ESP_FAIL) {
+        sd_card_recover();
+    }
 
-        ESP_LOGI(TAG, "✅ Successfully removed message ID %lu from SD card", message_id);
+    if (ret == ESP_OK) {
+        // Per PUBACK during replay; sd_replay.c logs progress every SD_REPLAY_PROGRESS_EVERY
+        ESP_LOGD(TAG, "🗑️ Removed message ID %lu from SD card", message_id);
+    } else if (ret == ESP_ERR_NOT_FOUND) {
+        ESP_LOGW(TAG, "⚠️ Message ID %lu is not the oldest pending message", message_id);
     } else {
-        ESP_LOGW(TAG, "⚠️ Message ID %lu not found in SD card", message_id);
-        remove(temp_messages_file);
+        ESP_LOGE(TAG, "❌ Failed to remove message ID %lu: %s", message_id, esp_err_to_name(ret));
     }
-
-    return ESP_OK;
+    return ret;
 }
 
 // Clear all pending messages
@@ -612,13 +960,16 @@ esp_err_t sd_card_clear_all_messages(void) {
         return ESP_ERR_INVALID_STATE;
     }
 
-    if (remove(pending_messages_file) == 0) {
+    xSemaphoreTake(queue_mutex, portMAX_DELAY);
+    esp_err_t ret = sd_queue_clear(&message_queue);
+    xSemaphoreGive(queue_mutex);
+
+    if (ret == ESP_OK) {
         ESP_LOGI(TAG, "✅ All pending messages cleared");
-        return ESP_OK;
     } else {
-        ESP_LOGW(TAG, "No messages file to clear");
-        return ESP_OK; // Not an error if file doesn't exist
+        ESP_LOGE(TAG, "Failed to clear pending messages: %s", esp_err_to_name(ret));
     }
+    return ret;
 }
 
 // Get next message ID
@@ -632,34 +983,10 @@ esp_err_t sd_card_restore_message_counter(void) {
         return ESP_ERR_INVALID_STATE;
     }
 
-    FILE *file = fopen(pending_messages_file, "r");
-    if (file == NULL) {
-        ESP_LOGI(TAG, "No existing messages file - starting with ID counter 0");
-        message_id_counter = 0;
-        return ESP_OK;
-    }
-
-    uint32_t max_id = 0;
-    uint32_t message_count = 0;
-    char line[700];
-
-    while (fgets(line, sizeof(line), file) != NULL) {
-        if (strlen(line) < 10) {
-            continue;
-        }
-
-        uint32_t msg_id = atoi(line);
-        if (msg_id > max_id) {
-            max_id = msg_id;
-        }
-        message_count++;
-    }
-
-    fclose(file);
-
-    message_id_counter = max_id;
+    // Read from the queue index when the queue was opened; kept even after
+    // every message has been sent, so IDs keep increasing across reboots
+    message_id_counter = message_queue.last_id;
     ESP_LOGI(TAG, "📋 Restored message ID counter to: %lu", message_id_counter);
-    ESP_LOGI(TAG, "📋 Found %lu existing messages on SD card", message_count);
 
     return ESP_OK;
 }
@@ -2,14 +2,34 @@
 #define SD_CARD_LOGGER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "esp_err.h"
 
+// Largest payload a cached message can hold (including the terminating NUL)
+#define SD_CARD_MAX_PAYLOAD_SIZE 512
+
+// Latency of one kind of card operation
+typedef struct {
+    uint32_t count;
+    uint32_t last_us;
+    uint32_t avg_us;                // Moving average, 1/8 weight per operation
+    uint32_t max_us;
+} sd_card_latency_t;
+
 // SD Card status
 typedef struct {
     bool initialized;
     bool card_available;
     uint64_t card_size_mb;
     uint64_t free_space_mb;
+    uint32_t clock_khz;             // SPI clock negotiated at mount
+    uint32_t probe_write_kbps;      // Mount-time test pattern throughput
+    uint32_t probe_read_kbps;
+    uint32_t clock_fallbacks;       // Clock lowered after I/O errors since boot
+    sd_card_latency_t append;       // Cache one message
+    sd_card_latency_t flush;        // Write out and fsync staged messages
+    sd_card_latency_t read;         // Read one pending message
+    sd_card_latency_t remove;       // Remove one replayed message
 } sd_card_status_t;
 
 // Message structure for pending telemetry
@@ -17,7 +37,7 @@ typedef struct {
     uint32_t message_id;
     char timestamp[32];
     char topic[128];
-    char payload[512];
+    char payload[SD_CARD_MAX_PAYLOAD_SIZE];
 } pending_message_t;
 
 // SD Card initialization and management
@@ -27,10 +47,19 @@ bool sd_card_is_available(void);
 esp_err_t sd_card_get_status(sd_card_status_t* status);
 esp_err_t sd_card_check_space(uint64_t required_bytes);
 
+// Write-behind control (see SD_CACHE_SYNC_POLICY)
+esp_err_t sd_card_flush(void);
+esp_err_t sd_card_flush_if_due(void);
+
 // Message persistence functions
 esp_err_t sd_card_save_message(const char* topic, const char* payload, const char* timestamp);
 esp_err_t sd_card_get_pending_count(uint32_t* count);
-esp_err_t sd_card_replay_messages(void (*publish_callback)(const pending_message_t* msg));
+esp_err_t sd_card_get_pending_range(uint32_t* oldest_id, uint32_t* newest_id);
+
+// Pipelined replay (see sd_replay.h): read ahead of the oldest pending message,
+// remove messages in the same order once the broker has acknowledged them
+esp_err_t sd_card_read_next_message(pending_message_t* msg);
+void sd_card_rewind_messages(void);
 esp_err_t sd_card_remove_message(uint32_t message_id);
 esp_err_t sd_card_clear_all_messages(void);
 
@@ -0,0 +1,376 @@
+// sd_codec.c - Compact encoding of cached telemetry messages
+
+#include "sd_codec.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+// LZ parameters; see the token layout in sd_codec.h
+#define SD_CODEC_DICT_MAX 512
+#define SD_CODEC_WINDOW_SIZE (SD_CODEC_DICT_MAX + SD_CODEC_MAX_PAYLOAD + 1)
+#define SD_CODEC_MAX_OFFSET 1024
+#define SD_CODEC_MIN_MATCH 3
+#define SD_CODEC_LONG_MATCH (SD_CODEC_MIN_MATCH + 31)
+#define SD_CODEC_MAX_MATCH (SD_CODEC_LONG_MATCH + 255)
+#define SD_CODEC_MAX_LITERALS 128
+#define SD_CODEC_HASH_BITS 9
+#define SD_CODEC_CHAIN_DEPTH 32
+
+// Fragments of the json_templates.c formats, so the first object of a
+// message already compresses. Changing this text invalidates cached records:
+// bump SD_CODEC_VERSION with it.
+static const char s_preset[] =
+    "{\"params_data\":{\"pH\":7.00,\"TDS\":100.00,\"Temp\":25.00,\"HUMIDITY\":60.00,"
+    "\"TSS\":10.00,\"BOD\":5.00,\"COD\":8.00},\"type\":\"QUALITY\",\"created_on\":\""
+    "{\"ene_con_hex\":\"00000000\",\"type\":\"ENERGY\",\"created_on_epoch\":"
+    "{\"borewell\":0.000000,\"type\":\"BOREWELL\",\"created_on_epoch\":"
+    ",\"slave_id\":1,\"meter\":\"piezo\"}"
+    "\",\"type\":\"RAINGAUGE\",\"raingauge\":\""
+    "\",\"type\":\"LEVEL\",\"level_filled\":"
+    "[{\"unit_id\":\"FG24\",\"type\":\"FLOW\",\"consumption\":\"0.00\",\"created_on\":\"20"
+    "Z\"},{\"unit_id\":\"FG24";
+
+// Preset, timestamp text and epoch digits
+_Static_assert(sizeof(s_preset) - 1 + 32 + 12 <= SD_CODEC_DICT_MAX, "preset dictionary too large");
+
+// Dictionary followed by the payload; callers serialize encode/decode
+static uint8_t s_window[SD_CODEC_WINDOW_SIZE];
+static int16_t s_head[1 << SD_CODEC_HASH_BITS];
+static int16_t s_prev[SD_CODEC_WINDOW_SIZE];
+
+static size_t sd_codec_put_varint(uint8_t *out, uint32_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+static bool sd_codec_get_varint(const uint8_t *in, size_t length, size_t *pos, uint32_t *value)
+{
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35 && *pos < length; shift += 7) {
+        uint8_t byte = in[(*pos)++];
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void sd_codec_format_time(uint32_t seconds, char *text, size_t size)
+{
+    time_t t = (time_t)seconds;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(text, size, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
+
+// "YYYY-MM-DDTHH:MM:SSZ" to seconds since 1970; false unless the text is
+// exactly what sd_codec_format_time() produces for the result
+static bool sd_codec_parse_time(const char *text, uint32_t *seconds)
+{
+    unsigned year, month, day, hour, minute, second;
+    if (strlen(text) != 20 ||
+        sscanf(text, "%4u-%2u-%2uT%2u:%2u:%2uZ", &year, &month, &day, &hour, &minute, &second) != 6 ||
+        year < 1970 || year > 2105 || month < 1 || month > 12 || day < 1 || day > 31) {
+        return false;
+    }
+
+    // Days since 1970-01-01 in the proleptic Gregorian calendar
+    unsigned y = year - (month <= 2);
+    unsigned era = y / 400;
+    unsigned yoe = y - era * 400;
+    unsigned doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = (int64_t)era * 146097 + doe - 719468;
+    int64_t total = days * 86400 + hour * 3600 + minute * 60 + second;
+    if (total < 0 || total > UINT32_MAX) {
+        return false;
+    }
+
+    char check[32];
+    sd_codec_format_time((uint32_t)total, check, sizeof(check));
+    if (strcmp(check, text) != 0) {
+        return false;
+    }
+    *seconds = (uint32_t)total;
+    return true;
+}
+
+// The payload's created_on / created_on_epoch usually repeat the message time
+static size_t sd_codec_build_dict(const char *timestamp, bool have_seconds, uint32_t seconds)
+{
+    size_t length = sizeof(s_preset) - 1;
+    memcpy(s_window, s_preset, length);
+
+    size_t ts_len = strnlen(timestamp, 31);
+    memcpy(s_window + length, timestamp, ts_len);
+    length += ts_len;
+
+    if (have_seconds) {
+        char digits[12];
+        int n = snprintf(digits, sizeof(digits), "%lu", (unsigned long)seconds);
+        memcpy(s_window + length, digits, n);
+        length += n;
+    }
+    return length;
+}
+
+static inline uint32_t sd_codec_hash(const uint8_t *p)
+{
+    uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+    return (v * 2654435761u) >> (32 - SD_CODEC_HASH_BITS);
+}
+
+static inline void sd_codec_insert(size_t pos)
+{
+    uint32_t h = sd_codec_hash(s_window + pos);
+    s_prev[pos] = s_head[h];
+    s_head[h] = (int16_t)pos;
+}
+
+static size_t sd_codec_flush_literals(size_t start, size_t end, uint8_t *out, size_t o, size_t out_size)
+{
+    while (start < end && o != SIZE_MAX) {
+        size_t n = end - start;
+        if (n > SD_CODEC_MAX_LITERALS) {
+            n = SD_CODEC_MAX_LITERALS;
+        }
+        if (o + 1 + n > out_size) {
+            return SIZE_MAX;
+        }
+        out[o++] = (uint8_t)(n - 1);
+        memcpy(out + o, s_window + start, n);
+        o += n;
+        start += n;
+    }
+    return o;
+}
+
+// Greedy LZ77 over s_window[dict_length, dict_length + length). Returns the
+// compressed size, 0 if it does not fit in out_size.
+static size_t sd_codec_compress(size_t dict_length, size_t length, uint8_t *out, size_t out_size)
+{
+    size_t end = dict_length + length;
+    memset(s_head, 0xFF, sizeof(s_head));
+    for (size_t pos = 0; pos < dict_length && pos + SD_CODEC_MIN_MATCH <= end; pos++) {
+        sd_codec_insert(pos);
+    }
+
+    size_t o = 0;
+    size_t pos = dict_length;
+    size_t literal_start = pos;
+    while (pos < end) {
+        size_t best_length = 0;
+        size_t best_offset = 0;
+        if (pos + SD_CODEC_MIN_MATCH <= end) {
+            size_t max_length = end - pos < SD_CODEC_MAX_MATCH ? end - pos : SD_CODEC_MAX_MATCH;
+            int depth = SD_CODEC_CHAIN_DEPTH;
+            for (int16_t candidate = s_head[sd_codec_hash(s_window + pos)];
+                 candidate >= 0 && depth-- > 0; candidate = s_prev[candidate]) {
+                size_t offset = pos - (size_t)candidate;
+                if (offset > SD_CODEC_MAX_OFFSET) {
+                    break;
+                }
+                size_t n = 0;
+                while (n < max_length && s_window[candidate + n] == s_window[pos + n]) {
+                    n++;
+                }
+                if (n > best_length) {
+                    best_length = n;
+                    best_offset = offset;
+                    if (n == max_length) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (best_length < SD_CODEC_MIN_MATCH) {
+            if (pos + SD_CODEC_MIN_MATCH <= end) {
+                sd_codec_insert(pos);
+            }
+            pos++;
+            continue;
+        }
+
+        o = sd_codec_flush_literals(literal_start, pos, out, o, out_size);
+        if (o == SIZE_MAX || o + 3 > out_size) {
+            return 0;
+        }
+        size_t code = best_length - SD_CODEC_MIN_MATCH;
+        uint32_t distance = (uint32_t)(best_offset - 1);
+        out[o++] = (uint8_t)(0x80 | ((code < 31 ? code : 31) << 2) | (distance >> 8));
+        out[o++] = (uint8_t)distance;
+        if (code >= 31) {
+            out[o++] = (uint8_t)(best_length - SD_CODEC_LONG_MATCH);
+        }
+
+        for (size_t k = 0; k < best_length; k++, pos++) {
+            if (pos + SD_CODEC_MIN_MATCH <= end) {
+                sd_codec_insert(pos);
+            }
+        }
+        literal_start = pos;
+    }
+
+    o = sd_codec_flush_literals(literal_start, end, out, o, out_size);
+    return o == SIZE_MAX ? 0 : o;
+}
+
+static bool sd_codec_decompress(const uint8_t *in, size_t in_length, size_t dict_length, size_t length)
+{
+    size_t pos = dict_length;
+    size_t end = dict_length + length;
+    size_t i = 0;
+    while (i < in_length) {
+        uint8_t token = in[i++];
+        if (!(token & 0x80)) {
+            size_t n = (size_t)token + 1;
+            if (i + n > in_length || pos + n > end) {
+                return false;
+            }
+            memcpy(s_window + pos, in + i, n);
+            i += n;
+            pos += n;
+            continue;
+        }
+
+        if (i >= in_length) {
+            return false;
+        }
+        size_t offset = (((size_t)(token & 0x03) << 8) | in[i++]) + 1;
+        size_t n = ((token >> 2) & 0x1F) + SD_CODEC_MIN_MATCH;
+        if (n == SD_CODEC_LONG_MATCH) {
+            if (i >= in_length) {
+                return false;
+            }
+            n += in[i++];
+        }
+        if (offset > pos || pos + n > end) {
+            return false;
+        }
+        // Byte by byte: the source may overlap the bytes being written
+        for (size_t k = 0; k < n; k++, pos++) {
+            s_window[pos] = s_window[pos - offset];
+        }
+    }
+    return pos == end;
+}
+
+esp_err_t sd_codec_encode(uint8_t topic_index, const char *timestamp, const char *payload,
+                          uint8_t *out, size_t out_size, size_t *out_length)
+{
+    if (!timestamp || !payload || !out || !out_length) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    size_t length = strlen(payload);
+    size_t ts_len = strlen(timestamp);
+    if (length > SD_CODEC_MAX_PAYLOAD || ts_len > 31 || out_size < 3 + 1 + ts_len + 5) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t flags = 0;
+    uint32_t seconds = 0;
+    bool have_seconds = sd_codec_parse_time(timestamp, &seconds) && seconds >= SD_CODEC_EPOCH;
+
+    size_t o = 0;
+    out[o++] = SD_CODEC_VERSION;
+    o++;                                    // Flags, set below
+    out[o++] = topic_index;
+    if (have_seconds) {
+        o += sd_codec_put_varint(out + o, seconds - SD_CODEC_EPOCH);
+    } else {
+        flags |= SD_CODEC_FLAG_RAW_TIME;
+        out[o++] = (uint8_t)ts_len;
+        memcpy(out + o, timestamp, ts_len);
+        o += ts_len;
+    }
+    o += sd_codec_put_varint(out + o, (uint32_t)length);
+
+    size_t dict_length = sd_codec_build_dict(timestamp, have_seconds, seconds);
+    memcpy(s_window + dict_length, payload, length);
+    size_t packed = sd_codec_compress(dict_length, length, out + o, out_size - o);
+    if (packed == 0 || packed >= length) {
+        if (o + length > out_size) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        flags |= SD_CODEC_FLAG_STORED;
+        memcpy(out + o, payload, length);
+        packed = length;
+    }
+
+    out[1] = flags;
+    *out_length = o + packed;
+    return ESP_OK;
+}
+
+esp_err_t sd_codec_decode(const uint8_t *in, size_t in_length, uint8_t *topic_index,
+                          char *timestamp, size_t timestamp_size, char *payload, size_t payload_size)
+{
+    if (!in || !topic_index || !timestamp || !payload || timestamp_size == 0 || payload_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (in_length < 5 || in[0] != SD_CODEC_VERSION) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    uint8_t flags = in[1];
+    *topic_index = in[2];
+    size_t i = 3;
+
+    uint32_t seconds = 0;
+    bool have_seconds = !(flags & SD_CODEC_FLAG_RAW_TIME);
+    if (have_seconds) {
+        uint32_t delta;
+        if (!sd_codec_get_varint(in, in_length, &i, &delta) || delta > UINT32_MAX - SD_CODEC_EPOCH) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        seconds = delta + SD_CODEC_EPOCH;
+        if (timestamp_size < 21) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        sd_codec_format_time(seconds, timestamp, timestamp_size);
+    } else {
+        size_t ts_len = in[i++];
+        if (ts_len > 31 || i + ts_len > in_length) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (ts_len >= timestamp_size) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(timestamp, in + i, ts_len);
+        timestamp[ts_len] = '\0';
+        i += ts_len;
+    }
+
+    uint32_t length;
+    if (!sd_codec_get_varint(in, in_length, &i, &length) || length > SD_CODEC_MAX_PAYLOAD) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if (length >= payload_size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (flags & SD_CODEC_FLAG_STORED) {
+        if (i + length != in_length) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        memcpy(payload, in + i, length);
+    } else {
+        size_t dict_length = sd_codec_build_dict(timestamp, have_seconds, seconds);
+        if (!sd_codec_decompress(in + i, in_length - i, dict_length, length)) {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        memcpy(payload, s_window + dict_length, length);
+    }
+    payload[length] = '\0';
+    return ESP_OK;
+}
@@ -0,0 +1,44 @@
+// sd_codec.h - Compact encoding of cached telemetry messages
+// A cached message is stored as a topic dictionary index, the timestamp as a
+// varint of seconds since SD_CODEC_EPOCH and the JSON payload LZ-compressed
+// against a preset dictionary of the telemetry template keys plus the
+// message's own timestamp. The full message is rebuilt only at replay.
+//
+// Body layout:
+//   [0] SD_CODEC_VERSION
+//   [1] flags (SD_CODEC_FLAG_*)
+//   [2] topic index
+//   varint seconds since SD_CODEC_EPOCH, or length byte + timestamp text (RAW_TIME)
+//   varint payload length
+//   LZ tokens, or the payload bytes (STORED)
+//
+// LZ tokens: 0LLLLLLL = L+1 literal bytes follow; 1LLLLLOO OOOOOOOO = copy
+// L+3 bytes from O+1 bytes back (L == 31: one more byte adds to the length).
+// Matches may reach back into the preset dictionary.
+
+#ifndef SD_CODEC_H
+#define SD_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Not a printable character, so never the first byte of a text record
+#define SD_CODEC_VERSION 0xC1
+#define SD_CODEC_EPOCH 1577836800UL         // 2020-01-01T00:00:00Z
+#define SD_CODEC_MAX_PAYLOAD 1023
+#define SD_CODEC_MAX_TOPICS 8
+
+#define SD_CODEC_FLAG_RAW_TIME 0x01         // Timestamp kept as text (not in the canonical UTC form)
+#define SD_CODEC_FLAG_STORED 0x02           // Payload did not compress
+
+// Encode one message into out. ESP_ERR_INVALID_SIZE if it does not fit.
+esp_err_t sd_codec_encode(uint8_t topic_index, const char *timestamp, const char *payload,
+                          uint8_t *out, size_t out_size, size_t *out_length);
+
+// Decode a body produced by sd_codec_encode(). ESP_ERR_INVALID_RESPONSE on
+// malformed input, ESP_ERR_INVALID_SIZE if a field does not fit its buffer.
+esp_err_t sd_codec_decode(const uint8_t *in, size_t in_length, uint8_t *topic_index,
+                          char *timestamp, size_t timestamp_size, char *payload, size_t payload_size);
+
+#endif // SD_CODEC_H
@@ -0,0 +1,515 @@
+// sd_history.c - Time-partitioned sensor historian on the SD card
+
+#include "sd_history.h"
+#include "sd_card_logger.h"
+#include "sensor_cache.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static const char *TAG = "SD_HISTORY";
+
+#ifndef SD_HISTORY_DIR                       // The host test keeps its history under /tmp
+#define SD_HISTORY_DIR "/sdcard/hist"
+#endif
+#define SD_HISTORY_PATH_MAX 48
+#define SD_HISTORY_MAGIC 0x31545348          // "HST1"
+#define SD_HISTORY_DAY 86400
+#define SD_HISTORY_MIN_TIME 1577836800       // 2020-01-01: the clock has been set
+#define SD_HISTORY_READ_ROWS 32              // Rows per read while streaming
+
+// File header, doubling as the file's index. Rewritten after every row; a
+// header that does not match the rows (power loss in between) is rebuilt.
+typedef struct {
+    uint32_t magic;
+    char unit_id[16];
+    uint32_t day;                            // UTC midnight, epoch seconds
+    uint32_t count;                          // Rows
+    uint32_t good;                           // SD_HISTORY_GOOD rows
+    uint32_t first_time;                     // Epoch seconds of the first and last row
+    uint32_t last_time;
+    float min_value;                         // Over good rows
+    float max_value;
+    double sum;
+    uint32_t reserved;
+    uint32_t crc;                            // Over everything before it
+} sd_history_header_t;
+
+typedef struct {
+    uint32_t time_quality;                   // Seconds since the day's midnight << 8 | quality
+    float value;
+} sd_history_row_t;
+
+_Static_assert(sizeof(sd_history_header_t) == 64, "history header layout");
+_Static_assert(sizeof(sd_history_row_t) == 8, "history row layout");
+
+// Day of the last recorded row; retention runs when it changes
+static uint32_t s_day = 0;
+
+// Query state: the bucket being filled
+typedef struct {
+    uint32_t bucket_sec;
+    sd_history_emit_fn emit;
+    void *ctx;
+    bool open;
+    bool stopped;
+    sd_history_point_t point;
+    double sum;
+} sd_history_cursor_t;
+
+static void sd_history_day_dir(uint32_t day, char *path, size_t size)
+{
+    time_t t = day;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    snprintf(path, size, "%s/%04d%02d%02d", SD_HISTORY_DIR, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+}
+
+static void sd_history_path(const char *unit_id, uint32_t day, char *path, size_t size)
+{
+    char dir[SD_HISTORY_PATH_MAX];
+    sd_history_day_dir(day, dir, sizeof(dir));
+    uint32_t hash = esp_rom_crc32_le(0, (const uint8_t *)unit_id, strlen(unit_id));
+    snprintf(path, size, "%s/%08lX.dat", dir, (unsigned long)hash);
+}
+
+static uint32_t sd_history_header_crc(const sd_history_header_t *header)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)header, offsetof(sd_history_header_t, crc));
+}
+
+static void sd_history_header_init(sd_history_header_t *header, const char *unit_id, uint32_t day)
+{
+    memset(header, 0, sizeof(*header));
+    header->magic = SD_HISTORY_MAGIC;
+    strncpy(header->unit_id, unit_id, sizeof(header->unit_id) - 1);
+    header->day = day;
+}
+
+static void sd_history_header_add(sd_history_header_t *header, uint32_t time, float value, uint8_t quality)
+{
+    if (header->count++ == 0) {
+        header->first_time = time;
+    }
+    header->last_time = time;
+    if (quality == SD_HISTORY_GOOD) {
+        if (header->good == 0 || value < header->min_value) header->min_value = value;
+        if (header->good == 0 || value > header->max_value) header->max_value = value;
+        header->good++;
+        header->sum += value;
+    }
+}
+
+// Read the header and count the whole rows in the file. A header that does
+// not describe those rows is rebuilt from them. False if the file belongs to
+// another unit ID with the same hash.
+static bool sd_history_load(FILE *fp, const char *unit_id, uint32_t day, sd_history_header_t *header, uint32_t *rows)
+{
+    long size = fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : 0;
+    *rows = size > (long)sizeof(*header) ? (uint32_t)((size - sizeof(*header)) / sizeof(sd_history_row_t)) : 0;
+
+    bool valid = fseek(fp, 0, SEEK_SET) == 0 && fread(header, sizeof(*header), 1, fp) == 1 &&
+                 header->magic == SD_HISTORY_MAGIC && header->crc == sd_history_header_crc(header);
+    if (valid && strncmp(header->unit_id, unit_id, sizeof(header->unit_id) - 1) != 0) {
+        return false;
+    }
+    if (valid && header->day == day && header->count == *rows) {
+        return true;
+    }
+
+    sd_history_header_init(header, unit_id, day);
+    sd_history_row_t chunk[SD_HISTORY_READ_ROWS];
+    fseek(fp, sizeof(*header), SEEK_SET);
+    for (uint32_t i = 0; i < *rows; ) {
+        uint32_t n = *rows - i < SD_HISTORY_READ_ROWS ? *rows - i : SD_HISTORY_READ_ROWS;
+        if (fread(chunk, sizeof(sd_history_row_t), n, fp) != n) {
+            *rows = i;
+            break;
+        }
+        for (uint32_t k = 0; k < n; k++) {
+            sd_history_header_add(header, day + (chunk[k].time_quality >> 8), chunk[k].value,
+                                  chunk[k].time_quality & 0xFF);
+        }
+        i += n;
+    }
+    return true;
+}
+
+// Remove a day directory and its files
+static void sd_history_remove_day(const char *dir)
+{
+    DIR *dp = opendir(dir);
+    if (dp) {
+        struct dirent *entry;
+        char path[SD_HISTORY_PATH_MAX + 16];
+        while ((entry = readdir(dp)) != NULL) {
+            if (entry->d_name[0] != '.') {
+                snprintf(path, sizeof(path), "%s/%.12s", dir, entry->d_name);
+                unlink(path);
+            }
+        }
+        closedir(dp);
+    }
+    rmdir(dir);
+}
+
+// Delete days that fell out of the retention window
+static void sd_history_prune(uint32_t today)
+{
+    if (mkdir(SD_HISTORY_DIR, 0775) != 0 && errno != EEXIST) {
+        ESP_LOGE(TAG, "[ERROR] Failed to create %s: %s", SD_HISTORY_DIR, strerror(errno));
+        return;
+    }
+
+    DIR *dp = opendir(SD_HISTORY_DIR);
+    if (!dp) {
+        return;
+    }
+    char dir[SD_HISTORY_PATH_MAX];
+    time_t oldest = (time_t)today - (time_t)SD_HISTORY_RETENTION_DAYS * SD_HISTORY_DAY;
+    int removed = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != NULL) {
+        char date[24];
+        time_t day;
+        if (strlen(entry->d_name) != 8 || strspn(entry->d_name, "0123456789") != 8) {
+            continue;
+        }
+        snprintf(date, sizeof(date), "%.4s-%.2s-%.2s", entry->d_name, entry->d_name + 4, entry->d_name + 6);
+        if (sd_history_parse_time(date, &day) && day < oldest) {
+            snprintf(dir, sizeof(dir), "%s/%s", SD_HISTORY_DIR, entry->d_name);
+            sd_history_remove_day(dir);
+            removed++;
+        }
+    }
+    closedir(dp);
+
+    if (removed > 0) {
+        ESP_LOGI(TAG, "[OK] Removed %d day(s) of history older than %d days", removed, SD_HISTORY_RETENTION_DAYS);
+    }
+}
+
+esp_err_t sd_history_record(const char *unit_id, time_t when, float value, uint8_t quality)
+{
+    if (!sd_card_is_available()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!unit_id || unit_id[0] == '\0' || when < SD_HISTORY_MIN_TIME) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t day = (uint32_t)(when - when % SD_HISTORY_DAY);
+    if (day != s_day) {
+        sd_history_prune(day);
+        s_day = day;
+    }
+
+    char path[SD_HISTORY_PATH_MAX];
+    sd_history_path(unit_id, day, path, sizeof(path));
+
+    sd_history_header_t header;
+    uint32_t rows = 0;
+    FILE *fp = fopen(path, "r+b");
+    if (fp) {
+        if (!sd_history_load(fp, unit_id, day, &header, &rows)) {
+            ESP_LOGW(TAG, "[WARN] %s already holds another unit's history, not recording %s", path, unit_id);
+            fclose(fp);
+            return ESP_ERR_INVALID_STATE;
+        }
+    } else {
+        char dir[SD_HISTORY_PATH_MAX];
+        sd_history_day_dir(day, dir, sizeof(dir));
+        mkdir(dir, 0775);
+        fp = fopen(path, "w+b");
+        if (!fp) {
+            ESP_LOGE(TAG, "[ERROR] Failed to create %s: %s", path, strerror(errno));
+            return ESP_FAIL;
+        }
+        sd_history_header_init(&header, unit_id, day);
+    }
+
+    // Rows stay in time order for the binary search; a clock step back drops rows
+    if (rows > 0 && (uint32_t)when < header.last_time) {
+        fclose(fp);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    sd_history_row_t row = {
+        .time_quality = ((uint32_t)(when - day) << 8) | quality,
+        .value = value,
+    };
+    sd_history_header_add(&header, (uint32_t)when, value, quality);
+    header.crc = sd_history_header_crc(&header);
+
+    bool ok = fseek(fp, (long)(sizeof(header) + rows * sizeof(row)), SEEK_SET) == 0 &&
+              fwrite(&row, sizeof(row), 1, fp) == 1 &&
+              fseek(fp, 0, SEEK_SET) == 0 &&
+              fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = fclose(fp) == 0 && ok;
+    if (!ok) {
+        ESP_LOGE(TAG, "[ERROR] Failed to write %s: %s", path, strerror(errno));
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+void sd_history_record_cycle(void)
+{
+    if (!sd_card_is_available()) {
+        return;
+    }
+    time_t now = time(NULL);
+    if (now < SD_HISTORY_MIN_TIME) {
+        return;  // Clock not set yet
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    uint32_t version = sensor_cache_version();
+    int recorded = 0;
+    for (int i = 0; i < SENSOR_CACHE_SLOTS; i++) {
+        sensor_cache_entry_t entry;
+        // Only sensors polled in the last cycle that have ever had a good reading
+        if (!sensor_cache_get(i, &entry) || entry.version != version || !entry.reading.valid) {
+            continue;
+        }
+        uint8_t quality = entry.last_error == ESP_OK ? SD_HISTORY_GOOD : SD_HISTORY_STALE;
+        time_t when = now - (time_t)((now_us - entry.attempt_time_us) / 1000000);
+        if (sd_history_record(entry.reading.unit_id, when, (float)entry.reading.value, quality) == ESP_OK) {
+            recorded++;
+        }
+    }
+    ESP_LOGD(TAG, "Recorded %d sensor(s)", recorded);
+}
+
+static void sd_history_emit(sd_history_cursor_t *cursor)
+{
+    if (cursor->open && !cursor->stopped) {
+        cursor->point.avg = cursor->point.good ? (float)(cursor->sum / cursor->point.good) : 0.0f;
+        cursor->stopped = !cursor->emit(&cursor->point, cursor->ctx);
+    }
+    cursor->open = false;
+}
+
+static void sd_history_add(sd_history_cursor_t *cursor, time_t time, float value, uint8_t quality)
+{
+    if (cursor->bucket_sec == 0) {
+        sd_history_point_t point = {
+            .time = time,
+            .count = 1,
+            .good = quality == SD_HISTORY_GOOD,
+            .min = value,
+            .max = value,
+            .avg = value,
+            .quality = quality,
+        };
+        cursor->stopped = !cursor->emit(&point, cursor->ctx);
+        return;
+    }
+
+    time_t bucket = time - time % cursor->bucket_sec;
+    if (cursor->open && cursor->point.time != bucket) {
+        sd_history_emit(cursor);
+    }
+    if (!cursor->open) {
+        memset(&cursor->point, 0, sizeof(cursor->point));
+        cursor->point.time = bucket;
+        cursor->sum = 0;
+        cursor->open = true;
+    }
+    cursor->point.count++;
+    if (quality == SD_HISTORY_GOOD) {
+        if (cursor->point.good == 0 || value < cursor->point.min) cursor->point.min = value;
+        if (cursor->point.good == 0 || value > cursor->point.max) cursor->point.max = value;
+        cursor->point.good++;
+        cursor->sum += value;
+    }
+}
+
+// First row at or after seconds-of-day
+static uint32_t sd_history_lower_bound(FILE *fp, uint32_t rows, uint32_t seconds)
+{
+    uint32_t low = 0;
+    uint32_t high = rows;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        sd_history_row_t row;
+        if (fseek(fp, (long)(sizeof(sd_history_header_t) + mid * sizeof(row)), SEEK_SET) != 0 ||
+            fread(&row, sizeof(row), 1, fp) != 1) {
+            return rows;
+        }
+        if ((row.time_quality >> 8) < seconds) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+esp_err_t sd_history_query(const char *unit_id, time_t from, time_t to, uint32_t bucket_sec,
+                           sd_history_emit_fn emit, void *ctx)
+{
+    if (!sd_card_is_available()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!unit_id || unit_id[0] == '\0' || !emit || from < 0 || to < from) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (to - from > (time_t)SD_HISTORY_MAX_SPAN_DAYS * SD_HISTORY_DAY) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    sd_history_cursor_t cursor = {
+        .bucket_sec = bucket_sec,
+        .emit = emit,
+        .ctx = ctx,
+    };
+    bool done = false;
+
+    for (time_t day = from - from % SD_HISTORY_DAY; day <= to && !done && !cursor.stopped; day += SD_HISTORY_DAY) {
+        char path[SD_HISTORY_PATH_MAX];
+        sd_history_path(unit_id, (uint32_t)day, path, sizeof(path));
+        FILE *fp = fopen(path, "rb");
+        if (!fp) {
+            continue;
+        }
+
+        sd_history_header_t header;
+        uint32_t rows = 0;
+        if (!sd_history_load(fp, unit_id, (uint32_t)day, &header, &rows) || rows == 0 ||
+            (time_t)header.last_time < from || (time_t)header.first_time > to) {
+            fclose(fp);
+            continue;
+        }
+
+        // Daily buckets of days fully inside the range come from the index alone
+        if (bucket_sec == SD_HISTORY_DAY && day >= from && day + SD_HISTORY_DAY - 1 <= to) {
+            sd_history_emit(&cursor);
+            cursor.point = (sd_history_point_t){
+                .time = day,
+                .count = header.count,
+                .good = header.good,
+                .min = header.min_value,
+                .max = header.max_value,
+            };
+            cursor.sum = header.sum;
+            cursor.open = true;
+            sd_history_emit(&cursor);
+            fclose(fp);
+            continue;
+        }
+
+        uint32_t i = from > day ? sd_history_lower_bound(fp, rows, (uint32_t)(from - day)) : 0;
+        sd_history_row_t chunk[SD_HISTORY_READ_ROWS];
+        while (i < rows && !done && !cursor.stopped) {
+            uint32_t n = rows - i < SD_HISTORY_READ_ROWS ? rows - i : SD_HISTORY_READ_ROWS;
+            if (fseek(fp, (long)(sizeof(header) + i * sizeof(sd_history_row_t)), SEEK_SET) != 0 ||
+                fread(chunk, sizeof(sd_history_row_t), n, fp) != n) {
+                break;
+            }
+            for (uint32_t k = 0; k < n && !cursor.stopped; k++) {
+                time_t time = day + (chunk[k].time_quality >> 8);
+                if (time > to) {
+                    done = true;
+                    break;
+                }
+                sd_history_add(&cursor, time, chunk[k].value, chunk[k].time_quality & 0xFF);
+            }
+            i += n;
+        }
+        fclose(fp);
+    }
+
+    sd_history_emit(&cursor);
+    return ESP_OK;
+}
+
+bool sd_history_parse_time(const char *text, time_t *out)
+{
+    if (!text || !out || text[0] == '\0') {
+        return false;
+    }
+    if (strspn(text, "0123456789") == strlen(text)) {
+        *out = (time_t)strtoll(text, NULL, 10);
+        return true;
+    }
+
+    unsigned year, month, day, hour = 0, minute = 0, second = 0;
+    int consumed = 0;
+    if (sscanf(text, "%4u-%2u-%2u%n", &year, &month, &day, &consumed) != 3) {
+        return false;
+    }
+    const char *rest = text + consumed;
+    if (*rest == 'T' || *rest == ' ') {
+        int n = 0;
+        if (sscanf(rest + 1, "%2u:%2u%n", &hour, &minute, &n) != 2) {
+            return false;
+        }
+        rest += 1 + n;
+        if (*rest == ':') {
+            if (sscanf(rest + 1, "%2u%n", &second, &n) != 1) {
+                return false;
+            }
+            rest += 1 + n;
+        }
+    }
+    if (*rest == 'Z') {
+        rest++;
+    }
+    if (*rest != '\0' || year < 1970 || month < 1 || month > 12 || day < 1 || day > 31 ||
+        hour > 23 || minute > 59 || second > 59) {
+        return false;
+    }
+
+    // Days since 1970-01-01 in the proleptic Gregorian calendar
+    unsigned y = year - (month <= 2);
+    unsigned era = y / 400;
+    unsigned yoe = y - era * 400;
+    unsigned doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = (int64_t)era * 146097 + doe - 719468;
+    *out = (time_t)(days * SD_HISTORY_DAY + hour * 3600 + minute * 60 + second);
+    return true;
+}
+
+bool sd_history_parse_interval(const char *text, uint32_t *seconds)
+{
+    if (!text || !seconds) {
+        return false;
+    }
+    if (strcmp(text, "raw") == 0) {
+        *seconds = 0;
+        return true;
+    }
+
+    char *end = NULL;
+    unsigned long value = strtoul(text, &end, 10);
+    if (end == text) {
+        return false;
+    }
+    unsigned long unit = 1;
+    switch (*end) {
+        case '\0': case 's': unit = 1; break;
+        case 'm': unit = 60; break;
+        case 'h': unit = 3600; break;
+        case 'd': unit = SD_HISTORY_DAY; break;
+        default: return false;
+    }
+    if (*end != '\0' && end[1] != '\0') {
+        return false;
+    }
+    if (value > (unsigned long)SD_HISTORY_MAX_SPAN_DAYS * SD_HISTORY_DAY / unit) {
+        return false;
+    }
+    *seconds = (uint32_t)(value * unit);
+    return true;
+}
@@ -0,0 +1,54 @@
+// sd_history.h - Time-partitioned sensor historian on the SD card
+// Every poll cycle appends one row per sensor to a per-day, per-sensor file:
+//   /sdcard/hist/YYYYMMDD/XXXXXXXX.dat   (XXXXXXXX = CRC-32 of the unit ID, 8.3 names)
+// A file is a 64-byte header (the file's index: unit ID, row count, time
+// range, min/max/sum of the good values) followed by fixed 8-byte rows in time
+// order, so a range query binary-searches its start and streams rows from
+// there. Days older than SD_HISTORY_RETENTION_DAYS are deleted.
+
+#ifndef SD_HISTORY_H
+#define SD_HISTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "esp_err.h"
+
+#define SD_HISTORY_RETENTION_DAYS 90
+#define SD_HISTORY_MAX_SPAN_DAYS 92         // Longest range one query may cover
+
+// Row quality
+#define SD_HISTORY_GOOD 0                   // Read in this poll cycle
+#define SD_HISTORY_STALE 1                  // Poll failed; value is the last good reading
+
+// One raw row (bucket_sec == 0) or one aggregated bucket
+typedef struct {
+    time_t time;                            // Row time, or bucket start
+    uint32_t count;                         // Rows in the bucket
+    uint32_t good;                          // Of which SD_HISTORY_GOOD; min/max/avg cover only these
+    float min;
+    float max;
+    float avg;                              // Raw rows: the value
+    uint8_t quality;                        // Raw rows only
+} sd_history_point_t;
+
+// Return false to stop the query (e.g. the client went away)
+typedef bool (*sd_history_emit_fn)(const sd_history_point_t *point, void *ctx);
+
+// Append one row. Rows older than the last one of the day are dropped.
+esp_err_t sd_history_record(const char *unit_id, time_t when, float value, uint8_t quality);
+
+// Append the outcome of the last poll cycle for every sensor in the sensor cache
+void sd_history_record_cycle(void);
+
+// Stream the rows of [from, to] in time order, raw (bucket_sec 0) or
+// aggregated into buckets aligned to multiples of bucket_sec.
+esp_err_t sd_history_query(const char *unit_id, time_t from, time_t to, uint32_t bucket_sec,
+                           sd_history_emit_fn emit, void *ctx);
+
+// "1700000000", "2026-10-17" or "2026-10-17T08:30[:00]" (UTC)
+bool sd_history_parse_time(const char *text, time_t *out);
+// "raw", "300", "30s", "5m", "1h", "1d"
+bool sd_history_parse_interval(const char *text, uint32_t *seconds);
+
+#endif // SD_HISTORY_H
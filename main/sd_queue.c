@@ -0,0 +1,896 @@
+// sd_queue.c - Segmented store-and-forward log for cached telemetry
+
+#include "sd_queue.h"
+#include "esp_log.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <strings.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <time.h>
+
+static const char *TAG = "SD_QUEUE";
+
+#define SD_QUEUE_INDEX_MAGIC 0x31584449     // "IDX1"
+#define SD_QUEUE_INDEX_FILE "index.bin"
+
+typedef struct {
+    uint16_t magic;
+    uint16_t length;
+    uint32_t id;
+    uint32_t crc;                           // Over magic, length, id and the body
+} sd_queue_header_t;
+
+// Persisted index, rewritten when appends are synced and when acks are saved.
+// Two slots are written alternately so a torn write always leaves the previous
+// index intact.
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t head_segment;
+    uint32_t head_offset;
+    uint32_t tail_segment;
+    uint32_t tail_offset;
+    uint32_t count;
+    uint32_t first_id;
+    uint32_t last_id;
+    uint32_t crc;
+} sd_queue_index_t;
+
+_Static_assert(sizeof(sd_queue_header_t) == SD_QUEUE_HEADER_SIZE, "record header layout");
+
+// Record body scratch; a queue is only used from one task at a time
+static uint8_t s_record[SD_QUEUE_MAX_RECORD];
+
+// CRC-32 (IEEE 802.3), nibble table
+static uint32_t sd_queue_crc32(uint32_t crc, const void *data, size_t length)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    const uint8_t *bytes = data;
+    crc = ~crc;
+    while (length--) {
+        crc ^= *bytes++;
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+static uint32_t sd_queue_record_crc(const sd_queue_header_t *header, const void *body)
+{
+    uint32_t crc = sd_queue_crc32(0, header, offsetof(sd_queue_header_t, crc));
+    return sd_queue_crc32(crc, body, header->length);
+}
+
+static int64_t sd_queue_now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sd_queue_segment_path(const sd_queue_t *queue, uint32_t segment, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%08lu.seg", queue->dir, (unsigned long)segment);
+}
+
+// Segment number of a directory entry, 0 if it is not a segment file
+static uint32_t sd_queue_parse_segment(const char *name)
+{
+    char *end = NULL;
+    unsigned long segment = strtoul(name, &end, 10);
+    if (end == name || strcasecmp(end, ".seg") != 0) {
+        return 0;
+    }
+    return (uint32_t)segment;
+}
+
+// Read bytes the segment is known to hold. A short read here is an I/O error
+// (or a file shorter than the bytes written to it), never the end of the data.
+static esp_err_t sd_queue_read_at(FILE *fp, uint32_t offset, void *buffer, size_t length)
+{
+    clearerr(fp);
+    if (fseek(fp, (long)offset, SEEK_SET) == 0 && fread(buffer, 1, length, fp) == length) {
+        return ESP_OK;
+    }
+    ESP_LOGE(TAG, "Failed to read %u bytes at offset %lu: %s", (unsigned)length, (unsigned long)offset,
+             ferror(fp) ? strerror(errno) : "file shorter than written");
+    return ESP_FAIL;
+}
+
+// Read and verify the record at offset in a segment holding end bytes.
+// ESP_ERR_NOT_FOUND when no complete record follows (end of segment or a torn
+// append), ESP_ERR_INVALID_CRC when the bytes there are not a valid record,
+// ESP_FAIL when the card could not be read.
+static esp_err_t sd_queue_read_record(FILE *fp, uint32_t offset, uint32_t end, sd_queue_header_t *header)
+{
+    if (offset >= end || end - offset < SD_QUEUE_HEADER_SIZE) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (sd_queue_read_at(fp, offset, header, sizeof(*header)) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if (header->magic != SD_QUEUE_RECORD_MAGIC || header->length == 0 || header->length > SD_QUEUE_MAX_RECORD) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    if (end - offset - SD_QUEUE_HEADER_SIZE < header->length) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (sd_queue_read_at(fp, offset + SD_QUEUE_HEADER_SIZE, s_record, header->length) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return sd_queue_record_crc(header, s_record) == header->crc ? ESP_OK : ESP_ERR_INVALID_CRC;
+}
+
+// Find the next valid record after corrupt bytes in a segment
+static esp_err_t sd_queue_resync(FILE *fp, uint32_t offset, uint32_t end, uint32_t *found)
+{
+    uint8_t magic[2];
+    for (; offset < end && end - offset >= SD_QUEUE_HEADER_SIZE; offset++) {
+        if (sd_queue_read_at(fp, offset, magic, sizeof(magic)) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        if ((magic[0] | (magic[1] << 8)) != SD_QUEUE_RECORD_MAGIC) {
+            continue;
+        }
+        sd_queue_header_t header;
+        esp_err_t ret = sd_queue_read_record(fp, offset, end, &header);
+        if (ret == ESP_OK) {
+            *found = offset;
+        }
+        if (ret == ESP_OK || ret == ESP_FAIL) {
+            return ret;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+static FILE *sd_queue_reader(sd_queue_t *queue, uint32_t segment)
+{
+    if (queue->read_fp && queue->read_segment == segment) {
+        return queue->read_fp;
+    }
+    if (queue->read_fp) {
+        fclose(queue->read_fp);
+        queue->read_fp = NULL;
+    }
+
+    char path[SD_QUEUE_PATH_MAX];
+    sd_queue_segment_path(queue, segment, path, sizeof(path));
+    queue->read_fp = fopen(path, "rb");
+    queue->read_segment = segment;
+    return queue->read_fp;
+}
+
+// Reader and written length of a segment: the tail offset for the tail
+// segment, the file size for the others. ESP_ERR_NOT_FOUND when the file does
+// not exist, ESP_FAIL when it exists but cannot be opened or sized.
+static esp_err_t sd_queue_open_segment(sd_queue_t *queue, uint32_t segment, FILE **fp, uint32_t *end)
+{
+    char path[SD_QUEUE_PATH_MAX];
+    struct stat st;
+
+    *fp = sd_queue_reader(queue, segment);
+    if (!*fp) {
+        sd_queue_segment_path(queue, segment, path, sizeof(path));
+        if (stat(path, &st) != 0 && errno == ENOENT) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        ESP_LOGE(TAG, "Failed to open %s: %s", path, strerror(errno));
+        return ESP_FAIL;
+    }
+    if (segment == queue->tail_segment) {
+        *end = queue->tail_offset;
+        return ESP_OK;
+    }
+    if (fstat(fileno(*fp), &st) != 0) {
+        ESP_LOGE(TAG, "Failed to size segment %lu: %s", (unsigned long)segment, strerror(errno));
+        return ESP_FAIL;
+    }
+    *end = (uint32_t)st.st_size;
+    return ESP_OK;
+}
+
+// Drop the cached reader after a failed read so the next attempt reopens the file
+static void sd_queue_drop_reader(sd_queue_t *queue)
+{
+    if (queue->read_fp) {
+        fclose(queue->read_fp);
+        queue->read_fp = NULL;
+    }
+}
+
+static esp_err_t sd_queue_save_index(sd_queue_t *queue)
+{
+    if (!queue->index_fp) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    sd_queue_index_t index = {
+        .magic = SD_QUEUE_INDEX_MAGIC,
+        .seq = queue->index_seq + 1,
+        .head_segment = queue->head_segment,
+        .head_offset = queue->head_offset,
+        .tail_segment = queue->tail_segment,
+        .tail_offset = queue->tail_offset,
+        .count = queue->count,
+        .first_id = queue->first_id,
+        .last_id = queue->last_id,
+    };
+    index.crc = sd_queue_crc32(0, &index, offsetof(sd_queue_index_t, crc));
+
+    long slot = (long)(index.seq & 1) * (long)sizeof(index);
+    if (fseek(queue->index_fp, slot, SEEK_SET) != 0 || fwrite(&index, sizeof(index), 1, queue->index_fp) != 1 ||
+        fflush(queue->index_fp) != 0) {
+        ESP_LOGE(TAG, "Failed to write index: %s", strerror(errno));
+        return ESP_FAIL;
+    }
+    fsync(fileno(queue->index_fp));
+    queue->index_seq = index.seq;
+    queue->unsaved_acks = 0;
+    return ESP_OK;
+}
+
+static bool sd_queue_load_index(sd_queue_t *queue, sd_queue_index_t *best)
+{
+    bool found = false;
+    for (int slot = 0; slot < 2; slot++) {
+        sd_queue_index_t index;
+        if (fseek(queue->index_fp, (long)(slot * sizeof(index)), SEEK_SET) != 0 ||
+            fread(&index, sizeof(index), 1, queue->index_fp) != 1) {
+            continue;
+        }
+        if (index.magic != SD_QUEUE_INDEX_MAGIC ||
+            index.crc != sd_queue_crc32(0, &index, offsetof(sd_queue_index_t, crc))) {
+            continue;
+        }
+        if (!found || index.seq > best->seq) {
+            *best = index;
+            found = true;
+        }
+    }
+    return found;
+}
+
+// Walk the record headers from the head to count the pending records. Only
+// needed when the index cannot be trusted (first open, crash, skipped corruption).
+static void sd_queue_recount(sd_queue_t *queue)
+{
+    if (queue->unsynced) {
+        sd_queue_flush(queue);
+    }
+    queue->count = 0;
+    queue->first_id = 0;
+    for (uint32_t segment = queue->head_segment; segment <= queue->tail_segment; segment++) {
+        FILE *fp;
+        uint32_t end;
+        if (sd_queue_open_segment(queue, segment, &fp, &end) != ESP_OK) {
+            continue;
+        }
+        uint32_t offset = segment == queue->head_segment ? queue->head_offset : 0;
+        sd_queue_header_t header;
+        while (offset < end && fseek(fp, (long)offset, SEEK_SET) == 0 &&
+               fread(&header, sizeof(header), 1, fp) == 1 && header.magic == SD_QUEUE_RECORD_MAGIC &&
+               header.length > 0 && header.length <= SD_QUEUE_MAX_RECORD &&
+               offset + SD_QUEUE_HEADER_SIZE + header.length <= end) {
+            if (queue->count++ == 0) {
+                queue->first_id = header.id;
+            }
+            offset += SD_QUEUE_HEADER_SIZE + header.length;
+        }
+    }
+}
+
+// ID of the record at the head, read without verifying the record (0 if none)
+static uint32_t sd_queue_read_head_id(sd_queue_t *queue)
+{
+    for (uint32_t segment = queue->head_segment; segment <= queue->tail_segment; segment++) {
+        FILE *fp = sd_queue_reader(queue, segment);
+        uint32_t offset = segment == queue->head_segment ? queue->head_offset : 0;
+        sd_queue_header_t header;
+        if (fp && fseek(fp, (long)offset, SEEK_SET) == 0 && fread(&header, sizeof(header), 1, fp) == 1 &&
+            header.magic == SD_QUEUE_RECORD_MAGIC) {
+            return header.id;
+        }
+    }
+    return 0;
+}
+
+// Move the head to the start of the next segment and delete the consumed one.
+// The index is persisted first, so a crash in between only leaves a stale
+// file that the next open removes.
+static esp_err_t sd_queue_advance_segment(sd_queue_t *queue)
+{
+    uint32_t consumed = queue->head_segment;
+    if (queue->read_fp && queue->read_segment == consumed) {
+        fclose(queue->read_fp);
+        queue->read_fp = NULL;
+    }
+
+    queue->head_segment++;
+    queue->head_offset = 0;
+    queue->head_valid = false;
+    esp_err_t ret = sd_queue_save_index(queue);
+
+    char path[SD_QUEUE_PATH_MAX];
+    sd_queue_segment_path(queue, consumed, path, sizeof(path));
+    remove(path);
+    return ret;
+}
+
+// Start a new tail segment. Callers flush first; anything still staged is dropped.
+static void sd_queue_roll_tail(sd_queue_t *queue)
+{
+    if (queue->write_fp) {
+        fclose(queue->write_fp);
+        queue->write_fp = NULL;
+    }
+    queue->tail_segment++;
+    queue->tail_offset = 0;
+    queue->stage_length = 0;
+}
+
+// Hand staged bytes to the tail segment. With whole_sectors only the part
+// ending on a sector boundary of the file is written; the rest stays staged.
+static esp_err_t sd_queue_write_stage(sd_queue_t *queue, bool whole_sectors)
+{
+    uint32_t start = queue->tail_offset - queue->stage_length;
+    uint32_t length = queue->stage_length;
+    if (whole_sectors) {
+        uint32_t end = queue->tail_offset & ~(uint32_t)(SD_QUEUE_SECTOR_SIZE - 1);
+        length = end > start ? end - start : 0;
+    }
+    if (length == 0) {
+        return ESP_OK;
+    }
+
+    if (!queue->write_fp) {
+        char path[SD_QUEUE_PATH_MAX];
+        sd_queue_segment_path(queue, queue->tail_segment, path, sizeof(path));
+        queue->write_fp = fopen(path, "ab");
+        if (!queue->write_fp) {
+            ESP_LOGE(TAG, "Failed to open %s: %s", path, strerror(errno));
+            return ESP_FAIL;
+        }
+        // The stage is the buffer; writes go straight to the filesystem
+        setvbuf(queue->write_fp, NULL, _IONBF, 0);
+    }
+
+    if (fwrite(queue->stage, 1, length, queue->write_fp) != length) {
+        ESP_LOGE(TAG, "Failed to write segment %lu: %s, %u staged bytes lost",
+                 (unsigned long)queue->tail_segment, strerror(errno), (unsigned)queue->stage_length);
+        // The segment may now end in a partial record; keep it out of the append path
+        queue->unsynced = false;
+        sd_queue_roll_tail(queue);
+        sd_queue_recount(queue);
+        return ESP_FAIL;
+    }
+
+    queue->stage_length -= length;
+    memmove(queue->stage, queue->stage + length, queue->stage_length);
+    return ESP_OK;
+}
+
+// Find the append position: the end of the last valid record in the newest segment
+static void sd_queue_recover_tail(sd_queue_t *queue, uint32_t last_segment)
+{
+    queue->tail_segment = last_segment;
+    queue->tail_offset = 0;
+
+    char path[SD_QUEUE_PATH_MAX];
+    sd_queue_segment_path(queue, last_segment, path, sizeof(path));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return;
+    }
+
+    struct stat st;
+    long size = fstat(fileno(fp), &st) == 0 ? (long)st.st_size : 0;
+    uint32_t offset = 0;
+    sd_queue_header_t header;
+    while (sd_queue_read_record(fp, offset, (uint32_t)size, &header) == ESP_OK) {
+        queue->last_id = header.id;
+        offset += SD_QUEUE_HEADER_SIZE + header.length;
+    }
+    queue->tail_offset = offset;
+    fclose(fp);
+
+    if (size > (long)offset) {
+        // Torn append (e.g. power loss); readers skip the garbage, new records go to the next segment
+        ESP_LOGW(TAG, "[WARN] Segment %lu has %ld unreadable bytes after offset %lu",
+                 (unsigned long)last_segment, size - (long)offset, (unsigned long)offset);
+        sd_queue_roll_tail(queue);
+    }
+}
+
+esp_err_t sd_queue_open(sd_queue_t *queue, const char *dir)
+{
+    if (!queue || !dir || strlen(dir) >= sizeof(queue->dir)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(queue, 0, sizeof(sd_queue_t));
+    strncpy(queue->dir, dir, sizeof(queue->dir) - 1);
+
+    if (mkdir(dir, 0775) != 0 && errno != EEXIST) {
+        ESP_LOGE(TAG, "Failed to create %s: %s", dir, strerror(errno));
+        return ESP_FAIL;
+    }
+
+    // Segment range on disk
+    uint32_t first_segment = 0;
+    uint32_t last_segment = 0;
+    DIR *dp = opendir(dir);
+    if (!dp) {
+        ESP_LOGE(TAG, "Failed to open %s: %s", dir, strerror(errno));
+        return ESP_FAIL;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dp)) != NULL) {
+        uint32_t segment = sd_queue_parse_segment(entry->d_name);
+        if (segment == 0) {
+            continue;
+        }
+        if (first_segment == 0 || segment < first_segment) first_segment = segment;
+        if (segment > last_segment) last_segment = segment;
+    }
+    closedir(dp);
+
+    char path[SD_QUEUE_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, SD_QUEUE_INDEX_FILE);
+    queue->index_fp = fopen(path, "r+b");
+    if (!queue->index_fp) {
+        queue->index_fp = fopen(path, "w+b");
+    }
+    if (!queue->index_fp) {
+        ESP_LOGE(TAG, "Failed to open index %s: %s", path, strerror(errno));
+        return ESP_FAIL;
+    }
+
+    sd_queue_index_t index = {0};
+    bool have_index = sd_queue_load_index(queue, &index);
+    if (have_index) {
+        queue->index_seq = index.seq;
+        queue->head_segment = index.head_segment;
+        queue->head_offset = index.head_offset;
+        queue->last_id = index.last_id;
+    } else {
+        queue->head_segment = first_segment ? first_segment : 1;
+        queue->head_offset = 0;
+    }
+    if (first_segment && queue->head_segment < first_segment) {
+        queue->head_segment = first_segment;
+        queue->head_offset = 0;
+        have_index = false;
+    }
+
+    // Consumed segments left behind by an interrupted delete
+    for (uint32_t segment = first_segment; first_segment && segment < queue->head_segment; segment++) {
+        sd_queue_segment_path(queue, segment, path, sizeof(path));
+        remove(path);
+    }
+
+    // The index is trusted if the tail segment ends exactly where it says, i.e.
+    // nothing was appended or torn after it was last written
+    if (have_index && last_segment <= index.tail_segment) {
+        struct stat st;
+        sd_queue_segment_path(queue, index.tail_segment, path, sizeof(path));
+        long size = stat(path, &st) == 0 ? (long)st.st_size : 0;
+        have_index = size == (long)index.tail_offset;
+    } else {
+        have_index = false;
+    }
+
+    if (have_index) {
+        queue->tail_segment = index.tail_segment;
+        queue->tail_offset = index.tail_offset;
+        queue->count = index.count;
+        queue->first_id = index.first_id;
+    } else {
+        if (last_segment >= queue->head_segment) {
+            sd_queue_recover_tail(queue, last_segment);
+            if (queue->head_segment == queue->tail_segment && queue->head_offset > queue->tail_offset) {
+                queue->head_offset = queue->tail_offset;
+            }
+        } else {
+            // Everything was consumed
+            queue->head_offset = 0;
+            queue->tail_segment = queue->head_segment;
+            queue->tail_offset = 0;
+        }
+        sd_queue_recount(queue);
+        sd_queue_save_index(queue);
+        ESP_LOGW(TAG, "[WARN] Queue index rebuilt: %lu pending", (unsigned long)queue->count);
+    }
+
+    queue->open = true;
+    ESP_LOGI(TAG, "[OK] Queue %s: %lu pending (IDs %lu-%lu), head %lu@%lu, tail %lu@%lu", dir,
+             (unsigned long)queue->count, (unsigned long)queue->first_id, (unsigned long)queue->last_id,
+             (unsigned long)queue->head_segment, (unsigned long)queue->head_offset,
+             (unsigned long)queue->tail_segment, (unsigned long)queue->tail_offset);
+    return ESP_OK;
+}
+
+void sd_queue_close(sd_queue_t *queue)
+{
+    if (!queue) {
+        return;
+    }
+    if (queue->open) {
+        sd_queue_flush(queue);
+    }
+    if (queue->write_fp) fclose(queue->write_fp);
+    if (queue->read_fp) fclose(queue->read_fp);
+    if (queue->index_fp) fclose(queue->index_fp);
+    queue->write_fp = NULL;
+    queue->read_fp = NULL;
+    queue->index_fp = NULL;
+    queue->open = false;
+}
+
+// Drop every record, keeping the directory
+esp_err_t sd_queue_clear(sd_queue_t *queue)
+{
+    if (!queue || !queue->open) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    char dir[sizeof(queue->dir)];
+    strncpy(dir, queue->dir, sizeof(dir));
+    uint32_t first = queue->head_segment;
+    uint32_t last = queue->tail_segment;
+    queue->stage_length = 0;
+    queue->unsynced = false;
+    sd_queue_close(queue);
+
+    char path[SD_QUEUE_PATH_MAX];
+    for (uint32_t segment = first; segment <= last; segment++) {
+        snprintf(path, sizeof(path), "%s/%08lu.seg", dir, (unsigned long)segment);
+        remove(path);
+    }
+    snprintf(path, sizeof(path), "%s/%s", dir, SD_QUEUE_INDEX_FILE);
+    remove(path);
+
+    // Message IDs keep counting up across a clear
+    uint32_t last_id = queue->last_id;
+    uint8_t sync = queue->sync;
+    uint32_t flush_interval_ms = queue->flush_interval_ms;
+    esp_err_t ret = sd_queue_open(queue, dir);
+    if (ret == ESP_OK) {
+        sd_queue_set_sync(queue, (sd_queue_sync_t)sync, flush_interval_ms);
+        if (last_id > queue->last_id) {
+            queue->last_id = last_id;
+            sd_queue_save_index(queue);
+        }
+    }
+    return ret;
+}
+
+void sd_queue_set_sync(sd_queue_t *queue, sd_queue_sync_t sync, uint32_t flush_interval_ms)
+{
+    if (!queue) {
+        return;
+    }
+    queue->sync = (uint8_t)sync;
+    queue->flush_interval_ms = flush_interval_ms;
+}
+
+esp_err_t sd_queue_append(sd_queue_t *queue, uint32_t id, const void *body, uint16_t length)
+{
+    if (!queue || !queue->open) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!body || length == 0 || length > SD_QUEUE_MAX_RECORD) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t ret;
+    uint32_t size = SD_QUEUE_HEADER_SIZE + length;
+    if (queue->tail_offset > 0 && queue->tail_offset + size > SD_QUEUE_SEGMENT_SIZE) {
+        // The stage only ever holds the tail segment
+        ret = sd_queue_flush(queue);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        sd_queue_roll_tail(queue);
+        if (queue->tail_segment - queue->head_segment >= SD_QUEUE_MAX_SEGMENTS) {
+            ESP_LOGW(TAG, "[WARN] Queue full, dropping segment %lu", (unsigned long)queue->head_segment);
+            sd_queue_advance_segment(queue);
+            sd_queue_recount(queue);
+        }
+    }
+
+    if (queue->stage_length + size > SD_QUEUE_STAGE_SIZE) {
+        ret = sd_queue_write_stage(queue, true);
+        if (ret == ESP_OK && queue->stage_length + size > SD_QUEUE_STAGE_SIZE) {
+            ret = sd_queue_write_stage(queue, false);
+        }
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    sd_queue_header_t header = {
+        .magic = SD_QUEUE_RECORD_MAGIC,
+        .length = length,
+        .id = id,
+    };
+    header.crc = sd_queue_record_crc(&header, body);
+    memcpy(queue->stage + queue->stage_length, &header, sizeof(header));
+    memcpy(queue->stage + queue->stage_length + sizeof(header), body, length);
+    queue->stage_length += size;
+
+    queue->tail_offset += size;
+    queue->last_id = id;
+    if (queue->count++ == 0) {
+        queue->first_id = id;
+    }
+    if (!queue->unsynced) {
+        queue->unsynced = true;
+        queue->unsynced_since_ms = sd_queue_now_ms();
+    }
+
+    if (queue->sync == SD_QUEUE_SYNC_RECORD) {
+        return sd_queue_flush(queue);
+    }
+    return ESP_OK;
+}
+
+esp_err_t sd_queue_flush(sd_queue_t *queue)
+{
+    if (!queue || !queue->open) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!queue->unsynced) {
+        return queue->unsaved_acks > 0 ? sd_queue_save_index(queue) : ESP_OK;
+    }
+
+    esp_err_t ret = sd_queue_write_stage(queue, false);
+    if (ret == ESP_OK && queue->write_fp && fsync(fileno(queue->write_fp)) != 0) {
+        ESP_LOGE(TAG, "Failed to sync segment %lu: %s", (unsigned long)queue->tail_segment, strerror(errno));
+        ret = ESP_FAIL;
+    }
+    queue->unsynced = false;
+
+    // A FAT file opened for reading does not see the file grow; reopen it on the next read
+    if (queue->read_fp && queue->read_segment == queue->tail_segment) {
+        fclose(queue->read_fp);
+        queue->read_fp = NULL;
+    }
+
+    esp_err_t index_ret = sd_queue_save_index(queue);
+    return ret != ESP_OK ? ret : index_ret;
+}
+
+esp_err_t sd_queue_flush_due(sd_queue_t *queue)
+{
+    if (!queue || !queue->open) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (queue->sync != SD_QUEUE_SYNC_PERIODIC) {
+        return ESP_OK;
+    }
+    int64_t now_ms = sd_queue_now_ms();
+    bool appends_due = queue->unsynced &&
+                       now_ms - queue->unsynced_since_ms >= (int64_t)queue->flush_interval_ms;
+    bool acks_due = queue->unsaved_acks > 0 &&
+                    now_ms - queue->unsaved_acks_since_ms >= (int64_t)queue->flush_interval_ms;
+    return appends_due || acks_due ? sd_queue_flush(queue) : ESP_OK;
+}
+
+esp_err_t sd_queue_peek(sd_queue_t *queue, uint32_t *id, void *body, size_t body_size, uint16_t *length)
+{
+    if (!queue || !queue->open) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    while (true) {
+        // Records in the tail segment are read back from the card
+        if (queue->unsynced && queue->head_segment == queue->tail_segment) {
+            sd_queue_flush(queue);
+        }
+        if (queue->head_segment == queue->tail_segment && queue->head_offset >= queue->tail_offset) {
+            queue->head_valid = false;
+            if (queue->count != 0) {
+                queue->count = 0;
+                queue->first_id = 0;
+                sd_queue_save_index(queue);
+            }
+            return ESP_ERR_NOT_FOUND;
+        }
+
+        FILE *fp;
+        uint32_t end = 0;
+        sd_queue_header_t header;
+        esp_err_t ret = sd_queue_open_segment(queue, queue->head_segment, &fp, &end);
+        if (ret == ESP_OK) {
+            ret = sd_queue_read_record(fp, queue->head_offset, end, &header);
+        }
+
+        if (ret == ESP_OK) {
+            if (body && body_size < header.length) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            if (body) {
+                memcpy(body, s_record, header.length);
+            }
+            if (id) *id = header.id;
+            if (length) *length = header.length;
+            queue->head_valid = true;
+            queue->head_id = header.id;
+            queue->head_length = header.length;
+            return ESP_OK;
+        }
+
+        uint32_t next = 0;
+        if (ret == ESP_ERR_INVALID_CRC) {
+            ret = sd_queue_resync(fp, queue->head_offset + 1, end, &next);
+        }
+        if (ret == ESP_FAIL) {
+            // Leave the segment in place: the records may still be readable on a retry or after a remount
+            ESP_LOGE(TAG, "Failed to read segment %lu at offset %lu", (unsigned long)queue->head_segment,
+                     (unsigned long)queue->head_offset);
+            sd_queue_drop_reader(queue);
+            return ESP_FAIL;
+        }
+        if (ret == ESP_OK) {
+            queue->corrupt_skips++;
+            ESP_LOGW(TAG, "[WARN] Skipped %lu corrupt bytes in segment %lu",
+                     (unsigned long)(next - queue->head_offset), (unsigned long)queue->head_segment);
+            queue->head_offset = next;
+            sd_queue_recount(queue);
+            sd_queue_save_index(queue);
+            continue;
+        }
+
+        // Nothing readable left before the segment's written length
+        if (queue->head_segment == queue->tail_segment) {
+            ESP_LOGW(TAG, "[WARN] Unreadable records at the end of segment %lu", (unsigned long)queue->head_segment);
+            sd_queue_roll_tail(queue);
+        }
+        sd_queue_advance_segment(queue);
+        sd_queue_recount(queue);
+        sd_queue_save_index(queue);
+    }
+}
+
+esp_err_t sd_queue_read_next(sd_queue_t *queue, uint32_t *id, void *body, size_t body_size, uint16_t *length)
+{
+    if (!queue || !queue->open) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // At the head, peek does the reading and skips anything unreadable
+    if (!queue->scan_valid || queue->scan_segment < queue->head_segment ||
+        (queue->scan_segment == queue->head_segment && queue->scan_offset <= queue->head_offset)) {
+        esp_err_t ret = sd_queue_peek(queue, id, body, body_size, length);
+        if (ret == ESP_OK) {
+            queue->scan_valid = true;
+            queue->scan_segment = queue->head_segment;
+            queue->scan_offset = queue->head_offset + SD_QUEUE_HEADER_SIZE + queue->head_length;
+        }
+        return ret;
+    }
+
+    while (true) {
+        bool in_tail = queue->scan_segment >= queue->tail_segment;
+        if (in_tail && queue->scan_offset >= queue->tail_offset) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        if (in_tail && queue->unsynced) {
+            sd_queue_flush(queue);
+            continue;
+        }
+
+        FILE *fp;
+        uint32_t end = 0;
+        sd_queue_header_t header;
+        esp_err_t ret = sd_queue_open_segment(queue, queue->scan_segment, &fp, &end);
+        if (ret == ESP_OK) {
+            ret = sd_queue_read_record(fp, queue->scan_offset, end, &header);
+        }
+
+        if (ret == ESP_OK) {
+            if (body && body_size < header.length) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            if (body) {
+                memcpy(body, s_record, header.length);
+            }
+            if (id) *id = header.id;
+            if (length) *length = header.length;
+            queue->scan_offset += SD_QUEUE_HEADER_SIZE + header.length;
+            return ESP_OK;
+        }
+
+        // Peek skips the same bytes once the head gets here
+        uint32_t next = 0;
+        if (ret == ESP_ERR_INVALID_CRC) {
+            ret = sd_queue_resync(fp, queue->scan_offset + 1, end, &next);
+        }
+        if (ret == ESP_FAIL) {
+            // The cursor stays put so the next call retries the same record
+            ESP_LOGE(TAG, "Failed to read segment %lu at offset %lu", (unsigned long)queue->scan_segment,
+                     (unsigned long)queue->scan_offset);
+            sd_queue_drop_reader(queue);
+            return ESP_FAIL;
+        }
+        if (ret == ESP_OK) {
+            queue->corrupt_skips++;
+            queue->scan_offset = next;
+            continue;
+        }
+        if (in_tail) {
+            return ESP_ERR_NOT_FOUND;
+        }
+        queue->scan_segment++;
+        queue->scan_offset = 0;
+    }
+}
+
+void sd_queue_rewind(sd_queue_t *queue)
+{
+    if (queue) {
+        queue->scan_valid = false;
+    }
+}
+
+esp_err_t sd_queue_ack(sd_queue_t *queue, uint32_t id)
+{
+    if (!queue || !queue->open) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!queue->head_valid) {
+        esp_err_t ret = sd_queue_peek(queue, NULL, NULL, 0, NULL);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    if (queue->head_id != id) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    queue->head_offset += SD_QUEUE_HEADER_SIZE + queue->head_length;
+    queue->head_valid = false;
+    if (queue->count > 0) {
+        queue->count--;
+    }
+
+    queue->first_id = queue->count > 0 ? sd_queue_read_head_id(queue) : 0;
+
+    // Delete a segment as soon as its last record is consumed
+    if (queue->head_segment < queue->tail_segment) {
+        FILE *fp;
+        uint32_t end;
+        esp_err_t ret = sd_queue_open_segment(queue, queue->head_segment, &fp, &end);
+        if (ret == ESP_ERR_NOT_FOUND || (ret == ESP_OK && queue->head_offset >= end)) {
+            return sd_queue_advance_segment(queue);
+        }
+        // On ESP_FAIL the next peek finds out whether anything follows
+    }
+
+    if (queue->unsaved_acks++ == 0) {
+        queue->unsaved_acks_since_ms = sd_queue_now_ms();
+    }
+    // A drained queue is saved at once rather than replayed after a crash
+    if (queue->sync == SD_QUEUE_SYNC_RECORD || queue->unsaved_acks >= SD_QUEUE_ACK_SAVE_EVERY ||
+        queue->count == 0) {
+        return sd_queue_save_index(queue);
+    }
+    return ESP_OK;
+}
+
+esp_err_t sd_queue_count(sd_queue_t *queue, uint32_t *count)
+{
+    if (!queue || !count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *count = queue->open ? queue->count : 0;
+    return queue->open ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
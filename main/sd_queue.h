@@ -0,0 +1,132 @@
+// sd_queue.h - Segmented store-and-forward log for cached telemetry
+// Records are appended to fixed-size segment files in one directory and
+// consumed in order from a persisted head cursor. Acknowledging a record only
+// advances the cursor; a segment file is deleted once every record in it has
+// been consumed. A small index file (head, tail, pending count and ID range)
+// is rewritten when appends are synced and acks saved, so counts and the last
+// message ID are known at open without reading the segments. Only stdio/POSIX
+// file calls are used, so the same code runs over the FAT mount on the device
+// and over a plain directory on a host build.
+//
+// Appends are staged in RAM and handed to the card in whole sectors; the sync
+// policy decides when staged and written records are forced out with fsync,
+// and how often acks are saved to the index.
+//
+// Record layout: 12-byte header (magic, body length, message ID, CRC-32 of
+// header fields and body) followed by the body. Torn or corrupt records are
+// skipped on read. If the index does not match the tail segment (power loss
+// mid-append) the tail is recovered by scanning the last segment and the
+// pending records are recounted.
+
+#ifndef SD_QUEUE_H
+#define SD_QUEUE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Layout
+#define SD_QUEUE_SEGMENT_SIZE (64 * 1024)   // A new segment starts when a record would not fit
+#define SD_QUEUE_MAX_SEGMENTS 160           // ~10 MB; the oldest segment is dropped beyond this
+#define SD_QUEUE_MAX_RECORD 1024            // Largest record body
+#define SD_QUEUE_RECORD_MAGIC 0x5153
+#define SD_QUEUE_HEADER_SIZE 12
+#define SD_QUEUE_PATH_MAX 64
+
+// Write-behind
+#define SD_QUEUE_STAGE_SIZE 4096            // RAM stage for appends
+#define SD_QUEUE_SECTOR_SIZE 512            // A full stage is written up to a sector boundary
+#define SD_QUEUE_ACK_SAVE_EVERY 32          // Acks between index writes when the sync policy stages
+
+// When appended records are made durable. Acks follow the same policy: under
+// RECORD each one rewrites the index, otherwise the index is rewritten every
+// SD_QUEUE_ACK_SAVE_EVERY acks, when the queue drains and by the flushes that
+// make appends durable. A crash in between replays the unsaved acks.
+typedef enum {
+    SD_QUEUE_SYNC_RECORD = 0,   // Written and fsync'd before sd_queue_append() returns
+    SD_QUEUE_SYNC_PERIODIC,     // Staged; fsync'd by sd_queue_flush_due() once the interval has passed
+    SD_QUEUE_SYNC_BATCH         // Staged; fsync'd only by sd_queue_flush() (close, shutdown, reads)
+} sd_queue_sync_t;
+
+typedef struct {
+    char dir[SD_QUEUE_PATH_MAX - 16];
+    bool open;
+
+    // Oldest unacknowledged record
+    uint32_t head_segment;
+    uint32_t head_offset;
+    // Next append position
+    uint32_t tail_segment;
+    uint32_t tail_offset;
+    uint32_t count;                         // Unacknowledged records
+    uint32_t first_id;                      // ID of the oldest pending record, 0 if empty
+    uint32_t last_id;                       // ID of the newest record ever appended, kept when empty
+    uint32_t corrupt_skips;                 // Corrupt stretches skipped by peek or read-ahead since open
+
+    // Record at the head, valid after a successful peek
+    bool head_valid;
+    uint32_t head_id;
+    uint16_t head_length;
+
+    // Read-ahead cursor of sd_queue_read_next(), never behind the head
+    bool scan_valid;
+    uint32_t scan_segment;
+    uint32_t scan_offset;
+
+    // Write-behind stage: the last stage_length bytes before tail_offset
+    uint8_t sync;                           // sd_queue_sync_t
+    uint32_t flush_interval_ms;
+    bool unsynced;                          // Records appended since the last fsync
+    int64_t unsynced_since_ms;
+    uint16_t stage_length;
+    uint8_t stage[SD_QUEUE_STAGE_SIZE];
+    uint32_t unsaved_acks;                  // Acks since the index was last persisted
+    int64_t unsaved_acks_since_ms;
+
+    uint32_t index_seq;                     // Sequence of the last persisted index slot
+    FILE *write_fp;                         // Tail segment, kept open between appends
+    FILE *read_fp;                          // Head segment
+    uint32_t read_segment;
+    FILE *index_fp;
+} sd_queue_t;
+
+// Lifecycle. open creates the directory if needed and recovers head and tail.
+esp_err_t sd_queue_open(sd_queue_t *queue, const char *dir);
+void sd_queue_close(sd_queue_t *queue);
+esp_err_t sd_queue_clear(sd_queue_t *queue);
+
+// Sync policy (SD_QUEUE_SYNC_RECORD after open)
+void sd_queue_set_sync(sd_queue_t *queue, sd_queue_sync_t sync, uint32_t flush_interval_ms);
+
+// Append one record (body up to SD_QUEUE_MAX_RECORD bytes). ESP_FAIL means a
+// write to the card failed; staged records that were not written are lost.
+esp_err_t sd_queue_append(sd_queue_t *queue, uint32_t id, const void *body, uint16_t length);
+
+// Write everything staged, fsync and persist the index (also after acks alone)
+esp_err_t sd_queue_flush(sd_queue_t *queue);
+// sd_queue_flush() if the periodic interval has passed since the oldest unsynced
+// append or unsaved ack
+esp_err_t sd_queue_flush_due(sd_queue_t *queue);
+
+// Read the oldest unacknowledged record without consuming it.
+// ESP_ERR_NOT_FOUND when the queue is empty. ESP_FAIL when the card could not
+// be read; nothing is skipped or deleted and the next call retries the record.
+esp_err_t sd_queue_peek(sd_queue_t *queue, uint32_t *id, void *body, size_t body_size, uint16_t *length);
+
+// Read the record after the one last returned, starting at the head after open,
+// clear or sd_queue_rewind(). Nothing is consumed: records read ahead are still
+// acknowledged one by one, in order, with sd_queue_ack().
+// ESP_ERR_NOT_FOUND when every pending record has been read, ESP_FAIL as for
+// sd_queue_peek().
+esp_err_t sd_queue_read_next(sd_queue_t *queue, uint32_t *id, void *body, size_t body_size, uint16_t *length);
+void sd_queue_rewind(sd_queue_t *queue);
+
+// Consume the record at the head. ESP_ERR_NOT_FOUND if id is not the head record.
+// Persisted according to the sync policy (see sd_queue_sync_t).
+esp_err_t sd_queue_ack(sd_queue_t *queue, uint32_t id);
+
+// Number of unacknowledged records, from the index
+esp_err_t sd_queue_count(sd_queue_t *queue, uint32_t *count);
+
+#endif // SD_QUEUE_H
@@ -0,0 +1,335 @@
+// sd_replay.c - Pipelined replay of the offline telemetry backlog
+
+#include "sd_replay.h"
+#include "sd_card_logger.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include <string.h>
+
+static const char *TAG = "SD_REPLAY";
+
+// Posted by sd_replay_set_connected() to wake the task
+#define SD_REPLAY_WAKE -1
+#define SD_REPLAY_ACK_QUEUE_DEPTH (2 * SD_REPLAY_MAX_INFLIGHT + 4)
+#define SD_REPLAY_RETRY_MS 1000          // After a failed publish
+#define SD_REPLAY_PROGRESS_EVERY 100     // Messages between progress logs
+
+typedef struct {
+    uint32_t message_id;
+    volatile int msg_id;                 // MQTT msg_id, -1 if never published (dropped message)
+    int64_t sent_ms;
+    bool acked;
+} replay_slot_t;
+
+// Messages read from the card and not yet removed, oldest first. Owned by the
+// replay task; the MQTT event handler only reads msg_id.
+static replay_slot_t s_slots[SD_REPLAY_MAX_INFLIGHT];
+static int s_first = 0;
+static int s_inflight = 0;
+
+static QueueHandle_t s_acks = NULL;      // msg_ids of MQTT_EVENT_PUBLISHED
+static TaskHandle_t s_task = NULL;
+static sd_replay_publish_fn s_publish = NULL;
+static volatile uint32_t s_connection = 0;   // Odd while connected, bumped on every change
+
+// Window control
+static int s_window = SD_REPLAY_INITIAL_WINDOW;
+static int s_threshold = SD_REPLAY_MAX_INFLIGHT;  // Slow start below this
+static int s_credit = 0;                 // Acks towards the next additive increase
+static int64_t s_min_latency_ms = 0;     // Fastest ack on this connection, 0 if none yet
+static int64_t s_srtt_ms = 0;            // Smoothed ack latency
+static int64_t s_last_decrease_ms = 0;
+
+// Read from the card but not yet published (publish failed)
+static pending_message_t s_next;
+static bool s_next_valid = false;
+static bool s_drained = false;           // Nothing left to read at the last attempt
+
+static uint32_t s_replayed = 0;          // Published and removed since the backlog was last empty
+static int64_t s_drain_start_ms = 0;
+
+static int64_t sd_replay_now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+static replay_slot_t *sd_replay_slot(int n)
+{
+    return &s_slots[(s_first + n) % SD_REPLAY_MAX_INFLIGHT];
+}
+
+// Forget the window; unacknowledged messages are read and published again
+static void sd_replay_reset(void)
+{
+    for (int i = 0; i < SD_REPLAY_MAX_INFLIGHT; i++) {
+        __atomic_store_n(&s_slots[i].msg_id, -1, __ATOMIC_RELAXED);
+    }
+    s_first = 0;
+    s_inflight = 0;
+    s_next_valid = false;
+    s_drained = false;
+    sd_card_rewind_messages();
+}
+
+// Latency history belongs to a connection
+static void sd_replay_reset_window(void)
+{
+    s_window = SD_REPLAY_INITIAL_WINDOW;
+    s_threshold = SD_REPLAY_MAX_INFLIGHT;
+    s_credit = 0;
+    s_min_latency_ms = 0;
+    s_srtt_ms = 0;
+    s_last_decrease_ms = 0;
+}
+
+// AIMD on ack latency
+static void sd_replay_adapt(int64_t latency_ms, int64_t now_ms)
+{
+    if (latency_ms < 1) {
+        latency_ms = 1;
+    }
+    if (s_min_latency_ms == 0 || latency_ms < s_min_latency_ms) {
+        s_min_latency_ms = latency_ms;
+    }
+    s_srtt_ms = s_srtt_ms ? (7 * s_srtt_ms + latency_ms) / 8 : latency_ms;
+
+    if (latency_ms > 2 * s_min_latency_ms + SD_REPLAY_LATENCY_SLACK_MS) {
+        // Messages are queueing somewhere on the path: halve, once per round trip
+        if (now_ms - s_last_decrease_ms >= s_srtt_ms) {
+            s_threshold = s_window / 2 > 1 ? s_window / 2 : 1;
+            s_window = s_threshold;
+            s_credit = 0;
+            s_last_decrease_ms = now_ms;
+        }
+    } else if (s_window < SD_REPLAY_MAX_INFLIGHT) {
+        if (s_window < s_threshold) {
+            s_window++;                  // Slow start: doubles every round trip
+        } else if (++s_credit >= s_window) {
+            s_window++;                  // One more message per round trip
+            s_credit = 0;
+        }
+    }
+}
+
+// Read and publish until the window is full or the backlog has been read
+static void sd_replay_fill(void)
+{
+    while (s_inflight < s_window) {
+        if (!s_next_valid) {
+            esp_err_t ret = sd_card_read_next_message(&s_next);
+            if (ret == ESP_ERR_INVALID_RESPONSE) {
+                // Not publishable; removed in order like an acknowledged message
+                replay_slot_t *slot = sd_replay_slot(s_inflight++);
+                slot->message_id = s_next.message_id;
+                slot->sent_ms = sd_replay_now_ms();
+                slot->acked = true;
+                __atomic_store_n(&slot->msg_id, -1, __ATOMIC_RELAXED);
+                continue;
+            }
+            if (ret != ESP_OK) {
+                s_drained = true;
+                return;
+            }
+            s_next_valid = true;
+        }
+
+        int msg_id = s_publish(s_next.topic, s_next.payload);
+        if (msg_id < 0) {
+            ESP_LOGW(TAG, "[WARN] Failed to publish cached message %lu, retrying", s_next.message_id);
+            return;
+        }
+
+        replay_slot_t *slot = sd_replay_slot(s_inflight++);
+        slot->message_id = s_next.message_id;
+        slot->sent_ms = sd_replay_now_ms();
+        slot->acked = false;
+        __atomic_store_n(&slot->msg_id, msg_id, __ATOMIC_RELEASE);
+        s_next_valid = false;
+        if (s_drain_start_ms == 0) {
+            s_drain_start_ms = slot->sent_ms;
+        }
+        ESP_LOGD(TAG, "Published cached message %lu from %s (msg_id %d, window %d)",
+                 slot->message_id, s_next.timestamp, msg_id, s_window);
+    }
+}
+
+static void sd_replay_ack(int msg_id)
+{
+    for (int n = 0; n < s_inflight; n++) {
+        replay_slot_t *slot = sd_replay_slot(n);
+        if (!slot->acked && slot->msg_id == msg_id) {
+            int64_t now_ms = sd_replay_now_ms();
+            slot->acked = true;
+            sd_replay_adapt(now_ms - slot->sent_ms, now_ms);
+            return;
+        }
+    }
+}
+
+// Remove acknowledged messages from the card, oldest first
+static void sd_replay_retire(void)
+{
+    while (s_inflight > 0 && sd_replay_slot(0)->acked) {
+        replay_slot_t *slot = sd_replay_slot(0);
+        if (sd_card_remove_message(slot->message_id) != ESP_OK) {
+            // The backlog changed underneath the window (cleared, card re-mounted)
+            ESP_LOGW(TAG, "[WARN] Message %lu is no longer the oldest cached message, restarting replay",
+                     slot->message_id);
+            sd_replay_reset();
+            return;
+        }
+        if (slot->msg_id >= 0) {
+            s_replayed++;
+        }
+        __atomic_store_n(&slot->msg_id, -1, __ATOMIC_RELAXED);
+        s_first = (s_first + 1) % SD_REPLAY_MAX_INFLIGHT;
+        s_inflight--;
+
+        if (s_replayed > 0 && s_replayed % SD_REPLAY_PROGRESS_EVERY == 0) {
+            uint32_t pending = 0;
+            sd_card_get_pending_count(&pending);
+            ESP_LOGI(TAG, "[SD] 📤 Replayed %lu cached messages, %lu pending (window %d, ack latency %lld ms)",
+                     s_replayed, pending, s_window, s_srtt_ms);
+        }
+    }
+}
+
+// The oldest unacknowledged publish was sent first; if it timed out, start over
+static void sd_replay_check_timeout(void)
+{
+    int64_t now_ms = sd_replay_now_ms();
+    for (int n = 0; n < s_inflight; n++) {
+        replay_slot_t *slot = sd_replay_slot(n);
+        if (slot->acked) {
+            continue;
+        }
+        if (now_ms - slot->sent_ms >= SD_REPLAY_ACK_TIMEOUT_MS) {
+            ESP_LOGW(TAG, "[WARN] No PUBACK for cached message %lu in %d ms, resending from it with window 1",
+                     slot->message_id, SD_REPLAY_ACK_TIMEOUT_MS);
+            s_threshold = s_window / 2 > 2 ? s_window / 2 : 2;
+            s_window = 1;
+            s_credit = 0;
+            sd_replay_reset();
+        }
+        return;
+    }
+}
+
+static TickType_t sd_replay_wait_ticks(void)
+{
+    // Until the oldest unacknowledged publish times out
+    for (int n = 0; n < s_inflight; n++) {
+        replay_slot_t *slot = sd_replay_slot(n);
+        if (!slot->acked) {
+            int64_t left_ms = slot->sent_ms + SD_REPLAY_ACK_TIMEOUT_MS - sd_replay_now_ms();
+            return left_ms > 0 ? pdMS_TO_TICKS(left_ms) + 1 : 0;
+        }
+    }
+    if (s_next_valid) {
+        return pdMS_TO_TICKS(SD_REPLAY_RETRY_MS);
+    }
+    if (!s_drained && s_inflight < s_window) {
+        return 0;
+    }
+    return pdMS_TO_TICKS(SD_REPLAY_IDLE_POLL_MS);
+}
+
+static void sd_replay_task(void *pvParameters)
+{
+    uint32_t seen = 0;
+    int msg_id;
+
+    while (true) {
+        uint32_t connection = __atomic_load_n(&s_connection, __ATOMIC_ACQUIRE);
+        if (connection != seen) {
+            seen = connection;
+            sd_replay_reset();
+            sd_replay_reset_window();
+        }
+        if (!(connection & 1) || !sd_card_is_available()) {
+            // Acks of an earlier connection are of no use
+            xQueueReceive(s_acks, &msg_id, pdMS_TO_TICKS(SD_REPLAY_IDLE_POLL_MS));
+            continue;
+        }
+
+        sd_replay_fill();
+        sd_replay_retire();
+
+        if (xQueueReceive(s_acks, &msg_id, sd_replay_wait_ticks()) == pdTRUE) {
+            do {
+                if (msg_id != SD_REPLAY_WAKE) {
+                    sd_replay_ack(msg_id);
+                }
+            } while (xQueueReceive(s_acks, &msg_id, 0) == pdTRUE);
+        }
+        sd_replay_check_timeout();
+        sd_replay_retire();
+
+        if (s_drained && s_inflight == 0 && s_drain_start_ms != 0) {
+            if (s_replayed > 0) {
+                ESP_LOGI(TAG, "[SD] ✅ Backlog replayed: %lu messages in %lld ms (window %d, ack latency %lld ms)",
+                         s_replayed, sd_replay_now_ms() - s_drain_start_ms, s_window, s_srtt_ms);
+            }
+            s_replayed = 0;
+            s_drain_start_ms = 0;
+        }
+    }
+}
+
+esp_err_t sd_replay_start(sd_replay_publish_fn publish)
+{
+    if (publish == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_task != NULL) {
+        return ESP_OK;
+    }
+
+    s_publish = publish;
+    for (int i = 0; i < SD_REPLAY_MAX_INFLIGHT; i++) {
+        s_slots[i].msg_id = -1;
+    }
+    s_acks = xQueueCreate(SD_REPLAY_ACK_QUEUE_DEPTH, sizeof(int));
+    if (s_acks == NULL || xTaskCreatePinnedToCore(sd_replay_task, "sd_replay", SD_REPLAY_TASK_STACK, NULL,
+                                                  SD_REPLAY_TASK_PRIORITY, &s_task, SD_REPLAY_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "[ERROR] Failed to start backlog replay task");
+        s_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "[OK] Backlog replay started (up to %d messages in flight)", SD_REPLAY_MAX_INFLIGHT);
+    return ESP_OK;
+}
+
+void sd_replay_set_connected(bool connected)
+{
+    uint32_t connection = __atomic_load_n(&s_connection, __ATOMIC_RELAXED);
+    if (((connection & 1) != 0) == connected) {
+        return;
+    }
+    __atomic_store_n(&s_connection, connection + 1, __ATOMIC_RELEASE);
+    if (s_acks != NULL) {
+        int wake = SD_REPLAY_WAKE;
+        xQueueSend(s_acks, &wake, 0);
+    }
+}
+
+bool sd_replay_on_published(int msg_id)
+{
+    if (s_acks == NULL) {
+        return false;
+    }
+    // Every ack goes to the task: the PUBACK can arrive before the task has
+    // recorded the msg_id. A full queue only costs a timeout and a resend.
+    xQueueSend(s_acks, &msg_id, 0);
+
+    for (int i = 0; i < SD_REPLAY_MAX_INFLIGHT; i++) {
+        if (__atomic_load_n(&s_slots[i].msg_id, __ATOMIC_ACQUIRE) == msg_id) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,48 @@
+// sd_replay.h - Pipelined replay of the offline telemetry backlog
+// A dedicated task publishes cached messages with QoS 1 while live telemetry
+// keeps flowing. Up to a window of publishes is in flight at once, each tracked
+// by its MQTT msg_id; a message is removed from the card only when its PUBACK
+// (MQTT_EVENT_PUBLISHED) arrives and every older message has been removed.
+//
+// The window adapts AIMD-style to the ack latency: it grows by one message per
+// round trip while acks come back close to the fastest latency seen on the
+// connection, is halved (at most once per round trip) when they slow down, and
+// drops to one message when an ack times out. Unacknowledged messages are sent
+// again after a timeout or reconnect, so delivery is at-least-once.
+
+#ifndef SD_REPLAY_H
+#define SD_REPLAY_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Replay task configuration
+#define SD_REPLAY_TASK_STACK 4096
+#define SD_REPLAY_TASK_PRIORITY 2        // Below telemetry_task; live data goes first
+#define SD_REPLAY_TASK_CORE 1
+
+// Window
+#define SD_REPLAY_MAX_INFLIGHT 16        // Largest window (also bounds the MQTT outbox use)
+#define SD_REPLAY_INITIAL_WINDOW 2
+// Times can be overridden at build time (the host test shortens them)
+#ifndef SD_REPLAY_ACK_TIMEOUT_MS
+#define SD_REPLAY_ACK_TIMEOUT_MS 15000   // No PUBACK this long: collapse the window and resend
+#endif
+#ifndef SD_REPLAY_LATENCY_SLACK_MS
+#define SD_REPLAY_LATENCY_SLACK_MS 200   // Ack latency tolerated above twice the fastest before backing off
+#endif
+#ifndef SD_REPLAY_IDLE_POLL_MS
+#define SD_REPLAY_IDLE_POLL_MS 5000      // Backlog check interval while there is nothing to send
+#endif
+
+// Publishes one message with QoS 1; returns the MQTT msg_id, or -1 on failure
+typedef int (*sd_replay_publish_fn)(const char *topic, const char *payload);
+
+esp_err_t sd_replay_start(sd_replay_publish_fn publish);
+
+// MQTT event hooks (safe from the MQTT event handler)
+void sd_replay_set_connected(bool connected);
+// Returns true if msg_id belongs to a replayed message
+bool sd_replay_on_published(int msg_id);
+
+#endif // SD_REPLAY_H
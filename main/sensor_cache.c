@@ -0,0 +1,131 @@
+// sensor_cache.c - Last-known-value store for sensor readings
+//
+// Each slot is guarded by a sequence counter (seqlock). The single writer makes
+// the counter odd while it updates the slot and even again when done; readers
+// copy the slot and retry if the counter was odd or changed underneath them.
+// Readers never block the poller and the poller never waits for readers.
+
+#include "sensor_cache.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+// Spins before a reader yields; covers a writer preempted mid-update on the same core
+#define SEQLOCK_SPINS_BEFORE_YIELD 64
+
+typedef struct {
+    volatile uint32_t seq;
+    sensor_cache_entry_t entry;
+} cache_slot_t;
+
+typedef struct {
+    volatile uint32_t seq;
+    uint32_t version;
+    int64_t cycle_time_us;
+} cache_header_t;
+
+static cache_slot_t s_slots[SENSOR_CACHE_SLOTS];
+static cache_header_t s_header;
+
+static inline void seqlock_write_begin(volatile uint32_t *seq)
+{
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqlock_write_end(volatile uint32_t *seq)
+{
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t seqlock_read_begin(volatile uint32_t *seq)
+{
+    int spins = 0;
+    uint32_t start;
+    while ((start = __atomic_load_n(seq, __ATOMIC_ACQUIRE)) & 1) {
+        if (++spins >= SEQLOCK_SPINS_BEFORE_YIELD) {
+            // Let a lower priority writer finish its update
+            vTaskDelay(1);
+            spins = 0;
+        }
+    }
+    return start;
+}
+
+static inline bool seqlock_read_retry(volatile uint32_t *seq, uint32_t start)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(seq, __ATOMIC_RELAXED) != start;
+}
+
+// Record the outcome of one poll attempt. A failed attempt keeps the last good
+// reading and only updates the error and attempt time.
+void sensor_cache_publish(int index, const sensor_reading_t *reading, uint32_t latency_ms, esp_err_t error)
+{
+    if (index < 0 || index >= SENSOR_CACHE_SLOTS || !reading) {
+        return;
+    }
+
+    cache_slot_t *slot = &s_slots[index];
+    int64_t now = esp_timer_get_time();
+    bool success = (error == ESP_OK && reading->valid);
+
+    seqlock_write_begin(&slot->seq);
+    if (success || strcmp(slot->entry.reading.unit_id, reading->unit_id) != 0) {
+        // New value, or the slot now belongs to a different sensor
+        slot->entry.reading = *reading;
+        slot->entry.read_time_us = success ? now : 0;
+    }
+    slot->entry.attempt_time_us = now;
+    slot->entry.latency_ms = latency_ms;
+    slot->entry.last_error = success ? ESP_OK : (error != ESP_OK ? error : ESP_FAIL);
+    slot->entry.version = s_header.version + 1;
+    seqlock_write_end(&slot->seq);
+}
+
+// Close a poll cycle: bump the cache version and stamp the cycle time
+void sensor_cache_commit(void)
+{
+    seqlock_write_begin(&s_header.seq);
+    s_header.version++;
+    s_header.cycle_time_us = esp_timer_get_time();
+    seqlock_write_end(&s_header.seq);
+}
+
+bool sensor_cache_get(int index, sensor_cache_entry_t *entry)
+{
+    if (index < 0 || index >= SENSOR_CACHE_SLOTS || !entry) {
+        return false;
+    }
+
+    cache_slot_t *slot = &s_slots[index];
+    uint32_t start;
+    do {
+        start = seqlock_read_begin(&slot->seq);
+        memcpy(entry, (const void *)&slot->entry, sizeof(sensor_cache_entry_t));
+    } while (seqlock_read_retry(&slot->seq, start));
+
+    return entry->attempt_time_us != 0;
+}
+
+uint32_t sensor_cache_version(void)
+{
+    return __atomic_load_n(&s_header.version, __ATOMIC_ACQUIRE);
+}
+
+// Time since the last completed poll cycle, -1 if none has completed yet
+int64_t sensor_cache_cycle_age_ms(void)
+{
+    uint32_t start;
+    int64_t cycle_time_us;
+    do {
+        start = seqlock_read_begin(&s_header.seq);
+        cycle_time_us = s_header.cycle_time_us;
+    } while (seqlock_read_retry(&s_header.seq, start));
+
+    if (cycle_time_us == 0) {
+        return -1;
+    }
+    return (esp_timer_get_time() - cycle_time_us) / 1000;
+}
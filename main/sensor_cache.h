@@ -0,0 +1,34 @@
+// sensor_cache.h - Last-known-value store for sensor readings
+// Written only by the sensor poller; read by telemetry, web UI, Telegram and the
+// device twin without touching the RS485 bus
+
+#ifndef SENSOR_CACHE_H
+#define SENSOR_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sensor_manager.h"
+
+#define SENSOR_CACHE_SLOTS 20      // One slot per system_config_t.sensors entry
+
+// Cached state of one sensor
+typedef struct {
+    sensor_reading_t reading;      // Last successful reading (reading.valid = false if none yet)
+    int64_t read_time_us;          // esp_timer time of the last successful read, 0 if never
+    int64_t attempt_time_us;       // esp_timer time of the last poll attempt, 0 if never
+    uint32_t latency_ms;           // Bus time spent on the last attempt
+    esp_err_t last_error;          // ESP_OK if the last attempt succeeded
+    uint32_t version;              // Cache version that last updated this slot
+} sensor_cache_entry_t;
+
+// Writer side (poller only)
+void sensor_cache_publish(int index, const sensor_reading_t *reading, uint32_t latency_ms, esp_err_t error);
+void sensor_cache_commit(void);
+
+// Reader side (any task, lock-free)
+bool sensor_cache_get(int index, sensor_cache_entry_t *entry);
+uint32_t sensor_cache_version(void);
+int64_t sensor_cache_cycle_age_ms(void);
+
+#endif // SENSOR_CACHE_H
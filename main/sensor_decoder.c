@@ -0,0 +1,437 @@
+// sensor_decoder.c - Precompiled register decoders
+
+#include "sensor_decoder.h"
+#include "esp_log.h"
+#include <string.h>
+#include <inttypes.h>
+
+static const char *TAG = "SENSOR_DEC";
+
+// Byte orders, as named by the web interface formats
+typedef enum {
+    DECODE_ORDER_BIG = 0,       // 1234 / 12345678 / BIG_ENDIAN / _HI
+    DECODE_ORDER_WORD_SWAP,     // 3412, 4321 / 87654321 / LITTLE_ENDIAN: registers reversed
+    DECODE_ORDER_MIXED_BADC,    // 2143 / 78563412 / MIXED_BADC
+    DECODE_ORDER_MIXED_DCBA,    // MIXED_DCBA
+    DECODE_ORDER_BYTE_SWAP,     // 21436587 / _LO: bytes swapped within each register
+    DECODE_ORDER_COUNT,
+    DECODE_ORDER_NONE = -1
+} decode_order_t;
+
+// Byte permutation per value width and order (0 = not supported). Source bytes
+// are numbered in wire order: register 0 high byte is 0, its low byte 1, ...
+static const uint32_t s_permutations_16[DECODE_ORDER_COUNT] = {
+    0x01, 0, 0, 0, 0x10
+};
+static const uint32_t s_permutations_32[DECODE_ORDER_COUNT] = {
+    0x0123, 0x2301, 0x1032, 0x3210, 0x1032
+};
+// FLOAT64 78563412 has always been decoded fully byte-reversed
+static const uint32_t s_permutations_64[DECODE_ORDER_COUNT] = {
+    0x01234567, 0x67452301, 0x76543210, 0, 0x10325476
+};
+
+static const struct {
+    const char *name;
+    sensor_decode_type_t type;
+    uint8_t width;
+} s_base_types[] = {
+    { "FLOAT64", SENSOR_DECODE_FLOAT64, 8 },
+    { "UINT64",  SENSOR_DECODE_UINT64,  8 },
+    { "INT64",   SENSOR_DECODE_INT64,   8 },
+    { "FLOAT32", SENSOR_DECODE_FLOAT32, 4 },
+    { "UINT32",  SENSOR_DECODE_UINT32,  4 },
+    { "INT32",   SENSOR_DECODE_INT32,   4 },
+    { "UINT16",  SENSOR_DECODE_UINT16,  2 },
+    { "INT16",   SENSOR_DECODE_INT16,   2 },
+};
+
+// Byte order suffixes of the data_type names (truncated 64-bit names included)
+static const struct {
+    const char *suffix;
+    decode_order_t order;
+} s_suffixes[] = {
+    { "_1234",     DECODE_ORDER_BIG },
+    { "_12345678", DECODE_ORDER_BIG },
+    { "_1234567",  DECODE_ORDER_BIG },
+    { "_HI",       DECODE_ORDER_BIG },
+    { "_4321",     DECODE_ORDER_WORD_SWAP },
+    { "_3412",     DECODE_ORDER_WORD_SWAP },
+    { "_87654321", DECODE_ORDER_WORD_SWAP },
+    { "_8765432",  DECODE_ORDER_WORD_SWAP },
+    { "_2143",     DECODE_ORDER_MIXED_BADC },
+    { "_78563412", DECODE_ORDER_MIXED_BADC },
+    { "_7856341",  DECODE_ORDER_MIXED_BADC },
+    { "_21436587", DECODE_ORDER_BYTE_SWAP },
+    { "_LO",       DECODE_ORDER_BYTE_SWAP },
+};
+
+// byte_order field, used when data_type carries no suffix
+static const struct {
+    const char *name;
+    decode_order_t order;
+} s_byte_orders[] = {
+    { "BIG_ENDIAN",    DECODE_ORDER_BIG },
+    { "LITTLE_ENDIAN", DECODE_ORDER_WORD_SWAP },
+    { "MIXED_BADC",    DECODE_ORDER_MIXED_BADC },
+    { "MIXED_DCBA",    DECODE_ORDER_MIXED_DCBA },
+};
+
+static float decoder_float_bits(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Flow-Meter / Clampon: UINT32 integer part + FLOAT32 decimal part, both word-swapped
+static void decode_integer_float_swapped(const sensor_decoder_t *decoder, const sensor_config_t *sensor,
+                                         const uint16_t *registers, double *value, uint32_t *raw_value)
+{
+    uint32_t integer_part_raw = ((uint32_t)registers[1] << 16) | registers[0];
+    uint32_t float_bits = ((uint32_t)registers[3] << 16) | registers[2];
+    double decimal_part = (double)decoder_float_bits(float_bits);
+
+    *value = ((double)integer_part_raw + decimal_part) * decoder->scale_factor;
+    *raw_value = integer_part_raw;
+    ESP_LOGD(TAG, "%s: Integer=0x%08" PRIX32 " + Decimal(FLOAT)=0x%08" PRIX32 "(%.6f) = %.6f",
+             sensor->sensor_type, integer_part_raw, float_bits, decimal_part, *value);
+}
+
+// ZEST (AquaGen): UINT16 integer part, unused register, FLOAT32 big-endian decimal part
+static void decode_zest(const sensor_decoder_t *decoder, const sensor_config_t *sensor,
+                        const uint16_t *registers, double *value, uint32_t *raw_value)
+{
+    uint32_t integer_part_raw = registers[0];
+    uint32_t float_bits = ((uint32_t)registers[2] << 16) | registers[3];
+    double decimal_part = (double)decoder_float_bits(float_bits);
+
+    *value = ((double)integer_part_raw + decimal_part) * decoder->scale_factor;
+    *raw_value = integer_part_raw;
+    ESP_LOGD(TAG, "ZEST: Integer=%" PRIu32 " + Decimal(FLOAT)=0x%08" PRIX32 "(%.6f) = %.6f",
+             integer_part_raw, float_bits, decimal_part, *value);
+}
+
+// Panda USM: net volume as big-endian FLOAT64, upper 32 bits reported as raw
+static void decode_panda_usm(const sensor_decoder_t *decoder, const sensor_config_t *sensor,
+                             const uint16_t *registers, double *value, uint32_t *raw_value)
+{
+    uint64_t bits = ((uint64_t)registers[0] << 48) | ((uint64_t)registers[1] << 32) |
+                    ((uint64_t)registers[2] << 16) | registers[3];
+    double net_volume;
+    memcpy(&net_volume, &bits, sizeof(net_volume));
+
+    *value = net_volume * decoder->scale_factor;
+    *raw_value = (uint32_t)(bits >> 32);
+    ESP_LOGD(TAG, "Panda USM: DOUBLE64=0x%016" PRIX64 " = %.6f", bits, *value);
+}
+
+// Dailian EMF: word-swapped UINT32 totaliser
+static void decode_dailian_emf(const sensor_decoder_t *decoder, const sensor_config_t *sensor,
+                               const uint16_t *registers, double *value, uint32_t *raw_value)
+{
+    uint32_t totaliser_raw = ((uint32_t)registers[1] << 16) | registers[0];
+
+    *value = (double)totaliser_raw * decoder->scale_factor;
+    *raw_value = totaliser_raw;
+    ESP_LOGD(TAG, "Dailian_EMF: Totaliser=%" PRIu32 " -> %.6f", totaliser_raw, *value);
+}
+
+// Panda EMF: INT32 integer part + FLOAT32 decimal part, both big-endian
+static void decode_panda_emf(const sensor_decoder_t *decoder, const sensor_config_t *sensor,
+                             const uint16_t *registers, double *value, uint32_t *raw_value)
+{
+    int32_t integer_part = (int32_t)(((uint32_t)registers[0] << 16) | registers[1]);
+    uint32_t float_bits = ((uint32_t)registers[2] << 16) | registers[3];
+    double decimal_part = (double)decoder_float_bits(float_bits);
+
+    *value = ((double)integer_part + decimal_part) * decoder->scale_factor;
+    *raw_value = (uint32_t)integer_part;
+    ESP_LOGD(TAG, "Panda_EMF: Integer=%" PRId32 " + Decimal(FLOAT)=0x%08" PRIX32 "(%.6f) = %.6f",
+             integer_part, float_bits, decimal_part, *value);
+}
+
+// Panda Level: distance reading turned into a fill percentage of the tank
+static void decode_panda_level(const sensor_decoder_t *decoder, const sensor_config_t *sensor,
+                               const uint16_t *registers, double *value, uint32_t *raw_value)
+{
+    uint16_t raw_level = registers[0];
+
+    if (sensor->max_water_level > 0) {
+        *value = ((sensor->sensor_height - (double)raw_level) / sensor->max_water_level) * 100.0;
+        if (*value < 0) *value = 0.0;
+        if (*value > 100) *value = 100.0;
+    } else {
+        *value = (double)raw_level * decoder->scale_factor;
+    }
+    *raw_value = raw_level;
+    ESP_LOGD(TAG, "Panda_Level: Raw=%u, SensorHeight=%.2f, TankHeight=%.2f, Level%%=%.2f",
+             raw_level, sensor->sensor_height, sensor->max_water_level, *value);
+}
+
+static const struct {
+    const char *sensor_type;
+    sensor_composite_fn_t fn;
+    uint8_t reg_count;
+} s_composites[] = {
+    { "Flow-Meter",  decode_integer_float_swapped, 4 },
+    { "ZEST",        decode_zest,                  4 },
+    { "Panda_USM",   decode_panda_usm,             4 },
+    { "Clampon",     decode_integer_float_swapped, 4 },
+    { "Dailian_EMF", decode_dailian_emf,           2 },
+    { "Panda_EMF",   decode_panda_emf,             4 },
+    { "Panda_Level", decode_panda_level,           1 },
+};
+
+#define DECODER_COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+esp_err_t sensor_decoder_compile_format(const char *data_type, const char *byte_order, double scale_factor,
+                                        sensor_decoder_t *decoder)
+{
+    if (!data_type || !decoder) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(decoder, 0, sizeof(sensor_decoder_t));
+    decoder->scale_factor = scale_factor;
+
+    if (strcmp(data_type, "HEX") == 0) {
+        decoder->type = SENSOR_DECODE_HEX;
+        return ESP_OK;
+    }
+
+    for (size_t t = 0; t < DECODER_COUNT(s_base_types); t++) {
+        size_t name_len = strlen(s_base_types[t].name);
+        if (strncmp(data_type, s_base_types[t].name, name_len) != 0) {
+            continue;
+        }
+
+        const char *suffix = data_type + name_len;
+        uint8_t width = s_base_types[t].width;
+        decode_order_t order = DECODE_ORDER_NONE;
+        if (*suffix == '\0') {
+            // 16-bit types have always ignored byte_order
+            if (width == 2) {
+                order = DECODE_ORDER_BIG;
+            } else {
+                for (size_t o = 0; byte_order && o < DECODER_COUNT(s_byte_orders); o++) {
+                    if (strcmp(byte_order, s_byte_orders[o].name) == 0) {
+                        order = s_byte_orders[o].order;
+                        break;
+                    }
+                }
+            }
+        } else {
+            for (size_t s = 0; s < DECODER_COUNT(s_suffixes); s++) {
+                if (strcmp(suffix, s_suffixes[s].suffix) == 0) {
+                    order = s_suffixes[s].order;
+                    break;
+                }
+            }
+        }
+        if (order == DECODE_ORDER_NONE) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+
+        const uint32_t *permutations = width == 2 ? s_permutations_16 :
+                                       width == 4 ? s_permutations_32 : s_permutations_64;
+        if (permutations[order] == 0) {
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+
+        decoder->type = s_base_types[t].type;
+        decoder->width = width;
+        decoder->reg_count = width / 2;
+        decoder->permutation = permutations[order];
+        return ESP_OK;
+    }
+
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static esp_err_t sensor_decoder_compile_fields(const char *sensor_type, const char *data_type,
+                                               const char *byte_order, double scale_factor, int quantity,
+                                               sensor_decoder_t *decoder)
+{
+    esp_err_t ret = sensor_decoder_compile_format(data_type, byte_order, scale_factor, decoder);
+    decoder->quantity = quantity > 0 ? (uint16_t)quantity : 0;
+
+    for (size_t c = 0; c < DECODER_COUNT(s_composites); c++) {
+        if (strcmp(sensor_type, s_composites[c].sensor_type) == 0) {
+            decoder->composite = s_composites[c].fn;
+            decoder->composite_regs = s_composites[c].reg_count;
+            // The vendor format covers the sensor even without a usable data_type
+            return ESP_OK;
+        }
+    }
+    return ret;
+}
+
+esp_err_t sensor_decoder_compile(const sensor_config_t *sensor, sensor_decoder_t *decoder)
+{
+    if (!sensor || !decoder) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return sensor_decoder_compile_fields(sensor->sensor_type, sensor->data_type, sensor->byte_order,
+                                         sensor->scale_factor, sensor->quantity, decoder);
+}
+
+// Reassemble the value bytes from the registers in the compiled order
+static inline uint64_t sensor_decoder_shuffle(const sensor_decoder_t *decoder, const uint16_t *registers)
+{
+    uint8_t bytes[8];
+    for (int i = 0; i < decoder->reg_count; i++) {
+        bytes[2 * i] = (uint8_t)(registers[i] >> 8);
+        bytes[2 * i + 1] = (uint8_t)registers[i];
+    }
+
+    uint64_t value = 0;
+    for (int shift = (decoder->width - 1) * 4; shift >= 0; shift -= 4) {
+        value = (value << 8) | bytes[(decoder->permutation >> shift) & 0xF];
+    }
+    return value;
+}
+
+esp_err_t sensor_decoder_decode(const sensor_decoder_t *decoder, const sensor_config_t *sensor,
+                                const uint16_t *registers, int reg_count, double *value, uint32_t *raw_value)
+{
+    if (!decoder || !registers || !value || !raw_value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (decoder->composite && sensor && reg_count >= decoder->composite_regs) {
+        decoder->composite(decoder, sensor, registers, value, raw_value);
+        return ESP_OK;
+    }
+
+    if (decoder->type == SENSOR_DECODE_INVALID || reg_count < decoder->reg_count) {
+        ESP_LOGE(TAG, "Unsupported data type or insufficient registers (need %d, have %d)",
+                 decoder->reg_count, reg_count);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (decoder->type == SENSOR_DECODE_HEX) {
+        uint32_t raw = 0;
+        for (int i = 0; i < reg_count && i < 2; i++) {
+            raw = (raw << 16) | registers[i];
+        }
+        *raw_value = raw;
+        *value = (double)raw * decoder->scale_factor;
+        return ESP_OK;
+    }
+
+    uint64_t bits = sensor_decoder_shuffle(decoder, registers);
+    switch (decoder->type) {
+        case SENSOR_DECODE_UINT16:
+        case SENSOR_DECODE_UINT32:
+            *raw_value = (uint32_t)bits;
+            *value = (double)(uint32_t)bits * decoder->scale_factor;
+            break;
+        case SENSOR_DECODE_INT16:
+            *raw_value = (uint32_t)bits;
+            *value = (double)(int16_t)bits * decoder->scale_factor;
+            break;
+        case SENSOR_DECODE_INT32:
+            *raw_value = (uint32_t)bits;
+            *value = (double)(int32_t)(uint32_t)bits * decoder->scale_factor;
+            break;
+        case SENSOR_DECODE_FLOAT32:
+            *raw_value = (uint32_t)bits;
+            *value = (double)decoder_float_bits((uint32_t)bits) * decoder->scale_factor;
+            break;
+        case SENSOR_DECODE_UINT64:
+            *raw_value = (uint32_t)bits;  // Lower 32 bits, as for FLOAT64
+            *value = (double)bits * decoder->scale_factor;
+            break;
+        case SENSOR_DECODE_INT64:
+            *raw_value = (uint32_t)bits;
+            *value = (double)(int64_t)bits * decoder->scale_factor;
+            break;
+        case SENSOR_DECODE_FLOAT64: {
+            double decoded;
+            memcpy(&decoded, &bits, sizeof(decoded));
+            *raw_value = (uint32_t)bits;
+            *value = decoded * decoder->scale_factor;
+            break;
+        }
+        default:
+            return ESP_ERR_INVALID_ARG;
+    }
+
+    ESP_LOGD(TAG, "Decoded type %d: Raw=0x%016" PRIX64 " -> %.6f", decoder->type, bits, *value);
+    return ESP_OK;
+}
+
+// Decoder table: [sensor][0] is the sensor itself, [sensor][1 + n] its sub-sensor n
+static sensor_decoder_t s_decoders[SENSOR_DECODER_MAX_SENSORS][1 + SENSOR_DECODER_MAX_SUBS];
+static uint32_t s_decoder_generation[SENSOR_DECODER_MAX_SENSORS][1 + SENSOR_DECODER_MAX_SUBS];
+static uint32_t s_generation = 1;
+
+static esp_err_t sensor_decoder_compile_entry(const sensor_config_t *sensor, int sub_index,
+                                              sensor_decoder_t *decoder)
+{
+    if (sub_index == SENSOR_DECODER_MAIN) {
+        return sensor_decoder_compile(sensor, decoder);
+    }
+    // Sub-sensors keep the sensor type of their parent
+    const sub_sensor_t *sub = &sensor->sub_sensors[sub_index];
+    return sensor_decoder_compile_fields(sensor->sensor_type, sub->data_type, sub->byte_order,
+                                         sub->scale_factor, sub->quantity, decoder);
+}
+
+void sensor_decoder_config_changed(const system_config_t *config)
+{
+    __atomic_add_fetch(&s_generation, 1, __ATOMIC_RELEASE);
+    if (!config) {
+        return;
+    }
+
+    int unsupported = 0;
+    sensor_decoder_t decoder;
+    for (int i = 0; i < config->sensor_count && i < SENSOR_DECODER_MAX_SENSORS; i++) {
+        const sensor_config_t *sensor = &config->sensors[i];
+        if (!sensor->enabled) {
+            continue;
+        }
+        // Water quality sensors are decoded through their sub-sensors only
+        if (strcmp(sensor->sensor_type, "QUALITY") != 0) {
+            if (sensor_decoder_compile_entry(sensor, SENSOR_DECODER_MAIN, &decoder) != ESP_OK) {
+                ESP_LOGW(TAG, "[WARN] Sensor %d (%s): unsupported data format %s / %s",
+                         i + 1, sensor->name, sensor->data_type, sensor->byte_order);
+                unsupported++;
+            }
+            continue;
+        }
+        for (int s = 0; s < sensor->sub_sensor_count && s < SENSOR_DECODER_MAX_SUBS; s++) {
+            const sub_sensor_t *sub = &sensor->sub_sensors[s];
+            if (sub->enabled && sensor_decoder_compile_entry(sensor, s, &decoder) != ESP_OK) {
+                ESP_LOGW(TAG, "[WARN] Sensor %d (%s) parameter %s: unsupported data format %s / %s",
+                         i + 1, sensor->name, sub->parameter_name, sub->data_type, sub->byte_order);
+                unsupported++;
+            }
+        }
+    }
+
+    if (unsupported == 0) {
+        ESP_LOGI(TAG, "[OK] Decoders ready for %d sensors", config->sensor_count);
+    }
+}
+
+// Compiled decoder of a configured sensor or sub-sensor, rebuilt if the
+// configuration changed since it was compiled
+const sensor_decoder_t *sensor_decoder_lookup(const system_config_t *config, int sensor_index, int sub_index)
+{
+    if (!config || sensor_index < 0 || sensor_index >= SENSOR_DECODER_MAX_SENSORS ||
+        sub_index < SENSOR_DECODER_MAIN || sub_index >= SENSOR_DECODER_MAX_SUBS) {
+        return NULL;
+    }
+
+    int slot = sub_index + 1;
+    sensor_decoder_t *decoder = &s_decoders[sensor_index][slot];
+    uint32_t generation = __atomic_load_n(&s_generation, __ATOMIC_ACQUIRE);
+    if (s_decoder_generation[sensor_index][slot] != generation) {
+        sensor_decoder_compile_entry(&config->sensors[sensor_index], sub_index, decoder);
+        s_decoder_generation[sensor_index][slot] = generation;
+    }
+    return decoder;
+}
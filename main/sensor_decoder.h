@@ -0,0 +1,65 @@
+// sensor_decoder.h - Precompiled register decoders
+// A sensor's data_type, byte_order and sensor_type strings are resolved once,
+// when the configuration is loaded or saved, into a small descriptor. Decoding
+// a reading is then a table lookup and a fixed byte shuffle.
+
+#ifndef SENSOR_DECODER_H
+#define SENSOR_DECODER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "web_config.h"
+
+// Decoder table capacity: every sensor plus its sub-sensors
+#define SENSOR_DECODER_MAX_SENSORS 20
+#define SENSOR_DECODER_MAX_SUBS 8
+
+// Marks the sensor itself rather than one of its sub-sensors
+#define SENSOR_DECODER_MAIN -1
+
+typedef enum {
+    SENSOR_DECODE_INVALID = 0,   // data_type/byte_order not supported
+    SENSOR_DECODE_UINT16,
+    SENSOR_DECODE_INT16,
+    SENSOR_DECODE_UINT32,
+    SENSOR_DECODE_INT32,
+    SENSOR_DECODE_FLOAT32,
+    SENSOR_DECODE_UINT64,
+    SENSOR_DECODE_INT64,
+    SENSOR_DECODE_FLOAT64,
+    SENSOR_DECODE_HEX            // Up to two registers concatenated
+} sensor_decode_type_t;
+
+struct sensor_decoder;
+
+// Vendor formats selected by sensor_type (Flow-Meter, ZEST, ...)
+typedef void (*sensor_composite_fn_t)(const struct sensor_decoder *decoder, const sensor_config_t *sensor,
+                                      const uint16_t *registers, double *value, uint32_t *raw_value);
+
+typedef struct sensor_decoder {
+    uint8_t type;                       // sensor_decode_type_t
+    uint8_t width;                      // Value size in bytes (2, 4 or 8)
+    uint8_t reg_count;                  // Registers the value needs
+    uint32_t permutation;               // Source byte of each value byte, one nibble each, MSB first
+    double scale_factor;
+    uint16_t quantity;                  // Configured register count
+    sensor_composite_fn_t composite;    // NULL for plain data types
+    uint8_t composite_regs;             // With fewer registers the data type is used instead
+} sensor_decoder_t;
+
+// Compilation
+esp_err_t sensor_decoder_compile_format(const char *data_type, const char *byte_order, double scale_factor,
+                                        sensor_decoder_t *decoder);
+esp_err_t sensor_decoder_compile(const sensor_config_t *sensor, sensor_decoder_t *decoder);
+
+// Decoding. sensor supplies vendor format parameters (may be NULL without a composite).
+esp_err_t sensor_decoder_decode(const sensor_decoder_t *decoder, const sensor_config_t *sensor,
+                                const uint16_t *registers, int reg_count, double *value, uint32_t *raw_value);
+
+// Decoder table for the configured sensors. sensor_decoder_config_changed()
+// reports unsupported formats and invalidates the table; entries are rebuilt
+// on their next lookup. Lookups are made from the poll task only.
+void sensor_decoder_config_changed(const system_config_t *config);
+const sensor_decoder_t *sensor_decoder_lookup(const system_config_t *config, int sensor_index, int sub_index);
+
+#endif // SENSOR_DECODER_H
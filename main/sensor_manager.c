@@ -2,8 +2,19 @@
 
 #include "sensor_manager.h"
 #include "modbus.h"
+#include "modbus_port.h"
+#include "poll_profile.h"
+#include "trace.h"
+#include "poll_planner.h"
+#include "sensor_cache.h"
+#include "modbus_bus.h"
+#include "sensor_decoder.h"
+#include "iot_configs.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
 #include <string.h>
 #include <time.h>
 #include <math.h>
@@ -11,13 +22,37 @@
 
 static const char *TAG = "SENSOR_MGR";
 
+// Poll cycle state, guarded by s_poll_mutex (the plan and window buffer are too
+// large for the calling task's stack)
+static SemaphoreHandle_t s_poll_mutex = NULL;
+static poll_plan_t s_poll_plan;
+static uint16_t s_window_registers[MODBUS_MAX_REGISTERS];
+static sensor_reading_t s_cycle_readings[POLL_PLAN_MAX_SENSORS];
+static bool s_cycle_any_success[POLL_PLAN_MAX_SENSORS];
+static modbus_result_t s_item_error = MODBUS_SUCCESS;
+static uint32_t s_cycle_latency_ms[POLL_PLAN_MAX_SENSORS];
+static uint32_t s_transaction_ms = 0;
+static int s_sensor_order[POLL_PLAN_MAX_SENSORS];
+static poll_cycle_stats_t s_cycle_stats;
+static uint32_t s_cycle_decode_us = 0;
+
 esp_err_t sensor_manager_init(void)
 {
     ESP_LOGI(TAG, "Initializing sensor manager");
+
+    if (!s_poll_mutex) {
+        s_poll_mutex = xSemaphoreCreateMutex();
+        if (!s_poll_mutex) {
+            ESP_LOGE(TAG, "Failed to create poll mutex");
+            return ESP_ERR_NO_MEM;
+        }
+    }
     return ESP_OK;
 }
 
-esp_err_t convert_modbus_data(uint16_t *registers, int reg_count, 
+// Decode registers by data type name. Kept for callers without a sensor config;
+// the poll path uses decoders compiled once per configuration.
+esp_err_t convert_modbus_data(const uint16_t *registers, int reg_count, 
                              const char* data_type, const char* byte_order,
                              double scale_factor, double *result, uint32_t *raw_value)
 {
@@ -25,190 +60,79 @@ esp_err_t convert_modbus_data(uint16_t *registers, int reg_count,
         return ESP_ERR_INVALID_ARG;
     }
 
-    ESP_LOGI(TAG, "Converting data: Type=%s, Order=%s, Scale=%.6f", data_type, byte_order, scale_factor);
+    sensor_decoder_t decoder;
+    if (sensor_decoder_compile_format(data_type, byte_order, scale_factor, &decoder) != ESP_OK) {
+        ESP_LOGE(TAG, "Unsupported data type: %s (byte order %s)", data_type, byte_order);
+        return ESP_ERR_INVALID_ARG;
+    }
+    return sensor_decoder_decode(&decoder, NULL, registers, reg_count, result, raw_value);
+}
 
-    // Handle specific format names from web interface
-    const char* actual_data_type = data_type;
-    const char* actual_byte_order = byte_order;
-    
-    // 32-bit Integer formats
-    if (strstr(data_type, "INT32_1234") || strstr(data_type, "UINT32_1234")) {
-        actual_data_type = strstr(data_type, "UINT32") ? "UINT32" : "INT32";
-        actual_byte_order = "BIG_ENDIAN";     // 1234 = ABCD = BIG_ENDIAN
-    } else if (strstr(data_type, "INT32_4321") || strstr(data_type, "UINT32_4321")) {
-        actual_data_type = strstr(data_type, "UINT32") ? "UINT32" : "INT32";
-        actual_byte_order = "LITTLE_ENDIAN";  // 4321 = DCBA = LITTLE_ENDIAN
-    } else if (strstr(data_type, "INT32_3412") || strstr(data_type, "UINT32_3412")) {
-        actual_data_type = strstr(data_type, "UINT32") ? "UINT32" : "INT32";
-        actual_byte_order = "LITTLE_ENDIAN";  // 3412 = DCBA (word swap) = reg[1]<<16 | reg[0]
-    } else if (strstr(data_type, "INT32_2143") || strstr(data_type, "UINT32_2143")) {
-        actual_data_type = strstr(data_type, "UINT32") ? "UINT32" : "INT32";
-        actual_byte_order = "MIXED_BADC";     // 2143 = BADC = MIXED_BADC
+static void sensor_format_hex(const uint16_t *registers, int reg_count, char *out, size_t out_size)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    size_t pos = 0;
+    for (int i = 0; i < reg_count && i < 12 && pos + 5 < out_size; i++) {
+        out[pos++] = digits[(registers[i] >> 12) & 0xF];
+        out[pos++] = digits[(registers[i] >> 8) & 0xF];
+        out[pos++] = digits[(registers[i] >> 4) & 0xF];
+        out[pos++] = digits[registers[i] & 0xF];
+        out[pos++] = ' ';
     }
-    
-    // 32-bit Float formats
-    else if (strstr(data_type, "FLOAT32_1234")) {
-        actual_data_type = "FLOAT32";
-        actual_byte_order = "BIG_ENDIAN";     // 1234 = ABCD
-    } else if (strstr(data_type, "FLOAT32_4321")) {
-        actual_data_type = "FLOAT32";
-        actual_byte_order = "LITTLE_ENDIAN";  // 4321 = DCBA
-    } else if (strstr(data_type, "FLOAT32_3412")) {
-        actual_data_type = "FLOAT32";
-        actual_byte_order = "LITTLE_ENDIAN";  // 3412 = DCBA (word swap)
-    } else if (strstr(data_type, "FLOAT32_2143")) {
-        actual_data_type = "FLOAT32";
-        actual_byte_order = "MIXED_BADC";     // 2143 = BADC
+    out[pos] = '\0';
+}
+
+// Decode a block of raw registers with a compiled decoder. Shared by the live
+// test path and the coalesced poll, which hands in a slice of a larger window read.
+static esp_err_t sensor_decode_compiled(const sensor_decoder_t *decoder, const sensor_config_t *sensor,
+                                        const uint16_t *registers, int reg_count, sensor_test_result_t *result)
+{
+    if (reg_count < decoder->quantity) {
+        result->success = false;
+        snprintf(result->error_message, sizeof(result->error_message), 
+                "Insufficient registers received: got %d, expected %d", reg_count, decoder->quantity);
+        return ESP_FAIL;
     }
-    
-    // 64-bit formats - Handle both full and truncated format names
-    else if (strstr(data_type, "INT64_12345678") || strstr(data_type, "UINT64_12345678") || strstr(data_type, "FLOAT64_12345678") ||
-             strstr(data_type, "INT64_1234567") || strstr(data_type, "UINT64_1234567") || strstr(data_type, "FLOAT64_1234567")) {
-        actual_data_type = strstr(data_type, "UINT64") ? "UINT64" : strstr(data_type, "FLOAT64") ? "FLOAT64" : "INT64";
-        actual_byte_order = "BIG_ENDIAN";     // 12345678/1234567 = standard order
-    } else if (strstr(data_type, "INT64_87654321") || strstr(data_type, "UINT64_87654321") || strstr(data_type, "FLOAT64_87654321") ||
-               strstr(data_type, "INT64_8765432") || strstr(data_type, "UINT64_8765432") || strstr(data_type, "FLOAT64_8765432")) {
-        actual_data_type = strstr(data_type, "UINT64") ? "UINT64" : strstr(data_type, "FLOAT64") ? "FLOAT64" : "INT64";
-        actual_byte_order = "LITTLE_ENDIAN";  // 87654321/8765432 = reversed
-    } else if (strstr(data_type, "INT64_78563412") || strstr(data_type, "UINT64_78563412") || strstr(data_type, "FLOAT64_78563412") ||
-               strstr(data_type, "INT64_7856341") || strstr(data_type, "UINT64_7856341") || strstr(data_type, "FLOAT64_7856341")) {
-        actual_data_type = strstr(data_type, "UINT64") ? "UINT64" : strstr(data_type, "FLOAT64") ? "FLOAT64" : "INT64";
-        actual_byte_order = "MIXED_BADC";     // 78563412/7856341 = mixed order
+
+    sensor_format_hex(registers, reg_count, result->raw_hex, sizeof(result->raw_hex));
+
+    esp_err_t conv_result = sensor_decoder_decode(decoder, sensor, registers, reg_count,
+                                                  &result->scaled_value, &result->raw_value);
+    if (conv_result != ESP_OK) {
+        result->success = false;
+        snprintf(result->error_message, sizeof(result->error_message), 
+                "Data conversion failed");
+        return conv_result;
     }
-    
-    ESP_LOGI(TAG, "Mapped to: Type=%s, Order=%s", actual_data_type, actual_byte_order);
 
-    if (strcmp(actual_data_type, "UINT16") == 0 && reg_count >= 1) {
-        *raw_value = registers[0];
-        *result = (double)(*raw_value) * scale_factor;
-        ESP_LOGI(TAG, "UINT16: Raw=0x%04" PRIX32 " (%" PRIu32 ") -> %.6f", *raw_value, *raw_value, *result);
-        
-    } else if (strcmp(actual_data_type, "INT16") == 0 && reg_count >= 1) {
-        int16_t signed_val = (int16_t)registers[0];
-        *raw_value = registers[0];
-        *result = (double)signed_val * scale_factor;
-        ESP_LOGI(TAG, "INT16: Raw=0x%04" PRIX32 " (%d) -> %.6f", *raw_value, signed_val, *result);
-        
-    } else if ((strcmp(actual_data_type, "UINT32") == 0 || strcmp(actual_data_type, "INT32") == 0) && reg_count >= 2) {
-        uint32_t combined_value;
-        
-        if (strcmp(actual_byte_order, "BIG_ENDIAN") == 0) {
-            // ABCD - reg[0] is high word, reg[1] is low word
-            combined_value = ((uint32_t)registers[0] << 16) | registers[1];
-        } else if (strcmp(actual_byte_order, "LITTLE_ENDIAN") == 0) {
-            // CDAB - reg[1] is high word, reg[0] is low word
-            combined_value = ((uint32_t)registers[1] << 16) | registers[0];
-        } else if (strcmp(actual_byte_order, "MIXED_BADC") == 0) {
-            // BADC - byte swap within each register
-            uint16_t reg0_swapped = ((registers[0] & 0xFF) << 8) | ((registers[0] >> 8) & 0xFF);
-            uint16_t reg1_swapped = ((registers[1] & 0xFF) << 8) | ((registers[1] >> 8) & 0xFF);
-            combined_value = ((uint32_t)reg0_swapped << 16) | reg1_swapped;
-        } else if (strcmp(actual_byte_order, "MIXED_DCBA") == 0) {
-            // DCBA - completely reversed
-            uint16_t reg0_swapped = ((registers[0] & 0xFF) << 8) | ((registers[0] >> 8) & 0xFF);
-            uint16_t reg1_swapped = ((registers[1] & 0xFF) << 8) | ((registers[1] >> 8) & 0xFF);
-            combined_value = ((uint32_t)reg1_swapped << 16) | reg0_swapped;
-        } else {
-            ESP_LOGE(TAG, "Unknown byte order: %s", actual_byte_order);
-            return ESP_ERR_INVALID_ARG;
-        }
+    result->success = true;
+    return ESP_OK;
+}
 
-        *raw_value = combined_value;
-        
-        if (strcmp(actual_data_type, "INT32") == 0) {
-            int32_t signed_val = (int32_t)combined_value;
-            *result = (double)signed_val * scale_factor;
-            ESP_LOGI(TAG, "INT32: Raw=0x%08" PRIX32 " (%" PRId32 ") -> %.6f", combined_value, signed_val, *result);
-        } else {
-            *result = (double)combined_value * scale_factor;
-            ESP_LOGI(TAG, "UINT32: Raw=0x%08" PRIX32 " (%" PRIu32 ") -> %.6f", combined_value, combined_value, *result);
-        }
-        
-    } else if (strcmp(actual_data_type, "HEX") == 0) {
-        // HEX type - concatenate all registers as hex value
-        *raw_value = 0;
-        for (int i = 0; i < reg_count && i < 2; i++) {
-            *raw_value = (*raw_value << 16) | registers[i];
-        }
-        *result = (double)(*raw_value) * scale_factor;
-        ESP_LOGI(TAG, "HEX: Raw=0x%08" PRIX32 " -> %.6f", *raw_value, *result);
-        
-    } else if (strcmp(actual_data_type, "FLOAT32") == 0 && reg_count >= 2) {
-        uint32_t combined_value;
-        
-        if (strcmp(actual_byte_order, "BIG_ENDIAN") == 0) {
-            combined_value = ((uint32_t)registers[0] << 16) | registers[1];
-        } else if (strcmp(actual_byte_order, "LITTLE_ENDIAN") == 0) {
-            combined_value = ((uint32_t)registers[1] << 16) | registers[0];
-        } else {
-            ESP_LOGE(TAG, "FLOAT32 only supports BIG_ENDIAN and LITTLE_ENDIAN");
-            return ESP_ERR_INVALID_ARG;
-        }
-        
-        // Convert to IEEE 754 float
-        union {
-            uint32_t i;
-            float f;
-        } converter;
-        converter.i = combined_value;
-        
-        *raw_value = combined_value;
-        *result = (double)converter.f * scale_factor;
-        ESP_LOGI(TAG, "FLOAT32: Raw=0x%08" PRIX32 " (%.6f) -> %.6f", combined_value, converter.f, *result);
-        
-    } else if (strcmp(actual_data_type, "FLOAT64") == 0 && reg_count >= 4) {
-        // FLOAT64 handling - 4 registers (64-bit double precision)
-        uint64_t combined_value64 = 0;
-        
-        if (strcmp(actual_byte_order, "BIG_ENDIAN") == 0) {
-            // FLOAT64_12345678 (ABCDEFGH) - Standard big endian
-            combined_value64 = ((uint64_t)registers[0] << 48) | ((uint64_t)registers[1] << 32) | 
-                              ((uint64_t)registers[2] << 16) | registers[3];
-        } else if (strcmp(actual_byte_order, "LITTLE_ENDIAN") == 0) {
-            // FLOAT64_87654321 (HGFEDCBA) - Full little endian
-            combined_value64 = ((uint64_t)registers[3] << 48) | ((uint64_t)registers[2] << 32) | 
-                              ((uint64_t)registers[1] << 16) | registers[0];
-        } else if (strcmp(actual_byte_order, "MIXED_BADC") == 0) {
-            // FLOAT64_78563412 (GHEFCDAB) - Mixed byte order
-            uint64_t val64_78563412 = ((uint64_t)(((registers[3] & 0xFF) << 8) | ((registers[3] >> 8) & 0xFF)) << 48) |
-                                     ((uint64_t)(((registers[2] & 0xFF) << 8) | ((registers[2] >> 8) & 0xFF)) << 32) |
-                                     ((uint64_t)(((registers[1] & 0xFF) << 8) | ((registers[1] >> 8) & 0xFF)) << 16) |
-                                     (((registers[0] & 0xFF) << 8) | ((registers[0] >> 8) & 0xFF));
-            combined_value64 = val64_78563412;
-        } else {
-            ESP_LOGE(TAG, "FLOAT64 unsupported byte order: %s", actual_byte_order);
-            return ESP_ERR_INVALID_ARG;
-        }
-        
-        // Convert to IEEE 754 double precision
-        union {
-            uint64_t i;
-            double d;
-        } converter64;
-        converter64.i = combined_value64;
-        
-        *raw_value = (uint32_t)(combined_value64 & 0xFFFFFFFF);  // Store lower 32 bits for compatibility
-        *result = converter64.d * scale_factor;
-        ESP_LOGI(TAG, "FLOAT64: Raw=0x%016" PRIX64 " (%.6f) -> %.6f", combined_value64, converter64.d, *result);
-        
-    } else {
-        // Calculate expected register count for better error message
-        int expected_regs = 1;  // Default for INT16/UINT16
-        if (strcmp(actual_data_type, "UINT32") == 0 || strcmp(actual_data_type, "INT32") == 0 || strcmp(actual_data_type, "FLOAT32") == 0) {
-            expected_regs = 2;
-        } else if (strcmp(actual_data_type, "FLOAT64") == 0 || strcmp(actual_data_type, "INT64") == 0 || strcmp(actual_data_type, "UINT64") == 0) {
-            expected_regs = 4;
-        }
-        
-        ESP_LOGE(TAG, "Unsupported data type or insufficient registers: %s -> %s (need %d, have %d)", 
-                 data_type, actual_data_type, expected_regs, reg_count);
+// Decode a block of raw registers according to the sensor configuration. Compiles
+// the decoder on every call; configured sensors use the table instead.
+esp_err_t sensor_decode_registers(const sensor_config_t *sensor, const uint16_t *registers,
+                                  int reg_count, sensor_test_result_t *result)
+{
+    if (!sensor || !registers || !result) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    return ESP_OK;
+    sensor_decoder_t decoder;
+    sensor_decoder_compile(sensor, &decoder);
+    return sensor_decode_compiled(&decoder, sensor, registers, reg_count, result);
 }
 
-esp_err_t sensor_test_live(const sensor_config_t *sensor, sensor_test_result_t *result)
+// Decoder of a configured sensor or sub-sensor, NULL for ad-hoc configurations
+// (config NULL), which are compiled on the fly. Caller holds s_poll_mutex.
+static const sensor_decoder_t *sensor_table_decoder(const system_config_t *config, int sensor_index,
+                                                    int sub_index)
+{
+    return config ? sensor_decoder_lookup(config, sensor_index, sub_index) : NULL;
+}
+
+static esp_err_t sensor_test_live_at(const sensor_config_t *sensor, const sensor_decoder_t *decoder,
+                                     sensor_test_result_t *result, modbus_bus_priority_t priority)
 {
     if (!sensor || !result) {
         return ESP_ERR_INVALID_ARG;
@@ -217,13 +141,9 @@ esp_err_t sensor_test_live(const sensor_config_t *sensor, sensor_test_result_t *
     // Clear result
     memset(result, 0, sizeof(sensor_test_result_t));
     
-    ESP_LOGI(TAG, "Testing sensor: %s (Unit: %s, Slave: %d)", 
-             sensor->name, sensor->unit_id, sensor->slave_id);
+    TRACE_INFO(TRACE_EV_SENSOR_READ, sensor->slave_id, sensor->register_address);
 
-    uint32_t start_time = esp_timer_get_time() / 1000;
-    
-    // Perform Modbus read based on register type
-    modbus_result_t modbus_result;
+    uint32_t start_time = modbus_port_now_us() / 1000;
     
     // Default to HOLDING if register_type is empty or invalid
     const char* reg_type = sensor->register_type;
@@ -233,43 +153,26 @@ esp_err_t sensor_test_live(const sensor_config_t *sensor, sensor_test_result_t *
         reg_type = "HOLDING";
     }
     
-    // For Flow-Meter, ZEST, and Panda USM sensors, read 4 registers
-    int quantity_to_read = sensor->quantity;
-    if (strcmp(sensor->sensor_type, "Flow-Meter") == 0) {
-        quantity_to_read = 4;
-        ESP_LOGI(TAG, "Flow-Meter sensor detected, reading 4 registers for UINT32_BADC + FLOAT32_BADC interpretation");
-    } else if (strcmp(sensor->sensor_type, "ZEST") == 0) {
-        quantity_to_read = 4;
-        ESP_LOGI(TAG, "ZEST sensor detected, reading 4 registers for UINT32_CDAB + FLOAT32_ABCD interpretation");
-    } else if (strcmp(sensor->sensor_type, "Panda_USM") == 0) {
-        quantity_to_read = 4;
-        ESP_LOGI(TAG, "Panda USM sensor detected, reading 4 registers for DOUBLE64 (Net Volume)");
-    }
+    // Flow-Meter, ZEST and Panda USM composites always span 4 registers
+    int quantity_to_read = poll_item_quantity(sensor);
     
-    // Set the baud rate for this sensor
-    int baud_rate = sensor->baud_rate > 0 ? sensor->baud_rate : 9600;
-    ESP_LOGI(TAG, "Setting baud rate to %d bps for sensor '%s'", baud_rate, sensor->name);
-    esp_err_t baud_err = modbus_set_baud_rate(baud_rate);
-    if (baud_err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set baud rate for sensor '%s': %s", sensor->name, esp_err_to_name(baud_err));
-        // Continue anyway with current baud rate
-    }
-    
-    if (strcmp(reg_type, "HOLDING") == 0) {
-        modbus_result = modbus_read_holding_registers(sensor->slave_id, 
-                                                     sensor->register_address, 
-                                                     quantity_to_read);
-    } else if (strcmp(reg_type, "INPUT") == 0) {
-        modbus_result = modbus_read_input_registers(sensor->slave_id, 
-                                                   sensor->register_address, 
-                                                   quantity_to_read);
-    } else {
+    if (quantity_to_read < 1 || quantity_to_read > MODBUS_MAX_REGISTERS) {
         snprintf(result->error_message, sizeof(result->error_message), 
-                "Unknown register type: %s", reg_type);
+                "Invalid quantity: %d", quantity_to_read);
         return ESP_ERR_INVALID_ARG;
     }
-
-    result->response_time_ms = (esp_timer_get_time() / 1000) - start_time;
+    
+    // The bus task switches to this sensor's line settings before the read
+    modbus_line_config_t line;
+    poll_sensor_line(sensor, &line);
+    uint16_t registers[MODBUS_MAX_REGISTERS];
+    uint16_t reg_count = 0;
+    modbus_result_t modbus_result = modbus_bus_read(priority, &line, sensor->slave_id,
+                                                    poll_function_code(reg_type),
+                                                    sensor->register_address, quantity_to_read,
+                                                    registers, &reg_count);
+
+    result->response_time_ms = (modbus_port_now_us() / 1000) - start_time;
 
     if (modbus_result != MODBUS_SUCCESS) {
         result->success = false;
@@ -279,227 +182,30 @@ esp_err_t sensor_test_live(const sensor_config_t *sensor, sensor_test_result_t *
         return ESP_FAIL;
     }
 
-    // Get the raw register values
-    uint16_t registers[10];
-    int reg_count = modbus_get_response_length();
-    
-    if (reg_count < sensor->quantity) {
-        result->success = false;
-        snprintf(result->error_message, sizeof(result->error_message), 
-                "Insufficient registers received: got %d, expected %d", reg_count, sensor->quantity);
-        return ESP_FAIL;
+    int64_t decode_start_us = modbus_port_now_us();
+    esp_err_t ret = decoder ? sensor_decode_compiled(decoder, sensor, registers, reg_count, result)
+                            : sensor_decode_registers(sensor, registers, reg_count, result);
+    if (priority == MODBUS_PRIO_POLL) {
+        s_cycle_decode_us += (uint32_t)(modbus_port_now_us() - decode_start_us);
     }
-
-    for (int i = 0; i < reg_count && i < 10; i++) {
-        registers[i] = modbus_get_response_buffer(i);
-    }
-
-    // Create hex representation
-    char hex_buf[64] = {0};
-    for (int i = 0; i < reg_count; i++) {
-        char temp[8];
-        snprintf(temp, sizeof(temp), "%04X ", registers[i]);
-        strncat(hex_buf, temp, sizeof(hex_buf) - strlen(hex_buf) - 1);
-    }
-    strncpy(result->raw_hex, hex_buf, sizeof(result->raw_hex) - 1);
-
-    // Special handling for Flow-Meter sensors (4 registers: UINT32_BADC + FLOAT32_BADC)
-    if (strcmp(sensor->sensor_type, "Flow-Meter") == 0 && reg_count >= 4) {
-        // Flow-Meter reads 4 registers:
-        // Registers [0-1]: Cumulative Flow Integer part (32-bit UINT, BADC word-swapped)
-        // Registers [2-3]: Cumulative Flow Decimal part (32-bit FLOAT, BADC word-swapped)
-        // Example: 33073.865 m³ = 33073 (registers[0-1]) + 0.865 (float in registers[2-3])
-
-        // Integer part: BADC format (word-swapped) = (reg[1] << 16) | reg[0]
-        uint32_t integer_part_raw = ((uint32_t)registers[1] << 16) | registers[0];
-        double integer_part = (double)integer_part_raw;
-
-        // Decimal part: BADC format (word-swapped) = (reg[3] << 16) | reg[2]
-        uint32_t float_bits = ((uint32_t)registers[3] << 16) | registers[2];
-        float decimal_part_float;
-        memcpy(&decimal_part_float, &float_bits, sizeof(float));
-        double decimal_part = (double)decimal_part_float;
-
-        // Sum integer and decimal parts, then apply scale factor
-        result->scaled_value = (integer_part + decimal_part) * sensor->scale_factor;
-        result->raw_value = integer_part_raw; // Store integer part as raw value
-
-        ESP_LOGI(TAG, "Flow-Meter Calculation: Integer=0x%08lX(%lu) + Decimal(FLOAT)=0x%08lX(%.6f) = %.6f",
-                 (unsigned long)integer_part_raw, (unsigned long)integer_part_raw,
-                 (unsigned long)float_bits, decimal_part, result->scaled_value);
-    }
-    // Special handling for ZEST sensors (AquaGen Flow Meter format)
-    else if (strcmp(sensor->sensor_type, "ZEST") == 0 && reg_count >= 4) {
-        // ZEST reads 4 registers (per AquaGen Modbus documentation):
-        // Register [0] @ 0x1019: Cumulative Flow Integer part (16-bit UINT)
-        // Register [1]: Unused (0x0000)
-        // Registers [2,3] @ 0x101B-101C: Cumulative Flow Decimal part (FLOAT32, IEEE 754 Big Endian)
-        // Example: 43.675 m³ = 43 (register[0]) + 0.675 (float in registers[2-3])
-
-        // First register contains the integer part (16-bit value)
-        uint32_t integer_part_raw = (uint32_t)registers[0];
-        double integer_part = (double)integer_part_raw;
-
-        // Registers 2-3 contain decimal part as 32-bit FLOAT Big Endian (ABCD)
-        // Convert to IEEE 754 float: registers[2] is HIGH word, registers[3] is LOW word
-        uint32_t float_bits = ((uint32_t)registers[2] << 16) | registers[3];
-        float decimal_part_float;
-        memcpy(&decimal_part_float, &float_bits, sizeof(float));
-        double decimal_part = (double)decimal_part_float;
-
-        // Sum integer and decimal parts, then apply scale factor
-        result->scaled_value = (integer_part + decimal_part) * sensor->scale_factor;
-        result->raw_value = integer_part_raw; // Store integer part as raw value
-
-        ESP_LOGI(TAG, "ZEST Calculation: Integer=0x%04X(%lu) + Decimal(FLOAT)=0x%08lX(%.6f) = %.6f",
-                 (unsigned int)integer_part_raw, (unsigned long)integer_part_raw,
-                 (unsigned long)float_bits, decimal_part, result->scaled_value);
-    }
-    // Special handling for Panda USM sensors (64-bit double format)
-    else if (strcmp(sensor->sensor_type, "Panda_USM") == 0 && reg_count >= 4) {
-        // Panda USM stores net volume as 64-bit double at register 4
-        // Big-endian format: registers[0] = MSW, registers[3] = LSW
-        uint64_t combined_value64 = ((uint64_t)registers[0] << 48) |
-                                   ((uint64_t)registers[1] << 32) |
-                                   ((uint64_t)registers[2] << 16) |
-                                   registers[3];
-
-        // Convert to double
-        double net_volume;
-        memcpy(&net_volume, &combined_value64, sizeof(double));
-
-        // Apply scale factor
-        result->scaled_value = net_volume * sensor->scale_factor;
-        result->raw_value = (uint32_t)(combined_value64 >> 32); // Store upper 32 bits as raw value
-
-        ESP_LOGI(TAG, "Panda USM Calculation: DOUBLE64=0x%016llX = %.6f m³",
-                 (unsigned long long)combined_value64, result->scaled_value);
-    }
-    // Special handling for Clampon flow meters (4 registers: UINT32_BADC + FLOAT32_BADC)
-    else if (strcmp(sensor->sensor_type, "Clampon") == 0 && reg_count >= 4) {
-        // Clampon reads 4 registers:
-        // Registers [0-1]: Cumulative Flow Integer part (32-bit UINT, BADC word-swapped)
-        // Registers [2-3]: Cumulative Flow Decimal part (32-bit FLOAT, BADC word-swapped)
-        // Example: 33073.865 m³ = 33073 (registers[0-1]) + 0.865 (float in registers[2-3])
-
-        // Integer part: BADC format (word-swapped) = (reg[1] << 16) | reg[0]
-        uint32_t integer_part_raw = ((uint32_t)registers[1] << 16) | registers[0];
-        double integer_part = (double)integer_part_raw;
-
-        // Decimal part: BADC format (word-swapped) = (reg[3] << 16) | reg[2]
-        uint32_t float_bits = ((uint32_t)registers[3] << 16) | registers[2];
-        float decimal_part_float;
-        memcpy(&decimal_part_float, &float_bits, sizeof(float));
-        double decimal_part = (double)decimal_part_float;
-
-        // Sum integer and decimal parts, then apply scale factor
-        result->scaled_value = (integer_part + decimal_part) * sensor->scale_factor;
-        result->raw_value = integer_part_raw; // Store integer part as raw value
-
-        ESP_LOGI(TAG, "Clampon Calculation: Integer=0x%08lX(%lu) + Decimal(FLOAT)=0x%08lX(%.6f) = %.6f",
-                 (unsigned long)integer_part_raw, (unsigned long)integer_part_raw,
-                 (unsigned long)float_bits, decimal_part, result->scaled_value);
-    }
-    // Special handling for Dailian EMF flow meters (2 registers: UINT32 word-swapped totaliser)
-    else if (strcmp(sensor->sensor_type, "Dailian_EMF") == 0 && reg_count >= 2) {
-        // Dailian EMF reads 2 registers at address 0x07D6 (2006):
-        // Registers [0-1]: Totaliser value (32-bit UINT, word-swapped)
-        // Format: (reg[1] << 16) | reg[0]
-
-        // Totaliser: word-swapped = (reg[1] << 16) | reg[0]
-        uint32_t totaliser_raw = ((uint32_t)registers[1] << 16) | registers[0];
-
-        // Apply scale factor
-        result->scaled_value = (double)totaliser_raw * sensor->scale_factor;
-        result->raw_value = totaliser_raw;
-
-        ESP_LOGI(TAG, "Dailian_EMF Calculation: Totaliser=0x%08lX(%lu) * %.6f = %.6f",
-                 (unsigned long)totaliser_raw, (unsigned long)totaliser_raw,
-                 sensor->scale_factor, result->scaled_value);
-    }
-    // Special handling for Panda EMF flow meters (4 registers: INT32_BE + FLOAT32_BE)
-    else if (strcmp(sensor->sensor_type, "Panda_EMF") == 0 && reg_count >= 4) {
-        // Panda EMF reads 4 registers at address 0x1012 (4114):
-        // Registers [0-1]: Totalizer integer part (32-bit INT, big-endian)
-        // Registers [2-3]: Totalizer decimal part (32-bit FLOAT, big-endian)
-        // Total = integer_part + float_decimal
-
-        // Integer part: Big-endian = (reg[0] << 16) | reg[1]
-        int32_t integer_part = (int32_t)(((uint32_t)registers[0] << 16) | registers[1]);
-        double integer_value = (double)integer_part;
-
-        // Decimal part: Big-endian = (reg[2] << 16) | reg[3]
-        uint32_t float_bits = ((uint32_t)registers[2] << 16) | registers[3];
-        float decimal_part_float;
-        memcpy(&decimal_part_float, &float_bits, sizeof(float));
-        double decimal_value = (double)decimal_part_float;
-
-        // Sum integer and decimal parts, then apply scale factor
-        result->scaled_value = (integer_value + decimal_value) * sensor->scale_factor;
-        result->raw_value = (uint32_t)integer_part; // Store integer part as raw value
-
-        ESP_LOGI(TAG, "Panda_EMF Calculation: Integer=0x%08lX(%ld) + Decimal(FLOAT)=0x%08lX(%.6f) = %.6f",
-                 (unsigned long)((uint32_t)integer_part), (long)integer_part,
-                 (unsigned long)float_bits, decimal_value, result->scaled_value);
-    }
-    // Special handling for Panda Level sensors (1 register: UINT16 level value)
-    else if (strcmp(sensor->sensor_type, "Panda_Level") == 0 && reg_count >= 1) {
-        // Panda Level reads 1 register at address 0x0001 (1):
-        // Register [0]: Level value (distance from sensor to water surface)
-        // Calculation: Level % = ((Sensor Height - Raw Value) / Tank Height) * 100
-
-        // Raw level value (distance reading)
-        uint16_t raw_level = registers[0];
-        double level_value = (double)raw_level;
-
-        // Apply the level calculation if sensor_height and max_water_level are set
-        if (sensor->max_water_level > 0) {
-            // Level % = ((Sensor Height - Raw Value) / Tank Height) * 100
-            result->scaled_value = ((sensor->sensor_height - level_value) / sensor->max_water_level) * 100.0;
-            // Clamp to 0-100% range
-            if (result->scaled_value < 0) result->scaled_value = 0.0;
-            if (result->scaled_value > 100) result->scaled_value = 100.0;
-        } else {
-            // If no tank height set, just return raw value scaled
-            result->scaled_value = level_value * sensor->scale_factor;
-        }
-        result->raw_value = raw_level;
-
-        ESP_LOGI(TAG, "Panda_Level Calculation: Raw=%u, SensorHeight=%.2f, TankHeight=%.2f, Level%%=%.2f",
-                 raw_level, sensor->sensor_height, sensor->max_water_level, result->scaled_value);
-    } else {
-        // Convert the data using standard conversion
-        esp_err_t conv_result = convert_modbus_data(registers, reg_count,
-                                                   sensor->data_type, sensor->byte_order,
-                                                   sensor->scale_factor,
-                                                   &result->scaled_value, &result->raw_value);
-
-        if (conv_result != ESP_OK) {
-            result->success = false;
-            snprintf(result->error_message, sizeof(result->error_message), 
-                    "Data conversion failed");
-            return conv_result;
-        }
+    if (ret != ESP_OK) {
+        return ret;
     }
 
-    result->success = true;
-    ESP_LOGI(TAG, "Test successful: %.6f (Response: %lu ms)", 
-             result->scaled_value, result->response_time_ms);
+    TRACE_INFO(TRACE_EV_SENSOR_VALUE, sensor->slave_id, trace_float((float)result->scaled_value));
 
     return ESP_OK;
 }
 
-esp_err_t sensor_read_single(const sensor_config_t *sensor, sensor_reading_t *reading)
+// Interactive reads (web UI, sensor tests) queue behind scheduled polls
+esp_err_t sensor_test_live(const sensor_config_t *sensor, sensor_test_result_t *result)
 {
-    if (!sensor || !reading) {
-        return ESP_ERR_INVALID_ARG;
-    }
-
-    // For water quality sensors, use specialized multi-parameter reading
-    if (strcmp(sensor->sensor_type, "QUALITY") == 0) {
-        return sensor_read_quality(sensor, reading);
-    }
+    return sensor_test_live_at(sensor, NULL, result, MODBUS_PRIO_INTERACTIVE);
+}
 
+// Fill the common header of a reading (identity and timestamp)
+static void sensor_reading_begin(const sensor_config_t *sensor, sensor_reading_t *reading)
+{
     // Clear reading
     memset(reading, 0, sizeof(sensor_reading_t));
     
@@ -513,94 +219,112 @@ esp_err_t sensor_read_single(const sensor_config_t *sensor, sensor_reading_t *re
     time(&now);
     gmtime_r(&now, &timeinfo);
     strftime(reading->timestamp, sizeof(reading->timestamp), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
+}
 
-    // Test the sensor
-    sensor_test_result_t test_result;
-    esp_err_t ret = sensor_test_live(sensor, &test_result);
-    
-    if (ret == ESP_OK && test_result.success) {
-        // Apply sensor type-specific calculations
-        if (strcmp(sensor->sensor_type, "Level") == 0) {
-            // Level sensor calculation: (Sensor Height - Raw Value) / Maximum Water Level * 100
-            double raw_scaled_value = test_result.scaled_value;
-            double level_percentage = 0.0;
-            
-            if (sensor->max_water_level > 0) {
-                level_percentage = ((sensor->sensor_height - raw_scaled_value) / sensor->max_water_level) * 100.0;
-                // Ensure percentage is within reasonable bounds
-                if (level_percentage < 0) level_percentage = 0.0;
-                if (level_percentage > 100) level_percentage = 100.0;
-            }
-            
-            reading->value = level_percentage;
-            ESP_LOGI(TAG, "Level Sensor %s: Raw=%.6f, Height=%.2f, MaxLevel=%.2f -> %.2f%%", 
-                     reading->unit_id, raw_scaled_value, sensor->sensor_height, sensor->max_water_level, level_percentage);
-        } else if (strcmp(sensor->sensor_type, "Radar Level") == 0) {
-            // Radar Level sensor calculation: (Raw Value / Maximum Water Level) * 100
-            double raw_scaled_value = test_result.scaled_value;
-            double level_percentage = 0.0;
-            
-            if (sensor->max_water_level > 0) {
-                level_percentage = (raw_scaled_value / sensor->max_water_level) * 100.0;
-                // Ensure percentage is not negative (but allow over 100% to show overflow)
-                if (level_percentage < 0) level_percentage = 0.0;
-            }
-            
-            reading->value = level_percentage;
-            ESP_LOGI(TAG, "Radar Level Sensor %s: Raw=%.6f, MaxLevel=%.2f -> %.2f%%", 
-                     reading->unit_id, raw_scaled_value, sensor->max_water_level, level_percentage);
-        } else if (strcmp(sensor->sensor_type, "ZEST") == 0) {
-            // ZEST sensor uses the sensor_test_live function which handles the special format
-            // The test_result.scaled_value already contains the combined integer + decimal value
-            reading->value = test_result.scaled_value;
-            ESP_LOGI(TAG, "ZEST Sensor %s: %.6f", reading->unit_id, reading->value);
-        } else {
-            // Flow-Meter or other sensor types use direct scaled value
-            reading->value = test_result.scaled_value;
-            ESP_LOGI(TAG, "Sensor %s: %.6f", reading->unit_id, reading->value);
-        }
-        
-        reading->valid = true;
-        reading->raw_value = test_result.raw_value;
-        strncpy(reading->raw_hex, test_result.raw_hex, sizeof(reading->raw_hex) - 1);
-        strncpy(reading->data_source, "modbus_rs485", sizeof(reading->data_source) - 1);
-        reading->data_source[sizeof(reading->data_source) - 1] = '\0';
-    } else {
+// Turn a decoded test result into a reading, applying sensor type-specific calculations
+static void sensor_reading_apply(const sensor_config_t *sensor, const sensor_test_result_t *test_result,
+                                 sensor_reading_t *reading)
+{
+    if (!test_result->success) {
         reading->valid = false;
         strncpy(reading->data_source, "error", sizeof(reading->data_source) - 1);
         reading->data_source[sizeof(reading->data_source) - 1] = '\0';
-        ESP_LOGE(TAG, "Failed to read sensor %s: %s", reading->unit_id, test_result.error_message);
+        ESP_LOGE(TAG, "Failed to read sensor %s: %s", reading->unit_id, test_result->error_message);
+        return;
     }
 
-    return ret;
+    if (strcmp(sensor->sensor_type, "Level") == 0) {
+        // Level sensor calculation: (Sensor Height - Raw Value) / Maximum Water Level * 100
+        double raw_scaled_value = test_result->scaled_value;
+        double level_percentage = 0.0;
+        
+        if (sensor->max_water_level > 0) {
+            level_percentage = ((sensor->sensor_height - raw_scaled_value) / sensor->max_water_level) * 100.0;
+            // Ensure percentage is within reasonable bounds
+            if (level_percentage < 0) level_percentage = 0.0;
+            if (level_percentage > 100) level_percentage = 100.0;
+        }
+        
+        reading->value = level_percentage;
+    } else if (strcmp(sensor->sensor_type, "Radar Level") == 0) {
+        // Radar Level sensor calculation: (Raw Value / Maximum Water Level) * 100
+        double raw_scaled_value = test_result->scaled_value;
+        double level_percentage = 0.0;
+        
+        if (sensor->max_water_level > 0) {
+            level_percentage = (raw_scaled_value / sensor->max_water_level) * 100.0;
+            // Ensure percentage is not negative (but allow over 100% to show overflow)
+            if (level_percentage < 0) level_percentage = 0.0;
+        }
+        
+        reading->value = level_percentage;
+    } else {
+        // Flow-Meter, ZEST and other sensor types use the decoded value directly
+        reading->value = test_result->scaled_value;
+    }
+    TRACE_DEBUG(TRACE_EV_READING_VALUE, sensor->slave_id, trace_float((float)reading->value));
+    
+    reading->valid = true;
+    reading->raw_value = test_result->raw_value;
+    strncpy(reading->raw_hex, test_result->raw_hex, sizeof(reading->raw_hex) - 1);
+    strncpy(reading->data_source, "modbus_rs485", sizeof(reading->data_source) - 1);
+    reading->data_source[sizeof(reading->data_source) - 1] = '\0';
 }
 
-// Read water quality sensor with multiple sub-parameters
-esp_err_t sensor_read_quality(const sensor_config_t *sensor, sensor_reading_t *reading)
+static esp_err_t sensor_read_quality_at(const sensor_config_t *sensor, const system_config_t *config,
+                                        int sensor_index, sensor_reading_t *reading,
+                                        modbus_bus_priority_t priority);
+
+// config and sensor_index locate a configured sensor; config is NULL for ad-hoc ones
+static esp_err_t sensor_read_single_at(const sensor_config_t *sensor, const system_config_t *config,
+                                       int sensor_index, sensor_reading_t *reading,
+                                       modbus_bus_priority_t priority)
 {
     if (!sensor || !reading) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    // Check if this is a water quality sensor
-    if (strcmp(sensor->sensor_type, "QUALITY") != 0) {
-        ESP_LOGE(TAG, "Sensor %s is not a QUALITY sensor", sensor->name);
-        return ESP_ERR_INVALID_ARG;
+    // For water quality sensors, use specialized multi-parameter reading
+    if (strcmp(sensor->sensor_type, "QUALITY") == 0) {
+        return sensor_read_quality_at(sensor, config, sensor_index, reading, priority);
     }
 
-    // Clear reading
-    memset(reading, 0, sizeof(sensor_reading_t));
-    
-    // Copy basic info
-    strncpy(reading->unit_id, sensor->unit_id, sizeof(reading->unit_id) - 1);
-    strncpy(reading->sensor_name, sensor->name, sizeof(reading->sensor_name) - 1);
-    
-    // Get timestamp
-    time_t now;
-    struct tm timeinfo;
-    time(&now);
-    gmtime_r(&now, &timeinfo);
-    strftime(reading->timestamp, sizeof(reading->timestamp), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
+    sensor_reading_begin(sensor, reading);
+
+    // Test the sensor
+    sensor_test_result_t test_result;
+    const sensor_decoder_t *decoder = sensor_table_decoder(config, sensor_index, SENSOR_DECODER_MAIN);
+    esp_err_t ret = sensor_test_live_at(sensor, decoder, &test_result, priority);
+    if (ret != ESP_OK) {
+        test_result.success = false;
+    }
+    sensor_reading_apply(sensor, &test_result, reading);
+
+    return ret;
+}
+
+esp_err_t sensor_read_single(const sensor_config_t *sensor, sensor_reading_t *reading)
+{
+    return sensor_read_single_at(sensor, NULL, -1, reading, MODBUS_PRIO_INTERACTIVE);
+}
+
+// Build the effective sensor config of a water quality sub-sensor
+static void sensor_make_sub_config(const sensor_config_t *sensor, const sub_sensor_t *sub_sensor,
+                                   sensor_config_t *temp_sensor)
+{
+    *temp_sensor = *sensor;  // Copy main sensor config
+    temp_sensor->slave_id = sub_sensor->slave_id;
+    temp_sensor->register_address = sub_sensor->register_address;
+    temp_sensor->quantity = sub_sensor->quantity;
+    strncpy(temp_sensor->data_type, sub_sensor->data_type, sizeof(temp_sensor->data_type) - 1);
+    strncpy(temp_sensor->register_type, sub_sensor->register_type, sizeof(temp_sensor->register_type) - 1);
+    temp_sensor->scale_factor = sub_sensor->scale_factor;
+    strncpy(temp_sensor->byte_order, sub_sensor->byte_order, sizeof(temp_sensor->byte_order) - 1);
+}
+
+static void sensor_quality_begin(const sensor_config_t *sensor, sensor_reading_t *reading)
+{
+    sensor_reading_begin(sensor, reading);
 
     // Initialize default parameter values
     reading->quality_params.ph_value = 7.0;        // Default pH
@@ -610,6 +334,62 @@ esp_err_t sensor_read_quality(const sensor_config_t *sensor, sensor_reading_t *r
     reading->quality_params.tss_value = 10.0;      // Default TSS
     reading->quality_params.bod_value = 5.0;       // Default BOD
     reading->quality_params.cod_value = 8.0;       // Default COD
+}
+
+// Map a decoded sub-sensor value to the correct field based on its JSON key
+static void sensor_quality_apply(const sub_sensor_t *sub_sensor, double scaled_value, sensor_reading_t *reading)
+{
+    TRACE_DEBUG(TRACE_EV_QUALITY_PARAM, sub_sensor->register_address, trace_float((float)scaled_value));
+    if (strcmp(sub_sensor->json_key, "pH") == 0) {
+        reading->quality_params.ph_value = scaled_value;
+    } else if (strcmp(sub_sensor->json_key, "TDS") == 0) {
+        reading->quality_params.tds_value = scaled_value;
+    } else if (strcmp(sub_sensor->json_key, "Temp") == 0) {
+        reading->quality_params.temp_value = scaled_value;
+    } else if (strcmp(sub_sensor->json_key, "HUMIDITY") == 0) {
+        reading->quality_params.humidity_value = scaled_value;
+    } else if (strcmp(sub_sensor->json_key, "TSS") == 0) {
+        reading->quality_params.tss_value = scaled_value;
+    } else if (strcmp(sub_sensor->json_key, "BOD") == 0) {
+        reading->quality_params.bod_value = scaled_value;
+    } else if (strcmp(sub_sensor->json_key, "COD") == 0) {
+        reading->quality_params.cod_value = scaled_value;
+    } else {
+        ESP_LOGW(TAG, "Unknown parameter key: %s", sub_sensor->json_key);
+    }
+}
+
+static void sensor_quality_finish(bool any_success, sensor_reading_t *reading)
+{
+    if (any_success) {
+        reading->valid = true;
+        reading->value = reading->quality_params.ph_value; // Use pH as primary value
+        strncpy(reading->data_source, "modbus_rs485_multi", sizeof(reading->data_source) - 1);
+        reading->data_source[sizeof(reading->data_source) - 1] = '\0';
+    } else {
+        reading->valid = false;
+        strncpy(reading->data_source, "error", sizeof(reading->data_source) - 1);
+        reading->data_source[sizeof(reading->data_source) - 1] = '\0';
+        ESP_LOGE(TAG, "All sub-sensors failed for water quality sensor %s", reading->unit_id);
+    }
+}
+
+// Read water quality sensor with multiple sub-parameters
+static esp_err_t sensor_read_quality_at(const sensor_config_t *sensor, const system_config_t *config,
+                                        int sensor_index, sensor_reading_t *reading,
+                                        modbus_bus_priority_t priority)
+{
+    if (!sensor || !reading) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Check if this is a water quality sensor
+    if (strcmp(sensor->sensor_type, "QUALITY") != 0) {
+        ESP_LOGE(TAG, "Sensor %s is not a QUALITY sensor", sensor->name);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    sensor_quality_begin(sensor, reading);
 
     bool any_success = false;
     
@@ -621,79 +401,279 @@ esp_err_t sensor_read_quality(const sensor_config_t *sensor, sensor_reading_t *r
             continue;
         }
 
-        ESP_LOGI(TAG, "Reading sub-sensor %d: %s (Slave:%d, Reg:%d)", 
-                 i, sub_sensor->parameter_name, sub_sensor->slave_id, sub_sensor->register_address);
-
         // Create a temporary sensor config for this sub-sensor
-        sensor_config_t temp_sensor = *sensor;  // Copy main sensor config
-        temp_sensor.slave_id = sub_sensor->slave_id;
-        temp_sensor.register_address = sub_sensor->register_address;
-        temp_sensor.quantity = sub_sensor->quantity;
-        strncpy(temp_sensor.data_type, sub_sensor->data_type, sizeof(temp_sensor.data_type) - 1);
-        strncpy(temp_sensor.register_type, sub_sensor->register_type, sizeof(temp_sensor.register_type) - 1);
-        temp_sensor.scale_factor = sub_sensor->scale_factor;
-        strncpy(temp_sensor.byte_order, sub_sensor->byte_order, sizeof(temp_sensor.byte_order) - 1);
+        sensor_config_t temp_sensor;
+        sensor_make_sub_config(sensor, sub_sensor, &temp_sensor);
 
         // Test this sub-sensor
         sensor_test_result_t test_result;
-        esp_err_t ret = sensor_test_live(&temp_sensor, &test_result);
+        const sensor_decoder_t *decoder = sensor_table_decoder(config, sensor_index, i);
+        esp_err_t ret = sensor_test_live_at(&temp_sensor, decoder, &test_result, priority);
         
         if (ret == ESP_OK && test_result.success) {
             any_success = true;
-            double scaled_value = test_result.scaled_value;
-            
-            // Map parameter to the correct field based on JSON key
-            if (strcmp(sub_sensor->json_key, "pH") == 0) {
-                reading->quality_params.ph_value = scaled_value;
-                ESP_LOGI(TAG, "pH: %.2f", scaled_value);
-            } else if (strcmp(sub_sensor->json_key, "TDS") == 0) {
-                reading->quality_params.tds_value = scaled_value;
-                ESP_LOGI(TAG, "TDS: %.2f ppm", scaled_value);
-            } else if (strcmp(sub_sensor->json_key, "Temp") == 0) {
-                reading->quality_params.temp_value = scaled_value;
-                ESP_LOGI(TAG, "Temperature: %.2fdegC", scaled_value);
-            } else if (strcmp(sub_sensor->json_key, "HUMIDITY") == 0) {
-                reading->quality_params.humidity_value = scaled_value;
-                ESP_LOGI(TAG, "Humidity: %.2f%%", scaled_value);
-            } else if (strcmp(sub_sensor->json_key, "TSS") == 0) {
-                reading->quality_params.tss_value = scaled_value;
-                ESP_LOGI(TAG, "TSS: %.2f mg/L", scaled_value);
-            } else if (strcmp(sub_sensor->json_key, "BOD") == 0) {
-                reading->quality_params.bod_value = scaled_value;
-                ESP_LOGI(TAG, "BOD: %.2f mg/L", scaled_value);
-            } else if (strcmp(sub_sensor->json_key, "COD") == 0) {
-                reading->quality_params.cod_value = scaled_value;
-                ESP_LOGI(TAG, "COD: %.2f mg/L", scaled_value);
-            } else {
-                ESP_LOGW(TAG, "Unknown parameter key: %s", sub_sensor->json_key);
-            }
+            sensor_quality_apply(sub_sensor, test_result.scaled_value, reading);
         } else {
             ESP_LOGE(TAG, "Failed to read sub-sensor %s: %s", 
                      sub_sensor->parameter_name, test_result.error_message);
         }
     }
 
-    if (any_success) {
-        reading->valid = true;
-        reading->value = reading->quality_params.ph_value; // Use pH as primary value
-        strncpy(reading->data_source, "modbus_rs485_multi", sizeof(reading->data_source) - 1);
-        reading->data_source[sizeof(reading->data_source) - 1] = '\0';
-        ESP_LOGI(TAG, "Water Quality Sensor %s: pH=%.2f, TDS=%.2f, Temp=%.2fdegC, Humidity=%.2f%%, TSS=%.2f, BOD=%.2f, COD=%.2f",
-                 reading->unit_id,
-                 reading->quality_params.ph_value, reading->quality_params.tds_value,
-                 reading->quality_params.temp_value, reading->quality_params.humidity_value,
-                 reading->quality_params.tss_value, reading->quality_params.bod_value,
-                 reading->quality_params.cod_value);
+    sensor_quality_finish(any_success, reading);
+
+    return any_success ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t sensor_read_quality(const sensor_config_t *sensor, sensor_reading_t *reading)
+{
+    return sensor_read_quality_at(sensor, NULL, -1, reading, MODBUS_PRIO_INTERACTIVE);
+}
+
+// Decode one planned item from the registers of its window and fold it into the
+// reading of its sensor
+static void sensor_scatter_item(const system_config_t *config, const poll_item_t *item,
+                                const uint16_t *registers, int reg_count)
+{
+    const sensor_config_t *sensor = &config->sensors[item->sensor_index];
+    sensor_reading_t *reading = &s_cycle_readings[item->sensor_index];
+    sensor_test_result_t test_result;
+    memset(&test_result, 0, sizeof(test_result));
+
+    s_cycle_latency_ms[item->sensor_index] += s_transaction_ms;
+
+    // Compiled when the configuration was last loaded or saved
+    const sensor_decoder_t *decoder = sensor_decoder_lookup(config, item->sensor_index, item->sub_index);
+
+    if (item->sub_index == POLL_ITEM_MAIN_SENSOR) {
+        if (registers) {
+            sensor_decode_compiled(decoder, sensor, registers, reg_count, &test_result);
+        } else {
+            snprintf(test_result.error_message, sizeof(test_result.error_message),
+                     "Modbus error: %d (timeout/CRC/communication)", s_item_error);
+        }
+        sensor_reading_apply(sensor, &test_result, reading);
+        return;
+    }
+
+    const sub_sensor_t *sub_sensor = &sensor->sub_sensors[item->sub_index];
+    if (!registers) {
+        ESP_LOGE(TAG, "Failed to read sub-sensor %s: Modbus error %d",
+                 sub_sensor->parameter_name, s_item_error);
+        return;
+    }
+
+    if (sensor_decode_compiled(decoder, sensor, registers, reg_count, &test_result) == ESP_OK) {
+        s_cycle_any_success[item->sensor_index] = true;
+        sensor_quality_apply(sub_sensor, test_result.scaled_value, reading);
     } else {
-        reading->valid = false;
-        strncpy(reading->data_source, "error", sizeof(reading->data_source) - 1);
-        reading->data_source[sizeof(reading->data_source) - 1] = '\0';
-        ESP_LOGE(TAG, "All sub-sensors failed for water quality sensor %s", reading->unit_id);
+        ESP_LOGE(TAG, "Failed to read sub-sensor %s: %s",
+                 sub_sensor->parameter_name, test_result.error_message);
     }
+}
 
-    return any_success ? ESP_OK : ESP_FAIL;
+// Issue a single scheduled-poll read into registers
+static modbus_result_t sensor_read_range(const modbus_line_config_t *line, uint8_t slave_id, uint8_t function_code,
+                                         uint16_t start_addr, uint16_t quantity, uint16_t *registers)
+{
+    uint16_t count = 0;
+    modbus_result_t result = modbus_bus_read(MODBUS_PRIO_POLL, line, slave_id, function_code,
+                                             start_addr, quantity, registers, &count);
+    if (result == MODBUS_SUCCESS && count < quantity) {
+        return MODBUS_INVALID_RESPONSE;
+    }
+    return result;
+}
+
+// Execute one window: a single transaction for all of its items, falling back to
+// per-item reads if the merged read fails (e.g. a gap register the slave rejects)
+static void sensor_execute_window(const system_config_t *config, const poll_window_t *window)
+{
+    const poll_item_t *items = &s_poll_plan.items[window->first_item];
+    modbus_line_config_t line;
+    poll_window_line(window, &line);
+    int64_t start_us = modbus_port_now_us();
+    modbus_result_t result = sensor_read_range(&line, window->slave_id, window->function_code,
+                                               window->start_addr, window->quantity, s_window_registers);
+    s_transaction_ms = (uint32_t)((modbus_port_now_us() - start_us) / 1000);
+
+    if (result == MODBUS_SUCCESS) {
+        int64_t decode_start_us = modbus_port_now_us();
+        for (int i = 0; i < window->item_count; i++) {
+            const uint16_t *slice = &s_window_registers[items[i].start_addr - window->start_addr];
+            sensor_scatter_item(config, &items[i], slice, items[i].quantity);
+            // Charge the shared transaction to the first item only
+            s_transaction_ms = 0;
+        }
+        s_cycle_decode_us += (uint32_t)(modbus_port_now_us() - decode_start_us);
+        return;
+    }
+
+    if (window->item_count > 1) {
+        ESP_LOGW(TAG, "Merged read slave %d @%u x%u failed (%d), reading %d ranges individually",
+                 window->slave_id, window->start_addr, window->quantity, result, window->item_count);
+    }
+
+    for (int i = 0; i < window->item_count; i++) {
+        if (window->item_count > 1) {
+            start_us = modbus_port_now_us();
+            // Items of a window share its line settings
+            result = sensor_read_range(&line, items[i].slave_id, items[i].function_code,
+                                       items[i].start_addr, items[i].quantity, s_window_registers);
+            s_transaction_ms += (uint32_t)((modbus_port_now_us() - start_us) / 1000);
+        }
+        s_item_error = result;
+        int64_t decode_start_us = modbus_port_now_us();
+        sensor_scatter_item(config, &items[i], result == MODBUS_SUCCESS ? s_window_registers : NULL,
+                            items[i].quantity);
+        s_cycle_decode_us += (uint32_t)(modbus_port_now_us() - decode_start_us);
+        s_transaction_ms = 0;
+    }
+}
+
+static int sensor_line_compare(const modbus_line_config_t *a, const modbus_line_config_t *b)
+{
+    if (a->baud_rate != b->baud_rate) return a->baud_rate < b->baud_rate ? -1 : 1;
+    if (a->parity != b->parity) return a->parity < b->parity ? -1 : 1;
+    if (a->stop_bits != b->stop_bits) return a->stop_bits < b->stop_bits ? -1 : 1;
+    return 0;
+}
+
+// Order sensor indices by line settings (stable, so configuration order is kept
+// within a group) and return the number of distinct groups
+static int sensor_order_by_line(const system_config_t *config, int sensor_count)
+{
+    modbus_line_config_t lines[POLL_PLAN_MAX_SENSORS];
+    for (int i = 0; i < sensor_count; i++) {
+        poll_sensor_line(&config->sensors[i], &lines[i]);
+        s_sensor_order[i] = i;
+    }
+
+    for (int i = 1; i < sensor_count; i++) {
+        int index = s_sensor_order[i];
+        int j = i - 1;
+        while (j >= 0 && sensor_line_compare(&lines[s_sensor_order[j]], &lines[index]) > 0) {
+            s_sensor_order[j + 1] = s_sensor_order[j];
+            j--;
+        }
+        s_sensor_order[j + 1] = index;
+    }
+
+    int groups = 0;
+    const modbus_line_config_t *previous = NULL;
+    for (int i = 0; i < sensor_count; i++) {
+        int index = s_sensor_order[i];
+        if (!config->sensors[index].enabled) {
+            continue;
+        }
+        if (!previous || sensor_line_compare(previous, &lines[index]) != 0) {
+            groups++;
+        }
+        previous = &lines[index];
+    }
+    return groups;
 }
 
+// Run one poll cycle over every enabled sensor and publish the outcome to the
+// sensor cache. Caller holds s_poll_mutex.
+static void sensor_poll_cycle_locked(const system_config_t *config)
+{
+    int64_t cycle_start_us = modbus_port_now_us();
+    modbus_stats_t bus_before;
+    modbus_get_statistics(&bus_before);
+    s_cycle_decode_us = 0;
+
+    int sensor_count = config->sensor_count < POLL_PLAN_MAX_SENSORS ? config->sensor_count : POLL_PLAN_MAX_SENSORS;
+    for (int i = 0; i < sensor_count; i++) {
+        const sensor_config_t *sensor = &config->sensors[i];
+        s_cycle_any_success[i] = false;
+        s_cycle_latency_ms[i] = 0;
+        if (!sensor->enabled) {
+            ESP_LOGW(TAG, "Sensor %d (%s) is disabled", i + 1, sensor->name);
+            continue;
+        }
+        if (strcmp(sensor->sensor_type, "QUALITY") == 0) {
+            sensor_quality_begin(sensor, &s_cycle_readings[i]);
+        } else {
+            sensor_reading_begin(sensor, &s_cycle_readings[i]);
+            // Stays an error unless the plan delivers registers for it
+            strncpy(s_cycle_readings[i].data_source, "error", sizeof(s_cycle_readings[i].data_source) - 1);
+        }
+    }
+
+    if (MODBUS_COALESCE_ENABLED) {
+        poll_plan_build(config, MODBUS_COALESCE_GAP_REGISTERS, &s_poll_plan);
+        ESP_LOGI(TAG, "Poll plan: %d transactions for %d register ranges",
+                 s_poll_plan.window_count, s_poll_plan.item_count);
+        s_cycle_stats.transactions = s_poll_plan.window_count;
+        s_cycle_stats.line_groups = s_poll_plan.line_groups;
+
+        // Windows are grouped by line settings, so the bus task reconfigures the
+        // UART only once per group
+        for (int w = 0; w < s_poll_plan.window_count; w++) {
+            sensor_execute_window(config, &s_poll_plan.windows[w]);
+        }
+
+        for (int i = 0; i < sensor_count; i++) {
+            if (config->sensors[i].enabled && strcmp(config->sensors[i].sensor_type, "QUALITY") == 0) {
+                sensor_quality_finish(s_cycle_any_success[i], &s_cycle_readings[i]);
+            }
+        }
+    } else {
+        // Per-sensor reads, one transaction per sensor / sub-sensor, grouped by
+        // line settings so each group costs one UART reconfiguration
+        s_cycle_stats.line_groups = sensor_order_by_line(config, sensor_count);
+        s_cycle_stats.transactions = 0;
+        for (int n = 0; n < sensor_count; n++) {
+            int i = s_sensor_order[n];
+            if (config->sensors[i].enabled) {
+                int64_t start_us = modbus_port_now_us();
+                sensor_read_single_at(&config->sensors[i], config, i, &s_cycle_readings[i], MODBUS_PRIO_POLL);
+                s_cycle_latency_ms[i] = (uint32_t)((modbus_port_now_us() - start_us) / 1000);
+                s_cycle_stats.transactions++;
+            }
+        }
+    }
+
+    // Reconfigurations are counted by the driver; interactive requests served
+    // during the cycle are included
+    modbus_stats_t bus_after;
+    modbus_get_statistics(&bus_after);
+    s_cycle_stats.cycle_count++;
+    s_cycle_stats.cycle_ms = (uint32_t)((modbus_port_now_us() - cycle_start_us) / 1000);
+    s_cycle_stats.line_reconfigs = bus_after.line_reconfigs - bus_before.line_reconfigs;
+    s_cycle_stats.line_reconfig_ms = (uint32_t)((bus_after.line_reconfig_us - bus_before.line_reconfig_us) / 1000);
+    ESP_LOGI(TAG, "Poll cycle: %lu ms, %d line groups, %lu reconfigurations (%lu ms)",
+             (unsigned long)s_cycle_stats.cycle_ms, s_cycle_stats.line_groups,
+             (unsigned long)s_cycle_stats.line_reconfigs, (unsigned long)s_cycle_stats.line_reconfig_ms);
+
+    uint32_t stage_us[POLL_STAGE_COUNT] = {
+        [POLL_STAGE_ENCODE] = (uint32_t)(bus_after.encode_us - bus_before.encode_us),
+        [POLL_STAGE_TX] = (uint32_t)(bus_after.tx_us - bus_before.tx_us),
+        [POLL_STAGE_WAIT] = (uint32_t)(bus_after.wait_us - bus_before.wait_us),
+        [POLL_STAGE_DECODE] = s_cycle_decode_us,
+    };
+    uint32_t cycle_us = (uint32_t)(modbus_port_now_us() - cycle_start_us);
+    poll_profile_record_cycle(cycle_us, s_cycle_stats.transactions, stage_us);
+    TRACE_INFO(TRACE_EV_POLL_CYCLE, s_cycle_stats.transactions, cycle_us);
+
+    for (int i = 0; i < sensor_count; i++) {
+        if (config->sensors[i].enabled) {
+            sensor_cache_publish(i, &s_cycle_readings[i], s_cycle_latency_ms[i],
+                                 s_cycle_readings[i].valid ? ESP_OK : ESP_FAIL);
+        }
+    }
+    sensor_cache_commit();
+}
+
+static bool sensor_poll_lock(void)
+{
+    if (!s_poll_mutex && sensor_manager_init() != ESP_OK) {
+        return false;
+    }
+    return xSemaphoreTake(s_poll_mutex, portMAX_DELAY) == pdTRUE;
+}
+
+// Poll the bus now and return the valid readings of this cycle
 esp_err_t sensor_read_all_configured(sensor_reading_t *readings, int max_readings, int *actual_count)
 {
     if (!readings || !actual_count || max_readings <= 0) {
@@ -705,27 +685,97 @@ esp_err_t sensor_read_all_configured(sensor_reading_t *readings, int max_reading
 
     ESP_LOGI(TAG, "Reading all configured sensors (%d total)", config->sensor_count);
 
-    for (int i = 0; i < config->sensor_count && *actual_count < max_readings; i++) {
-        if (config->sensors[i].enabled) {
-            ESP_LOGI(TAG, "Reading sensor %d: %s (Unit: %s, Slave: %d)", 
-                     i + 1, config->sensors[i].name, config->sensors[i].unit_id, config->sensors[i].slave_id);
-            esp_err_t ret = sensor_read_single(&config->sensors[i], &readings[*actual_count]);
-            if (ret == ESP_OK && readings[*actual_count].valid) {
-                ESP_LOGI(TAG, "Sensor %s read successfully: %.2f", 
-                         config->sensors[i].unit_id, readings[*actual_count].value);
-                (*actual_count)++;
-            } else {
-                ESP_LOGE(TAG, "Failed to read sensor %s", config->sensors[i].unit_id);
-            }
+    if (!sensor_poll_lock()) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    sensor_poll_cycle_locked(config);
+
+    // Collect results in configuration order
+    for (int i = 0; i < config->sensor_count && i < POLL_PLAN_MAX_SENSORS && *actual_count < max_readings; i++) {
+        if (!config->sensors[i].enabled) {
+            continue;
+        }
+        if (s_cycle_readings[i].valid) {
+            readings[(*actual_count)++] = s_cycle_readings[i];
         } else {
-            ESP_LOGW(TAG, "Sensor %d (%s) is disabled", i + 1, config->sensors[i].name);
+            ESP_LOGE(TAG, "Failed to read sensor %s", config->sensors[i].unit_id);
         }
     }
 
+    xSemaphoreGive(s_poll_mutex);
+
     ESP_LOGI(TAG, "Successfully read %d/%d sensors", *actual_count, config->sensor_count);
     return ESP_OK;
 }
 
+// Poll the bus only if the cache is older than SENSOR_CACHE_MAX_AGE_SEC. Callers
+// that arrive while another task is polling wait for that cycle and reuse it.
+esp_err_t sensor_manager_refresh(void)
+{
+    int64_t max_age_ms = (int64_t)SENSOR_CACHE_MAX_AGE_SEC * 1000;
+    int64_t age_ms = sensor_cache_cycle_age_ms();
+    if (age_ms >= 0 && age_ms < max_age_ms) {
+        return ESP_OK;
+    }
+
+    if (!sensor_poll_lock()) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    age_ms = sensor_cache_cycle_age_ms();
+    if (age_ms < 0 || age_ms >= max_age_ms) {
+        ESP_LOGI(TAG, "Sensor cache stale (%lld ms), forcing a poll", (long long)age_ms);
+        sensor_poll_cycle_locked(get_system_config());
+    }
+
+    xSemaphoreGive(s_poll_mutex);
+    return ESP_OK;
+}
+
+// Last known readings that are valid and fresh, in configuration order. Forces a
+// poll first when the cache has aged past SENSOR_CACHE_MAX_AGE_SEC.
+esp_err_t sensor_get_cached_readings(sensor_reading_t *readings, int max_readings, int *actual_count)
+{
+    if (!readings || !actual_count || max_readings <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *actual_count = 0;
+    sensor_manager_refresh();
+
+    system_config_t *config = get_system_config();
+    int64_t now_us = esp_timer_get_time();
+    sensor_cache_entry_t entry;
+
+    for (int i = 0; i < config->sensor_count && i < SENSOR_CACHE_SLOTS && *actual_count < max_readings; i++) {
+        const sensor_config_t *sensor = &config->sensors[i];
+        if (!sensor->enabled || !sensor_cache_get(i, &entry)) {
+            continue;
+        }
+        // Skip slots left over from a sensor that has since moved or been removed
+        if (strcmp(entry.reading.unit_id, sensor->unit_id) != 0) {
+            continue;
+        }
+        if (entry.last_error != ESP_OK || !entry.reading.valid ||
+            now_us - entry.read_time_us > (int64_t)SENSOR_CACHE_MAX_AGE_SEC * 1000000) {
+            continue;
+        }
+        readings[(*actual_count)++] = entry.reading;
+    }
+
+    return ESP_OK;
+}
+
+// Copy the statistics of the last scheduled poll cycle. Not taken under the poll
+// mutex (a running cycle would block the caller); fields are written once per cycle.
+void sensor_manager_get_cycle_stats(poll_cycle_stats_t *stats)
+{
+    if (stats) {
+        *stats = s_cycle_stats;
+    }
+}
+
 // Utility functions
 const char* get_register_type_description(const char* reg_type)
 {
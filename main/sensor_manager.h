@@ -40,12 +40,27 @@ typedef struct {
     quality_params_t quality_params; // Water quality parameters (for QUALITY sensors)
 } sensor_reading_t;
 
+// Outcome of the last scheduled poll cycle
+typedef struct {
+    uint32_t cycle_count;
+    uint32_t cycle_ms;
+    int transactions;           // Planned reads (sensors when coalescing is off)
+    int line_groups;            // Distinct line settings, visited once each
+    uint32_t line_reconfigs;    // UART reconfigurations during the cycle
+    uint32_t line_reconfig_ms;  // Time spent in them
+} poll_cycle_stats_t;
+
 // Function prototypes
 esp_err_t sensor_manager_init(void);
 esp_err_t sensor_test_live(const sensor_config_t *sensor, sensor_test_result_t *result);
 esp_err_t sensor_read_all_configured(sensor_reading_t *readings, int max_readings, int *actual_count);
+esp_err_t sensor_manager_refresh(void);
+esp_err_t sensor_get_cached_readings(sensor_reading_t *readings, int max_readings, int *actual_count);
+void sensor_manager_get_cycle_stats(poll_cycle_stats_t *stats);
 esp_err_t sensor_read_single(const sensor_config_t *sensor, sensor_reading_t *reading);
 esp_err_t sensor_read_quality(const sensor_config_t *sensor, sensor_reading_t *reading);
+esp_err_t sensor_decode_registers(const sensor_config_t *sensor, const uint16_t *registers,
+                                  int reg_count, sensor_test_result_t *result);
 
 // Utility functions
 const char* get_register_type_description(const char* reg_type);
@@ -53,7 +68,7 @@ const char* get_data_type_description(const char* data_type);
 const char* get_byte_order_description(const char* byte_order);
 
 // Data format conversion
-esp_err_t convert_modbus_data(uint16_t *registers, int reg_count, 
+esp_err_t convert_modbus_data(const uint16_t *registers, int reg_count, 
                              const char* data_type, const char* byte_order,
                              double scale_factor, double *result, uint32_t *raw_value);
 
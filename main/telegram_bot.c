@@ -3,6 +3,9 @@
 
 #include "telegram_bot.h"
 #include "web_config.h"
+#include "sensor_manager.h"
+#include "sensor_cache.h"
+#include "fixed_format.h"
 #include "esp_log.h"
 #include "esp_http_client.h"
 #include "esp_system.h"
@@ -177,14 +180,19 @@ esp_err_t telegram_send_status(void) {
     size_t free_heap = esp_get_free_heap_size();
     size_t min_free_heap = esp_get_minimum_free_heap_size();
 
+    char free_heap_kb[FIXED_FORMAT_BUF_SIZE];
+    char min_heap_kb[FIXED_FORMAT_BUF_SIZE];
+    fixed_format(free_heap_kb, sizeof(free_heap_kb), free_heap / 1024.0, 1);
+    fixed_format(min_heap_kb, sizeof(min_heap_kb), min_free_heap / 1024.0, 1);
+
     char status_msg[1024];
     snprintf(status_msg, sizeof(status_msg),
              "<b>🤖 ESP32 Gateway Status</b>\n"
              "━━━━━━━━━━━━━━━━━━━\n\n"
              "<b>📊 System Info:</b>\n"
              "├ Uptime: %s\n"
-             "├ Free Heap: %.1f KB\n"
-             "└ Min Heap: %.1f KB\n\n"
+             "├ Free Heap: %s KB\n"
+             "└ Min Heap: %s KB\n\n"
              "<b>🌐 Network:</b>\n"
              "├ Mode: %s\n"
              "└ Status: Connected\n\n"
@@ -195,8 +203,8 @@ esp_err_t telegram_send_status(void) {
              "└ Active: %d\n\n"
              "<i>Gateway ID: %s</i>",
              uptime,
-             free_heap / 1024.0,
-             min_free_heap / 1024.0,
+             free_heap_kb,
+             min_heap_kb,
              config->network_mode == NETWORK_MODE_WIFI ? "WiFi" : "SIM",
              config->azure_device_id,
              config->sensor_count,
@@ -220,16 +228,35 @@ esp_err_t telegram_send_sensor_readings(void) {
                       "<b>🌡️ Sensor Readings</b>\n"
                       "━━━━━━━━━━━━━━━━━━━\n\n");
 
+    // Values come from the poll cache; the bus is only read if the cache is stale
+    sensor_manager_refresh();
+    int64_t now_us = esp_timer_get_time();
+
     for (int i = 0; i < config->sensor_count && i < 5; i++) {  // Limit to 5 sensors to fit in message
         if (config->sensors[i].enabled) {
+            sensor_cache_entry_t entry;
+            char value_line[64];
+            if (sensor_cache_get(i, &entry) && entry.reading.valid &&
+                strcmp(entry.reading.unit_id, config->sensors[i].unit_id) == 0) {
+                char value_text[FIXED_FORMAT_BUF_SIZE];
+                fixed_format(value_text, sizeof(value_text), entry.reading.value, 2);
+                snprintf(value_line, sizeof(value_line), "%s (%llds ago%s)",
+                         value_text,
+                         (long long)((now_us - entry.read_time_us) / 1000000),
+                         entry.last_error == ESP_OK ? "" : ", last read failed");
+            } else {
+                snprintf(value_line, sizeof(value_line), "No data");
+            }
+
             offset += snprintf(msg + offset, sizeof(msg) - offset,
                              "<b>%s</b>\n"
                              "├ Type: %s\n"
                              "├ Slave ID: %d\n"
-                             "└ Status: Active\n\n",
+                             "└ Value: %s\n\n",
                              config->sensors[i].name,
                              config->sensors[i].sensor_type,
-                             config->sensors[i].slave_id);
+                             config->sensors[i].slave_id,
+                             value_line);
         }
     }
 
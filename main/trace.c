@@ -0,0 +1,210 @@
+// trace.c - Binary event trace for the Modbus and telemetry hot paths
+
+#include "trace.h"
+#include "esp_timer.h"
+
+// Ring entry. seq is the entry's sequence number + 1 once written and 0 while
+// a writer owns it, so a reader can tell a torn or recycled entry.
+typedef struct {
+    uint32_t seq;
+    uint32_t timestamp_us;                 // Low 32 bits of esp_timer_get_time()
+    uint16_t event;
+    uint16_t a16;
+    uint32_t a32;
+} trace_entry_t;
+
+typedef enum {
+    TRACE_ARGS_SLAVE_FC_ADDR_QTY,
+    TRACE_ARGS_SLAVE_FC_U32,
+    TRACE_ARGS_BYTES,
+    TRACE_ARGS_U16_U32,
+    TRACE_ARGS_U16_FLOAT
+} trace_args_t;
+
+typedef struct {
+    const char *name;
+    trace_args_t args;
+    const char *key16;
+    const char *key32;
+} trace_event_info_t;
+
+static const trace_event_info_t event_info[TRACE_EV_COUNT] = {
+    [TRACE_EV_MODBUS_REQUEST] = {"modbus_request", TRACE_ARGS_SLAVE_FC_ADDR_QTY, NULL, NULL},
+    [TRACE_EV_MODBUS_RESPONSE] = {"modbus_response", TRACE_ARGS_SLAVE_FC_U32, NULL, "wait_us"},
+    [TRACE_EV_MODBUS_ERROR] = {"modbus_error", TRACE_ARGS_SLAVE_FC_U32, NULL, "result"},
+    [TRACE_EV_MODBUS_TIMEOUT] = {"modbus_timeout", TRACE_ARGS_SLAVE_FC_U32, NULL, "timeout_ms"},
+    [TRACE_EV_MODBUS_BYTES] = {"modbus_bytes", TRACE_ARGS_BYTES, NULL, NULL},
+    [TRACE_EV_MODBUS_REGISTER] = {"modbus_register", TRACE_ARGS_U16_U32, "index", "value"},
+    [TRACE_EV_SENSOR_READ] = {"sensor_read", TRACE_ARGS_U16_U32, "slave", "addr"},
+    [TRACE_EV_SENSOR_VALUE] = {"sensor_value", TRACE_ARGS_U16_FLOAT, "slave", "value"},
+    [TRACE_EV_READING_VALUE] = {"reading_value", TRACE_ARGS_U16_FLOAT, "slave", "value"},
+    [TRACE_EV_QUALITY_PARAM] = {"quality_param", TRACE_ARGS_U16_FLOAT, "addr", "value"},
+    [TRACE_EV_POLL_CYCLE] = {"poll_cycle", TRACE_ARGS_U16_U32, "transactions", "cycle_us"},
+    [TRACE_EV_TELEMETRY_VALUE] = {"telemetry_value", TRACE_ARGS_U16_FLOAT, "sensor", "value"},
+    [TRACE_EV_TELEMETRY_BUILD] = {"telemetry_build", TRACE_ARGS_U16_U32, "sensors", "build_us"},
+    [TRACE_EV_TELEMETRY_PUBLISH] = {"telemetry_publish", TRACE_ARGS_U16_U32, "msg_id", "bytes"},
+};
+
+uint8_t trace_level = TRACE_DEFAULT_LEVEL;
+
+static trace_entry_t s_ring[TRACE_RING_SIZE];
+static uint32_t s_head = 0;                // Sequence number of the next entry
+
+void trace_record(trace_event_t event, uint16_t a16, uint32_t a32)
+{
+    uint32_t seq = __atomic_fetch_add(&s_head, 1, __ATOMIC_RELAXED);
+    trace_entry_t *entry = &s_ring[seq & (TRACE_RING_SIZE - 1)];
+
+    __atomic_store_n(&entry->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    entry->timestamp_us = (uint32_t)esp_timer_get_time();
+    entry->event = (uint16_t)event;
+    entry->a16 = a16;
+    entry->a32 = a32;
+    __atomic_store_n(&entry->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+void trace_bytes(const uint8_t *data, size_t length)
+{
+    if (!trace_enabled(TRACE_LEVEL_DEBUG) || !data) {
+        return;
+    }
+    for (size_t offset = 0; offset < length && offset < 256; offset += 4) {
+        size_t count = length - offset < 4 ? length - offset : 4;
+        uint32_t packed = 0;
+        for (size_t i = 0; i < count; i++) {
+            packed |= (uint32_t)data[offset + i] << (24 - 8 * i);
+        }
+        trace_record(TRACE_EV_MODBUS_BYTES, (uint16_t)((count << 8) | offset), packed);
+    }
+}
+
+void trace_set_level(uint8_t level)
+{
+    if (level > TRACE_LEVEL_DEBUG) {
+        level = TRACE_LEVEL_DEBUG;
+    }
+    __atomic_store_n(&trace_level, level, __ATOMIC_RELAXED);
+}
+
+uint8_t trace_get_level(void)
+{
+    return __atomic_load_n(&trace_level, __ATOMIC_RELAXED);
+}
+
+uint32_t trace_head(void)
+{
+    return __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+}
+
+// Marks everything recorded so far as gone; readers continue from the new head
+void trace_clear(void)
+{
+    for (int i = 0; i < TRACE_RING_SIZE; i++) {
+        __atomic_store_n(&s_ring[i].seq, 0, __ATOMIC_RELAXED);
+    }
+}
+
+// Copy an entry, failing if a writer owned or recycled it meanwhile
+static bool trace_read(uint32_t seq, trace_entry_t *out)
+{
+    const trace_entry_t *entry = &s_ring[seq & (TRACE_RING_SIZE - 1)];
+    uint32_t before = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+    if (before != seq + 1) {
+        return false;
+    }
+    out->timestamp_us = entry->timestamp_us;
+    out->event = entry->event;
+    out->a16 = entry->a16;
+    out->a32 = entry->a32;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&entry->seq, __ATOMIC_RELAXED) == before;
+}
+
+static void trace_write_entry(json_writer_t *w, uint32_t seq, const trace_entry_t *entry)
+{
+    const trace_event_info_t *info = entry->event < TRACE_EV_COUNT ? &event_info[entry->event] : NULL;
+
+    json_writer_begin_object(w);
+    json_writer_key_uint(w, "seq", seq);
+    json_writer_key_uint(w, "t_us", entry->timestamp_us);
+    if (!info || !info->name) {
+        json_writer_key_uint(w, "event", entry->event);
+        json_writer_key_uint(w, "a16", entry->a16);
+        json_writer_key_uint(w, "a32", entry->a32);
+        json_writer_end_object(w);
+        return;
+    }
+
+    json_writer_key_string(w, "event", info->name);
+    switch (info->args) {
+        case TRACE_ARGS_SLAVE_FC_ADDR_QTY:
+            json_writer_key_uint(w, "slave", entry->a16 >> 8);
+            json_writer_key_uint(w, "fc", entry->a16 & 0xFF);
+            json_writer_key_uint(w, "addr", entry->a32 >> 16);
+            json_writer_key_uint(w, "qty", entry->a32 & 0xFFFF);
+            break;
+        case TRACE_ARGS_SLAVE_FC_U32:
+            json_writer_key_uint(w, "slave", entry->a16 >> 8);
+            json_writer_key_uint(w, "fc", entry->a16 & 0xFF);
+            json_writer_key_uint(w, info->key32, entry->a32);
+            break;
+        case TRACE_ARGS_BYTES: {
+            static const char digits[] = "0123456789ABCDEF";
+            char hex[9];
+            int count = entry->a16 >> 8;
+            for (int i = 0; i < count && i < 4; i++) {
+                uint8_t byte = (uint8_t)(entry->a32 >> (24 - 8 * i));
+                hex[i * 2] = digits[byte >> 4];
+                hex[i * 2 + 1] = digits[byte & 0xF];
+            }
+            hex[(count < 4 ? count : 4) * 2] = '\0';
+            json_writer_key_uint(w, "offset", entry->a16 & 0xFF);
+            json_writer_key_string(w, "bytes", hex);
+            break;
+        }
+        case TRACE_ARGS_U16_U32:
+            json_writer_key_uint(w, info->key16, entry->a16);
+            json_writer_key_uint(w, info->key32, entry->a32);
+            break;
+        case TRACE_ARGS_U16_FLOAT: {
+            float value;
+            memcpy(&value, &entry->a32, sizeof(value));
+            json_writer_key_uint(w, info->key16, entry->a16);
+            json_writer_key_double(w, info->key32, value, 3);
+            break;
+        }
+    }
+    json_writer_end_object(w);
+}
+
+esp_err_t trace_write_json(json_writer_t *w, uint32_t since)
+{
+    uint32_t head = trace_head();
+    uint32_t oldest = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+    uint32_t start = since;
+    uint32_t lost = 0;
+    if (since > head) {
+        start = oldest;                    // Cursor from before a reboot
+    } else if (since < oldest) {
+        start = oldest;
+        lost = oldest - since;             // Overwritten before they were fetched
+    }
+
+    json_writer_begin_object(w);
+    json_writer_key_uint(w, "level", trace_get_level());
+    json_writer_key_uint(w, "compile_level", TRACE_COMPILE_LEVEL);
+    json_writer_key_uint(w, "head", head);
+    json_writer_key_uint(w, "lost", lost);
+    json_writer_key(w, "events");
+    json_writer_begin_array(w);
+    trace_entry_t entry;
+    for (uint32_t seq = start; seq != head; seq++) {
+        if (trace_read(seq, &entry)) {
+            trace_write_entry(w, seq, &entry);
+        }
+    }
+    json_writer_end_array(w);
+    json_writer_end_object(w);
+    return w->error;
+}
@@ -0,0 +1,88 @@
+// trace.h - Binary event trace for the Modbus and telemetry hot paths
+// Per-transaction, per-register and per-value events are recorded into a
+// fixed ring of small binary entries (timestamp, event id, two arguments)
+// instead of being formatted onto the console, which at 115200 baud costs
+// more than the RS485 transaction it describes. The ring is written lock-free
+// from any task and decoded to JSON by /api/trace; text logging on these paths
+// is kept for warnings and errors.
+//
+// Levels are filtered at compile time (TRACE_COMPILE_LEVEL, so DEBUG events can
+// be compiled out) and at run time (trace_set_level(), /api/trace?level=N).
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "esp_err.h"
+#include "json_writer.h"
+
+#define TRACE_LEVEL_NONE 0
+#define TRACE_LEVEL_INFO 1                 // Per transaction, cycle and telemetry build
+#define TRACE_LEVEL_DEBUG 2                // Per register, response byte and value
+
+#ifndef TRACE_COMPILE_LEVEL
+#define TRACE_COMPILE_LEVEL TRACE_LEVEL_DEBUG
+#endif
+#define TRACE_DEFAULT_LEVEL TRACE_LEVEL_INFO
+#define TRACE_RING_SIZE 256                // Entries, power of two (16 bytes each)
+
+typedef enum {
+    TRACE_EV_MODBUS_REQUEST = 1,           // a16: slave<<8 | fc, a32: addr<<16 | qty (or value)
+    TRACE_EV_MODBUS_RESPONSE,              // a16: slave<<8 | fc, a32: wait in us
+    TRACE_EV_MODBUS_ERROR,                 // a16: slave<<8 | fc, a32: modbus_result_t
+    TRACE_EV_MODBUS_TIMEOUT,               // a16: slave<<8 | fc, a32: timeout applied in ms
+    TRACE_EV_MODBUS_BYTES,                 // a16: count<<8 | offset, a32: up to 4 frame bytes, first in the MSB
+    TRACE_EV_MODBUS_REGISTER,              // a16: index, a32: register value
+    TRACE_EV_SENSOR_READ,                  // a16: slave, a32: register address
+    TRACE_EV_SENSOR_VALUE,                 // a16: slave, a32: decoded value (float)
+    TRACE_EV_READING_VALUE,                // a16: slave, a32: reading after type-specific calculation (float)
+    TRACE_EV_QUALITY_PARAM,                // a16: sub-sensor register address, a32: value (float)
+    TRACE_EV_POLL_CYCLE,                   // a16: transactions, a32: cycle time in us
+    TRACE_EV_TELEMETRY_VALUE,              // a16: sensor index, a32: value (float)
+    TRACE_EV_TELEMETRY_BUILD,              // a16: sensors, a32: build time in us
+    TRACE_EV_TELEMETRY_PUBLISH,            // a16: MQTT message ID, a32: payload bytes
+    TRACE_EV_COUNT
+} trace_event_t;
+
+extern uint8_t trace_level;
+
+static inline bool trace_enabled(uint8_t level)
+{
+    return level <= TRACE_COMPILE_LEVEL && __atomic_load_n(&trace_level, __ATOMIC_RELAXED) >= level;
+}
+
+// Values are traced as float bits; precision beyond 24 bits is not kept
+static inline uint32_t trace_float(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+#define TRACE_SLAVE_FC(slave, fc) ((uint16_t)(((slave) << 8) | ((fc) & 0xFF)))
+
+#define TRACE(level, event, a16, a32) do {                          \
+        if (trace_enabled(level)) {                                 \
+            trace_record((event), (uint16_t)(a16), (uint32_t)(a32)); \
+        }                                                           \
+    } while (0)
+#define TRACE_INFO(event, a16, a32) TRACE(TRACE_LEVEL_INFO, event, a16, a32)
+#define TRACE_DEBUG(event, a16, a32) TRACE(TRACE_LEVEL_DEBUG, event, a16, a32)
+
+// Lock-free; safe from any task
+void trace_record(trace_event_t event, uint16_t a16, uint32_t a32);
+// Frame bytes as TRACE_EV_MODBUS_BYTES entries (DEBUG)
+void trace_bytes(const uint8_t *data, size_t length);
+
+void trace_set_level(uint8_t level);
+uint8_t trace_get_level(void);
+// Sequence number of the next entry; entries before head - TRACE_RING_SIZE are gone
+uint32_t trace_head(void);
+void trace_clear(void);
+
+// Entries with sequence >= since, oldest first
+esp_err_t trace_write_json(json_writer_t *w, uint32_t since);
+
+#endif // TRACE_H
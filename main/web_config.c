@@ -5,6 +5,12 @@
 #include "web_config.h"
 #include "modbus.h"
 #include "sensor_manager.h"
+#include "sensor_cache.h"
+#include "modbus_bus.h"
+#include "poll_planner.h"
+#include "modbus_scan.h"
+#include "sensor_decoder.h"
+#include "json_templates.h"
 #include "iot_configs.h"  // For hardcoded values
 #include "esp_wifi.h"
 #include "esp_event.h"
@@ -25,6 +31,11 @@
 #include "esp_heap_caps.h"
 #include "a7670c_ppp.h"
 #include "sd_card_logger.h"
+#include "sd_history.h"
+#include "fixed_format.h"
+#include "poll_profile.h"
+#include "trace.h"
+#include "metrics.h"
 #include "ds3231_rtc.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -1025,15 +1036,19 @@ esp_err_t test_sensor_connection(const sensor_config_t *sensor, char *result_buf
         return ESP_ERR_INVALID_ARG;
     }
     
-    // Perform Modbus read operation
-    modbus_result_t modbus_result;
+    // Perform Modbus read operation through the bus owner task
+    uint16_t registers[125];
+    uint16_t response_length = 0;
     
     // Use holding registers by default, or input registers if specified
-    if (sensor->register_type[0] && strcmp(sensor->register_type, "INPUT_REGISTER") == 0) {
-        modbus_result = modbus_read_input_registers(sensor->slave_id, sensor->register_address, sensor->quantity);
-    } else {
-        modbus_result = modbus_read_holding_registers(sensor->slave_id, sensor->register_address, sensor->quantity);
-    }
+    uint8_t function_code = (sensor->register_type[0] && strcmp(sensor->register_type, "INPUT_REGISTER") == 0) ?
+                            MODBUS_READ_INPUT_REGISTERS : MODBUS_READ_HOLDING_REGISTERS;
+    modbus_line_config_t line;
+    poll_sensor_line(sensor, &line);
+    modbus_result_t modbus_result = modbus_bus_read(MODBUS_PRIO_INTERACTIVE, &line,
+                                                    sensor->slave_id, function_code,
+                                                    sensor->register_address, sensor->quantity,
+                                                    registers, &response_length);
     
     if (modbus_result != MODBUS_SUCCESS) {
         const char* error_description = "";
@@ -1082,21 +1097,13 @@ esp_err_t test_sensor_connection(const sensor_config_t *sensor, char *result_buf
         return ESP_FAIL;
     }
     
-    // Read successful - get the raw register values
-    uint16_t registers[125];
-    uint8_t response_length = modbus_get_response_length();
-    
+    // Read successful - the raw register values are already in registers[]
     if (response_length < sensor->quantity) {
         snprintf(result_buffer, buffer_size, "[ERROR] Insufficient data received: got %d registers, expected %d", 
                  response_length, sensor->quantity);
         return ESP_FAIL;
     }
     
-    // Copy register values
-    for (int i = 0; i < sensor->quantity && i < response_length; i++) {
-        registers[i] = modbus_get_response_buffer(i);
-    }
-    
     // Convert data based on sensor data type
     double converted_value = 0.0;
     uint32_t raw_value = 0;
@@ -1290,15 +1297,22 @@ static esp_err_t api_modbus_poll_handler(httpd_req_t *req);
 static esp_err_t api_sim_test_handler(httpd_req_t *req);
 static esp_err_t api_sim_test_status_handler(httpd_req_t *req);
 static esp_err_t api_sd_status_handler(httpd_req_t *req);
+static esp_err_t api_history_handler(httpd_req_t *req);
 static esp_err_t api_sd_clear_handler(httpd_req_t *req);
 static esp_err_t api_sd_replay_handler(httpd_req_t *req);
 static esp_err_t api_rtc_time_handler(httpd_req_t *req);
 static esp_err_t api_rtc_sync_handler(httpd_req_t *req);
 static esp_err_t api_rtc_set_handler(httpd_req_t *req);
 static esp_err_t api_modbus_status_handler(httpd_req_t *req);
+static esp_err_t api_poll_profile_handler(httpd_req_t *req);
+static esp_err_t api_trace_handler(httpd_req_t *req);
+static esp_err_t metrics_handler(httpd_req_t *req);
 static esp_err_t api_azure_status_handler(httpd_req_t *req);
 static esp_err_t api_telemetry_history_handler(httpd_req_t *req);
-static esp_err_t modbus_scan_handler(httpd_req_t *req);
+static esp_err_t api_modbus_scan_start_handler(httpd_req_t *req);
+static esp_err_t api_modbus_scan_status_handler(httpd_req_t *req);
+static esp_err_t api_modbus_scan_results_handler(httpd_req_t *req);
+static esp_err_t api_modbus_scan_stop_handler(httpd_req_t *req);
 static esp_err_t modbus_read_live_handler(httpd_req_t *req);
 
 // WiFi scan handler
@@ -1423,10 +1437,10 @@ static esp_err_t wifi_scan_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
-// Live data handler
+// Live data handler - serves the sensor cache, polling only if it has gone stale
 static esp_err_t live_data_handler(httpd_req_t *req)
 {
-    char response[1024];
+    char response[2048];
     time_t now = time(NULL);
     struct tm timeinfo;
     char timestamp[64];
@@ -1436,27 +1450,54 @@ static esp_err_t live_data_handler(httpd_req_t *req)
     
     // Get system configuration for real sensor data
     system_config_t* config = get_system_config();
+    sensor_manager_refresh();
+    int64_t now_us = esp_timer_get_time();
     
     // Start JSON response
     snprintf(response, sizeof(response), 
-        "{\"timestamp\":\"%s\",\"sensors\":[", timestamp);
+        "{\"timestamp\":\"%s\",\"cache_version\":%lu,\"sensors\":[",
+        timestamp, (unsigned long)sensor_cache_version());
+    bool first = true;
     
-    // Add configured sensors with simulated or real data
+    // Add configured sensors with their last known values
     for (int i = 0; i < config->sensor_count && i < 8; i++) {
         if (config->sensors[i].enabled) {
-            char sensor_data[200];
-            float simulated_value = 100.0 + (esp_random() % 5000) / 100.0;
+            char sensor_data[256];
+            sensor_cache_entry_t entry;
+            bool cached = sensor_cache_get(i, &entry) &&
+                          strcmp(entry.reading.unit_id, config->sensors[i].unit_id) == 0;
+            bool has_value = cached && entry.reading.valid;
+            const char *status = "pending";
+            if (cached) {
+                if (entry.last_error == ESP_OK &&
+                    now_us - entry.read_time_us <= (int64_t)SENSOR_CACHE_MAX_AGE_SEC * 1000000) {
+                    status = "live";
+                } else {
+                    status = has_value ? "stale" : "error";
+                }
+            }
+            char value_str[32];
+            if (has_value) {
+                fixed_format(value_str, sizeof(value_str), entry.reading.value, 2);
+            } else {
+                strcpy(value_str, "null");
+            }
             
             snprintf(sensor_data, sizeof(sensor_data),
-                "%s{\"name\":\"%s\",\"unit_id\":\"%s\",\"value\":%.2f,\"slave_id\":%d,\"register\":%d,\"status\":\"simulated\"}",
-                (strlen(response) > 50) ? "," : "",
+                "%s{\"name\":\"%s\",\"unit_id\":\"%s\",\"value\":%s,\"slave_id\":%d,\"register\":%d,"
+                "\"status\":\"%s\",\"age_s\":%lld,\"latency_ms\":%lu}",
+                first ? "" : ",",
                 config->sensors[i].name,
                 config->sensors[i].unit_id,
-                simulated_value,
+                value_str,
                 config->sensors[i].slave_id,
-                config->sensors[i].register_address
+                config->sensors[i].register_address,
+                status,
+                has_value ? (long long)((now_us - entry.read_time_us) / 1000000) : -1LL,
+                cached ? (unsigned long)entry.latency_ms : 0UL
             );
             strncat(response, sensor_data, sizeof(response) - strlen(response) - 1);
+            first = false;
         }
     }
     
@@ -2820,9 +2861,15 @@ static esp_err_t config_page_handler(httpd_req_t *req)
         "<select id='scan_reg_type'>"
         "<option value='holding'>Holding Register (0x03)</option>"
         "<option value='input'>Input Register (0x04)</option>"
+        "<option value='both'>Both (0x03 and 0x04)</option>"
         "</select>"
+        "<label>Baud Rates:</label>"
+        "<input type='text' id='scan_bauds' value='9600' placeholder='9600,19200'>"
+        "<label>Probe Timeout (ms):</label>"
+        "<input type='number' id='scan_timeout' min='20' max='1000' value='100'>"
         "</div>"
         "<button onclick='scanModbusDevices()' class='btn' style='background:var(--color-accent);color:white;width:auto;min-width:200px'>Scan for Devices</button>"
+        "<button onclick='stopModbusScan()' class='btn' style='background:#6c757d;color:white;width:auto;min-width:120px;margin-left:10px'>Stop</button>"
         "<div id='scan_progress' style='margin-top:var(--space-md);padding:var(--space-md);background:var(--color-bg-secondary);border-radius:var(--radius-md);display:none'></div>"
         "<div id='scan_results' style='margin-top:var(--space-md)'></div>"
         "</div>"
@@ -3870,7 +3917,7 @@ static esp_err_t config_page_handler(httpd_req_t *req)
         ".then(r=>r.json())"
         ".then(data=>{"
         "if(data.mounted){"
-        "result.innerHTML='<span style=\"color:#155724\">SD Card: '+data.size_mb+' MB total, '+data.free_mb+' MB free, '+data.cached_messages+' messages cached</span>';"
+        "result.innerHTML='<span style=\"color:#155724\">SD Card: '+data.size_mb+' MB total, '+data.free_mb+' MB free, '+data.cached_messages+' messages cached, SPI '+(data.clock_khz/1000)+' MHz</span>';"
         "result.style.backgroundColor='#d4edda';"
         "}else{"
         "result.innerHTML='<span style=\"color:#721c24\">SD Card not mounted</span>';"
@@ -5357,40 +5404,49 @@ static esp_err_t config_page_handler(httpd_req_t *req)
         "}"
         "}"
         "let autoRefreshInterval=null;"
+        "let scanTimer=null;"
         "function scanModbusDevices(){"
         "const startId=parseInt(document.getElementById('scan_start').value);"
         "const endId=parseInt(document.getElementById('scan_end').value);"
         "const testRegister=parseInt(document.getElementById('scan_register').value);"
         "const regType=document.getElementById('scan_reg_type').value;"
+        "const bauds=document.getElementById('scan_bauds').value.replace(/\\s/g,'');"
+        "const timeoutMs=parseInt(document.getElementById('scan_timeout').value)||100;"
         "const progressDiv=document.getElementById('scan_progress');"
         "const resultsDiv=document.getElementById('scan_results');"
         "if(startId<1||startId>247||endId<1||endId>247||startId>endId){"
         "alert('Invalid slave ID range (1-247)');return;}"
         "progressDiv.style.display='block';"
-        "progressDiv.innerHTML='<div style=\"background:#d1ecf1;padding:10px;border-radius:4px;color:#0c5460\">Scanning devices '+startId+'-'+endId+'...</div>';"
-        "resultsDiv.innerHTML='';"
-        "const data='start_id='+startId+'&end_id='+endId+'&test_register='+testRegister+'&reg_type='+regType;"
-        "fetch('/modbus_scan',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body:data})"
+        "progressDiv.innerHTML='<div style=\"background:#d1ecf1;padding:10px;border-radius:4px;color:#0c5460\">Starting scan '+startId+'-'+endId+'...</div>';"
+        "resultsDiv.innerHTML='<div class=\"sensor-card\"><h3>Discovered Devices (<span id=\"scan_count\">0</span>)</h3><table style=\"width:100%;border-collapse:collapse\"><thead><tr><th>Slave ID</th><th>Function</th><th>Baud</th><th>Response</th><th>Latency</th></tr></thead><tbody id=\"scan_rows\"></tbody></table></div>';"
+        "const data='start_id='+startId+'&end_id='+endId+'&test_register='+testRegister+'&reg_type='+regType+'&bauds='+encodeURIComponent(bauds)+'&timeout_ms='+timeoutMs;"
+        "fetch('/api/modbus_scan/start',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body:data})"
         ".then(response=>response.json()).then(result=>{"
-        "progressDiv.style.display='none';"
-        "if(result.status==='success'){"
-        "if(result.devices.length===0){"
-        "resultsDiv.innerHTML='<div class=\"sensor-card\"><h3>No Devices Found</h3><p>No responsive Modbus devices found in range '+startId+'-'+endId+'</p></div>';"
-        "}else{"
-        "let html='<div class=\"sensor-card\"><h3>Discovered Devices ('+result.devices.length+')</h3><table style=\"width:100%;border-collapse:collapse\"><thead><tr><th>Slave ID</th><th>Status</th></tr></thead><tbody>';"
+        "if(result.status!=='success'){"
+        "progressDiv.innerHTML='<div style=\"background:#f8d7da;padding:10px;border-radius:4px;color:#721c24\">ERROR: '+result.message+'</div>';return;}"
+        "pollModbusScan(result.job_id,0);"
+        "}).catch(error=>{"
+        "progressDiv.innerHTML='<div style=\"background:#f8d7da;padding:10px;border-radius:4px;color:#721c24\">NETWORK ERROR: '+error.message+'</div>';"
+        "});}"
+        "function pollModbusScan(jobId,since){"
+        "fetch('/api/modbus_scan/results?since='+since).then(r=>r.json()).then(result=>{"
+        "if(result.job_id!==jobId)return;"
+        "const rows=document.getElementById('scan_rows');"
         "result.devices.forEach(dev=>{"
-        "html+='<tr><td>'+dev.slave_id+'</td><td><span style=\"color:#28a745;font-weight:bold\">✓ Responsive</span></td></tr>';"
+        "const resp=dev.exception_code?'Exception 0x'+dev.exception_code.toString(16):'Value '+dev.value;"
+        "rows.innerHTML+='<tr><td>'+dev.slave_id+'</td><td>0x0'+dev.function_code+'</td><td>'+dev.baud_rate+' '+dev.parity+'</td><td><span style=\"color:#28a745;font-weight:bold\">'+resp+'</span></td><td>'+dev.latency_ms+' ms</td></tr>';"
         "});"
-        "html+='</tbody></table></div>';"
-        "resultsDiv.innerHTML=html;"
-        "}"
+        "document.getElementById('scan_count').textContent=result.next;"
+        "const progressDiv=document.getElementById('scan_progress');"
+        "const pct=result.probes_total?Math.round(result.probes_done*100/result.probes_total):0;"
+        "if(result.complete){"
+        "progressDiv.innerHTML='<div style=\"background:#d4edda;padding:10px;border-radius:4px;color:#155724\">Scan '+result.state+': '+result.next+' device(s), '+result.probes_done+' probes</div>';"
         "}else{"
-        "resultsDiv.innerHTML='<div style=\"background:#f8d7da;padding:10px;border-radius:4px;color:#721c24\">ERROR: '+result.message+'</div>';"
-        "}"
-        "}).catch(error=>{"
-        "progressDiv.style.display='none';"
-        "resultsDiv.innerHTML='<div style=\"background:#f8d7da;padding:10px;border-radius:4px;color:#721c24\">NETWORK ERROR: '+error.message+'</div>';"
-        "});}"
+        "progressDiv.innerHTML='<div style=\"background:#d1ecf1;padding:10px;border-radius:4px;color:#0c5460\">Scanning... '+pct+'% ('+result.probes_done+'/'+result.probes_total+' probes)</div>';"
+        "scanTimer=setTimeout(()=>pollModbusScan(jobId,result.next),500);}"
+        "}).catch(()=>{scanTimer=setTimeout(()=>pollModbusScan(jobId,since),1000);});}"
+        "function stopModbusScan(){"
+        "fetch('/api/modbus_scan/stop',{method:'POST'});}"
         "function readLiveRegisters(){"
         "const slaveId=parseInt(document.getElementById('live_slave').value);"
         "const startRegister=parseInt(document.getElementById('live_register').value);"
@@ -6164,13 +6220,10 @@ static esp_err_t test_sensor_handler(httpd_req_t *req)
         // (Modbus should be initialized in both setup and operation modes)
         ESP_LOGI(TAG, "Attempting real RS485 Modbus communication...");
         
-        // Set the baud rate for this sensor before testing
-        int baud_rate = sensor->baud_rate > 0 ? sensor->baud_rate : 9600;
-        ESP_LOGI(TAG, "Setting baud rate to %d bps for testing sensor '%s'", baud_rate, sensor->name);
-        esp_err_t baud_err = modbus_set_baud_rate(baud_rate);
-        if (baud_err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to set baud rate: %s", esp_err_to_name(baud_err));
-        }
+        // The bus task applies this sensor's line settings before the read
+        modbus_line_config_t line;
+        poll_sensor_line(sensor, &line);
+        ESP_LOGI(TAG, "Testing sensor '%s' at %d %c%d", sensor->name, line.baud_rate, line.parity, line.stop_bits);
         
         // Perform real Modbus communication
         // Allocate format_table buffer before modbus operation (needed for both success/error paths)
@@ -6184,6 +6237,8 @@ static esp_err_t test_sensor_handler(httpd_req_t *req)
 
         // Perform Modbus read based on register type
         modbus_result_t result;
+        uint16_t read_registers[MODBUS_MAX_REGISTERS];
+        uint16_t read_count = 0;
         const char* reg_type = sensor->register_type;
         if (!reg_type || strlen(reg_type) == 0) {
             reg_type = "HOLDING";
@@ -6191,24 +6246,26 @@ static esp_err_t test_sensor_handler(httpd_req_t *req)
         
         if (strcmp(reg_type, "INPUT") == 0) {
             ESP_LOGI(TAG, "[MODBUS] Reading INPUT registers (function 04) for sensor '%s'", sensor->name);
-            result = modbus_read_input_registers(sensor->slave_id, sensor->register_address, sensor->quantity);
+            result = modbus_bus_read(MODBUS_PRIO_INTERACTIVE, &line, sensor->slave_id, MODBUS_READ_INPUT_REGISTERS,
+                                     sensor->register_address, sensor->quantity, read_registers, &read_count);
         } else {
             ESP_LOGI(TAG, "[MODBUS] Reading HOLDING registers (function 03) for sensor '%s' - type '%s'", sensor->name, reg_type);
-            result = modbus_read_holding_registers(sensor->slave_id, sensor->register_address, sensor->quantity);
+            result = modbus_bus_read(MODBUS_PRIO_INTERACTIVE, &line, sensor->slave_id, MODBUS_READ_HOLDING_REGISTERS,
+                                     sensor->register_address, sensor->quantity, read_registers, &read_count);
         }
         
         if (result == MODBUS_SUCCESS) {
             // Use the same comprehensive logic as test_rs485_handler
             // Get the raw register values
             uint16_t registers[4]; // Limit to 4 registers to prevent overflow
-            int reg_count = modbus_get_response_length();
+            int reg_count = read_count;
             if (reg_count > 4 || reg_count <= 0) {
                 ESP_LOGW(TAG, "Invalid register count: %d, limiting to safe range", reg_count);
                 reg_count = (reg_count > 4) ? 4 : 1; // Safety limit
             }
             
             for (int i = 0; i < reg_count && i < 4; i++) {
-                registers[i] = modbus_get_response_buffer(i);
+                registers[i] = read_registers[i];
             }
             
             // Create comprehensive ScadaCore format interpretation table
@@ -6542,7 +6599,7 @@ static esp_err_t test_sensor_handler(httpd_req_t *req)
                 "<li>Try different baud rates (9600, 19200, 38400)</li>"
                 "<li>Ensure proper RS485 termination resistors</li>"
                 "</ul></div></div>",
-                error_msg, sensor->slave_id, sensor->register_address, sensor->register_type[0] ? sensor->register_type : "HOLDING", baud_rate);
+                error_msg, sensor->slave_id, sensor->register_address, sensor->register_type[0] ? sensor->register_type : "HOLDING", line.baud_rate);
             
             httpd_resp_set_type(req, "text/html");
             httpd_resp_send(req, format_table, strlen(format_table));
@@ -7136,7 +7193,7 @@ static esp_err_t test_rs485_handler(httpd_req_t *req)
     // Parse parameters
     int slave_id = 1, register_address = 0, quantity = 1, baud_rate = 9600;
     float scale_factor = 1.0, sensor_height = 0.0, max_water_level = 0.0;
-    char data_type[32] = "", sensor_type[16] = "", register_type[16] = "HOLDING";
+    char data_type[32] = "", sensor_type[16] = "", register_type[16] = "HOLDING", parity[8] = "none";
     
     char* param = strtok(buf, "&");
     while (param != NULL) {
@@ -7160,6 +7217,8 @@ static esp_err_t test_rs485_handler(httpd_req_t *req)
             max_water_level = atof(param + 16);
         } else if (strncmp(param, "register_type=", 13) == 0) {
             url_decode(register_type, param + 13);
+        } else if (strncmp(param, "parity=", 7) == 0) {
+            strncpy(parity, param + 7, sizeof(parity) - 1);
         }
         param = strtok(NULL, "&");
     }
@@ -7209,34 +7268,37 @@ static esp_err_t test_rs485_handler(httpd_req_t *req)
     ESP_LOGI(TAG, "✓ Parameters validated - Slave:%d, Reg:%d, Qty:%d, RegType:%s, DataType:%s", 
              slave_id, register_address, quantity, register_type, data_type);
     
-    // Set the baud rate before performing the test
-    ESP_LOGI(TAG, "Setting baud rate to %d bps for RS485 test", baud_rate);
-    esp_err_t baud_err = modbus_set_baud_rate(baud_rate);
-    if (baud_err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set baud rate: %s", esp_err_to_name(baud_err));
-    }
-    
-    // Perform Modbus test based on register type
+    // Perform Modbus test based on register type (the bus task applies the line settings)
+    modbus_line_config_t line = {
+        .baud_rate = baud_rate > 0 ? baud_rate : 9600,
+        .parity = poll_parity_code(parity),
+        .stop_bits = POLL_DEFAULT_STOP_BITS,
+    };
+    ESP_LOGI(TAG, "RS485 test at %d %c%d", line.baud_rate, line.parity, line.stop_bits);
     modbus_result_t result;
+    uint16_t read_registers[MODBUS_MAX_REGISTERS];
+    uint16_t read_count = 0;
     if (strcmp(register_type, "INPUT") == 0) {
         ESP_LOGI(TAG, "[MODBUS] Reading INPUT registers (function 04)");
-        result = modbus_read_input_registers(slave_id, register_address, quantity);
+        result = modbus_bus_read(MODBUS_PRIO_INTERACTIVE, &line, slave_id, MODBUS_READ_INPUT_REGISTERS,
+                                 register_address, quantity, read_registers, &read_count);
     } else {
         ESP_LOGI(TAG, "[MODBUS] Reading HOLDING registers (function 03) - default for type '%s'", register_type);
-        result = modbus_read_holding_registers(slave_id, register_address, quantity);
+        result = modbus_bus_read(MODBUS_PRIO_INTERACTIVE, &line, slave_id, MODBUS_READ_HOLDING_REGISTERS,
+                                 register_address, quantity, read_registers, &read_count);
     }
     
     if (result == MODBUS_SUCCESS) {
         // Get the raw register values
         uint16_t registers[4]; // Limit to 4 registers to prevent overflow
-        int reg_count = modbus_get_response_length();
+        int reg_count = read_count;
         if (reg_count > 4 || reg_count <= 0) {
             ESP_LOGW(TAG, "Invalid register count: %d, limiting to safe range", reg_count);
             reg_count = (reg_count > 4) ? 4 : 1; // Safety limit
         }
         
         for (int i = 0; i < reg_count && i < 4; i++) {
-            registers[i] = modbus_get_response_buffer(i);
+            registers[i] = read_registers[i];
         }
         
         // Create comprehensive ScadaCore format interpretation table (heap allocated for large content)
@@ -8014,7 +8076,10 @@ static esp_err_t test_water_quality_sensor_handler(httpd_req_t *req)
              slave_id, register_address, quantity, data_type);
     
     // Test RS485 communication
-    modbus_result_t result = modbus_read_holding_registers(slave_id, register_address, quantity);
+    uint16_t read_registers[MODBUS_MAX_REGISTERS];
+    uint16_t read_count = 0;
+    modbus_result_t result = modbus_bus_read(MODBUS_PRIO_INTERACTIVE, NULL, slave_id, MODBUS_READ_HOLDING_REGISTERS,
+                                             register_address, quantity, read_registers, &read_count);
     
     char response[512];
     httpd_resp_set_type(req, "application/json");
@@ -8022,11 +8087,11 @@ static esp_err_t test_water_quality_sensor_handler(httpd_req_t *req)
     if (result == MODBUS_SUCCESS) {
         // Get the raw register values
         uint16_t registers[10];
-        int reg_count = modbus_get_response_length();
+        int reg_count = read_count;
         if (reg_count > 10) reg_count = 10; // Safety limit
         
         for (int i = 0; i < reg_count; i++) {
-            registers[i] = modbus_get_response_buffer(i);
+            registers[i] = read_registers[i];
         }
         // Process the data based on data type
         float processed_value = 0.0;
@@ -8520,7 +8585,7 @@ static esp_err_t write_single_register_handler(httpd_req_t *req)
     
     // Execute Modbus write
     ESP_LOGI(TAG, "[PROC] Executing Modbus write single register...");
-    modbus_result_t result = modbus_write_single_register(slave_id, register_addr, value);
+    modbus_result_t result = modbus_bus_write_single(MODBUS_PRIO_INTERACTIVE, NULL, slave_id, register_addr, value);
     
     if (result == MODBUS_SUCCESS) {
         ESP_LOGI(TAG, "Write single register successful");
@@ -8624,7 +8689,8 @@ static esp_err_t write_multiple_registers_handler(httpd_req_t *req)
     
     // Execute Modbus write
     ESP_LOGI(TAG, "[PROC] Executing Modbus write multiple registers...");
-    modbus_result_t result = modbus_write_multiple_registers(slave_id, start_addr, num_regs, values);
+    modbus_result_t result = modbus_bus_write_multiple(MODBUS_PRIO_INTERACTIVE, NULL, slave_id, start_addr,
+                                                       num_regs, values);
     
     if (result == MODBUS_SUCCESS) {
         ESP_LOGI(TAG, "Write multiple registers successful");
@@ -9007,7 +9073,7 @@ static esp_err_t start_webserver(void)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 80;
-    config.max_uri_handlers = 50; // Increased to accommodate all 45+ handlers (SIM/SD/RTC/Modbus endpoints)
+    config.max_uri_handlers = 64; // Room for all 50+ handlers (SIM/SD/RTC/Modbus endpoints)
     config.max_open_sockets = 7;      // Maximum allowed by LWIP configuration
     config.stack_size = 16384;        // Increased to 16KB to handle large stack buffers safely
     config.task_priority = 5;
@@ -9366,6 +9432,15 @@ static esp_err_t start_webserver(void)
         };
         httpd_register_uri_handler(g_server, &api_sd_status_uri);
 
+        // SD historian range query endpoint
+        httpd_uri_t api_history_uri = {
+            .uri = "/api/history",
+            .method = HTTP_GET,
+            .handler = api_history_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(g_server, &api_history_uri);
+
         // SD clear API endpoint
         httpd_uri_t api_sd_clear_uri = {
             .uri = "/api/sd_clear",
@@ -9420,6 +9495,33 @@ static esp_err_t start_webserver(void)
         };
         httpd_register_uri_handler(g_server, &api_modbus_status_uri);
 
+        // Poll path stage timings and latency budgets
+        httpd_uri_t api_poll_profile_uri = {
+            .uri = "/api/poll_profile",
+            .method = HTTP_GET,
+            .handler = api_poll_profile_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(g_server, &api_poll_profile_uri);
+
+        // Binary trace ring of the Modbus and telemetry paths
+        httpd_uri_t api_trace_uri = {
+            .uri = "/api/trace",
+            .method = HTTP_GET,
+            .handler = api_trace_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(g_server, &api_trace_uri);
+
+        // Prometheus scrape endpoint
+        httpd_uri_t metrics_uri = {
+            .uri = "/metrics",
+            .method = HTTP_GET,
+            .handler = metrics_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(g_server, &metrics_uri);
+
         // Azure IoT Hub status API endpoint
         httpd_uri_t api_azure_status_uri = {
             .uri = "/api/azure/status",
@@ -9438,19 +9540,38 @@ static esp_err_t start_webserver(void)
         };
         httpd_register_uri_handler(g_server, &api_telemetry_history_uri);
 
-        // Modbus Explorer: Device Scanner endpoint
-        httpd_uri_t modbus_scan_uri = {
-            .uri = "/modbus_scan",
+        // Modbus Explorer: background scan job endpoints
+        httpd_uri_t api_modbus_scan_start_uri = {
+            .uri = "/api/modbus_scan/start",
             .method = HTTP_POST,
-            .handler = modbus_scan_handler,
+            .handler = api_modbus_scan_start_handler,
             .user_ctx = NULL
         };
-        esp_err_t scan_reg = httpd_register_uri_handler(g_server, &modbus_scan_uri);
-        if (scan_reg == ESP_OK) {
-            ESP_LOGI(TAG, "SUCCESS: /modbus_scan endpoint registered successfully");
-        } else {
-            ESP_LOGE(TAG, "ERROR: Failed to register /modbus_scan endpoint: %s", esp_err_to_name(scan_reg));
-        }
+        httpd_register_uri_handler(g_server, &api_modbus_scan_start_uri);
+
+        httpd_uri_t api_modbus_scan_status_uri = {
+            .uri = "/api/modbus_scan/status",
+            .method = HTTP_GET,
+            .handler = api_modbus_scan_status_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(g_server, &api_modbus_scan_status_uri);
+
+        httpd_uri_t api_modbus_scan_results_uri = {
+            .uri = "/api/modbus_scan/results",
+            .method = HTTP_GET,
+            .handler = api_modbus_scan_results_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(g_server, &api_modbus_scan_results_uri);
+
+        httpd_uri_t api_modbus_scan_stop_uri = {
+            .uri = "/api/modbus_scan/stop",
+            .method = HTTP_POST,
+            .handler = api_modbus_scan_stop_handler,
+            .user_ctx = NULL
+        };
+        httpd_register_uri_handler(g_server, &api_modbus_scan_stop_uri);
 
         // Modbus Explorer: Live Register Reader endpoint
         httpd_uri_t modbus_read_live_uri = {
@@ -9519,7 +9640,7 @@ static esp_err_t start_webserver(void)
 
         ESP_LOGI(TAG, "Web server started on port 80");
         ESP_LOGI(TAG, "[NET] All URI handlers registered successfully (including Modbus Explorer endpoints)");
-        ESP_LOGI(TAG, "[CONFIG] Available endpoints: /, /save_config, /save_azure_config, /save_network_mode, /save_sim_config, /save_sd_config, /save_rtc_config, /test_sensor, /test_rs485, /start_operation, /scan_wifi, /live_data, /edit_sensor, /save_single_sensor, /delete_sensor, /api/system_status, /api/sim_test, /api/sd_status, /api/sd_clear, /api/sd_replay, /api/rtc_time, /api/rtc_sync, /api/rtc_set, /write_single_register, /write_multiple_registers, /modbus_scan, /modbus_read_live, /reboot, /watchdog_control, /gpio_trigger, /logo, /favicon.ico");
+        ESP_LOGI(TAG, "[CONFIG] Available endpoints: /, /save_config, /save_azure_config, /save_network_mode, /save_sim_config, /save_sd_config, /save_rtc_config, /test_sensor, /test_rs485, /start_operation, /scan_wifi, /live_data, /edit_sensor, /save_single_sensor, /delete_sensor, /api/system_status, /api/sim_test, /api/sd_status, /api/history, /api/poll_profile, /api/trace, /metrics, /api/sd_clear, /api/sd_replay, /api/rtc_time, /api/rtc_sync, /api/rtc_set, /write_single_register, /write_multiple_registers, /api/modbus_scan/{start,status,results,stop}, /modbus_read_live, /reboot, /watchdog_control, /gpio_trigger, /logo, /favicon.ico");
         return ESP_OK;
     }
 
@@ -9655,6 +9776,7 @@ esp_err_t web_config_start_sta_mode(void)
         ESP_LOGE(TAG, "[WARN] Sensor testing will not work until Modbus is properly connected");
     } else {
         ESP_LOGI(TAG, "SUCCESS: Modbus RS485 initialized successfully in setup mode");
+        modbus_bus_start();
     }
     
     return start_webserver();
@@ -10026,12 +10148,12 @@ static esp_err_t api_modbus_poll_handler(httpd_req_t *req) {
     }
 
     // Read Modbus registers
-    modbus_result_t result;
-    if (strcmp(type_str, "holding") == 0) {
-        result = modbus_read_holding_registers(slave_id, start_reg, quantity);
-    } else {
-        result = modbus_read_input_registers(slave_id, start_reg, quantity);
-    }
+    uint16_t registers[20];
+    uint16_t reg_count = 0;
+    uint8_t function_code = (strcmp(type_str, "holding") == 0) ?
+        MODBUS_READ_HOLDING_REGISTERS : MODBUS_READ_INPUT_REGISTERS;
+    modbus_result_t result = modbus_bus_read(MODBUS_PRIO_INTERACTIVE, NULL, slave_id, function_code,
+                                             start_reg, quantity, registers, &reg_count);
 
     if (result != MODBUS_SUCCESS) {
         char resp[128];
@@ -10057,8 +10179,8 @@ static esp_err_t api_modbus_poll_handler(httpd_req_t *req) {
         slave_id, start_reg, quantity, type_str);
 
     // Get values from response buffer
-    for (int i = 0; i < quantity && offset < sizeof(response) - 50; i++) {
-        uint16_t value = modbus_get_response_buffer(i);
+    for (int i = 0; i < reg_count && offset < sizeof(response) - 50; i++) {
+        uint16_t value = registers[i];
         offset += snprintf(response + offset, sizeof(response) - offset,
             "%s%u", i > 0 ? "," : "", value);
     }
@@ -10330,14 +10452,31 @@ static esp_err_t api_sd_status_handler(httpd_req_t *req) {
 
     if (ret == ESP_OK && status.initialized && status.card_available) {
         uint32_t pending_count = 0;
+        uint32_t oldest_id = 0;
+        uint32_t newest_id = 0;
         sd_card_get_pending_count(&pending_count);
+        sd_card_get_pending_range(&oldest_id, &newest_id);
 
-        char response[256];
+        char response[640];
         snprintf(response, sizeof(response),
-                 "{\"mounted\":true,\"size_mb\":%llu,\"free_mb\":%llu,\"cached_messages\":%lu}",
+                 "{\"mounted\":true,\"size_mb\":%llu,\"free_mb\":%llu,\"cached_messages\":%lu,"
+                 "\"oldest_id\":%lu,\"newest_id\":%lu,"
+                 "\"clock_khz\":%lu,\"write_kbps\":%lu,\"read_kbps\":%lu,\"clock_fallbacks\":%lu,"
+                 "\"latency_us\":{\"append\":{\"avg\":%lu,\"max\":%lu},\"flush\":{\"avg\":%lu,\"max\":%lu},"
+                 "\"read\":{\"avg\":%lu,\"max\":%lu},\"remove\":{\"avg\":%lu,\"max\":%lu}}}",
                  status.card_size_mb,
                  status.free_space_mb,
-                 (unsigned long)pending_count);
+                 (unsigned long)pending_count,
+                 (unsigned long)oldest_id,
+                 (unsigned long)newest_id,
+                 (unsigned long)status.clock_khz,
+                 (unsigned long)status.probe_write_kbps,
+                 (unsigned long)status.probe_read_kbps,
+                 (unsigned long)status.clock_fallbacks,
+                 (unsigned long)status.append.avg_us, (unsigned long)status.append.max_us,
+                 (unsigned long)status.flush.avg_us, (unsigned long)status.flush.max_us,
+                 (unsigned long)status.read.avg_us, (unsigned long)status.read.max_us,
+                 (unsigned long)status.remove.avg_us, (unsigned long)status.remove.max_us);
         httpd_resp_sendstr(req, response);
     } else {
         httpd_resp_sendstr(req, "{\"mounted\":false}");
@@ -10345,6 +10484,129 @@ static esp_err_t api_sd_status_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+// json_writer sink that sends each filled scratch buffer as one HTTP chunk
+static bool httpd_chunk_sink(void *ctx, const char *data, size_t len)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len) == ESP_OK;
+}
+
+// Ends a chunked JSON response written through httpd_chunk_sink
+static esp_err_t httpd_json_finish(httpd_req_t *req, json_writer_t *w)
+{
+    if (json_writer_finish(w) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// Streaming state for /api/history: points go straight into the response
+// through a small scratch buffer, so a long range never sits in RAM
+typedef struct {
+    json_writer_t writer;
+    char scratch[512];
+    bool raw;
+} history_stream_t;
+
+static bool history_stream_point(const sd_history_point_t *point, void *ctx)
+{
+    history_stream_t *stream = (history_stream_t *)ctx;
+    json_writer_t *w = &stream->writer;
+    json_writer_begin_array(w);
+    json_writer_int(w, (int64_t)point->time);
+    if (stream->raw) {
+        json_writer_double(w, point->avg, 2);
+        json_writer_uint(w, point->quality);
+    } else if (point->good > 0) {
+        json_writer_double(w, point->avg, 2);
+        json_writer_double(w, point->min, 2);
+        json_writer_double(w, point->max, 2);
+        json_writer_uint(w, point->count);
+    } else {
+        // Only stale rows in this bucket
+        json_writer_null(w);
+        json_writer_null(w);
+        json_writer_null(w);
+        json_writer_uint(w, point->count);
+    }
+    json_writer_end_array(w);
+    return w->error == ESP_OK;
+}
+
+// Handler: /api/history - Range query over the SD historian
+// ?unit=ID[&from=T][&to=T][&agg=raw|300|5m|1h|1d]; T is epoch seconds or
+// YYYY-MM-DD[THH:MM[:SS]] (UTC). Defaults: the last 24 hours, raw rows.
+static esp_err_t api_history_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "application/json");
+
+    char query[160];
+    char unit[20] = "";
+    char value[24];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "unit", unit, sizeof(unit)) != ESP_OK || unit[0] == '\0' ||
+        strspn(unit, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_.") != strlen(unit)) {
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_sendstr(req, "{\"status\":\"error\",\"message\":\"Missing or invalid unit parameter\"}");
+        return ESP_OK;
+    }
+
+    time_t to = time(NULL);
+    time_t from;
+    uint32_t agg = 0;
+    if (httpd_query_key_value(query, "to", value, sizeof(value)) == ESP_OK && !sd_history_parse_time(value, &to)) {
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_sendstr(req, "{\"status\":\"error\",\"message\":\"Invalid to\"}");
+        return ESP_OK;
+    }
+    from = to - 24 * 3600;
+    if (httpd_query_key_value(query, "from", value, sizeof(value)) == ESP_OK && !sd_history_parse_time(value, &from)) {
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_sendstr(req, "{\"status\":\"error\",\"message\":\"Invalid from\"}");
+        return ESP_OK;
+    }
+    if (httpd_query_key_value(query, "agg", value, sizeof(value)) == ESP_OK && !sd_history_parse_interval(value, &agg)) {
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_sendstr(req, "{\"status\":\"error\",\"message\":\"Invalid agg\"}");
+        return ESP_OK;
+    }
+    if (to < from || to - from > (time_t)SD_HISTORY_MAX_SPAN_DAYS * 86400) {
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_sendstr(req, "{\"status\":\"error\",\"message\":\"Range must be 0 to 92 days\"}");
+        return ESP_OK;
+    }
+    if (!sd_card_is_available()) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "{\"status\":\"error\",\"message\":\"SD card not available\"}");
+        return ESP_OK;
+    }
+
+    static history_stream_t stream;  // httpd serves one request at a time
+    json_writer_t *w = &stream.writer;
+    stream.raw = agg == 0;
+    json_writer_init(w, stream.scratch, sizeof(stream.scratch), httpd_chunk_sink, req);
+    json_writer_begin_object(w);
+    json_writer_key_string(w, "unit", unit);
+    json_writer_key_int(w, "from", (int64_t)from);
+    json_writer_key_int(w, "to", (int64_t)to);
+    json_writer_key_uint(w, "agg", agg);
+    const char *fields = stream.raw ? "[\"t\",\"value\",\"quality\"]"
+                                    : "[\"t\",\"avg\",\"min\",\"max\",\"count\"]";
+    json_writer_key(w, "fields");
+    json_writer_raw(w, fields, strlen(fields));
+    json_writer_key(w, "points");
+    json_writer_begin_array(w);
+
+    esp_err_t ret = sd_history_query(unit, from, to, agg, history_stream_point, &stream);
+    if (w->error != ESP_OK) {
+        ESP_LOGW(TAG, "[WARN] History query for %s aborted: client went away", unit);
+        return ESP_FAIL;
+    }
+
+    json_writer_end_array(w);
+    json_writer_key_string(w, "status", ret == ESP_OK ? "ok" : esp_err_to_name(ret));
+    json_writer_end_object(w);
+    return httpd_json_finish(req, w);
+}
+
 // Handler: /api/sd_clear - Clear cached messages
 static esp_err_t api_sd_clear_handler(httpd_req_t *req) {
     httpd_resp_set_type(req, "application/json");
@@ -10453,8 +10715,14 @@ static esp_err_t api_modbus_status_handler(httpd_req_t *req) {
     // Get current time for timestamp
     int64_t current_time = esp_timer_get_time() / 1000000;
 
-    char json_response[512];
-    snprintf(json_response, sizeof(json_response),
+    modbus_slave_stats_t slaves[MODBUS_STATS_MAX_SLAVES];
+    int slave_count = modbus_get_slave_statistics(slaves, MODBUS_STATS_MAX_SLAVES);
+
+    poll_cycle_stats_t cycle;
+    sensor_manager_get_cycle_stats(&cycle);
+
+    char json_response[6144];
+    int len = snprintf(json_response, sizeof(json_response),
         "{"
         "\"total_reads\":%lu,"
         "\"successful_reads\":%lu,"
@@ -10464,8 +10732,12 @@ static esp_err_t api_modbus_status_handler(httpd_req_t *req) {
         "\"timeout_errors\":%lu,"
         "\"last_error_code\":%lu,"
         "\"sensors_configured\":%d,"
-        "\"timestamp\":%lld"
-        "}",
+        "\"timestamp\":%lld,"
+        "\"line_reconfigs\":%lu,"
+        "\"line_reconfig_ms\":%llu,"
+        "\"last_poll_cycle\":{\"cycle\":%lu,\"duration_ms\":%lu,\"transactions\":%d,"
+        "\"line_groups\":%d,\"line_reconfigs\":%lu,\"line_reconfig_ms\":%lu},"
+        "\"slaves\":[",
         (unsigned long)stats.total_requests,
         (unsigned long)stats.successful_requests,
         (unsigned long)stats.failed_requests,
@@ -10474,9 +10746,42 @@ static esp_err_t api_modbus_status_handler(httpd_req_t *req) {
         (unsigned long)stats.timeout_errors,
         (unsigned long)stats.last_error_code,
         g_system_config.sensor_count,
-        (long long)current_time
+        (long long)current_time,
+        (unsigned long)stats.line_reconfigs,
+        (unsigned long long)(stats.line_reconfig_us / 1000),
+        (unsigned long)cycle.cycle_count,
+        (unsigned long)cycle.cycle_ms,
+        cycle.transactions,
+        cycle.line_groups,
+        (unsigned long)cycle.line_reconfigs,
+        (unsigned long)cycle.line_reconfig_ms
     );
 
+    // Per-slave turnaround statistics and the timeout currently in use
+    for (int i = 0; i < slave_count && len < (int)sizeof(json_response) - 400; i++) {
+        const modbus_slave_stats_t *slave = &slaves[i];
+        len += snprintf(json_response + len, sizeof(json_response) - len,
+            "%s{\"slave_id\":%d,\"requests\":%lu,\"responses\":%lu,\"timeouts\":%lu,"
+            "\"rtt_ewma_ms\":%.1f,\"rtt_p99_ms\":%lu,\"rtt_max_ms\":%lu,\"timeout_ms\":%lu,\"histogram\":[",
+            i > 0 ? "," : "", slave->slave_id,
+            (unsigned long)slave->requests, (unsigned long)slave->responses, (unsigned long)slave->timeouts,
+            slave->rtt_ewma_us / 1000.0f, (unsigned long)modbus_slave_rtt_p99_ms(slave),
+            (unsigned long)slave->rtt_max_ms, (unsigned long)slave->timeout_ms);
+        for (int b = 0; b < MODBUS_RTT_BUCKETS; b++) {
+            len += snprintf(json_response + len, sizeof(json_response) - len,
+                            "%s%lu", b > 0 ? "," : "", (unsigned long)slave->rtt_histogram[b]);
+        }
+        len += snprintf(json_response + len, sizeof(json_response) - len, "]}");
+    }
+
+    // Bucket i counts turnarounds below rtt_bucket_limits_ms[i]; the last bucket is open-ended
+    len += snprintf(json_response + len, sizeof(json_response) - len, "],\"rtt_bucket_limits_ms\":[");
+    for (int b = 0; b < MODBUS_RTT_BUCKETS - 1; b++) {
+        len += snprintf(json_response + len, sizeof(json_response) - len,
+                        "%s%lu", b > 0 ? "," : "", (unsigned long)modbus_rtt_bucket_limit_ms(b));
+    }
+    snprintf(json_response + len, sizeof(json_response) - len, "]}");
+
     httpd_resp_sendstr(req, json_response);
     return ESP_OK;
 }
@@ -10528,95 +10833,214 @@ static esp_err_t api_azure_status_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
-// Azure telemetry history handler (for web interface)
-static esp_err_t api_telemetry_history_handler(httpd_req_t *req) {
+// Handler: /api/poll_profile - Stage timings of the poll and telemetry path
+static esp_err_t api_poll_profile_handler(httpd_req_t *req) {
     httpd_resp_set_type(req, "application/json");
 
-    // Allocate buffer for telemetry history JSON (25 messages * ~450 bytes each)
-    char *history_buffer = (char *)malloc(12000);
-    if (history_buffer == NULL) {
-        const char* error_response = "{\"error\":\"Out of memory\"}";
-        httpd_resp_sendstr(req, error_response);
-        return ESP_OK;
-    }
+    char scratch[256];
+    json_writer_t w;
+    json_writer_init(&w, scratch, sizeof(scratch), httpd_chunk_sink, req);
+    poll_profile_write_json(&w);
+    return httpd_json_finish(req, &w);
+}
 
-    // Get telemetry history from main.c
-    int written = get_telemetry_history_json(history_buffer, 12000);
+// Handler: /api/trace - Trace events, oldest first
+// ?since=SEQ returns only events from SEQ on (pass the previous "head" to poll);
+// ?level=0|1|2 sets the runtime trace level (off, info, debug) first.
+static esp_err_t api_trace_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "application/json");
 
-    if (written > 0) {
-        httpd_resp_sendstr(req, history_buffer);
-    } else {
-        const char* empty_response = "[]";
-        httpd_resp_sendstr(req, empty_response);
+    char query[64];
+    char value[16];
+    uint32_t since = 0;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "level", value, sizeof(value)) == ESP_OK) {
+            if (value[0] < '0' || value[0] > '2' || value[1] != '\0') {
+                httpd_resp_set_status(req, "400 Bad Request");
+                httpd_resp_sendstr(req, "{\"status\":\"error\",\"message\":\"level must be 0, 1 or 2\"}");
+                return ESP_OK;
+            }
+            trace_set_level((uint8_t)(value[0] - '0'));
+        }
+        if (httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+            since = (uint32_t)strtoul(value, NULL, 10);
+        }
     }
 
-    free(history_buffer);
-    return ESP_OK;
+    char scratch[512];
+    json_writer_t w;
+    json_writer_init(&w, scratch, sizeof(scratch), httpd_chunk_sink, req);
+    trace_write_json(&w, since);
+    return httpd_json_finish(req, &w);
+}
+
+// Handler: /metrics - Registry in Prometheus text exposition format
+static esp_err_t metrics_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    char scratch[512];
+    json_writer_t w;
+    json_writer_init(&w, scratch, sizeof(scratch), httpd_chunk_sink, req);
+    metrics_write_text(&w);
+    return httpd_json_finish(req, &w);
 }
 
-// Modbus Explorer: Device Scanner Handler
-static esp_err_t modbus_scan_handler(httpd_req_t *req) {
+// Azure telemetry history handler (for web interface)
+static esp_err_t api_telemetry_history_handler(httpd_req_t *req) {
     httpd_resp_set_type(req, "application/json");
 
-    char content[512];
+    // Streamed in chunks through a small scratch buffer (25 messages * ~450 bytes each)
+    char scratch[512];
+    json_writer_t w;
+    json_writer_init(&w, scratch, sizeof(scratch), httpd_chunk_sink, req);
+    write_telemetry_history_json(&w);
+    return httpd_json_finish(req, &w);
+}
+
+// Handler: /api/modbus_scan/start - Start a background scan job
+// Form fields: start_id, end_id, test_register, reg_type (holding/input/both),
+// bauds (comma separated), parity (none/even/odd), timeout_ms
+static esp_err_t api_modbus_scan_start_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "application/json");
+
+    char content[256];
     int ret = httpd_req_recv(req, content, sizeof(content) - 1);
-    if (ret <= 0) {
+    if (ret < 0) {
         httpd_resp_sendstr(req, "{\"status\":\"error\",\"message\":\"Failed to receive request\"}");
         return ESP_FAIL;
     }
-    content[ret] = '\0';
-
-    // Parse parameters
-    int start_id = 1, end_id = 10, test_register = 0;
-    char reg_type[16] = "holding";
-
-    char *param = strstr(content, "start_id=");
-    if (param) start_id = atoi(param + 9);
+    content[ret > 0 ? ret : 0] = '\0';
 
-    param = strstr(content, "end_id=");
-    if (param) end_id = atoi(param + 7);
+    modbus_scan_params_t params;
+    modbus_scan_default_params(&params);
 
-    param = strstr(content, "test_register=");
-    if (param) test_register = atoi(param + 14);
-
-    param = strstr(content, "reg_type=");
-    if (param) {
-        sscanf(param + 9, "%15[^&]", reg_type);
+    char value[64];
+    int start_id = params.start_id, end_id = params.end_id;
+    if (httpd_query_key_value(content, "start_id", value, sizeof(value)) == ESP_OK) {
+        start_id = atoi(value);
+    }
+    if (httpd_query_key_value(content, "end_id", value, sizeof(value)) == ESP_OK) {
+        end_id = atoi(value);
     }
-
-    // Validate range
     if (start_id < 1 || start_id > 247 || end_id < 1 || end_id > 247 || start_id > end_id) {
         httpd_resp_sendstr(req, "{\"status\":\"error\",\"message\":\"Invalid slave ID range\"}");
         return ESP_OK;
     }
+    params.start_id = (uint8_t)start_id;
+    params.end_id = (uint8_t)end_id;
+
+    if (httpd_query_key_value(content, "test_register", value, sizeof(value)) == ESP_OK) {
+        params.test_register = (uint16_t)atoi(value);
+    }
+    if (httpd_query_key_value(content, "reg_type", value, sizeof(value)) == ESP_OK) {
+        params.holding = (strcmp(value, "input") != 0);
+        params.input = (strcmp(value, "input") == 0 || strcmp(value, "both") == 0);
+    }
+    if (httpd_query_key_value(content, "bauds", value, sizeof(value)) == ESP_OK) {
+        char bauds[64];
+        url_decode(bauds, value);
+        params.baud_count = 0;
+        for (char *token = strtok(bauds, ","); token && params.baud_count < MODBUS_SCAN_MAX_BAUDS;
+             token = strtok(NULL, ",")) {
+            int baud = atoi(token);
+            if (baud > 0) {
+                params.baud_rates[params.baud_count++] = baud;
+            }
+        }
+    }
+    if (httpd_query_key_value(content, "parity", value, sizeof(value)) == ESP_OK) {
+        params.parity = poll_parity_code(value);
+    }
+    if (httpd_query_key_value(content, "timeout_ms", value, sizeof(value)) == ESP_OK) {
+        int timeout_ms = atoi(value);
+        params.probe_timeout_ms = (uint32_t)(timeout_ms < 20 ? 20 : (timeout_ms > MODBUS_RESPONSE_TIMEOUT_MS ?
+                                             MODBUS_RESPONSE_TIMEOUT_MS : timeout_ms));
+    }
 
-    // Build JSON response with discovered devices
-    char json_response[2048] = "{\"status\":\"success\",\"devices\":[";
-    bool first = true;
+    uint32_t job_id = 0;
+    esp_err_t err = modbus_scan_start(&params, &job_id);
+    char response[160];
+    if (err == ESP_OK) {
+        snprintf(response, sizeof(response), "{\"status\":\"success\",\"job_id\":%lu}", (unsigned long)job_id);
+    } else if (err == ESP_ERR_INVALID_STATE) {
+        snprintf(response, sizeof(response), "{\"status\":\"error\",\"message\":\"A scan is already running\"}");
+    } else if (err == ESP_ERR_INVALID_ARG) {
+        snprintf(response, sizeof(response), "{\"status\":\"error\",\"message\":\"Invalid scan parameters\"}");
+    } else {
+        snprintf(response, sizeof(response), "{\"status\":\"error\",\"message\":\"%s\"}", esp_err_to_name(err));
+    }
+    httpd_resp_sendstr(req, response);
+    return ESP_OK;
+}
 
-    for (int slave_id = start_id; slave_id <= end_id; slave_id++) {
-        modbus_result_t result;
+// Handler: /api/modbus_scan/status - Progress of the current or last scan job
+static esp_err_t api_modbus_scan_status_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "application/json");
 
-        if (strcmp(reg_type, "input") == 0) {
-            result = modbus_read_input_registers(slave_id, test_register, 1);
-        } else {
-            result = modbus_read_holding_registers(slave_id, test_register, 1);
-        }
+    modbus_scan_status_t status;
+    modbus_scan_get_status(&status);
 
-        if (result == MODBUS_SUCCESS) {
-            char device_entry[128];
-            snprintf(device_entry, sizeof(device_entry),
-                     "%s{\"slave_id\":%d,\"responsive\":true}",
-                     first ? "" : ",", slave_id);
-            strcat(json_response, device_entry);
-            first = false;
-        }
+    char response[320];
+    snprintf(response, sizeof(response),
+        "{\"status\":\"success\",\"job_id\":%lu,\"state\":\"%s\",\"probes_done\":%lu,\"probes_total\":%lu,"
+        "\"found\":%d,\"dropped\":%d,\"current_slave\":%d,\"current_baud\":%d,\"elapsed_ms\":%lu}",
+        (unsigned long)status.job_id, modbus_scan_state_name(status.state),
+        (unsigned long)status.probes_done, (unsigned long)status.probes_total,
+        status.found, status.dropped, status.current_slave, status.current_baud,
+        (unsigned long)status.elapsed_ms);
+    httpd_resp_sendstr(req, response);
+    return ESP_OK;
+}
 
-        vTaskDelay(pdMS_TO_TICKS(50)); // Small delay between scans
-    }
+// Handler: /api/modbus_scan/results?since=N - Devices found after the first N.
+// Clients poll with since=next until complete is true.
+static esp_err_t api_modbus_scan_results_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "application/json");
 
-    strcat(json_response, "]}");
-    httpd_resp_sendstr(req, json_response);
+    int since = 0;
+    char query[32];
+    char value[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+        since = atoi(value);
+    }
+    if (since < 0) {
+        since = 0;  // Reported back as since/next, so clamp rather than let the results call do it
+    }
+
+    // Status first: results copied afterwards are at least as complete
+    modbus_scan_status_t status;
+    modbus_scan_get_status(&status);
+    modbus_scan_result_t results[MODBUS_SCAN_MAX_RESULTS];
+    int count = modbus_scan_get_results(since, results, MODBUS_SCAN_MAX_RESULTS);
+
+    char response[5120];
+    int len = snprintf(response, sizeof(response),
+        "{\"status\":\"success\",\"job_id\":%lu,\"state\":\"%s\",\"complete\":%s,"
+        "\"probes_done\":%lu,\"probes_total\":%lu,\"since\":%d,\"next\":%d,\"devices\":[",
+        (unsigned long)status.job_id, modbus_scan_state_name(status.state),
+        status.state == MODBUS_SCAN_RUNNING ? "false" : "true",
+        (unsigned long)status.probes_done, (unsigned long)status.probes_total,
+        since, since + count);
+    for (int i = 0; i < count; i++) {
+        len += snprintf(response + len, sizeof(response) - len,
+            "%s{\"slave_id\":%d,\"function_code\":%d,\"baud_rate\":%d,\"parity\":\"%c\","
+            "\"exception_code\":%d,\"value\":%u,\"latency_ms\":%lu}",
+            i > 0 ? "," : "", results[i].slave_id, results[i].function_code, results[i].baud_rate,
+            results[i].parity, results[i].exception_code, results[i].value,
+            (unsigned long)results[i].latency_ms);
+    }
+    snprintf(response + len, sizeof(response) - len, "]}");
+
+    httpd_resp_sendstr(req, response);
+    return ESP_OK;
+}
+
+// Handler: /api/modbus_scan/stop - Cancel the running scan job
+static esp_err_t api_modbus_scan_stop_handler(httpd_req_t *req) {
+    httpd_resp_set_type(req, "application/json");
+    modbus_scan_stop();
+    httpd_resp_sendstr(req, "{\"status\":\"success\"}");
     return ESP_OK;
 }
 
@@ -10657,12 +11081,11 @@ static esp_err_t modbus_read_live_handler(httpd_req_t *req) {
     }
 
     // Read registers
-    modbus_result_t result;
-    if (strcmp(reg_type, "input") == 0) {
-        result = modbus_read_input_registers(slave_id, start_register, quantity);
-    } else {
-        result = modbus_read_holding_registers(slave_id, start_register, quantity);
-    }
+    uint16_t registers[10] = {0};
+    uint8_t function_code = (strcmp(reg_type, "input") == 0) ?
+        MODBUS_READ_INPUT_REGISTERS : MODBUS_READ_HOLDING_REGISTERS;
+    modbus_result_t result = modbus_bus_read(MODBUS_PRIO_INTERACTIVE, NULL, slave_id, function_code,
+                                             start_register, quantity, registers, NULL);
 
     if (result != MODBUS_SUCCESS) {
         char error_msg[256];
@@ -10672,24 +11095,21 @@ static esp_err_t modbus_read_live_handler(httpd_req_t *req) {
         return ESP_OK;
     }
 
-    // Build JSON response with all format interpretations
-    char json_response[3072] = "{\"status\":\"success\",\"formats\":{";
-    char temp[256];
-
-    // Get register values
-    uint16_t registers[10];
-    for (int i = 0; i < quantity; i++) {
-        registers[i] = modbus_get_response_buffer(i);
-    }
+    // Stream the JSON response with all format interpretations
+    char scratch[256];
+    json_writer_t w;
+    json_writer_init(&w, scratch, sizeof(scratch), httpd_chunk_sink, req);
+    json_writer_begin_object(&w);
+    json_writer_key_string(&w, "status", "success");
+    json_writer_key(&w, "formats");
+    json_writer_begin_object(&w);
 
     // Raw hex data
-    strcat(json_response, "\"hex_string\":\"");
+    char hex_string[4 * 10 + 1];
     for (int i = 0; i < quantity; i++) {
-        char hex_reg[8];
-        snprintf(hex_reg, sizeof(hex_reg), "%04X", registers[i]);
-        strcat(json_response, hex_reg);
+        snprintf(hex_string + i * 4, sizeof(hex_string) - i * 4, "%04X", registers[i]);
     }
-    strcat(json_response, "\",");
+    json_writer_key_string(&w, "hex_string", hex_string);
 
     // UINT16 and INT16 formats (from first register)
     if (quantity >= 1) {
@@ -10698,10 +11118,10 @@ static esp_err_t modbus_read_live_handler(httpd_req_t *req) {
         int16_t int16_be = (int16_t)registers[0];
         int16_t int16_le = (int16_t)uint16_le;
 
-        snprintf(temp, sizeof(temp),
-                 "\"uint16_be\":%u,\"uint16_le\":%u,\"int16_be\":%d,\"int16_le\":%d,",
-                 uint16_be, uint16_le, int16_be, int16_le);
-        strcat(json_response, temp);
+        json_writer_key_uint(&w, "uint16_be", uint16_be);
+        json_writer_key_uint(&w, "uint16_le", uint16_le);
+        json_writer_key_int(&w, "int16_be", int16_be);
+        json_writer_key_int(&w, "int16_le", int16_le);
     }
 
     // 32-bit formats (if we have at least 2 registers)
@@ -10714,44 +11134,33 @@ static esp_err_t modbus_read_live_handler(httpd_req_t *req) {
         uint32_t uint32_cdab = ((uint32_t)(((registers[0] & 0xFF) << 8) | ((registers[0] >> 8) & 0xFF)) << 16) |
                                (((registers[1] & 0xFF) << 8) | ((registers[1] >> 8) & 0xFF));
 
-        snprintf(temp, sizeof(temp),
-                 "\"uint32_abcd\":%u,\"uint32_dcba\":%u,\"uint32_badc\":%u,\"uint32_cdab\":%u,",
-                 (unsigned int)uint32_abcd, (unsigned int)uint32_dcba,
-                 (unsigned int)uint32_badc, (unsigned int)uint32_cdab);
-        strcat(json_response, temp);
+        json_writer_key_uint(&w, "uint32_abcd", uint32_abcd);
+        json_writer_key_uint(&w, "uint32_dcba", uint32_dcba);
+        json_writer_key_uint(&w, "uint32_badc", uint32_badc);
+        json_writer_key_uint(&w, "uint32_cdab", uint32_cdab);
 
         // INT32 formats
-        int32_t int32_abcd = (int32_t)uint32_abcd;
-        int32_t int32_dcba = (int32_t)uint32_dcba;
-        int32_t int32_badc = (int32_t)uint32_badc;
-        int32_t int32_cdab = (int32_t)uint32_cdab;
-
-        snprintf(temp, sizeof(temp),
-                 "\"int32_abcd\":%d,\"int32_dcba\":%d,\"int32_badc\":%d,\"int32_cdab\":%d,",
-                 (int)int32_abcd, (int)int32_dcba, (int)int32_badc, (int)int32_cdab);
-        strcat(json_response, temp);
+        json_writer_key_int(&w, "int32_abcd", (int32_t)uint32_abcd);
+        json_writer_key_int(&w, "int32_dcba", (int32_t)uint32_dcba);
+        json_writer_key_int(&w, "int32_badc", (int32_t)uint32_badc);
+        json_writer_key_int(&w, "int32_cdab", (int32_t)uint32_cdab);
 
         // FLOAT32 formats
         union { uint32_t u; float f; } float_conv;
 
         float_conv.u = uint32_abcd;
-        float float32_abcd = float_conv.f;
+        json_writer_key_double(&w, "float32_abcd", float_conv.f, 6);
         float_conv.u = uint32_dcba;
-        float float32_dcba = float_conv.f;
+        json_writer_key_double(&w, "float32_dcba", float_conv.f, 6);
         float_conv.u = uint32_badc;
-        float float32_badc = float_conv.f;
+        json_writer_key_double(&w, "float32_badc", float_conv.f, 6);
         float_conv.u = uint32_cdab;
-        float float32_cdab = float_conv.f;
-
-        snprintf(temp, sizeof(temp),
-                 "\"float32_abcd\":%.6f,\"float32_dcba\":%.6f,\"float32_badc\":%.6f,\"float32_cdab\":%.6f",
-                 float32_abcd, float32_dcba, float32_badc, float32_cdab);
-        strcat(json_response, temp);
+        json_writer_key_double(&w, "float32_cdab", float_conv.f, 6);
     }
 
-    strcat(json_response, "}}");
-    httpd_resp_sendstr(req, json_response);
-    return ESP_OK;
+    json_writer_end_object(&w);
+    json_writer_end_object(&w);
+    return httpd_json_finish(req, &w);
 }
 
 // ============================================================================
@@ -10936,6 +11345,8 @@ esp_err_t config_load_from_nvs(system_config_t *config)
         ESP_LOGI(TAG, "[NVS_LOAD] Config loaded - complete=%s, mode=%d, sensors=%d",
                  config->config_complete ? "TRUE" : "FALSE", config->network_mode, config->sensor_count);
         nvs_close(nvs_handle);
+        sensor_decoder_config_changed(config);
+        json_templates_config_changed(config);
         return ESP_OK;
     }
 
@@ -11041,6 +11452,9 @@ esp_err_t config_save_to_nvs(const system_config_t *config)
     }
 
     nvs_close(nvs_handle);
+    // Recompile the sensor decoders and JSON templates from the configuration now in use
+    sensor_decoder_config_changed(config);
+    json_templates_config_changed(config);
     return err;
 }
 
@@ -11374,6 +11788,7 @@ esp_err_t web_config_start_server_only(void)
         ESP_LOGE(TAG, "[WARN] Sensor testing will not work until Modbus is properly connected");
     } else {
         ESP_LOGI(TAG, "SUCCESS: Modbus RS485 initialized successfully for web server");
+        modbus_bus_start();
     }
     
     return start_webserver();
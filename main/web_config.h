@@ -8,6 +8,7 @@
 #include <stdbool.h>
 #include "driver/gpio.h"
 #include "driver/uart.h"
+#include "json_writer.h"
 
 // Configuration states
 typedef enum {
@@ -173,6 +174,6 @@ esp_err_t update_modem_gpio_pin(int new_gpio_pin);
 esp_err_t connect_to_wifi_network(void);
 
 // Telemetry history (for web interface display)
-int get_telemetry_history_json(char *buffer, size_t buffer_size);
+esp_err_t write_telemetry_history_json(json_writer_t *w);
 
 #endif // WEB_CONFIG_H
\ No newline at end of file